@@ -0,0 +1,1314 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "BlockCompression.h"
+#include "dds.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <intrin.h>
+#include <ppl.h>
+
+using namespace std;
+using namespace BlockCompression;
+
+namespace
+{
+    // A 4x4 block of pixels, both as rows of channels (for searching four pixels at once) and pixel by pixel
+    struct Block
+    {
+        __m128 Rows[4][4];          // [Channel][Row]
+        __m128 Pixels[16];          // RGBA
+        uint32_t MinAlpha;
+    };
+
+    typedef float Color[4];
+
+    const float kRGBWeights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+    const float kRGBAWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const float kChannelWeights[4][4] = { { 1.0f }, { 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } };
+
+    const uint32_t kAllPixels = 0xFFFF;
+
+    // Least squares refits for each quality
+    const uint32_t kRefinements[kNumQualities] = { 0, 1, 3 };
+
+    // Mode 1 partitions to encode, out of the best estimates
+    const uint32_t kPartitionsTried[kNumQualities] = { 0, 2, 16 };
+
+    inline float HorizontalSum( __m128 v )
+    {
+        v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(v);
+    }
+
+    inline float Dot( __m128 a, __m128 b )
+    {
+        return HorizontalSum(_mm_mul_ps(a, b));
+    }
+
+    inline __m128 Clamp255( __m128 v )
+    {
+        return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+    }
+
+    void LoadBlock( const uint8_t* Pixels, size_t RowPitch, uint32_t Width, uint32_t Height, uint32_t X, uint32_t Y, Block& B )
+    {
+        const __m128i Zero = _mm_setzero_si128();
+        uint32_t MinAlpha = 255;
+
+        for (uint32_t Row = 0; Row < 4; ++Row)
+        {
+            const uint8_t* Line = Pixels + min(Y + Row, Height - 1) * RowPitch;
+            __m128 Texels[4];
+
+            for (uint32_t Col = 0; Col < 4; ++Col)
+            {
+                const uint8_t* Texel = Line + min(X + Col, Width - 1) * 4;
+                int32_t Packed;
+                memcpy(&Packed, Texel, 4);
+
+                __m128i Bytes = _mm_cvtsi32_si128(Packed);
+                Bytes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(Bytes, Zero), Zero);
+                Texels[Col] = B.Pixels[Row * 4 + Col] = _mm_cvtepi32_ps(Bytes);
+                MinAlpha = min<uint32_t>(MinAlpha, Texel[3]);
+            }
+
+            _MM_TRANSPOSE4_PS(Texels[0], Texels[1], Texels[2], Texels[3]);
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                B.Rows[Channel][Row] = Texels[Channel];
+        }
+
+        B.MinAlpha = MinAlpha;
+    }
+
+    // Picks the closest palette entry for every pixel, four pixels at a time.  Errors receives each pixel's
+    // weighted squared error.
+    void FindClosest( const Block& B, const Color* Palette, uint32_t NumEntries, const float Weights[4],
+        uint8_t Indices[16], float Errors[16] )
+    {
+        uint32_t Channels[4];
+        uint32_t NumChannels = 0;
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            if (Weights[Channel] != 0.0f)
+                Channels[NumChannels++] = Channel;
+        }
+
+        for (uint32_t Row = 0; Row < 4; ++Row)
+        {
+            __m128 BestError = _mm_set1_ps(FLT_MAX);
+            __m128i BestIndex = _mm_setzero_si128();
+
+            for (uint32_t i = 0; i < NumEntries; ++i)
+            {
+                __m128 Error = _mm_setzero_ps();
+                for (uint32_t c = 0; c < NumChannels; ++c)
+                {
+                    const uint32_t Channel = Channels[c];
+                    __m128 Diff = _mm_sub_ps(B.Rows[Channel][Row], _mm_set1_ps(Palette[i][Channel]));
+                    Error = _mm_add_ps(Error, _mm_mul_ps(_mm_mul_ps(Diff, Diff), _mm_set1_ps(Weights[Channel])));
+                }
+
+                __m128i Closer = _mm_castps_si128(_mm_cmplt_ps(Error, BestError));
+                BestError = _mm_min_ps(Error, BestError);
+                BestIndex = _mm_or_si128(_mm_andnot_si128(Closer, BestIndex), _mm_and_si128(Closer, _mm_set1_epi32(i)));
+            }
+
+            _mm_storeu_ps(Errors + Row * 4, BestError);
+
+            // Four 32-bit indices down to four bytes
+            BestIndex = _mm_packs_epi32(BestIndex, BestIndex);
+            const int32_t Packed = _mm_cvtsi128_si32(_mm_packus_epi16(BestIndex, BestIndex));
+            memcpy(Indices + Row * 4, &Packed, 4);
+        }
+    }
+
+    float SumErrors( const float Errors[16], uint32_t Mask )
+    {
+        float Sum = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+                Sum += Errors[i];
+        }
+        return Sum;
+    }
+
+    inline __m128 Transform( const __m128 Matrix[4], __m128 v )
+    {
+        return _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(Matrix[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0))),
+                _mm_mul_ps(Matrix[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)))),
+            _mm_add_ps(_mm_mul_ps(Matrix[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))),
+                _mm_mul_ps(Matrix[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)))));
+    }
+
+    // Finds the principal axis of a covariance matrix by power iteration.  Returns the sum of squared
+    // distances from that axis (the trace less the largest eigenvalue), which is how far the pixels are from
+    // being representable by two endpoints.
+    float PrincipalAxis( const __m128 Covariance[4], __m128& Axis )
+    {
+        float Diagonal[4];
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            float Row[4];
+            _mm_storeu_ps(Row, Covariance[Channel]);
+            Diagonal[Channel] = Row[Channel];
+        }
+
+        const float Trace = Diagonal[0] + Diagonal[1] + Diagonal[2] + Diagonal[3];
+        const uint32_t Largest = (uint32_t)(max_element(Diagonal, Diagonal + 4) - Diagonal);
+
+        Axis = _mm_setzero_ps();
+        if (Trace <= 0.0f)
+            return 0.0f;
+
+        // Start from the row with the most variance
+        __m128 v = Covariance[Largest];
+        for (uint32_t Iteration = 0; Iteration < 3; ++Iteration)
+            v = Transform(Covariance, _mm_mul_ps(v, _mm_set1_ps(1.0f / max(sqrtf(Dot(v, v)), FLT_MIN))));
+
+        const float Length = sqrtf(Dot(v, v));
+        if (Length <= FLT_MIN)
+            return Trace;
+
+        Axis = _mm_div_ps(v, _mm_set1_ps(Length));
+        return max(Trace - Dot(Axis, Transform(Covariance, Axis)), 0.0f);
+    }
+
+    // Fits a line through the pixels in Mask, returning their mean, their principal axis and the sum of their
+    // squared distances from the line
+    float FitLine( const Block& B, uint32_t Mask, const float Weights[4], __m128& Mean, __m128& Axis )
+    {
+        const __m128 ChannelMask = _mm_cmpneq_ps(_mm_loadu_ps(Weights), _mm_setzero_ps());
+
+        __m128 Sum = _mm_setzero_ps();
+        uint32_t Count = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+            {
+                Sum = _mm_add_ps(Sum, B.Pixels[i]);
+                ++Count;
+            }
+        }
+
+        Axis = _mm_setzero_ps();
+        if (Count == 0)
+        {
+            Mean = _mm_setzero_ps();
+            return 0.0f;
+        }
+
+        Mean = _mm_div_ps(Sum, _mm_set1_ps((float)Count));
+
+        // Rows of the covariance matrix
+        __m128 Covariance[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+            {
+                const __m128 d = _mm_and_ps(_mm_sub_ps(B.Pixels[i], Mean), ChannelMask);
+                Covariance[0] = _mm_add_ps(Covariance[0], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(0, 0, 0, 0))));
+                Covariance[1] = _mm_add_ps(Covariance[1], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 1, 1, 1))));
+                Covariance[2] = _mm_add_ps(Covariance[2], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 2, 2, 2))));
+                Covariance[3] = _mm_add_ps(Covariance[3], _mm_mul_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 3, 3, 3))));
+            }
+        }
+
+        return PrincipalAxis(Covariance, Axis);
+    }
+
+    // The color sums and products of color channels that a subset's covariance is built from, for four
+    // partitions at once
+    struct Moments
+    {
+        __m128 Count, R, G, B, RR, GG, BB, RG, RB, GB;
+    };
+
+    // How far from a line each of four subsets is: the trace of its covariance less its largest eigenvalue
+    __m128 EstimateSubsets( const Moments& M )
+    {
+        const __m128 Zero = _mm_setzero_ps();
+        const __m128 InvCount = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), M.Count), _mm_cmpgt_ps(M.Count, Zero));
+
+        // Covariance = sum of products - sum * sum / count
+        const __m128 RR = _mm_sub_ps(M.RR, _mm_mul_ps(_mm_mul_ps(M.R, M.R), InvCount));
+        const __m128 GG = _mm_sub_ps(M.GG, _mm_mul_ps(_mm_mul_ps(M.G, M.G), InvCount));
+        const __m128 BB = _mm_sub_ps(M.BB, _mm_mul_ps(_mm_mul_ps(M.B, M.B), InvCount));
+        const __m128 RG = _mm_sub_ps(M.RG, _mm_mul_ps(_mm_mul_ps(M.R, M.G), InvCount));
+        const __m128 RB = _mm_sub_ps(M.RB, _mm_mul_ps(_mm_mul_ps(M.R, M.B), InvCount));
+        const __m128 GB = _mm_sub_ps(M.GB, _mm_mul_ps(_mm_mul_ps(M.G, M.B), InvCount));
+
+        // Power iteration from the row with the most variance.  Three steps can't overflow, so there is no
+        // need to normalize between them.
+        const __m128 UseR = _mm_and_ps(_mm_cmpge_ps(RR, GG), _mm_cmpge_ps(RR, BB));
+        const __m128 UseG = _mm_andnot_ps(UseR, _mm_cmpge_ps(GG, BB));
+        const __m128 UseB = _mm_andnot_ps(_mm_or_ps(UseR, UseG), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+        __m128 x = _mm_or_ps(_mm_or_ps(_mm_and_ps(UseR, RR), _mm_and_ps(UseG, RG)), _mm_and_ps(UseB, RB));
+        __m128 y = _mm_or_ps(_mm_or_ps(_mm_and_ps(UseR, RG), _mm_and_ps(UseG, GG)), _mm_and_ps(UseB, GB));
+        __m128 z = _mm_or_ps(_mm_or_ps(_mm_and_ps(UseR, RB), _mm_and_ps(UseG, GB)), _mm_and_ps(UseB, BB));
+
+        __m128 cx, cy, cz;
+        for (uint32_t Iteration = 0; Iteration < 4; ++Iteration)
+        {
+            cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(RR, x), _mm_mul_ps(RG, y)), _mm_mul_ps(RB, z));
+            cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(RG, x), _mm_mul_ps(GG, y)), _mm_mul_ps(GB, z));
+            cz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(RB, x), _mm_mul_ps(GB, y)), _mm_mul_ps(BB, z));
+            if (Iteration < 3)
+            {
+                x = cx;
+                y = cy;
+                z = cz;
+            }
+        }
+
+        // The Rayleigh quotient of the last step is the largest eigenvalue
+        const __m128 LengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        const __m128 Projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, cx), _mm_mul_ps(y, cy)), _mm_mul_ps(z, cz));
+        const __m128 Eigenvalue = _mm_and_ps(_mm_div_ps(Projected, LengthSq), _mm_cmpgt_ps(LengthSq, Zero));
+
+        return _mm_max_ps(_mm_sub_ps(_mm_add_ps(_mm_add_ps(RR, GG), BB), Eigenvalue), Zero);
+    }
+
+    // Estimates how far from two lines the RGB of each two subset partition is, four partitions at a time.
+    // Rather than fit each subset from scratch, each partition sums color moments over its second subset and
+    // takes the first subset's as the remainder of the block's totals.
+    void EstimatePartitions( const Block& B, const uint16_t* Partitions, uint32_t NumPartitions, float* Estimates )
+    {
+        ASSERT(NumPartitions % 4 == 0);
+
+        float Pixels[16][4];
+        Moments Totals = {};
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            _mm_storeu_ps(Pixels[i], B.Pixels[i]);
+            const float r = Pixels[i][0], g = Pixels[i][1], b = Pixels[i][2];
+            Totals.RR = _mm_add_ps(Totals.RR, _mm_set1_ps(r * r));
+            Totals.GG = _mm_add_ps(Totals.GG, _mm_set1_ps(g * g));
+            Totals.BB = _mm_add_ps(Totals.BB, _mm_set1_ps(b * b));
+            Totals.RG = _mm_add_ps(Totals.RG, _mm_set1_ps(r * g));
+            Totals.RB = _mm_add_ps(Totals.RB, _mm_set1_ps(r * b));
+            Totals.GB = _mm_add_ps(Totals.GB, _mm_set1_ps(g * b));
+            Totals.R = _mm_add_ps(Totals.R, _mm_set1_ps(r));
+            Totals.G = _mm_add_ps(Totals.G, _mm_set1_ps(g));
+            Totals.B = _mm_add_ps(Totals.B, _mm_set1_ps(b));
+        }
+        Totals.Count = _mm_set1_ps(16.0f);
+
+        for (uint32_t First = 0; First < NumPartitions; First += 4)
+        {
+            const __m128i Masks = _mm_set_epi32(Partitions[First + 3], Partitions[First + 2], Partitions[First + 1], Partitions[First]);
+
+            Moments Second = {};
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const __m128i Bit = _mm_set1_epi32(1 << i);
+                const __m128 In = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(Masks, Bit), Bit));
+                const float r = Pixels[i][0], g = Pixels[i][1], b = Pixels[i][2];
+
+                Second.Count = _mm_add_ps(Second.Count, _mm_and_ps(In, _mm_set1_ps(1.0f)));
+                Second.R = _mm_add_ps(Second.R, _mm_and_ps(In, _mm_set1_ps(r)));
+                Second.G = _mm_add_ps(Second.G, _mm_and_ps(In, _mm_set1_ps(g)));
+                Second.B = _mm_add_ps(Second.B, _mm_and_ps(In, _mm_set1_ps(b)));
+                Second.RR = _mm_add_ps(Second.RR, _mm_and_ps(In, _mm_set1_ps(r * r)));
+                Second.GG = _mm_add_ps(Second.GG, _mm_and_ps(In, _mm_set1_ps(g * g)));
+                Second.BB = _mm_add_ps(Second.BB, _mm_and_ps(In, _mm_set1_ps(b * b)));
+                Second.RG = _mm_add_ps(Second.RG, _mm_and_ps(In, _mm_set1_ps(r * g)));
+                Second.RB = _mm_add_ps(Second.RB, _mm_and_ps(In, _mm_set1_ps(r * b)));
+                Second.GB = _mm_add_ps(Second.GB, _mm_and_ps(In, _mm_set1_ps(g * b)));
+            }
+
+            Moments First_;
+            First_.Count = _mm_sub_ps(Totals.Count, Second.Count);
+            First_.R = _mm_sub_ps(Totals.R, Second.R);
+            First_.G = _mm_sub_ps(Totals.G, Second.G);
+            First_.B = _mm_sub_ps(Totals.B, Second.B);
+            First_.RR = _mm_sub_ps(Totals.RR, Second.RR);
+            First_.GG = _mm_sub_ps(Totals.GG, Second.GG);
+            First_.BB = _mm_sub_ps(Totals.BB, Second.BB);
+            First_.RG = _mm_sub_ps(Totals.RG, Second.RG);
+            First_.RB = _mm_sub_ps(Totals.RB, Second.RB);
+            First_.GB = _mm_sub_ps(Totals.GB, Second.GB);
+
+            _mm_storeu_ps(Estimates + First, _mm_add_ps(EstimateSubsets(First_), EstimateSubsets(Second)));
+        }
+    }
+
+    // Endpoints at the extent of the pixels in Mask along the axis
+    void LineEndpoints( const Block& B, uint32_t Mask, __m128 Mean, __m128 Axis, Color E0, Color E1 )
+    {
+        float MinT = 0.0f, MaxT = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+            {
+                const float t = Dot(_mm_sub_ps(B.Pixels[i], Mean), Axis);
+                MinT = min(MinT, t);
+                MaxT = max(MaxT, t);
+            }
+        }
+
+        _mm_storeu_ps(E0, Clamp255(_mm_add_ps(Mean, _mm_mul_ps(Axis, _mm_set1_ps(MinT)))));
+        _mm_storeu_ps(E1, Clamp255(_mm_add_ps(Mean, _mm_mul_ps(Axis, _mm_set1_ps(MaxT)))));
+    }
+
+    // Least squares endpoints for the pixels in Mask, given how far each is from E0 toward E1.  Returns false
+    // if they don't determine two endpoints.
+    bool RefineEndpoints( const Block& B, uint32_t Mask, const float Lerp[16], Color E0, Color E1 )
+    {
+        float AA = 0.0f, AB = 0.0f, BB = 0.0f;
+        __m128 SumA = _mm_setzero_ps();
+        __m128 SumB = _mm_setzero_ps();
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if (Mask & (1 << i))
+            {
+                const float b = Lerp[i];
+                const float a = 1.0f - b;
+                AA += a * a;
+                AB += a * b;
+                BB += b * b;
+                SumA = _mm_add_ps(SumA, _mm_mul_ps(B.Pixels[i], _mm_set1_ps(a)));
+                SumB = _mm_add_ps(SumB, _mm_mul_ps(B.Pixels[i], _mm_set1_ps(b)));
+            }
+        }
+
+        const float Determinant = AA * BB - AB * AB;
+        if (fabsf(Determinant) < 1e-6f)
+            return false;
+
+        const __m128 Scale = _mm_set1_ps(1.0f / Determinant);
+        _mm_storeu_ps(E0, Clamp255(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(SumA, _mm_set1_ps(BB)), _mm_mul_ps(SumB, _mm_set1_ps(AB))), Scale)));
+        _mm_storeu_ps(E1, Clamp255(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(SumB, _mm_set1_ps(AA)), _mm_mul_ps(SumA, _mm_set1_ps(AB))), Scale)));
+        return true;
+    }
+
+    inline void WriteBits( uint8_t* Dest, uint32_t& Offset, uint32_t Value, uint32_t NumBits )
+    {
+        for (uint32_t i = 0; i < NumBits; ++i, ++Offset)
+            Dest[Offset >> 3] |= ((Value >> i) & 1) << (Offset & 7);
+    }
+
+    inline uint32_t ReadBits( const uint8_t* Src, uint32_t& Offset, uint32_t NumBits )
+    {
+        uint32_t Value = 0;
+        for (uint32_t i = 0; i < NumBits; ++i, ++Offset)
+            Value |= ((Src[Offset >> 3] >> (Offset & 7)) & 1) << i;
+        return Value;
+    }
+
+    //
+    // BC1 (and the color half of BC3)
+    //
+
+    uint16_t QuantizeRGB565( const Color C )
+    {
+        const uint32_t R = (uint32_t)(C[0] * 31.0f / 255.0f + 0.5f);
+        const uint32_t G = (uint32_t)(C[1] * 63.0f / 255.0f + 0.5f);
+        const uint32_t B = (uint32_t)(C[2] * 31.0f / 255.0f + 0.5f);
+        return (uint16_t)(R << 11 | G << 5 | B);
+    }
+
+    void ExpandRGB565( uint16_t C, int32_t Out[3] )
+    {
+        const int32_t R = C >> 11, G = (C >> 5) & 63, B = C & 31;
+        Out[0] = R << 3 | R >> 2;
+        Out[1] = G << 2 | G >> 4;
+        Out[2] = B << 3 | B >> 2;
+    }
+
+    // BC1 uses three colors and transparent black when Color0 <= Color1.  BC3 always uses four colors.
+    void BuildColorPalette( uint16_t Color0, uint16_t Color1, bool FourColors, Color Palette[4] )
+    {
+        int32_t C0[3], C1[3];
+        ExpandRGB565(Color0, C0);
+        ExpandRGB565(Color1, C1);
+
+        for (uint32_t Channel = 0; Channel < 3; ++Channel)
+        {
+            Palette[0][Channel] = (float)C0[Channel];
+            Palette[1][Channel] = (float)C1[Channel];
+            if (FourColors)
+            {
+                Palette[2][Channel] = (float)((2 * C0[Channel] + C1[Channel]) / 3);
+                Palette[3][Channel] = (float)((C0[Channel] + 2 * C1[Channel]) / 3);
+            }
+            else
+            {
+                Palette[2][Channel] = (float)((C0[Channel] + C1[Channel]) / 2);
+                Palette[3][Channel] = 0.0f;
+            }
+        }
+
+        Palette[0][3] = Palette[1][3] = Palette[2][3] = 255.0f;
+        Palette[3][3] = FourColors ? 255.0f : 0.0f;
+    }
+
+    struct ColorBlock
+    {
+        uint16_t Color0;
+        uint16_t Color1;
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    // Quantizes the endpoints and picks indices.  ThreeColors selects BC1's three color mode, in which the
+    // pixels outside Mask are transparent.
+    void TryColorEndpoints( const Block& B, const Color E0, const Color E1, bool ThreeColors, bool AlwaysFourColors,
+        uint32_t Mask, ColorBlock& Best )
+    {
+        ColorBlock Candidate;
+        Candidate.Color0 = QuantizeRGB565(E0);
+        Candidate.Color1 = QuantizeRGB565(E1);
+
+        // The order of the colors selects the mode
+        if ((Candidate.Color0 < Candidate.Color1) != ThreeColors)
+            swap(Candidate.Color0, Candidate.Color1);
+
+        const bool FourColors = AlwaysFourColors || Candidate.Color0 > Candidate.Color1;
+
+        Color Palette[4];
+        BuildColorPalette(Candidate.Color0, Candidate.Color1, FourColors, Palette);
+
+        float Errors[16];
+        FindClosest(B, Palette, FourColors ? 4 : 3, kRGBWeights, Candidate.Indices, Errors);
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            if ((Mask & (1 << i)) == 0)
+                Candidate.Indices[i] = 3;
+        }
+
+        Candidate.Error = SumErrors(Errors, Mask);
+        if (Candidate.Error < Best.Error)
+            Best = Candidate;
+    }
+
+    void EncodeColorBlock( const Block& B, Quality Qual, bool AllowTransparency, uint8_t* Dest )
+    {
+        // BC1 can only make pixels transparent in its three color mode
+        const bool Transparent = AllowTransparency && B.MinAlpha < 128;
+
+        uint32_t Mask = kAllPixels;
+        if (Transparent)
+        {
+            Mask = 0;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                if (_mm_cvtss_f32(_mm_shuffle_ps(B.Pixels[i], B.Pixels[i], _MM_SHUFFLE(3, 3, 3, 3))) >= 128.0f)
+                    Mask |= 1 << i;
+            }
+        }
+
+        ColorBlock Best;
+        Best.Error = FLT_MAX;
+
+        __m128 Mean, Axis;
+        Color E0, E1;
+        FitLine(B, Mask, kRGBWeights, Mean, Axis);
+        LineEndpoints(B, Mask, Mean, Axis, E0, E1);
+
+        const bool AlwaysFourColors = !AllowTransparency;
+        TryColorEndpoints(B, E0, E1, Transparent, AlwaysFourColors, Mask, Best);
+        if (Qual == kHigh && AllowTransparency && !Transparent)
+            TryColorEndpoints(B, E0, E1, true, false, Mask, Best);
+
+        for (uint32_t Iteration = 0; Iteration < kRefinements[Qual]; ++Iteration)
+        {
+            const bool FourColors = AlwaysFourColors || Best.Color0 > Best.Color1;
+
+            // Which palette entries are how far along from Color0 to Color1
+            static const float kFourColorLerp[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+            static const float kThreeColorLerp[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+            float Lerp[16];
+            uint32_t FitMask = Mask;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                Lerp[i] = FourColors ? kFourColorLerp[Best.Indices[i]] : kThreeColorLerp[Best.Indices[i]];
+                if (!FourColors && Best.Indices[i] == 3)
+                    FitMask &= ~(1 << i);
+            }
+
+            if (!RefineEndpoints(B, FitMask, Lerp, E0, E1))
+                break;
+
+            TryColorEndpoints(B, E0, E1, !FourColors, AlwaysFourColors, Mask, Best);
+        }
+
+        uint32_t IndexBits = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+            IndexBits |= Best.Indices[i] << (i * 2);
+
+        memcpy(Dest, &Best.Color0, 2);
+        memcpy(Dest + 2, &Best.Color1, 2);
+        memcpy(Dest + 4, &IndexBits, 4);
+    }
+
+    void DecodeColorBlock( const uint8_t* Src, bool AlwaysFourColors, uint8_t Out[16][4] )
+    {
+        uint16_t Color0, Color1;
+        uint32_t IndexBits;
+        memcpy(&Color0, Src, 2);
+        memcpy(&Color1, Src + 2, 2);
+        memcpy(&IndexBits, Src + 4, 4);
+
+        Color Palette[4];
+        BuildColorPalette(Color0, Color1, AlwaysFourColors || Color0 > Color1, Palette);
+
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            const uint32_t Index = (IndexBits >> (i * 2)) & 3;
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                Out[i][Channel] = (uint8_t)Palette[Index][Channel];
+        }
+    }
+
+    //
+    // BC4 channels (the alpha half of BC3 and both halves of BC5)
+    //
+
+    // Eight values when Value0 > Value1, otherwise six and 0 and 255
+    void BuildChannelPalette( uint32_t Value0, uint32_t Value1, uint32_t Channel, Color Palette[8] )
+    {
+        memset(Palette, 0, sizeof(Color) * 8);
+
+        Palette[0][Channel] = (float)Value0;
+        Palette[1][Channel] = (float)Value1;
+
+        if (Value0 > Value1)
+        {
+            for (uint32_t i = 1; i < 7; ++i)
+                Palette[i + 1][Channel] = (float)(((7 - i) * Value0 + i * Value1) / 7);
+        }
+        else
+        {
+            for (uint32_t i = 1; i < 5; ++i)
+                Palette[i + 1][Channel] = (float)(((5 - i) * Value0 + i * Value1) / 5);
+            Palette[6][Channel] = 0.0f;
+            Palette[7][Channel] = 255.0f;
+        }
+    }
+
+    struct ChannelBlock
+    {
+        uint8_t Value0;
+        uint8_t Value1;
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    void TryChannelEndpoints( const Block& B, uint32_t Channel, float Low, float High, bool SixValues, ChannelBlock& Best )
+    {
+        ChannelBlock Candidate;
+        uint32_t Value0 = (uint32_t)(min(max(Low, 0.0f), 255.0f) + 0.5f);
+        uint32_t Value1 = (uint32_t)(min(max(High, 0.0f), 255.0f) + 0.5f);
+        if ((Value0 <= Value1) != SixValues)
+            swap(Value0, Value1);
+
+        Candidate.Value0 = (uint8_t)Value0;
+        Candidate.Value1 = (uint8_t)Value1;
+
+        Color Palette[8];
+        BuildChannelPalette(Value0, Value1, Channel, Palette);
+
+        float Errors[16];
+        FindClosest(B, Palette, 8, kChannelWeights[Channel], Candidate.Indices, Errors);
+
+        Candidate.Error = SumErrors(Errors, kAllPixels);
+        if (Candidate.Error < Best.Error)
+            Best = Candidate;
+    }
+
+    void EncodeChannelBlock( const Block& B, uint32_t Channel, Quality Qual, uint8_t* Dest )
+    {
+        float Values[16];
+        _mm_storeu_ps(Values, B.Rows[Channel][0]);
+        _mm_storeu_ps(Values + 4, B.Rows[Channel][1]);
+        _mm_storeu_ps(Values + 8, B.Rows[Channel][2]);
+        _mm_storeu_ps(Values + 12, B.Rows[Channel][3]);
+
+        float Low = 255.0f, High = 0.0f;
+        float InnerLow = 255.0f, InnerHigh = 0.0f;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            Low = min(Low, Values[i]);
+            High = max(High, Values[i]);
+            if (Values[i] > 0.0f && Values[i] < 255.0f)
+            {
+                InnerLow = min(InnerLow, Values[i]);
+                InnerHigh = max(InnerHigh, Values[i]);
+            }
+        }
+
+        ChannelBlock Best;
+        Best.Error = FLT_MAX;
+
+        TryChannelEndpoints(B, Channel, Low, High, false, Best);
+
+        // The six value mode spends two values on 0 and 255, so it can span what is left more finely
+        if (Qual == kHigh && InnerLow <= InnerHigh)
+            TryChannelEndpoints(B, Channel, InnerLow, InnerHigh, true, Best);
+
+        for (uint32_t Iteration = 0; Iteration < kRefinements[Qual] && Best.Error > 0.0f; ++Iteration)
+        {
+            const bool EightValues = Best.Value0 > Best.Value1;
+
+            float Lerp[16];
+            uint32_t FitMask = kAllPixels;
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t Index = Best.Indices[i];
+                if (Index < 2)
+                    Lerp[i] = (float)Index;
+                else if (EightValues)
+                    Lerp[i] = (Index - 1) / 7.0f;
+                else if (Index < 6)
+                    Lerp[i] = (Index - 1) / 5.0f;
+                else
+                    FitMask &= ~(1 << i);
+            }
+
+            Color E0, E1;
+            if (!RefineEndpoints(B, FitMask, Lerp, E0, E1))
+                break;
+
+            TryChannelEndpoints(B, Channel, E0[Channel], E1[Channel], !EightValues, Best);
+        }
+
+        Dest[0] = Best.Value0;
+        Dest[1] = Best.Value1;
+        uint64_t IndexBits = 0;
+        for (uint32_t i = 0; i < 16; ++i)
+            IndexBits |= (uint64_t)Best.Indices[i] << (i * 3);
+        for (uint32_t i = 0; i < 6; ++i)
+            Dest[2 + i] = (uint8_t)(IndexBits >> (i * 8));
+    }
+
+    void DecodeChannelBlock( const uint8_t* Src, uint32_t Channel, uint8_t Out[16][4] )
+    {
+        Color Palette[8];
+        BuildChannelPalette(Src[0], Src[1], Channel, Palette);
+
+        uint64_t IndexBits = 0;
+        for (uint32_t i = 0; i < 6; ++i)
+            IndexBits |= (uint64_t)Src[2 + i] << (i * 8);
+
+        for (uint32_t i = 0; i < 16; ++i)
+            Out[i][Channel] = (uint8_t)Palette[(IndexBits >> (i * 3)) & 7][Channel];
+    }
+
+    //
+    // BC7 modes 1 and 6
+    //
+
+    const uint32_t kWeights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+    const uint32_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // Which pixels are in the second subset of each two subset partition, and the anchor pixel of that subset
+    const uint16_t kPartitions2[64] =
+    {
+        0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+        0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+        0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+        0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+        0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+        0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+        0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+        0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+    };
+
+    const uint8_t kAnchors2[64] =
+    {
+        15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+        15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+        15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+         6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+    };
+
+    inline uint32_t Interpolate( uint32_t E0, uint32_t E1, uint32_t Weight )
+    {
+        return ((64 - Weight) * E0 + Weight * E1 + 32) >> 6;
+    }
+
+    // Mode 6: one subset of RGBA endpoints with 7 bits per channel and a p-bit (the shared low bit) each,
+    // and 4-bit indices
+    struct Mode6Block
+    {
+        uint8_t Endpoints[2][4];    // 8-bit values, the low bit being the p-bit
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    // Rounds an endpoint to 7 bits and the given p-bit
+    void QuantizeWithPBit( const Color E, uint32_t PBit, uint8_t Out[4] )
+    {
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            const int32_t q = min(max((int32_t)((E[Channel] - PBit) * 0.5f + 0.5f), 0), 127);
+            Out[Channel] = (uint8_t)(q << 1 | PBit);
+        }
+    }
+
+    float QuantizationError( const Color E, const uint8_t Q[4] )
+    {
+        float Error = 0.0f;
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            Error += (E[Channel] - Q[Channel]) * (E[Channel] - Q[Channel]);
+        return Error;
+    }
+
+    void TryMode6( const Block& B, const Color E0, const Color E1, bool SearchPBits, Mode6Block& Best )
+    {
+        uint8_t Quantized[2][2][4];
+        for (uint32_t PBit = 0; PBit < 2; ++PBit)
+        {
+            QuantizeWithPBit(E0, PBit, Quantized[0][PBit]);
+            QuantizeWithPBit(E1, PBit, Quantized[1][PBit]);
+        }
+
+        // Opaque blocks keep both p-bits set so that alpha stays exactly 255.  Otherwise each endpoint gets
+        // whichever p-bit rounds it best, or every combination is tried.
+        uint32_t Combinations[4] = { 3 };
+        uint32_t NumCombinations = 1;
+        if (B.MinAlpha < 255)
+        {
+            if (SearchPBits)
+            {
+                NumCombinations = 4;
+                for (uint32_t i = 0; i < 4; ++i)
+                    Combinations[i] = i;
+            }
+            else
+            {
+                Combinations[0] =
+                    (QuantizationError(E0, Quantized[0][1]) < QuantizationError(E0, Quantized[0][0]) ? 1 : 0) |
+                    (QuantizationError(E1, Quantized[1][1]) < QuantizationError(E1, Quantized[1][0]) ? 2 : 0);
+            }
+        }
+
+        for (uint32_t i = 0; i < NumCombinations; ++i)
+        {
+            Mode6Block Candidate;
+            memcpy(Candidate.Endpoints[0], Quantized[0][Combinations[i] & 1], 4);
+            memcpy(Candidate.Endpoints[1], Quantized[1][Combinations[i] >> 1], 4);
+
+            Color Palette[16];
+            for (uint32_t j = 0; j < 16; ++j)
+            {
+                for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                    Palette[j][Channel] = (float)Interpolate(Candidate.Endpoints[0][Channel], Candidate.Endpoints[1][Channel], kWeights4[j]);
+            }
+
+            float Errors[16];
+            FindClosest(B, Palette, 16, kRGBAWeights, Candidate.Indices, Errors);
+            Candidate.Error = SumErrors(Errors, kAllPixels);
+            if (Candidate.Error < Best.Error)
+                Best = Candidate;
+        }
+    }
+
+    void EncodeMode6( const Block& B, Quality Qual, Mode6Block& Best )
+    {
+        __m128 Mean, Axis;
+        Color E0, E1;
+        FitLine(B, kAllPixels, kRGBAWeights, Mean, Axis);
+        LineEndpoints(B, kAllPixels, Mean, Axis, E0, E1);
+
+        const bool SearchPBits = Qual == kHigh;
+        TryMode6(B, E0, E1, SearchPBits, Best);
+
+        for (uint32_t Iteration = 0; Iteration < kRefinements[Qual] && Best.Error > 0.0f; ++Iteration)
+        {
+            float Lerp[16];
+            for (uint32_t i = 0; i < 16; ++i)
+                Lerp[i] = kWeights4[Best.Indices[i]] / 64.0f;
+
+            if (!RefineEndpoints(B, kAllPixels, Lerp, E0, E1))
+                break;
+
+            TryMode6(B, E0, E1, SearchPBits, Best);
+        }
+    }
+
+    void WriteMode6( Mode6Block& M, uint8_t* Dest )
+    {
+        // The anchor index's high bit is implicitly 0
+        if (M.Indices[0] >= 8)
+        {
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                swap(M.Endpoints[0][Channel], M.Endpoints[1][Channel]);
+            for (uint32_t i = 0; i < 16; ++i)
+                M.Indices[i] = 15 - M.Indices[i];
+        }
+
+        memset(Dest, 0, 16);
+        uint32_t Offset = 0;
+        WriteBits(Dest, Offset, 1 << 6, 7);
+        for (uint32_t Channel = 0; Channel < 4; ++Channel)
+        {
+            WriteBits(Dest, Offset, M.Endpoints[0][Channel] >> 1, 7);
+            WriteBits(Dest, Offset, M.Endpoints[1][Channel] >> 1, 7);
+        }
+        WriteBits(Dest, Offset, M.Endpoints[0][0] & 1, 1);
+        WriteBits(Dest, Offset, M.Endpoints[1][0] & 1, 1);
+        for (uint32_t i = 0; i < 16; ++i)
+            WriteBits(Dest, Offset, M.Indices[i], i == 0 ? 3 : 4);
+    }
+
+    // Mode 1: two subsets of RGB endpoints with 6 bits per channel and a p-bit per subset, and 3-bit indices
+    struct Mode1Block
+    {
+        uint32_t Partition;
+        uint8_t Endpoints[2][2][3];     // [Subset][Endpoint][Channel], as 8-bit values
+        uint8_t PBits[2];
+        uint8_t Indices[16];
+        float Error;
+    };
+
+    inline uint8_t ExpandMode1( uint32_t q, uint32_t PBit )
+    {
+        const uint32_t Value = q << 1 | PBit;
+        return (uint8_t)(Value << 1 | Value >> 6);
+    }
+
+    // Finds the indices for one subset, and its p-bit: whichever rounds the endpoints best, or whichever
+    // gives the least error when searching
+    float TryMode1Subset( const Block& B, uint32_t Mask, const Color E0, const Color E1, bool SearchPBits,
+        Mode1Block& M, uint32_t Subset )
+    {
+        uint8_t Quantized[2][2][3];
+        float RoundingError[2] = { 0.0f, 0.0f };
+        for (uint32_t PBit = 0; PBit < 2; ++PBit)
+        {
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                Quantized[PBit][0][Channel] = ExpandMode1(min(max((int32_t)((E0[Channel] * 0.5f - PBit) * 0.5f + 0.5f), 0), 63), PBit);
+                Quantized[PBit][1][Channel] = ExpandMode1(min(max((int32_t)((E1[Channel] * 0.5f - PBit) * 0.5f + 0.5f), 0), 63), PBit);
+                RoundingError[PBit] += (E0[Channel] - Quantized[PBit][0][Channel]) * (E0[Channel] - Quantized[PBit][0][Channel]);
+                RoundingError[PBit] += (E1[Channel] - Quantized[PBit][1][Channel]) * (E1[Channel] - Quantized[PBit][1][Channel]);
+            }
+        }
+
+        const uint32_t FirstPBit = SearchPBits ? 0 : (RoundingError[1] < RoundingError[0] ? 1 : 0);
+        const uint32_t LastPBit = SearchPBits ? 1 : FirstPBit;
+
+        float BestError = FLT_MAX;
+        for (uint32_t PBit = FirstPBit; PBit <= LastPBit; ++PBit)
+        {
+            Color Palette[8];
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                    Palette[i][Channel] = (float)Interpolate(Quantized[PBit][0][Channel], Quantized[PBit][1][Channel], kWeights3[i]);
+                Palette[i][3] = 255.0f;
+            }
+
+            uint8_t Indices[16];
+            float Errors[16];
+            FindClosest(B, Palette, 8, kRGBWeights, Indices, Errors);
+
+            const float Error = SumErrors(Errors, Mask);
+            if (Error < BestError)
+            {
+                BestError = Error;
+                memcpy(M.Endpoints[Subset], Quantized[PBit], sizeof(Quantized[PBit]));
+                M.PBits[Subset] = (uint8_t)PBit;
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    if (Mask & (1 << i))
+                        M.Indices[i] = Indices[i];
+                }
+            }
+        }
+
+        return BestError;
+    }
+
+    void EncodeMode1( const Block& B, Quality Qual, uint32_t Partition, Mode1Block& Best )
+    {
+        const uint32_t Masks[2] = { kAllPixels & ~kPartitions2[Partition], kPartitions2[Partition] };
+
+        // Indices are filled in a subset at a time
+        Mode1Block Candidate = {};
+        Candidate.Partition = Partition;
+        Candidate.Error = 0.0f;
+
+        for (uint32_t Subset = 0; Subset < 2; ++Subset)
+        {
+            __m128 Mean, Axis;
+            Color E0, E1;
+            FitLine(B, Masks[Subset], kRGBWeights, Mean, Axis);
+            LineEndpoints(B, Masks[Subset], Mean, Axis, E0, E1);
+
+            float Error = TryMode1Subset(B, Masks[Subset], E0, E1, Qual == kHigh, Candidate, Subset);
+
+            for (uint32_t Iteration = 0; Iteration < kRefinements[Qual] && Error > 0.0f; ++Iteration)
+            {
+                // Only this subset's pixels have indices yet, and only they are fit
+                float Lerp[16] = {};
+                for (uint32_t i = 0; i < 16; ++i)
+                {
+                    if (Masks[Subset] & (1 << i))
+                        Lerp[i] = kWeights3[Candidate.Indices[i]] / 64.0f;
+                }
+
+                if (!RefineEndpoints(B, Masks[Subset], Lerp, E0, E1))
+                    break;
+
+                Mode1Block Refined = Candidate;
+                const float RefinedError = TryMode1Subset(B, Masks[Subset], E0, E1, Qual == kHigh, Refined, Subset);
+                if (RefinedError >= Error)
+                    break;
+
+                Candidate = Refined;
+                Error = RefinedError;
+            }
+
+            Candidate.Error += Error;
+        }
+
+        if (Candidate.Error < Best.Error)
+            Best = Candidate;
+    }
+
+    void WriteMode1( Mode1Block& M, uint8_t* Dest )
+    {
+        const uint32_t Partition = M.Partition;
+
+        for (uint32_t Subset = 0; Subset < 2; ++Subset)
+        {
+            const uint32_t Anchor = Subset == 0 ? 0 : kAnchors2[Partition];
+            if (M.Indices[Anchor] < 4)
+                continue;
+
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                swap(M.Endpoints[Subset][0][Channel], M.Endpoints[Subset][1][Channel]);
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                if (((kPartitions2[Partition] >> i) & 1) == Subset)
+                    M.Indices[i] = 7 - M.Indices[i];
+            }
+        }
+
+        memset(Dest, 0, 16);
+        uint32_t Offset = 0;
+        WriteBits(Dest, Offset, 1 << 1, 2);
+        WriteBits(Dest, Offset, Partition, 6);
+        for (uint32_t Channel = 0; Channel < 3; ++Channel)
+        {
+            for (uint32_t Subset = 0; Subset < 2; ++Subset)
+            {
+                WriteBits(Dest, Offset, M.Endpoints[Subset][0][Channel] >> 2, 6);
+                WriteBits(Dest, Offset, M.Endpoints[Subset][1][Channel] >> 2, 6);
+            }
+        }
+        WriteBits(Dest, Offset, M.PBits[0], 1);
+        WriteBits(Dest, Offset, M.PBits[1], 1);
+        for (uint32_t i = 0; i < 16; ++i)
+            WriteBits(Dest, Offset, M.Indices[i], i == 0 || i == kAnchors2[Partition] ? 2 : 3);
+    }
+
+    void EncodeBC7Block( const Block& B, Quality Qual, uint8_t* Dest )
+    {
+        Mode6Block Mode6;
+        Mode6.Error = FLT_MAX;
+        EncodeMode6(B, Qual, Mode6);
+
+        // Mode 1 has no alpha, and only helps blocks that don't lie along one line
+        const uint32_t NumPartitions = kPartitionsTried[Qual];
+        if (NumPartitions == 0 || B.MinAlpha < 255 || Mode6.Error == 0.0f)
+        {
+            WriteMode6(Mode6, Dest);
+            return;
+        }
+
+        // Estimate every partition by how far its subsets are from lines, and encode the best few
+        float Errors[64];
+        EstimatePartitions(B, kPartitions2, 64, Errors);
+
+        pair<float, uint32_t> Estimates[64];
+        for (uint32_t Partition = 0; Partition < 64; ++Partition)
+            Estimates[Partition] = make_pair(Errors[Partition], Partition);
+        partial_sort(Estimates, Estimates + NumPartitions, Estimates + 64);
+
+        // Zeroed, so that nothing is left uninitialized when no partition is encoded
+        Mode1Block Mode1 = {};
+        Mode1.Error = FLT_MAX;
+        for (uint32_t i = 0; i < NumPartitions; ++i)
+            EncodeMode1(B, Qual, Estimates[i].second, Mode1);
+
+        if (Mode1.Error < Mode6.Error)
+            WriteMode1(Mode1, Dest);
+        else
+            WriteMode6(Mode6, Dest);
+    }
+
+    void DecodeBC7Block( const uint8_t* Src, uint8_t Out[16][4] )
+    {
+        uint32_t Offset = 0;
+
+        if (Src[0] & 1)
+        {
+            // Mode 0, which isn't written
+        }
+        else if (Src[0] & 2)
+        {
+            Offset = 2;
+            const uint32_t Partition = ReadBits(Src, Offset, 6);
+
+            uint32_t Endpoints[2][2][3];
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                for (uint32_t Subset = 0; Subset < 2; ++Subset)
+                {
+                    Endpoints[Subset][0][Channel] = ReadBits(Src, Offset, 6);
+                    Endpoints[Subset][1][Channel] = ReadBits(Src, Offset, 6);
+                }
+            }
+
+            for (uint32_t Subset = 0; Subset < 2; ++Subset)
+            {
+                const uint32_t PBit = ReadBits(Src, Offset, 1);
+                for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                {
+                    Endpoints[Subset][0][Channel] = ExpandMode1(Endpoints[Subset][0][Channel], PBit);
+                    Endpoints[Subset][1][Channel] = ExpandMode1(Endpoints[Subset][1][Channel], PBit);
+                }
+            }
+
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t Index = ReadBits(Src, Offset, i == 0 || i == kAnchors2[Partition] ? 2 : 3);
+                const uint32_t Subset = (kPartitions2[Partition] >> i) & 1;
+                for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                    Out[i][Channel] = (uint8_t)Interpolate(Endpoints[Subset][0][Channel], Endpoints[Subset][1][Channel], kWeights3[Index]);
+                Out[i][3] = 255;
+            }
+            return;
+        }
+        else if ((Src[0] & 0x7F) == 0x40)
+        {
+            Offset = 7;
+
+            uint32_t Endpoints[2][4];
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            {
+                Endpoints[0][Channel] = ReadBits(Src, Offset, 7) << 1;
+                Endpoints[1][Channel] = ReadBits(Src, Offset, 7) << 1;
+            }
+
+            const uint32_t P0 = ReadBits(Src, Offset, 1);
+            const uint32_t P1 = ReadBits(Src, Offset, 1);
+            for (uint32_t Channel = 0; Channel < 4; ++Channel)
+            {
+                Endpoints[0][Channel] |= P0;
+                Endpoints[1][Channel] |= P1;
+            }
+
+            for (uint32_t i = 0; i < 16; ++i)
+            {
+                const uint32_t Index = ReadBits(Src, Offset, i == 0 ? 3 : 4);
+                for (uint32_t Channel = 0; Channel < 4; ++Channel)
+                    Out[i][Channel] = (uint8_t)Interpolate(Endpoints[0][Channel], Endpoints[1][Channel], kWeights4[Index]);
+            }
+            return;
+        }
+
+        memset(Out, 0, 64);
+    }
+
+    void EncodeBlock( Format Fmt, Quality Qual, const Block& B, uint8_t* Dest )
+    {
+        switch (Fmt)
+        {
+        case kBC1:
+            EncodeColorBlock(B, Qual, true, Dest);
+            break;
+        case kBC3:
+            EncodeChannelBlock(B, 3, Qual, Dest);
+            EncodeColorBlock(B, Qual, false, Dest + 8);
+            break;
+        case kBC5:
+            EncodeChannelBlock(B, 0, Qual, Dest);
+            EncodeChannelBlock(B, 1, Qual, Dest + 8);
+            break;
+        case kBC7:
+            EncodeBC7Block(B, Qual, Dest);
+            break;
+        default:
+            ASSERT(false, "Unknown block compression format");
+        }
+    }
+
+    void DecodeBlock( Format Fmt, const uint8_t* Src, uint8_t Out[16][4] )
+    {
+        switch (Fmt)
+        {
+        case kBC1:
+            DecodeColorBlock(Src, false, Out);
+            break;
+        case kBC3:
+            DecodeColorBlock(Src + 8, true, Out);
+            DecodeChannelBlock(Src, 3, Out);
+            break;
+        case kBC5:
+            memset(Out, 0, 64);
+            DecodeChannelBlock(Src, 0, Out);
+            DecodeChannelBlock(Src + 8, 1, Out);
+            for (uint32_t i = 0; i < 16; ++i)
+                Out[i][3] = 255;
+            break;
+        case kBC7:
+            DecodeBC7Block(Src, Out);
+            break;
+        default:
+            ASSERT(false, "Unknown block compression format");
+        }
+    }
+}
+
+const char* BlockCompression::GetFormatName( Format Fmt )
+{
+    static const char* kNames[kNumFormats] = { "BC1", "BC3", "BC5", "BC7" };
+    return kNames[Fmt];
+}
+
+const char* BlockCompression::GetQualityName( Quality Qual )
+{
+    static const char* kNames[kNumQualities] = { "Fast", "Normal", "High" };
+    return kNames[Qual];
+}
+
+DXGI_FORMAT BlockCompression::GetDXGIFormat( Format Fmt, bool sRGB )
+{
+    switch (Fmt)
+    {
+    case kBC1: return sRGB ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+    case kBC3: return sRGB ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+    case kBC5: return DXGI_FORMAT_BC5_UNORM;
+    case kBC7: return sRGB ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+    default: return DXGI_FORMAT_UNKNOWN;
+    }
+}
+
+size_t BlockCompression::GetBlockSize( Format Fmt )
+{
+    return Fmt == kBC1 ? 8 : 16;
+}
+
+size_t BlockCompression::GetCompressedSize( Format Fmt, uint32_t Width, uint32_t Height )
+{
+    return (size_t)((Width + 3) / 4) * ((Height + 3) / 4) * GetBlockSize(Fmt);
+}
+
+void BlockCompression::Compress( Format Fmt, Quality Qual, const uint8_t* Pixels, size_t RowPitch, uint32_t Width,
+    uint32_t Height, void* Dest, bool Multithreaded )
+{
+    const uint32_t BlocksWide = (Width + 3) / 4;
+    const uint32_t BlocksHigh = (Height + 3) / 4;
+    const size_t BlockSize = GetBlockSize(Fmt);
+
+    auto CompressRow = [&]( uint32_t BlockY )
+    {
+        uint8_t* Out = (uint8_t*)Dest + BlockY * BlocksWide * BlockSize;
+        for (uint32_t BlockX = 0; BlockX < BlocksWide; ++BlockX, Out += BlockSize)
+        {
+            Block B;
+            LoadBlock(Pixels, RowPitch, Width, Height, BlockX * 4, BlockY * 4, B);
+            EncodeBlock(Fmt, Qual, B, Out);
+        }
+    };
+
+    if (Multithreaded && BlocksHigh > 1)
+        concurrency::parallel_for(0u, BlocksHigh, CompressRow);
+    else
+    {
+        for (uint32_t BlockY = 0; BlockY < BlocksHigh; ++BlockY)
+            CompressRow(BlockY);
+    }
+}
+
+void BlockCompression::Decompress( Format Fmt, const void* Blocks, uint32_t Width, uint32_t Height, uint8_t* Pixels, size_t RowPitch )
+{
+    const size_t BlockSize = GetBlockSize(Fmt);
+    const uint8_t* Src = (const uint8_t*)Blocks;
+
+    for (uint32_t BlockY = 0; BlockY < Height; BlockY += 4)
+    {
+        for (uint32_t BlockX = 0; BlockX < Width; BlockX += 4, Src += BlockSize)
+        {
+            uint8_t Out[16][4];
+            DecodeBlock(Fmt, Src, Out);
+
+            for (uint32_t y = 0; y < 4 && BlockY + y < Height; ++y)
+            {
+                const uint32_t Columns = min(4u, Width - BlockX);
+                memcpy(Pixels + (BlockY + y) * RowPitch + BlockX * 4, Out[y * 4], Columns * 4);
+            }
+        }
+    }
+}
+
+static const uint32_t kDDSTagMarker = 0x4342454D; // "MEBC", marks headers written here
+
+void BlockCompression::WriteDDSHeader( void* Dest, Format Fmt, bool sRGB, uint32_t Width, uint32_t Height, uint32_t MipCount, uint64_t Tag )
+{
+    using namespace DirectX;
+
+    uint8_t* Out = (uint8_t*)Dest;
+    memset(Out, 0, kDDSHeaderSize);
+
+    const uint32_t Magic = DDS_MAGIC;
+    memcpy(Out, &Magic, 4);
+
+    DDS_HEADER Header = {};
+    Header.size = sizeof(DDS_HEADER);
+    Header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP | DDS_HEADER_FLAGS_LINEARSIZE;
+    Header.height = Height;
+    Header.width = Width;
+    Header.pitchOrLinearSize = (uint32_t)GetCompressedSize(Fmt, Width, Height);
+    Header.mipMapCount = MipCount;
+    Header.reserved1[0] = kDDSTagMarker;
+    Header.reserved1[1] = (uint32_t)Tag;
+    Header.reserved1[2] = (uint32_t)(Tag >> 32);
+    Header.ddspf = DDSPF_DX10;
+    Header.caps = DDS_SURFACE_FLAGS_TEXTURE;
+    memcpy(Out + 4, &Header, sizeof(Header));
+
+    DDS_HEADER_DXT10 Extension = {};
+    Extension.dxgiFormat = GetDXGIFormat(Fmt, sRGB);
+    Extension.resourceDimension = DDS_DIMENSION_TEXTURE2D;
+    Extension.arraySize = 1;
+    memcpy(Out + 4 + sizeof(Header), &Extension, sizeof(Extension));
+}
+
+bool BlockCompression::CheckDDSTag( const void* File, size_t Size, uint64_t Tag )
+{
+    using namespace DirectX;
+
+    if (Size < kDDSHeaderSize)
+        return false;
+
+    uint32_t Magic;
+    DDS_HEADER Header;
+    memcpy(&Magic, File, 4);
+    memcpy(&Header, (const uint8_t*)File + 4, sizeof(Header));
+
+    return Magic == DDS_MAGIC && Header.size == sizeof(DDS_HEADER) && Header.reserved1[0] == kDDSTagMarker &&
+        Header.reserved1[1] == (uint32_t)Tag && Header.reserved1[2] == (uint32_t)(Tag >> 32);
+}
@@ -0,0 +1,75 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A CPU encoder for the BC1, BC3, BC5 and BC7 block compressed formats.  It doesn't touch the
+// device, so the same code compresses TGAs as they are loaded and in the offline TextureCompressor tool.
+//
+// Each 4x4 block is loaded into SSE registers one row per channel, so palette searches, covariance sums and
+// endpoint refits work on four pixels at a time.  Rows of blocks are compressed in parallel.
+//
+// Endpoints start on the principal axis of the block's colors.  The quality presets add work from there:
+//
+//   Fast     The principal axis endpoints alone.  BC7 uses mode 6 only.
+//   Normal   A least squares refit of the endpoints.  BC7 also tries two subset mode 1 on the two
+//            partitions estimated to fit opaque blocks best.
+//   High     Three refits.  BC1 also tries its three color mode, BC3 alpha and BC5 their six value
+//            mode, and BC7 tries every p-bit combination and sixteen mode 1 partitions.
+//
+// BC7 only writes modes 1 and 6, so Decompress() only reads those.  It is meant for measuring error.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <dxgiformat.h>
+
+namespace BlockCompression
+{
+    enum Format
+    {
+        kBC1,       // RGB and 1-bit alpha, 4 bits per pixel
+        kBC3,       // RGBA, 8 bits per pixel
+        kBC5,       // RG, 8 bits per pixel (for normal maps)
+        kBC7,       // RGBA, 8 bits per pixel, highest quality
+        kNumFormats
+    };
+
+    enum Quality
+    {
+        kFast,
+        kNormal,
+        kHigh,
+        kNumQualities
+    };
+
+    const char* GetFormatName( Format Fmt );
+    const char* GetQualityName( Quality Qual );
+    DXGI_FORMAT GetDXGIFormat( Format Fmt, bool sRGB );
+
+    // Bytes per 4x4 block and for a whole image
+    size_t GetBlockSize( Format Fmt );
+    size_t GetCompressedSize( Format Fmt, uint32_t Width, uint32_t Height );
+
+    // Pixels are RGBA8 with RowPitch bytes per row.  Partial blocks on the right and bottom edges repeat the
+    // last column or row.  Dest must hold GetCompressedSize() bytes.
+    void Compress( Format Fmt, Quality Qual, const uint8_t* Pixels, size_t RowPitch, uint32_t Width, uint32_t Height,
+        void* Dest, bool Multithreaded = true );
+
+    void Decompress( Format Fmt, const void* Blocks, uint32_t Width, uint32_t Height, uint8_t* Pixels, size_t RowPitch );
+
+    // A DDS file header (magic number, DDS_HEADER and DDS_HEADER_DXT10) for a 2D texture, which Tag is stored
+    // in so that cached files can be matched to their source.  The mips follow, largest first.
+    const size_t kDDSHeaderSize = 148;
+    void WriteDDSHeader( void* Dest, Format Fmt, bool sRGB, uint32_t Width, uint32_t Height, uint32_t MipCount, uint64_t Tag );
+
+    // Returns true if File begins with a header written with this Tag
+    bool CheckDDSTag( const void* File, size_t Size, uint64_t Tag );
+}
@@ -21,10 +21,10 @@ using namespace Graphics;
 using namespace std;
 
 BuddyBlock::BuddyBlock(uint32_t heapOffset, uint32_t totalSize, uint32_t unpaddedSize) :
-    m_pBuffer(nullptr)
+    BuddyRetireNode()
+    , m_pBuffer(nullptr)
     , m_pBackingHeap(nullptr)
     , m_offset(heapOffset)
-    , m_fenceValue(0)
     , m_size(totalSize)
     , m_unpaddedSize(unpaddedSize)
 {};
@@ -51,16 +51,59 @@ void BuddyBlock::InitFromResource(ByteAddressBuffer* pBuffer, uint32_t numElemen
 void BuddyBlock::Destroy()
 {
     m_pBuffer->Destroy();
+    delete m_pBuffer;
     m_pBuffer = nullptr;
 }
 
-BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D12_HEAP_TYPE heapType, size_t maxBlockSize, size_t MinBlockSize, size_t baseOffset)
+BuddyBlock* BuddyBlockPool::Allocate()
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    if (m_FreeList == nullptr)
+    {
+        BuddyBlock* pPage = new BuddyBlock[kBlocksPerPage];
+        m_Pages.push_back(pPage);
+
+        for (uint32_t i = 0; i < kBlocksPerPage; ++i)
+        {
+            pPage[i].m_pNextRetired = m_FreeList;
+            m_FreeList = &pPage[i];
+        }
+    }
+
+    BuddyBlock* pBlock = m_FreeList;
+    m_FreeList = static_cast<BuddyBlock*>(pBlock->m_pNextRetired);
+    *pBlock = BuddyBlock();
+    return pBlock;
+}
+
+void BuddyBlockPool::Free(BuddyBlock* pBlock)
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    pBlock->m_pNextRetired = m_FreeList;
+    m_FreeList = pBlock;
+}
+
+void BuddyBlockPool::Destroy()
+{
+    std::lock_guard<std::mutex> LockGuard(m_Mutex);
+
+    for (BuddyBlock* pPage : m_Pages)
+        delete[] pPage;
+
+    m_Pages.clear();
+    m_FreeList = nullptr;
+}
+
+BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D12_HEAP_TYPE heapType, size_t maxBlockSize, size_t MinBlockSize, size_t baseOffset, IFenceSource* pFenceSource)
     : m_allocationStrategy(allocationStrategy)
     , m_heapType(heapType)
     , m_baseOffset(baseOffset)
     , m_maxBlockSize(maxBlockSize)
     , m_minBlockSize(MinBlockSize)
     , m_pBackingHeap(nullptr)
+    , m_pFenceSource(pFenceSource != nullptr ? pFenceSource : &g_CommandManager.GetGraphicsQueue())
 #if defined(PROFILE) || defined(_DEBUG)
     , m_SpaceUsed(0)
     , m_InternalFragmentation(0)
@@ -71,7 +114,7 @@ BuddyAllocator::BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D1
 
     m_maxOrder = UnitSizeToOrder(SizeToUnitSize(maxBlockSize));
 
-    Reset();
+    m_freeBlocks.Create(m_maxOrder, m_pFenceSource);
 }
 
 void BuddyAllocator::Initialize()
@@ -96,72 +139,27 @@ void BuddyAllocator::Initialize()
 
 void BuddyAllocator::Destroy()
 {
-    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-    {
-        m_pBackingHeap->Release();
-    }
-    else
-    {
-        m_BackingResource.Destroy();
-    }
-}
-
-size_t BuddyAllocator::AllocateBlock(UINT order)
-{
-    size_t offset;
+    // The GPU is idle by now, so blocks still waiting on their fence can be released with the rest.  Placed
+    // blocks own a resource in the heap, which must go before the heap does.
+    BuddyRetireNode* pNode = m_freeBlocks.ReclaimAllRetired();
 
-    if (order > m_maxOrder)
+    while (pNode != nullptr)
     {
-        throw(std::bad_alloc()); // Can't allocate a block that large  
-    }
-
-    auto it = m_freeBlocks[order].begin();
-
-    if (it == m_freeBlocks[order].end())
-    {
-        // No free nodes in the requested pool.  Try to find a higher-order block and split it.  
-        size_t left = AllocateBlock(order + 1);
-
-        size_t size = OrderToUnitSize(order);
-
-        size_t right = left + size;
-
-        m_freeBlocks[order].insert(right); // Add the right block to the free pool  
-
-        offset = left; // Return the left block  
-    }
+        BuddyBlock* pBlock = static_cast<BuddyBlock*>(pNode);
+        pNode = pNode->m_pNextRetired;
 
-    else
-    {
-        offset = *it;
-
-        // Remove the block from the free list  
-        m_freeBlocks[order].erase(it);
+        DeallocateInternal(pBlock);
     }
 
-    return offset;
-}
-
-void BuddyAllocator::DeallocateBlock(size_t offset, UINT order)
-{
-    // See if the buddy block is free  
-    size_t size = OrderToUnitSize(order);
-
-    size_t buddy = GetBuddyOffset(offset, size);
+    m_freeBlocks.Destroy();
 
-    auto it = m_freeBlocks[order].find(buddy);
-
-    if (it != m_freeBlocks[order].end())
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate merged blocks  
-        DeallocateBlock(min(offset, buddy), order + 1);
-        // Remove the buddy from the free list  
-        m_freeBlocks[order].erase(it);
+        m_pBackingHeap->Release();
     }
     else
     {
-        // Add the block to the free list  
-        m_freeBlocks[order].insert(offset); // throw(std::bad_alloc) 
+        m_BackingResource.Destroy();
     }
 }
 
@@ -171,94 +169,71 @@ BuddyBlock* BuddyAllocator::Allocate(uint32_t numElements, uint32_t elementSize,
     size_t unitSize = SizeToUnitSize(size);
     UINT order = UnitSizeToOrder(unitSize);
 
-    try
+    uint32_t offset;
+    if (m_freeBlocks.Allocate(order, offset) != kBuddySuccess)
     {
-        size_t offset = AllocateBlock(order);
-        uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
+        // There are no blocks available for the requested size
+        return nullptr;
+    }
 
-        uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
+    uint32_t paddedSize = uint32_t(OrderToUnitSize(order) * m_minBlockSize);
 
-        INCREASE_BUDDY_COUNTER(m_SpaceUsed, paddedSize);
-        INCREASE_BUDDY_COUNTER(m_InternalFragmentation, (paddedSize - size));
+    uint32_t blockOffset = uint32_t(m_baseOffset + (offset * m_minBlockSize));
 
-        BuddyBlock* pBlock = new BuddyBlock(blockOffset, //offset
-            paddedSize, //total size (padded to fit a block)
-            numElements * elementSize);
-            
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            pBlock->InitPlaced(m_pBackingHeap, numElements, elementSize, initialData);
-        }
-        else
-        {
-            //TODO: To be truely thread-safe this operation should be atomic to guard against
-            //      the case in which blocks from this allocator are used on multiple threads 
-            //      (because it's really only 1 resource underneath)
-            pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
-        }
+    INCREASE_BUDDY_COUNTER(m_SpaceUsed, paddedSize);
+    INCREASE_BUDDY_COUNTER(m_InternalFragmentation, (paddedSize - size));
 
-        return pBlock;
-    }
+    BuddyBlock* pBlock = m_blockPool.Allocate();
+    *pBlock = BuddyBlock(blockOffset, //offset
+        paddedSize, //total size (padded to fit a block)
+        numElements * elementSize);
+    pBlock->m_UnitOffset = offset;
+    pBlock->m_Order = order;
 
-    catch (std::bad_alloc&)
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // There are no blocks available for the requested size so  
-        // return the NULL block type  
-        return new BuddyBlock();
+        pBlock->InitPlaced(m_pBackingHeap, numElements, elementSize, initialData);
     }
+    else
+    {
+        // Every block shares one resource underneath, so serialize the upload and its state transitions
+        std::lock_guard<std::mutex> LockGuard(m_backingResourceMutex);
+        pBlock->InitFromResource(&m_BackingResource, numElements, elementSize, initialData);
+    }
+
+    return pBlock;
 }
 
-/*
 void BuddyAllocator::Deallocate(BuddyBlock* pBlock)
 {
-    pBlock->m_fenceValue = g_CommandManager.GetNextFenceValue();
-    m_deferredDeletionQueue.push(pBlock);
+    ASSERT(IsOwner(*pBlock));
+
+    m_freeBlocks.Retire(pBlock);
 }
-*/
 
 void BuddyAllocator::DeallocateInternal(BuddyBlock* pBlock)
 {
-    ASSERT(IsOwner(*pBlock));
-
-    size_t offset = SizeToUnitSize(pBlock->GetOffset() - m_baseOffset);
-
-    size_t size = SizeToUnitSize(pBlock->GetSize());
-
-    UINT order = UnitSizeToOrder(size);
+    // The block's range has already been returned to m_freeBlocks
+    DECREASE_BUDDY_COUNTER(m_SpaceUsed, pBlock->GetSize());
+    DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (pBlock->GetSize() - pBlock->m_unpaddedSize));
 
-    try
-    {
-        DeallocateBlock(offset, order); // throw(std::bad_alloc)
-
-        DECREASE_BUDDY_COUNTER(m_SpaceUsed, size);
-        DECREASE_BUDDY_COUNTER(m_InternalFragmentation, (size - pBlock->m_unpaddedSize));
-        
-        if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
-        {
-            // Release the resource
-            pBlock->Destroy();
-        }
-        delete(pBlock);
-    }
-
-    catch (std::bad_alloc&)
+    if (m_allocationStrategy == kBuddyAllocationStrategy::kPlacedResourceStrategy)
     {
-        // Deallocate failed trying to add the free block to the pool  
-        // resulting in a leak.  Unfortunately there is not much we can do.  
-        // Fortunately this is expected to be extremely rare as the storage  
-        // needed for each deallocate is very small.  
+        // Release the resource
+        pBlock->Destroy();
     }
+    m_blockPool.Free(pBlock);
 };
 
-/*
 void BuddyAllocator::CleanUpAllocations()
 {
-    while (m_deferredDeletionQueue.empty() == false &&
-        g_CommandManager.IsFenceComplete(m_deferredDeletionQueue.front()->m_fenceValue))
+    BuddyRetireNode* pNode = m_freeBlocks.ReclaimRetired();
+
+    while (pNode != nullptr)
     {
-        BuddyBlock* pBlock = m_deferredDeletionQueue.front();
-        m_deferredDeletionQueue.pop();
+        BuddyBlock* pBlock = static_cast<BuddyBlock*>(pNode);
+        pNode = pNode->m_pNextRetired;
 
         DeallocateInternal(pBlock);
     }
-}*/
+}
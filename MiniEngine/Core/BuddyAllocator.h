@@ -21,17 +21,17 @@
 #pragma once
 
 #include "GpuBuffer.h"
+#include "ConcurrentBuddyAllocator.h"
 #include <vector>
-#include <queue>
 #include <mutex>
-#include <set>
+#include <atomic>
 
 // Unfortunately the api restricts the minimum size of a placed buffer resource to 64k
 #define MIN_PLACED_BUFFER_SIZE (64 * 1024)
 
 #if defined(PROFILE) || defined(_DEBUG)
-#define INCREASE_BUDDY_COUNTER(A, B) (A = A + B);
-#define DECREASE_BUDDY_COUNTER(A, B) (A = A - B);
+#define INCREASE_BUDDY_COUNTER(A, B) (A += B);
+#define DECREASE_BUDDY_COUNTER(A, B) (A -= B);
 #else
 #define INCREASE_BUDDY_COUNTER(A, B)
 #define DECREASE_BUDDY_COUNTER(A, B)
@@ -51,7 +51,7 @@ enum kBuddyAllocationStrategy
     kManualSubAllocationStrategy
 };
 
-struct BuddyBlock
+struct BuddyBlock : public BuddyRetireNode
 {
     ByteAddressBuffer* m_pBuffer;
     ID3D12Heap* m_pBackingHeap;
@@ -59,12 +59,11 @@ struct BuddyBlock
     size_t m_offset;
     size_t m_size;
     size_t m_unpaddedSize;
-    uint64_t m_fenceValue;
 
     inline size_t GetOffset() const { return m_offset; }
     inline size_t GetSize() const { return m_size; }
 
-    BuddyBlock() : m_pBuffer(nullptr), m_pBackingHeap(nullptr), m_offset(0), m_size(0), m_unpaddedSize(0), m_fenceValue(0) {};
+    BuddyBlock() : BuddyRetireNode(), m_pBuffer(nullptr), m_pBackingHeap(nullptr), m_offset(0), m_size(0), m_unpaddedSize(0) {};
 
     BuddyBlock(uint32_t heapOffset, uint32_t totalSize, uint32_t unpaddedSize);
 
@@ -75,18 +74,46 @@ struct BuddyBlock
     void Destroy();
 };
 
+// Recycles BuddyBlock descriptors so that allocating from the buddy allocator does not
+// hit the general purpose heap.  Blocks are carved out of fixed size pages which live
+// until the pool is destroyed.  Safe to use from multiple threads.
+class BuddyBlockPool
+{
+public:
+    BuddyBlockPool() : m_FreeList(nullptr) {}
+    ~BuddyBlockPool() { Destroy(); }
+
+    BuddyBlock* Allocate();
+    void Free(BuddyBlock* pBlock);
+    void Destroy();
+
+private:
+    static const uint32_t kBlocksPerPage = 256;
+
+    std::mutex m_Mutex;
+
+    // Free blocks are linked through their m_pNextRetired field
+    BuddyBlock* m_FreeList;
+    std::vector<BuddyBlock*> m_Pages;
+};
+
 class BuddyAllocator
 {
 public:
 
-    BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D12_HEAP_TYPE heapType, size_t maxBlockSize, size_t minBlockSize = MIN_PLACED_BUFFER_SIZE, size_t baseOffset = 0);
+    // Frees are deferred until pFenceSource reports the GPU is done with them.  Defaults to the graphics queue.
+    BuddyAllocator(kBuddyAllocationStrategy allocationStrategy, D3D12_HEAP_TYPE heapType, size_t maxBlockSize, size_t minBlockSize = MIN_PLACED_BUFFER_SIZE, size_t baseOffset = 0, IFenceSource* pFenceSource = nullptr);
 
     void Initialize();
 
+    // Releases everything still retired, without waiting on fences.  Call once the GPU is idle.
     void Destroy();
 
+    // Returns nullptr when the allocator cannot satisfy the request.  Safe to call from any thread.
     BuddyBlock* Allocate(uint32_t numElements, uint32_t elementSize, const void* initialData = nullptr);
 
+    // Retires the block against the next fence value.  Its memory is recycled by a later
+    // call to CleanUpAllocations() once that fence completes.  Safe to call from any thread.
     void Deallocate(BuddyBlock* pBlock);
 
     inline bool IsOwner(const BuddyBlock &block)
@@ -94,16 +121,7 @@ public:
         return block.GetOffset() >= m_baseOffset && block.GetSize() <= m_maxBlockSize;
     }
 
-    inline void Reset()
-    {
-        // Clear the free blocks collection  
-        m_freeBlocks.clear();
-
-        // Initialize the pool with a free inner block of max inner block size  
-        m_freeBlocks.resize(m_maxOrder + 1);
-        m_freeBlocks[m_maxOrder].insert((size_t)0);
-    }
-
+    // Reclaims every deallocated block whose fence has completed.  Call once per frame.
     void CleanUpAllocations();
 
 private:
@@ -112,8 +130,12 @@ private:
 
     const D3D12_HEAP_TYPE m_heapType;
 
-    std::queue<BuddyBlock*> m_deferredDeletionQueue;
-    std::vector<std::set<size_t>> m_freeBlocks;
+    IFenceSource* m_pFenceSource;
+    ConcurrentBuddyAllocator m_freeBlocks;
+    BuddyBlockPool m_blockPool;
+
+    // Uploads into the shared backing resource transition its state, so they must not overlap
+    std::mutex m_backingResourceMutex;
     UINT m_maxOrder;
     const size_t m_baseOffset;
     const size_t m_maxBlockSize;
@@ -139,11 +161,9 @@ private:
     void DeallocateInternal(BuddyBlock* pBlock);
 
     size_t OrderToUnitSize(UINT order) const { return ((size_t)1) << order; }
-    size_t AllocateBlock(UINT order);
-    void DeallocateBlock(size_t offset, UINT order);
 
 #if defined(PROFILE) || defined(_DEBUG)
-    size_t m_SpaceUsed;
-    size_t m_InternalFragmentation;
+    std::atomic<size_t> m_SpaceUsed;
+    std::atomic<size_t> m_InternalFragmentation;
 #endif
 };
@@ -0,0 +1,139 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "BuddyAllocatorCore.h"
+
+void BuddyAllocatorCore::Create( uint32_t maxOrder )
+{
+    ASSERT(maxOrder <= kMaxOrder, "Buddy allocator range is too large");
+
+    m_MaxOrder = maxOrder;
+
+    const size_t numUnits = ((size_t)1) << maxOrder;
+    m_NextFree.resize(numUnits);
+    m_PrevFree.resize(numUnits);
+    m_FreeOrder.resize(numUnits);
+
+    Reset();
+}
+
+void BuddyAllocatorCore::Destroy()
+{
+    m_NextFree = std::vector<uint32_t>();
+    m_PrevFree = std::vector<uint32_t>();
+    m_FreeOrder = std::vector<uint8_t>();
+    m_NonEmptyOrders = 0;
+    m_FreeUnits = 0;
+}
+
+void BuddyAllocatorCore::Reset()
+{
+    for (uint32_t order = 0; order <= kMaxOrder; ++order)
+        m_FreeHead[order] = kInvalidOffset;
+
+    m_FreeOrder.assign(m_FreeOrder.size(), (uint8_t)0);
+    m_NonEmptyOrders = 0;
+    m_FreeUnits = 0;
+
+    if (!m_FreeOrder.empty())
+        PushFreeBlock(0, m_MaxOrder);
+}
+
+void BuddyAllocatorCore::PushFreeBlock( uint32_t unitOffset, uint32_t order )
+{
+    ASSERT(m_FreeOrder[unitOffset] == 0, "Buddy block freed twice");
+
+    const uint32_t head = m_FreeHead[order];
+
+    m_NextFree[unitOffset] = head;
+    m_PrevFree[unitOffset] = kInvalidOffset;
+    if (head != kInvalidOffset)
+        m_PrevFree[head] = unitOffset;
+
+    m_FreeHead[order] = unitOffset;
+    m_FreeOrder[unitOffset] = uint8_t(order + 1);
+    m_NonEmptyOrders |= ((uint64_t)1) << order;
+    m_FreeUnits += ((size_t)1) << order;
+}
+
+void BuddyAllocatorCore::RemoveFreeBlock( uint32_t unitOffset, uint32_t order )
+{
+    ASSERT(IsFreeBlock(unitOffset, order));
+
+    const uint32_t next = m_NextFree[unitOffset];
+    const uint32_t prev = m_PrevFree[unitOffset];
+
+    if (prev != kInvalidOffset)
+        m_NextFree[prev] = next;
+    else
+        m_FreeHead[order] = next;
+
+    if (next != kInvalidOffset)
+        m_PrevFree[next] = prev;
+
+    if (m_FreeHead[order] == kInvalidOffset)
+        m_NonEmptyOrders &= ~(((uint64_t)1) << order);
+
+    m_FreeOrder[unitOffset] = 0;
+    m_FreeUnits -= ((size_t)1) << order;
+}
+
+kBuddyResult BuddyAllocatorCore::AllocateBlock( uint32_t order, uint32_t& unitOffset )
+{
+    unitOffset = kInvalidOffset;
+
+    if (order > m_MaxOrder)
+        return kBuddyInvalidOrder;
+
+    // Find the smallest order at least as large as the request that has a free block
+    const uint64_t candidates = m_NonEmptyOrders >> order;
+    if (candidates == 0)
+        return kBuddyOutOfMemory;
+
+    unsigned long lssb;
+    _BitScanForward64(&lssb, candidates);
+    uint32_t foundOrder = order + (uint32_t)lssb;
+
+    uint32_t offset = m_FreeHead[foundOrder];
+    RemoveFreeBlock(offset, foundOrder);
+
+    // Split the block down to the requested order, keeping the left half and
+    // returning each right half to the free list of its order
+    while (foundOrder > order)
+    {
+        --foundOrder;
+        PushFreeBlock(offset + (1u << foundOrder), foundOrder);
+    }
+
+    unitOffset = offset;
+    return kBuddySuccess;
+}
+
+void BuddyAllocatorCore::DeallocateBlock( uint32_t unitOffset, uint32_t order )
+{
+    ASSERT(order <= m_MaxOrder);
+    ASSERT((unitOffset & ((1u << order) - 1)) == 0, "Buddy block offset is not aligned to its order");
+
+    // Merge with the buddy for as long as it is free
+    while (order < m_MaxOrder)
+    {
+        const uint32_t buddy = unitOffset ^ (1u << order);
+        if (!IsFreeBlock(buddy, order))
+            break;
+
+        RemoveFreeBlock(buddy, order);
+        unitOffset &= ~(1u << order);
+        ++order;
+    }
+
+    PushFreeBlock(unitOffset, order);
+}
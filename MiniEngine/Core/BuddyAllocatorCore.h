@@ -0,0 +1,79 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Device-independent offset bookkeeping for the buddy allocator.  Offsets and
+// sizes are expressed in allocation units (the allocator's minimum block size)
+// so this class never touches D3D and can be exercised on its own.
+//
+// Every order keeps an intrusive doubly linked free list threaded through
+// per-unit arrays, and a 64-bit mask records which orders have free blocks.
+// Allocation finds the smallest usable order with a single bit scan, and
+// freeing checks the buddy with a single array lookup, so neither operation
+// allocates memory or walks a tree.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum kBuddyResult
+{
+    kBuddySuccess,
+    // No free block of the requested order (or larger) is available
+    kBuddyOutOfMemory,
+    // The requested order exceeds the size of the managed range
+    kBuddyInvalidOrder
+};
+
+class BuddyAllocatorCore
+{
+public:
+    static const uint32_t kMaxOrder = 31;
+    static const uint32_t kInvalidOffset = 0xFFFFFFFF;
+
+    BuddyAllocatorCore() : m_MaxOrder(0), m_NonEmptyOrders(0), m_FreeUnits(0) {}
+
+    // Manages (1 << maxOrder) allocation units
+    void Create( uint32_t maxOrder );
+    void Destroy();
+
+    // Returns the whole range to a single free block of maximum order
+    void Reset();
+
+    kBuddyResult AllocateBlock( uint32_t order, uint32_t& unitOffset );
+    void DeallocateBlock( uint32_t unitOffset, uint32_t order );
+
+    uint32_t GetMaxOrder() const { return m_MaxOrder; }
+    size_t GetTotalUnits() const { return m_FreeOrder.size(); }
+    size_t GetFreeUnits() const { return m_FreeUnits; }
+    bool HasFreeBlock( uint32_t order ) const { return order <= m_MaxOrder && (m_NonEmptyOrders >> order) != 0; }
+    bool IsFreeBlock( uint32_t unitOffset, uint32_t order ) const { return m_FreeOrder[unitOffset] == order + 1; }
+
+private:
+    void PushFreeBlock( uint32_t unitOffset, uint32_t order );
+    void RemoveFreeBlock( uint32_t unitOffset, uint32_t order );
+
+    uint32_t m_MaxOrder;
+
+    // Bit N is set when m_FreeHead[N] is not empty
+    uint64_t m_NonEmptyOrders;
+    size_t m_FreeUnits;
+
+    uint32_t m_FreeHead[kMaxOrder + 1];
+
+    // Indexed by unit offset.  Only meaningful for units that begin a free block.
+    std::vector<uint32_t> m_NextFree;
+    std::vector<uint32_t> m_PrevFree;
+
+    // Order + 1 of the free block beginning at this unit, or 0 if none does
+    std::vector<uint8_t> m_FreeOrder;
+};
@@ -14,9 +14,14 @@
 #include "pch.h"
 #include "CommandAllocatorPool.h"
 
-CommandAllocatorPool::CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type) :
-    m_cCommandListType(Type),
-    m_Device(nullptr)
+CommandAllocatorPool::CommandAllocatorPool() :
+    m_FenceSource(nullptr),
+    m_Factory(nullptr),
+    m_NumRequests(0),
+    m_NumCreated(0),
+    m_NumReused(0),
+    m_NumStalls(0),
+    m_NumTrimmed(0)
 {
 }
 
@@ -25,54 +30,129 @@ CommandAllocatorPool::~CommandAllocatorPool()
     Shutdown();
 }
 
-void CommandAllocatorPool::Create(ID3D12Device * pDevice)
+void CommandAllocatorPool::Create(IFenceSource* FenceSource, ICommandAllocatorFactory* Factory)
 {
-    m_Device = pDevice;
+    m_FenceSource = FenceSource;
+    m_Factory = Factory;
 }
 
 void CommandAllocatorPool::Shutdown()
 {
-    for (size_t i = 0; i < m_AllocatorPool.size(); ++i)
-        m_AllocatorPool[i]->Release();
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+
+    for (auto Iter = m_AllocatorPool.begin(); Iter != m_AllocatorPool.end(); ++Iter)
+        m_Factory->DestroyAllocator(Iter->first);
 
     m_AllocatorPool.clear();
+    m_ReadyAllocators.clear();
 }
 
-ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(uint64_t CompletedFenceValue)
+ID3D12CommandAllocator * CommandAllocatorPool::RequestAllocator(size_t ExpectedBytes)
 {
     std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
 
-    ID3D12CommandAllocator* pAllocator = nullptr;
+    ++m_NumRequests;
 
-    if (!m_ReadyAllocators.empty())
+    // Any completed allocator will do, not just the oldest.  Prefer the smallest one that already
+    // fits; failing that, the largest, since it will have to grow the least.
+    size_t BestIdx = m_ReadyAllocators.size();
+    for (size_t i = 0; i < m_ReadyAllocators.size(); ++i)
     {
-        std::pair<uint64_t, ID3D12CommandAllocator*>& AllocatorPair = m_ReadyAllocators.front();
+        const RetiredAllocator& Candidate = m_ReadyAllocators[i];
+        if (!m_FenceSource->IsFenceComplete(Candidate.FenceValue))
+            continue;
 
-        if (AllocatorPair.first <= CompletedFenceValue)
+        if (BestIdx == m_ReadyAllocators.size())
         {
-            pAllocator = AllocatorPair.second;
-            ASSERT_SUCCEEDED(pAllocator->Reset());
-            m_ReadyAllocators.pop();
+            BestIdx = i;
+            continue;
         }
+
+        const size_t BestSize = m_ReadyAllocators[BestIdx].HighWaterBytes;
+        const size_t Size = Candidate.HighWaterBytes;
+        const bool BestFits = BestSize >= ExpectedBytes;
+        const bool Fits = Size >= ExpectedBytes;
+
+        if (Fits ? (!BestFits || Size < BestSize) : (!BestFits && Size > BestSize))
+            BestIdx = i;
     }
 
-    // If no allocator's were ready to be reused, create a new one
-    if (pAllocator == nullptr)
+    ID3D12CommandAllocator* pAllocator = nullptr;
+
+    if (BestIdx < m_ReadyAllocators.size())
+    {
+        pAllocator = m_ReadyAllocators[BestIdx].Allocator;
+        m_ReadyAllocators[BestIdx] = m_ReadyAllocators.back();
+        m_ReadyAllocators.pop_back();
+
+        m_Factory->ResetAllocator(pAllocator);
+        ++m_NumReused;
+    }
+    else
     {
-        ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_cCommandListType, MY_IID_PPV_ARGS(&pAllocator)));
-        wchar_t AllocatorName[32];
-        swprintf(AllocatorName, 32, L"CommandAllocator %zu", m_AllocatorPool.size());
-        pAllocator->SetName(AllocatorName);
-        m_AllocatorPool.push_back(pAllocator);
+        // If no allocators were ready to be reused, create a new one
+        if (!m_ReadyAllocators.empty())
+            ++m_NumStalls;
+
+        pAllocator = m_Factory->CreateAllocator();
+        m_AllocatorPool[pAllocator] = 0;
+        ++m_NumCreated;
     }
 
+    if (m_NumRequests % kTrimInterval == 0)
+        TrimIdle(kMaxIdleRequests);
+
     return pAllocator;
 }
 
-void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator)
+void CommandAllocatorPool::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator * Allocator, size_t UsedBytes)
 {
     std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
 
+    auto Iter = m_AllocatorPool.find(Allocator);
+    ASSERT(Iter != m_AllocatorPool.end(), "Allocator does not belong to this pool");
+    Iter->second = std::max(Iter->second, UsedBytes);
+
     // That fence value indicates we are free to reset the allocator
-    m_ReadyAllocators.push(std::make_pair(FenceValue, Allocator));
+    RetiredAllocator Retired = { Allocator, FenceValue, m_NumRequests, Iter->second };
+    m_ReadyAllocators.push_back(Retired);
+}
+
+void CommandAllocatorPool::TrimIdleAllocators(uint64_t MaxIdleRequests)
+{
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+    TrimIdle(MaxIdleRequests);
+}
+
+void CommandAllocatorPool::TrimIdle(uint64_t MaxIdleRequests)
+{
+    for (size_t i = 0; i < m_ReadyAllocators.size(); )
+    {
+        const RetiredAllocator& Retired = m_ReadyAllocators[i];
+        if (m_NumRequests - Retired.RetiredAtRequest <= MaxIdleRequests || !m_FenceSource->IsFenceComplete(Retired.FenceValue))
+        {
+            ++i;
+            continue;
+        }
+
+        m_Factory->DestroyAllocator(Retired.Allocator);
+        m_AllocatorPool.erase(Retired.Allocator);
+        ++m_NumTrimmed;
+
+        m_ReadyAllocators[i] = m_ReadyAllocators.back();
+        m_ReadyAllocators.pop_back();
+    }
+}
+
+CommandAllocatorPool::Statistics CommandAllocatorPool::GetStatistics()
+{
+    std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex);
+
+    size_t HighWaterBytes = 0;
+    for (auto Iter = m_AllocatorPool.begin(); Iter != m_AllocatorPool.end(); ++Iter)
+        HighWaterBytes += Iter->second;
+
+    Statistics Stats = { m_AllocatorPool.size(), m_ReadyAllocators.size(),
+        m_NumCreated, m_NumReused, m_NumStalls, m_NumTrimmed, HighWaterBytes };
+    return Stats;
 }
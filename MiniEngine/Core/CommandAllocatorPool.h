@@ -10,33 +10,95 @@
 //
 // Author:  James Stanard
 //
+// Command allocators never give memory back on Reset(), so an allocator's footprint is the most it
+// has ever recorded.  The pool remembers that high-water mark (as reported by the caller, since D3D
+// can't be asked) and, among the retired allocators whose fence has passed, hands out the smallest
+// one that already fits the expected workload.  Small lists therefore don't pin large allocators,
+// and large lists don't grow small ones.  Allocators that sit idle for a while are destroyed.
+//
+// Allocators are created, reset and destroyed through an ICommandAllocatorFactory and fences are
+// tested through an IFenceSource, so the policy can be driven without a device.
+//
 
 #pragma once
 
+#include "FenceSource.h"
 #include <vector>
-#include <queue>
+#include <unordered_map>
 #include <mutex>
 #include <stdint.h>
 
+struct ID3D12CommandAllocator;
+
+class ICommandAllocatorFactory
+{
+public:
+    virtual ~ICommandAllocatorFactory() {}
+    virtual ID3D12CommandAllocator* CreateAllocator( void ) = 0;
+    virtual void ResetAllocator( ID3D12CommandAllocator* Allocator ) = 0;
+    virtual void DestroyAllocator( ID3D12CommandAllocator* Allocator ) = 0;
+};
+
 class CommandAllocatorPool
 {
 public:
-    CommandAllocatorPool(D3D12_COMMAND_LIST_TYPE Type);
+    struct Statistics
+    {
+        size_t NumLive;         // Allocators currently owned by the pool
+        size_t NumRetired;      // ...of which are waiting to be reused
+        size_t Created;
+        size_t Reused;
+        size_t Stalls;          // Requests that found retired allocators, but none whose fence had passed
+        size_t Trimmed;
+        size_t HighWaterBytes;  // Sum of every live allocator's high-water mark
+    };
+
+    CommandAllocatorPool();
     ~CommandAllocatorPool();
 
-    void Create(ID3D12Device* pDevice);
+    void Create(IFenceSource* FenceSource, ICommandAllocatorFactory* Factory);
     void Shutdown();
 
-    ID3D12CommandAllocator* RequestAllocator(uint64_t CompletedFenceValue);
-    void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator);
+    // ExpectedBytes is the caller's guess at how much it will record.  Zero matches any allocator.
+    ID3D12CommandAllocator* RequestAllocator(size_t ExpectedBytes = 0);
 
-    inline size_t Size() { return m_AllocatorPool.size(); }
+    // UsedBytes is an estimate of how much was recorded into the allocator since it was requested
+    void DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator, size_t UsedBytes = 0);
+
+    // Destroys allocators that have been retired, with their fence passed, for more than MaxIdleRequests
+    // requests.  Also runs periodically from RequestAllocator().
+    void TrimIdleAllocators(uint64_t MaxIdleRequests);
+
+    inline size_t Size() { std::lock_guard<std::mutex> LockGuard(m_AllocatorMutex); return m_AllocatorPool.size(); }
+
+    Statistics GetStatistics();
 
 private:
-    const D3D12_COMMAND_LIST_TYPE m_cCommandListType;
+    static const uint64_t kTrimInterval = 64;
+    static const uint64_t kMaxIdleRequests = 256;
+
+    struct RetiredAllocator
+    {
+        ID3D12CommandAllocator* Allocator;
+        uint64_t FenceValue;
+        uint64_t RetiredAtRequest;
+        size_t HighWaterBytes;
+    };
 
-    ID3D12Device* m_Device;
-    std::vector<ID3D12CommandAllocator*> m_AllocatorPool;
-    std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_ReadyAllocators;
+    // Must hold m_AllocatorMutex
+    void TrimIdle(uint64_t MaxIdleRequests);
+
+    IFenceSource* m_FenceSource;
+    ICommandAllocatorFactory* m_Factory;
+
+    // Every live allocator and its high-water mark
+    std::unordered_map<ID3D12CommandAllocator*, size_t> m_AllocatorPool;
+    std::vector<RetiredAllocator> m_ReadyAllocators;
     std::mutex m_AllocatorMutex;
+
+    uint64_t m_NumRequests;
+    size_t m_NumCreated;
+    size_t m_NumReused;
+    size_t m_NumStalls;
+    size_t m_NumTrimmed;
 };
@@ -18,6 +18,7 @@
 #include "GraphicsCore.h"
 #include "DescriptorHeap.h"
 #include "EngineProfiling.h"
+#include "EngineTuning.h"
 
 #ifndef RELEASE
 	#include <d3d11_2.h>
@@ -26,6 +27,11 @@
 
 using namespace Graphics;
 
+static BoolVar s_OptimizeBarriers("Graphics/Optimize Barriers", true);
+
+std::mutex CommandContext::sm_BarrierStatsMutex;
+ResourceBarrierBatch::Statistics CommandContext::sm_BarrierStats = {};
+
 
 void ContextManager::DestroyAllContexts(void)
 {
@@ -73,6 +79,12 @@ void CommandContext::DestroyAllContexts(void)
     g_ContextManager.DestroyAllContexts();
 }
 
+ResourceBarrierBatch::Statistics CommandContext::GetBarrierStatistics(void)
+{
+    std::lock_guard<std::mutex> LockGuard(sm_BarrierStatsMutex);
+    return sm_BarrierStats;
+}
+
 CommandContext& CommandContext::Begin( const std::wstring ID )
 {
     CommandContext* NewContext = g_ContextManager.AllocateContext(D3D12_COMMAND_LIST_TYPE_DIRECT);
@@ -139,14 +151,27 @@ uint64_t CommandContext::Finish( bool WaitForCompletion )
     CommandQueue& Queue = g_CommandManager.GetQueue(m_Type);
 
     uint64_t FenceValue = Queue.ExecuteCommandList(m_CommandList);
-    Queue.DiscardAllocator(FenceValue, m_CurrentAllocator);
+    Queue.DiscardAllocator(FenceValue, m_CurrentAllocator, m_CommandBytesEstimate);
     m_CurrentAllocator = nullptr;
+    m_LastCommandBytesEstimate = m_CommandBytesEstimate;
 
     m_CpuLinearAllocator.CleanupUsedPages(FenceValue);
     m_GpuLinearAllocator.CleanupUsedPages(FenceValue);
     m_DynamicViewDescriptorHeap.CleanupUsedHeaps(FenceValue);
     m_DynamicSamplerDescriptorHeap.CleanupUsedHeaps(FenceValue);
 
+    {
+        const ResourceBarrierBatch::Statistics& Stats = m_BarrierBatch.GetStatistics();
+        std::lock_guard<std::mutex> LockGuard(sm_BarrierStatsMutex);
+        sm_BarrierStats.Requested += Stats.Requested;
+        sm_BarrierStats.Emitted += Stats.Emitted;
+        sm_BarrierStats.Merged += Stats.Merged;
+        sm_BarrierStats.Elided += Stats.Elided;
+        sm_BarrierStats.SplitsCollapsed += Stats.SplitsCollapsed;
+        sm_BarrierStats.Batches += Stats.Batches;
+        m_BarrierBatch.ResetStatistics();
+    }
+
     if (WaitForCompletion)
         g_CommandManager.WaitForFence(FenceValue);
 
@@ -171,7 +196,9 @@ CommandContext::CommandContext(D3D12_COMMAND_LIST_TYPE Type) :
     m_CurGraphicsPipelineState = nullptr;
     m_CurComputeRootSignature = nullptr;
     m_CurComputePipelineState = nullptr;
-    m_NumBarriersToFlush = 0;
+    m_BarrierBatch.SetOptimize(s_OptimizeBarriers);
+    m_CommandBytesEstimate = 0;
+    m_LastCommandBytesEstimate = 0;
 }
 
 CommandContext::~CommandContext( void )
@@ -190,14 +217,15 @@ void CommandContext::Reset( void )
     // We only call Reset() on previously freed contexts.  The command list persists, but we must
     // request a new allocator.
     ASSERT(m_CommandList != nullptr && m_CurrentAllocator == nullptr);
-    m_CurrentAllocator = g_CommandManager.GetQueue(m_Type).RequestAllocator();
+    m_CurrentAllocator = g_CommandManager.GetQueue(m_Type).RequestAllocator(m_LastCommandBytesEstimate);
     m_CommandList->Reset(m_CurrentAllocator, nullptr);
+    m_CommandBytesEstimate = 0;
 
     m_CurGraphicsRootSignature = nullptr;
     m_CurGraphicsPipelineState = nullptr;
     m_CurComputeRootSignature = nullptr;
     m_CurComputePipelineState = nullptr;
-    m_NumBarriersToFlush = 0;
+    m_BarrierBatch.SetOptimize(s_OptimizeBarriers);
 
     BindDescriptorHeaps();
 }
@@ -346,30 +374,23 @@ void CommandContext::TransitionResource(GpuResource& Resource, D3D12_RESOURCE_ST
 
     if (OldState != NewState)
     {
-        ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-        D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-        BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        BarrierDesc.Transition.pResource = Resource.GetResource();
-        BarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        BarrierDesc.Transition.StateBefore = OldState;
-        BarrierDesc.Transition.StateAfter = NewState;
+        D3D12_RESOURCE_BARRIER_FLAGS Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
 
         // Check to see if we already started the transition
         if (NewState == Resource.m_TransitioningState)
         {
-            BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+            Flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
             Resource.m_TransitioningState = (D3D12_RESOURCE_STATES)-1;
         }
-        else
-            BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+
+        m_BarrierBatch.AddTransition(Resource.GetResource(), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, OldState, NewState, Flags);
 
         Resource.m_UsageState = NewState;
     }
     else if (NewState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
         InsertUAVBarrier(Resource, FlushImmediate);
 
-    if (FlushImmediate || m_NumBarriersToFlush == 16)
+    if (FlushImmediate)
         FlushResourceBarriers();
 }
 
@@ -383,32 +404,19 @@ void CommandContext::BeginResourceTransition(GpuResource& Resource, D3D12_RESOUR
 
     if (OldState != NewState)
     {
-        ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-        D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-        BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-        BarrierDesc.Transition.pResource = Resource.GetResource();
-        BarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-        BarrierDesc.Transition.StateBefore = OldState;
-        BarrierDesc.Transition.StateAfter = NewState;
-
-        BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+        m_BarrierBatch.AddTransition(Resource.GetResource(), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, OldState, NewState,
+            D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY);
 
         Resource.m_TransitioningState = NewState;
     }
 
-    if (FlushImmediate || m_NumBarriersToFlush == 16)
+    if (FlushImmediate)
         FlushResourceBarriers();
 }
 
 void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate)
 {
-    ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-    D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    BarrierDesc.UAV.pResource = Resource.GetResource();
+    m_BarrierBatch.AddUAV(Resource.GetResource());
 
     if (FlushImmediate)
         FlushResourceBarriers();
@@ -416,13 +424,7 @@ void CommandContext::InsertUAVBarrier(GpuResource& Resource, bool FlushImmediate
 
 void CommandContext::InsertAliasBarrier(GpuResource& Before, GpuResource& After, bool FlushImmediate)
 {
-    ASSERT(m_NumBarriersToFlush < 16, "Exceeded arbitrary limit on buffered barriers");
-    D3D12_RESOURCE_BARRIER& BarrierDesc = m_ResourceBarrierBuffer[m_NumBarriersToFlush++];
-
-    BarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
-    BarrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-    BarrierDesc.Aliasing.pResourceBefore = Before.GetResource();
-    BarrierDesc.Aliasing.pResourceAfter = After.GetResource();
+    m_BarrierBatch.AddAliasing(Before.GetResource(), After.GetResource());
 
     if (FlushImmediate)
         FlushResourceBarriers();
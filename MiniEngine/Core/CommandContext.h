@@ -23,6 +23,7 @@
 #include "PixelBuffer.h"
 #include "DynamicDescriptorHeap.h"
 #include "LinearAllocator.h"
+#include "ResourceBarrierBatch.h"
 #include "CommandSignature.h"
 #include "GraphicsCore.h"
 #include <vector>
@@ -96,6 +97,9 @@ public:
 
     static CommandContext& Begin(const std::wstring ID = L"");
 
+    // Totals across every context, updated as each one finishes
+    static ResourceBarrierBatch::Statistics GetBarrierStatistics(void);
+
     // Flush existing commands to the GPU but keep the context alive
     uint64_t Flush( bool WaitForCompletion = false );
 
@@ -124,9 +128,9 @@ public:
     void CopyCounter(GpuResource& Dest, size_t DestOffset, StructuredBuffer& Src);
     void ResetCounter(StructuredBuffer& Buf, uint32_t Value = 0);
 
-    DynAlloc ReserveUploadMemory(size_t SizeInBytes)
+    DynAlloc ReserveUploadMemory(size_t SizeInBytes, size_t Alignment = DEFAULT_ALIGN)
     {
-        return m_CpuLinearAllocator.Allocate(SizeInBytes);
+        return m_CpuLinearAllocator.Allocate(SizeInBytes, Alignment);
     }
 
     static void InitializeTexture( GpuResource& Dest, UINT NumSubresources, D3D12_SUBRESOURCE_DATA SubData[] );
@@ -170,8 +174,20 @@ protected:
     DynamicDescriptorHeap m_DynamicViewDescriptorHeap;		// HEAP_TYPE_CBV_SRV_UAV
     DynamicDescriptorHeap m_DynamicSamplerDescriptorHeap;	// HEAP_TYPE_SAMPLER
 
-    D3D12_RESOURCE_BARRIER m_ResourceBarrierBuffer[16];
-    UINT m_NumBarriersToFlush;
+    // Requested barriers are held until the next command that does work, which gives the batch a
+    // chance to merge or drop them
+    ResourceBarrierBatch m_BarrierBatch;
+
+    static std::mutex sm_BarrierStatsMutex;
+    static ResourceBarrierBatch::Statistics sm_BarrierStats;
+
+    // A draw or dispatch together with the state set up before it
+    static const size_t kEstimatedBytesPerCommand = 256;
+
+    // Recorded into the current allocator, and into the previous one.  The previous amount is the
+    // size hint for the next allocator, on the assumption that contexts see similar workloads.
+    size_t m_CommandBytesEstimate;
+    size_t m_LastCommandBytesEstimate;
 
     ID3D12DescriptorHeap* m_CurrentDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
 
@@ -303,10 +319,15 @@ private:
 
 inline void CommandContext::FlushResourceBarriers( void )
 {
-    if (m_NumBarriersToFlush > 0)
+    // Nearly every command that does work flushes barriers first, so this is where the command
+    // memory held by the allocator is (roughly) accounted for
+    m_CommandBytesEstimate += kEstimatedBytesPerCommand;
+
+    if (!m_BarrierBatch.IsEmpty())
     {
-        m_CommandList->ResourceBarrier(m_NumBarriersToFlush, m_ResourceBarrierBuffer);
-        m_NumBarriersToFlush = 0;
+        m_CommandBytesEstimate += m_BarrierBatch.GetNumBarriers() * sizeof(D3D12_RESOURCE_BARRIER);
+        m_CommandList->ResourceBarrier(m_BarrierBatch.GetNumBarriers(), m_BarrierBatch.GetBarriers());
+        m_BarrierBatch.Clear();
     }
 }
 
@@ -16,11 +16,12 @@
 
 CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE Type) :
     m_Type(Type),
+    m_Device(nullptr),
     m_CommandQueue(nullptr),
     m_pFence(nullptr),
     m_NextFenceValue((uint64_t)Type << 56 | 1),
     m_LastCompletedFenceValue((uint64_t)Type << 56),
-    m_AllocatorPool(Type)
+    m_NumAllocatorsCreated(0)
 {
 }
 
@@ -84,7 +85,8 @@ void CommandQueue::Create(ID3D12Device* pDevice)
     m_FenceEventHandle = CreateEvent(nullptr, false, false, nullptr);
     ASSERT(m_FenceEventHandle != INVALID_HANDLE_VALUE);
 
-    m_AllocatorPool.Create(pDevice);
+    m_Device = pDevice;
+    m_AllocatorPool.Create(this, this);
 
     ASSERT(IsReady());
 }
@@ -138,6 +140,13 @@ uint64_t CommandQueue::IncrementFence(void)
     return m_NextFenceValue++;
 }
 
+uint64_t CommandQueue::GetNextFenceValue()
+{
+    // Blocks are retired from worker threads while the render thread executes command lists
+    std::lock_guard<std::mutex> LockGuard(m_FenceMutex);
+    return m_NextFenceValue;
+}
+
 bool CommandQueue::IsFenceComplete(uint64_t FenceValue)
 {
     // Avoid querying the fence value by testing against the last one seen.
@@ -162,8 +171,9 @@ void CommandQueue::StallForFence(uint64_t FenceValue)
 
 void CommandQueue::StallForProducer(CommandQueue& Producer)
 {
-    ASSERT(Producer.m_NextFenceValue > 0);
-    m_CommandQueue->Wait(Producer.m_pFence, Producer.m_NextFenceValue - 1);
+    const uint64_t NextFenceValue = Producer.GetNextFenceValue();
+    ASSERT(NextFenceValue > 0);
+    m_CommandQueue->Wait(Producer.m_pFence, NextFenceValue - 1);
 }
 
 void CommandQueue::WaitForFence(uint64_t FenceValue)
@@ -190,14 +200,32 @@ void CommandListManager::WaitForFence(uint64_t FenceValue)
     Producer.WaitForFence(FenceValue);
 }
 
-ID3D12CommandAllocator* CommandQueue::RequestAllocator()
+ID3D12CommandAllocator* CommandQueue::RequestAllocator(size_t ExpectedBytes)
+{
+    return m_AllocatorPool.RequestAllocator(ExpectedBytes);
+}
+
+void CommandQueue::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator, size_t UsedBytes)
 {
-    uint64_t CompletedFence = m_pFence->GetCompletedValue();
+    m_AllocatorPool.DiscardAllocator(FenceValue, Allocator, UsedBytes);
+}
 
-    return m_AllocatorPool.RequestAllocator(CompletedFence);
+ID3D12CommandAllocator* CommandQueue::CreateAllocator(void)
+{
+    ID3D12CommandAllocator* pAllocator = nullptr;
+    ASSERT_SUCCEEDED(m_Device->CreateCommandAllocator(m_Type, MY_IID_PPV_ARGS(&pAllocator)));
+    wchar_t AllocatorName[32];
+    swprintf(AllocatorName, 32, L"CommandAllocator %u", m_NumAllocatorsCreated++);
+    pAllocator->SetName(AllocatorName);
+    return pAllocator;
+}
+
+void CommandQueue::ResetAllocator(ID3D12CommandAllocator* Allocator)
+{
+    ASSERT_SUCCEEDED(Allocator->Reset());
 }
 
-void CommandQueue::DiscardAllocator(uint64_t FenceValue, ID3D12CommandAllocator* Allocator)
+void CommandQueue::DestroyAllocator(ID3D12CommandAllocator* Allocator)
 {
-    m_AllocatorPool.DiscardAllocator(FenceValue, Allocator);
+    Allocator->Release();
 }
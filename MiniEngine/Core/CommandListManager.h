@@ -18,8 +18,9 @@
 #include <mutex>
 #include <stdint.h>
 #include "CommandAllocatorPool.h"
+#include "FenceSource.h"
 
-class CommandQueue
+class CommandQueue : public IFenceSource, public ICommandAllocatorFactory
 {
     friend class CommandListManager;
     friend class CommandContext;
@@ -37,7 +38,7 @@ public:
     }
 
     uint64_t IncrementFence(void);
-    bool IsFenceComplete(uint64_t FenceValue);
+    bool IsFenceComplete(uint64_t FenceValue) override;
     void StallForFence(uint64_t FenceValue);
     void StallForProducer(CommandQueue& Producer);
     void WaitForFence(uint64_t FenceValue);
@@ -45,13 +46,23 @@ public:
 
     ID3D12CommandQueue* GetCommandQueue() { return m_CommandQueue; }
 
-    uint64_t GetNextFenceValue() { return m_NextFenceValue; }
+    // Safe to call from any thread
+    uint64_t GetNextFenceValue() override;
+
+    CommandAllocatorPool::Statistics GetAllocatorStatistics(void) { return m_AllocatorPool.GetStatistics(); }
 
 private:
 
     uint64_t ExecuteCommandList(ID3D12CommandList* List);
-    ID3D12CommandAllocator* RequestAllocator(void);
-    void DiscardAllocator(uint64_t FenceValueForReset, ID3D12CommandAllocator* Allocator);
+    ID3D12CommandAllocator* RequestAllocator(size_t ExpectedBytes = 0);
+    void DiscardAllocator(uint64_t FenceValueForReset, ID3D12CommandAllocator* Allocator, size_t UsedBytes = 0);
+
+    // ICommandAllocatorFactory
+    ID3D12CommandAllocator* CreateAllocator(void) override;
+    void ResetAllocator(ID3D12CommandAllocator* Allocator) override;
+    void DestroyAllocator(ID3D12CommandAllocator* Allocator) override;
+
+    ID3D12Device* m_Device;
 
     ID3D12CommandQueue* m_CommandQueue;
 
@@ -67,9 +78,11 @@ private:
     uint64_t m_LastCompletedFenceValue;
     HANDLE m_FenceEventHandle;
 
+    uint32_t m_NumAllocatorsCreated;
+
 };
 
-class CommandListManager
+class CommandListManager : public IFenceSource
 {
     friend class CommandContext;
 
@@ -104,8 +117,15 @@ public:
         ID3D12GraphicsCommandList** List,
         ID3D12CommandAllocator** Allocator);
 
+    // Fence values carry their queue type, so fences from any queue may be tested here.  New
+    // fence values are taken from the graphics queue.
+    uint64_t GetNextFenceValue() override
+    {
+        return m_GraphicsQueue.GetNextFenceValue();
+    }
+
     // Test to see if a fence has already been reached
-    bool IsFenceComplete(uint64_t FenceValue)
+    bool IsFenceComplete(uint64_t FenceValue) override
     {
         return GetQueue(D3D12_COMMAND_LIST_TYPE(FenceValue >> 56)).IsFenceComplete(FenceValue);
     }
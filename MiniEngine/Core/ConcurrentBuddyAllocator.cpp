@@ -0,0 +1,230 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "ConcurrentBuddyAllocator.h"
+
+using namespace std;
+
+ConcurrentBuddyAllocator::ConcurrentBuddyAllocator()
+    : m_pFenceSource(nullptr)
+    , m_RetiredHead(nullptr)
+    , m_PendingHead(nullptr)
+{
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+    {
+        for (uint32_t order = 0; order < kNumCachedOrders; ++order)
+            m_ThreadCaches[i].m_Count[order] = 0;
+    }
+}
+
+void ConcurrentBuddyAllocator::Create( uint32_t maxOrder, IFenceSource* pFenceSource )
+{
+    m_pFenceSource = pFenceSource;
+    m_Core.Create(maxOrder);
+}
+
+void ConcurrentBuddyAllocator::Destroy()
+{
+    // Retired nodes belong to the caller, who must have taken them back with ReclaimAllRetired()
+    ASSERT(m_RetiredHead.load() == nullptr && m_PendingHead == nullptr, "Retired blocks were not reclaimed");
+
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+    {
+        for (uint32_t order = 0; order < kNumCachedOrders; ++order)
+            m_ThreadCaches[i].m_Count[order] = 0;
+    }
+
+    m_Core.Destroy();
+}
+
+ConcurrentBuddyAllocator::ThreadCache& ConcurrentBuddyAllocator::GetThreadCache()
+{
+    static atomic<uint32_t> s_NextThreadIndex(0);
+    thread_local uint32_t t_ThreadIndex = s_NextThreadIndex++;
+
+    return m_ThreadCaches[t_ThreadIndex % kNumCacheStripes];
+}
+
+kBuddyResult ConcurrentBuddyAllocator::AllocateFromCore( uint32_t order, uint32_t& unitOffset )
+{
+    kBuddyResult result;
+    {
+        lock_guard<mutex> LockGuard(m_CoreMutex);
+        result = m_Core.AllocateBlock(order, unitOffset);
+    }
+
+    // Blocks parked in other threads' caches may be all that stands between us and success
+    if (result == kBuddyOutOfMemory)
+    {
+        FlushThreadCaches();
+
+        lock_guard<mutex> LockGuard(m_CoreMutex);
+        result = m_Core.AllocateBlock(order, unitOffset);
+    }
+
+    return result;
+}
+
+kBuddyResult ConcurrentBuddyAllocator::Allocate( uint32_t order, uint32_t& unitOffset )
+{
+    if (order >= kNumCachedOrders || order > m_Core.GetMaxOrder())
+        return AllocateFromCore(order, unitOffset);
+
+    ThreadCache& cache = GetThreadCache();
+    {
+        lock_guard<mutex> CacheGuard(cache.m_Mutex);
+
+        uint32_t& count = cache.m_Count[order];
+
+        if (count == 0)
+        {
+            // Refill in one trip to the core so the next few requests stay local
+            lock_guard<mutex> LockGuard(m_CoreMutex);
+            while (count < kCacheRefillCount && m_Core.AllocateBlock(order, cache.m_Offsets[order][count]) == kBuddySuccess)
+                ++count;
+        }
+
+        if (count > 0)
+        {
+            unitOffset = cache.m_Offsets[order][--count];
+            return kBuddySuccess;
+        }
+    }
+
+    // The core is exhausted at this order.  This takes every stripe lock, so ours must be released first.
+    return AllocateFromCore(order, unitOffset);
+}
+
+void ConcurrentBuddyAllocator::Free( uint32_t unitOffset, uint32_t order )
+{
+    lock_guard<mutex> LockGuard(m_CoreMutex);
+    m_Core.DeallocateBlock(unitOffset, order);
+}
+
+void ConcurrentBuddyAllocator::Retire( BuddyRetireNode* pNode )
+{
+    ASSERT(m_pFenceSource != nullptr, "Deferred frees need a fence source");
+
+    pNode->m_RetireFenceValue = m_pFenceSource->GetNextFenceValue();
+
+    BuddyRetireNode* pHead = m_RetiredHead.load(memory_order_relaxed);
+    do
+    {
+        pNode->m_pNextRetired = pHead;
+    }
+    while (!m_RetiredHead.compare_exchange_weak(pHead, pNode, memory_order_release, memory_order_relaxed));
+}
+
+void ConcurrentBuddyAllocator::TakeRetired()
+{
+    // Move everything retired since the last pass onto the pending list
+    BuddyRetireNode* pNode = m_RetiredHead.exchange(nullptr, memory_order_acquire);
+    while (pNode != nullptr)
+    {
+        BuddyRetireNode* pNext = pNode->m_pNextRetired;
+        pNode->m_pNextRetired = m_PendingHead;
+        m_PendingHead = pNode;
+        pNode = pNext;
+    }
+}
+
+void ConcurrentBuddyAllocator::ReturnToCore( BuddyRetireNode* pList )
+{
+    if (pList == nullptr)
+        return;
+
+    lock_guard<mutex> LockGuard(m_CoreMutex);
+    for (BuddyRetireNode* pNode = pList; pNode != nullptr; pNode = pNode->m_pNextRetired)
+        m_Core.DeallocateBlock(pNode->m_UnitOffset, pNode->m_Order);
+}
+
+BuddyRetireNode* ConcurrentBuddyAllocator::ReclaimRetired()
+{
+    unique_lock<mutex> ReclaimGuard(m_ReclaimMutex, try_to_lock);
+    if (!ReclaimGuard.owns_lock())
+        return nullptr;
+
+    TakeRetired();
+
+    // Pull out every node whose fence has completed
+    BuddyRetireNode* pReclaimed = nullptr;
+    BuddyRetireNode** ppLink = &m_PendingHead;
+    while (*ppLink != nullptr)
+    {
+        BuddyRetireNode* pNode = *ppLink;
+        if (m_pFenceSource->IsFenceComplete(pNode->m_RetireFenceValue))
+        {
+            *ppLink = pNode->m_pNextRetired;
+            pNode->m_pNextRetired = pReclaimed;
+            pReclaimed = pNode;
+        }
+        else
+        {
+            ppLink = &pNode->m_pNextRetired;
+        }
+    }
+
+    ReturnToCore(pReclaimed);
+    return pReclaimed;
+}
+
+BuddyRetireNode* ConcurrentBuddyAllocator::ReclaimAllRetired()
+{
+    lock_guard<mutex> ReclaimGuard(m_ReclaimMutex);
+
+    TakeRetired();
+
+    BuddyRetireNode* pReclaimed = m_PendingHead;
+    m_PendingHead = nullptr;
+
+    ReturnToCore(pReclaimed);
+    return pReclaimed;
+}
+
+void ConcurrentBuddyAllocator::FlushThreadCache( ThreadCache& cache )
+{
+    lock_guard<mutex> CacheGuard(cache.m_Mutex);
+    lock_guard<mutex> LockGuard(m_CoreMutex);
+
+    for (uint32_t order = 0; order < kNumCachedOrders; ++order)
+    {
+        for (uint32_t i = 0; i < cache.m_Count[order]; ++i)
+            m_Core.DeallocateBlock(cache.m_Offsets[order][i], order);
+
+        cache.m_Count[order] = 0;
+    }
+}
+
+void ConcurrentBuddyAllocator::FlushThreadCaches()
+{
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+        FlushThreadCache(m_ThreadCaches[i]);
+}
+
+size_t ConcurrentBuddyAllocator::GetFreeUnits()
+{
+    // Hold every stripe at once so a block can't be counted both in a cache and, after a flush, in the core.
+    // Stripes are only ever held one at a time elsewhere, and always before the core lock, so this can't deadlock.
+    unique_lock<mutex> CacheGuards[kNumCacheStripes];
+    size_t cachedUnits = 0;
+
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+    {
+        CacheGuards[i] = unique_lock<mutex>(m_ThreadCaches[i].m_Mutex);
+
+        for (uint32_t order = 0; order < kNumCachedOrders; ++order)
+            cachedUnits += (size_t)m_ThreadCaches[i].m_Count[order] << order;
+    }
+
+    lock_guard<mutex> LockGuard(m_CoreMutex);
+    return m_Core.GetFreeUnits() + cachedUnits;
+}
@@ -0,0 +1,115 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Thread-safe front end to BuddyAllocatorCore.
+//
+// Small orders are served from a set of striped caches, one stripe per thread
+// (modulo the stripe count), which are refilled from the shared core in batches
+// so loader threads rarely touch the core lock.  Freed blocks are pushed onto a
+// lock-free retire list stamped with the fence value that must complete before
+// the GPU is done with them.  ReclaimRetired() returns every block whose fence
+// has passed to the core in a single locked batch.  At shutdown, once the GPU is
+// idle, ReclaimAllRetired() hands back the rest so their owner can release them.
+//
+
+#pragma once
+
+#include "BuddyAllocatorCore.h"
+#include "FenceSource.h"
+#include <atomic>
+#include <mutex>
+
+// Intrusive link used to retire a block.  Anything handed to Retire() must
+// stay alive until ReclaimRetired() hands it back.
+struct BuddyRetireNode
+{
+    BuddyRetireNode* m_pNextRetired;
+    uint64_t m_RetireFenceValue;
+    uint32_t m_UnitOffset;
+    uint32_t m_Order;
+
+    BuddyRetireNode() : m_pNextRetired(nullptr), m_RetireFenceValue(0), m_UnitOffset(0), m_Order(0) {}
+};
+
+class ConcurrentBuddyAllocator
+{
+public:
+    ConcurrentBuddyAllocator();
+    ~ConcurrentBuddyAllocator() { Destroy(); }
+
+    // The fence source may be null if nothing is ever retired.  Everything retired
+    // must have been reclaimed before Destroy().
+    void Create( uint32_t maxOrder, IFenceSource* pFenceSource );
+    void Destroy();
+
+    // Safe to call from any thread
+    kBuddyResult Allocate( uint32_t order, uint32_t& unitOffset );
+
+    // Immediately frees a block the GPU has never seen (or is known to be done with)
+    void Free( uint32_t unitOffset, uint32_t order );
+
+    // Stamps the node with the next fence value and queues it for reclamation.
+    // Lock-free; safe to call from any thread.
+    void Retire( BuddyRetireNode* pNode );
+
+    // Returns the offsets of every retired block whose fence has completed to the
+    // allocator and hands the nodes back as a list linked through m_pNextRetired.
+    // Only one thread reclaims at a time; concurrent callers return nullptr.
+    BuddyRetireNode* ReclaimRetired();
+
+    // As ReclaimRetired(), but without waiting on fences.  Only for shutdown, once
+    // the GPU is idle; it blocks until any concurrent reclaim has finished.
+    BuddyRetireNode* ReclaimAllRetired();
+
+    // Returns all blocks held by the thread caches to the core
+    void FlushThreadCaches();
+
+    uint32_t GetMaxOrder() const { return m_Core.GetMaxOrder(); }
+
+    // Counts blocks parked in the thread caches as free.  Retired blocks are not
+    // free until they have been reclaimed.
+    size_t GetFreeUnits();
+
+private:
+    // Orders below this are cached per thread
+    static const uint32_t kNumCachedOrders = 4;
+    static const uint32_t kCacheDepth = 16;
+    static const uint32_t kCacheRefillCount = 8;
+    static const uint32_t kNumCacheStripes = 16;
+
+    struct ThreadCache
+    {
+        std::mutex m_Mutex;
+        uint32_t m_Count[kNumCachedOrders];
+        uint32_t m_Offsets[kNumCachedOrders][kCacheDepth];
+    };
+
+    ThreadCache& GetThreadCache();
+    kBuddyResult AllocateFromCore( uint32_t order, uint32_t& unitOffset );
+    void FlushThreadCache( ThreadCache& cache );
+
+    // Both require m_ReclaimMutex
+    void TakeRetired();
+    void ReturnToCore( BuddyRetireNode* pList );
+
+    IFenceSource* m_pFenceSource;
+
+    std::mutex m_CoreMutex;
+    BuddyAllocatorCore m_Core;
+
+    ThreadCache m_ThreadCaches[kNumCacheStripes];
+
+    // Multi-producer push list of freshly retired nodes
+    std::atomic<BuddyRetireNode*> m_RetiredHead;
+
+    // Retired nodes still waiting on their fence.  Owned by whoever holds m_ReclaimMutex.
+    std::mutex m_ReclaimMutex;
+    BuddyRetireNode* m_PendingHead;
+};
@@ -966,17 +966,11 @@ static HRESULT CreateD3DResources( _In_ ID3D12Device* d3dDevice,
 }
 
 //--------------------------------------------------------------------------------------
-static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
-                                     _In_ const DDS_HEADER* header,
-                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
-                                     _In_ size_t bitSize,
-                                     _In_ size_t maxsize,
-                                     _In_ bool forceSRGB,
-                                     _Outptr_opt_ ID3D12Resource** texture,
-                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+// Validates the header and fills in the texture description part of the layout
+//--------------------------------------------------------------------------------------
+static HRESULT GetTextureInfo( _In_ const DDS_HEADER* header,
+                               _Out_ DDS_TEXTURE_LAYOUT* layout )
 {
-    HRESULT hr = S_OK;
-
     UINT width = header->width;
     UINT height = header->height;
     UINT depth = header->depth;
@@ -986,7 +980,7 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
     DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
     bool isCubeMap = false;
 
-    size_t mipCount = header->mipMapCount;
+    UINT mipCount = header->mipMapCount;
     if (0 == mipCount)
     {
         mipCount = 1;
@@ -1142,6 +1136,45 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
         return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
     }
 
+    layout->dimension = static_cast<D3D12_RESOURCE_DIMENSION>( resDim );
+    layout->format = format;
+    layout->width = width;
+    layout->height = height;
+    layout->depth = depth;
+    layout->mipCount = mipCount;
+    layout->arraySize = arraySize;
+    layout->isCubeMap = isCubeMap;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+static HRESULT CreateTextureFromDDS( _In_ ID3D12Device* d3dDevice,
+                                     _In_ const DDS_HEADER* header,
+                                     _In_reads_bytes_(bitSize) const uint8_t* bitData,
+                                     _In_ size_t bitSize,
+                                     _In_ size_t maxsize,
+                                     _In_ bool forceSRGB,
+                                     _Outptr_opt_ ID3D12Resource** texture,
+                                     _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    DDS_TEXTURE_LAYOUT info;
+    HRESULT hr = GetTextureInfo( header, &info );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    const uint32_t resDim = info.dimension;
+    const UINT width = info.width;
+    const UINT height = info.height;
+    const UINT depth = info.depth;
+    const size_t mipCount = info.mipCount;
+    const UINT arraySize = info.arraySize;
+    const DXGI_FORMAT format = info.format;
+    const bool isCubeMap = info.isCubeMap;
+
     {
         // Create the texture
         UINT subresourceCount = static_cast<UINT>(mipCount) * arraySize;
@@ -1345,3 +1378,262 @@ HRESULT CreateDDSTextureFromFile(
 
     return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+// Progressive loading
+//--------------------------------------------------------------------------------------
+static_assert( DDS_MAX_HEADER_SIZE == sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10), "DDS header size mismatch" );
+
+static inline UINT MipDimension( _In_ UINT size, _In_ UINT mip )
+{
+    size >>= mip;
+    return size ? size : 1;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Points initData[0..numMips) at mips [firstMip, firstMip + numMips) of mipData, which holds slice 0
+// of the file starting at mip firstMip
+//--------------------------------------------------------------------------------------
+static HRESULT FillMipInitData( _In_ const DDS_TEXTURE_LAYOUT& layout,
+                                _In_ UINT firstMip,
+                                _In_ UINT numMips,
+                                _In_reads_bytes_(mipDataSize) const uint8_t* mipData,
+                                _In_ size_t mipDataSize,
+                                _Out_writes_(numMips) D3D12_SUBRESOURCE_DATA* initData )
+{
+    if ( !mipData || !initData )
+    {
+        return E_POINTER;
+    }
+
+    for ( UINT i = 0; i < numMips; ++i )
+    {
+        const UINT mip = firstMip + i;
+        const size_t offset = layout.mipOffset[mip] - layout.mipOffset[firstMip];
+
+        if ( offset + layout.mipSize[mip] > mipDataSize )
+        {
+            return HRESULT_FROM_WIN32( ERROR_HANDLE_EOF );
+        }
+
+        size_t NumBytes = 0;
+        size_t RowBytes = 0;
+        GetSurfaceInfo( MipDimension( layout.width, mip ), MipDimension( layout.height, mip ), layout.format,
+                        &NumBytes, &RowBytes, nullptr );
+
+        initData[i].pData = mipData + offset;
+        initData[i].RowPitch = static_cast<UINT>( RowBytes );
+        initData[i].SlicePitch = static_cast<UINT>( NumBytes );
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Creates a texture holding mips [firstMip, mipCount) of the file and rewrites the view to match
+//--------------------------------------------------------------------------------------
+static HRESULT CreateMipRange( _In_ ID3D12Device* d3dDevice,
+                               _In_ const DDS_TEXTURE_LAYOUT& layout,
+                               _In_ UINT firstMip,
+                               _In_ bool forceSRGB,
+                               _Outptr_ ID3D12Resource** texture,
+                               _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    return CreateD3DResources( d3dDevice, D3D12_RESOURCE_DIMENSION_TEXTURE2D,
+                               MipDimension( layout.width, firstMip ), MipDimension( layout.height, firstMip ), 1,
+                               layout.mipCount - firstMip, 1, layout.format, forceSRGB, false, texture, textureView );
+}
+
+
+_Use_decl_annotations_
+HRESULT GetDDSTextureLayout(
+    const uint8_t* ddsData,
+    size_t ddsDataSize,
+    DDS_TEXTURE_LAYOUT* layout )
+{
+    if (!ddsData || !layout)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (ddsDataSize < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    {
+        return E_FAIL;
+    }
+
+    uint32_t dwMagicNumber = *( const uint32_t* )( ddsData );
+    if (dwMagicNumber != DDS_MAGIC)
+    {
+        return E_FAIL;
+    }
+
+    auto header = reinterpret_cast<const DDS_HEADER*>( ddsData + sizeof( uint32_t ) );
+
+    if (header->size != sizeof(DDS_HEADER) ||
+        header->ddspf.size != sizeof(DDS_PIXELFORMAT))
+    {
+        return E_FAIL;
+    }
+
+    size_t offset = sizeof(DDS_HEADER) + sizeof(uint32_t);
+
+    if (header->ddspf.flags & DDS_FOURCC)
+    {
+        if (MAKEFOURCC( 'D', 'X', '1', '0' ) == header->ddspf.fourCC)
+            offset += sizeof(DDS_HEADER_DXT10);
+    }
+
+    if (ddsDataSize < offset)
+        return E_FAIL;
+
+    HRESULT hr = GetTextureInfo( header, layout );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    layout->headerSize = offset;
+    layout->sliceSize = 0;
+
+    for ( UINT mip = 0; mip < layout->mipCount; ++mip )
+    {
+        size_t NumBytes = 0;
+        GetSurfaceInfo( MipDimension( layout->width, mip ), MipDimension( layout->height, mip ), layout->format,
+                        &NumBytes, nullptr, nullptr );
+
+        layout->mipOffset[mip] = layout->sliceSize;
+        layout->mipSize[mip] = NumBytes * MipDimension( layout->depth, mip );
+        layout->sliceSize += layout->mipSize[mip];
+    }
+
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+HRESULT CreateDDSTextureFromMipTail(
+    ID3D12Device* d3dDevice,
+    const DDS_TEXTURE_LAYOUT& layout,
+    UINT firstMip,
+    const uint8_t* mipData,
+    size_t mipDataSize,
+    bool forceSRGB,
+    ID3D12Resource** texture,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView )
+{
+    if ( texture )
+    {
+        *texture = nullptr;
+    }
+
+    if (!d3dDevice || !mipData || !texture || firstMip >= layout.mipCount)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!CanStreamDDSMips( layout ))
+    {
+        return HRESULT_FROM_WIN32( ERROR_NOT_SUPPORTED );
+    }
+
+    const UINT numMips = layout.mipCount - firstMip;
+
+    D3D12_SUBRESOURCE_DATA initData[D3D12_REQ_MIP_LEVELS];
+    HRESULT hr = FillMipInitData( layout, firstMip, numMips, mipData, mipDataSize, initData );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    hr = CreateMipRange( d3dDevice, layout, firstMip, forceSRGB, texture, textureView );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    GpuResource DestTexture(*texture, D3D12_RESOURCE_STATE_COPY_DEST);
+    CommandContext::InitializeTexture(DestTexture, numMips, initData);
+
+    (*texture)->SetName(L"DDSTextureLoader");
+
+    return S_OK;
+}
+
+
+_Use_decl_annotations_
+HRESULT ResizeDDSTextureMips(
+    ID3D12Device* d3dDevice,
+    const DDS_TEXTURE_LAYOUT& layout,
+    ID3D12Resource* currentTexture,
+    UINT currentFirstMip,
+    UINT newFirstMip,
+    const uint8_t* mipData,
+    size_t mipDataSize,
+    bool forceSRGB,
+    ID3D12Resource** texture,
+    D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+    uint64_t* fenceValue )
+{
+    if ( texture )
+    {
+        *texture = nullptr;
+    }
+
+    if (!d3dDevice || !currentTexture || !texture || !fenceValue ||
+        currentFirstMip >= layout.mipCount || newFirstMip >= layout.mipCount || newFirstMip == currentFirstMip)
+    {
+        return E_INVALIDARG;
+    }
+
+    // Mips above those already resident come from the file
+    const UINT numNewMips = newFirstMip < currentFirstMip ? currentFirstMip - newFirstMip : 0;
+
+    HRESULT hr = S_OK;
+
+    D3D12_SUBRESOURCE_DATA initData[D3D12_REQ_MIP_LEVELS];
+    if ( numNewMips > 0 )
+    {
+        hr = FillMipInitData( layout, newFirstMip, numNewMips, mipData, mipDataSize, initData );
+        if ( FAILED(hr) )
+        {
+            return hr;
+        }
+    }
+
+    // The view is only read when it is copied into a descriptor table, which no one does until this
+    // returns.  Work recorded after that runs on the graphics queue behind the copies below.
+    hr = CreateMipRange( d3dDevice, layout, newFirstMip, forceSRGB, texture, textureView );
+    if ( FAILED(hr) )
+    {
+        return hr;
+    }
+
+    GpuResource DestTexture(*texture, D3D12_RESOURCE_STATE_COPY_DEST);
+    GpuResource SrcTexture(currentTexture, D3D12_RESOURCE_STATE_GENERIC_READ);
+
+    // Every mip both textures hold is copied on the GPU
+    const UINT firstShared = newFirstMip > currentFirstMip ? newFirstMip : currentFirstMip;
+
+    CommandContext& Context = CommandContext::Begin(L"Resize DDS Mips");
+    for ( UINT mip = firstShared; mip < layout.mipCount; ++mip )
+        Context.CopySubresource(DestTexture, mip - newFirstMip, SrcTexture, mip - currentFirstMip);
+
+    // The new mips are uploaded by the same command list.  Upload memory is recycled by fence, so
+    // nothing here needs to wait.
+    if ( numNewMips > 0 )
+    {
+        const UINT64 uploadSize = GetRequiredIntermediateSize( *texture, 0, numNewMips );
+        DynAlloc mem = Context.ReserveUploadMemory( (size_t)uploadSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT );
+        UpdateSubresources( Context.GetCommandList(), *texture, mem.Buffer.GetResource(), mem.Offset, 0, numNewMips, initData );
+    }
+
+    Context.TransitionResource(DestTexture, D3D12_RESOURCE_STATE_GENERIC_READ);
+    *fenceValue = Context.Finish();
+
+    (*texture)->SetName(L"DDSTextureLoader");
+
+    return S_OK;
+}
@@ -56,3 +56,75 @@ HRESULT __cdecl CreateDDSTextureFromFile( _In_ ID3D12Device* d3dDevice,
                                             );
 
 size_t BitsPerPixel(_In_ DXGI_FORMAT fmt);
+
+//--------------------------------------------------------------------------------------
+// Progressive loading
+//
+// A DDS file stores each array slice's mips largest first, so the smallest mips of a 2D
+// texture are the last bytes of the file.  GetDDSTextureLayout() needs only the headers
+// (at most DDS_MAX_HEADER_SIZE bytes) to say where every mip is, which lets a loader read
+// and create just the mip tail, then add larger mips (or drop them) with further reads.
+//
+// Textures created this way hold mips [firstMip, mipCount) of the file: mip 0 of the
+// resource is mip firstMip of the file.  Only single 2D textures are supported.
+//--------------------------------------------------------------------------------------
+
+// Magic number, DDS_HEADER and DDS_HEADER_DXT10
+const size_t DDS_MAX_HEADER_SIZE = 4 + 124 + 20;
+
+struct DDS_TEXTURE_LAYOUT
+{
+    D3D12_RESOURCE_DIMENSION    dimension;
+    DXGI_FORMAT                 format;
+    UINT                        width;
+    UINT                        height;
+    UINT                        depth;
+    UINT                        mipCount;
+    UINT                        arraySize;      // Six per cube
+    bool                        isCubeMap;
+
+    size_t                      headerSize;     // The first slice's mip 0 starts here
+    size_t                      sliceSize;      // Bytes of every mip of one array slice
+    size_t                      mipOffset[D3D12_REQ_MIP_LEVELS];    // From the start of a slice
+    size_t                      mipSize[D3D12_REQ_MIP_LEVELS];
+};
+
+inline bool CanStreamDDSMips( const DDS_TEXTURE_LAYOUT& layout )
+{
+    return layout.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D && layout.arraySize == 1 && !layout.isCubeMap;
+}
+
+HRESULT __cdecl GetDDSTextureLayout( _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+                                     _In_ size_t ddsDataSize,
+                                     _Out_ DDS_TEXTURE_LAYOUT* layout
+                                     );
+
+// mipData holds mips [firstMip, mipCount) as stored in the file, i.e. the bytes starting at
+// headerSize + mipOffset[firstMip]
+HRESULT __cdecl CreateDDSTextureFromMipTail( _In_ ID3D12Device* d3dDevice,
+                                             _In_ const DDS_TEXTURE_LAYOUT& layout,
+                                             _In_ UINT firstMip,
+                                             _In_reads_bytes_(mipDataSize) const uint8_t* mipData,
+                                             _In_ size_t mipDataSize,
+                                             _In_ bool forceSRGB,
+                                             _Outptr_ ID3D12Resource** texture,
+                                             _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView
+                                             );
+
+// Creates a texture holding mips [newFirstMip, mipCount) from one holding [currentFirstMip,
+// mipCount) and points the view at it.  Mips both hold are copied on the GPU.  When growing,
+// mipData holds mips [newFirstMip, currentFirstMip) as stored in the file; when shrinking it
+// may be null.  Returns without waiting for the GPU:  currentTexture must be kept alive until
+// the graphics queue has passed fenceValue.
+HRESULT __cdecl ResizeDDSTextureMips( _In_ ID3D12Device* d3dDevice,
+                                      _In_ const DDS_TEXTURE_LAYOUT& layout,
+                                      _In_ ID3D12Resource* currentTexture,
+                                      _In_ UINT currentFirstMip,
+                                      _In_ UINT newFirstMip,
+                                      _In_reads_bytes_opt_(mipDataSize) const uint8_t* mipData,
+                                      _In_ size_t mipDataSize,
+                                      _In_ bool forceSRGB,
+                                      _Outptr_ ID3D12Resource** texture,
+                                      _In_ D3D12_CPU_DESCRIPTOR_HANDLE textureView,
+                                      _Out_ uint64_t* fenceValue
+                                      );
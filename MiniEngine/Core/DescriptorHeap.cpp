@@ -21,46 +21,89 @@ using namespace Graphics;
 //
 // DescriptorAllocator implementation
 //
-std::mutex DescriptorAllocator::sm_AllocationMutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DescriptorAllocator::sm_DescriptorHeapPool;
+DescriptorAllocator* DescriptorAllocator::sm_AllocatorList = nullptr;
+
+std::mutex& DescriptorAllocator::GetAllocationMutex( void )
+{
+    static std::mutex s_AllocationMutex;
+    return s_AllocationMutex;
+}
+
+DescriptorAllocator::DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t NumDescriptorsPerHeap)
+    : m_Type(Type), m_DescriptorSize(0)
+{
+    m_Allocator.Create(this, NumDescriptorsPerHeap);
+
+    // Allocators are usually globals, so this list is a plain pointer that needs no construction
+    std::lock_guard<std::mutex> LockGuard(GetAllocationMutex());
+    m_NextAllocator = sm_AllocatorList;
+    sm_AllocatorList = this;
+}
 
 void DescriptorAllocator::DestroyAll(void)
 {
+    // Allocate() holds an allocator's growth lock while CreateHeap() takes the allocation mutex, so Destroy(),
+    // which takes the growth lock, must not be called with the allocation mutex held.  Allocators are only ever
+    // pushed on the front of the list, so it can be walked from a snapshot of the head.
+    DescriptorAllocator* AllocatorList;
+    {
+        std::lock_guard<std::mutex> LockGuard(GetAllocationMutex());
+        AllocatorList = sm_AllocatorList;
+    }
+
+    for (DescriptorAllocator* Allocator = AllocatorList; Allocator != nullptr; Allocator = Allocator->m_NextAllocator)
+        Allocator->m_Allocator.Destroy();
+
+    std::lock_guard<std::mutex> LockGuard(GetAllocationMutex());
     sm_DescriptorHeapPool.clear();
 }
 
-ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_TYPE Type)
+void DescriptorAllocator::CreateHeap( uint32_t HeapIndex, uint32_t NumDescriptors )
 {
-    std::lock_guard<std::mutex> LockGuard(sm_AllocationMutex);
-
     D3D12_DESCRIPTOR_HEAP_DESC Desc;
-    Desc.Type = Type;
-    Desc.NumDescriptors = sm_NumDescriptorsPerHeap;
+    Desc.Type = m_Type;
+    Desc.NumDescriptors = NumDescriptors;
     Desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
     Desc.NodeMask = 1;
 
     Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> pHeap;
     ASSERT_SUCCEEDED(Graphics::g_Device->CreateDescriptorHeap(&Desc, MY_IID_PPV_ARGS(&pHeap)));
+
+    if (m_DescriptorSize == 0)
+        m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+
+    m_HeapStart[HeapIndex] = pHeap->GetCPUDescriptorHandleForHeapStart().ptr;
+
+    std::lock_guard<std::mutex> LockGuard(GetAllocationMutex());
     sm_DescriptorHeapPool.emplace_back(pHeap);
-    return pHeap.Get();
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate( uint32_t Count )
 {
-    if (m_CurrentHeap == nullptr || m_RemainingFreeHandles < Count)
-    {
-        m_CurrentHeap = RequestNewHeap(m_Type);
-        m_CurrentHandle = m_CurrentHeap->GetCPUDescriptorHandleForHeapStart();
-        m_RemainingFreeHandles = sm_NumDescriptorsPerHeap;
+    uint32_t HeapIndex, Offset;
+    m_Allocator.Allocate(Count, HeapIndex, Offset);
 
-        if (m_DescriptorSize == 0)
-            m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(m_Type);
+    D3D12_CPU_DESCRIPTOR_HANDLE ret;
+    ret.ptr = m_HeapStart[HeapIndex] + (SIZE_T)Offset * m_DescriptorSize;
+    return ret;
+}
+
+void DescriptorAllocator::Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count )
+{
+    const SIZE_T HeapBytes = (SIZE_T)m_Allocator.GetNumDescriptorsPerHeap() * m_DescriptorSize;
+    const uint32_t NumHeaps = m_Allocator.GetNumHeaps();
+
+    for (uint32_t HeapIndex = 0; HeapIndex < NumHeaps; ++HeapIndex)
+    {
+        if (Handle.ptr >= m_HeapStart[HeapIndex] && Handle.ptr < m_HeapStart[HeapIndex] + HeapBytes)
+        {
+            m_Allocator.Free(HeapIndex, uint32_t((Handle.ptr - m_HeapStart[HeapIndex]) / m_DescriptorSize), Count);
+            return;
+        }
     }
 
-    D3D12_CPU_DESCRIPTOR_HANDLE ret = m_CurrentHandle;
-    m_CurrentHandle.ptr += Count * m_DescriptorSize;
-    m_RemainingFreeHandles -= Count;
-    return ret;
+    ASSERT(false, "Descriptor handle does not belong to this allocator");
 }
 
 //
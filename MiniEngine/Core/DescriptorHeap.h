@@ -13,6 +13,7 @@
 
 #pragma once
 
+#include "DescriptorIndexAllocator.h"
 #include <mutex>
 #include <vector>
 #include <queue>
@@ -22,27 +23,37 @@
 // This is an unbounded resource descriptor allocator.  It is intended to provide space for CPU-visible resource descriptors
 // as resources are created.  For those that need to be made shader-visible, they will need to be copied to a UserDescriptorHeap
 // or a DynamicDescriptorHeap.
-class DescriptorAllocator
+//
+// Allocation and Free are thread-safe.  CPU descriptors are consumed when a command is recorded or descriptors are copied,
+// so a range may be freed as soon as the CPU is done with it; there is no need to wait on the GPU.
+class DescriptorAllocator : public IDescriptorHeapFactory
 {
 public:
-    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type) : m_Type(Type), m_CurrentHeap(nullptr) {}
+    DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t NumDescriptorsPerHeap = 1024);
 
     D3D12_CPU_DESCRIPTOR_HANDLE Allocate( uint32_t Count );
+    void Free( D3D12_CPU_DESCRIPTOR_HANDLE Handle, uint32_t Count );
+
+    uint32_t GetNumHeaps( void ) const { return m_Allocator.GetNumHeaps(); }
+    size_t GetNumAllocatedDescriptors( void ) const { return m_Allocator.GetNumAllocatedDescriptors(); }
 
     static void DestroyAll(void);
 
 protected:
 
-    static const uint32_t sm_NumDescriptorsPerHeap = 256;
-    static std::mutex sm_AllocationMutex;
+    virtual void CreateHeap( uint32_t HeapIndex, uint32_t NumDescriptors ) override;
+
+    // Allocators are constructed during static initialization, so the mutex is created on first use
+    static std::mutex& GetAllocationMutex( void );
+
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool;
-    static ID3D12DescriptorHeap* RequestNewHeap( D3D12_DESCRIPTOR_HEAP_TYPE Type );
+    static DescriptorAllocator* sm_AllocatorList;
 
     D3D12_DESCRIPTOR_HEAP_TYPE m_Type;
-    ID3D12DescriptorHeap* m_CurrentHeap;
-    D3D12_CPU_DESCRIPTOR_HANDLE m_CurrentHandle;
     uint32_t m_DescriptorSize;
-    uint32_t m_RemainingFreeHandles;
+    DescriptorIndexAllocator m_Allocator;
+    SIZE_T m_HeapStart[DescriptorIndexAllocator::kMaxHeaps];
+    DescriptorAllocator* m_NextAllocator;
 };
 
 
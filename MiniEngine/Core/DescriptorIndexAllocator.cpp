@@ -0,0 +1,113 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "DescriptorIndexAllocator.h"
+
+using namespace std;
+
+DescriptorIndexAllocator::DescriptorIndexAllocator()
+    : m_Factory(nullptr)
+    , m_NumDescriptorsPerHeap(0)
+    , m_MaxOrder(0)
+    , m_NumHeaps(0)
+    , m_CurrentHeap(0)
+    , m_NumAllocated(0)
+{
+}
+
+void DescriptorIndexAllocator::Create( IDescriptorHeapFactory* Factory, uint32_t NumDescriptorsPerHeap )
+{
+    ASSERT(Factory != nullptr);
+    ASSERT(Math::IsPowerOfTwo(NumDescriptorsPerHeap), "Descriptor heap size must be a power of two");
+
+    m_Factory = Factory;
+    m_NumDescriptorsPerHeap = NumDescriptorsPerHeap;
+    m_MaxOrder = GetOrder(NumDescriptorsPerHeap);
+}
+
+void DescriptorIndexAllocator::Destroy( void )
+{
+    lock_guard<mutex> LockGuard(m_GrowthMutex);
+
+    for (uint32_t i = 0; i < kMaxHeaps; ++i)
+        m_Heaps[i].reset();
+
+    m_NumHeaps = 0;
+    m_CurrentHeap = 0;
+    m_NumAllocated = 0;
+}
+
+uint32_t DescriptorIndexAllocator::GetOrder( uint32_t Count )
+{
+    if (Count <= 1)
+        return 0;
+
+    unsigned long mssb;
+    _BitScanReverse(&mssb, Count - 1);
+    return mssb + 1;
+}
+
+void DescriptorIndexAllocator::Allocate( uint32_t Count, uint32_t& HeapIndex, uint32_t& Offset )
+{
+    const uint32_t Order = GetOrder(Count);
+    ASSERT(Order <= m_MaxOrder, "Descriptor allocation is larger than a descriptor heap");
+
+    uint32_t NumHeaps = m_NumHeaps.load(memory_order_acquire);
+
+    for (;;)
+    {
+        // Start with the heap that worked last time; the others are usually full
+        const uint32_t StartHeap = NumHeaps > 0 ? m_CurrentHeap.load(memory_order_relaxed) % NumHeaps : 0;
+        for (uint32_t i = 0; i < NumHeaps; ++i)
+        {
+            const uint32_t Heap = (StartHeap + i) % NumHeaps;
+            if (m_Heaps[Heap]->Allocate(Order, Offset) == kBuddySuccess)
+            {
+                if (Heap != StartHeap)
+                    m_CurrentHeap = Heap;
+
+                HeapIndex = Heap;
+                m_NumAllocated += (size_t)1 << Order;
+                return;
+            }
+        }
+
+        lock_guard<mutex> LockGuard(m_GrowthMutex);
+
+        // Someone else may have added a heap while we were searching
+        const uint32_t LatestNumHeaps = m_NumHeaps.load(memory_order_acquire);
+        if (LatestNumHeaps == NumHeaps)
+        {
+            ASSERT(NumHeaps < kMaxHeaps, "Out of descriptor heaps.  Increase the heap size.");
+
+            m_Factory->CreateHeap(NumHeaps, m_NumDescriptorsPerHeap);
+
+            ConcurrentBuddyAllocator* NewHeap = new ConcurrentBuddyAllocator;
+            NewHeap->Create(m_MaxOrder, nullptr);
+            m_Heaps[NumHeaps].reset(NewHeap);
+
+            m_CurrentHeap = NumHeaps;
+            m_NumHeaps.store(NumHeaps + 1, memory_order_release);
+        }
+
+        NumHeaps = m_NumHeaps.load(memory_order_acquire);
+    }
+}
+
+void DescriptorIndexAllocator::Free( uint32_t HeapIndex, uint32_t Offset, uint32_t Count )
+{
+    ASSERT(HeapIndex < GetNumHeaps());
+
+    const uint32_t Order = GetOrder(Count);
+    m_Heaps[HeapIndex]->Free(Offset, Order);
+    m_NumAllocated -= (size_t)1 << Order;
+}
@@ -0,0 +1,69 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Device-independent bookkeeping for CPU descriptor heaps.  Descriptors are identified
+// by (heap index, offset) and every heap is a ConcurrentBuddyAllocator over its descriptor indices, so
+// small allocations come out of per-thread caches and freed ranges coalesce back into larger ones.
+// New heaps are requested from an IDescriptorHeapFactory only when every existing heap is full.
+//
+
+#pragma once
+
+#include "ConcurrentBuddyAllocator.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+class IDescriptorHeapFactory
+{
+public:
+    virtual ~IDescriptorHeapFactory() {}
+
+    // Called with the allocator's growth lock held, before the heap is visible to other threads.  Any lock it
+    // takes must never be held while calling Destroy(), which takes the growth lock too.
+    virtual void CreateHeap( uint32_t HeapIndex, uint32_t NumDescriptors ) = 0;
+};
+
+class DescriptorIndexAllocator
+{
+public:
+    static const uint32_t kMaxHeaps = 256;
+
+    DescriptorIndexAllocator();
+    ~DescriptorIndexAllocator() { Destroy(); }
+
+    // NumDescriptorsPerHeap must be a power of two
+    void Create( IDescriptorHeapFactory* Factory, uint32_t NumDescriptorsPerHeap );
+    void Destroy( void );
+
+    // Safe to call from any thread.  Count is rounded up to a power of two internally.
+    void Allocate( uint32_t Count, uint32_t& HeapIndex, uint32_t& Offset );
+    void Free( uint32_t HeapIndex, uint32_t Offset, uint32_t Count );
+
+    uint32_t GetNumHeaps( void ) const { return m_NumHeaps.load(std::memory_order_acquire); }
+    uint32_t GetNumDescriptorsPerHeap( void ) const { return m_NumDescriptorsPerHeap; }
+    size_t GetNumAllocatedDescriptors( void ) const { return m_NumAllocated; }
+
+private:
+    static uint32_t GetOrder( uint32_t Count );
+
+    IDescriptorHeapFactory* m_Factory;
+    uint32_t m_NumDescriptorsPerHeap;
+    uint32_t m_MaxOrder;
+
+    std::unique_ptr<ConcurrentBuddyAllocator> m_Heaps[kMaxHeaps];
+    std::atomic<uint32_t> m_NumHeaps;
+
+    // The heap that satisfied the last allocation, where the next search starts
+    std::atomic<uint32_t> m_CurrentHeap;
+
+    std::mutex m_GrowthMutex;
+    std::atomic<size_t> m_NumAllocated;
+};
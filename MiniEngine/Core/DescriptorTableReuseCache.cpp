@@ -0,0 +1,106 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "DescriptorTableReuseCache.h"
+#include "Hash.h"
+
+DescriptorTableReuseCache::DescriptorTableReuseCache()
+    : m_Generation(1)
+    , m_NumEntries(0)
+{
+    memset(m_Slots, 0, sizeof(m_Slots));
+    m_KeyStorage.reserve(1024);
+    ResetStatistics();
+}
+
+void DescriptorTableReuseCache::BuildKey( const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t AssignedHandlesBitMap, uint32_t TableSize, TableKey& Key )
+{
+    // Unassigned entries hold stale handles, so only the assigned ones are part of the key
+    Key.Words[0] = (uint64_t)TableSize << 32 | AssignedHandlesBitMap;
+    Key.NumWords = 1;
+
+    unsigned long Index;
+    uint32_t Remaining = AssignedHandlesBitMap;
+    while (_BitScanForward(&Index, Remaining))
+    {
+        Remaining ^= (1u << Index);
+        Key.Words[Key.NumWords++] = Handles[Index].ptr;
+    }
+
+    Key.NumDescriptors = Key.NumWords - 1;
+    Key.Hash = Utility::HashState(Key.Words, Key.NumWords);
+}
+
+bool DescriptorTableReuseCache::Find( const TableKey& Key, uint32_t& HeapOffset )
+{
+    ++m_Statistics.Lookups;
+
+    for (uint32_t SlotIdx = (uint32_t)Key.Hash; ; ++SlotIdx)
+    {
+        const Slot& S = m_Slots[SlotIdx % kNumSlots];
+        if (S.Generation != m_Generation)
+            return false;
+
+        if (S.Hash == Key.Hash && S.NumWords == Key.NumWords &&
+            memcmp(&m_KeyStorage[S.KeyOffset], Key.Words, Key.NumWords * sizeof(uint64_t)) == 0)
+        {
+            ++m_Statistics.Hits;
+            m_Statistics.DescriptorsSaved += Key.NumDescriptors;
+            HeapOffset = S.HeapOffset;
+            return true;
+        }
+    }
+}
+
+void DescriptorTableReuseCache::Insert( const TableKey& Key, uint32_t HeapOffset )
+{
+    // Past this point probes get long; the remaining tables in this heap are simply copied
+    if (m_NumEntries >= kMaxEntries)
+        return;
+
+    uint32_t SlotIdx = (uint32_t)Key.Hash;
+    while (m_Slots[SlotIdx % kNumSlots].Generation == m_Generation)
+        ++SlotIdx;
+
+    Slot& S = m_Slots[SlotIdx % kNumSlots];
+    S.Hash = Key.Hash;
+    S.Generation = m_Generation;
+    S.KeyOffset = (uint32_t)m_KeyStorage.size();
+    S.NumWords = Key.NumWords;
+    S.HeapOffset = HeapOffset;
+
+    m_KeyStorage.insert(m_KeyStorage.end(), Key.Words, Key.Words + Key.NumWords);
+    ++m_NumEntries;
+}
+
+void DescriptorTableReuseCache::Clear( void )
+{
+    if (m_NumEntries == 0)
+        return;
+
+    // Bumping the generation invalidates every slot without touching them
+    if (++m_Generation == 0)
+    {
+        memset(m_Slots, 0, sizeof(m_Slots));
+        m_Generation = 1;
+    }
+
+    m_NumEntries = 0;
+    m_KeyStorage.clear();
+}
+
+void DescriptorTableReuseCache::ResetStatistics( void )
+{
+    m_Statistics.Lookups = 0;
+    m_Statistics.Hits = 0;
+    m_Statistics.DescriptorsSaved = 0;
+}
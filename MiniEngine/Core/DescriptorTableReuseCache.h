@@ -0,0 +1,79 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Remembers which descriptor tables have already been copied into the current shader-visible
+// heap.  A table is identified by its layout (size and assigned-handle mask) plus every assigned CPU handle,
+// so binding the same set of handles again can point at the earlier copy instead of copying it anew.
+//
+// Lookups hash the key and then compare it in full, so a hash collision never aliases two tables.  The
+// cache must be cleared whenever the heap it describes is retired.  It never touches the device.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class DescriptorTableReuseCache
+{
+public:
+
+    // A table's handle mask is 32 bits wide, so a key is at most one layout word plus 32 handles
+    static const uint32_t kMaxKeyWords = 33;
+
+    struct TableKey
+    {
+        uint64_t Hash;
+        uint32_t NumWords;
+        uint32_t NumDescriptors;    // Assigned handles, i.e. descriptors a hit saves copying
+        uint64_t Words[kMaxKeyWords];
+    };
+
+    struct Statistics
+    {
+        uint64_t Lookups;
+        uint64_t Hits;
+        uint64_t DescriptorsSaved;
+    };
+
+    DescriptorTableReuseCache();
+
+    static void BuildKey( const D3D12_CPU_DESCRIPTOR_HANDLE* Handles, uint32_t AssignedHandlesBitMap, uint32_t TableSize, TableKey& Key );
+
+    // Returns the heap offset (in descriptors) of an identical table copied since the last Clear()
+    bool Find( const TableKey& Key, uint32_t& HeapOffset );
+    void Insert( const TableKey& Key, uint32_t HeapOffset );
+
+    void Clear( void );
+
+    const Statistics& GetStatistics( void ) const { return m_Statistics; }
+    void ResetStatistics( void );
+
+private:
+
+    static const uint32_t kNumSlots = 1024;     // One per descriptor in a dynamic heap, so at least one per table
+    static const uint32_t kMaxEntries = kNumSlots * 3 / 4;
+
+    struct Slot
+    {
+        uint64_t Hash;
+        uint32_t Generation;
+        uint32_t KeyOffset;
+        uint32_t NumWords;
+        uint32_t HeapOffset;
+    };
+
+    Slot m_Slots[kNumSlots];
+    uint32_t m_Generation;
+    uint32_t m_NumEntries;
+    std::vector<uint64_t> m_KeyStorage;
+
+    Statistics m_Statistics;
+};
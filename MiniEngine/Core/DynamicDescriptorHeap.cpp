@@ -28,6 +28,13 @@ std::mutex DynamicDescriptorHeap::sm_Mutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::sm_DescriptorHeapPool[2];
 std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::sm_RetiredDescriptorHeaps[2];
 std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::sm_AvailableDescriptorHeaps[2];
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_TableLookups(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_TableHits(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::sm_DescriptorsSaved(0);
+std::atomic<uint32_t> DynamicDescriptorHeap::sm_DescriptorRewrites(0);
+
+// Reuse relies on InvalidateReusedTables() being called whenever a CPU descriptor is rewritten or freed
+static BoolVar s_ReuseDescriptorTables("Graphics/Reuse Descriptor Tables", true);
 
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType)
 {
@@ -82,6 +89,9 @@ void DynamicDescriptorHeap::RetireCurrentHeap( void )
     m_RetiredHeaps.push_back(m_CurrentHeapPtr);
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
+
+    // Cached tables point into the heap we just gave up
+    m_TableReuseCache.Clear();
 }
 
 void DynamicDescriptorHeap::RetireUsedHeaps( uint64_t fenceValue )
@@ -96,6 +106,7 @@ DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& OwningContext, D3D1
     m_CurrentHeapPtr = nullptr;
     m_CurrentOffset = 0;
     m_DescriptorSize = Graphics::g_Device->GetDescriptorHandleIncrementSize(HeapType);
+    m_SeenDescriptorRewrites = sm_DescriptorRewrites;
 }
 
 DynamicDescriptorHeap::~DynamicDescriptorHeap()
@@ -108,6 +119,21 @@ void DynamicDescriptorHeap::CleanupUsedHeaps( uint64_t fenceValue )
     RetireUsedHeaps(fenceValue);
     m_GraphicsHandleCache.ClearCache();
     m_ComputeHandleCache.ClearCache();
+
+    const DescriptorTableReuseCache::Statistics& Stats = m_TableReuseCache.GetStatistics();
+    sm_TableLookups += Stats.Lookups;
+    sm_TableHits += Stats.Hits;
+    sm_DescriptorsSaved += Stats.DescriptorsSaved;
+    m_TableReuseCache.ResetStatistics();
+}
+
+DescriptorTableReuseCache::Statistics DynamicDescriptorHeap::GetTableReuseStatistics( void )
+{
+    DescriptorTableReuseCache::Statistics Stats;
+    Stats.Lookups = sm_TableLookups;
+    Stats.Hits = sm_TableHits;
+    Stats.DescriptorsSaved = sm_DescriptorsSaved;
+    return Stats;
 }
 
 inline ID3D12DescriptorHeap* DynamicDescriptorHeap::GetHeapPointer()
@@ -143,11 +169,14 @@ uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
     return NeededSpace;
 }
 
-void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
+uint32_t DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize,
-    DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
+    DescriptorHandle HeapStart, uint32_t HeapOffset, DescriptorTableReuseCache* ReuseCache,
+    ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
 {
+    const uint32_t FirstOffset = HeapOffset;
+
     uint32_t StaleParamCount = 0;
     uint32_t TableSize[DescriptorHandleCache::kMaxNumDescriptorTables];
     uint32_t RootIndices[DescriptorHandleCache::kMaxNumDescriptorTables];
@@ -188,14 +217,30 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
     for (uint32_t i = 0; i < StaleParamCount; ++i)
     {
         RootIndex = RootIndices[i];
-        (CmdList->*SetFunc)(RootIndex, DestHandleStart.GetGpuHandle());
-
         DescriptorTableCache& RootDescTable = m_RootDescriptorTable[RootIndex];
 
+        if (ReuseCache != nullptr)
+        {
+            DescriptorTableReuseCache::TableKey Key;
+            DescriptorTableReuseCache::BuildKey(RootDescTable.TableStart, RootDescTable.AssignedHandlesBitMap, TableSize[i], Key);
+
+            uint32_t ReusedOffset;
+            if (ReuseCache->Find(Key, ReusedOffset))
+            {
+                (CmdList->*SetFunc)(RootIndex, (HeapStart + ReusedOffset * DescriptorSize).GetGpuHandle());
+                continue;
+            }
+
+            ReuseCache->Insert(Key, HeapOffset);
+        }
+
+        DescriptorHandle DestHandleStart = HeapStart + HeapOffset * DescriptorSize;
+        (CmdList->*SetFunc)(RootIndex, DestHandleStart.GetGpuHandle());
+        HeapOffset += TableSize[i];
+
         D3D12_CPU_DESCRIPTOR_HANDLE* SrcHandles = RootDescTable.TableStart;
         uint64_t SetHandles = (uint64_t)RootDescTable.AssignedHandlesBitMap;
         D3D12_CPU_DESCRIPTOR_HANDLE CurDest = DestHandleStart.GetCpuHandle();
-        DestHandleStart += TableSize[i] * DescriptorSize;
 
         unsigned long SkipCount;
         while (_BitScanForward64(&SkipCount, SetHandles))
@@ -240,12 +285,17 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
         }
     }
 
-    g_Device->CopyDescriptors(
-        NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
-        NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
-        Type);
+    if (NumDestDescriptorRanges > 0)
+    {
+        g_Device->CopyDescriptors(
+            NumDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
+            NumSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
+            Type);
+    }
+
+    return HeapOffset - FirstOffset;
 }
-    
+
 void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& HandleCache, ID3D12GraphicsCommandList* CmdList,
     void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE))
 {
@@ -259,7 +309,18 @@ void DynamicDescriptorHeap::CopyAndBindStagedTables( DescriptorHandleCache& Hand
 
     // This can trigger the creation of a new heap
     m_OwningContext.SetDescriptorHeap(m_DescriptorType, GetHeapPointer());
-    HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, Allocate(NeededSize), CmdList, SetFunc);
+
+    // A table copied before a descriptor it holds was rewritten would bind the old view
+    const uint32_t DescriptorRewrites = sm_DescriptorRewrites;
+    if (DescriptorRewrites != m_SeenDescriptorRewrites)
+    {
+        m_TableReuseCache.Clear();
+        m_SeenDescriptorRewrites = DescriptorRewrites;
+    }
+
+    // NeededSize is the worst case; tables found in the reuse cache take no space
+    m_CurrentOffset += HandleCache.CopyAndBindStaleTables(m_DescriptorType, m_DescriptorSize, m_FirstDescriptor, m_CurrentOffset,
+        s_ReuseDescriptorTables ? &m_TableReuseCache : nullptr, CmdList, SetFunc);
 }
 
 void DynamicDescriptorHeap::UnbindAllValid( void )
@@ -15,6 +15,8 @@
 
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include "DescriptorTableReuseCache.h"
+#include <atomic>
 #include <vector>
 #include <queue>
 
@@ -25,7 +27,8 @@ namespace Graphics
 
 // This class is a linear allocation system for dynamically generated descriptor tables.  It internally caches
 // CPU descriptor handles so that when not enough space is available in the current heap, necessary descriptors
-// can be re-copied to the new heap.
+// can be re-copied to the new heap.  Tables whose handles match one already copied into the current heap are
+// bound to that copy instead of being copied again.
 class DynamicDescriptorHeap
 {
 public:
@@ -40,6 +43,13 @@ public:
 
     void CleanupUsedHeaps( uint64_t fenceValue );
 
+    // Call after rewriting a CPU descriptor in place, or freeing one that may be handed out again.  Tables copied
+    // from it earlier can no longer be reused, so every context drops its reuse cache before the next lookup.
+    static void InvalidateReusedTables( void ) { ++sm_DescriptorRewrites; }
+
+    // Totals across all contexts for tables looked up in, and served from, the reuse cache
+    static DescriptorTableReuseCache::Statistics GetTableReuseStatistics( void );
+
     // Copy multiple handles into the cache area reserved for the specified root parameter.
     void SetGraphicsDescriptorHandles( UINT RootIndex, UINT Offset, UINT NumHandles, const D3D12_CPU_DESCRIPTOR_HANDLE Handles[] )
     {
@@ -86,6 +96,10 @@ private:
     static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> sm_DescriptorHeapPool[2];
     static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> sm_RetiredDescriptorHeaps[2];
     static std::queue<ID3D12DescriptorHeap*> sm_AvailableDescriptorHeaps[2];
+    static std::atomic<uint64_t> sm_TableLookups;
+    static std::atomic<uint64_t> sm_TableHits;
+    static std::atomic<uint64_t> sm_DescriptorsSaved;
+    static std::atomic<uint32_t> sm_DescriptorRewrites;
 
     // Static methods
     static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE HeapType);
@@ -99,6 +113,8 @@ private:
     uint32_t m_CurrentOffset;
     DescriptorHandle m_FirstDescriptor;
     std::vector<ID3D12DescriptorHeap*> m_RetiredHeaps;
+    DescriptorTableReuseCache m_TableReuseCache;
+    uint32_t m_SeenDescriptorRewrites;
 
     // Describes a descriptor table entry:  a region of the handle cache and which handles have been set
     struct DescriptorTableCache
@@ -130,7 +146,10 @@ private:
         static const uint32_t kMaxNumDescriptorTables = 16;
 
         uint32_t ComputeStagedSize();
-        void CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle DestHandleStart, ID3D12GraphicsCommandList* CmdList,
+
+        // Returns the number of descriptors used starting at HeapOffset.  Without a reuse cache every table is copied.
+        uint32_t CopyAndBindStaleTables( D3D12_DESCRIPTOR_HEAP_TYPE Type, uint32_t DescriptorSize, DescriptorHandle HeapStart, uint32_t HeapOffset,
+            DescriptorTableReuseCache* ReuseCache, ID3D12GraphicsCommandList* CmdList,
             void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE));
 
         DescriptorTableCache m_RootDescriptorTable[kMaxNumDescriptorTables];
@@ -153,13 +172,6 @@ private:
     void RetireUsedHeaps( uint64_t fenceValue );
     ID3D12DescriptorHeap* GetHeapPointer();
 
-    DescriptorHandle Allocate( UINT Count )
-    {
-        DescriptorHandle ret = m_FirstDescriptor + m_CurrentOffset * m_DescriptorSize;
-        m_CurrentOffset += Count;
-        return ret;
-    }
-
     void CopyAndBindStagedTables( DescriptorHandleCache& HandleCache, ID3D12GraphicsCommandList* CmdList,
         void (STDMETHODCALLTYPE ID3D12GraphicsCommandList::*SetFunc)(UINT, D3D12_GPU_DESCRIPTOR_HANDLE) );
 
@@ -19,6 +19,10 @@
 #include "GameInput.h"
 #include "GpuTimeManager.h"
 #include "CommandContext.h"
+#include "TraceCapture.h"
+#include "ProfilingScopes.h"
+#include "QuantileSketch.h"
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <array>
@@ -32,6 +36,9 @@ using namespace std;
 namespace EngineProfiling
 {
     bool Paused = false;
+
+    // A hitch is a frame that takes this many times as long as the average of those before it
+    NumVar HitchFactor("Profiling/Hitch Factor", 2.0f, 1.25f, 10.0f, 0.25f);
 }
 
 class StatHistory
@@ -53,6 +60,7 @@ public:
         m_RecentHistory[FrameIndex % kHistorySize] = Value;
         m_ExtendedHistory[FrameIndex % kExtendedHistorySize] = Value;
         m_Recent = Value;
+        m_Sketch.Add(Value);
 
         uint32_t ValidCount = 0;
         m_Minimum = FLT_MAX;
@@ -84,6 +92,11 @@ public:
     const float* GetHistory(void) const { return m_ExtendedHistory; }
     uint32_t GetHistoryLength(void) const { return kExtendedHistorySize; }
 
+    // Over every frame since the last reset, rather than the recent history
+    float GetPercentile(float Percent) const { return m_Sketch.GetQuantile(Percent * 0.01f); }
+    const QuantileSketch& GetSketch(void) const { return m_Sketch; }
+    void ResetSketch(void) { m_Sketch.Reset(); }
+
 private:
     static const uint32_t kHistorySize = 64;
     static const uint32_t kExtendedHistorySize = 256;
@@ -93,6 +106,7 @@ private:
     float m_Average;
     float m_Minimum;
     float m_Maximum;
+    QuantileSketch m_Sketch;
 };
 
 class StatPlot
@@ -158,44 +172,13 @@ private:
     vector<StatGraph> m_Graphs;
 };
 
-class GpuTimer
-{
-public:
-
-    GpuTimer::GpuTimer()
-    {
-        m_TimerIndex = GpuTimeManager::NewTimer();
-    }
-
-    void Start(CommandContext& Context)
-    {
-        GpuTimeManager::StartTimer(Context, m_TimerIndex);
-    }
-
-    void Stop(CommandContext& Context)
-    {
-        GpuTimeManager::StopTimer(Context, m_TimerIndex);
-    }
-
-    float GpuTimer::GetTime(void)
-    {
-        return GpuTimeManager::GetTime(m_TimerIndex);
-    }
-
-    uint32_t GetTimerIndex(void)
-    {
-        return m_TimerIndex;
-    }
-private:
-
-    uint32_t m_TimerIndex;
-};
-
 class NestedTimingTree
 {
 public:
     NestedTimingTree( const wstring& name, NestedTimingTree* parent = nullptr )
-        : m_Name(name), m_Parent(parent), m_IsExpanded(false), m_IsGraphed(false), m_GraphHandle(PERF_GRAPH_ERROR) {}
+        : m_Name(name), m_Parent(parent), m_CpuTicks(0), m_IsExpanded(false), m_IsGraphed(false),
+        m_GraphHandle(PERF_GRAPH_ERROR), m_TraceNameId(TraceCapture::RegisterName(name)),
+        m_Depth(parent == nullptr ? 0 : (uint16_t)(parent->m_Depth + 1)) {}
 
     NestedTimingTree* GetChild( const wstring& name )
     {
@@ -281,48 +264,73 @@ public:
         return nullptr;
     }
 
-    void StartTiming( CommandContext* Context )
+    // Adds a scope closed on some thread to the frame's time.  Samples of a scope that ran more than once,
+    // or on more than one thread, are summed.
+    void AddSample( const ProfilingScopes::Sample& Sample, uint32_t FrameIndex )
     {
-        m_StartTick = SystemTime::GetCurrentTick();
-        if (Context == nullptr)
-            return;
+        m_CpuTicks += Sample.End - Sample.Begin;
 
-        m_GpuTimer.Start(*Context);
+        if (Sample.GpuTimerIdx != 0 && find(m_GpuTimers.begin(), m_GpuTimers.end(), Sample.GpuTimerIdx) == m_GpuTimers.end())
+            m_GpuTimers.push_back(Sample.GpuTimerIdx);
 
-        Context->PIXBeginEvent(m_Name.c_str());
-    }
-
-    void StopTiming( CommandContext* Context )
-    {
-        m_EndTick = SystemTime::GetCurrentTick();
-        if (Context == nullptr)
-            return;
-
-        m_GpuTimer.Stop(*Context);
-
-        Context->PIXEndEvent();
+        // The samples are from the frame before FrameIndex
+        if (TraceCapture::IsCapturing() && !EngineProfiling::Paused)
+        {
+            TraceCapture::Event Event = {};
+            Event.Begin = Sample.Begin;
+            Event.End = Sample.End;
+            Event.Frame = FrameIndex > 0 ? FrameIndex - 1 : 0;
+            Event.NameId = m_TraceNameId;
+            Event.ThreadId = Sample.ThreadId;
+            Event.Depth = m_Depth;
+            Event.Timeline = TraceCapture::kCpu;
+            TraceCapture::Record(Event);
+        }
     }
 
     void GatherTimes(uint32_t FrameIndex)
     {
-        if (sm_SelectedScope == this)
+        if (sm_SelectedScope == this && !m_GpuTimers.empty())
         {
-            GraphRenderer::SetSelectedIndex(m_GpuTimer.GetTimerIndex());
+            GraphRenderer::SetSelectedIndex(m_GpuTimers[0]);
         }
         if (EngineProfiling::Paused)
         {
+            m_CpuTicks = 0;
             for (auto node : m_Children)
                 node->GatherTimes(FrameIndex);
             return;
         }
-        m_CpuTime.RecordStat(FrameIndex, 1000.0f * (float)SystemTime::TimeBetweenTicks(m_StartTick, m_EndTick));
-        m_GpuTime.RecordStat(FrameIndex, 1000.0f * m_GpuTimer.GetTime());
+
+        // Each thread that timed the scope on a command context has a timer of its own
+        float GpuTime = 0.0f;
+        for (uint32_t TimerIdx : m_GpuTimers)
+        {
+            GpuTime += GpuTimeManager::GetTime(TimerIdx);
+            if (TraceCapture::IsCapturing())
+                CaptureGpuTimes(TimerIdx, FrameIndex);
+        }
+
+        m_CpuTime.RecordStat(FrameIndex, 1000.0f * (float)SystemTime::TicksToSeconds(m_CpuTicks));
+        m_GpuTime.RecordStat(FrameIndex, 1000.0f * GpuTime);
+        m_CpuTicks = 0;
 
         for (auto node : m_Children)
             node->GatherTimes(FrameIndex);
+    }
+
+    // GPU times are read back two frames after they were recorded
+    void CaptureGpuTimes(uint32_t TimerIdx, uint32_t FrameIndex)
+    {
+        TraceCapture::Event Event = {};
+        if (!GpuTimeManager::GetTimeStamps(TimerIdx, Event.Begin, Event.End))
+            return;
 
-        m_StartTick = 0;
-        m_EndTick = 0;
+        Event.Frame = FrameIndex > 1 ? FrameIndex - 2 : 0;
+        Event.NameId = m_TraceNameId;
+        Event.Depth = m_Depth;
+        Event.Timeline = TraceCapture::kGpu;
+        TraceCapture::Record(Event);
     }
 
     void SumInclusiveTimes(float& cpuTime, float& gpuTime)
@@ -336,18 +344,22 @@ public:
         }
     }
 
-    static void PushProfilingMarker( const wstring& name, CommandContext* Context );
-    static void PopProfilingMarker( CommandContext* Context );
     static void Update( void );
+    static void MergeScopes( uint32_t FrameIndex );
     static void UpdateTimes( void )
     {
         uint32_t FrameIndex = (uint32_t)Graphics::GetFrameCount();
 
+        MergeScopes(FrameIndex);
+
         GpuTimeManager::BeginReadBack();
         sm_RootScope.GatherTimes(FrameIndex);
         s_FrameDelta.RecordStat(FrameIndex, GpuTimeManager::GetTime(0));
         GpuTimeManager::EndReadBack();
 
+        if (!EngineProfiling::Paused)
+            RecordFrameTime(FrameIndex, 1000.0f * Graphics::GetFrameTime());
+
         float TotalCpuTime, TotalGpuTime;
         sm_RootScope.SumInclusiveTimes(TotalCpuTime, TotalGpuTime);
         s_TotalCpuTime.RecordStat(FrameIndex, TotalCpuTime);
@@ -356,6 +368,52 @@ public:
         GraphRenderer::Update(XMFLOAT2(TotalCpuTime, TotalGpuTime), 0, GraphType::Global);
     }
 
+    // Compares the frame with the average of the recent ones before adding it, so that a hitch doesn't hide
+    // itself.  Small variations of fast frames aren't hitches.
+    static void RecordFrameTime( uint32_t FrameIndex, float FrameTime )
+    {
+        const float Typical = s_FrameTime.GetAvg();
+        s_FrameTime.RecordStat(FrameIndex, FrameTime);
+
+        if (Typical > 0.0f && FrameTime > Typical * EngineProfiling::HitchFactor && FrameTime - Typical > 1.0f)
+        {
+            ++sm_NumHitches;
+            sm_LastHitchFrame = FrameIndex;
+            sm_LastHitchTime = FrameTime;
+        }
+    }
+
+    static void ResetStatistics( void )
+    {
+        s_FrameTime.ResetSketch();
+        s_TotalCpuTime.ResetSketch();
+        s_TotalGpuTime.ResetSketch();
+        sm_RootScope.ResetSketches();
+        sm_NumHitches = 0;
+        sm_LastHitchFrame = 0;
+        sm_LastHitchTime = 0.0f;
+    }
+
+    static void GetStatSummaries( vector<EngineProfiling::StatSummary>& Summaries )
+    {
+        AddSummary(Summaries, L"Frame Time", s_FrameTime);
+        AddSummary(Summaries, L"Total CPU", s_TotalCpuTime);
+        AddSummary(Summaries, L"Total GPU", s_TotalGpuTime);
+        for (auto node : sm_RootScope.m_Children)
+            node->SummarizeNode(L"", Summaries);
+    }
+
+    static void DisplayFrameTimes( TextContext& Text )
+    {
+        Text.DrawFormattedString("Frame time: p50 %6.3f, p95 %6.3f, p99 %6.3f ms over %llu frames, %u hitches",
+            s_FrameTime.GetPercentile(50.0f), s_FrameTime.GetPercentile(95.0f), s_FrameTime.GetPercentile(99.0f),
+            s_FrameTime.GetSketch().GetCount(), sm_NumHitches);
+        if (sm_NumHitches > 0)
+            Text.DrawFormattedString(" (last %.1f ms on frame %u)", sm_LastHitchTime, sm_LastHitchFrame);
+        Text.NewLine();
+    }
+
+    static uint32_t GetHitchCount(void) { return sm_NumHitches; }
     static float GetTotalCpuTime(void) { return s_TotalCpuTime.GetAvg(); }
     static float GetTotalGpuTime(void) { return s_TotalGpuTime.GetAvg(); }
     static float GetFrameDelta(void) { return s_FrameDelta.GetAvg(); }
@@ -381,6 +439,42 @@ public:
 private:
 
     void DisplayNode( TextContext& Text, float x, float indent );
+    static NestedTimingTree* FindNode( const ProfilingScopes::Node* Scope );
+
+    void ResetSketches( void )
+    {
+        m_CpuTime.ResetSketch();
+        m_GpuTime.ResetSketch();
+        for (auto node : m_Children)
+            node->ResetSketches();
+    }
+
+    // Scopes are named by their path from the root, and only those that were timed are included
+    void SummarizeNode( const wstring& ParentPath, vector<EngineProfiling::StatSummary>& Summaries )
+    {
+        const wstring Path = ParentPath.empty() ? m_Name : ParentPath + L"/" + m_Name;
+        AddSummary(Summaries, L"CPU/" + Path, m_CpuTime);
+        AddSummary(Summaries, L"GPU/" + Path, m_GpuTime);
+        for (auto node : m_Children)
+            node->SummarizeNode(Path, Summaries);
+    }
+
+    static void AddSummary( vector<EngineProfiling::StatSummary>& Summaries, const wstring& Name, const StatHistory& Stat )
+    {
+        const QuantileSketch& Sketch = Stat.GetSketch();
+        if (Sketch.GetCount() == 0)
+            return;
+
+        EngineProfiling::StatSummary Summary;
+        Summary.Name = Name;
+        Summary.Count = Sketch.GetCount();
+        Summary.Average = Sketch.GetAverage();
+        Summary.P50 = Sketch.GetQuantile(0.50f);
+        Summary.P95 = Sketch.GetQuantile(0.95f);
+        Summary.P99 = Sketch.GetQuantile(0.99f);
+        Summary.Maximum = Sketch.GetMaximum();
+        Summaries.push_back(Summary);
+    }
     void StoreToGraph(void);
     void DeleteChildren( void )
     {
@@ -393,19 +487,24 @@ private:
     NestedTimingTree* m_Parent;
     vector<NestedTimingTree*> m_Children;
     unordered_map<wstring, NestedTimingTree*> m_LUT;
-    int64_t m_StartTick;
-    int64_t m_EndTick;
+    int64_t m_CpuTicks;         // This frame, from every thread
+    vector<uint32_t> m_GpuTimers;
     StatHistory m_CpuTime;
     StatHistory m_GpuTime;
     bool m_IsExpanded;
-    GpuTimer m_GpuTimer;
     bool m_IsGraphed;
     GraphHandle m_GraphHandle;
+    uint32_t m_TraceNameId;
+    uint16_t m_Depth;
     static StatHistory s_TotalCpuTime;
     static StatHistory s_TotalGpuTime;
     static StatHistory s_FrameDelta;
+    static StatHistory s_FrameTime;     // In milliseconds
+    static uint32_t sm_NumHitches;
+    static uint32_t sm_LastHitchFrame;
+    static float sm_LastHitchTime;
     static NestedTimingTree sm_RootScope;
-    static NestedTimingTree* sm_CurrentNode;
+    static vector<ProfilingScopes::Sample> sm_Samples;
     static NestedTimingTree* sm_SelectedScope;
 
     static bool sm_CursorOnGraph;
@@ -415,8 +514,12 @@ private:
 StatHistory NestedTimingTree::s_TotalCpuTime;
 StatHistory NestedTimingTree::s_TotalGpuTime;
 StatHistory NestedTimingTree::s_FrameDelta;
+StatHistory NestedTimingTree::s_FrameTime;
+uint32_t NestedTimingTree::sm_NumHitches = 0;
+uint32_t NestedTimingTree::sm_LastHitchFrame = 0;
+float NestedTimingTree::sm_LastHitchTime = 0.0f;
 NestedTimingTree NestedTimingTree::sm_RootScope(L"");
-NestedTimingTree* NestedTimingTree::sm_CurrentNode = &NestedTimingTree::sm_RootScope;
+vector<ProfilingScopes::Sample> NestedTimingTree::sm_Samples;
 NestedTimingTree* NestedTimingTree::sm_SelectedScope = &NestedTimingTree::sm_RootScope;
 bool NestedTimingTree::sm_CursorOnGraph = false;
 namespace EngineProfiling
@@ -425,7 +528,28 @@ namespace EngineProfiling
     BoolVar DrawProfiler("Display Profiler", false);
     //BoolVar DrawPerfGraph("Display Performance Graph", false);
     const bool DrawPerfGraph = false;
-    
+
+    const char* TraceFormatLabels[TraceCapture::kNumFormats] = { "Chrome JSON", "Binary" };
+    BoolVar CaptureTrace("Profiling/Capture Trace", false);
+    IntVar TraceCaptureKEvents("Profiling/Trace Capture K Events", 1024, 16, 64 * 1024, 256);
+    EnumVar TraceFormat("Profiling/Trace Format", TraceCapture::kChromeJson, TraceCapture::kNumFormats, TraceFormatLabels);
+
+    void SaveTraceCaptureCallback( void* )
+    {
+        const wchar_t* Extension = TraceFormat == TraceCapture::kBinary ? L".mtrc" : L".json";
+        const wstring FileName = L"Trace_Frame" + to_wstring(Graphics::GetFrameCount()) + Extension;
+        SaveTraceCapture(FileName, TraceFormat == TraceCapture::kBinary);
+    }
+
+    CallbackTrigger SaveTrace("Profiling/Save Trace", SaveTraceCaptureCallback);
+
+    void MeasureScopeOverheadCallback( void* )
+    {
+        MeasureScopeOverhead();
+    }
+
+    CallbackTrigger MeasureOverhead("Profiling/Measure Scope Overhead", MeasureScopeOverheadCallback);
+
     void Update( void )
     {
         if (GameInput::IsFirstPressed( GameInput::kStartButton ) 
@@ -433,17 +557,63 @@ namespace EngineProfiling
         {
             Paused = !Paused;
         }
+
+        if (CaptureTrace != TraceCapture::IsCapturing())
+        {
+            if (CaptureTrace)
+                TraceCapture::Start((size_t)TraceCaptureKEvents * 1024);
+            else
+                TraceCapture::Stop();
+        }
+
         NestedTimingTree::UpdateTimes();
     }
 
-    void BeginBlock(const wstring& name, CommandContext* Context)
+    void StartTraceCapture( size_t MaxEvents )
+    {
+        TraceCapture::Start(MaxEvents);
+        CaptureTrace = true;
+    }
+
+    void StopTraceCapture( void )
+    {
+        TraceCapture::Stop();
+        CaptureTrace = false;
+    }
+
+    bool SaveTraceCapture( const wstring& FileName, bool Binary )
+    {
+        TraceCapture::Statistics Stats = TraceCapture::GetStatistics();
+        bool Saved = TraceCapture::Save(FileName, Binary ? TraceCapture::kBinary : TraceCapture::kChromeJson,
+            SystemTime::TicksToSeconds(1));
+
+        if (Saved)
+            Utility::Printf(L"Saved %llu trace events to %s\n", Stats.Recorded - Stats.Overwritten, FileName.c_str());
+        else
+            Utility::Printf(L"Couldn't save the trace capture to %s\n", FileName.c_str());
+
+        return Saved;
+    }
+
+#if ENABLE_PROFILING
+    void BeginBlock(const wchar_t* name, CommandContext* Context)
     {
-        NestedTimingTree::PushProfilingMarker(name, Context);
+        ProfilingScopes::Push(name, Context);
     }
 
     void EndBlock(CommandContext* Context)
     {
-        NestedTimingTree::PopProfilingMarker(Context);
+        ProfilingScopes::Pop(Context);
+    }
+#endif
+
+    void MeasureScopeOverhead( uint32_t Iterations )
+    {
+        double NanosecsPerScope, NanosecsPerClockRead;
+        ProfilingScopes::MeasureOverhead(Iterations, NanosecsPerScope, NanosecsPerClockRead);
+
+        Utility::Printf("Profiling scope overhead:  %.1f ns per scope, of which %.1f ns reading the clock twice (%s)\n",
+            NanosecsPerScope, 2.0 * NanosecsPerClockRead, PROFILING_USE_RDTSC ? "rdtsc" : "QueryPerformanceCounter");
     }
 
     bool IsPaused()
@@ -451,6 +621,22 @@ namespace EngineProfiling
         return Paused;
     }
 
+    void ResetStatistics( void )
+    {
+        NestedTimingTree::ResetStatistics();
+    }
+
+    void GetStatSummaries( vector<StatSummary>& Summaries )
+    {
+        Summaries.clear();
+        NestedTimingTree::GetStatSummaries(Summaries);
+    }
+
+    uint32_t GetHitchCount( void )
+    {
+        return NestedTimingTree::GetHitchCount();
+    }
+
     void DisplayFrameRate( TextContext& Text )
     {
         if (!DrawFrameRate)
@@ -491,6 +677,58 @@ namespace EngineProfiling
             Text.SetColor( Color(1.0f, 1.0f, 1.0f) );
 
             NestedTimingTree::Display( Text, x );
+
+            Text.NewLine();
+            NestedTimingTree::DisplayFrameTimes(Text);
+
+            // Report the interval since the last display rather than lifetime totals
+            static DescriptorTableReuseCache::Statistics s_LastStats = {};
+            DescriptorTableReuseCache::Statistics Stats = DynamicDescriptorHeap::GetTableReuseStatistics();
+            uint64_t Lookups = Stats.Lookups - s_LastStats.Lookups;
+            uint64_t Hits = Stats.Hits - s_LastStats.Hits;
+            uint64_t DescriptorsSaved = Stats.DescriptorsSaved - s_LastStats.DescriptorsSaved;
+            s_LastStats = Stats;
+
+            Text.DrawFormattedString("Descriptor tables reused: %5.1f%%, %llu descriptor copies saved\n",
+                Lookups > 0 ? 100.0 * Hits / Lookups : 0.0, DescriptorsSaved);
+
+            static ResourceBarrierBatch::Statistics s_LastBarrierStats = {};
+            ResourceBarrierBatch::Statistics BarrierStats = CommandContext::GetBarrierStatistics();
+            uint64_t Requested = BarrierStats.Requested - s_LastBarrierStats.Requested;
+            uint64_t Emitted = BarrierStats.Emitted - s_LastBarrierStats.Emitted;
+            uint64_t SplitsCollapsed = BarrierStats.SplitsCollapsed - s_LastBarrierStats.SplitsCollapsed;
+            s_LastBarrierStats = BarrierStats;
+
+            Text.DrawFormattedString("Barriers: %llu requested, %llu emitted (%4.1f%% removed), %llu split pairs collapsed\n",
+                Requested, Emitted, Requested > 0 ? 100.0 * (Requested - Emitted) / Requested : 0.0, SplitsCollapsed);
+
+            static const char* s_QueueNames[3] = { "Graphics", "Compute", "Copy" };
+            CommandQueue* Queues[3] = { &g_CommandManager.GetGraphicsQueue(), &g_CommandManager.GetComputeQueue(), &g_CommandManager.GetCopyQueue() };
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                CommandAllocatorPool::Statistics AllocStats = Queues[i]->GetAllocatorStatistics();
+                Text.DrawFormattedString("%s allocators: %zu live (%zu KB), %zu created, %zu reused, %zu stalls, %zu trimmed\n",
+                    s_QueueNames[i], AllocStats.NumLive, AllocStats.HighWaterBytes / 1024, AllocStats.Created,
+                    AllocStats.Reused, AllocStats.Stalls, AllocStats.Trimmed);
+            }
+
+            static TextureManager::CacheStatistics s_LastCacheStats = {};
+            TextureManager::CacheStatistics CacheStats = TextureManager::GetCacheStatistics();
+            uint64_t CacheHits = CacheStats.Hits - s_LastCacheStats.Hits;
+            uint64_t CacheMisses = CacheStats.Misses - s_LastCacheStats.Misses;
+            uint64_t Evictions = CacheStats.Evictions - s_LastCacheStats.Evictions;
+            uint64_t BytesEvicted = CacheStats.BytesEvicted - s_LastCacheStats.BytesEvicted;
+            s_LastCacheStats = CacheStats;
+
+            Text.DrawFormattedString("Texture cache: %zu textures, %zu of %zu MB, %llu hits, %llu misses, %llu evicted (%llu MB)\n",
+                CacheStats.NumTextures, CacheStats.TotalBytes >> 20, CacheStats.BudgetBytes >> 20, CacheHits, CacheMisses,
+                Evictions, BytesEvicted >> 20);
+
+            static ProfilingScopes::Statistics s_LastScopeStats = {};
+            ProfilingScopes::Statistics ScopeStats = ProfilingScopes::GetStatistics();
+            Text.DrawFormattedString("Profiling scopes: %u threads, %llu recorded, %llu dropped\n", ScopeStats.NumThreads,
+                ScopeStats.Recorded - s_LastScopeStats.Recorded, ScopeStats.Dropped - s_LastScopeStats.Dropped);
+            s_LastScopeStats = ScopeStats;
         }
 
         Text.GetCommandContext().SetScissor(0, 0, g_DisplayWidth, g_DisplayHeight);
@@ -498,16 +736,30 @@ namespace EngineProfiling
 
 } // EngineProfiling
 
-void NestedTimingTree::PushProfilingMarker( const wstring& name, CommandContext* Context )
+// Every thread has a tree of its own scopes.  Each of their nodes caches the node it maps to in this tree,
+// which is only ever touched on the thread that updates the profiler.
+NestedTimingTree* NestedTimingTree::FindNode( const ProfilingScopes::Node* Scope )
 {
-    sm_CurrentNode = sm_CurrentNode->GetChild(name);
-    sm_CurrentNode->StartTiming(Context);
+    if (Scope->Parent == nullptr)
+        return &sm_RootScope;
+
+    NestedTimingTree* Node = (NestedTimingTree*)Scope->UserData;
+    if (Node == nullptr)
+    {
+        Node = FindNode(Scope->Parent)->GetChild(Scope->Name);
+        Scope->UserData = Node;
+    }
+
+    return Node;
 }
 
-void NestedTimingTree::PopProfilingMarker( CommandContext* Context )
+void NestedTimingTree::MergeScopes( uint32_t FrameIndex )
 {
-    sm_CurrentNode->StopTiming(Context);
-    sm_CurrentNode = sm_CurrentNode->m_Parent;
+    sm_Samples.clear();
+    ProfilingScopes::Drain(sm_Samples);
+
+    for (const ProfilingScopes::Sample& Sample : sm_Samples)
+        FindNode(Sample.Scope)->AddSample(Sample, FrameIndex);
 }
 
 void NestedTimingTree::Update( void )
@@ -516,9 +768,11 @@ void NestedTimingTree::Update( void )
 
     if (sm_SelectedScope == &sm_RootScope)
     {
-        sm_SelectedScope = sm_RootScope.FirstChild();
-        if (sm_SelectedScope == &sm_RootScope)
+        // Nothing has been timed yet
+        if (sm_RootScope.FirstChild() == nullptr)
             return;
+
+        sm_SelectedScope = sm_RootScope.FirstChild();
     }
 
     if (GameInput::IsFirstPressed( GameInput::kDPadLeft )
@@ -563,7 +817,8 @@ void NestedTimingTree::DisplayNode( TextContext& Text, float leftMargin, float i
     if (this == &sm_RootScope)
     {
         m_IsExpanded = true;
-        sm_RootScope.FirstChild()->m_IsExpanded = true;
+        if (FirstChild() != nullptr)
+            FirstChild()->m_IsExpanded = true;
     }
     else
     {
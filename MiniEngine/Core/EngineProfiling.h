@@ -14,16 +14,62 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "TextRenderer.h"
 
+// Profiling scopes compile to nothing unless ENABLE_PROFILING is set, which it is for all but Release builds
+#ifndef ENABLE_PROFILING
+#ifdef RELEASE
+#define ENABLE_PROFILING 0
+#else
+#define ENABLE_PROFILING 1
+#endif
+#endif
+
 class CommandContext;
 
 namespace EngineProfiling
 {
     void Update();
 
-    void BeginBlock(const std::wstring& name, CommandContext* Context = nullptr);
+    // Scopes may be opened on any thread, but must be closed on the thread that opened them.  Each thread
+    // keeps its own stack (see ProfilingScopes.h), and the timing tree is updated once a frame.
+#if ENABLE_PROFILING
+    void BeginBlock(const wchar_t* name, CommandContext* Context = nullptr);
     void EndBlock(CommandContext* Context = nullptr);
+    inline void BeginBlock(const std::wstring& name, CommandContext* Context = nullptr) { BeginBlock(name.c_str(), Context); }
+#else
+    inline void BeginBlock(const wchar_t*, CommandContext* = nullptr) {}
+    inline void BeginBlock(const std::wstring&, CommandContext* = nullptr) {}
+    inline void EndBlock(CommandContext* = nullptr) {}
+#endif
+
+    // Records every timed scope, on the CPU and GPU, into a ring buffer of the last MaxEvents events (see
+    // TraceCapture.h).  "Profiling/Capture Trace" does the same.
+    void StartTraceCapture( size_t MaxEvents = 1 << 20 );
+    void StopTraceCapture( void );
+
+    // Saves what has been captured, during a capture or after it, as Chrome trace JSON or the binary format
+    bool SaveTraceCapture( const std::wstring& FileName, bool Binary = false );
+
+    // Prints the cost of a profiling scope.  "Profiling/Measure Scope Overhead" does the same.
+    void MeasureScopeOverhead( uint32_t Iterations = 1000000 );
+
+    // Percentiles are estimated over every frame since the last ResetStatistics(), in milliseconds
+    struct StatSummary
+    {
+        std::wstring Name;      // "Frame Time", "Total CPU", "Total GPU", or "CPU/" or "GPU/" and a scope's path
+        uint64_t Count;
+        float Average;
+        float P50;
+        float P95;
+        float P99;
+        float Maximum;
+    };
+
+    void ResetStatistics( void );
+    void GetStatSummaries( std::vector<StatSummary>& Summaries );
+    uint32_t GetHitchCount( void );
 
     void DisplayFrameRate(TextContext& Text);
     void DisplayPerfGraph(GraphicsContext& Text);
@@ -31,10 +77,13 @@ namespace EngineProfiling
     bool IsPaused();
 }
 
-#ifdef RELEASE
+#if !ENABLE_PROFILING
+// The string literal overloads keep a wstring from being built for a timer that does nothing
 class ScopedTimer
 {
 public:
+    ScopedTimer(const wchar_t*) {}
+    ScopedTimer(const wchar_t*, CommandContext&) {}
     ScopedTimer(const std::wstring&) {}
     ScopedTimer(const std::wstring&, CommandContext&) {}
 };
@@ -42,6 +91,14 @@ public:
 class ScopedTimer
 {
 public:
+    ScopedTimer( const wchar_t* name ) : m_Context(nullptr)
+    {
+        EngineProfiling::BeginBlock(name);
+    }
+    ScopedTimer( const wchar_t* name, CommandContext& Context ) : m_Context(&Context)
+    {
+        EngineProfiling::BeginBlock(name, m_Context);
+    }
     ScopedTimer( const std::wstring& name ) : m_Context(nullptr)
     {
         EngineProfiling::BeginBlock(name);
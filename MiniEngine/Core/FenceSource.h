@@ -0,0 +1,31 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Abstracts the fence that gates reuse of GPU memory.  CommandQueue implements
+// this for real submissions; bookkeeping classes that only need to know when
+// memory is safe to recycle take an IFenceSource so they can be driven by a
+// simulated fence when running without a device.
+//
+
+#pragma once
+
+#include <cstdint>
+
+class IFenceSource
+{
+public:
+    virtual ~IFenceSource() {}
+
+    // The fence value that will be signaled once all work submitted so far completes
+    virtual uint64_t GetNextFenceValue() = 0;
+
+    // Test to see if a fence has already been reached
+    virtual bool IsFenceComplete(uint64_t FenceValue) = 0;
+};
@@ -0,0 +1,589 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "FileSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+using namespace concurrency;
+using namespace Utility;
+
+namespace
+{
+    // Loose files smaller than this are read rather than mapped
+    const uint64_t kMinMappedFileSize = 64 * 1024;
+
+    // Keeps views of empty files valid
+    const shared_ptr<const void> s_EmptyFile = make_shared<int>(0);
+
+    // A read-only view of a whole file.  The file itself can be closed once mapped.
+    class FileMapping
+    {
+    public:
+        static shared_ptr<FileMapping> Create( HANDLE File )
+        {
+            HANDLE Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (Mapping == nullptr)
+                return nullptr;
+
+            const void* Base = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(Mapping);
+
+            return Base == nullptr ? nullptr : shared_ptr<FileMapping>(new FileMapping((const byte*)Base));
+        }
+
+        ~FileMapping() { UnmapViewOfFile(m_Base); }
+
+        const byte* GetBase( void ) const { return m_Base; }
+
+    private:
+        FileMapping( const byte* Base ) : m_Base(Base) {}
+        const byte* m_Base;
+    };
+
+    FileView OpenLooseFile( const wstring& Path )
+    {
+        HANDLE File = CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (File == INVALID_HANDLE_VALUE)
+            return FileView();
+
+        FileView View;
+        LARGE_INTEGER FileSize;
+
+        if (!GetFileSizeEx(File, &FileSize))
+        {
+            // Unreadable
+        }
+        else if (FileSize.QuadPart == 0)
+        {
+            View = FileView(nullptr, 0, s_EmptyFile);
+        }
+        else if ((uint64_t)FileSize.QuadPart < kMinMappedFileSize)
+        {
+            const DWORD Size = (DWORD)FileSize.QuadPart;
+            shared_ptr<vector<byte>> Buffer = make_shared<vector<byte>>(Size);
+            DWORD BytesRead = 0;
+            if (ReadFile(File, Buffer->data(), Size, &BytesRead, nullptr) && BytesRead == Size)
+                View = FileView(Buffer);
+        }
+        else if (shared_ptr<FileMapping> Mapping = FileMapping::Create(File))
+        {
+            View = FileView(Mapping->GetBase(), (size_t)FileSize.QuadPart, Mapping);
+        }
+
+        CloseHandle(File);
+        return View;
+    }
+
+    bool GetLooseFileSize( const wstring& Path, uint64_t& Size )
+    {
+        WIN32_FILE_ATTRIBUTE_DATA Attributes;
+        if (!GetFileAttributesExW(Path.c_str(), GetFileExInfoStandard, &Attributes) ||
+            (Attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        {
+            return false;
+        }
+
+        Size = (uint64_t)Attributes.nFileSizeHigh << 32 | Attributes.nFileSizeLow;
+        return true;
+    }
+
+    // Pack names are UTF-8 and lower case (ASCII only), separated by backslashes and without a leading ".\"
+    string MakePackKey( const wstring& FileName )
+    {
+        size_t Start = 0;
+        while (FileName.size() >= Start + 2 && FileName[Start] == L'.' && (FileName[Start + 1] == L'\\' || FileName[Start + 1] == L'/'))
+            Start += 2;
+
+        wstring Name = FileName.substr(Start);
+        for (wchar_t& c : Name)
+        {
+            if (c == L'/')
+                c = L'\\';
+            else if (c >= L'A' && c <= L'Z')
+                c += L'a' - L'A';
+        }
+
+        return MakeUTF8(Name);
+    }
+
+    // 64-bit FNV-1a, which is simple to match in the packing script
+    uint64_t HashPackKey( const string& Key )
+    {
+        uint64_t Hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < Key.size(); ++i)
+            Hash = (Hash ^ (uint8_t)Key[i]) * 0x100000001b3ull;
+        return Hash;
+    }
+
+    class PackFile
+    {
+    public:
+        static const uint32_t kMagic = 0x4B41504D;  // "MPAK"
+        static const uint32_t kVersion = 1;
+
+        struct Header
+        {
+            uint32_t Magic;
+            uint32_t Version;
+            uint32_t NumEntries;
+            uint32_t Reserved;
+            uint64_t DirectoryOffset;   // NumEntries entries, sorted by name hash
+            uint64_t NamesOffset;       // Entry names, not terminated
+        };
+
+        struct Entry
+        {
+            uint64_t NameHash;
+            uint64_t Offset;
+            uint64_t Size;
+            uint32_t NameOffset;        // From Header::NamesOffset
+            uint32_t NameLength;
+        };
+
+        static shared_ptr<PackFile> Open( const wstring& Path )
+        {
+            HANDLE File = CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_FLAG_RANDOM_ACCESS, nullptr);
+            if (File == INVALID_HANDLE_VALUE)
+                return nullptr;
+
+            LARGE_INTEGER FileSize;
+            shared_ptr<FileMapping> Mapping;
+            if (GetFileSizeEx(File, &FileSize) && (uint64_t)FileSize.QuadPart >= sizeof(Header))
+                Mapping = FileMapping::Create(File);
+            CloseHandle(File);
+
+            if (Mapping == nullptr)
+                return nullptr;
+
+            shared_ptr<PackFile> Pack(new PackFile(Mapping));
+            return Pack->Validate((uint64_t)FileSize.QuadPart) ? Pack : nullptr;
+        }
+
+        FileView Find( const string& Key, uint64_t Hash ) const
+        {
+            const Entry* Last = m_Entries + m_NumEntries;
+            const Entry* Iter = lower_bound(m_Entries, Last, Hash,
+                []( const Entry& E, uint64_t H ) { return E.NameHash < H; });
+
+            for (; Iter != Last && Iter->NameHash == Hash; ++Iter)
+            {
+                if (Iter->NameLength == Key.size() && memcmp(m_Names + Iter->NameOffset, Key.data(), Key.size()) == 0)
+                    return FileView(m_Mapping->GetBase() + Iter->Offset, (size_t)Iter->Size, m_Mapping);
+            }
+
+            return FileView();
+        }
+
+    private:
+        PackFile( const shared_ptr<FileMapping>& Mapping ) : m_Mapping(Mapping), m_Entries(nullptr), m_NumEntries(0), m_Names(nullptr) {}
+
+        // Checks every entry once so that lookups can trust the directory
+        bool Validate( uint64_t FileSize )
+        {
+            const byte* Base = m_Mapping->GetBase();
+            const Header& PackHeader = *(const Header*)Base;
+
+            if (PackHeader.Magic != kMagic || PackHeader.Version != kVersion ||
+                PackHeader.DirectoryOffset % 8 != 0 || PackHeader.DirectoryOffset > FileSize ||
+                (FileSize - PackHeader.DirectoryOffset) / sizeof(Entry) < PackHeader.NumEntries ||
+                PackHeader.NamesOffset > FileSize)
+            {
+                return false;
+            }
+
+            m_Entries = (const Entry*)(Base + PackHeader.DirectoryOffset);
+            m_NumEntries = PackHeader.NumEntries;
+            m_Names = (const char*)(Base + PackHeader.NamesOffset);
+
+            const uint64_t NamesSize = FileSize - PackHeader.NamesOffset;
+
+            for (uint32_t i = 0; i < m_NumEntries; ++i)
+            {
+                const Entry& E = m_Entries[i];
+                if (E.Offset > FileSize || E.Size > FileSize - E.Offset ||
+                    E.NameOffset > NamesSize || E.NameLength > NamesSize - E.NameOffset ||
+                    (i > 0 && E.NameHash < m_Entries[i - 1].NameHash))
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        shared_ptr<FileMapping> m_Mapping;
+        const Entry* m_Entries;
+        uint32_t m_NumEntries;
+        const char* m_Names;
+    };
+
+    // Either a directory or a pack
+    struct Mount
+    {
+        wstring Root;
+        shared_ptr<PackFile> Pack;
+    };
+
+    typedef vector<Mount> MountList;
+
+    // Replaced, never modified, so that lookups only hold the lock long enough to take a reference
+    mutex s_MountMutex;
+    shared_ptr<const MountList> s_Mounts = make_shared<MountList>();
+
+    shared_ptr<const MountList> GetMounts( void )
+    {
+        lock_guard<mutex> Guard(s_MountMutex);
+        return s_Mounts;
+    }
+
+    void AddMount( const Mount& NewMount )
+    {
+        lock_guard<mutex> Guard(s_MountMutex);
+        shared_ptr<MountList> Mounts = make_shared<MountList>(*s_Mounts);
+        Mounts->push_back(NewMount);
+        s_Mounts = Mounts;
+    }
+
+    // Issues overlapped reads of whole files and completes their tasks from a single thread waiting on an
+    // I/O completion port
+    class AsyncReader
+    {
+    public:
+        AsyncReader() : m_Port(nullptr), m_Stopped(false), m_NumInFlight(0) {}
+        ~AsyncReader() { Shutdown(); }
+
+        // Reads up to Size bytes from Offset.  Returns false if the file couldn't be opened.
+        bool Read( const wstring& Path, uint64_t Offset, size_t Size, task<FileView>& Task )
+        {
+            HANDLE File = CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (File == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER FileSize;
+            if (!GetFileSizeEx(File, &FileSize) || Offset > (uint64_t)FileSize.QuadPart ||
+                min<uint64_t>(Size, FileSize.QuadPart - Offset) > MAXDWORD)
+            {
+                CloseHandle(File);
+                Task = task_from_result(FileView());
+                return true;
+            }
+
+            const DWORD ReadSize = (DWORD)min<uint64_t>(Size, FileSize.QuadPart - Offset);
+            if (ReadSize == 0)
+            {
+                CloseHandle(File);
+                Task = task_from_result(FileView(nullptr, 0, s_EmptyFile));
+                return true;
+            }
+
+            if (!Start(File))
+            {
+                CloseHandle(File);
+                Task = task_from_result(FileView());
+                return true;
+            }
+
+            PendingRead* Pending = new PendingRead;
+            ZeroMemory((OVERLAPPED*)Pending, sizeof(OVERLAPPED));
+            Pending->Offset = (DWORD)Offset;
+            Pending->OffsetHigh = (DWORD)(Offset >> 32);
+            Pending->File = File;
+            Pending->Size = ReadSize;
+            Pending->Buffer = make_shared<vector<byte>>(Pending->Size);
+
+            Task = create_task(Pending->Done);
+
+            if (!ReadFile(File, Pending->Buffer->data(), Pending->Size, nullptr, Pending) && GetLastError() != ERROR_IO_PENDING)
+            {
+                --m_NumInFlight;
+                CloseHandle(File);
+                Pending->Done.set(FileView());
+                delete Pending;
+            }
+
+            return true;
+        }
+
+        void Shutdown( void )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+            m_Stopped = true;
+            if (m_Port == nullptr)
+                return;
+
+            PostQueuedCompletionStatus(m_Port, 0, kShutdownKey, nullptr);
+            m_Thread.join();
+            CloseHandle(m_Port);
+            m_Port = nullptr;
+        }
+
+    private:
+        static const ULONG_PTR kShutdownKey = 1;
+
+        struct PendingRead : public OVERLAPPED
+        {
+            HANDLE File;
+            DWORD Size;
+            shared_ptr<vector<byte>> Buffer;
+            task_completion_event<FileView> Done;
+        };
+
+        // Creates the port and its thread on first use, associates the file with the port and counts the read as
+        // in flight.  Counting it under the lock means Shutdown() can't miss it.  Fails once Shutdown() has run,
+        // rather than starting the thread again.
+        bool Start( HANDLE File )
+        {
+            lock_guard<mutex> Guard(m_Mutex);
+
+            if (m_Stopped)
+                return false;
+
+            if (m_Port == nullptr)
+            {
+                m_Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+                if (m_Port == nullptr)
+                    return false;
+                m_Thread = thread(&AsyncReader::CompletionThread, this);
+            }
+
+            if (CreateIoCompletionPort(File, m_Port, 0, 0) == nullptr)
+                return false;
+
+            ++m_NumInFlight;
+            return true;
+        }
+
+        void CompletionThread( void )
+        {
+            bool Stopping = false;
+
+            while (!Stopping || m_NumInFlight > 0)
+            {
+                DWORD BytesRead = 0;
+                ULONG_PTR Key = 0;
+                OVERLAPPED* Overlapped = nullptr;
+                const BOOL Succeeded = GetQueuedCompletionStatus(m_Port, &BytesRead, &Key, &Overlapped, INFINITE);
+
+                if (Overlapped == nullptr)
+                {
+                    Stopping |= Succeeded && Key == kShutdownKey;
+                    continue;
+                }
+
+                PendingRead* Pending = static_cast<PendingRead*>(Overlapped);
+                CloseHandle(Pending->File);
+
+                if (Succeeded && BytesRead == Pending->Size)
+                    Pending->Done.set(FileView(Pending->Buffer));
+                else
+                    Pending->Done.set(FileView());
+
+                delete Pending;
+                --m_NumInFlight;
+            }
+        }
+
+        mutex m_Mutex;
+        HANDLE m_Port;
+        bool m_Stopped;
+        thread m_Thread;
+        atomic<uint32_t> m_NumInFlight;
+    };
+
+    AsyncReader s_AsyncReader;
+}
+
+void FileSystem::Initialize( void )
+{
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+    int argc = 0;
+    wchar_t** argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv == nullptr)
+        return;
+
+    // Options this doesn't know are left for the application
+    for (int arg = 1; arg + 1 < argc; ++arg)
+    {
+        if (_wcsicmp(argv[arg], L"-mount") != 0)
+            continue;
+
+        const wstring Path = argv[++arg];
+        const DWORD Attributes = GetFileAttributesW(Path.c_str());
+        if (Attributes != INVALID_FILE_ATTRIBUTES && (Attributes & FILE_ATTRIBUTE_DIRECTORY))
+            MountDirectory(Path);
+        else
+            MountPackFile(Path);
+    }
+
+    LocalFree(argv);
+#endif
+}
+
+bool FileSystem::MountDirectory( const wstring& Path )
+{
+    DWORD Attributes = GetFileAttributesW(Path.c_str());
+    if (Attributes == INVALID_FILE_ATTRIBUTES || !(Attributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+
+    Mount NewMount;
+    NewMount.Root = Path;
+    if (!Path.empty() && Path.back() != L'\\' && Path.back() != L'/')
+        NewMount.Root += L'\\';
+
+    AddMount(NewMount);
+    return true;
+}
+
+bool FileSystem::MountPackFile( const wstring& Path )
+{
+    Mount NewMount;
+    NewMount.Pack = PackFile::Open(Path);
+    if (NewMount.Pack == nullptr)
+    {
+        Utility::Printf(L"Couldn't mount pack file %s\n", Path.c_str());
+        return false;
+    }
+
+    AddMount(NewMount);
+    return true;
+}
+
+void FileSystem::UnmountAll( void )
+{
+    lock_guard<mutex> Guard(s_MountMutex);
+    s_Mounts = make_shared<MountList>();
+}
+
+FileView FileSystem::MapFile( const wstring& FileName )
+{
+    shared_ptr<const MountList> Mounts = GetMounts();
+
+    string Key;
+    uint64_t Hash = 0;
+
+    for (auto Iter = Mounts->rbegin(); Iter != Mounts->rend(); ++Iter)
+    {
+        FileView View;
+        if (Iter->Pack)
+        {
+            if (Key.empty())
+            {
+                Key = MakePackKey(FileName);
+                Hash = HashPackKey(Key);
+            }
+            View = Iter->Pack->Find(Key, Hash);
+        }
+        else
+        {
+            View = OpenLooseFile(Iter->Root + FileName);
+        }
+
+        if (View.IsValid())
+            return View;
+    }
+
+    return OpenLooseFile(FileName);
+}
+
+bool FileSystem::GetFileSize( const wstring& FileName, uint64_t& Size )
+{
+    shared_ptr<const MountList> Mounts = GetMounts();
+
+    string Key;
+    uint64_t Hash = 0;
+
+    for (auto Iter = Mounts->rbegin(); Iter != Mounts->rend(); ++Iter)
+    {
+        if (Iter->Pack)
+        {
+            if (Key.empty())
+            {
+                Key = MakePackKey(FileName);
+                Hash = HashPackKey(Key);
+            }
+
+            FileView View = Iter->Pack->Find(Key, Hash);
+            if (View.IsValid())
+            {
+                Size = View.Size();
+                return true;
+            }
+        }
+        else if (GetLooseFileSize(Iter->Root + FileName, Size))
+        {
+            return true;
+        }
+    }
+
+    return GetLooseFileSize(FileName, Size);
+}
+
+task<FileView> FileSystem::ReadAsync( const wstring& FileName )
+{
+    return ReadAsync(FileName, 0, SIZE_MAX);
+}
+
+task<FileView> FileSystem::ReadAsync( const wstring& FileName, uint64_t Offset, size_t Size )
+{
+    shared_ptr<const MountList> Mounts = GetMounts();
+
+    string Key;
+    uint64_t Hash = 0;
+    task<FileView> Task;
+
+    for (auto Iter = Mounts->rbegin(); Iter != Mounts->rend(); ++Iter)
+    {
+        if (Iter->Pack)
+        {
+            if (Key.empty())
+            {
+                Key = MakePackKey(FileName);
+                Hash = HashPackKey(Key);
+            }
+
+            FileView View = Iter->Pack->Find(Key, Hash);
+            if (View.IsValid())
+            {
+                if (Offset > View.Size())
+                    return task_from_result(FileView());
+                View = View.Slice((size_t)Offset, min<size_t>(Size, View.Size() - (size_t)Offset));
+
+                // Start paging the range in rather than faulting it in a page at a time when it is first read
+                WIN32_MEMORY_RANGE_ENTRY Range = { (PVOID)View.Data(), View.Size() };
+                if (View.Size() > 0)
+                    PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+                return task_from_result(View);
+            }
+        }
+        else if (s_AsyncReader.Read(Iter->Root + FileName, Offset, Size, Task))
+        {
+            return Task;
+        }
+    }
+
+    if (s_AsyncReader.Read(FileName, Offset, Size, Task))
+        return Task;
+
+    return task_from_result(FileView());
+}
+
+void FileSystem::Shutdown( void )
+{
+    s_AsyncReader.Shutdown();
+}
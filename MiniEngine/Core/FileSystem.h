@@ -0,0 +1,101 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A read-only virtual file system.  File names are looked up in the mounted directories and
+// pack files, most recently mounted first, and finally used as ordinary paths.
+//
+// Files come back as views rather than copies.  Pack entries and large loose files are views of a memory
+// mapping; small loose files are read into a buffer, because mapping them costs more system calls than
+// reading them.  A view keeps whatever it points into alive, even after its pack is unmounted.
+//
+// A pack file (written by Tools/Scripts/CreatePackFile.py) holds many files back to back, followed by a
+// directory sorted by name hash.  The whole pack is mapped when mounted and the directory is searched in
+// place, so opening a file in a pack needs no system calls at all.  Names in packs are not case sensitive
+// and may use either kind of slash.
+//
+// ReadAsync() reads loose files with overlapped I/O serviced by a completion port, so any number of reads
+// can be in flight without tying up a thread each.
+//
+// GameCore mounts whatever the command line names with "-mount <directory or pack>", in order, so later ones
+// shadow earlier ones.
+//
+
+#pragma once
+
+#include "pch.h"
+#include <memory>
+#include <string>
+#include <vector>
+#include <ppl.h>
+
+namespace Utility
+{
+    class FileView
+    {
+    public:
+        FileView() : m_Data(nullptr), m_Size(0) {}
+        FileView( const byte* Data, size_t Size, const std::shared_ptr<const void>& Owner )
+            : m_Data(Data), m_Size(Size), m_Owner(Owner) {}
+
+        // A view of the whole of a buffer a file was read into
+        explicit FileView( const std::shared_ptr<std::vector<byte>>& Buffer )
+            : m_Data(Buffer->data()), m_Size(Buffer->size()), m_Owner(Buffer), m_Buffer(Buffer) {}
+
+        // False if the file couldn't be found or read.  An empty file is valid.
+        bool IsValid( void ) const { return m_Owner != nullptr; }
+
+        const byte* Data( void ) const { return m_Data; }
+        size_t Size( void ) const { return m_Size; }
+
+        // Part of this view, which keeps the same file alive
+        FileView Slice( size_t Offset, size_t Size ) const { return FileView(m_Data + Offset, Size, m_Owner); }
+
+        // The buffer a loose file was read into, so that it can be handed over rather than copied, or null for
+        // mappings, pack entries and slices.  Whoever takes it may change it, so the view should be dropped.
+        const std::shared_ptr<std::vector<byte>>& GetBuffer( void ) const { return m_Buffer; }
+
+    private:
+        const byte* m_Data;
+        size_t m_Size;
+        std::shared_ptr<const void> m_Owner;
+        std::shared_ptr<std::vector<byte>> m_Buffer;
+    };
+
+    namespace FileSystem
+    {
+        // Mounts the directories and packs named on the command line
+        void Initialize( void );
+
+        // Files under Path shadow files mounted earlier
+        bool MountDirectory( const std::wstring& Path );
+
+        // Returns false if the file is missing or isn't a pack
+        bool MountPackFile( const std::wstring& Path );
+
+        void UnmountAll( void );
+
+        FileView MapFile( const std::wstring& FileName );
+
+        // Returns false if the file can't be found.  Nothing is read.
+        bool GetFileSize( const std::wstring& FileName, uint64_t& Size );
+
+        // Pack entries are returned at once (their pages are prefetched); loose files complete when read
+        concurrency::task<FileView> ReadAsync( const std::wstring& FileName );
+
+        // Reads up to Size bytes starting at Offset, fewer if the file ends first.  The view is invalid if Offset
+        // is past the end.
+        concurrency::task<FileView> ReadAsync( const std::wstring& FileName, uint64_t Offset, size_t Size );
+
+        // Waits for outstanding reads, then ends the thread that completes them.  Loose file reads started
+        // afterwards complete at once with an invalid view.  Call it after everything that streams files has
+        // been shut down.
+        void Shutdown( void );
+    }
+}
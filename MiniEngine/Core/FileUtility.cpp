@@ -13,7 +13,8 @@
 
 #include "pch.h"
 #include "FileUtility.h"
-#include <fstream>
+#include "FileSystem.h"
+#include "Inflate.h"
 #include <mutex>
 #include <zlib.h> // From NuGet package 
 
@@ -26,25 +27,23 @@ namespace Utility
 }
 
 ByteArray DecompressZippedFile( wstring& fileName );
+ByteArray DecompressView( const wstring& fileName, const FileView& CompressedFile );
 
-ByteArray ReadFileHelper(const wstring& fileName)
+// Files read into a buffer are handed over as they are.  Mappings and pack entries have to be copied.
+ByteArray TakeView( const FileView& View )
 {
-    struct _stat64 fileStat;
-    int fileExists = _wstat64(fileName.c_str(), &fileStat);
-    if (fileExists == -1)
-        return NullFile;
-
-    ifstream file( fileName, ios::in | ios::binary );
-    if (!file)
+    if (!View.IsValid())
         return NullFile;
 
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( file.seekg(0, ios::end).tellg() );
-    file.seekg(0, ios::beg).read( (char*)byteArray->data(), byteArray->size() );
-    file.close();
+    if (View.GetBuffer() != nullptr)
+        return View.GetBuffer();
 
-    ASSERT(byteArray->size() == (size_t)fileStat.st_size);
+    return make_shared<vector<byte> >( View.Data(), View.Data() + View.Size() );
+}
 
-    return byteArray;
+ByteArray ReadFileHelper(const wstring& fileName)
+{
+    return TakeView(FileSystem::MapFile(fileName));
 }
 
 ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
@@ -57,66 +56,22 @@ ByteArray ReadFileHelperEx( shared_ptr<wstring> fileName)
     return ReadFileHelper(*fileName);
 }
 
-ByteArray Inflate(ByteArray CompressedSource, int& err, uint32_t ChunkSize = 0x100000 ) 
+ByteArray DecompressZippedFile( wstring& fileName )
 {
-    // Create a dynamic buffer to hold compressed blocks
-    vector<unique_ptr<byte> > blocks;
-
-    z_stream strm  = {};
-    strm.data_type = Z_BINARY;
-    strm.total_in  = strm.avail_in  = (uInt)CompressedSource->size();
-    strm.next_in   = CompressedSource->data();
-
-    err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
-
-    while (err == Z_OK || err == Z_BUF_ERROR)
-    {
-        strm.avail_out = ChunkSize;
-        strm.next_out = (byte*)malloc(ChunkSize);
-        blocks.emplace_back(strm.next_out);
-        err = inflate(&strm, Z_NO_FLUSH);
-    }
-
-    if (err != Z_STREAM_END) 
-    {
-        inflateEnd(&strm);
-        return NullFile;
-    }
-
-    ASSERT(strm.total_out > 0, "Nothing to decompress");
-
-    Utility::ByteArray byteArray = make_shared<vector<byte> >( strm.total_out );
-
-    // Allocate actual memory for this.
-    // copy the bits into that RAM.
-    // Free everything else up!!
-    void* curDest = byteArray->data();
-    size_t remaining = byteArray->size();
-
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-        ASSERT(remaining > 0);
-
-        size_t CopySize = min(remaining, (size_t)ChunkSize);
-
-        memcpy(curDest, blocks[i].get(), CopySize);
-        curDest = (byte*)curDest + CopySize;
-        remaining -= CopySize;
-    }
-
-    inflateEnd(&strm);
-
-    return byteArray;
+    return DecompressView(fileName, FileSystem::MapFile(fileName));
 }
 
-ByteArray DecompressZippedFile( wstring& fileName )
+// Inflated straight from the mapping, pack entry or read buffer, with no intermediate copy
+ByteArray DecompressView( const wstring& fileName, const FileView& CompressedFile )
 {
-    ByteArray CompressedFile = ReadFileHelper(fileName);
-    if (CompressedFile == NullFile)
+    if (!CompressedFile.IsValid())
         return NullFile;
 
-    int error;
-    ByteArray DecompressedFile = Inflate(CompressedFile, error);
+    int error = Z_DATA_ERROR;
+    ByteArray DecompressedFile = make_shared<vector<byte> >();
+    if (!InflateChunked(CompressedFile.Data(), CompressedFile.Size(), *DecompressedFile))
+        error = Inflate(CompressedFile.Data(), CompressedFile.Size(), *DecompressedFile);
+
     if (DecompressedFile->size() == 0)
     {
         Utility::Printf(L"Couldn't unzip file %s:  Error = %d\n", fileName.c_str(), error);
@@ -131,8 +86,34 @@ ByteArray Utility::ReadFileSync( const wstring& fileName)
     return ReadFileHelperEx(make_shared<wstring>(fileName));
 }
 
+ByteArray Utility::ReadFileRangeSync( const wstring& fileName, uint64_t Offset, size_t Size )
+{
+    // Only the pages in range are touched when the file is mapped
+    FileView View = FileSystem::MapFile(fileName);
+    if (!View.IsValid() || Offset >= View.Size())
+        return NullFile;
+
+    Size = (size_t)min<uint64_t>(Size, View.Size() - Offset);
+
+    const byte* Start = View.Data() + Offset;
+    return make_shared<vector<byte> >( Start, Start + Size );
+}
+
 task<ByteArray> Utility::ReadFileAsync(const wstring& fileName)
 {
-    shared_ptr<wstring> SharedPtr = make_shared<wstring>(fileName);
-    return create_task( [=] { return ReadFileHelperEx(SharedPtr); } );
+    // As ReadFileSync(), but no thread waits on either read.  Only decompression runs on the thread pool.
+    const wstring zippedFileName = fileName + L".gz";
+    return FileSystem::ReadAsync(zippedFileName).then( [=]( FileView Zipped ) -> task<ByteArray>
+    {
+        ByteArray firstTry = DecompressView(zippedFileName, Zipped);
+        if (firstTry != NullFile)
+            return task_from_result(firstTry);
+
+        return FileSystem::ReadAsync(fileName).then( []( FileView View ) { return TakeView(View); } );
+    });
+}
+
+task<ByteArray> Utility::ReadFileRangeAsync( const wstring& fileName, uint64_t Offset, size_t Size )
+{
+    return FileSystem::ReadAsync(fileName, Offset, Size).then( []( FileView View ) { return TakeView(View); } );
 }
@@ -27,11 +27,19 @@ namespace Utility
     extern ByteArray NullFile;
 
     // Reads the entire contents of a binary file.  If the file with the same name except with an additional
-    // ".gz" suffix exists, it will be loaded and decompressed instead.
+    // ".gz" suffix exists, it will be loaded and decompressed instead.  Files are found through FileSystem,
+    // so they may come from a mounted directory or pack file.
     // This operation blocks until the entire file is read.
     ByteArray ReadFileSync(const wstring& fileName);
 
     // Same as previous except that it does not block but instead returns a task.
     task<ByteArray> ReadFileAsync(const wstring& fileName);
 
+    // Reads up to Size bytes starting at Offset, fewer if the file ends first.  A ".gz" version of the file
+    // can't be read by range, so it is not looked for.
+    ByteArray ReadFileRangeSync(const wstring& fileName, uint64_t Offset, size_t Size);
+
+    // Same as previous except that it does not block but instead returns a task.
+    task<ByteArray> ReadFileRangeAsync(const wstring& fileName, uint64_t Offset, size_t Size);
+
 } // namespace Utility
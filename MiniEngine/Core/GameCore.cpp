@@ -19,6 +19,8 @@
 #include "BufferManager.h"
 #include "CommandContext.h"
 #include "PostEffects.h"
+#include "FileSystem.h"
+#include "PerfRegression.h"
 
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
     #pragma comment(lib, "runtimeobject.lib")
@@ -45,29 +47,39 @@ namespace GameCore
 
     void InitializeApplication( IGameApp& game )
     {
+        // Before anything is loaded, since mounted packs shadow loose files
+        Utility::FileSystem::Initialize();
         Graphics::Initialize();
         SystemTime::Initialize();
         GameInput::Initialize();
         EngineTuning::Initialize();
+        PerfRegression::Initialize();
 
         game.Startup();
     }
 
-    void TerminateApplication( IGameApp& game )
+    // Returns the process exit code
+    int TerminateApplication( IGameApp& game )
     {
+        int ExitCode = PerfRegression::Shutdown();
+
         game.Cleanup();
 
         GameInput::Shutdown();
+
+        return ExitCode;
     }
 
     bool UpdateApplication( IGameApp& game )
     {
         EngineProfiling::Update();
+        PerfRegression::Update();
 
         float DeltaTime = Graphics::GetFrameTime();
     
         GameInput::Update(DeltaTime);
         EngineTuning::Update(DeltaTime);
+        TextureManager::UpdateStreaming();
         
         game.Update(DeltaTime);
         game.RenderScene();
@@ -103,7 +115,7 @@ namespace GameCore
 
         Graphics::Present();
 
-        return !game.IsDone();
+        return !game.IsDone() && !PerfRegression::IsDone();
     }
 
     // Default implementation to be overridden by the application
@@ -208,6 +220,9 @@ namespace GameCore
         Graphics::Terminate();
         TerminateApplication(*m_game);
         Graphics::Shutdown();
+
+        // The texture streaming threads read files until TextureManager::Shutdown() stops them
+        Utility::FileSystem::Shutdown();
     }
 
     // Called when the application is activated.  For now, there is just one activation kind - Launch.
@@ -290,12 +305,13 @@ namespace GameCore
     }
 #endif
 
-    void RunApplication( IGameApp& app, const wchar_t* className )
+    int RunApplication( IGameApp& app, const wchar_t* className )
     {
         m_game = &app;
         (void)className;
         auto applicationViewSource = ref new ApplicationViewSource();
         CoreApplication::Run(applicationViewSource);
+        return 0;
     }
 
 #else // Win32
@@ -305,7 +321,7 @@ namespace GameCore
     void InitWindow( const wchar_t* className );
     LRESULT CALLBACK WndProc( HWND, UINT, WPARAM, LPARAM );
 
-    void RunApplication( IGameApp& app, const wchar_t* className )
+    int RunApplication( IGameApp& app, const wchar_t* className )
     {
         //ASSERT_SUCCEEDED(CoInitializeEx(nullptr, COINITBASE_MULTITHREADED));
         Microsoft::WRL::Wrappers::RoInitializeWrapper InitializeWinRT(RO_INIT_MULTITHREADED);
@@ -356,8 +372,13 @@ namespace GameCore
         while (UpdateApplication(app));	// Returns false to quit loop
 
         Graphics::Terminate();
-        TerminateApplication(app);
+        int ExitCode = TerminateApplication(app);
         Graphics::Shutdown();
+
+        // The texture streaming threads read files until TextureManager::Shutdown() stops them
+        Utility::FileSystem::Shutdown();
+
+        return ExitCode;
     }
 
     //--------------------------------------------------------------------------------------
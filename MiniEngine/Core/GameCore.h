@@ -40,7 +40,8 @@ namespace GameCore
         virtual void RenderUI( class GraphicsContext& ) {};
     };
 
-    void RunApplication( IGameApp& app, const wchar_t* className );
+    // Returns the process exit code, which is nonzero when a benchmark run fails (see PerfRegression.h)
+    int RunApplication( IGameApp& app, const wchar_t* className );
 }
 
 #if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
@@ -52,6 +53,5 @@ namespace GameCore
 #define CREATE_APPLICATION( app_class ) \
     MAIN_FUNCTION() \
     { \
-        GameCore::RunApplication( app_class(), L#app_class ); \
-        return 0; \
+        return GameCore::RunApplication( app_class(), L#app_class ); \
     }
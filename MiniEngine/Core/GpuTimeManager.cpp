@@ -16,6 +16,8 @@
 #include "GraphicsCore.h"
 #include "CommandContext.h"
 #include "CommandListManager.h"
+#include "SystemTime.h"
+#include <atomic>
 
 namespace
 {
@@ -24,10 +26,14 @@ namespace
     uint64_t* sm_TimeStampBuffer = nullptr;
     uint64_t sm_Fence = 0;
     uint32_t sm_MaxNumTimers = 0;
-    uint32_t sm_NumTimers = 1;
+    std::atomic<uint32_t> sm_NumTimers(1);    // Timers are reserved by any thread that opens a scope
     uint64_t sm_ValidTimeStart = 0;
     uint64_t sm_ValidTimeEnd = 0;
     double sm_GpuTickDelta = 0.0;
+
+    // A GPU time stamp and the CPU tick taken at the same moment, for converting one to the other
+    uint64_t sm_CalibrationGpuTime = 0;
+    uint64_t sm_CalibrationCpuTick = 0;
 }
 
 void GpuTimeManager::Initialize(uint32_t MaxNumTimers)
@@ -81,7 +87,16 @@ void GpuTimeManager::Shutdown()
 
 uint32_t GpuTimeManager::NewTimer(void)
 {
-    return sm_NumTimers++;
+    // Only handed out while there is room in the query heap, so that the count never passes the end of it
+    uint32_t TimerIdx = sm_NumTimers.load(std::memory_order_relaxed);
+    do
+    {
+        if (TimerIdx >= sm_MaxNumTimers)
+            return 0;
+    }
+    while (!sm_NumTimers.compare_exchange_weak(TimerIdx, TimerIdx + 1, std::memory_order_relaxed));
+
+    return TimerIdx;
 }
 
 void GpuTimeManager::StartTimer(CommandContext& Context, uint32_t TimerIdx)
@@ -112,6 +127,9 @@ void GpuTimeManager::BeginReadBack(void)
         sm_ValidTimeStart = 0ull;
         sm_ValidTimeEnd = 0ull;
     }
+
+    // The CPU tick is a QueryPerformanceCounter() value, like SystemTime's
+    Graphics::g_CommandManager.GetCommandQueue()->GetClockCalibration(&sm_CalibrationGpuTime, &sm_CalibrationCpuTick);
 }
 
 void GpuTimeManager::EndReadBack(void)
@@ -141,3 +159,20 @@ float GpuTimeManager::GetTime(uint32_t TimerIdx)
 
     return static_cast<float>(sm_GpuTickDelta * (TimeStamp2 - TimeStamp1));
 }
+
+bool GpuTimeManager::GetTimeStamps(uint32_t TimerIdx, int64_t& StartTick, int64_t& StopTick)
+{
+    ASSERT(sm_TimeStampBuffer != nullptr, "Time stamp readback buffer is not mapped");
+    ASSERT(TimerIdx < sm_NumTimers, "Invalid GPU timer index");
+
+    uint64_t TimeStamp1 = sm_TimeStampBuffer[TimerIdx * 2];
+    uint64_t TimeStamp2 = sm_TimeStampBuffer[TimerIdx * 2 + 1];
+
+    if (TimeStamp1 < sm_ValidTimeStart || TimeStamp2 > sm_ValidTimeEnd || TimeStamp2 <= TimeStamp1 )
+        return false;
+
+    const double CpuTicksPerGpuTick = sm_GpuTickDelta / SystemTime::TicksToSeconds(1);
+    StartTick = (int64_t)sm_CalibrationCpuTick + (int64_t)(((double)TimeStamp1 - (double)sm_CalibrationGpuTime) * CpuTicksPerGpuTick);
+    StopTick = (int64_t)sm_CalibrationCpuTick + (int64_t)(((double)TimeStamp2 - (double)sm_CalibrationGpuTime) * CpuTicksPerGpuTick);
+    return true;
+}
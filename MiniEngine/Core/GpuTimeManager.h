@@ -22,7 +22,8 @@ namespace GpuTimeManager
     void Initialize( uint32_t MaxNumTimers = 4096 );
     void Shutdown();
 
-    // Reserve a unique timer index
+    // Reserve a unique timer index.  Thread safe.  Returns zero, the index of the frame's own timer, once
+    // all MaxNumTimers are taken.
     uint32_t NewTimer(void);
 
     // Write start and stop time stamps on the GPU timeline
@@ -36,4 +37,8 @@ namespace GpuTimeManager
 
     // Returns the time in milliseconds between start and stop queries
     float GetTime(uint32_t TimerIdx);
+
+    // Returns the start and stop time stamps converted to CPU ticks (see SystemTime), or false if the
+    // timer didn't run in the frame read back
+    bool GetTimeStamps(uint32_t TimerIdx, int64_t& StartTick, int64_t& StopTick);
 }
@@ -30,6 +30,7 @@
 #include "ParticleEffectManager.h"
 #include "GraphRenderer.h"
 #include "TemporalEffects.h"
+#include "Hash.h"
 
 // This macro determines whether to detect if there is an HDR display and enable HDR10 output.
 // Currently, with HDR display enabled, the pixel magnfication functionality is broken.
@@ -187,12 +188,13 @@ namespace Graphics
 
     IDXGISwapChain1* s_SwapChain1 = nullptr;
 
+    // Heap sizes are in descriptors and must be powers of two
     DescriptorAllocator g_DescriptorAllocator[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES] =
     {
-        D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
-        D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
-        D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
+        { D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4096 },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 256 },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 256 },
+        { D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 256 },
     };
 
     RootSignature s_PresentRS;
@@ -453,6 +455,28 @@ void Graphics::Initialize(void)
 
     g_CommandManager.Create(g_Device);
 
+    // Cached pipeline blobs are only valid for the adapter and driver that produced them
+    {
+        ComPtr<IDXGIAdapter1> pDeviceAdapter;
+        DXGI_ADAPTER_DESC1 AdapterDesc;
+        LARGE_INTEGER DriverVersion = {};
+        if (SUCCEEDED(dxgiFactory->EnumAdapterByLuid(g_Device->GetAdapterLuid(), MY_IID_PPV_ARGS(&pDeviceAdapter))) &&
+            SUCCEEDED(pDeviceAdapter->GetDesc1(&AdapterDesc)) &&
+            SUCCEEDED(pDeviceAdapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &DriverVersion)))
+        {
+            // Seeding with the driver version keeps all 64 bits of it
+            UINT AdapterId[4] = { AdapterDesc.VendorId, AdapterDesc.DeviceId, AdapterDesc.SubSysId, AdapterDesc.Revision };
+            const uint64_t CompatibilityTag = Utility::HashBytes(AdapterId, sizeof(AdapterId), (uint64_t)DriverVersion.QuadPart);
+
+            PSO::LoadPipelineCache(L"PipelineCache.bin", CompatibilityTag);
+        }
+        else
+        {
+            // Without the driver version there is no telling whose blobs are on disk, so don't use them
+            Utility::Print("Unable to identify the graphics driver.  Pipelines will not be cached on disk.\n");
+        }
+    }
+
     DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
     swapChainDesc.Width = g_DisplayWidth;
     swapChainDesc.Height = g_DisplayHeight;
@@ -600,6 +624,7 @@ void Graphics::Shutdown( void )
     GpuTimeManager::Shutdown();
     s_SwapChain1->Release();
     PSO::DestroyAll();
+    PSO::SavePipelineCache();
     RootSignature::DestroyAll();
     DescriptorAllocator::DestroyAll();
 
@@ -68,6 +68,10 @@ namespace Graphics
     {
         return g_DescriptorAllocator[Type].Allocate(Count);
     }
+    inline void FreeDescriptor( D3D12_DESCRIPTOR_HEAP_TYPE Type, D3D12_CPU_DESCRIPTOR_HANDLE Handle, UINT Count = 1 )
+    {
+        g_DescriptorAllocator[Type].Free(Handle, Count);
+    }
 
     extern RootSignature g_GenerateMipsRS;
     extern ComputePSO g_GenerateMipsLinearPSO[4];
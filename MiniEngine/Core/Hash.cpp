@@ -0,0 +1,343 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "Hash.h"
+#include <cstring>
+
+// Other compilers, as when the tools are built on their own, get the portable implementation only
+#if defined(_M_X64) || defined(_M_IX86)
+#define HASH_X86 1
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#define HASH_X86 0
+#endif
+
+#if defined(_M_ARM64)
+#define HASH_ARM64 1
+#include <intrin.h>
+#else
+#define HASH_ARM64 0
+#endif
+
+using namespace Utility;
+
+namespace
+{
+    // Keys shorter than this are hashed with the CRC chains alone
+    const size_t kWideThreshold = 256;
+    const size_t kStripeSize = 32;
+    const size_t kStripesPerBlock = 16;
+
+    const uint64_t kMulPrime = 0x9E3779B97F4A7C15ull;
+    const uint32_t kScramblePrime = 0x9E3779B1u;
+
+    const uint64_t kSecret[8] =
+    {
+        0xBE4BA423396CFEB8ull, 0x1CAD21F72C81017Cull, 0xDB979083E96DD4DEull, 0x1F67B3B7A4A44072ull,
+        0x78E5C0CC4EE679CBull, 0x2172FFCC7DD05A82ull, 0x8E2443F7744608B8ull, 0x4C263A81E69035E0ull,
+    };
+
+    inline uint64_t Load64( const uint8_t* Ptr )
+    {
+        uint64_t Value;
+        memcpy(&Value, Ptr, sizeof(Value));
+        return Value;
+    }
+
+    // Final avalanche so that every input bit affects every output bit
+    inline uint64_t Mix64( uint64_t Hash )
+    {
+        Hash ^= Hash >> 33;
+        Hash *= 0xFF51AFD7ED558CCDull;
+        Hash ^= Hash >> 33;
+        Hash *= 0xC4CEB9FE1A85EC53ull;
+        Hash ^= Hash >> 33;
+        return Hash;
+    }
+
+    //
+    // CRC32C (Castagnoli) with the same conventions as the SSE4.2 and ARMv8 instructions:  reflected,
+    // no pre or post inversion, 64-bit operands consumed low byte first.
+    //
+
+    struct Crc32cPortable
+    {
+        struct Table
+        {
+            uint32_t Entries[256];
+
+            Table()
+            {
+                for (uint32_t i = 0; i < 256; ++i)
+                {
+                    uint32_t Crc = i;
+                    for (uint32_t Bit = 0; Bit < 8; ++Bit)
+                        Crc = (Crc >> 1) ^ (0x82F63B78u & (0u - (Crc & 1)));
+                    Entries[i] = Crc;
+                }
+            }
+        };
+
+        static uint32_t Update( uint32_t Crc, uint64_t Value )
+        {
+            static const Table s_Table;
+            for (uint32_t i = 0; i < 8; ++i, Value >>= 8)
+                Crc = s_Table.Entries[(Crc ^ (uint32_t)Value) & 0xFF] ^ (Crc >> 8);
+            return Crc;
+        }
+    };
+
+#if HASH_X86
+    struct Crc32cSSE42
+    {
+        static uint32_t Update( uint32_t Crc, uint64_t Value ) { return (uint32_t)_mm_crc32_u64(Crc, Value); }
+    };
+#endif
+
+#if HASH_ARM64
+    struct Crc32cARMv8
+    {
+        static uint32_t Update( uint32_t Crc, uint64_t Value ) { return __crc32cd(Crc, Value); }
+    };
+#endif
+
+    // Two CRC chains over every word.  The second chain sees each word multiplied by an odd constant, which
+    // is not linear over GF(2), so the chains can't cancel each other out and the result is a full 64 bits.
+    template <typename Crc>
+    uint64_t HashShort( const uint8_t* Data, size_t Size, uint64_t Seed )
+    {
+        uint32_t Lo = (uint32_t)Seed;
+        uint32_t Hi = (uint32_t)(Seed >> 32) ^ (uint32_t)Size;
+
+        const uint8_t* const End = Data + (Size & ~(size_t)7);
+        for (; Data < End; Data += 8)
+        {
+            const uint64_t Word = Load64(Data);
+            Lo = Crc::Update(Lo, Word);
+            Hi = Crc::Update(Hi, Word * kMulPrime);
+        }
+
+        // The zero padding is unambiguous because the size is mixed in below
+        if (Size & 7)
+        {
+            uint64_t Word = 0;
+            memcpy(&Word, Data, Size & 7);
+            Lo = Crc::Update(Lo, Word);
+            Hi = Crc::Update(Hi, Word * kMulPrime);
+        }
+
+        return Mix64(((uint64_t)Hi << 32 | Lo) ^ (Size * kMulPrime));
+    }
+
+    //
+    // The wide loop keeps four 64-bit accumulators, one per 8-byte lane of a 32-byte stripe.  Each lane
+    // adds the 32x32 product of its key-mixed halves and the raw data of its neighbour lane.  The key
+    // includes the stripe's position within its block, otherwise reordering stripes would not change
+    // the sum.  Every 16 stripes the accumulators are scrambled so long inputs don't wash out early bits.
+    //
+
+    inline uint64_t GetStripeSalt( size_t Stripe )
+    {
+        return (Stripe % kStripesPerBlock + 1) * kMulPrime;
+    }
+
+    struct WideScalar
+    {
+        static void Accumulate( uint64_t Acc[4], const uint8_t* Data, size_t NumStripes )
+        {
+            for (size_t Stripe = 0; Stripe < NumStripes; ++Stripe, Data += kStripeSize)
+            {
+                uint64_t Words[4];
+                for (uint32_t i = 0; i < 4; ++i)
+                    Words[i] = Load64(Data + i * 8);
+
+                const uint64_t Salt = GetStripeSalt(Stripe);
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    const uint64_t Key = Words[i] ^ kSecret[i] ^ Salt;
+                    Acc[i] += (Key & 0xFFFFFFFF) * (Key >> 32) + Words[i ^ 1];
+                }
+
+                if ((Stripe + 1) % kStripesPerBlock == 0)
+                {
+                    for (uint32_t i = 0; i < 4; ++i)
+                        Acc[i] = (Acc[i] ^ (Acc[i] >> 47) ^ kSecret[4 + i]) * kScramblePrime;
+                }
+            }
+        }
+    };
+
+#if HASH_X86
+    struct WideAVX2
+    {
+        static void Accumulate( uint64_t Acc[4], const uint8_t* Data, size_t NumStripes )
+        {
+            __m256i Accumulator = _mm256_loadu_si256((const __m256i*)Acc);
+            const __m256i Secret = _mm256_loadu_si256((const __m256i*)kSecret);
+            const __m256i ScrambleSecret = _mm256_loadu_si256((const __m256i*)(kSecret + 4));
+            const __m256i Prime = _mm256_set1_epi32((int)kScramblePrime);
+
+            for (size_t Stripe = 0; Stripe < NumStripes; ++Stripe, Data += kStripeSize)
+            {
+                const __m256i Words = _mm256_loadu_si256((const __m256i*)Data);
+                const __m256i Salt = _mm256_set1_epi64x((long long)GetStripeSalt(Stripe));
+                const __m256i Key = _mm256_xor_si256(Words, _mm256_xor_si256(Secret, Salt));
+                const __m256i Product = _mm256_mul_epu32(Key, _mm256_srli_epi64(Key, 32));
+                const __m256i Swapped = _mm256_shuffle_epi32(Words, _MM_SHUFFLE(1, 0, 3, 2));
+                Accumulator = _mm256_add_epi64(Accumulator, _mm256_add_epi64(Product, Swapped));
+
+                if ((Stripe + 1) % kStripesPerBlock == 0)
+                {
+                    __m256i Mixed = _mm256_xor_si256(Accumulator, _mm256_srli_epi64(Accumulator, 47));
+                    Mixed = _mm256_xor_si256(Mixed, ScrambleSecret);
+
+                    // 64x32-bit multiply from two 32x32 products
+                    const __m256i ProductLo = _mm256_mul_epu32(Mixed, Prime);
+                    const __m256i ProductHi = _mm256_mul_epu32(_mm256_srli_epi64(Mixed, 32), Prime);
+                    Accumulator = _mm256_add_epi64(ProductLo, _mm256_slli_epi64(ProductHi, 32));
+                }
+            }
+
+            _mm256_storeu_si256((__m256i*)Acc, Accumulator);
+        }
+    };
+#endif
+
+    template <typename Crc, typename Wide>
+    uint64_t HashBytesImpl( const void* Data, size_t Size, uint64_t Seed )
+    {
+        const uint8_t* Bytes = (const uint8_t*)Data;
+
+        if (Size < kWideThreshold)
+            return HashShort<Crc>(Bytes, Size, Seed);
+
+        uint64_t Acc[4] = { Seed ^ kSecret[0], Seed ^ kSecret[1], Seed ^ kSecret[2], Seed ^ kSecret[3] };
+
+        const size_t NumStripes = Size / kStripeSize;
+        Wide::Accumulate(Acc, Bytes, NumStripes);
+
+        const size_t Consumed = NumStripes * kStripeSize;
+        uint64_t Hash = Seed ^ (Size * kMulPrime);
+        for (uint32_t i = 0; i < 4; ++i)
+            Hash = Mix64(Hash ^ Acc[i]);
+
+        return Mix64(Hash ^ HashShort<Crc>(Bytes + Consumed, Size - Consumed, Seed));
+    }
+
+    typedef uint64_t (*HashFunction)( const void*, size_t, uint64_t );
+
+    const HashFunction s_HashFunctions[kNumHashImplementations] =
+    {
+        HashBytesImpl<Crc32cPortable, WideScalar>,
+#if HASH_X86
+        HashBytesImpl<Crc32cSSE42, WideScalar>,
+        HashBytesImpl<Crc32cSSE42, WideAVX2>,
+#elif HASH_ARM64
+        HashBytesImpl<Crc32cARMv8, WideScalar>,
+        nullptr,
+#else
+        nullptr,
+        nullptr,
+#endif
+    };
+
+    bool DetectSupport( HashImplementation Impl )
+    {
+        if (s_HashFunctions[Impl] == nullptr)
+            return false;
+
+        if (Impl == kHashPortable)
+            return true;
+
+#if HASH_X86
+        int Info[4];
+        __cpuid(Info, 1);
+        const bool HasSSE42 = (Info[2] & (1 << 20)) != 0;
+        const bool HasOSXSAVE = (Info[2] & (1 << 27)) != 0;
+
+        if (Impl == kHashCRC32C)
+            return HasSSE42;
+
+        // AVX2 also needs the OS to preserve the upper halves of the YMM registers
+        if (!HasSSE42 || !HasOSXSAVE || (_xgetbv(0) & 6) != 6)
+            return false;
+
+        __cpuidex(Info, 7, 0);
+        return (Info[1] & (1 << 5)) != 0;
+#elif HASH_ARM64
+        return IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE) != FALSE;
+#else
+        return false;
+#endif
+    }
+
+    struct HashDispatch
+    {
+        bool Supported[kNumHashImplementations];
+        HashImplementation Best;
+
+        HashDispatch() : Best(kHashPortable)
+        {
+            for (uint32_t i = 0; i < kNumHashImplementations; ++i)
+            {
+                Supported[i] = DetectSupport((HashImplementation)i);
+                if (Supported[i])
+                    Best = (HashImplementation)i;
+            }
+        }
+    };
+
+    // Hashes may be computed during static initialization elsewhere, so detection happens on first use
+    const HashDispatch& GetDispatch( void )
+    {
+        static const HashDispatch s_Dispatch;
+        return s_Dispatch;
+    }
+}
+
+HashImplementation Utility::GetHashImplementation( void )
+{
+    return GetDispatch().Best;
+}
+
+bool Utility::IsHashImplementationSupported( HashImplementation Impl )
+{
+    return Impl < kNumHashImplementations && GetDispatch().Supported[Impl];
+}
+
+const char* Utility::GetHashImplementationName( HashImplementation Impl )
+{
+    switch (Impl)
+    {
+    case kHashPortable: return "Portable";
+#if HASH_ARM64
+    case kHashCRC32C: return "ARMv8 CRC32C";
+#else
+    case kHashCRC32C: return "SSE4.2 CRC32C";
+#endif
+    case kHashCRC32C_AVX2: return "SSE4.2 CRC32C + AVX2";
+    default: return "Unknown";
+    }
+}
+
+uint64_t Utility::HashBytes( const void* Data, size_t Size, uint64_t Hash )
+{
+    static const HashFunction s_BestFunction = s_HashFunctions[GetDispatch().Best];
+    return s_BestFunction(Data, Size, Hash);
+}
+
+uint64_t Utility::HashBytes( HashImplementation Impl, const void* Data, size_t Size, uint64_t Hash )
+{
+    ASSERT(IsHashImplementationSupported(Impl), "Hash implementation is not supported on this CPU");
+    return s_HashFunctions[Impl](Data, Size, Hash);
+}
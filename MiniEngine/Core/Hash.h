@@ -12,49 +12,36 @@
 
 #pragma once
 
-#include "Math/Common.h"
-
-// This requires SSE4.2 which is present on Intel Nehalem (Nov. 2008)
-// and AMD Bulldozer (Oct. 2011) processors.  I could put a runtime
-// check for this, but I'm just going to assume people playing with
-// DirectX 12 on Windows 10 have fairly recent machines.
-#ifdef _M_X64
-#define ENABLE_SSE_CRC32 1
-#else
-#define ENABLE_SSE_CRC32 0
-#endif
-
-#if ENABLE_SSE_CRC32
-#pragma intrinsic(_mm_crc32_u32)
-#pragma intrinsic(_mm_crc32_u64)
-#endif
+#include <cstddef>
+#include <cstdint>
 
 namespace Utility
 {
-    inline size_t HashRange(const uint32_t* const Begin, const uint32_t* const End, size_t Hash)
+    // Hashing is dispatched at startup to the fastest implementation the CPU supports.  Short keys are
+    // hashed with two CRC32C chains (SSE4.2 or the ARMv8 CRC extension) and long blobs such as shader
+    // bytecode with a four-lane multiply-accumulate (AVX2).  Every implementation produces the same
+    // 64-bit result, so the choice affects speed only.
+    enum HashImplementation
     {
-#if ENABLE_SSE_CRC32
-        const uint64_t* Iter64 = (const uint64_t*)Math::AlignUp(Begin, 8);
-        const uint64_t* const End64 = (const uint64_t* const)Math::AlignDown(End, 8);
+        kHashPortable,      // Table-driven CRC32C, scalar wide loop
+        kHashCRC32C,        // SSE4.2 or ARMv8 CRC32C, scalar wide loop
+        kHashCRC32C_AVX2,   // SSE4.2 CRC32C, AVX2 wide loop
 
-        // If not 64-bit aligned, start with a single u32
-        if ((uint32_t*)Iter64 > Begin)
-            Hash = _mm_crc32_u32((uint32_t)Hash, *Begin);
+        kNumHashImplementations
+    };
 
-        // Iterate over consecutive u64 values
-        while (Iter64 < End64)
-            Hash = _mm_crc32_u64((uint64_t)Hash, *Iter64++);
+    HashImplementation GetHashImplementation( void );
+    bool IsHashImplementationSupported( HashImplementation Impl );
+    const char* GetHashImplementationName( HashImplementation Impl );
 
-        // If there is a 32-bit remainder, accumulate that
-        if ((uint32_t*)Iter64 < End)
-            Hash = _mm_crc32_u32((uint32_t)Hash, *(uint32_t*)Iter64);
-#else
-        // An inexpensive hash for CPUs lacking SSE4.2
-        for (const uint32_t* Iter = Begin; Iter < End; ++Iter)
-            Hash = 16777619U * Hash ^ *Iter;
-#endif
+    uint64_t HashBytes( const void* Data, size_t Size, uint64_t Hash = 2166136261U );
 
-        return Hash;
+    // Same as HashBytes() but with a specific implementation, which must be supported
+    uint64_t HashBytes( HashImplementation Impl, const void* Data, size_t Size, uint64_t Hash = 2166136261U );
+
+    inline size_t HashRange(const uint32_t* const Begin, const uint32_t* const End, size_t Hash)
+    {
+        return HashBytes(Begin, (End - Begin) * sizeof(uint32_t), Hash);
     }
 
     template <typename T> inline size_t HashState( const T* StateDesc, size_t Count = 1, size_t Hash = 2166136261U )
@@ -0,0 +1,643 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "ImageProcessing.h"
+#include <algorithm>
+#include <cmath>
+#include <intrin.h>
+#include <ppl.h>
+
+using namespace std;
+
+namespace
+{
+    //
+    // Swizzles
+    //
+
+    // Expands four 3-byte pixels in the low 12 bytes to four 4-byte pixels with the given byte order
+    inline void Expand3To4( const uint8_t* Src, uint8_t* Dest, size_t Count, __m128i Shuffle )
+    {
+        const __m128i Alpha = _mm_set1_epi32(0xFF000000);
+
+        // A 16-byte load reads past the last of four pixels, so stop while 16 bytes remain
+        size_t i = 0;
+        for (; i + 6 <= Count; i += 4)
+        {
+            __m128i Pixels = _mm_loadu_si128((const __m128i*)(Src + i * 3));
+            _mm_storeu_si128((__m128i*)(Dest + i * 4), _mm_or_si128(_mm_shuffle_epi8(Pixels, Shuffle), Alpha));
+        }
+
+        uint8_t Order[16];
+        _mm_storeu_si128((__m128i*)Order, Shuffle);
+
+        for (; i < Count; ++i)
+        {
+            Dest[i * 4 + 0] = Src[i * 3 + Order[0]];
+            Dest[i * 4 + 1] = Src[i * 3 + Order[1]];
+            Dest[i * 4 + 2] = Src[i * 3 + Order[2]];
+            Dest[i * 4 + 3] = 255;
+        }
+    }
+
+    //
+    // float16 conversion with round to nearest even, as f32tof16() and f16tof32() do
+    //
+
+    inline __m128i FloatToHalf( __m128 f )
+    {
+        const __m128i Bits = _mm_castps_si128(f);
+        const __m128i Sign = _mm_srli_epi32(_mm_and_si128(Bits, _mm_set1_epi32(0x80000000)), 16);
+        const __m128i Abs = _mm_and_si128(Bits, _mm_set1_epi32(0x7FFFFFFF));
+        const __m128i IsNaN = _mm_cmpgt_epi32(Abs, _mm_set1_epi32(0x7F800000));
+
+        // Anything from 65536 up becomes infinity.  Normal halves rebias the exponent from 127 to 15 and round
+        // the 13 dropped bits to nearest even.
+        __m128i Normal = _mm_min_epi32(Abs, _mm_set1_epi32(0x47800000));
+        Normal = _mm_add_epi32(Normal, _mm_add_epi32(_mm_set1_epi32(0xC8000FFF), _mm_and_si128(_mm_srli_epi32(Normal, 13), _mm_set1_epi32(1))));
+        Normal = _mm_srli_epi32(Normal, 13);
+
+        // Below 2^-14, adding 0.5 lines the float's mantissa up with the half denormal's, so the FPU rounds just
+        // once.  (Shifting into a float denormal first and then dropping 13 bits would round twice.)
+        const __m128i Half = _mm_set1_epi32(0x3F000000);
+        const __m128i Denormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(Abs), _mm_castsi128_ps(Half))), Half);
+
+        __m128i h = _mm_blendv_epi8(Normal, Denormal, _mm_cmplt_epi32(Abs, _mm_set1_epi32(0x38800000)));
+        h = _mm_blendv_epi8(h, _mm_set1_epi32(0x7E00), IsNaN);
+        return _mm_or_si128(h, Sign);
+    }
+
+    // Takes halves in the low 16 bits of each lane
+    inline __m128 HalfToFloat( __m128i h )
+    {
+        const __m128i Sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+        const __m128i Abs = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+
+        // Shifting puts the exponent and mantissa in place, and multiplying by 2^112 rebiases the exponent
+        // (renormalizing denormals on the way).  Infinity and NaN need their exponent filled in.
+        __m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(Abs, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000)));
+        const __m128i IsSpecial = _mm_cmpgt_epi32(Abs, _mm_set1_epi32(0x7BFF));
+        f = _mm_or_ps(f, _mm_castsi128_ps(_mm_and_si128(IsSpecial, _mm_set1_epi32(0x7F800000))));
+
+        return _mm_or_ps(f, _mm_castsi128_ps(Sign));
+    }
+
+    // Runs a kernel over Count elements in groups of four.  The last partial group goes through a zero
+    // padded copy so that kernels never read or write past the end.
+    template <typename SrcType, typename DestType, size_t SrcPerItem, size_t DestPerItem, typename Kernel>
+    void ForEachGroupOf4( const SrcType* Src, DestType* Dest, size_t Count, Kernel Process )
+    {
+        size_t i = 0;
+        for (; i + 4 <= Count; i += 4)
+            Process(Src + i * SrcPerItem, Dest + i * DestPerItem);
+
+        if (i < Count)
+        {
+            SrcType SrcTail[4 * SrcPerItem] = {};
+            DestType DestTail[4 * DestPerItem];
+            memcpy(SrcTail, Src + i * SrcPerItem, (Count - i) * SrcPerItem * sizeof(SrcType));
+            Process(SrcTail, DestTail);
+            memcpy(Dest + i * DestPerItem, DestTail, (Count - i) * DestPerItem * sizeof(DestType));
+        }
+    }
+
+    //
+    // Filters
+    //
+
+    // Modified Bessel function of the first kind, for the Kaiser window
+    double BesselI0( double x )
+    {
+        double Sum = 1.0, Term = 1.0;
+        for (int k = 1; k < 32 && Term > Sum * 1e-12; ++k)
+        {
+            Term *= (x * x) / (4.0 * k * k);
+            Sum += Term;
+        }
+        return Sum;
+    }
+
+    // Distance is in destination pixels
+    double KaiserSinc( double Distance )
+    {
+        const double kRadius = 3.0;
+        const double kAlpha = 4.0;
+        const double kPi = 3.14159265358979323846;
+
+        if (fabs(Distance) >= kRadius)
+            return 0.0;
+
+        const double Sinc = Distance == 0.0 ? 1.0 : sin(kPi * Distance) / (kPi * Distance);
+        const double x = Distance / kRadius;
+        return Sinc * BesselI0(kAlpha * sqrt(1.0 - x * x)) / BesselI0(kAlpha);
+    }
+
+    // The source pixels and weights that make up each destination pixel along one axis.  Taps that fall off
+    // the edge are folded into the edge pixel.
+    struct FilterAxis
+    {
+        uint32_t TapsPerPixel;
+        vector<uint32_t> First;
+        vector<float> Weights;      // TapsPerPixel per destination pixel
+
+        FilterAxis( ImageProcessing::Filter Filt, uint32_t SrcSize, uint32_t DestSize )
+            : First(DestSize)
+        {
+            const double Scale = (double)SrcSize / DestSize;
+            const double Radius = Filt == ImageProcessing::kBox ? Scale * 0.5 : Scale * 3.0;
+
+            // Weights of every source pixel for one destination pixel, normalized, and the nonzero span
+            vector<double> Accumulated(SrcSize);
+            uint32_t Lo, Hi;
+
+            auto AccumulateWeights = [&](uint32_t i)
+            {
+                const double Center = (i + 0.5) * Scale;
+                const int32_t Begin = (int32_t)floor(Center - Radius);
+                const int32_t End = (int32_t)ceil(Center + Radius);
+
+                // Only the touched pixels need clearing and scanning
+                Lo = (uint32_t)max(Begin, 0);
+                Hi = (uint32_t)min(End - 1, (int32_t)SrcSize - 1);
+                fill(Accumulated.begin() + Lo, Accumulated.begin() + Hi + 1, 0.0);
+                double Total = 0.0;
+
+                for (int32_t j = Begin; j < End; ++j)
+                {
+                    double w;
+                    if (Filt == ImageProcessing::kBox)
+                        w = max(0.0, min(j + 1.0, Center + Radius) - max((double)j, Center - Radius));
+                    else
+                        w = KaiserSinc((j + 0.5 - Center) / Scale);
+
+                    Accumulated[min(max(j, 0), (int32_t)SrcSize - 1)] += w;
+                    Total += w;
+                }
+
+                for (uint32_t j = Lo; j <= Hi; ++j)
+                    Accumulated[j] /= Total;
+
+                while (Lo < Hi && Accumulated[Lo] == 0.0)
+                    ++Lo;
+                while (Hi > Lo && Accumulated[Hi] == 0.0)
+                    --Hi;
+            };
+
+            TapsPerPixel = 1;
+            for (uint32_t i = 0; i < DestSize; ++i)
+            {
+                AccumulateWeights(i);
+                TapsPerPixel = max(TapsPerPixel, Hi - Lo + 1);
+            }
+
+            Weights.resize(DestSize * TapsPerPixel);
+
+            for (uint32_t i = 0; i < DestSize; ++i)
+            {
+                // Keep the window inside the source.  Pixels it covers beyond the span get zero weight.
+                AccumulateWeights(i);
+                First[i] = min(Lo, SrcSize - TapsPerPixel);
+
+                for (uint32_t k = 0; k < TapsPerPixel; ++k)
+                {
+                    const uint32_t j = First[i] + k;
+                    Weights[i * TapsPerPixel + k] = j >= Lo && j <= Hi ? (float)Accumulated[j] : 0.0f;
+                }
+            }
+        }
+
+        // The range of source pixels read by destination pixels [Begin, End)
+        void GetSourceRange( uint32_t Begin, uint32_t End, uint32_t& SrcBegin, uint32_t& SrcEnd ) const
+        {
+            SrcBegin = First[Begin];
+            SrcEnd = First[Begin] + TapsPerPixel;
+            for (uint32_t i = Begin + 1; i < End; ++i)
+            {
+                SrcBegin = min(SrcBegin, First[i]);
+                SrcEnd = max(SrcEnd, First[i] + TapsPerPixel);
+            }
+        }
+    };
+
+    //
+    // Pixel formats the filters read and write.  Pixels are filtered as linear RGBA floats.
+    //
+
+    struct RGBA8_UNORM
+    {
+        static __m128 Load( const uint8_t* Row, uint32_t x )
+        {
+            __m128i Pixel = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(*(const int*)(Row + x * 4)));
+            return _mm_mul_ps(_mm_cvtepi32_ps(Pixel), _mm_set1_ps(1.0f / 255.0f));
+        }
+
+        static void Store( uint8_t* Row, uint32_t x, __m128 Pixel )
+        {
+            Pixel = _mm_min_ps(_mm_max_ps(Pixel, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128i Bytes = _mm_cvtps_epi32(_mm_mul_ps(Pixel, _mm_set1_ps(255.0f)));
+            Bytes = _mm_packus_epi16(_mm_packus_epi32(Bytes, Bytes), Bytes);
+            *(int*)(Row + x * 4) = _mm_cvtsi128_si32(Bytes);
+        }
+    };
+
+    // sRGB conversion goes through tables:  one float per 8-bit value to decode, and one byte per 16-bit
+    // linear value to encode.  16 bits of linear precision is enough to round correctly to 8-bit sRGB.
+    struct SRGBTables
+    {
+        float ToLinear[256];
+        uint8_t FromLinear[65536];
+
+        SRGBTables()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                const double s = i / 255.0;
+                ToLinear[i] = (float)(s <= 0.04045 ? s / 12.92 : pow((s + 0.055) / 1.055, 2.4));
+            }
+
+            for (uint32_t i = 0; i < 65536; ++i)
+            {
+                const double l = i / 65535.0;
+                const double s = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+                FromLinear[i] = (uint8_t)(s * 255.0 + 0.5);
+            }
+        }
+
+        static const SRGBTables& Get( void )
+        {
+            static const SRGBTables s_Tables;
+            return s_Tables;
+        }
+    };
+
+    struct RGBA8_SRGB
+    {
+        static __m128 Load( const uint8_t* Row, uint32_t x )
+        {
+            const float* ToLinear = SRGBTables::Get().ToLinear;
+            const uint8_t* Pixel = Row + x * 4;
+            return _mm_set_ps(Pixel[3] * (1.0f / 255.0f), ToLinear[Pixel[2]], ToLinear[Pixel[1]], ToLinear[Pixel[0]]);
+        }
+
+        static void Store( uint8_t* Row, uint32_t x, __m128 Pixel )
+        {
+            const uint8_t* FromLinear = SRGBTables::Get().FromLinear;
+            Pixel = _mm_min_ps(_mm_max_ps(Pixel, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128i Index = _mm_cvtps_epi32(_mm_mul_ps(Pixel, _mm_set_ps(255.0f, 65535.0f, 65535.0f, 65535.0f)));
+
+            uint8_t* Out = Row + x * 4;
+            Out[0] = FromLinear[_mm_extract_epi32(Index, 0)];
+            Out[1] = FromLinear[_mm_extract_epi32(Index, 1)];
+            Out[2] = FromLinear[_mm_extract_epi32(Index, 2)];
+            Out[3] = (uint8_t)_mm_extract_epi32(Index, 3);
+        }
+    };
+
+    struct RGBA32_FLOAT
+    {
+        static __m128 Load( const uint8_t* Row, uint32_t x )
+        {
+            return _mm_loadu_ps((const float*)Row + x * 4);
+        }
+
+        static void Store( uint8_t* Row, uint32_t x, __m128 Pixel )
+        {
+            _mm_storeu_ps((float*)Row + x * 4, Pixel);
+        }
+    };
+
+    const uint32_t kTileSize = 64;
+
+    // Filters one destination tile:  the source pixels under it are loaded once, filtered horizontally into
+    // one row per source row, then filtered vertically.
+    template <typename PixelFormat>
+    void DownsampleTile( const FilterAxis& AxisX, const FilterAxis& AxisY, const uint8_t* Src, size_t SrcPitch,
+        uint8_t* Dest, size_t DestPitch, uint32_t X, uint32_t Y, uint32_t TileWidth, uint32_t TileHeight )
+    {
+        uint32_t SrcX0, SrcX1, SrcY0, SrcY1;
+        AxisX.GetSourceRange(X, X + TileWidth, SrcX0, SrcX1);
+        AxisY.GetSourceRange(Y, Y + TileHeight, SrcY0, SrcY1);
+
+        const uint32_t SrcWidth = SrcX1 - SrcX0;
+        const uint32_t SrcHeight = SrcY1 - SrcY0;
+
+        vector<__m128> Loaded(SrcWidth);
+        vector<__m128> Filtered(SrcHeight * TileWidth);
+
+        for (uint32_t Row = 0; Row < SrcHeight; ++Row)
+        {
+            const uint8_t* SrcRow = Src + (SrcY0 + Row) * SrcPitch;
+            for (uint32_t i = 0; i < SrcWidth; ++i)
+                Loaded[i] = PixelFormat::Load(SrcRow, SrcX0 + i);
+
+            __m128* FilteredRow = &Filtered[Row * TileWidth];
+            for (uint32_t i = 0; i < TileWidth; ++i)
+            {
+                const __m128* Taps = &Loaded[AxisX.First[X + i] - SrcX0];
+                const float* Weights = &AxisX.Weights[(X + i) * AxisX.TapsPerPixel];
+
+                __m128 Sum = _mm_mul_ps(Taps[0], _mm_set1_ps(Weights[0]));
+                for (uint32_t k = 1; k < AxisX.TapsPerPixel; ++k)
+                    Sum = _mm_add_ps(Sum, _mm_mul_ps(Taps[k], _mm_set1_ps(Weights[k])));
+                FilteredRow[i] = Sum;
+            }
+        }
+
+        vector<__m128> Sums(TileWidth);
+
+        for (uint32_t j = 0; j < TileHeight; ++j)
+        {
+            const __m128* Taps = &Filtered[(AxisY.First[Y + j] - SrcY0) * TileWidth];
+            const float* Weights = &AxisY.Weights[(Y + j) * AxisY.TapsPerPixel];
+
+            const __m128 Weight0 = _mm_set1_ps(Weights[0]);
+            for (uint32_t i = 0; i < TileWidth; ++i)
+                Sums[i] = _mm_mul_ps(Taps[i], Weight0);
+
+            for (uint32_t k = 1; k < AxisY.TapsPerPixel; ++k)
+            {
+                const __m128 Weight = _mm_set1_ps(Weights[k]);
+                const __m128* TapRow = Taps + k * TileWidth;
+                for (uint32_t i = 0; i < TileWidth; ++i)
+                    Sums[i] = _mm_add_ps(Sums[i], _mm_mul_ps(TapRow[i], Weight));
+            }
+
+            uint8_t* DestRow = Dest + (Y + j) * DestPitch;
+            for (uint32_t i = 0; i < TileWidth; ++i)
+                PixelFormat::Store(DestRow, X + i, Sums[i]);
+        }
+    }
+
+    template <typename PixelFormat>
+    void DownsampleImage( ImageProcessing::Filter Filt, const uint8_t* Src, size_t SrcPitch, uint32_t Width,
+        uint32_t Height, uint8_t* Dest, size_t DestPitch, bool Multithreaded )
+    {
+        const uint32_t DestWidth = max(Width / 2, 1u);
+        const uint32_t DestHeight = max(Height / 2, 1u);
+
+        const FilterAxis AxisX(Filt, Width, DestWidth);
+        const FilterAxis AxisY(Filt, Height, DestHeight);
+
+        ImageProcessing::ForEachTile(DestWidth, DestHeight, kTileSize,
+            [&](uint32_t X, uint32_t Y, uint32_t TileWidth, uint32_t TileHeight)
+            {
+                DownsampleTile<PixelFormat>(AxisX, AxisY, Src, SrcPitch, Dest, DestPitch, X, Y, TileWidth, TileHeight);
+            },
+            Multithreaded);
+    }
+}
+
+const char* ImageProcessing::GetFilterName( Filter Filt )
+{
+    static const char* kNames[kNumFilters] = { "Box", "Kaiser" };
+    return kNames[Filt];
+}
+
+void ImageProcessing::ForEachTile( uint32_t Width, uint32_t Height, uint32_t TileSize,
+    const function<void(uint32_t, uint32_t, uint32_t, uint32_t)>& Work, bool Multithreaded )
+{
+    const uint32_t TilesWide = (Width + TileSize - 1) / TileSize;
+    const uint32_t TilesHigh = (Height + TileSize - 1) / TileSize;
+    const uint32_t NumTiles = TilesWide * TilesHigh;
+
+    auto RunTile = [&](uint32_t Index)
+    {
+        const uint32_t X = Index % TilesWide * TileSize;
+        const uint32_t Y = Index / TilesWide * TileSize;
+        Work(X, Y, min(TileSize, Width - X), min(TileSize, Height - Y));
+    };
+
+    if (Multithreaded && NumTiles > 1)
+        concurrency::parallel_for(0u, NumTiles, RunTile);
+    else
+    {
+        for (uint32_t i = 0; i < NumTiles; ++i)
+            RunTile(i);
+    }
+}
+
+void ImageProcessing::BGRToRGBA( const uint8_t* Src, uint8_t* Dest, size_t Count )
+{
+    ASSERT(Src != Dest, "Expanding swizzles can't work in place");
+    Expand3To4(Src, Dest, Count, _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1));
+}
+
+void ImageProcessing::RGBToRGBA( const uint8_t* Src, uint8_t* Dest, size_t Count )
+{
+    ASSERT(Src != Dest, "Expanding swizzles can't work in place");
+    Expand3To4(Src, Dest, Count, _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+}
+
+void ImageProcessing::BGRAToRGBA( const uint8_t* Src, uint8_t* Dest, size_t Count )
+{
+    const __m128i Shuffle = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+    size_t i = 0;
+    for (; i + 4 <= Count; i += 4)
+    {
+        __m128i Pixels = _mm_loadu_si128((const __m128i*)(Src + i * 4));
+        _mm_storeu_si128((__m128i*)(Dest + i * 4), _mm_shuffle_epi8(Pixels, Shuffle));
+    }
+
+    for (; i < Count; ++i)
+    {
+        const uint8_t B = Src[i * 4 + 0];
+        Dest[i * 4 + 0] = Src[i * 4 + 2];
+        Dest[i * 4 + 1] = Src[i * 4 + 1];
+        Dest[i * 4 + 2] = B;
+        Dest[i * 4 + 3] = Src[i * 4 + 3];
+    }
+}
+
+void ImageProcessing::RGBAToRGB( const uint8_t* Src, uint8_t* Dest, size_t Count )
+{
+    const __m128i Shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+
+    // Each store writes 16 bytes for 12 bytes of pixels, so stop while 16 bytes of Dest remain.  Working in
+    // place is safe because writes stay behind reads.
+    size_t i = 0;
+    for (; i + 6 <= Count; i += 4)
+    {
+        __m128i Pixels = _mm_loadu_si128((const __m128i*)(Src + i * 4));
+        _mm_storeu_si128((__m128i*)(Dest + i * 3), _mm_shuffle_epi8(Pixels, Shuffle));
+    }
+
+    for (; i < Count; ++i)
+    {
+        Dest[i * 3 + 0] = Src[i * 4 + 0];
+        Dest[i * 3 + 1] = Src[i * 4 + 1];
+        Dest[i * 3 + 2] = Src[i * 4 + 2];
+    }
+}
+
+void ImageProcessing::PackHalf( const float* Src, uint16_t* Dest, size_t Count )
+{
+    ForEachGroupOf4<float, uint16_t, 1, 1>(Src, Dest, Count, [](const float* In, uint16_t* Out)
+    {
+        __m128i h = FloatToHalf(_mm_loadu_ps(In));
+        _mm_storel_epi64((__m128i*)Out, _mm_packus_epi32(h, h));
+    });
+}
+
+void ImageProcessing::UnpackHalf( const uint16_t* Src, float* Dest, size_t Count )
+{
+    ForEachGroupOf4<uint16_t, float, 1, 1>(Src, Dest, Count, [](const uint16_t* In, float* Out)
+    {
+        _mm_storeu_ps(Out, HalfToFloat(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)In))));
+    });
+}
+
+void ImageProcessing::PackR11G11B10( const float* RGBA, uint32_t* Dest, size_t Count )
+{
+    ForEachGroupOf4<float, uint32_t, 4, 1>(RGBA, Dest, Count, [](const float* In, uint32_t* Out)
+    {
+        __m128 R = _mm_loadu_ps(In), G = _mm_loadu_ps(In + 4), B = _mm_loadu_ps(In + 8), A = _mm_loadu_ps(In + 12);
+        _MM_TRANSPOSE4_PS(R, G, B, A);
+
+        // Clamp upper bound so that it doesn't accidentally round up to INF
+        const __m128 kMaxVal = _mm_castsi128_ps(_mm_set1_epi32(0x477C0000));
+        const __m128i r = FloatToHalf(_mm_min_ps(R, kMaxVal));
+        const __m128i g = FloatToHalf(_mm_min_ps(G, kMaxVal));
+        const __m128i b = FloatToHalf(_mm_min_ps(B, kMaxVal));
+
+        __m128i Packed = _mm_and_si128(_mm_srli_epi32(_mm_add_epi32(r, _mm_set1_epi32(8)), 4), _mm_set1_epi32(0x000007FF));
+        Packed = _mm_or_si128(Packed, _mm_and_si128(_mm_slli_epi32(_mm_add_epi32(g, _mm_set1_epi32(8)), 7), _mm_set1_epi32(0x003FF800)));
+        Packed = _mm_or_si128(Packed, _mm_and_si128(_mm_slli_epi32(_mm_add_epi32(b, _mm_set1_epi32(16)), 17), _mm_set1_epi32(0xFFC00000)));
+        _mm_storeu_si128((__m128i*)Out, Packed);
+    });
+}
+
+void ImageProcessing::UnpackR11G11B10( const uint32_t* Src, float* RGBA, size_t Count )
+{
+    ForEachGroupOf4<uint32_t, float, 1, 4>(Src, RGBA, Count, [](const uint32_t* In, float* Out)
+    {
+        const __m128i p = _mm_loadu_si128((const __m128i*)In);
+        __m128 R = HalfToFloat(_mm_and_si128(_mm_slli_epi32(p, 4), _mm_set1_epi32(0x7FF0)));
+        __m128 G = HalfToFloat(_mm_and_si128(_mm_srli_epi32(p, 7), _mm_set1_epi32(0x7FF0)));
+        __m128 B = HalfToFloat(_mm_and_si128(_mm_srli_epi32(p, 17), _mm_set1_epi32(0x7FE0)));
+        __m128 A = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(R, G, B, A);
+        _mm_storeu_ps(Out, R);
+        _mm_storeu_ps(Out + 4, G);
+        _mm_storeu_ps(Out + 8, B);
+        _mm_storeu_ps(Out + 12, A);
+    });
+}
+
+void ImageProcessing::PackRGBE( const float* RGBA, uint32_t* Dest, size_t Count )
+{
+    ForEachGroupOf4<float, uint32_t, 4, 1>(RGBA, Dest, Count, [](const float* In, uint32_t* Out)
+    {
+        __m128 R = _mm_loadu_ps(In), G = _mm_loadu_ps(In + 4), B = _mm_loadu_ps(In + 8), A = _mm_loadu_ps(In + 12);
+        _MM_TRANSPOSE4_PS(R, G, B, A);
+
+        // Clamp to [0, 1.FF x 2^+15] and make the maximum channel at least 1.00 x 2^-16
+        const __m128 kMaxVal = _mm_castsi128_ps(_mm_set1_epi32(0x477F8000));
+        const __m128 kMinVal = _mm_castsi128_ps(_mm_set1_epi32(0x37800000));
+        R = _mm_min_ps(_mm_max_ps(R, _mm_setzero_ps()), kMaxVal);
+        G = _mm_min_ps(_mm_max_ps(G, _mm_setzero_ps()), kMaxVal);
+        B = _mm_min_ps(_mm_max_ps(B, _mm_setzero_ps()), kMaxVal);
+        const __m128 MaxChannel = _mm_max_ps(_mm_max_ps(kMinVal, R), _mm_max_ps(G, B));
+
+        // Adding a bias of the largest exponent plus 15 shifts each channel's 9 bits into the low bits,
+        // rounding what is shifted out
+        const __m128i Bias = _mm_and_si128(_mm_add_epi32(_mm_castps_si128(MaxChannel), _mm_set1_epi32(0x07804000)),
+            _mm_set1_epi32(0x7F800000));
+        const __m128i r = _mm_castps_si128(_mm_add_ps(R, _mm_castsi128_ps(Bias)));
+        const __m128i g = _mm_castps_si128(_mm_add_ps(G, _mm_castsi128_ps(Bias)));
+        const __m128i b = _mm_castps_si128(_mm_add_ps(B, _mm_castsi128_ps(Bias)));
+        const __m128i E = _mm_add_epi32(_mm_slli_epi32(Bias, 4), _mm_set1_epi32(0x10000000));
+
+        __m128i Packed = _mm_or_si128(E, _mm_slli_epi32(b, 18));
+        Packed = _mm_or_si128(Packed, _mm_slli_epi32(g, 9));
+        Packed = _mm_or_si128(Packed, _mm_and_si128(r, _mm_set1_epi32(0x1FF)));
+        _mm_storeu_si128((__m128i*)Out, Packed);
+    });
+}
+
+void ImageProcessing::UnpackRGBE( const uint32_t* Src, float* RGBA, size_t Count )
+{
+    ForEachGroupOf4<uint32_t, float, 1, 4>(Src, RGBA, Count, [](const uint32_t* In, float* Out)
+    {
+        const __m128i p = _mm_loadu_si128((const __m128i*)In);
+        const __m128i Mask = _mm_set1_epi32(0x1FF);
+
+        // ldexp(rgb, Exp - 24) is a multiply by a float with exponent bits of Exp - 24 + 127
+        const __m128 Scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_srli_epi32(p, 27), _mm_set1_epi32(103)), 23));
+        __m128 R = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(p, Mask)), Scale);
+        __m128 G = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 9), Mask)), Scale);
+        __m128 B = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(p, 18), Mask)), Scale);
+        __m128 A = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(R, G, B, A);
+        _mm_storeu_ps(Out, R);
+        _mm_storeu_ps(Out + 4, G);
+        _mm_storeu_ps(Out + 8, B);
+        _mm_storeu_ps(Out + 12, A);
+    });
+}
+
+uint32_t ImageProcessing::GetMipCount( uint32_t Width, uint32_t Height )
+{
+    uint32_t MipCount = 1;
+    while (Width > 1 || Height > 1)
+    {
+        Width = max(Width / 2, 1u);
+        Height = max(Height / 2, 1u);
+        ++MipCount;
+    }
+    return MipCount;
+}
+
+size_t ImageProcessing::GetMipChainSize( uint32_t Width, uint32_t Height, uint32_t MipCount, size_t BytesPerPixel )
+{
+    size_t Size = 0;
+    for (uint32_t Mip = 0; Mip < MipCount; ++Mip)
+    {
+        Size += (size_t)Width * Height * BytesPerPixel;
+        Width = max(Width / 2, 1u);
+        Height = max(Height / 2, 1u);
+    }
+    return Size;
+}
+
+void ImageProcessing::Downsample( Filter Filt, bool sRGB, const uint8_t* Src, size_t SrcPitch, uint32_t Width,
+    uint32_t Height, uint8_t* Dest, size_t DestPitch, bool Multithreaded )
+{
+    if (sRGB)
+        DownsampleImage<RGBA8_SRGB>(Filt, Src, SrcPitch, Width, Height, Dest, DestPitch, Multithreaded);
+    else
+        DownsampleImage<RGBA8_UNORM>(Filt, Src, SrcPitch, Width, Height, Dest, DestPitch, Multithreaded);
+}
+
+void ImageProcessing::Downsample( Filter Filt, const float* Src, size_t SrcPitch, uint32_t Width, uint32_t Height,
+    float* Dest, size_t DestPitch, bool Multithreaded )
+{
+    DownsampleImage<RGBA32_FLOAT>(Filt, (const uint8_t*)Src, SrcPitch, Width, Height, (uint8_t*)Dest, DestPitch, Multithreaded);
+}
+
+void ImageProcessing::GenerateMipChain( Filter Filt, bool sRGB, const uint8_t* Src, uint32_t Width, uint32_t Height,
+    uint32_t MipCount, uint8_t* Chain, bool Multithreaded )
+{
+    ASSERT(MipCount >= 1 && MipCount <= GetMipCount(Width, Height));
+
+    memcpy(Chain, Src, (size_t)Width * Height * 4);
+
+    for (uint32_t Mip = 1; Mip < MipCount; ++Mip)
+    {
+        uint8_t* Next = Chain + (size_t)Width * Height * 4;
+        Downsample(Filt, sRGB, Chain, Width * 4, Width, Height, Next, max(Width / 2, 1u) * 4, Multithreaded);
+
+        Chain = Next;
+        Width = max(Width / 2, 1u);
+        Height = max(Height / 2, 1u);
+    }
+}
@@ -0,0 +1,80 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  CPU image processing for building textures without the GPU:  mip generation, channel
+// swizzles and HDR pixel packing.  Like BlockCompression, nothing here touches the device, so offline tools
+// can use it as well as the texture loaders.
+//
+// Downsampling halves each dimension (rounding down) with a separable filter, one SSE register per RGBA
+// pixel.  Odd dimensions are handled by widening the filter footprint rather than dropping an edge.  sRGB
+// images are filtered in linear space and alpha is always linear.  The work is split into tiles of the
+// destination that run in parallel.
+//
+// The packing functions produce the same bits as their namesakes in PixelPacking_R11G11B10.hlsli and
+// PixelPacking_RGBE.hlsli, so CPU-baked data decodes with the shader unpacking functions.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+
+namespace ImageProcessing
+{
+    enum Filter
+    {
+        kBox,       // Averages the footprint of each destination pixel (what the GenerateMips shaders do)
+        kKaiser,    // Kaiser windowed sinc.  Sharper, with slight ringing.
+        kNumFilters
+    };
+
+    const char* GetFilterName( Filter Filt );
+
+    // Calls Work for each TileSize x TileSize tile (smaller on the right and bottom edges) of a Width x Height
+    // region, in parallel unless Multithreaded is false.
+    void ForEachTile( uint32_t Width, uint32_t Height, uint32_t TileSize,
+        const std::function<void(uint32_t X, uint32_t Y, uint32_t TileWidth, uint32_t TileHeight)>& Work,
+        bool Multithreaded = true );
+
+    // Channel swizzles of Count pixels.  Dest may equal Src when the pixel size doesn't change.
+    void BGRToRGBA( const uint8_t* Src, uint8_t* Dest, size_t Count );     // Alpha is set to 255
+    void BGRAToRGBA( const uint8_t* Src, uint8_t* Dest, size_t Count );    // Also converts RGBA to BGRA
+    void RGBToRGBA( const uint8_t* Src, uint8_t* Dest, size_t Count );     // Alpha is set to 255
+    void RGBAToRGB( const uint8_t* Src, uint8_t* Dest, size_t Count );
+
+    // Pixel packing of Count values.  The RGB formats read RGBA floats and ignore alpha.
+    void PackHalf( const float* Src, uint16_t* Dest, size_t Count );                // f32tof16()
+    void UnpackHalf( const uint16_t* Src, float* Dest, size_t Count );              // f16tof32()
+    void PackR11G11B10( const float* RGBA, uint32_t* Dest, size_t Count );          // Pack_R11G11B10_FLOAT()
+    void UnpackR11G11B10( const uint32_t* Src, float* RGBA, size_t Count );         // Unpack_R11G11B10_FLOAT()
+    void PackRGBE( const float* RGBA, uint32_t* Dest, size_t Count );               // PackRGBE()
+    void UnpackRGBE( const uint32_t* Src, float* RGBA, size_t Count );              // UnpackRGBE()
+
+    // The number of mips in a full chain, down to 1x1
+    uint32_t GetMipCount( uint32_t Width, uint32_t Height );
+
+    // The total size of MipCount tightly packed mips of an image, largest first
+    size_t GetMipChainSize( uint32_t Width, uint32_t Height, uint32_t MipCount, size_t BytesPerPixel );
+
+    // Halves an RGBA8 image.  Dest is max(Width / 2, 1) by max(Height / 2, 1).
+    void Downsample( Filter Filt, bool sRGB, const uint8_t* Src, size_t SrcPitch, uint32_t Width, uint32_t Height,
+        uint8_t* Dest, size_t DestPitch, bool Multithreaded = true );
+
+    // Halves an RGBA32F image.  Pitches are in bytes.  Values aren't clamped, so Kaiser filtering can
+    // overshoot the source range slightly.
+    void Downsample( Filter Filt, const float* Src, size_t SrcPitch, uint32_t Width, uint32_t Height,
+        float* Dest, size_t DestPitch, bool Multithreaded = true );
+
+    // Fills Chain, laid out as GetMipChainSize() describes, with MipCount mips of a tightly packed RGBA8
+    // image.  Mip 0 is copied from Src and each mip after it is downsampled from the one before.
+    void GenerateMipChain( Filter Filt, bool sRGB, const uint8_t* Src, uint32_t Width, uint32_t Height,
+        uint32_t MipCount, uint8_t* Chain, bool Multithreaded = true );
+}
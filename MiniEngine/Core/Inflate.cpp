@@ -0,0 +1,175 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard 
+//
+
+#include "pch.h"
+#include "Inflate.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <ppl.h>
+#include <zlib.h> // From NuGet package 
+
+using namespace std;
+
+namespace
+{
+    struct GzipChunk
+    {
+        const uint8_t* Deflated;
+        size_t DeflatedSize;
+        size_t DestOffset;
+        uint32_t Size;
+        uint32_t Crc;
+    };
+
+    const uint64_t kMaxDeflateRatio = 1032;
+
+    uint32_t ReadLE32( const uint8_t* Data )
+    {
+        return Data[0] | Data[1] << 8 | Data[2] << 16 | (uint32_t)Data[3] << 24;
+    }
+
+    // Returns false if this isn't the header of a chunked gzip member
+    bool ReadChunkHeader( const uint8_t* Data, size_t Size, GzipChunk& Chunk, size_t& MemberSize )
+    {
+        // ID1, ID2, deflate, and no flags but FEXTRA (which fixes where the compressed data starts)
+        if (Size < 12 || Data[0] != 0x1f || Data[1] != 0x8b || Data[2] != 8 || Data[3] != 0x04)
+            return false;
+
+        const size_t HeaderSize = 12 + (Data[10] | Data[11] << 8);
+        if (HeaderSize > Size)
+            return false;
+
+        for (size_t Field = 12; Field + 4 <= HeaderSize; )
+        {
+            const size_t FieldSize = Data[Field + 2] | Data[Field + 3] << 8;
+            if (Data[Field] == 'M' && Data[Field + 1] == 'E' && FieldSize == 8 && Field + 12 <= HeaderSize)
+            {
+                MemberSize = ReadLE32(Data + Field + 4);
+                if (MemberSize < HeaderSize + 8 || MemberSize > Size)
+                    return false;
+
+                Chunk.Deflated = Data + HeaderSize;
+                Chunk.DeflatedSize = MemberSize - HeaderSize - 8;
+                Chunk.Size = ReadLE32(Data + Field + 8);
+                Chunk.Crc = ReadLE32(Data + MemberSize - 8);
+
+                // Deflate can't expand anything more than 1032 times, so a larger size means a damaged header,
+                // and the destination isn't allocated for it
+                return Chunk.Size == ReadLE32(Data + MemberSize - 4) &&
+                    Chunk.Size <= (uint64_t)Chunk.DeflatedSize * kMaxDeflateRatio;
+            }
+            Field += 4 + FieldSize;
+        }
+
+        return false;
+    }
+
+    bool InflateChunk( const GzipChunk& Chunk, uint8_t* Dest )
+    {
+        // Raw deflate, since the gzip framing has already been parsed
+        z_stream strm = {};
+        strm.next_in = (Bytef*)Chunk.Deflated;
+        strm.avail_in = (uInt)Chunk.DeflatedSize;
+        strm.next_out = Dest;
+        strm.avail_out = Chunk.Size;
+
+        if (inflateInit2(&strm, -15) != Z_OK)
+            return false;
+
+        const int err = inflate(&strm, Z_FINISH);
+        const bool Complete = err == Z_STREAM_END && strm.total_out == Chunk.Size;
+        inflateEnd(&strm);
+
+        return Complete && crc32(0, Dest, Chunk.Size) == Chunk.Crc;
+    }
+}
+
+bool Utility::InflateChunked( const uint8_t* Data, size_t Size, vector<uint8_t>& Dest )
+{
+    Dest.clear();
+
+    vector<GzipChunk> Chunks;
+    size_t TotalSize = 0;
+
+    for (size_t Offset = 0; Offset < Size; )
+    {
+        GzipChunk Chunk;
+        size_t MemberSize;
+        if (!ReadChunkHeader(Data + Offset, Size - Offset, Chunk, MemberSize))
+            return !Chunks.empty();
+
+        Chunk.DestOffset = TotalSize;
+        TotalSize += Chunk.Size;
+        Chunks.push_back(Chunk);
+        Offset += MemberSize;
+    }
+
+    if (Chunks.empty())
+        return false;
+
+    Dest.resize(TotalSize);
+
+    atomic<bool> Failed(false);
+    if (Chunks.size() == 1)
+    {
+        Failed = !InflateChunk(Chunks[0], Dest.data());
+    }
+    else
+    {
+        concurrency::parallel_for(size_t(0), Chunks.size(), [&]( size_t i )
+        {
+            if (!InflateChunk(Chunks[i], Dest.data() + Chunks[i].DestOffset))
+                Failed = true;
+        });
+    }
+
+    if (Failed)
+        Dest.clear();
+
+    return true;
+}
+
+int Utility::Inflate( const uint8_t* Data, size_t Size, vector<uint8_t>& Dest )
+{
+    // A gzip file ends with its uncompressed size (modulo 4 GB), which makes a good first guess
+    size_t SizeGuess = Size * 4;
+    if (Size > 18 && Data[0] == 0x1f && Data[1] == 0x8b)
+        SizeGuess = min<size_t>(ReadLE32(Data + Size - 4), Size * kMaxInflateGuessRatio);
+
+    Dest.resize(max<size_t>(SizeGuess, 1));
+
+    z_stream strm  = {};
+    strm.data_type = Z_BINARY;
+    strm.total_in  = strm.avail_in  = (uInt)Size;
+    strm.next_in   = (Bytef*)Data;
+
+    int err = inflateInit2(&strm, (15 + 32)); //15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
+
+    // Inflate straight into the result, doubling it whenever it fills
+    while (err == Z_OK)
+    {
+        if (strm.total_out == Dest.size())
+            Dest.resize(Dest.size() * 2);
+
+        strm.next_out = Dest.data() + strm.total_out;
+        strm.avail_out = (uInt)min<size_t>(Dest.size() - strm.total_out, UINT_MAX);
+        err = inflate(&strm, Z_NO_FLUSH);
+    }
+
+    Dest.resize(err == Z_STREAM_END ? strm.total_out : 0);
+
+    inflateEnd(&strm);
+
+    return err;
+}
@@ -0,0 +1,38 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Author:  James Stanard 
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Utility
+{
+    // Chunked .gz files (written by Tools/Scripts/CompressChunked.py) are a series of gzip members, each holding
+    // up to 256 KB of the file compressed on its own.  Any gzip tool still reads them as one file.  Each member's
+    // header carries an extra field, 'M' 'E', with the member's size and its uncompressed size.  Walking those
+    // gives an index, so every chunk can be inflated in parallel straight into the destination buffer.
+    //
+    // Returns false if Data isn't a chunked file.  Otherwise returns true, with Dest empty if it can't be
+    // decompressed.
+    bool InflateChunked( const uint8_t* Data, size_t Size, std::vector<uint8_t>& Dest );
+
+    // A single-stream gzip file, or a zlib stream, inflated on the calling thread.  Returns the zlib error code,
+    // which is Z_STREAM_END once the whole stream is in Dest.
+    int Inflate( const uint8_t* Data, size_t Size, std::vector<uint8_t>& Dest );
+
+    // Dest starts no larger than this many times Size, and doubles from there.  The gzip trailer's size is
+    // believed up to that point, because a damaged or hostile file could claim anything up to 4 GB.
+    const size_t kMaxInflateGuessRatio = 64;
+}
@@ -16,7 +16,6 @@
 #include "LinearAllocator.h"
 #include "GraphicsCore.h"
 #include "CommandListManager.h"
-#include <thread>
 
 using namespace Graphics;
 using namespace std;
@@ -28,58 +27,32 @@ LinearAllocatorPageManager::LinearAllocatorPageManager()
     m_AllocationType = sm_AutoType;
     sm_AutoType = (LinearAllocatorType)(sm_AutoType + 1);
     ASSERT(sm_AutoType <= kNumAllocatorTypes);
+
+    m_PagePool.Create(&g_CommandManager, this,
+        m_AllocationType == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize,
+        LARGE_PAGE_POOL_BUDGET);
 }
 
 LinearAllocatorPageManager LinearAllocator::sm_PageManager[2];
 
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage()
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_RetiredPages.empty() && g_CommandManager.IsFenceComplete(m_RetiredPages.front().first))
-    {
-        m_AvailablePages.push(m_RetiredPages.front().second);
-        m_RetiredPages.pop();
-    }
-
-    LinearAllocationPage* PagePtr = nullptr;
-
-    if (!m_AvailablePages.empty())
-    {
-        PagePtr = m_AvailablePages.front();
-        m_AvailablePages.pop();
-    }
-    else
-    {
-        PagePtr = CreateNewPage();
-        m_PagePool.emplace_back(PagePtr);
-    }
-
-    return PagePtr;
+    return static_cast<LinearAllocationPage*>(m_PagePool.RequestPage());
 }
 
-void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearAllocationPage*>& UsedPages )
+LinearAllocationPage* LinearAllocatorPageManager::RequestLargePage( size_t PageSize )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-    for (auto iter = UsedPages.begin(); iter != UsedPages.end(); ++iter)
-        m_RetiredPages.push(make_pair(FenceValue, *iter));
+    return static_cast<LinearAllocationPage*>(m_PagePool.RequestLargePage(PageSize));
 }
 
-void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearAllocationPage*>& LargePages )
+void LinearAllocatorPageManager::DiscardPages( uint64_t FenceValue, const vector<LinearPageNode*>& UsedPages )
 {
-    lock_guard<mutex> LockGuard(m_Mutex);
-
-    while (!m_DeletionQueue.empty() && g_CommandManager.IsFenceComplete(m_DeletionQueue.front().first))
-    {
-        delete m_DeletionQueue.front().second;
-        m_DeletionQueue.pop();
-    }
+    m_PagePool.DiscardPages(FenceValue, UsedPages.data(), UsedPages.size());
+}
 
-    for (auto iter = LargePages.begin(); iter != LargePages.end(); ++iter)
-    {
-        (*iter)->Unmap();
-        m_DeletionQueue.push(make_pair(FenceValue, *iter));
-    }
+void LinearAllocatorPageManager::FreeLargePages( uint64_t FenceValue, const vector<LinearPageNode*>& LargePages )
+{
+    m_PagePool.FreeLargePages(FenceValue, LargePages.data(), LargePages.size());
 }
 
 LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage( size_t PageSize  )
@@ -145,7 +118,7 @@ void LinearAllocator::CleanupUsedPages( uint64_t FenceID )
 
 DynAlloc LinearAllocator::AllocateLargePage(size_t SizeInBytes)
 {
-    LinearAllocationPage* OneOff = sm_PageManager[m_AllocationType].CreateNewPage(SizeInBytes);
+    LinearAllocationPage* OneOff = sm_PageManager[m_AllocationType].RequestLargePage(SizeInBytes);
     m_LargePageList.push_back(OneOff);
 
     DynAlloc ret(*OneOff, 0, SizeInBytes);
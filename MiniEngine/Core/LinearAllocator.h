@@ -19,13 +19,15 @@
 // When a command context is finished, it will receive a fence ID that indicates when it's safe to reclaim
 // used resources.  The CleanupUsedPages() method must be invoked at this time so that the used pages can be
 // scheduled for reuse after the fence has cleared.
+//
+// The page bookkeeping itself lives in LinearPagePool, which caches pages per thread, retires them without
+// taking a lock, and recycles large pages by size class rather than destroying them after every use.
 
 #pragma once
 
 #include "GpuResource.h"
+#include "LinearPagePool.h"
 #include <vector>
-#include <queue>
-#include <mutex>
 
 // Constant blocks must be multiples of 16 constants @ 16 bytes each
 #define DEFAULT_ALIGN 256
@@ -43,7 +45,7 @@ struct DynAlloc
     D3D12_GPU_VIRTUAL_ADDRESS GpuAddress;	// The GPU-visible address
 };
 
-class LinearAllocationPage : public GpuResource
+class LinearAllocationPage : public GpuResource, public LinearPageNode
 {
 public:
     LinearAllocationPage(ID3D12Resource* pResource, D3D12_RESOURCE_STATES Usage) : GpuResource()
@@ -96,7 +98,10 @@ enum
     kCpuAllocatorPageSize = 0x200000	// 2MB
 };
 
-class LinearAllocatorPageManager
+// Upper bound on the bytes held by idle large pages awaiting reuse
+#define LARGE_PAGE_POOL_BUDGET (64 * 1024 * 1024)
+
+class LinearAllocatorPageManager : public ILinearPageFactory
 {
 public:
 
@@ -104,25 +109,27 @@ public:
     LinearAllocationPage* RequestPage( void );
     LinearAllocationPage* CreateNewPage( size_t PageSize = 0 );
 
+    // Returns a page of at least PageSize bytes for a single allocation that doesn't fit in a standard page
+    LinearAllocationPage* RequestLargePage( size_t PageSize );
+
     // Discarded pages will get recycled.  This is for fixed size pages.
-    void DiscardPages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
+    void DiscardPages( uint64_t FenceID, const std::vector<LinearPageNode*>& Pages );
+
+    // Freed pages will be pooled by size class once their fence has passed, or destroyed if
+    // the pool is over budget.  This is for "large" pages.
+    void FreeLargePages( uint64_t FenceID, const std::vector<LinearPageNode*>& Pages );
 
-    // Freed pages will be destroyed once their fence has passed.  This is for single-use,
-    // "large" pages.
-    void FreeLargePages( uint64_t FenceID, const std::vector<LinearAllocationPage*>& Pages );
+    void Destroy( void ) { m_PagePool.Destroy(); }
 
-    void Destroy( void ) { m_PagePool.clear(); }
+    virtual LinearPageNode* CreatePage( size_t PageSize ) override { return CreateNewPage(PageSize); }
+    virtual void DestroyPage( LinearPageNode* Page ) override { delete static_cast<LinearAllocationPage*>(Page); }
 
 private:
 
     static LinearAllocatorType sm_AutoType;
 
     LinearAllocatorType m_AllocationType;
-    std::vector<std::unique_ptr<LinearAllocationPage> > m_PagePool;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_RetiredPages;
-    std::queue<std::pair<uint64_t, LinearAllocationPage*> > m_DeletionQueue;
-    std::queue<LinearAllocationPage*> m_AvailablePages;
-    std::mutex m_Mutex;
+    LinearPagePool m_PagePool;
 };
 
 class LinearAllocator
@@ -155,6 +162,6 @@ private:
     size_t m_PageSize;
     size_t m_CurOffset;
     LinearAllocationPage* m_CurPage;
-    std::vector<LinearAllocationPage*> m_RetiredPages;
-    std::vector<LinearAllocationPage*> m_LargePageList;
+    std::vector<LinearPageNode*> m_RetiredPages;
+    std::vector<LinearPageNode*> m_LargePageList;
 };
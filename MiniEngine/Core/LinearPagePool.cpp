@@ -0,0 +1,275 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "LinearPagePool.h"
+
+using namespace std;
+
+LinearPagePool::LinearPagePool()
+    : m_FenceSource(nullptr)
+    , m_Factory(nullptr)
+    , m_PageSize(0)
+    , m_LargePageBudget(0)
+    , m_RetiredPages(nullptr)
+    , m_RetiredLargePages(nullptr)
+    , m_PendingPages(nullptr)
+    , m_PendingLargePages(nullptr)
+    , m_AvailablePages(nullptr)
+    , m_NumPagesCreated(0)
+    , m_NumLargePagesCreated(0)
+    , m_NumLargePagesReused(0)
+    , m_PooledLargePageBytes(0)
+{
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+        m_Stripes[i].Count = 0;
+
+    for (uint32_t i = 0; i < kNumLargeSizeClasses; ++i)
+        m_AvailableLargePages[i] = nullptr;
+}
+
+void LinearPagePool::Create( IFenceSource* FenceSource, ILinearPageFactory* Factory, size_t PageSize, size_t LargePageBudget )
+{
+    m_FenceSource = FenceSource;
+    m_Factory = Factory;
+    m_PageSize = PageSize;
+    m_LargePageBudget = LargePageBudget;
+}
+
+void LinearPagePool::Destroy( void )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+        m_Stripes[i].Count = 0;
+
+    // Every standard page is tracked, wherever it currently lives
+    for (auto Iter = m_AllPages.begin(); Iter != m_AllPages.end(); ++Iter)
+        m_Factory->DestroyPage(*Iter);
+
+    m_AllPages.clear();
+    m_RetiredPages = nullptr;
+    m_PendingPages = nullptr;
+    m_AvailablePages = nullptr;
+
+    // Large pages are only tracked while they are pooled or waiting on a fence
+    LinearPageNode* Lists[2] = { m_RetiredLargePages.exchange(nullptr), m_PendingLargePages };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        for (LinearPageNode* Page = Lists[i]; Page != nullptr; )
+        {
+            LinearPageNode* Next = Page->m_pNextPage;
+            m_Factory->DestroyPage(Page);
+            Page = Next;
+        }
+    }
+    m_PendingLargePages = nullptr;
+
+    for (uint32_t i = 0; i < kNumLargeSizeClasses; ++i)
+    {
+        for (LinearPageNode* Page = m_AvailableLargePages[i]; Page != nullptr; )
+        {
+            LinearPageNode* Next = Page->m_pNextPage;
+            m_Factory->DestroyPage(Page);
+            Page = Next;
+        }
+        m_AvailableLargePages[i] = nullptr;
+    }
+    m_PooledLargePageBytes = 0;
+}
+
+uint32_t LinearPagePool::GetLargeSizeClass( size_t SizeInBytes, size_t& ClassSize )
+{
+    ASSERT(SizeInBytes > 4);
+
+    // Four classes per power of two keeps the rounding waste under 25%
+    unsigned long mssb;
+    _BitScanReverse64(&mssb, SizeInBytes - 1);
+
+    const uint32_t StepShift = mssb - 2;
+    ClassSize = Math::AlignUp(SizeInBytes, (size_t)1 << StepShift);
+
+    const uint32_t SubClass = uint32_t(ClassSize >> StepShift) - 5;
+    return mssb * 4 + SubClass;
+}
+
+void LinearPagePool::PushList( atomic<LinearPageNode*>& Head, uint64_t FenceValue, LinearPageNode* const* Pages, size_t NumPages )
+{
+    if (NumPages == 0)
+        return;
+
+    // Link the batch together first so it can be published with a single exchange
+    for (size_t i = 0; i < NumPages; ++i)
+    {
+        Pages[i]->m_FenceValue = FenceValue;
+        Pages[i]->m_pNextPage = i + 1 < NumPages ? Pages[i + 1] : nullptr;
+    }
+
+    LinearPageNode* Last = Pages[NumPages - 1];
+    LinearPageNode* OldHead = Head.load(memory_order_relaxed);
+    do
+    {
+        Last->m_pNextPage = OldHead;
+    }
+    while (!Head.compare_exchange_weak(OldHead, Pages[0], memory_order_release, memory_order_relaxed));
+}
+
+void LinearPagePool::DiscardPages( uint64_t FenceValue, LinearPageNode* const* Pages, size_t NumPages )
+{
+    PushList(m_RetiredPages, FenceValue, Pages, NumPages);
+}
+
+void LinearPagePool::FreeLargePages( uint64_t FenceValue, LinearPageNode* const* Pages, size_t NumPages )
+{
+    PushList(m_RetiredLargePages, FenceValue, Pages, NumPages);
+}
+
+void LinearPagePool::ReclaimRetiredPages( void )
+{
+    LinearPageNode* Page = m_RetiredPages.exchange(nullptr, memory_order_acquire);
+    while (Page != nullptr)
+    {
+        LinearPageNode* Next = Page->m_pNextPage;
+        Page->m_pNextPage = m_PendingPages;
+        m_PendingPages = Page;
+        Page = Next;
+    }
+
+    LinearPageNode** Link = &m_PendingPages;
+    while (*Link != nullptr)
+    {
+        Page = *Link;
+        if (m_FenceSource->IsFenceComplete(Page->m_FenceValue))
+        {
+            *Link = Page->m_pNextPage;
+            Page->m_pNextPage = m_AvailablePages;
+            m_AvailablePages = Page;
+        }
+        else
+        {
+            Link = &Page->m_pNextPage;
+        }
+    }
+}
+
+void LinearPagePool::ReclaimRetiredLargePages( void )
+{
+    LinearPageNode* Page = m_RetiredLargePages.exchange(nullptr, memory_order_acquire);
+    while (Page != nullptr)
+    {
+        LinearPageNode* Next = Page->m_pNextPage;
+        Page->m_pNextPage = m_PendingLargePages;
+        m_PendingLargePages = Page;
+        Page = Next;
+    }
+
+    LinearPageNode** Link = &m_PendingLargePages;
+    while (*Link != nullptr)
+    {
+        Page = *Link;
+        if (!m_FenceSource->IsFenceComplete(Page->m_FenceValue))
+        {
+            Link = &Page->m_pNextPage;
+            continue;
+        }
+
+        *Link = Page->m_pNextPage;
+
+        if (m_PooledLargePageBytes + Page->m_PageSize <= m_LargePageBudget)
+        {
+            size_t ClassSize;
+            uint32_t SizeClass = GetLargeSizeClass(Page->m_PageSize, ClassSize);
+            ASSERT(ClassSize == Page->m_PageSize);
+
+            Page->m_pNextPage = m_AvailableLargePages[SizeClass];
+            m_AvailableLargePages[SizeClass] = Page;
+            m_PooledLargePageBytes += Page->m_PageSize;
+        }
+        else
+        {
+            m_Factory->DestroyPage(Page);
+        }
+    }
+}
+
+LinearPageNode* LinearPagePool::RequestPage( void )
+{
+    static atomic<uint32_t> s_NextThreadIndex(0);
+    thread_local uint32_t t_ThreadIndex = s_NextThreadIndex++;
+
+    CacheStripe& Stripe = m_Stripes[t_ThreadIndex % kNumCacheStripes];
+    lock_guard<mutex> StripeGuard(Stripe.Mutex);
+
+    if (Stripe.Count == 0)
+    {
+        // Refill the stripe with a small batch so the next few requests don't touch the pool lock
+        lock_guard<mutex> LockGuard(m_Mutex);
+        ReclaimRetiredPages();
+
+        while (Stripe.Count < kPagesPerStripe && m_AvailablePages != nullptr)
+        {
+            Stripe.Pages[Stripe.Count++] = m_AvailablePages;
+            m_AvailablePages = m_AvailablePages->m_pNextPage;
+        }
+    }
+
+    if (Stripe.Count > 0)
+        return Stripe.Pages[--Stripe.Count];
+
+    // Before growing the pool, take a page another thread is sitting on
+    for (uint32_t i = 0; i < kNumCacheStripes; ++i)
+    {
+        CacheStripe& Other = m_Stripes[i];
+        if (&Other == &Stripe || !Other.Mutex.try_lock())
+            continue;
+
+        LinearPageNode* Page = Other.Count > 0 ? Other.Pages[--Other.Count] : nullptr;
+        Other.Mutex.unlock();
+
+        if (Page != nullptr)
+            return Page;
+    }
+
+    LinearPageNode* Page = m_Factory->CreatePage(m_PageSize);
+    Page->m_PageSize = m_PageSize;
+    ++m_NumPagesCreated;
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+    m_AllPages.push_back(Page);
+
+    return Page;
+}
+
+LinearPageNode* LinearPagePool::RequestLargePage( size_t SizeInBytes )
+{
+    size_t ClassSize;
+    uint32_t SizeClass = GetLargeSizeClass(SizeInBytes, ClassSize);
+
+    {
+        lock_guard<mutex> LockGuard(m_Mutex);
+        ReclaimRetiredLargePages();
+
+        LinearPageNode* Page = m_AvailableLargePages[SizeClass];
+        if (Page != nullptr)
+        {
+            m_AvailableLargePages[SizeClass] = Page->m_pNextPage;
+            m_PooledLargePageBytes -= Page->m_PageSize;
+            ++m_NumLargePagesReused;
+            return Page;
+        }
+    }
+
+    LinearPageNode* Page = m_Factory->CreatePage(ClassSize);
+    Page->m_PageSize = ClassSize;
+    ++m_NumLargePagesCreated;
+
+    return Page;
+}
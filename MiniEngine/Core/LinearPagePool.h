@@ -0,0 +1,110 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Device-independent page bookkeeping for the linear allocators.  Pages are created and
+// destroyed through an ILinearPageFactory so the pool itself never touches D3D.
+//
+// Pages handed back by command contexts are pushed onto a lock-free retire list along with the fence
+// value that guards them.  Threads requesting a page first look in their own cache stripe, then drain
+// the retire list under the pool lock and take a small batch of completed pages back to their stripe.
+//
+// Pages too large for the standard page size are rounded up to a size class (four per power of two)
+// and recycled through per-class free lists instead of being destroyed after every use.  Pooled large
+// pages are kept within a byte budget; anything over it is destroyed once its fence has passed.
+
+#pragma once
+
+#include "FenceSource.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+struct LinearPageNode
+{
+    LinearPageNode* m_pNextPage;
+    uint64_t m_FenceValue;
+    size_t m_PageSize;
+
+    LinearPageNode() : m_pNextPage(nullptr), m_FenceValue(0), m_PageSize(0) {}
+};
+
+class ILinearPageFactory
+{
+public:
+    virtual ~ILinearPageFactory() {}
+    virtual LinearPageNode* CreatePage( size_t PageSize ) = 0;
+    virtual void DestroyPage( LinearPageNode* Page ) = 0;
+};
+
+class LinearPagePool
+{
+public:
+    LinearPagePool();
+
+    void Create( IFenceSource* FenceSource, ILinearPageFactory* Factory, size_t PageSize, size_t LargePageBudget );
+    void Destroy( void );
+
+    // Returns a page of the standard size
+    LinearPageNode* RequestPage( void );
+
+    // Returns a page of at least SizeInBytes, reusing a pooled page of the same size class when possible
+    LinearPageNode* RequestLargePage( size_t SizeInBytes );
+
+    // Lock-free.  The pages may be reused once FenceValue has completed.
+    void DiscardPages( uint64_t FenceValue, LinearPageNode* const* Pages, size_t NumPages );
+    void FreeLargePages( uint64_t FenceValue, LinearPageNode* const* Pages, size_t NumPages );
+
+    size_t GetNumPagesCreated( void ) const { return m_NumPagesCreated; }
+    size_t GetNumLargePagesCreated( void ) const { return m_NumLargePagesCreated; }
+    size_t GetNumLargePagesReused( void ) const { return m_NumLargePagesReused; }
+    size_t GetPooledLargePageBytes( void ) const { return m_PooledLargePageBytes; }
+
+private:
+    static const uint32_t kNumCacheStripes = 16;
+    static const uint32_t kPagesPerStripe = 4;
+    static const uint32_t kNumLargeSizeClasses = 64 * 4;
+
+    struct CacheStripe
+    {
+        std::mutex Mutex;
+        uint32_t Count;
+        LinearPageNode* Pages[kPagesPerStripe];
+    };
+
+    static uint32_t GetLargeSizeClass( size_t SizeInBytes, size_t& ClassSize );
+
+    static void PushList( std::atomic<LinearPageNode*>& Head, uint64_t FenceValue, LinearPageNode* const* Pages, size_t NumPages );
+
+    // Must hold m_Mutex
+    void ReclaimRetiredPages( void );
+    void ReclaimRetiredLargePages( void );
+
+    IFenceSource* m_FenceSource;
+    ILinearPageFactory* m_Factory;
+    size_t m_PageSize;
+    size_t m_LargePageBudget;
+
+    CacheStripe m_Stripes[kNumCacheStripes];
+
+    std::atomic<LinearPageNode*> m_RetiredPages;
+    std::atomic<LinearPageNode*> m_RetiredLargePages;
+
+    std::mutex m_Mutex;
+    LinearPageNode* m_PendingPages;
+    LinearPageNode* m_PendingLargePages;
+    LinearPageNode* m_AvailablePages;
+    LinearPageNode* m_AvailableLargePages[kNumLargeSizeClasses];
+    std::vector<LinearPageNode*> m_AllPages;
+
+    std::atomic<size_t> m_NumPagesCreated;
+    std::atomic<size_t> m_NumLargePagesCreated;
+    std::atomic<size_t> m_NumLargePagesReused;
+    std::atomic<size_t> m_PooledLargePageBytes;
+};
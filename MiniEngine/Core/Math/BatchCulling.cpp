@@ -0,0 +1,534 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "BatchCulling.h"
+#include <algorithm>
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define CULL_X86 0
+#endif
+
+#if defined(_WIN32)
+#include <ppl.h>
+#else
+#include <thread>
+#include <vector>
+#endif
+
+using namespace std;
+using namespace Math;
+
+void CullingPlanes::AddPlane( float A, float B, float C, float Dist )
+{
+    if (m_NumPlanes == kMaxPlanes)
+        return;
+
+    const uint32_t i = m_NumPlanes++;
+    NormalX[i] = A;
+    NormalY[i] = B;
+    NormalZ[i] = C;
+    D[i] = Dist;
+    PosX[i] = max(A, 0.0f);
+    PosY[i] = max(B, 0.0f);
+    PosZ[i] = max(C, 0.0f);
+    NegX[i] = min(A, 0.0f);
+    NegY[i] = min(B, 0.0f);
+    NegZ[i] = min(C, 0.0f);
+}
+
+namespace
+{
+    inline uint32_t CountBits( uint32_t Word )
+    {
+        Word = Word - ((Word >> 1) & 0x55555555);
+        Word = (Word & 0x33333333) + ((Word >> 2) & 0x33333333);
+        return (((Word + (Word >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+    }
+
+    // Every implementation adds up the terms in this order, so they only disagree when rounding differs, and
+    // then only for objects touching a plane.
+    inline uint32_t TestBoxScalar( const CullingPlanes& P, const BoxArrays& B, uint32_t i )
+    {
+        for (uint32_t p = 0; p < P.GetNumPlanes(); ++p)
+        {
+            float Dist = P.D[p] + P.PosX[p] * B.MaxX[i];
+            Dist = Dist + P.NegX[p] * B.MinX[i];
+            Dist = Dist + P.PosY[p] * B.MaxY[i];
+            Dist = Dist + P.NegY[p] * B.MinY[i];
+            Dist = Dist + P.PosZ[p] * B.MaxZ[i];
+            Dist = Dist + P.NegZ[p] * B.MinZ[i];
+            if (!(Dist >= 0.0f))
+                return 0;
+        }
+        return 1;
+    }
+
+    inline uint32_t TestSphereScalar( const CullingPlanes& P, const SphereArrays& S, uint32_t i )
+    {
+        for (uint32_t p = 0; p < P.GetNumPlanes(); ++p)
+        {
+            float Dist = P.D[p] + P.NormalX[p] * S.CenterX[i];
+            Dist = Dist + P.NormalY[p] * S.CenterY[i];
+            Dist = Dist + P.NormalZ[p] * S.CenterZ[i];
+            Dist = Dist + S.Radius[i];
+            if (!(Dist >= 0.0f))
+                return 0;
+        }
+        return 1;
+    }
+
+    // Runs Test(i, Count) over [First, First + Count), where Test returns the bits of Width objects starting at
+    // i, and fills in the mask a word at a time.  Objects past the last whole group go through TestOne().
+    template <uint32_t Width, typename TestGroup, typename TestSingle>
+    uint32_t CullRange( uint32_t First, uint32_t Count, uint32_t* VisibleMask, TestGroup Test, TestSingle TestOne )
+    {
+        const uint32_t End = First + Count;
+        uint32_t Visible = 0;
+        uint32_t i = First;
+
+        for (; i + 32 <= End; i += 32)
+        {
+            uint32_t Word = 0;
+            for (uint32_t j = 0; j < 32; j += Width)
+                Word |= Test(i + j) << j;
+            VisibleMask[i / 32] = Word;
+            Visible += CountBits(Word);
+        }
+
+        if (i < End)
+        {
+            const uint32_t WordIdx = i / 32;
+            uint32_t Word = 0;
+            for (; i + Width <= End; i += Width)
+                Word |= Test(i) << (i % 32);
+            for (; i < End; ++i)
+                Word |= TestOne(i) << (i % 32);
+            VisibleMask[WordIdx] = Word;
+            Visible += CountBits(Word);
+        }
+
+        return Visible;
+    }
+
+    uint32_t CullBoxesScalar( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+    {
+        auto TestOne = [&]( uint32_t i ) { return TestBoxScalar(Planes, Boxes, i); };
+        return CullRange<1>(First, Count, VisibleMask, TestOne, TestOne);
+    }
+
+    uint32_t CullSpheresScalar( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+    {
+        auto TestOne = [&]( uint32_t i ) { return TestSphereScalar(Planes, Spheres, i); };
+        return CullRange<1>(First, Count, VisibleMask, TestOne, TestOne);
+    }
+
+#if CULL_X86
+
+    // Each plane broadcast across the lanes:  PosX, NegX, PosY, NegY, PosZ, NegZ, D for boxes and NormalX,
+    // NormalY, NormalZ, D for spheres
+    struct PlanesSSE
+    {
+        __m128 Box[CullingPlanes::kMaxPlanes][7];
+        __m128 Sphere[CullingPlanes::kMaxPlanes][4];
+        uint32_t NumPlanes;
+
+        PlanesSSE( const CullingPlanes& P ) : NumPlanes(P.GetNumPlanes())
+        {
+            for (uint32_t p = 0; p < NumPlanes; ++p)
+            {
+                Box[p][0] = _mm_set1_ps(P.PosX[p]);
+                Box[p][1] = _mm_set1_ps(P.NegX[p]);
+                Box[p][2] = _mm_set1_ps(P.PosY[p]);
+                Box[p][3] = _mm_set1_ps(P.NegY[p]);
+                Box[p][4] = _mm_set1_ps(P.PosZ[p]);
+                Box[p][5] = _mm_set1_ps(P.NegZ[p]);
+                Box[p][6] = _mm_set1_ps(P.D[p]);
+                Sphere[p][0] = _mm_set1_ps(P.NormalX[p]);
+                Sphere[p][1] = _mm_set1_ps(P.NormalY[p]);
+                Sphere[p][2] = _mm_set1_ps(P.NormalZ[p]);
+                Sphere[p][3] = _mm_set1_ps(P.D[p]);
+            }
+        }
+    };
+
+    uint32_t CullBoxesSSE( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+    {
+        const PlanesSSE P(Planes);
+        const __m128 Zero = _mm_setzero_ps();
+
+        auto Test = [&]( uint32_t i ) -> uint32_t
+        {
+            const __m128 MinX = _mm_loadu_ps(Boxes.MinX + i);
+            const __m128 MinY = _mm_loadu_ps(Boxes.MinY + i);
+            const __m128 MinZ = _mm_loadu_ps(Boxes.MinZ + i);
+            const __m128 MaxX = _mm_loadu_ps(Boxes.MaxX + i);
+            const __m128 MaxY = _mm_loadu_ps(Boxes.MaxY + i);
+            const __m128 MaxZ = _mm_loadu_ps(Boxes.MaxZ + i);
+
+            __m128 Inside = _mm_cmpeq_ps(Zero, Zero);
+            for (uint32_t p = 0; p < P.NumPlanes; ++p)
+            {
+                const __m128* Plane = P.Box[p];
+                __m128 Dist = _mm_add_ps(Plane[6], _mm_mul_ps(Plane[0], MaxX));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[1], MinX));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[2], MaxY));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[3], MinY));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[4], MaxZ));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[5], MinZ));
+                Inside = _mm_and_ps(Inside, _mm_cmpge_ps(Dist, Zero));
+            }
+            return (uint32_t)_mm_movemask_ps(Inside);
+        };
+
+        auto TestOne = [&]( uint32_t i ) { return TestBoxScalar(Planes, Boxes, i); };
+        return CullRange<4>(First, Count, VisibleMask, Test, TestOne);
+    }
+
+    uint32_t CullSpheresSSE( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+    {
+        const PlanesSSE P(Planes);
+        const __m128 Zero = _mm_setzero_ps();
+
+        auto Test = [&]( uint32_t i ) -> uint32_t
+        {
+            const __m128 CenterX = _mm_loadu_ps(Spheres.CenterX + i);
+            const __m128 CenterY = _mm_loadu_ps(Spheres.CenterY + i);
+            const __m128 CenterZ = _mm_loadu_ps(Spheres.CenterZ + i);
+            const __m128 Radius = _mm_loadu_ps(Spheres.Radius + i);
+
+            __m128 Inside = _mm_cmpeq_ps(Zero, Zero);
+            for (uint32_t p = 0; p < P.NumPlanes; ++p)
+            {
+                const __m128* Plane = P.Sphere[p];
+                __m128 Dist = _mm_add_ps(Plane[3], _mm_mul_ps(Plane[0], CenterX));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[1], CenterY));
+                Dist = _mm_add_ps(Dist, _mm_mul_ps(Plane[2], CenterZ));
+                Dist = _mm_add_ps(Dist, Radius);
+                Inside = _mm_and_ps(Inside, _mm_cmpge_ps(Dist, Zero));
+            }
+            return (uint32_t)_mm_movemask_ps(Inside);
+        };
+
+        auto TestOne = [&]( uint32_t i ) { return TestSphereScalar(Planes, Spheres, i); };
+        return CullRange<4>(First, Count, VisibleMask, Test, TestOne);
+    }
+
+    // GCC and Clang only emit AVX instructions in functions compiled for it.  Everything up to the matching pop
+    // is, and it is only called once DetectSupport() has said the CPU and OS can run it.
+#if defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx")
+#endif
+
+    struct PlanesAVX
+    {
+        __m256 Box[CullingPlanes::kMaxPlanes][7];
+        __m256 Sphere[CullingPlanes::kMaxPlanes][4];
+        uint32_t NumPlanes;
+
+        PlanesAVX( const CullingPlanes& P ) : NumPlanes(P.GetNumPlanes())
+        {
+            for (uint32_t p = 0; p < NumPlanes; ++p)
+            {
+                Box[p][0] = _mm256_set1_ps(P.PosX[p]);
+                Box[p][1] = _mm256_set1_ps(P.NegX[p]);
+                Box[p][2] = _mm256_set1_ps(P.PosY[p]);
+                Box[p][3] = _mm256_set1_ps(P.NegY[p]);
+                Box[p][4] = _mm256_set1_ps(P.PosZ[p]);
+                Box[p][5] = _mm256_set1_ps(P.NegZ[p]);
+                Box[p][6] = _mm256_set1_ps(P.D[p]);
+                Sphere[p][0] = _mm256_set1_ps(P.NormalX[p]);
+                Sphere[p][1] = _mm256_set1_ps(P.NormalY[p]);
+                Sphere[p][2] = _mm256_set1_ps(P.NormalZ[p]);
+                Sphere[p][3] = _mm256_set1_ps(P.D[p]);
+            }
+        }
+    };
+
+    uint32_t CullBoxesAVX( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+    {
+        const PlanesAVX P(Planes);
+        const __m256 Zero = _mm256_setzero_ps();
+
+        auto Test = [&]( uint32_t i ) -> uint32_t
+        {
+            const __m256 MinX = _mm256_loadu_ps(Boxes.MinX + i);
+            const __m256 MinY = _mm256_loadu_ps(Boxes.MinY + i);
+            const __m256 MinZ = _mm256_loadu_ps(Boxes.MinZ + i);
+            const __m256 MaxX = _mm256_loadu_ps(Boxes.MaxX + i);
+            const __m256 MaxY = _mm256_loadu_ps(Boxes.MaxY + i);
+            const __m256 MaxZ = _mm256_loadu_ps(Boxes.MaxZ + i);
+
+            __m256 Inside = _mm256_cmp_ps(Zero, Zero, _CMP_EQ_OQ);
+            for (uint32_t p = 0; p < P.NumPlanes; ++p)
+            {
+                const __m256* Plane = P.Box[p];
+                __m256 Dist = _mm256_add_ps(Plane[6], _mm256_mul_ps(Plane[0], MaxX));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[1], MinX));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[2], MaxY));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[3], MinY));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[4], MaxZ));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[5], MinZ));
+                Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(Dist, Zero, _CMP_GE_OQ));
+            }
+            return (uint32_t)_mm256_movemask_ps(Inside);
+        };
+
+        auto TestOne = [&]( uint32_t i ) { return TestBoxScalar(Planes, Boxes, i); };
+        const uint32_t Visible = CullRange<8>(First, Count, VisibleMask, Test, TestOne);
+        _mm256_zeroupper();
+        return Visible;
+    }
+
+    uint32_t CullSpheresAVX( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+    {
+        const PlanesAVX P(Planes);
+        const __m256 Zero = _mm256_setzero_ps();
+
+        auto Test = [&]( uint32_t i ) -> uint32_t
+        {
+            const __m256 CenterX = _mm256_loadu_ps(Spheres.CenterX + i);
+            const __m256 CenterY = _mm256_loadu_ps(Spheres.CenterY + i);
+            const __m256 CenterZ = _mm256_loadu_ps(Spheres.CenterZ + i);
+            const __m256 Radius = _mm256_loadu_ps(Spheres.Radius + i);
+
+            __m256 Inside = _mm256_cmp_ps(Zero, Zero, _CMP_EQ_OQ);
+            for (uint32_t p = 0; p < P.NumPlanes; ++p)
+            {
+                const __m256* Plane = P.Sphere[p];
+                __m256 Dist = _mm256_add_ps(Plane[3], _mm256_mul_ps(Plane[0], CenterX));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[1], CenterY));
+                Dist = _mm256_add_ps(Dist, _mm256_mul_ps(Plane[2], CenterZ));
+                Dist = _mm256_add_ps(Dist, Radius);
+                Inside = _mm256_and_ps(Inside, _mm256_cmp_ps(Dist, Zero, _CMP_GE_OQ));
+            }
+            return (uint32_t)_mm256_movemask_ps(Inside);
+        };
+
+        auto TestOne = [&]( uint32_t i ) { return TestSphereScalar(Planes, Spheres, i); };
+        const uint32_t Visible = CullRange<8>(First, Count, VisibleMask, Test, TestOne);
+        _mm256_zeroupper();
+        return Visible;
+    }
+
+#if defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif // CULL_X86
+
+    typedef uint32_t (*CullBoxesFunction)( const CullingPlanes&, const BoxArrays&, uint32_t, uint32_t, uint32_t* );
+    typedef uint32_t (*CullSpheresFunction)( const CullingPlanes&, const SphereArrays&, uint32_t, uint32_t, uint32_t* );
+
+    const CullBoxesFunction s_CullBoxesFunctions[kNumCullImplementations] =
+    {
+        CullBoxesScalar,
+#if CULL_X86
+        CullBoxesSSE,
+        CullBoxesAVX,
+#else
+        nullptr,
+        nullptr,
+#endif
+    };
+
+    const CullSpheresFunction s_CullSpheresFunctions[kNumCullImplementations] =
+    {
+        CullSpheresScalar,
+#if CULL_X86
+        CullSpheresSSE,
+        CullSpheresAVX,
+#else
+        nullptr,
+        nullptr,
+#endif
+    };
+
+#if CULL_X86
+    void CpuId( int Info[4], int Leaf )
+    {
+#if defined(_MSC_VER)
+        __cpuid(Info, Leaf);
+#else
+        unsigned int a = 0, b = 0, c = 0, d = 0;
+        __get_cpuid((unsigned int)Leaf, &a, &b, &c, &d);
+        Info[0] = (int)a; Info[1] = (int)b; Info[2] = (int)c; Info[3] = (int)d;
+#endif
+    }
+
+    uint64_t ReadXCR0( void )
+    {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        uint32_t Lo, Hi;
+        __asm__ __volatile__("xgetbv" : "=a"(Lo), "=d"(Hi) : "c"(0));
+        return ((uint64_t)Hi << 32) | Lo;
+#endif
+    }
+#endif
+
+    bool DetectSupport( CullImplementation Impl )
+    {
+        if (s_CullBoxesFunctions[Impl] == nullptr)
+            return false;
+
+        // SSE2 is part of x64, and every x86 CPU the engine runs on
+        if (Impl == kCullScalar || Impl == kCullSSE)
+            return true;
+
+#if CULL_X86
+        int Info[4];
+        CpuId(Info, 1);
+        const bool HasAVX = (Info[2] & (1 << 28)) != 0;
+        const bool HasOSXSAVE = (Info[2] & (1 << 27)) != 0;
+
+        // The OS must also preserve the upper halves of the YMM registers
+        return HasAVX && HasOSXSAVE && (ReadXCR0() & 6) == 6;
+#else
+        return false;
+#endif
+    }
+
+    struct CullDispatch
+    {
+        bool Supported[kNumCullImplementations];
+        CullImplementation Best;
+
+        CullDispatch() : Best(kCullScalar)
+        {
+            for (uint32_t i = 0; i < kNumCullImplementations; ++i)
+            {
+                Supported[i] = DetectSupport((CullImplementation)i);
+                if (Supported[i])
+                    Best = (CullImplementation)i;
+            }
+        }
+    };
+
+    const CullDispatch& GetDispatch( void )
+    {
+        static const CullDispatch s_Dispatch;
+        return s_Dispatch;
+    }
+
+    // Culls chunks of the batch on the worker threads.  CullChunk(First, Count) returns the number visible.
+    template <typename Func>
+    uint32_t ParallelCull( uint32_t Count, uint32_t ChunkSize, Func CullChunk )
+    {
+        ChunkSize = max((ChunkSize + kCullAlignment - 1) / kCullAlignment * kCullAlignment, kCullAlignment);
+        const uint32_t NumChunks = (Count + ChunkSize - 1) / ChunkSize;
+
+        if (NumChunks <= 1)
+            return CullChunk(0, Count);
+
+        atomic<uint32_t> Visible(0);
+
+        auto CullOneChunk = [&]( uint32_t Chunk )
+        {
+            const uint32_t First = Chunk * ChunkSize;
+            Visible += CullChunk(First, min(ChunkSize, Count - First));
+        };
+
+#if defined(_WIN32)
+        concurrency::parallel_for(0u, NumChunks, CullOneChunk);
+#else
+        // Each thread takes the next chunk until there are none left, so uneven chunks balance out
+        atomic<uint32_t> NextChunk(0);
+        auto Worker = [&]( void )
+        {
+            for (uint32_t Chunk = NextChunk++; Chunk < NumChunks; Chunk = NextChunk++)
+                CullOneChunk(Chunk);
+        };
+
+        const uint32_t NumThreads = min(max(thread::hardware_concurrency(), 1u), NumChunks);
+        vector<thread> Threads;
+        for (uint32_t i = 1; i < NumThreads; ++i)
+            Threads.emplace_back(Worker);
+        Worker();
+        for (auto& Thread : Threads)
+            Thread.join();
+#endif
+
+        return Visible;
+    }
+}
+
+CullImplementation Math::GetCullImplementation( void )
+{
+    return GetDispatch().Best;
+}
+
+bool Math::IsCullImplementationSupported( CullImplementation Impl )
+{
+    return Impl < kNumCullImplementations && GetDispatch().Supported[Impl];
+}
+
+const char* Math::GetCullImplementationName( CullImplementation Impl )
+{
+    switch (Impl)
+    {
+    case kCullScalar: return "Scalar";
+    case kCullSSE: return "SSE";
+    case kCullAVX: return "AVX";
+    default: return "Unknown";
+    }
+}
+
+uint32_t Math::CullBoxes( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+{
+    static const CullBoxesFunction s_BestFunction = s_CullBoxesFunctions[GetDispatch().Best];
+    return s_BestFunction(Planes, Boxes, First, Count, VisibleMask);
+}
+
+uint32_t Math::CullSpheres( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+{
+    static const CullSpheresFunction s_BestFunction = s_CullSpheresFunctions[GetDispatch().Best];
+    return s_BestFunction(Planes, Spheres, First, Count, VisibleMask);
+}
+
+uint32_t Math::CullBoxes( CullImplementation Impl, const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+{
+    ASSERT(IsCullImplementationSupported(Impl), "Cull implementation is not supported on this CPU");
+    return s_CullBoxesFunctions[Impl](Planes, Boxes, First, Count, VisibleMask);
+}
+
+uint32_t Math::CullSpheres( CullImplementation Impl, const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask )
+{
+    ASSERT(IsCullImplementationSupported(Impl), "Cull implementation is not supported on this CPU");
+    return s_CullSpheresFunctions[Impl](Planes, Spheres, First, Count, VisibleMask);
+}
+
+uint32_t Math::ParallelCullBoxes( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t Count, uint32_t* VisibleMask, uint32_t ChunkSize )
+{
+    return ParallelCull(Count, ChunkSize, [&]( uint32_t First, uint32_t ChunkCount )
+    {
+        return CullBoxes(Planes, Boxes, First, ChunkCount, VisibleMask);
+    });
+}
+
+uint32_t Math::ParallelCullSpheres( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t Count, uint32_t* VisibleMask, uint32_t ChunkSize )
+{
+    return ParallelCull(Count, ChunkSize, [&]( uint32_t First, uint32_t ChunkCount )
+    {
+        return CullSpheres(Planes, Spheres, First, ChunkCount, VisibleMask);
+    });
+}
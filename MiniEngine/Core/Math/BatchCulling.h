@@ -0,0 +1,107 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Culls many bounding boxes or spheres against a set of planes at once.  Bounds are passed as
+// structures of arrays, and the planes are stored transposed, so that four objects (SSE) or eight (AVX) are
+// tested against each plane with a handful of multiply-adds and no shuffles.  The result is a bit mask with
+// bit i of word i / 32 set when object i is at least partly inside every plane.
+//
+// A range of objects may be culled on each worker thread as long as every range but the last begins and ends
+// on a multiple of kCullAlignment, so that no two write the same mask word.  ParallelCullBoxes() does that.
+//
+// This file has no dependencies on the rest of the engine, so that tools can use it on any platform.
+//
+
+#pragma once
+
+#include <cstdint>
+
+namespace Math
+{
+    // Planes face inward:  a point p is inside when Dot(Normal, p) + D >= 0.  Sphere tests need normalized
+    // normals; box tests don't.
+    class CullingPlanes
+    {
+    public:
+        static const uint32_t kMaxPlanes = 8;
+
+        CullingPlanes() : m_NumPlanes(0) {}
+
+        void AddPlane( float A, float B, float C, float D );
+        uint32_t GetNumPlanes( void ) const { return m_NumPlanes; }
+
+        // Transposed, and with the normals split into positive and negative parts.  A box's farthest corner
+        // along a normal is then PosX * MaxX + NegX * MinX + ... with no per-plane selects.
+        float NormalX[kMaxPlanes], NormalY[kMaxPlanes], NormalZ[kMaxPlanes], D[kMaxPlanes];
+        float PosX[kMaxPlanes], PosY[kMaxPlanes], PosZ[kMaxPlanes];
+        float NegX[kMaxPlanes], NegY[kMaxPlanes], NegZ[kMaxPlanes];
+
+    private:
+        uint32_t m_NumPlanes;
+    };
+
+    // Structure of arrays bounds.  The arrays need no particular alignment.
+    struct BoxArrays
+    {
+        const float* MinX;
+        const float* MinY;
+        const float* MinZ;
+        const float* MaxX;
+        const float* MaxY;
+        const float* MaxZ;
+    };
+
+    struct SphereArrays
+    {
+        const float* CenterX;
+        const float* CenterY;
+        const float* CenterZ;
+        const float* Radius;
+    };
+
+    // The fastest implementation the CPU supports is used by default.  They all produce the same masks.
+    enum CullImplementation
+    {
+        kCullScalar,
+        kCullSSE,
+        kCullAVX,
+
+        kNumCullImplementations
+    };
+
+    CullImplementation GetCullImplementation( void );
+    bool IsCullImplementationSupported( CullImplementation Impl );
+    const char* GetCullImplementationName( CullImplementation Impl );
+
+    const uint32_t kCullAlignment = 32;
+
+    // Words needed for a mask of Count objects
+    inline uint32_t GetCullMaskSize( uint32_t Count ) { return (Count + 31) / 32; }
+
+    // Culls objects [First, First + Count).  First must be a multiple of kCullAlignment.  The mask words the
+    // range covers are overwritten, with any bits past the end of the range cleared.  Returns the number of
+    // objects inside.
+    uint32_t CullBoxes( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask );
+    uint32_t CullSpheres( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask );
+
+    // Same as above but with a specific implementation, which must be supported
+    uint32_t CullBoxes( CullImplementation Impl, const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t First, uint32_t Count, uint32_t* VisibleMask );
+    uint32_t CullSpheres( CullImplementation Impl, const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t First, uint32_t Count, uint32_t* VisibleMask );
+
+    // Splits objects [0, Count) into chunks of ChunkSize, rounded up to kCullAlignment, and culls them on the
+    // worker threads.  Small batches aren't worth splitting; they are culled on the calling thread.
+    uint32_t ParallelCullBoxes( const CullingPlanes& Planes, const BoxArrays& Boxes, uint32_t Count, uint32_t* VisibleMask, uint32_t ChunkSize = 16384 );
+    uint32_t ParallelCullSpheres( const CullingPlanes& Planes, const SphereArrays& Spheres, uint32_t Count, uint32_t* VisibleMask, uint32_t ChunkSize = 16384 );
+
+    inline bool IsVisible( const uint32_t* VisibleMask, uint32_t Index )
+    {
+        return (VisibleMask[Index / 32] & (1u << (Index % 32))) != 0;
+    }
+}
@@ -0,0 +1,733 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "DynamicAABBTree.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <queue>
+
+using namespace std;
+using namespace Math;
+
+namespace
+{
+    // Half the surface area, which is all the costs need
+    inline float Area( const float* MinBound, const float* MaxBound )
+    {
+        const float dx = MaxBound[0] - MinBound[0];
+        const float dy = MaxBound[1] - MinBound[1];
+        const float dz = MaxBound[2] - MinBound[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+
+    inline float UnionArea( const float* MinA, const float* MaxA, const float* MinB, const float* MaxB )
+    {
+        float MinBound[3], MaxBound[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            MinBound[i] = min(MinA[i], MinB[i]);
+            MaxBound[i] = max(MaxA[i], MaxB[i]);
+        }
+        return Area(MinBound, MaxBound);
+    }
+
+    inline bool Overlaps( const float* MinA, const float* MaxA, const float* MinB, const float* MaxB )
+    {
+        return MinA[0] <= MaxB[0] && MinA[1] <= MaxB[1] && MinA[2] <= MaxB[2] &&
+            MaxA[0] >= MinB[0] && MaxA[1] >= MinB[1] && MaxA[2] >= MinB[2];
+    }
+
+    inline float DistanceSquared( const float* Point, const float* MinBound, const float* MaxBound )
+    {
+        float Sum = 0.0f;
+        for (int i = 0; i < 3; ++i)
+        {
+            const float d = max(max(MinBound[i] - Point[i], Point[i] - MaxBound[i]), 0.0f);
+            Sum += d * d;
+        }
+        return Sum;
+    }
+
+    // A ray with everything the slab test needs precomputed
+    struct Ray
+    {
+        float Origin[3];
+        float InvDirection[3];
+        bool Parallel[3];
+
+        Ray( const float* O, const float* Direction )
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                Origin[i] = O[i];
+                Parallel[i] = Direction[i] == 0.0f;
+                InvDirection[i] = Parallel[i] ? 0.0f : 1.0f / Direction[i];
+            }
+        }
+
+        // Where the ray enters the box, if it does before MaxDistance
+        bool Intersect( const float* MinBound, const float* MaxBound, float MaxDistance, float& Entry ) const
+        {
+            float Near = 0.0f, Far = MaxDistance;
+            for (int i = 0; i < 3; ++i)
+            {
+                if (Parallel[i])
+                {
+                    if (Origin[i] < MinBound[i] || Origin[i] > MaxBound[i])
+                        return false;
+                    continue;
+                }
+
+                float t0 = (MinBound[i] - Origin[i]) * InvDirection[i];
+                float t1 = (MaxBound[i] - Origin[i]) * InvDirection[i];
+                if (t0 > t1)
+                    swap(t0, t1);
+                Near = max(Near, t0);
+                Far = min(Far, t1);
+                if (Near > Far)
+                    return false;
+            }
+            Entry = Near;
+            return true;
+        }
+    };
+
+    // Traversal stack, on the real stack unless the tree is unusually deep, so that queries don't allocate
+    // or share anything between threads
+    template <typename T>
+    class TraversalStack
+    {
+    public:
+        TraversalStack() : m_Size(0) {}
+
+        bool Empty( void ) const { return m_Size == 0; }
+
+        void Push( const T& Entry )
+        {
+            if (m_Size < kLocalSize)
+                m_Local[m_Size] = Entry;
+            else
+                m_Overflow.push_back(Entry);
+            ++m_Size;
+        }
+
+        T Pop( void )
+        {
+            --m_Size;
+            if (m_Size < kLocalSize)
+                return m_Local[m_Size];
+            const T Entry = m_Overflow.back();
+            m_Overflow.pop_back();
+            return Entry;
+        }
+
+    private:
+        static const uint32_t kLocalSize = 128;
+        T m_Local[kLocalSize];
+        vector<T> m_Overflow;
+        uint32_t m_Size;
+    };
+
+    typedef TraversalStack<uint32_t> NodeStack;
+
+    // A node and the frustum planes it still has to be tested against.  Planes its parent was entirely inside
+    // are skipped, and once there are none left the whole subtree is visible.
+    struct FrustumEntry
+    {
+        uint32_t Index;
+        uint32_t Planes;
+    };
+}
+
+const DynamicAABBTree::ProxyId DynamicAABBTree::kInvalidProxy;
+const uint32_t DynamicAABBTree::kNullNode;
+
+DynamicAABBTree::DynamicAABBTree( float Margin ) : m_Root(kNullNode), m_FreeList(kNullNode), m_NumProxies(0), m_Margin(Margin)
+{
+}
+
+void DynamicAABBTree::Clear( void )
+{
+    m_Nodes.clear();
+    m_Root = kNullNode;
+    m_FreeList = kNullNode;
+    m_NumProxies = 0;
+}
+
+uint32_t DynamicAABBTree::AllocateNode( void )
+{
+    uint32_t Index = m_FreeList;
+    if (Index != kNullNode)
+    {
+        m_FreeList = m_Nodes[Index].Parent;
+    }
+    else
+    {
+        ASSERT(m_Nodes.size() < kNullNode, "Too many nodes");
+        Index = (uint32_t)m_Nodes.size();
+        m_Nodes.emplace_back();
+    }
+
+    Node& New = m_Nodes[Index];
+    New.Parent = kNullNode;
+    New.Child[0] = New.Child[1] = kNullNode;
+    New.Height = 0;
+    New.UserData = 0;
+    return Index;
+}
+
+void DynamicAABBTree::FreeNode( uint32_t Index )
+{
+    m_Nodes[Index].Parent = m_FreeList;
+    m_Nodes[Index].Height = -1;
+    m_FreeList = Index;
+}
+
+DynamicAABBTree::ProxyId DynamicAABBTree::Insert( const float* MinBound, const float* MaxBound, uint32_t UserData )
+{
+    const uint32_t Leaf = AllocateNode();
+    Node& New = m_Nodes[Leaf];
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT(MinBound[i] <= MaxBound[i], "Inverted bounds");
+        New.Min[i] = MinBound[i] - m_Margin;
+        New.Max[i] = MaxBound[i] + m_Margin;
+    }
+    New.UserData = UserData;
+
+    InsertLeaf(Leaf);
+    ++m_NumProxies;
+    return Leaf;
+}
+
+void DynamicAABBTree::Remove( ProxyId Proxy )
+{
+    ASSERT(Proxy < m_Nodes.size() && m_Nodes[Proxy].IsLeaf() && m_Nodes[Proxy].Height == 0, "Invalid proxy");
+
+    RemoveLeaf(Proxy);
+    FreeNode(Proxy);
+    --m_NumProxies;
+}
+
+bool DynamicAABBTree::Move( ProxyId Proxy, const float* MinBound, const float* MaxBound )
+{
+    ASSERT(Proxy < m_Nodes.size() && m_Nodes[Proxy].IsLeaf() && m_Nodes[Proxy].Height == 0, "Invalid proxy");
+
+    Node& Leaf = m_Nodes[Proxy];
+    if (MinBound[0] >= Leaf.Min[0] && MinBound[1] >= Leaf.Min[1] && MinBound[2] >= Leaf.Min[2] &&
+        MaxBound[0] <= Leaf.Max[0] && MaxBound[1] <= Leaf.Max[1] && MaxBound[2] <= Leaf.Max[2])
+    {
+        return false;
+    }
+
+    RemoveLeaf(Proxy);
+
+    Node& Moved = m_Nodes[Proxy];
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT(MinBound[i] <= MaxBound[i], "Inverted bounds");
+        Moved.Min[i] = MinBound[i] - m_Margin;
+        Moved.Max[i] = MaxBound[i] + m_Margin;
+    }
+
+    InsertLeaf(Proxy);
+    return true;
+}
+
+// Finds the sibling that adds least surface area to the tree:  the area of the new parent, plus how much every
+// ancestor grows.  A subtree is only descended into while the cheapest the leaf could cost there, which is at
+// least the growth so far plus the new parent's area, is below the best sibling found.
+uint32_t DynamicAABBTree::FindBestSibling( uint32_t Leaf ) const
+{
+    const float* LeafMin = m_Nodes[Leaf].Min;
+    const float* LeafMax = m_Nodes[Leaf].Max;
+    const float LeafArea = Area(LeafMin, LeafMax);
+
+    uint32_t Index = m_Root;
+    float DirectCost = UnionArea(m_Nodes[Index].Min, m_Nodes[Index].Max, LeafMin, LeafMax);
+    float InheritedCost = 0.0f;
+
+    uint32_t BestSibling = Index;
+    float BestCost = DirectCost;
+
+    while (!m_Nodes[Index].IsLeaf())
+    {
+        const Node& Current = m_Nodes[Index];
+
+        const float Cost = DirectCost + InheritedCost;
+        if (Cost < BestCost)
+        {
+            BestSibling = Index;
+            BestCost = Cost;
+        }
+
+        // Anything below grows this node too
+        InheritedCost += DirectCost - Area(Current.Min, Current.Max);
+
+        float ChildDirectCost[2];
+        float LowerBound[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            const Node& Child = m_Nodes[Current.Child[c]];
+            ChildDirectCost[c] = UnionArea(Child.Min, Child.Max, LeafMin, LeafMax);
+            LowerBound[c] = FLT_MAX;
+
+            if (Child.IsLeaf())
+            {
+                const float ChildCost = ChildDirectCost[c] + InheritedCost;
+                if (ChildCost < BestCost)
+                {
+                    BestSibling = Current.Child[c];
+                    BestCost = ChildCost;
+                }
+            }
+            else
+            {
+                LowerBound[c] = InheritedCost + ChildDirectCost[c] + min(LeafArea - Area(Child.Min, Child.Max), 0.0f);
+            }
+        }
+
+        if (BestCost <= LowerBound[0] && BestCost <= LowerBound[1])
+            break;
+
+        const int Next = LowerBound[0] <= LowerBound[1] ? 0 : 1;
+        Index = Current.Child[Next];
+        DirectCost = ChildDirectCost[Next];
+    }
+
+    return BestSibling;
+}
+
+void DynamicAABBTree::InsertLeaf( uint32_t Leaf )
+{
+    if (m_Root == kNullNode)
+    {
+        m_Root = Leaf;
+        m_Nodes[Leaf].Parent = kNullNode;
+        return;
+    }
+
+    const uint32_t Sibling = FindBestSibling(Leaf);
+    const uint32_t OldParent = m_Nodes[Sibling].Parent;
+    const uint32_t NewParent = AllocateNode();
+
+    Node& Parent = m_Nodes[NewParent];
+    Parent.Parent = OldParent;
+    Parent.Child[0] = Sibling;
+    Parent.Child[1] = Leaf;
+    RefitNode(NewParent);
+
+    if (OldParent == kNullNode)
+        m_Root = NewParent;
+    else
+        m_Nodes[OldParent].Child[m_Nodes[OldParent].Child[0] == Sibling ? 0 : 1] = NewParent;
+
+    m_Nodes[Sibling].Parent = NewParent;
+    m_Nodes[Leaf].Parent = NewParent;
+
+    FixUpwards(OldParent);
+}
+
+// The leaf's parent goes away and its sibling takes the parent's place
+void DynamicAABBTree::RemoveLeaf( uint32_t Leaf )
+{
+    if (Leaf == m_Root)
+    {
+        m_Root = kNullNode;
+        return;
+    }
+
+    const uint32_t Parent = m_Nodes[Leaf].Parent;
+    const uint32_t GrandParent = m_Nodes[Parent].Parent;
+    const uint32_t Sibling = m_Nodes[Parent].Child[m_Nodes[Parent].Child[0] == Leaf ? 1 : 0];
+
+    m_Nodes[Sibling].Parent = GrandParent;
+    FreeNode(Parent);
+
+    if (GrandParent == kNullNode)
+    {
+        m_Root = Sibling;
+        return;
+    }
+
+    m_Nodes[GrandParent].Child[m_Nodes[GrandParent].Child[0] == Parent ? 0 : 1] = Sibling;
+    FixUpwards(GrandParent);
+}
+
+void DynamicAABBTree::RefitNode( uint32_t Index )
+{
+    Node& Current = m_Nodes[Index];
+    const Node& Child0 = m_Nodes[Current.Child[0]];
+    const Node& Child1 = m_Nodes[Current.Child[1]];
+    Current.Height = 1 + max(Child0.Height, Child1.Height);
+    for (int i = 0; i < 3; ++i)
+    {
+        Current.Min[i] = min(Child0.Min[i], Child1.Min[i]);
+        Current.Max[i] = max(Child0.Max[i], Child1.Max[i]);
+    }
+}
+
+// Refits every node from Index to the root, rotating each where that shrinks the tree
+void DynamicAABBTree::FixUpwards( uint32_t Index )
+{
+    while (Index != kNullNode)
+    {
+        RefitNode(Index);
+        Rotate(Index);
+        Index = m_Nodes[Index].Parent;
+    }
+}
+
+// Tries swapping each child of A with each child of its sibling.  Only the sibling's bounds change, so the swap
+// that shrinks it most is made, if any does.  Insertion alone would otherwise leave early objects grouped in ways
+// that suited the tree when it was small.
+void DynamicAABBTree::Rotate( uint32_t A )
+{
+    if (m_Nodes[A].Height < 2)
+        return;
+
+    float BestChange = 0.0f;
+    int BestDown = -1, BestUp = -1;
+
+    for (int Down = 0; Down < 2; ++Down)
+    {
+        const Node& Moved = m_Nodes[m_Nodes[A].Child[Down]];
+        const Node& Sibling = m_Nodes[m_Nodes[A].Child[1 - Down]];
+        if (Sibling.IsLeaf())
+            continue;
+
+        const float SiblingArea = Area(Sibling.Min, Sibling.Max);
+        for (int Up = 0; Up < 2; ++Up)
+        {
+            // Moved takes the place of Sibling's child Up, next to the other one
+            const Node& Kept = m_Nodes[Sibling.Child[1 - Up]];
+            const float Change = UnionArea(Moved.Min, Moved.Max, Kept.Min, Kept.Max) - SiblingArea;
+            if (Change < BestChange)
+            {
+                BestChange = Change;
+                BestDown = Down;
+                BestUp = Up;
+            }
+        }
+    }
+
+    if (BestDown < 0)
+        return;
+
+    const uint32_t Moved = m_Nodes[A].Child[BestDown];
+    const uint32_t Sibling = m_Nodes[A].Child[1 - BestDown];
+    const uint32_t Raised = m_Nodes[Sibling].Child[BestUp];
+
+    m_Nodes[A].Child[BestDown] = Raised;
+    m_Nodes[Raised].Parent = A;
+    m_Nodes[Sibling].Child[BestUp] = Moved;
+    m_Nodes[Moved].Parent = Sibling;
+
+    RefitNode(Sibling);
+    RefitNode(A);
+}
+
+uint32_t DynamicAABBTree::GetHeight( void ) const
+{
+    return m_Root == kNullNode ? 0 : (uint32_t)m_Nodes[m_Root].Height;
+}
+
+float DynamicAABBTree::GetAreaRatio( void ) const
+{
+    if (m_Root == kNullNode)
+        return 0.0f;
+
+    const float RootArea = Area(m_Nodes[m_Root].Min, m_Nodes[m_Root].Max);
+    if (RootArea <= 0.0f)
+        return 0.0f;
+
+    double TotalArea = 0.0;
+    for (const Node& Current : m_Nodes)
+    {
+        if (Current.Height >= 0)
+            TotalArea += Area(Current.Min, Current.Max);
+    }
+    return (float)(TotalArea / RootArea);
+}
+
+void DynamicAABBTree::QueryFrustum( const CullingPlanes& Planes, vector<uint32_t>& Results ) const
+{
+    if (m_Root == kNullNode)
+        return;
+
+    const uint32_t NumPlanes = Planes.GetNumPlanes();
+
+    TraversalStack<FrustumEntry> Stack;
+    FrustumEntry Root = { m_Root, (1u << NumPlanes) - 1 };
+    Stack.Push(Root);
+    while (!Stack.Empty())
+    {
+        FrustumEntry Entry = Stack.Pop();
+        const Node& Current = m_Nodes[Entry.Index];
+
+        // The farthest corner along each normal must be inside every plane.  Planes that even the nearest corner
+        // is inside are dropped for the subtree.
+        bool Outside = false;
+        for (uint32_t p = 0; p < NumPlanes && !Outside; ++p)
+        {
+            if ((Entry.Planes & (1u << p)) == 0)
+                continue;
+
+            const float Far = Planes.PosX[p] * Current.Max[0] + Planes.NegX[p] * Current.Min[0] +
+                Planes.PosY[p] * Current.Max[1] + Planes.NegY[p] * Current.Min[1] +
+                Planes.PosZ[p] * Current.Max[2] + Planes.NegZ[p] * Current.Min[2] + Planes.D[p];
+            const float Near = Planes.PosX[p] * Current.Min[0] + Planes.NegX[p] * Current.Max[0] +
+                Planes.PosY[p] * Current.Min[1] + Planes.NegY[p] * Current.Max[1] +
+                Planes.PosZ[p] * Current.Min[2] + Planes.NegZ[p] * Current.Max[2] + Planes.D[p];
+            Outside = Far < 0.0f;
+            if (Near >= 0.0f)
+                Entry.Planes &= ~(1u << p);
+        }
+        if (Outside)
+            continue;
+
+        if (Current.IsLeaf())
+        {
+            Results.push_back(Current.UserData);
+            continue;
+        }
+
+        FrustumEntry Child0 = { Current.Child[0], Entry.Planes };
+        FrustumEntry Child1 = { Current.Child[1], Entry.Planes };
+        Stack.Push(Child0);
+        Stack.Push(Child1);
+    }
+}
+
+void DynamicAABBTree::QuerySphere( const float* Center, float Radius, vector<uint32_t>& Results ) const
+{
+    if (m_Root == kNullNode)
+        return;
+
+    const float RadiusSquared = Radius * Radius;
+
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        if (DistanceSquared(Center, Current.Min, Current.Max) > RadiusSquared)
+            continue;
+
+        if (Current.IsLeaf())
+        {
+            Results.push_back(Current.UserData);
+        }
+        else
+        {
+            Stack.Push(Current.Child[0]);
+            Stack.Push(Current.Child[1]);
+        }
+    }
+}
+
+void DynamicAABBTree::QueryBox( const float* MinBound, const float* MaxBound, vector<uint32_t>& Results ) const
+{
+    if (m_Root == kNullNode)
+        return;
+
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        if (!Overlaps(Current.Min, Current.Max, MinBound, MaxBound))
+            continue;
+
+        if (Current.IsLeaf())
+        {
+            Results.push_back(Current.UserData);
+        }
+        else
+        {
+            Stack.Push(Current.Child[0]);
+            Stack.Push(Current.Child[1]);
+        }
+    }
+}
+
+void DynamicAABBTree::QueryRay( const float* Origin, const float* Direction, float MaxDistance, vector<RayHit>& Hits ) const
+{
+    if (m_Root == kNullNode)
+        return;
+
+    const Ray R(Origin, Direction);
+    const size_t FirstHit = Hits.size();
+
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        float Entry;
+        if (!R.Intersect(Current.Min, Current.Max, MaxDistance, Entry))
+            continue;
+
+        if (Current.IsLeaf())
+        {
+            RayHit Hit = { Current.UserData, Entry };
+            Hits.push_back(Hit);
+        }
+        else
+        {
+            Stack.Push(Current.Child[0]);
+            Stack.Push(Current.Child[1]);
+        }
+    }
+
+    sort(Hits.begin() + FirstHit, Hits.end(), []( const RayHit& a, const RayHit& b ) { return a.Distance < b.Distance; });
+}
+
+bool DynamicAABBTree::RayCast( const float* Origin, const float* Direction, float MaxDistance, RayHit& Hit ) const
+{
+    if (m_Root == kNullNode)
+        return false;
+
+    const Ray R(Origin, Direction);
+    float Best = MaxDistance;
+    bool Found = false;
+    float Entry;
+
+    if (!R.Intersect(m_Nodes[m_Root].Min, m_Nodes[m_Root].Max, Best, Entry))
+        return false;
+
+    // Nodes are only pushed once the ray is known to reach them, but may be passed over if a nearer hit turns up
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const Node& Current = m_Nodes[Stack.Pop()];
+        if (!R.Intersect(Current.Min, Current.Max, Best, Entry))
+            continue;
+
+        if (Current.IsLeaf())
+        {
+            Best = Entry;
+            Hit.UserData = Current.UserData;
+            Hit.Distance = Entry;
+            Found = true;
+            continue;
+        }
+
+        float Entries[2];
+        bool Reached[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            const Node& Child = m_Nodes[Current.Child[c]];
+            Reached[c] = R.Intersect(Child.Min, Child.Max, Best, Entries[c]);
+        }
+
+        // The nearer child goes on top
+        const int Near = !Reached[1] || (Reached[0] && Entries[0] <= Entries[1]) ? 0 : 1;
+        if (Reached[1 - Near])
+            Stack.Push(Current.Child[1 - Near]);
+        if (Reached[Near])
+            Stack.Push(Current.Child[Near]);
+    }
+
+    return Found;
+}
+
+void DynamicAABBTree::QueryNearest( const float* Point, uint32_t Count, vector<Neighbor>& Results ) const
+{
+    if (m_Root == kNullNode || Count == 0)
+        return;
+
+    // Nodes by distance, nearest on top, and the best leaves so far, farthest on top
+    typedef pair<float, uint32_t> Candidate;
+    priority_queue<Candidate, vector<Candidate>, greater<Candidate>> Open;
+    priority_queue<Candidate> Best;
+
+    Open.push(Candidate(DistanceSquared(Point, m_Nodes[m_Root].Min, m_Nodes[m_Root].Max), m_Root));
+    while (!Open.empty())
+    {
+        const Candidate Next = Open.top();
+        Open.pop();
+
+        // Everything left is at least this far away
+        if (Best.size() == Count && Next.first >= Best.top().first)
+            break;
+
+        const Node& Current = m_Nodes[Next.second];
+        if (Current.IsLeaf())
+        {
+            Best.push(Next);
+            if (Best.size() > Count)
+                Best.pop();
+            continue;
+        }
+
+        for (int c = 0; c < 2; ++c)
+        {
+            const Node& Child = m_Nodes[Current.Child[c]];
+            const float DistSq = DistanceSquared(Point, Child.Min, Child.Max);
+            if (Best.size() < Count || DistSq < Best.top().first)
+                Open.push(Candidate(DistSq, Current.Child[c]));
+        }
+    }
+
+    const size_t FirstResult = Results.size();
+    Results.resize(FirstResult + Best.size());
+    for (size_t i = Results.size(); i-- > FirstResult; )
+    {
+        Results[i].UserData = m_Nodes[Best.top().second].UserData;
+        Results[i].Distance = sqrtf(Best.top().first);
+        Best.pop();
+    }
+}
+
+void DynamicAABBTree::Validate( void ) const
+{
+    if (m_Root == kNullNode)
+    {
+        ASSERT(m_NumProxies == 0, "Proxies missing from the tree");
+        return;
+    }
+
+    ASSERT(m_Nodes[m_Root].Parent == kNullNode, "The root has a parent");
+
+    uint32_t NumLeaves = 0;
+    NodeStack Stack;
+    Stack.Push(m_Root);
+    while (!Stack.Empty())
+    {
+        const uint32_t Index = Stack.Pop();
+        const Node& Current = m_Nodes[Index];
+        if (Current.IsLeaf())
+        {
+            ASSERT(Current.Height == 0, "Leaf with a height");
+            ++NumLeaves;
+            continue;
+        }
+
+        const Node& Child0 = m_Nodes[Current.Child[0]];
+        const Node& Child1 = m_Nodes[Current.Child[1]];
+        ASSERT(Child0.Parent == Index && Child1.Parent == Index, "Broken parent link");
+        ASSERT(Current.Height == 1 + max(Child0.Height, Child1.Height), "Wrong height");
+        for (int i = 0; i < 3; ++i)
+        {
+            ASSERT(Current.Min[i] == min(Child0.Min[i], Child1.Min[i]), "Bounds not refit");
+            ASSERT(Current.Max[i] == max(Child0.Max[i], Child1.Max[i]), "Bounds not refit");
+        }
+
+        Stack.Push(Current.Child[0]);
+        Stack.Push(Current.Child[1]);
+    }
+
+    ASSERT(NumLeaves == m_NumProxies, "Proxies missing from the tree");
+}
@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A bounding volume hierarchy of axis aligned boxes that objects can be added to, moved in and
+// removed from one at a time, for finding what a frustum, sphere or ray touches, or what is nearest a point,
+// without looping over every object.
+//
+// Each object is a leaf holding its box grown by a margin.  Moving an object within that fat box costs nothing;
+// moving it out of it reinserts the leaf.  Leaves are inserted next to the sibling that grows the tree's surface
+// area least, and nodes are rotated on the way back up wherever that shrinks it, since the surface area is what
+// decides how many nodes a query visits.
+//
+// Queries don't modify the tree and keep their state on the stack, so any number of threads may query at once.
+// Changes need the tree to themselves.  Like BatchCulling, this file has no dependencies on the rest of the
+// engine:  bounds are passed as float arrays, so a Model::BoundingBox can be passed as (const float*)&Box.min
+// and (const float*)&Box.max, and a Frustum as its GetCullingPlanes().
+//
+
+#pragma once
+
+#include "BatchCulling.h"
+#include <vector>
+
+namespace Math
+{
+    class DynamicAABBTree
+    {
+    public:
+        typedef uint32_t ProxyId;
+        static const ProxyId kInvalidProxy = ~0u;
+
+        struct RayHit
+        {
+            uint32_t UserData;
+            float Distance;         // Where the ray enters the object's box, in multiples of the direction
+        };
+
+        struct Neighbor
+        {
+            uint32_t UserData;
+            float Distance;         // From the point to the object's box, zero when inside
+        };
+
+        // Boxes are stored grown by Margin on every side, so that objects can move that far without changing
+        // the tree
+        explicit DynamicAABBTree( float Margin = 0.0f );
+
+        void Clear( void );
+
+        ProxyId Insert( const float* MinBound, const float* MaxBound, uint32_t UserData );
+        void Remove( ProxyId Proxy );
+
+        // Returns true when the object left its fat box and was reinserted
+        bool Move( ProxyId Proxy, const float* MinBound, const float* MaxBound );
+
+        uint32_t GetUserData( ProxyId Proxy ) const { return m_Nodes[Proxy].UserData; }
+        const float* GetFatMin( ProxyId Proxy ) const { return m_Nodes[Proxy].Min; }
+        const float* GetFatMax( ProxyId Proxy ) const { return m_Nodes[Proxy].Max; }
+
+        uint32_t GetNumProxies( void ) const { return m_NumProxies; }
+        uint32_t GetHeight( void ) const;
+
+        // The summed surface area of every node over that of the root.  Lower is a better tree.
+        float GetAreaRatio( void ) const;
+
+        // Queries append the user data of every object whose fat box the shape touches, in no particular order.
+        // The results are conservative:  objects just outside may be included, as with the margin.
+        void QueryFrustum( const CullingPlanes& Planes, std::vector<uint32_t>& Results ) const;
+        void QuerySphere( const float* Center, float Radius, std::vector<uint32_t>& Results ) const;
+        void QueryBox( const float* MinBound, const float* MaxBound, std::vector<uint32_t>& Results ) const;
+
+        // Every object whose box the ray [Origin, Origin + Direction * MaxDistance] passes through, nearest first,
+        // for testing the objects themselves in order
+        void QueryRay( const float* Origin, const float* Direction, float MaxDistance, std::vector<RayHit>& Hits ) const;
+
+        // Only the nearest box hit, visiting the nearer child first and skipping anything farther than the best
+        bool RayCast( const float* Origin, const float* Direction, float MaxDistance, RayHit& Hit ) const;
+
+        // Up to Count objects whose boxes are nearest the point, nearest first
+        void QueryNearest( const float* Point, uint32_t Count, std::vector<Neighbor>& Results ) const;
+
+        // Checks the links, heights and bounds of every node.  For debugging; it visits the whole tree.
+        void Validate( void ) const;
+
+    private:
+        static const uint32_t kNullNode = ~0u;
+
+        struct Node
+        {
+            float Min[3];
+            float Max[3];
+            uint32_t Parent;        // Or the next free node
+            uint32_t Child[2];      // Both kNullNode for leaves
+            int32_t Height;         // Zero for leaves, -1 when free
+            uint32_t UserData;
+
+            bool IsLeaf( void ) const { return Child[0] == kNullNode; }
+        };
+
+        uint32_t AllocateNode( void );
+        void FreeNode( uint32_t Index );
+        uint32_t FindBestSibling( uint32_t Leaf ) const;
+        void InsertLeaf( uint32_t Leaf );
+        void RemoveLeaf( uint32_t Leaf );
+        void RefitNode( uint32_t Index );
+        void FixUpwards( uint32_t Index );
+        void Rotate( uint32_t Index );
+
+        std::vector<Node> m_Nodes;
+        uint32_t m_Root;
+        uint32_t m_FreeList;
+        uint32_t m_NumProxies;
+        float m_Margin;
+    };
+}
@@ -15,6 +15,7 @@
 
 #include "BoundingPlane.h"
 #include "BoundingSphere.h"
+#include "BatchCulling.h"
 
 namespace Math
 {
@@ -47,6 +48,11 @@ namespace Math
         // simple struct in the Model project.)
         bool IntersectBoundingBox(const Vector3 minBound, const Vector3 maxBound) const;
 
+        // For culling many objects at once.  See BatchCulling.h.
+        CullingPlanes GetCullingPlanes( void ) const;
+        uint32_t CullBoxes( const BoxArrays& Boxes, uint32_t Count, uint32_t* VisibleMask ) const;
+        uint32_t CullSpheres( const SphereArrays& Spheres, uint32_t Count, uint32_t* VisibleMask ) const;
+
         friend Frustum  operator* ( const OrthogonalTransform& xform, const Frustum& frustum );	// Fast
         friend Frustum  operator* ( const AffineTransform& xform, const Frustum& frustum );		// Slow
         friend Frustum  operator* ( const Matrix4& xform, const Frustum& frustum );				// Slowest (and most general)
@@ -63,6 +69,11 @@ namespace Math
         BoundingPlane m_FrustumPlanes[6];			// the bounding planes
     };
 
+    // The planes bounding the clip volume of a view-projection matrix (-w <= x, y <= w and 0 <= z <= w), so it
+    // works for perspective and orthographic projections, reversed Z, and spot light shadow matrices, which
+    // don't keep a Frustum.  An infinite far plane is left out.
+    CullingPlanes MakeCullingPlanes( const Matrix4& ViewProjMat );
+
     //=======================================================================================================
     // Inline implementations
     //
@@ -91,6 +102,48 @@ namespace Math
         return true;
     }
 
+    inline CullingPlanes Frustum::GetCullingPlanes( void ) const
+    {
+        CullingPlanes planes;
+        for (int i = 0; i < 6; ++i)
+        {
+            Vector4 p = m_FrustumPlanes[i];
+            planes.AddPlane(p.GetX(), p.GetY(), p.GetZ(), p.GetW());
+        }
+        return planes;
+    }
+
+    inline CullingPlanes MakeCullingPlanes( const Matrix4& ViewProjMat )
+    {
+        // Rows of the transpose are the x, y, z and w clip coordinates as functions of position
+        Matrix4 clip = Transpose(ViewProjMat);
+        Vector4 x = clip.GetX(), y = clip.GetY(), z = clip.GetZ(), w = clip.GetW();
+        Vector4 clipPlanes[6] = { w + x, w - x, w + y, w - y, z, w - z };
+
+        CullingPlanes planes;
+        for (int i = 0; i < 6; ++i)
+        {
+            float length = Length(Vector3(clipPlanes[i]));
+            if (length < 1e-6f)
+                continue;
+
+            Vector4 p = clipPlanes[i] / length;
+            planes.AddPlane(p.GetX(), p.GetY(), p.GetZ(), p.GetW());
+        }
+        return planes;
+    }
+
+    // Large batches are split across the worker threads
+    inline uint32_t Frustum::CullBoxes( const BoxArrays& Boxes, uint32_t Count, uint32_t* VisibleMask ) const
+    {
+        return ParallelCullBoxes(GetCullingPlanes(), Boxes, Count, VisibleMask);
+    }
+
+    inline uint32_t Frustum::CullSpheres( const SphereArrays& Spheres, uint32_t Count, uint32_t* VisibleMask ) const
+    {
+        return ParallelCullSpheres(GetCullingPlanes(), Spheres, Count, VisibleMask);
+    }
+
     inline Frustum operator* ( const OrthogonalTransform& xform, const Frustum& frustum )
     {
         Frustum result;
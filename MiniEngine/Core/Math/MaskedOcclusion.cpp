@@ -0,0 +1,702 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "MaskedOcclusion.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#else
+#define OCCLUSION_SSE 0
+#endif
+
+#if defined(_WIN32)
+#include <ppl.h>
+#else
+#include <thread>
+#endif
+
+using namespace std;
+using namespace Math;
+
+namespace
+{
+    // Triangles are clipped where w reaches this, rather than at the near plane, so that the projection's depth
+    // convention doesn't matter
+    const float kMinW = 1e-3f;
+
+    // And where x or y reach this many times w, well off the screen, so that no vertex projects far enough away
+    // for float precision to spoil the edge equations and depth plane
+    const float kGuardBand = 2.0f;
+
+    // Boxes are moved this much closer before testing, so that a surface is never hidden by its own occluder
+    // after rounding
+    const float kDepthBias = 1e-4f;
+
+    // Tile rows per band when rasterizing on the worker threads
+    const uint32_t kBandTileRows = 4;
+
+    // Box tests per worker thread task, in mask words
+    const uint32_t kTestChunkWords = 64;
+
+    // Four lanes, which are the four rows of a tile when rasterizing
+#if OCCLUSION_SSE
+    typedef __m128 Float4;
+
+    inline Float4 Splat( float v ) { return _mm_set1_ps(v); }
+    inline Float4 Make( float a, float b, float c, float d ) { return _mm_setr_ps(a, b, c, d); }
+    inline Float4 Add( Float4 a, Float4 b ) { return _mm_add_ps(a, b); }
+    inline Float4 Sub( Float4 a, Float4 b ) { return _mm_sub_ps(a, b); }
+    inline Float4 Mul( Float4 a, Float4 b ) { return _mm_mul_ps(a, b); }
+    inline Float4 Div( Float4 a, Float4 b ) { return _mm_div_ps(a, b); }
+    inline Float4 Min( Float4 a, Float4 b ) { return _mm_min_ps(a, b); }
+    inline Float4 Max( Float4 a, Float4 b ) { return _mm_max_ps(a, b); }
+    inline void Store( float* Dest, Float4 v ) { _mm_storeu_ps(Dest, v); }
+
+    // Where a < 0, b; elsewhere c
+    inline Float4 SelectNegative( Float4 a, Float4 b, Float4 c )
+    {
+        const __m128 Mask = _mm_cmplt_ps(a, _mm_setzero_ps());
+        return _mm_or_ps(_mm_and_ps(Mask, b), _mm_andnot_ps(Mask, c));
+    }
+
+    // SSE2 has no floor, so round to nearest and step down where that went up
+    inline void FloorToInt( int32_t* Dest, Float4 v )
+    {
+        const __m128i Rounded = _mm_cvtps_epi32(v);
+        const __m128i WentUp = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(Rounded), v));
+        _mm_storeu_si128((__m128i*)Dest, _mm_add_epi32(Rounded, WentUp));
+    }
+#else
+    struct Float4 { float v[4]; };
+
+    inline Float4 Splat( float v ) { Float4 r = { v, v, v, v }; return r; }
+    inline Float4 Make( float a, float b, float c, float d ) { Float4 r = { a, b, c, d }; return r; }
+
+#define OCCLUSION_LANEWISE(Name, Expr) \
+    inline Float4 Name( Float4 a, Float4 b ) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = Expr; return r; }
+    OCCLUSION_LANEWISE(Add, a.v[i] + b.v[i])
+    OCCLUSION_LANEWISE(Sub, a.v[i] - b.v[i])
+    OCCLUSION_LANEWISE(Mul, a.v[i] * b.v[i])
+    OCCLUSION_LANEWISE(Div, a.v[i] / b.v[i])
+    OCCLUSION_LANEWISE(Min, a.v[i] < b.v[i] ? a.v[i] : b.v[i])
+    OCCLUSION_LANEWISE(Max, a.v[i] > b.v[i] ? a.v[i] : b.v[i])
+#undef OCCLUSION_LANEWISE
+
+    inline void Store( float* Dest, Float4 v ) { for (int i = 0; i < 4; ++i) Dest[i] = v.v[i]; }
+
+    inline Float4 SelectNegative( Float4 a, Float4 b, Float4 c )
+    {
+        Float4 r;
+        for (int i = 0; i < 4; ++i)
+            r.v[i] = a.v[i] < 0.0f ? b.v[i] : c.v[i];
+        return r;
+    }
+
+    inline void FloorToInt( int32_t* Dest, Float4 v )
+    {
+        for (int i = 0; i < 4; ++i)
+            Dest[i] = (int32_t)floorf(v.v[i]);
+    }
+#endif
+
+    // Bits First through Last of a tile row, both in [0, 31]
+    inline uint32_t SpanMask( int32_t First, int32_t Last )
+    {
+        return First > Last ? 0 : (~0u << First) & (~0u >> (31 - Last));
+    }
+
+    template <typename Func>
+    void ParallelFor( uint32_t Count, Func Body )
+    {
+        if (Count <= 1)
+        {
+            if (Count == 1)
+                Body(0);
+            return;
+        }
+
+#if defined(_WIN32)
+        concurrency::parallel_for(0u, Count, Body);
+#else
+        atomic<uint32_t> Next(0);
+        auto Worker = [&]( void )
+        {
+            for (uint32_t i = Next++; i < Count; i = Next++)
+                Body(i);
+        };
+
+        const uint32_t NumThreads = min(max(thread::hardware_concurrency(), 1u), Count);
+        vector<thread> Threads;
+        for (uint32_t i = 1; i < NumThreads; ++i)
+            Threads.emplace_back(Worker);
+        Worker();
+        for (auto& Thread : Threads)
+            Thread.join();
+#endif
+    }
+
+    struct ClipVertex
+    {
+        float X, Y, W;
+    };
+
+    // The planes triangles are clipped to:  w >= kMinW, then the guard band on each side
+    const uint32_t kNumClipPlanes = 5;
+    const uint32_t kMaxClipVertices = 3 + kNumClipPlanes;
+
+    // Positive inside the plane
+    inline float PlaneDistance( const ClipVertex& V, uint32_t Plane )
+    {
+        switch (Plane)
+        {
+        case 0: return V.W - kMinW;
+        case 1: return kGuardBand * V.W + V.X;
+        case 2: return kGuardBand * V.W - V.X;
+        case 3: return kGuardBand * V.W + V.Y;
+        default: return kGuardBand * V.W - V.Y;
+        }
+    }
+
+    // One bit for each plane the vertex is outside of
+    inline uint32_t OutsideMask( const ClipVertex& V )
+    {
+        uint32_t Mask = 0;
+        for (uint32_t Plane = 0; Plane < kNumClipPlanes; ++Plane)
+            Mask |= (PlaneDistance(V, Plane) < 0.0f ? 1u : 0u) << Plane;
+        return Mask;
+    }
+
+    // Clips a triangle to the planes above.  Returns the number of vertices of the remaining convex polygon, which
+    // is 0 or from 3 to kMaxClipVertices.
+    uint32_t ClipTriangle( const ClipVertex* In, ClipVertex* Out )
+    {
+        ClipVertex Polygons[2][kMaxClipVertices];
+        memcpy(Polygons[0], In, 3 * sizeof(ClipVertex));
+        uint32_t Count = 3;
+
+        for (uint32_t Plane = 0; Plane < kNumClipPlanes; ++Plane)
+        {
+            const ClipVertex* Src = Polygons[Plane & 1];
+            ClipVertex* Dest = Polygons[(Plane + 1) & 1];
+            uint32_t NumOut = 0;
+
+            for (uint32_t i = 0; i < Count; ++i)
+            {
+                const ClipVertex& Cur = Src[i];
+                const ClipVertex& Next = Src[(i + 1) % Count];
+                const float CurDist = PlaneDistance(Cur, Plane);
+                const float NextDist = PlaneDistance(Next, Plane);
+
+                if (CurDist >= 0.0f)
+                    Dest[NumOut++] = Cur;
+
+                if ((CurDist >= 0.0f) != (NextDist >= 0.0f))
+                {
+                    const float t = CurDist / (CurDist - NextDist);
+                    ClipVertex& New = Dest[NumOut++];
+                    New.X = Cur.X + (Next.X - Cur.X) * t;
+                    New.Y = Cur.Y + (Next.Y - Cur.Y) * t;
+                    New.W = Plane == 0 ? kMinW : Cur.W + (Next.W - Cur.W) * t;
+                }
+            }
+
+            Count = NumOut;
+            if (Count < 3)
+                return 0;
+        }
+
+        memcpy(Out, Polygons[kNumClipPlanes & 1], Count * sizeof(ClipVertex));
+        return Count;
+    }
+
+    // Where positions land in screen space, in pixels with y down, with depth 1/w
+    struct ScreenVertex
+    {
+        float X, Y, Z;
+    };
+}
+
+MaskedOcclusionBuffer::MaskedOcclusionBuffer()
+    : m_Width(0), m_Height(0), m_TilesX(0), m_TilesY(0), m_NumTrianglesRasterized(0), m_NumTrianglesCulled(0)
+{
+    for (uint32_t i = 0; i < 16; ++i)
+        m_ViewProj[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+}
+
+void MaskedOcclusionBuffer::Create( uint32_t Width, uint32_t Height )
+{
+    ASSERT(Width > 0 && Width % kTileWidth == 0, "Occlusion buffer width must be a multiple of 32");
+    ASSERT(Height > 0 && Height % kTileHeight == 0, "Occlusion buffer height must be a multiple of 4");
+
+    m_Width = Width;
+    m_Height = Height;
+    m_TilesX = Width / kTileWidth;
+    m_TilesY = Height / kTileHeight;
+    m_Tiles.resize(m_TilesX * m_TilesY);
+    Clear();
+}
+
+void MaskedOcclusionBuffer::Destroy( void )
+{
+    m_Tiles.clear();
+    m_Tiles.shrink_to_fit();
+    m_TriangleLists.clear();
+    m_Width = m_Height = m_TilesX = m_TilesY = 0;
+}
+
+void MaskedOcclusionBuffer::SetViewProjMatrix( const float* ViewProjMat )
+{
+    memcpy(m_ViewProj, ViewProjMat, sizeof(m_ViewProj));
+}
+
+void MaskedOcclusionBuffer::Clear( void )
+{
+    for (Tile& T : m_Tiles)
+    {
+        T.ReferenceDepth = 0.0f;
+        T.WorkingDepth = 0.0f;
+        for (uint32_t Row = 0; Row < kTileHeight; ++Row)
+            T.Mask[Row] = 0;
+    }
+}
+
+void MaskedOcclusionBuffer::SetupTriangles( const OccluderMesh& Mesh, TriangleList& List ) const
+{
+    List.Triangles.clear();
+    List.MinY = INT32_MAX;
+    List.MaxY = INT32_MIN;
+    List.NumCulled = 0;
+
+    // Transform each vertex once, four at a time, into clip space x, y and w
+    thread_local vector<float> t_Clip;
+    const uint32_t PaddedCount = (Mesh.VertexCount + 3) & ~3u;
+    t_Clip.resize(PaddedCount * 3);
+    float* ClipX = t_Clip.data();
+    float* ClipY = ClipX + PaddedCount;
+    float* ClipW = ClipY + PaddedCount;
+
+    const float* M = m_ViewProj;
+    const uint8_t* Vertices = (const uint8_t*)Mesh.Positions;
+    for (uint32_t v = 0; v < Mesh.VertexCount; v += 4)
+    {
+        const float* P[4];
+        for (uint32_t i = 0; i < 4; ++i)
+            P[i] = (const float*)(Vertices + min(v + i, Mesh.VertexCount - 1) * Mesh.VertexStride);
+
+        const Float4 X = Make(P[0][0], P[1][0], P[2][0], P[3][0]);
+        const Float4 Y = Make(P[0][1], P[1][1], P[2][1], P[3][1]);
+        const Float4 Z = Make(P[0][2], P[1][2], P[2][2], P[3][2]);
+
+        Store(ClipX + v, Add(Add(Mul(X, Splat(M[0])), Mul(Y, Splat(M[4]))), Add(Mul(Z, Splat(M[8])), Splat(M[12]))));
+        Store(ClipY + v, Add(Add(Mul(X, Splat(M[1])), Mul(Y, Splat(M[5]))), Add(Mul(Z, Splat(M[9])), Splat(M[13]))));
+        Store(ClipW + v, Add(Add(Mul(X, Splat(M[3])), Mul(Y, Splat(M[7]))), Add(Mul(Z, Splat(M[11])), Splat(M[15]))));
+    }
+
+    const float HalfWidth = 0.5f * m_Width;
+    const float HalfHeight = 0.5f * m_Height;
+
+    auto AddTriangle = [&]( ScreenVertex V0, ScreenVertex V1, ScreenVertex V2 )
+    {
+        float Area = (V1.X - V0.X) * (V2.Y - V0.Y) - (V2.X - V0.X) * (V1.Y - V0.Y);
+        if (Area < 0.0f)
+        {
+            swap(V1, V2);
+            Area = -Area;
+        }
+
+        if (!(Area > 1e-8f))
+        {
+            ++List.NumCulled;
+            return;
+        }
+
+        // Only pixels whose centers are inside are covered
+        const float MinX = min(min(V0.X, V1.X), V2.X), MaxX = max(max(V0.X, V1.X), V2.X);
+        const float MinY = min(min(V0.Y, V1.Y), V2.Y), MaxY = max(max(V0.Y, V1.Y), V2.Y);
+
+        Triangle Tri;
+        Tri.MinX = max((int32_t)ceilf(max(MinX, -1.0f) - 0.5f), 0);
+        Tri.MaxX = min((int32_t)floorf(min(MaxX, m_Width + 1.0f) - 0.5f), (int32_t)m_Width - 1);
+        Tri.MinY = max((int32_t)ceilf(max(MinY, -1.0f) - 0.5f), 0);
+        Tri.MaxY = min((int32_t)floorf(min(MaxY, m_Height + 1.0f) - 0.5f), (int32_t)m_Height - 1);
+
+        if (Tri.MinX > Tri.MaxX || Tri.MinY > Tri.MaxY)
+        {
+            ++List.NumCulled;
+            return;
+        }
+
+        // Inside is where A * x + B * y + C >= 0 for all three edges
+        const ScreenVertex* V[3] = { &V0, &V1, &V2 };
+        for (uint32_t e = 0; e < 3; ++e)
+        {
+            const ScreenVertex& Va = *V[e];
+            const ScreenVertex& Vb = *V[(e + 1) % 3];
+            Tri.EdgeA[e] = Va.Y - Vb.Y;
+            Tri.EdgeB[e] = Vb.X - Va.X;
+            Tri.EdgeC[e] = -(Tri.EdgeA[e] * Va.X + Tri.EdgeB[e] * Va.Y);
+        }
+
+        // 1/w is linear in screen space
+        const float DX1 = V1.X - V0.X, DY1 = V1.Y - V0.Y, DZ1 = V1.Z - V0.Z;
+        const float DX2 = V2.X - V0.X, DY2 = V2.Y - V0.Y, DZ2 = V2.Z - V0.Z;
+        Tri.DepthX = (DZ1 * DY2 - DZ2 * DY1) / Area;
+        Tri.DepthY = (DZ2 * DX1 - DZ1 * DX2) / Area;
+        Tri.DepthC = V0.Z - Tri.DepthX * V0.X - Tri.DepthY * V0.Y;
+        Tri.MinDepth = min(min(V0.Z, V1.Z), V2.Z);
+
+        List.MinY = min(List.MinY, Tri.MinY);
+        List.MaxY = max(List.MaxY, Tri.MaxY);
+        List.Triangles.push_back(Tri);
+    };
+
+    auto Project = [&]( const ClipVertex& In ) -> ScreenVertex
+    {
+        const float InvW = 1.0f / In.W;
+        ScreenVertex Out;
+        Out.X = In.X * InvW * HalfWidth + HalfWidth;
+        Out.Y = HalfHeight - In.Y * InvW * HalfHeight;
+        Out.Z = InvW;
+        return Out;
+    };
+
+    for (uint32_t i = 0; i + 2 < Mesh.IndexCount; i += 3)
+    {
+        ClipVertex Tri[3];
+        bool Valid = true;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t Index = Mesh.Indices[i + k];
+            Valid = Valid && Index < Mesh.VertexCount;
+            Index = min(Index, PaddedCount - 1);
+            Tri[k].X = ClipX[Index];
+            Tri[k].Y = ClipY[Index];
+            Tri[k].W = ClipW[Index];
+        }
+
+        if (!Valid)
+        {
+            ++List.NumCulled;
+            continue;
+        }
+
+        const uint32_t Outside0 = OutsideMask(Tri[0]);
+        const uint32_t Outside1 = OutsideMask(Tri[1]);
+        const uint32_t Outside2 = OutsideMask(Tri[2]);
+
+        if ((Outside0 | Outside1 | Outside2) == 0)
+        {
+            // Entirely off one side of the screen
+            if ((Tri[0].X > Tri[0].W && Tri[1].X > Tri[1].W && Tri[2].X > Tri[2].W) ||
+                (Tri[0].X < -Tri[0].W && Tri[1].X < -Tri[1].W && Tri[2].X < -Tri[2].W) ||
+                (Tri[0].Y > Tri[0].W && Tri[1].Y > Tri[1].W && Tri[2].Y > Tri[2].W) ||
+                (Tri[0].Y < -Tri[0].W && Tri[1].Y < -Tri[1].W && Tri[2].Y < -Tri[2].W))
+            {
+                ++List.NumCulled;
+                continue;
+            }
+
+            AddTriangle(Project(Tri[0]), Project(Tri[1]), Project(Tri[2]));
+            continue;
+        }
+
+        ClipVertex Clipped[kMaxClipVertices];
+        const uint32_t NumClipped = (Outside0 & Outside1 & Outside2) != 0 ? 0 : ClipTriangle(Tri, Clipped);
+        if (NumClipped < 3)
+        {
+            ++List.NumCulled;
+            continue;
+        }
+
+        const ScreenVertex S0 = Project(Clipped[0]);
+        for (uint32_t k = 2; k < NumClipped; ++k)
+            AddTriangle(S0, Project(Clipped[k - 1]), Project(Clipped[k]));
+    }
+}
+
+void MaskedOcclusionBuffer::RasterizeTriangle( const Triangle& Tri, uint32_t FirstTileRow, uint32_t EndTileRow )
+{
+    const uint32_t TileY0 = max((uint32_t)Tri.MinY / kTileHeight, FirstTileRow);
+    const uint32_t TileY1 = min((uint32_t)Tri.MaxY / kTileHeight + 1, EndTileRow);
+    const uint32_t TileX0 = (uint32_t)Tri.MinX / kTileWidth;
+    const uint32_t TileX1 = (uint32_t)Tri.MaxX / kTileWidth;
+
+    for (uint32_t TileY = TileY0; TileY < TileY1; ++TileY)
+    {
+        // The span of each of the tile's four rows, between the left and right edges.  Pixel i is covered when
+        // i + 0.5 is within it.
+        const float RowY = (float)(TileY * kTileHeight) + 0.5f;
+        const Float4 Y = Make(RowY, RowY + 1.0f, RowY + 2.0f, RowY + 3.0f);
+        Float4 Left = Splat(Tri.MinX + 0.5f);
+        Float4 Right = Splat(Tri.MaxX + 0.5f);
+
+        for (uint32_t e = 0; e < 3; ++e)
+        {
+            const Float4 Dist = Add(Mul(Splat(Tri.EdgeB[e]), Y), Splat(Tri.EdgeC[e]));
+            if (Tri.EdgeA[e] > 0.0f)
+                Left = Max(Left, Div(Sub(Splat(0.0f), Dist), Splat(Tri.EdgeA[e])));
+            else if (Tri.EdgeA[e] < 0.0f)
+                Right = Min(Right, Div(Sub(Splat(0.0f), Dist), Splat(Tri.EdgeA[e])));
+            else
+                Right = SelectNegative(Dist, Splat(-2.0f), Right);
+        }
+
+        // Clamped so that the conversions can't overflow
+        Left = Min(Left, Splat(m_Width + 1.0f));
+        Right = Max(Right, Splat(-2.0f));
+
+        // The first covered pixel is ceil(Left - 0.5), which is -floor(0.5 - Left)
+        int32_t First[kTileHeight], Last[kTileHeight];
+        FloorToInt(First, Sub(Splat(0.5f), Left));
+        FloorToInt(Last, Sub(Right, Splat(0.5f)));
+        for (uint32_t Row = 0; Row < kTileHeight; ++Row)
+            First[Row] = -First[Row];
+
+        const int32_t RowMinY = max((int32_t)(TileY * kTileHeight), Tri.MinY);
+        const int32_t RowMaxY = min((int32_t)(TileY * kTileHeight + kTileHeight - 1), Tri.MaxY);
+
+        for (uint32_t TileX = TileX0; TileX <= TileX1; ++TileX)
+        {
+            const int32_t BaseX = (int32_t)(TileX * kTileWidth);
+
+            uint32_t Coverage[kTileHeight];
+            uint32_t AnyCoverage = 0;
+            for (uint32_t Row = 0; Row < kTileHeight; ++Row)
+            {
+                Coverage[Row] = SpanMask(max(First[Row] - BaseX, 0), min(Last[Row] - BaseX, 31));
+                AnyCoverage |= Coverage[Row];
+            }
+
+            if (AnyCoverage == 0)
+                continue;
+
+            // The farthest the triangle can be over the covered part of the tile.  The depth plane is at its
+            // minimum in one corner, and the triangle is never farther than its farthest vertex.
+            const float X0 = max(BaseX, Tri.MinX) + 0.5f;
+            const float X1 = min(BaseX + (int32_t)kTileWidth - 1, Tri.MaxX) + 0.5f;
+            const float Y0 = RowMinY + 0.5f;
+            const float Y1 = RowMaxY + 0.5f;
+            float Depth = Tri.DepthC + Tri.DepthX * (Tri.DepthX < 0.0f ? X1 : X0) + Tri.DepthY * (Tri.DepthY < 0.0f ? Y1 : Y0);
+            Depth = max(Depth, Tri.MinDepth);
+
+            Tile& T = m_Tiles[TileY * m_TilesX + TileX];
+
+            // Nothing to gain where the triangle may be behind the reference layer
+            if (Depth <= T.ReferenceDepth)
+                continue;
+
+            bool WorkingEmpty = (T.Mask[0] | T.Mask[1] | T.Mask[2] | T.Mask[3]) == 0;
+
+            // A triangle much closer than the working layer starts a new one, which is likely to cover the tile
+            // sooner and closer
+            if (!WorkingEmpty && Depth - T.WorkingDepth > T.WorkingDepth - T.ReferenceDepth)
+                WorkingEmpty = true;
+
+            T.WorkingDepth = WorkingEmpty ? Depth : min(T.WorkingDepth, Depth);
+
+            uint32_t Full = ~0u;
+            for (uint32_t Row = 0; Row < kTileHeight; ++Row)
+            {
+                T.Mask[Row] = (WorkingEmpty ? 0 : T.Mask[Row]) | Coverage[Row];
+                Full &= T.Mask[Row];
+            }
+
+            if (Full == ~0u)
+            {
+                T.ReferenceDepth = T.WorkingDepth;
+                for (uint32_t Row = 0; Row < kTileHeight; ++Row)
+                    T.Mask[Row] = 0;
+            }
+        }
+    }
+}
+
+void MaskedOcclusionBuffer::RenderOccluders( const OccluderMesh* Meshes, uint32_t NumMeshes )
+{
+    if (m_TriangleLists.size() < NumMeshes)
+        m_TriangleLists.resize(NumMeshes);
+
+    ParallelFor(NumMeshes, [&]( uint32_t i )
+    {
+        SetupTriangles(Meshes[i], m_TriangleLists[i]);
+    });
+
+    // Each band rasterizes every triangle that reaches it, in order, so the result doesn't depend on timing
+    const uint32_t NumBands = (m_TilesY + kBandTileRows - 1) / kBandTileRows;
+    ParallelFor(NumBands, [&]( uint32_t Band )
+    {
+        const uint32_t FirstTileRow = Band * kBandTileRows;
+        const uint32_t EndTileRow = min(FirstTileRow + kBandTileRows, m_TilesY);
+        const int32_t MinY = (int32_t)(FirstTileRow * kTileHeight);
+        const int32_t MaxY = (int32_t)(EndTileRow * kTileHeight) - 1;
+
+        for (uint32_t i = 0; i < NumMeshes; ++i)
+        {
+            const TriangleList& List = m_TriangleLists[i];
+            if (List.MaxY < MinY || List.MinY > MaxY)
+                continue;
+
+            for (const Triangle& Tri : List.Triangles)
+            {
+                if (Tri.MaxY >= MinY && Tri.MinY <= MaxY)
+                    RasterizeTriangle(Tri, FirstTileRow, EndTileRow);
+            }
+        }
+    });
+
+    m_NumTrianglesRasterized = 0;
+    m_NumTrianglesCulled = 0;
+    for (uint32_t i = 0; i < NumMeshes; ++i)
+    {
+        m_NumTrianglesRasterized += (uint32_t)m_TriangleLists[i].Triangles.size();
+        m_NumTrianglesCulled += m_TriangleLists[i].NumCulled;
+    }
+}
+
+bool MaskedOcclusionBuffer::TestRect( int32_t MinX, int32_t MaxX, int32_t MinY, int32_t MaxY, float Depth ) const
+{
+    for (int32_t TileY = MinY / (int32_t)kTileHeight; TileY <= MaxY / (int32_t)kTileHeight; ++TileY)
+    {
+        const int32_t BaseY = TileY * (int32_t)kTileHeight;
+        const int32_t FirstRow = max(MinY - BaseY, 0);
+        const int32_t LastRow = min(MaxY - BaseY, (int32_t)kTileHeight - 1);
+
+        for (int32_t TileX = MinX / (int32_t)kTileWidth; TileX <= MaxX / (int32_t)kTileWidth; ++TileX)
+        {
+            const Tile& T = m_Tiles[TileY * m_TilesX + TileX];
+            if (Depth < T.ReferenceDepth)
+                continue;
+
+            // Pixels in the working layer are at least as close as its depth
+            const int32_t BaseX = TileX * (int32_t)kTileWidth;
+            const uint32_t RowMask = SpanMask(max(MinX - BaseX, 0), min(MaxX - BaseX, 31));
+            uint32_t Uncovered = 0;
+            for (int32_t Row = FirstRow; Row <= LastRow; ++Row)
+                Uncovered |= RowMask & ~T.Mask[Row];
+
+            if (Uncovered != 0 || Depth >= T.WorkingDepth)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+bool MaskedOcclusionBuffer::IsBoxVisible( const float* MinBound, const float* MaxBound ) const
+{
+    // The eight corners, four at a time
+    const float* M = m_ViewProj;
+    const Float4 X = Make(MinBound[0], MaxBound[0], MinBound[0], MaxBound[0]);
+    const Float4 Y = Make(MinBound[1], MinBound[1], MaxBound[1], MaxBound[1]);
+    const Float4 PartX = Add(Mul(X, Splat(M[0])), Add(Mul(Y, Splat(M[4])), Splat(M[12])));
+    const Float4 PartY = Add(Mul(X, Splat(M[1])), Add(Mul(Y, Splat(M[5])), Splat(M[13])));
+    const Float4 PartW = Add(Mul(X, Splat(M[3])), Add(Mul(Y, Splat(M[7])), Splat(M[15])));
+
+    float ClipX[8], ClipY[8], ClipW[8];
+    for (uint32_t Half = 0; Half < 2; ++Half)
+    {
+        const Float4 Z = Splat(Half == 0 ? MinBound[2] : MaxBound[2]);
+        Store(ClipX + Half * 4, Add(PartX, Mul(Z, Splat(M[8]))));
+        Store(ClipY + Half * 4, Add(PartY, Mul(Z, Splat(M[9]))));
+        Store(ClipW + Half * 4, Add(PartW, Mul(Z, Splat(M[11]))));
+    }
+
+    const float HalfWidth = 0.5f * m_Width;
+    const float HalfHeight = 0.5f * m_Height;
+    float MinX = FLT_MAX, MaxX = -FLT_MAX, MinY = FLT_MAX, MaxY = -FLT_MAX, Nearest = 0.0f;
+
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        // Reaches behind the viewer, so it surrounds the view
+        if (!(ClipW[i] >= kMinW))
+            return true;
+
+        const float InvW = 1.0f / ClipW[i];
+        const float X = ClipX[i] * InvW * HalfWidth + HalfWidth;
+        const float Y = HalfHeight - ClipY[i] * InvW * HalfHeight;
+        MinX = min(MinX, X);
+        MaxX = max(MaxX, X);
+        MinY = min(MinY, Y);
+        MaxY = max(MaxY, Y);
+        Nearest = max(Nearest, InvW);
+    }
+
+    // Every pixel the box touches.  Boxes off the screen are left to frustum culling.
+    if (MaxX < 0.0f || MaxY < 0.0f || MinX >= (float)m_Width || MinY >= (float)m_Height)
+        return true;
+
+    const int32_t PixelMinX = (int32_t)max(MinX, 0.0f);
+    const int32_t PixelMaxX = (int32_t)min(MaxX, m_Width - 1.0f);
+    const int32_t PixelMinY = (int32_t)max(MinY, 0.0f);
+    const int32_t PixelMaxY = (int32_t)min(MaxY, m_Height - 1.0f);
+
+    return TestRect(PixelMinX, PixelMaxX, PixelMinY, PixelMaxY, Nearest * (1.0f + kDepthBias));
+}
+
+uint32_t MaskedOcclusionBuffer::TestBoxes( const BoxArrays& Boxes, uint32_t Count, uint32_t* VisibleMask ) const
+{
+    const uint32_t NumWords = GetCullMaskSize(Count);
+    const uint32_t NumChunks = (NumWords + kTestChunkWords - 1) / kTestChunkWords;
+    atomic<uint32_t> NumVisible(0);
+
+    ParallelFor(NumChunks, [&]( uint32_t Chunk )
+    {
+        const uint32_t FirstWord = Chunk * kTestChunkWords;
+        const uint32_t EndWord = min(FirstWord + kTestChunkWords, NumWords);
+        uint32_t ChunkVisible = 0;
+
+        for (uint32_t Word = FirstWord; Word < EndWord; ++Word)
+        {
+            uint32_t Visible = VisibleMask[Word];
+            for (uint32_t Bits = Visible; Bits != 0; Bits &= Bits - 1)
+            {
+                uint32_t Bit = 0;
+                while ((Bits & (1u << Bit)) == 0)
+                    ++Bit;
+
+                const uint32_t i = Word * 32 + Bit;
+                const float MinBound[3] = { Boxes.MinX[i], Boxes.MinY[i], Boxes.MinZ[i] };
+                const float MaxBound[3] = { Boxes.MaxX[i], Boxes.MaxY[i], Boxes.MaxZ[i] };
+                if (!IsBoxVisible(MinBound, MaxBound))
+                    Visible &= ~(1u << Bit);
+            }
+
+            VisibleMask[Word] = Visible;
+            for (uint32_t Bits = Visible; Bits != 0; Bits &= Bits - 1)
+                ++ChunkVisible;
+        }
+
+        NumVisible += ChunkVisible;
+    });
+
+    return NumVisible;
+}
+
+void MaskedOcclusionBuffer::ReadDepth( float* Dest ) const
+{
+    for (uint32_t y = 0; y < m_Height; ++y)
+    {
+        for (uint32_t x = 0; x < m_Width; ++x)
+        {
+            const Tile& T = m_Tiles[(y / kTileHeight) * m_TilesX + x / kTileWidth];
+            const bool InWorkingLayer = (T.Mask[y % kTileHeight] & (1u << (x % kTileWidth))) != 0;
+            Dest[y * m_Width + x] = InWorkingLayer ? T.WorkingDepth : T.ReferenceDepth;
+        }
+    }
+}
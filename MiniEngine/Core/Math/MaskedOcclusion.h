@@ -0,0 +1,120 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A low resolution software depth buffer for occlusion culling on the CPU, after "Masked Software
+// Occlusion Culling" (Hasselgren, Andersson and Akenine-Moller).  Occluder triangles are rasterized into tiles
+// of 32x4 pixels, each holding a coverage mask of one bit per pixel and two depths:  a reference depth for the
+// whole tile and a working depth for the covered pixels.  When the mask fills up, the working layer becomes the
+// reference.  This keeps a conservative depth for every pixel in 24 bytes per tile, without sorting occluders.
+//
+// Depths are 1/w, so larger is closer, and every value stored is at least as far as the occluders really are.
+// A box is only reported occluded when it is behind them everywhere it covers, so culling never removes
+// anything visible, but small gaps between occluders are lost.
+//
+// Occluders are set up and rasterized on the worker threads, in bands of tile rows so that no two threads
+// write the same tile.  Like BatchCulling, this file has no dependencies on the rest of the engine.
+//
+
+#pragma once
+
+#include "BatchCulling.h"
+#include <vector>
+
+namespace Math
+{
+    // An indexed triangle list.  Positions are three floats at the start of each vertex, as in the depth-only
+    // vertex streams of H3D models.
+    struct OccluderMesh
+    {
+        const float* Positions;
+        uint32_t VertexStride;      // In bytes
+        uint32_t VertexCount;
+        const uint16_t* Indices;
+        uint32_t IndexCount;
+    };
+
+    class MaskedOcclusionBuffer
+    {
+    public:
+        static const uint32_t kTileWidth = 32;
+        static const uint32_t kTileHeight = 4;
+
+        MaskedOcclusionBuffer();
+
+        // The width must be a multiple of kTileWidth and the height of kTileHeight
+        void Create( uint32_t Width, uint32_t Height );
+        void Destroy( void );
+
+        uint32_t GetWidth( void ) const { return m_Width; }
+        uint32_t GetHeight( void ) const { return m_Height; }
+
+        // Takes world space to clip space.  The sixteen floats are laid out as Math::Matrix4 is in memory, so that
+        // a position transforms as x * row 0 + y * row 1 + z * row 2 + row 3.  Only x, y and w are used, so the
+        // depth convention doesn't matter.
+        void SetViewProjMatrix( const float* ViewProjMat );
+
+        void Clear( void );
+
+        // Adds occluders to the buffer.  They should be opaque, and large enough on screen to hide something.
+        void RenderOccluders( const OccluderMesh* Meshes, uint32_t NumMeshes );
+
+        // Tests the boxes whose bits are set in VisibleMask and clears the bits of those that are occluded.  The
+        // mask is laid out as for CullBoxes(), which normally fills it in first.  Returns the number left visible.
+        uint32_t TestBoxes( const BoxArrays& Boxes, uint32_t Count, uint32_t* VisibleMask ) const;
+
+        bool IsBoxVisible( const float* MinBound, const float* MaxBound ) const;
+
+        // The conservative depth (1/w) of every pixel, row by row, for debugging
+        void ReadDepth( float* Dest ) const;
+
+        // Counts from the last RenderOccluders() call
+        uint32_t GetNumTrianglesRasterized( void ) const { return m_NumTrianglesRasterized; }
+        uint32_t GetNumTrianglesCulled( void ) const { return m_NumTrianglesCulled; }
+
+    private:
+        struct Tile
+        {
+            float ReferenceDepth;
+            float WorkingDepth;
+            uint32_t Mask[kTileHeight];   // One row of the tile in each word, bit 0 leftmost
+        };
+
+        // Edge functions, depth plane and bounds of a triangle in screen space
+        struct Triangle
+        {
+            float EdgeA[3], EdgeB[3], EdgeC[3];
+            float DepthX, DepthY, DepthC;
+            float MinDepth;
+            int32_t MinX, MaxX, MinY, MaxY;
+        };
+
+        struct TriangleList
+        {
+            std::vector<Triangle> Triangles;
+            int32_t MinY, MaxY;
+            uint32_t NumCulled;
+        };
+
+        void SetupTriangles( const OccluderMesh& Mesh, TriangleList& List ) const;
+        void RasterizeTriangle( const Triangle& Tri, uint32_t FirstTileRow, uint32_t EndTileRow );
+        bool TestRect( int32_t MinX, int32_t MaxX, int32_t MinY, int32_t MaxY, float Depth ) const;
+
+        uint32_t m_Width;
+        uint32_t m_Height;
+        uint32_t m_TilesX;
+        uint32_t m_TilesY;
+        std::vector<Tile> m_Tiles;
+        float m_ViewProj[16];
+
+        std::vector<TriangleList> m_TriangleLists;
+        uint32_t m_NumTrianglesRasterized;
+        uint32_t m_NumTrianglesCulled;
+    };
+}
@@ -0,0 +1,545 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "SceneGraph.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SCENE_GRAPH_SSE 1
+#include <emmintrin.h>
+#else
+#define SCENE_GRAPH_SSE 0
+#endif
+
+#if defined(_WIN32)
+#include <ppl.h>
+#else
+#include <thread>
+#endif
+
+using namespace std;
+using namespace Math;
+
+namespace
+{
+    // One row of a transform
+#if SCENE_GRAPH_SSE
+    typedef __m128 Float4;
+
+    inline Float4 Load( const float* Src ) { return _mm_loadu_ps(Src); }
+    inline Float4 Splat( float v ) { return _mm_set1_ps(v); }
+    inline Float4 Add( Float4 a, Float4 b ) { return _mm_add_ps(a, b); }
+    inline Float4 Sub( Float4 a, Float4 b ) { return _mm_sub_ps(a, b); }
+    inline Float4 Mul( Float4 a, Float4 b ) { return _mm_mul_ps(a, b); }
+    inline Float4 Abs( Float4 a ) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    inline void Store( float* Dest, Float4 v ) { _mm_storeu_ps(Dest, v); }
+#else
+    struct Float4 { float v[4]; };
+
+    inline Float4 Load( const float* Src ) { Float4 r; memcpy(r.v, Src, sizeof(r.v)); return r; }
+    inline Float4 Splat( float v ) { Float4 r = { v, v, v, v }; return r; }
+
+#define FLOAT4_BINARY_OP( Name, Expr ) \
+    inline Float4 Name( Float4 a, Float4 b ) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = Expr; return r; }
+
+    FLOAT4_BINARY_OP( Add, a.v[i] + b.v[i] )
+    FLOAT4_BINARY_OP( Sub, a.v[i] - b.v[i] )
+    FLOAT4_BINARY_OP( Mul, a.v[i] * b.v[i] )
+
+#undef FLOAT4_BINARY_OP
+
+    inline Float4 Abs( Float4 a ) { for (int i = 0; i < 4; ++i) a.v[i] = fabsf(a.v[i]); return a; }
+    inline void Store( float* Dest, Float4 v ) { memcpy(Dest, v.v, sizeof(v.v)); }
+#endif
+
+    // World = Local * ParentWorld as XMMatrixMultiply() orders them, with both affine.  Each row of the result
+    // is the parent's rows weighted by a row of the local transform.
+    inline void MultiplyAffine( const float* Local, const float* Parent, float* World )
+    {
+        const Float4 P0 = Load(Parent);
+        const Float4 P1 = Load(Parent + 4);
+        const Float4 P2 = Load(Parent + 8);
+        const Float4 P3 = Load(Parent + 12);
+
+        for (int Row = 0; Row < 4; ++Row)
+        {
+            const float* L = Local + Row * 4;
+            Float4 R = Add(Add(Mul(Splat(L[0]), P0), Mul(Splat(L[1]), P1)), Mul(Splat(L[2]), P2));
+            if (Row == 3)
+                R = Add(R, P3);
+            Store(World + Row * 4, R);
+        }
+    }
+
+    // Runs Body(i) for i in [0, Count) on the worker threads
+    template <typename Func>
+    void ParallelFor( uint32_t Count, Func Body )
+    {
+        if (Count <= 1)
+        {
+            if (Count == 1)
+                Body(0);
+            return;
+        }
+
+#if defined(_WIN32)
+        concurrency::parallel_for(0u, Count, Body);
+#else
+        atomic<uint32_t> Next(0);
+        auto Worker = [&]( void )
+        {
+            for (uint32_t i = Next++; i < Count; i = Next++)
+                Body(i);
+        };
+
+        const uint32_t NumThreads = min(max(thread::hardware_concurrency(), 1u), Count);
+        vector<thread> Threads;
+        for (uint32_t i = 1; i < NumThreads; ++i)
+            Threads.emplace_back(Worker);
+        Worker();
+        for (auto& Thread : Threads)
+            Thread.join();
+#endif
+    }
+
+    // Moves each element from its index in From to its index in To
+    template <typename T>
+    void Permute( vector<T>& Array, const vector<uint32_t>& From, const vector<uint32_t>& To )
+    {
+        vector<T> Sorted(Array.size());
+        for (size_t i = 0; i < From.size(); ++i)
+            Sorted[To[i]] = Array[From[i]];
+        Array.swap(Sorted);
+    }
+
+    // Sorts the ranges and joins those that overlap or touch
+    template <typename RangeType>
+    void MergeRanges( vector<RangeType>& Ranges )
+    {
+        if (Ranges.empty())
+            return;
+
+        sort(Ranges.begin(), Ranges.end(), []( const RangeType& a, const RangeType& b ) { return a.First < b.First; });
+
+        size_t Last = 0;
+        for (size_t i = 1; i < Ranges.size(); ++i)
+        {
+            if (Ranges[i].First <= Ranges[Last].End)
+                Ranges[Last].End = max(Ranges[Last].End, Ranges[i].End);
+            else
+                Ranges[++Last] = Ranges[i];
+        }
+        Ranges.resize(Last + 1);
+    }
+
+    const float kIdentity[16] =
+    {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f
+    };
+}
+
+const SceneGraph::NodeId SceneGraph::kNoParent;
+
+SceneGraph::SceneGraph() : m_LevelStart(1, 0), m_NeedsSort(false), m_NumNodesUpdated(0)
+{
+}
+
+void SceneGraph::MarkDirty( NodeId Node )
+{
+    if (!m_IsDirty[Node])
+    {
+        m_IsDirty[Node] = 1;
+        m_DirtyNodes.push_back(Node);
+    }
+}
+
+SceneGraph::NodeId SceneGraph::AddNode( NodeId Parent )
+{
+    ASSERT(Parent == kNoParent || Parent < GetNumNodes(), "Invalid parent node");
+
+    // The node goes at the end of the arrays until the next Update() sorts it into place
+    const NodeId Node = GetNumNodes();
+    const uint32_t Index = (uint32_t)m_NodeAt.size();
+
+    m_ParentOfNode.push_back(Parent);
+    m_IndexOfNode.push_back(Index);
+    m_IsDirty.push_back(0);
+
+    m_NodeAt.push_back(Node);
+    m_Parent.push_back(kNoParent);
+    m_FirstChild.push_back(0);
+    m_NumChildren.push_back(0);
+    m_HasBounds.push_back(0);
+
+    Transform Identity;
+    memcpy(Identity.m, kIdentity, sizeof(Identity.m));
+    m_Local.push_back(Identity);
+    m_World.push_back(Identity);
+
+    LocalBox Empty = {};
+    m_LocalBounds.push_back(Empty);
+    for (int i = 0; i < 6; ++i)
+    {
+        m_WorldBounds[i].push_back(i < 3 ? FLT_MAX : -FLT_MAX);
+        m_SubtreeBounds[i].push_back(i < 3 ? FLT_MAX : -FLT_MAX);
+    }
+
+    MarkDirty(Node);
+    m_NeedsSort = true;
+    return Node;
+}
+
+void SceneGraph::SetParent( NodeId Node, NodeId Parent )
+{
+    ASSERT(Node < GetNumNodes(), "Invalid node");
+    ASSERT(Parent == kNoParent || Parent < GetNumNodes(), "Invalid parent node");
+
+    for (NodeId Ancestor = Parent; Ancestor != kNoParent; Ancestor = m_ParentOfNode[Ancestor])
+        ASSERT(Ancestor != Node, "A node can't be parented to its own subtree");
+
+    if (m_ParentOfNode[Node] == Parent)
+        return;
+
+    m_ParentOfNode[Node] = Parent;
+    MarkDirty(Node);
+    m_NeedsSort = true;
+}
+
+void SceneGraph::SetLocalTransform( NodeId Node, const float* Matrix )
+{
+    float* Local = m_Local[m_IndexOfNode[Node]].m;
+    memcpy(Local, Matrix, sizeof(Transform));
+    Local[3] = Local[7] = Local[11] = 0.0f;
+    Local[15] = 1.0f;
+
+    MarkDirty(Node);
+}
+
+void SceneGraph::SetLocalBounds( NodeId Node, const float* MinBound, const float* MaxBound )
+{
+    const uint32_t Index = m_IndexOfNode[Node];
+    LocalBox& Box = m_LocalBounds[Index];
+    for (int i = 0; i < 3; ++i)
+    {
+        ASSERT(MinBound[i] <= MaxBound[i], "Inverted bounds");
+        Box.Center[i] = (MinBound[i] + MaxBound[i]) * 0.5f;
+        Box.Extent[i] = (MaxBound[i] - MinBound[i]) * 0.5f;
+    }
+    Box.Center[3] = Box.Extent[3] = 0.0f;
+
+    m_HasBounds[Index] = 1;
+    MarkDirty(Node);
+}
+
+void SceneGraph::ClearLocalBounds( NodeId Node )
+{
+    const uint32_t Index = m_IndexOfNode[Node];
+    m_HasBounds[Index] = 0;
+    MarkDirty(Node);
+}
+
+bool SceneGraph::GetWorldBounds( NodeId Node, float* MinBound, float* MaxBound ) const
+{
+    const uint32_t Index = m_IndexOfNode[Node];
+    for (int i = 0; i < 3; ++i)
+    {
+        MinBound[i] = m_WorldBounds[i][Index];
+        MaxBound[i] = m_WorldBounds[i + 3][Index];
+    }
+    return MinBound[0] <= MaxBound[0];
+}
+
+bool SceneGraph::GetSubtreeBounds( NodeId Node, float* MinBound, float* MaxBound ) const
+{
+    const uint32_t Index = m_IndexOfNode[Node];
+    for (int i = 0; i < 3; ++i)
+    {
+        MinBound[i] = m_SubtreeBounds[i][Index];
+        MaxBound[i] = m_SubtreeBounds[i + 3][Index];
+    }
+    return MinBound[0] <= MaxBound[0];
+}
+
+BoxArrays SceneGraph::GetWorldBoxes( void ) const
+{
+    BoxArrays Boxes = { m_WorldBounds[0].data(), m_WorldBounds[1].data(), m_WorldBounds[2].data(),
+        m_WorldBounds[3].data(), m_WorldBounds[4].data(), m_WorldBounds[5].data() };
+    return Boxes;
+}
+
+BoxArrays SceneGraph::GetSubtreeBoxes( void ) const
+{
+    BoxArrays Boxes = { m_SubtreeBounds[0].data(), m_SubtreeBounds[1].data(), m_SubtreeBounds[2].data(),
+        m_SubtreeBounds[3].data(), m_SubtreeBounds[4].data(), m_SubtreeBounds[5].data() };
+    return Boxes;
+}
+
+// Puts the nodes in breadth-first order, roots first, with the children of each node in the order they were
+// added.  Everything stored per node moves with it, so clean nodes keep their world transforms.
+void SceneGraph::SortNodes( void )
+{
+    const uint32_t NumNodes = GetNumNodes();
+
+    // Children of each node, as ranges of one array
+    vector<uint32_t> ChildStart(NumNodes + 1, 0);
+    for (NodeId Node = 0; Node < NumNodes; ++Node)
+    {
+        if (m_ParentOfNode[Node] != kNoParent)
+            ++ChildStart[m_ParentOfNode[Node] + 1];
+    }
+    for (uint32_t i = 0; i < NumNodes; ++i)
+        ChildStart[i + 1] += ChildStart[i];
+
+    vector<NodeId> Children(ChildStart[NumNodes]);
+    vector<uint32_t> Cursor(ChildStart.begin(), ChildStart.end() - 1);
+    for (NodeId Node = 0; Node < NumNodes; ++Node)
+    {
+        if (m_ParentOfNode[Node] != kNoParent)
+            Children[Cursor[m_ParentOfNode[Node]]++] = Node;
+    }
+
+    vector<NodeId> Order;
+    Order.reserve(NumNodes);
+    for (NodeId Node = 0; Node < NumNodes; ++Node)
+    {
+        if (m_ParentOfNode[Node] == kNoParent)
+            Order.push_back(Node);
+    }
+
+    vector<uint32_t> NewIndexOfNode(NumNodes);
+    m_FirstChild.assign(NumNodes, 0);
+    m_NumChildren.assign(NumNodes, 0);
+    m_LevelStart.assign(1, 0);
+
+    // Each pass over one depth appends the next
+    for (uint32_t LevelBegin = 0; LevelBegin < Order.size(); )
+    {
+        const uint32_t LevelEnd = (uint32_t)Order.size();
+        m_LevelStart.push_back(LevelEnd);
+
+        for (uint32_t i = LevelBegin; i < LevelEnd; ++i)
+        {
+            const NodeId Node = Order[i];
+            NewIndexOfNode[Node] = i;
+            m_FirstChild[i] = (uint32_t)Order.size();
+            m_NumChildren[i] = ChildStart[Node + 1] - ChildStart[Node];
+            Order.insert(Order.end(), Children.begin() + ChildStart[Node], Children.begin() + ChildStart[Node + 1]);
+        }
+
+        LevelBegin = LevelEnd;
+    }
+
+    ASSERT(Order.size() == NumNodes, "The hierarchy has a cycle");
+
+    Permute(m_HasBounds, m_IndexOfNode, NewIndexOfNode);
+    Permute(m_Local, m_IndexOfNode, NewIndexOfNode);
+    Permute(m_World, m_IndexOfNode, NewIndexOfNode);
+    Permute(m_LocalBounds, m_IndexOfNode, NewIndexOfNode);
+    for (int i = 0; i < 6; ++i)
+    {
+        Permute(m_WorldBounds[i], m_IndexOfNode, NewIndexOfNode);
+        Permute(m_SubtreeBounds[i], m_IndexOfNode, NewIndexOfNode);
+    }
+
+    m_IndexOfNode.swap(NewIndexOfNode);
+    m_NodeAt.swap(Order);
+    for (uint32_t i = 0; i < NumNodes; ++i)
+    {
+        const NodeId Parent = m_ParentOfNode[m_NodeAt[i]];
+        m_Parent[i] = Parent == kNoParent ? kNoParent : m_IndexOfNode[Parent];
+    }
+}
+
+void SceneGraph::FindUpdateRanges( bool RefitAll )
+{
+    const uint32_t NumLevels = GetNumLevels();
+    m_TransformRanges.resize(NumLevels);
+    m_RefitRanges.resize(NumLevels);
+    for (uint32_t Level = 0; Level < NumLevels; ++Level)
+    {
+        m_TransformRanges[Level].clear();
+        m_RefitRanges[Level].clear();
+    }
+
+    for (NodeId Node : m_DirtyNodes)
+    {
+        const uint32_t Index = m_IndexOfNode[Node];
+        const uint32_t Level = (uint32_t)(upper_bound(m_LevelStart.begin(), m_LevelStart.end(), Index) - m_LevelStart.begin()) - 1;
+        Range Single = { Index, Index + 1 };
+        m_TransformRanges[Level].push_back(Single);
+        m_IsDirty[Node] = 0;
+    }
+    m_DirtyNodes.clear();
+
+    // Down the hierarchy, the children of every node recomputed are recomputed too
+    for (uint32_t Level = 0; Level < NumLevels; ++Level)
+    {
+        if (Level > 0)
+        {
+            for (const Range& Parents : m_TransformRanges[Level - 1])
+            {
+                Range Children = { m_FirstChild[Parents.First], m_FirstChild[Parents.End - 1] + m_NumChildren[Parents.End - 1] };
+                if (Children.First < Children.End)
+                    m_TransformRanges[Level].push_back(Children);
+            }
+        }
+        MergeRanges(m_TransformRanges[Level]);
+    }
+
+    // Then back up, the parents of every node refit refit too
+    for (uint32_t Level = NumLevels; Level-- > 0; )
+    {
+        vector<Range>& Refit = m_RefitRanges[Level];
+        if (RefitAll)
+        {
+            Range Whole = { m_LevelStart[Level], m_LevelStart[Level + 1] };
+            Refit.push_back(Whole);
+            continue;
+        }
+
+        Refit = m_TransformRanges[Level];
+        if (Level + 1 < NumLevels)
+        {
+            for (const Range& Children : m_RefitRanges[Level + 1])
+            {
+                Range Parents = { m_Parent[Children.First], m_Parent[Children.End - 1] + 1 };
+                Refit.push_back(Parents);
+            }
+        }
+        MergeRanges(Refit);
+    }
+}
+
+template <typename Func>
+void SceneGraph::ForEachRange( const vector<Range>& Ranges, Func Body )
+{
+    m_Chunks.clear();
+    for (const Range& R : Ranges)
+    {
+        for (uint32_t First = R.First; First < R.End; First += kParallelChunkSize)
+        {
+            Range Chunk = { First, min(First + kParallelChunkSize, R.End) };
+            m_Chunks.push_back(Chunk);
+        }
+    }
+
+    ParallelFor((uint32_t)m_Chunks.size(), [&]( uint32_t i )
+    {
+        Body(m_Chunks[i].First, m_Chunks[i].End);
+    });
+}
+
+// Parents are a depth up, so their world transforms are already done
+void SceneGraph::UpdateTransforms( uint32_t First, uint32_t End )
+{
+    for (uint32_t i = First; i < End; ++i)
+    {
+        const uint32_t Parent = m_Parent[i];
+        float* World = m_World[i].m;
+        if (Parent == kNoParent)
+            memcpy(World, m_Local[i].m, sizeof(Transform));
+        else
+            MultiplyAffine(m_Local[i].m, m_World[Parent].m, World);
+
+        if (!m_HasBounds[i])
+        {
+            for (int k = 0; k < 6; ++k)
+                m_WorldBounds[k][i] = k < 3 ? FLT_MAX : -FLT_MAX;
+            continue;
+        }
+
+        // The box's center transforms as a point, and its extent grows by the absolute value of each axis
+        const LocalBox& Box = m_LocalBounds[i];
+        const Float4 Row0 = Load(World);
+        const Float4 Row1 = Load(World + 4);
+        const Float4 Row2 = Load(World + 8);
+        const Float4 Center = Add(Add(Mul(Splat(Box.Center[0]), Row0), Mul(Splat(Box.Center[1]), Row1)),
+            Add(Mul(Splat(Box.Center[2]), Row2), Load(World + 12)));
+        const Float4 Extent = Add(Add(Mul(Splat(Box.Extent[0]), Abs(Row0)), Mul(Splat(Box.Extent[1]), Abs(Row1))),
+            Mul(Splat(Box.Extent[2]), Abs(Row2)));
+
+        float MinBound[4], MaxBound[4];
+        Store(MinBound, Sub(Center, Extent));
+        Store(MaxBound, Add(Center, Extent));
+        for (int k = 0; k < 3; ++k)
+        {
+            m_WorldBounds[k][i] = MinBound[k];
+            m_WorldBounds[k + 3][i] = MaxBound[k];
+        }
+    }
+}
+
+// Children are a depth down, so their subtree bounds are already done
+void SceneGraph::RefitBounds( uint32_t First, uint32_t End )
+{
+    for (uint32_t i = First; i < End; ++i)
+    {
+        const uint32_t FirstChild = m_FirstChild[i];
+        const uint32_t EndChild = FirstChild + m_NumChildren[i];
+
+        for (int k = 0; k < 3; ++k)
+        {
+            float MinBound = m_WorldBounds[k][i];
+            float MaxBound = m_WorldBounds[k + 3][i];
+            for (uint32_t Child = FirstChild; Child < EndChild; ++Child)
+            {
+                MinBound = min(MinBound, m_SubtreeBounds[k][Child]);
+                MaxBound = max(MaxBound, m_SubtreeBounds[k + 3][Child]);
+            }
+            m_SubtreeBounds[k][i] = MinBound;
+            m_SubtreeBounds[k + 3][i] = MaxBound;
+        }
+    }
+}
+
+void SceneGraph::Update( void )
+{
+    m_NumNodesUpdated = 0;
+    if (m_DirtyNodes.empty())
+        return;
+
+    // A moved subtree leaves its old ancestors' bounds too large, so after a sort every node refits
+    const bool RefitAll = m_NeedsSort;
+    if (m_NeedsSort)
+    {
+        SortNodes();
+        m_NeedsSort = false;
+    }
+
+    FindUpdateRanges(RefitAll);
+
+    for (const vector<Range>& Ranges : m_TransformRanges)
+    {
+        ForEachRange(Ranges, [&]( uint32_t First, uint32_t End )
+        {
+            UpdateTransforms(First, End);
+        });
+
+        for (const Range& R : Ranges)
+            m_NumNodesUpdated += R.End - R.First;
+    }
+
+    for (size_t Level = m_RefitRanges.size(); Level-- > 0; )
+    {
+        ForEachRange(m_RefitRanges[Level], [&]( uint32_t First, uint32_t End )
+        {
+            RefitBounds(First, End);
+        });
+    }
+}
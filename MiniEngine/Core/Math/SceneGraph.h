@@ -0,0 +1,135 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A hierarchy of transforms with bounds, stored as flat arrays rather than as linked nodes.  Nodes
+// are kept in breadth-first order:  every parent comes before its children, the nodes of each depth are
+// contiguous, and the children of a node are next to each other.  Update() then walks the arrays one depth at a
+// time, and the nodes of a depth can be split between the worker threads with no locking.
+//
+// Only nodes whose local transform changed, and their descendants, have their world transforms recomputed.  The
+// bounds of each node's own geometry and of its whole subtree are refit in world space on the way back up, again
+// only where something changed.  The world bounds come out as structures of arrays, ready for CullBoxes().
+//
+// Like BatchCulling, this file has no dependencies on the rest of the engine.
+//
+
+#pragma once
+
+#include "BatchCulling.h"
+#include <vector>
+
+namespace Math
+{
+    class SceneGraph
+    {
+    public:
+        typedef uint32_t NodeId;
+        static const NodeId kNoParent = ~0u;
+
+        SceneGraph();
+
+        // New nodes have an identity transform and no bounds.  The parent must already exist.
+        NodeId AddNode( NodeId Parent = kNoParent );
+
+        // Moves the node, with its subtree, under another parent.  The parent can't be in the node's subtree.
+        void SetParent( NodeId Node, NodeId Parent );
+        NodeId GetParent( NodeId Node ) const { return m_ParentOfNode[Node]; }
+
+        // Transforms are sixteen floats laid out as Math::Matrix4 is in memory, so a Matrix4 or AffineTransform
+        // can be passed as (const float*)&Mat.  They must be affine; the last column is taken to be (0, 0, 0, 1).
+        // A node's world transform is its parent's world transform times its local one, as Matrix4s multiply.
+        void SetLocalTransform( NodeId Node, const float* Matrix );
+        const float* GetLocalTransform( NodeId Node ) const { return m_Local[m_IndexOfNode[Node]].m; }
+
+        // Bounds of the node's own geometry in its local space.  Nodes without geometry still bound their subtree.
+        void SetLocalBounds( NodeId Node, const float* MinBound, const float* MaxBound );
+        void ClearLocalBounds( NodeId Node );
+
+        // Brings the world transforms and bounds up to date.  No other calls may be made while this runs.
+        void Update( void );
+
+        // These are as of the last Update()
+        const float* GetWorldTransform( NodeId Node ) const { return m_World[m_IndexOfNode[Node]].m; }
+        bool GetWorldBounds( NodeId Node, float* MinBound, float* MaxBound ) const;
+        bool GetSubtreeBounds( NodeId Node, float* MinBound, float* MaxBound ) const;
+
+        uint32_t GetNumNodes( void ) const { return (uint32_t)m_ParentOfNode.size(); }
+        uint32_t GetNumLevels( void ) const { return (uint32_t)m_LevelStart.size() - 1; }
+
+        // World bounds of every node, in update order.  Nodes without bounds have inverted boxes, which any
+        // culling rejects.  GetNodeAt() maps an index in these arrays, or in a cull mask, back to its node.
+        BoxArrays GetWorldBoxes( void ) const;
+        BoxArrays GetSubtreeBoxes( void ) const;
+        NodeId GetNodeAt( uint32_t Index ) const { return m_NodeAt[Index]; }
+        uint32_t GetIndexOf( NodeId Node ) const { return m_IndexOfNode[Node]; }
+
+        // Nodes whose world transforms were recomputed by the last Update()
+        uint32_t GetNumNodesUpdated( void ) const { return m_NumNodesUpdated; }
+
+    private:
+        struct Transform
+        {
+            float m[16];
+        };
+
+        struct LocalBox
+        {
+            float Center[4];
+            float Extent[4];
+        };
+
+        // Nodes [First, End) in update order
+        struct Range
+        {
+            uint32_t First, End;
+        };
+
+        // Ranges longer than this are split between the worker threads
+        static const uint32_t kParallelChunkSize = 2048;
+
+        void MarkDirty( NodeId Node );
+        void SortNodes( void );
+        void FindUpdateRanges( bool RefitAll );
+        void UpdateTransforms( uint32_t First, uint32_t End );
+        void RefitBounds( uint32_t First, uint32_t End );
+
+        template <typename Func>
+        void ForEachRange( const std::vector<Range>& Ranges, Func Body );
+
+        // Indexed by NodeId
+        std::vector<NodeId> m_ParentOfNode;
+        std::vector<uint32_t> m_IndexOfNode;
+        std::vector<uint8_t> m_IsDirty;
+        std::vector<NodeId> m_DirtyNodes;
+
+        // Indexed in update order
+        std::vector<NodeId> m_NodeAt;
+        std::vector<uint32_t> m_Parent;             // Index of the parent, or kNoParent
+        std::vector<uint32_t> m_FirstChild;
+        std::vector<uint32_t> m_NumChildren;
+        std::vector<uint8_t> m_HasBounds;
+        std::vector<Transform> m_Local;
+        std::vector<Transform> m_World;
+        std::vector<LocalBox> m_LocalBounds;
+        std::vector<float> m_WorldBounds[6];        // Min x, y, z, then max x, y, z
+        std::vector<float> m_SubtreeBounds[6];
+
+        std::vector<uint32_t> m_LevelStart;         // Index of the first node of each depth, and the node count
+        bool m_NeedsSort;
+
+        // Per depth, the nodes the next Update() recomputes, and the nodes whose subtree bounds it refits.  Since
+        // the nodes are in breadth-first order, the children of a range of nodes are a range too, as are the
+        // parents, so a moved subtree is one range at each depth below it.
+        std::vector<std::vector<Range>> m_TransformRanges;
+        std::vector<std::vector<Range>> m_RefitRanges;
+        std::vector<Range> m_Chunks;
+        uint32_t m_NumNodesUpdated;
+    };
+}
@@ -189,10 +189,11 @@ namespace
         UINT TextureID = (UINT)(TextureNameArray.size() - 1);
         effectProperties.EmitProperties.TextureID = TextureID;
 
-        const ManagedTexture* managedTex = TextureManager::LoadDDSFromFile(name.c_str(), true);
+        // Only needed until it's copied into the array
+        TextureRef managedTex = TextureManager::LoadDDSFromFile(name.c_str(), true);
         managedTex->WaitForLoad();
 
-        GpuResource& ParticleTexture = *const_cast<ManagedTexture*>(managedTex);
+        GpuResource& ParticleTexture = *const_cast<ManagedTexture*>(managedTex.Get());
         CommandContext::InitializeTextureArraySlice(TextureArray, TextureID, ParticleTexture);
     }
 
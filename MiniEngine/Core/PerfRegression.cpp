@@ -0,0 +1,494 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "PerfRegression.h"
+#include "GraphicsCore.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <shellapi.h>
+
+#pragma comment(lib, "shell32.lib")
+
+using namespace std;
+
+namespace PerfRegression
+{
+    BoolVar WriteSummaryOnExit("Profiling/Write Summary On Exit", false);
+}
+
+namespace
+{
+    bool s_Benchmarking = false;
+    uint32_t s_NumFrames = 0;
+    uint32_t s_NumWarmupFrames = 120;
+    uint32_t s_FrameNumber = 0;
+    wstring s_SummaryFile = L"PerfSummary.json";
+    wstring s_BaselineFile;
+    float s_Tolerance = 10.0f;
+    float s_Slack = 0.1f;
+    int s_MaxHitches = -1;
+
+    struct Metric
+    {
+        string Name;        // UTF-8
+        uint64_t Count;
+        float Average;
+        float P50;
+        float P95;
+        float P99;
+        float Maximum;
+    };
+
+    struct Summary
+    {
+        uint64_t Frames;
+        uint32_t Hitches;
+        vector<Metric> Metrics;
+    };
+
+    // Utility::Printf() has a short buffer, and scope paths can be long
+    void Report( const char* Format, ... )
+    {
+        char Buffer[1024];
+        va_list ap;
+        va_start(ap, Format);
+        vsnprintf(Buffer, sizeof(Buffer), Format, ap);
+        va_end(ap);
+        Utility::Print(Buffer);
+    }
+
+    string EscapeJson( const string& Str )
+    {
+        string Result;
+        for (char c : Str)
+        {
+            if (c == '"' || c == '\\')
+                Result += '\\';
+            if ((unsigned char)c >= 0x20)
+                Result += c;
+        }
+        return Result;
+    }
+
+    Summary GatherSummary( void )
+    {
+        vector<EngineProfiling::StatSummary> Stats;
+        EngineProfiling::GetStatSummaries(Stats);
+
+        Summary Result;
+        Result.Frames = 0;
+        Result.Hitches = EngineProfiling::GetHitchCount();
+
+        for (const EngineProfiling::StatSummary& Stat : Stats)
+        {
+            Metric NewMetric = { MakeUTF8(Stat.Name), Stat.Count, Stat.Average, Stat.P50, Stat.P95, Stat.P99, Stat.Maximum };
+            Result.Metrics.push_back(NewMetric);
+
+            if (Stat.Name == L"Frame Time")
+                Result.Frames = Stat.Count;
+        }
+
+        return Result;
+    }
+
+    bool WriteSummary( const wstring& FileName, const Summary& Sum )
+    {
+        ofstream File(FileName, ios::out | ios::trunc);
+        if (!File)
+            return false;
+
+        char Line[256];
+        snprintf(Line, sizeof(Line), "{\n  \"version\": 1,\n  \"frames\": %llu,\n  \"hitches\": %u,\n  \"metrics\": {",
+            Sum.Frames, Sum.Hitches);
+        File << Line;
+
+        for (size_t i = 0; i < Sum.Metrics.size(); ++i)
+        {
+            const Metric& M = Sum.Metrics[i];
+            snprintf(Line, sizeof(Line), "\": { \"count\": %llu, \"avg\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+                M.Count, M.Average, M.P50, M.P95, M.P99, M.Maximum);
+            File << (i == 0 ? "\n    \"" : ",\n    \"") << EscapeJson(M.Name) << Line;
+        }
+
+        File << "\n  }\n}\n";
+        return File.good();
+    }
+
+    // Reads what WriteSummary() writes.  Fields it doesn't know are skipped, so that summaries can gain
+    // fields without breaking older baselines.
+    class SummaryReader
+    {
+    public:
+        SummaryReader( const string& Text ) : m_Text(Text), m_Pos(0) {}
+
+        bool Read( Summary& Sum )
+        {
+            Sum.Frames = 0;
+            Sum.Hitches = 0;
+            Sum.Metrics.clear();
+
+            return ReadObject([&]( const string& Key )
+            {
+                if (Key == "frames")
+                    return ReadInteger(Sum.Frames);
+                else if (Key == "hitches")
+                {
+                    uint64_t Hitches;
+                    if (!ReadInteger(Hitches))
+                        return false;
+                    Sum.Hitches = (uint32_t)Hitches;
+                    return true;
+                }
+                else if (Key == "metrics")
+                    return ReadObject([&]( const string& Name ) { return ReadMetric(Name, Sum.Metrics); });
+                else
+                    return SkipValue();
+            });
+        }
+
+    private:
+        bool ReadMetric( const string& Name, vector<Metric>& Metrics )
+        {
+            Metric M = { Name, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+
+            bool Succeeded = ReadObject([&]( const string& Key )
+            {
+                if (Key == "count")
+                    return ReadInteger(M.Count);
+
+                float* Field = Key == "avg" ? &M.Average : Key == "p50" ? &M.P50 : Key == "p95" ? &M.P95 :
+                    Key == "p99" ? &M.P99 : Key == "max" ? &M.Maximum : nullptr;
+
+                if (Field == nullptr)
+                    return SkipValue();
+
+                double Value;
+                if (!ReadNumber(Value))
+                    return false;
+                *Field = (float)Value;
+                return true;
+            });
+
+            Metrics.push_back(M);
+            return Succeeded;
+        }
+
+        template <typename Func>
+        bool ReadObject( Func ReadField )
+        {
+            if (!Expect('{'))
+                return false;
+            if (Expect('}'))
+                return true;
+
+            do
+            {
+                string Key;
+                if (!ReadString(Key) || !Expect(':') || !ReadField(Key))
+                    return false;
+            }
+            while (Expect(','));
+
+            return Expect('}');
+        }
+
+        bool ReadString( string& Str )
+        {
+            if (!Expect('"'))
+                return false;
+
+            while (m_Pos < m_Text.size() && m_Text[m_Pos] != '"')
+            {
+                char c = m_Text[m_Pos++];
+                if (c == '\\' && m_Pos < m_Text.size())
+                {
+                    c = m_Text[m_Pos++];
+                    if (c == 'u')
+                    {
+                        // Scope names are written unescaped, so this only needs to keep the reader in step
+                        m_Pos = min(m_Pos + 4, m_Text.size());
+                        c = '?';
+                    }
+                    else if (c == 'n')
+                        c = '\n';
+                    else if (c == 't')
+                        c = '\t';
+                }
+                Str += c;
+            }
+
+            return Expect('"');
+        }
+
+        bool ReadNumber( double& Value )
+        {
+            SkipSpace();
+            const char* Start = m_Text.c_str() + m_Pos;
+            char* End = nullptr;
+            Value = strtod(Start, &End);
+            if (End == Start)
+                return false;
+            m_Pos += End - Start;
+            return true;
+        }
+
+        bool ReadInteger( uint64_t& Value )
+        {
+            double Number;
+            if (!ReadNumber(Number) || Number < 0.0)
+                return false;
+            Value = (uint64_t)Number;
+            return true;
+        }
+
+        bool SkipValue( void )
+        {
+            SkipSpace();
+            if (m_Pos == m_Text.size())
+                return false;
+
+            const char c = m_Text[m_Pos];
+            if (c == '{')
+                return ReadObject([&]( const string& ) { return SkipValue(); });
+            else if (c == '[')
+            {
+                ++m_Pos;
+                if (Expect(']'))
+                    return true;
+                do
+                {
+                    if (!SkipValue())
+                        return false;
+                }
+                while (Expect(','));
+                return Expect(']');
+            }
+            else if (c == '"')
+            {
+                string Ignored;
+                return ReadString(Ignored);
+            }
+            else if (isalpha((unsigned char)c))
+            {
+                while (m_Pos < m_Text.size() && isalpha((unsigned char)m_Text[m_Pos]))
+                    ++m_Pos;
+                return true;
+            }
+
+            double Ignored;
+            return ReadNumber(Ignored);
+        }
+
+        // Consumes c if it's the next character that isn't white space
+        bool Expect( char c )
+        {
+            SkipSpace();
+            if (m_Pos == m_Text.size() || m_Text[m_Pos] != c)
+                return false;
+            ++m_Pos;
+            return true;
+        }
+
+        void SkipSpace( void )
+        {
+            while (m_Pos < m_Text.size() && isspace((unsigned char)m_Text[m_Pos]))
+                ++m_Pos;
+        }
+
+        const string& m_Text;
+        size_t m_Pos;
+    };
+
+    bool ReadSummary( const wstring& FileName, Summary& Sum )
+    {
+        ifstream File(FileName, ios::in);
+        if (!File)
+            return false;
+
+        stringstream Contents;
+        Contents << File.rdbuf();
+        const string Text = Contents.str();
+        return SummaryReader(Text).Read(Sum);
+    }
+
+    // Only the percentiles are compared.  The maximum is a single frame, and the average hides the tail.
+    bool Compare( const Summary& Current, const Summary& Baseline )
+    {
+        unordered_map<string, const Metric*> BaselineMetrics;
+        for (const Metric& M : Baseline.Metrics)
+            BaselineMetrics[M.Name] = &M;
+
+        const char* StatNames[3] = { "p50", "p95", "p99" };
+        uint32_t NumRegressions = 0;
+        uint32_t NumCompared = 0;
+
+        for (const Metric& Cur : Current.Metrics)
+        {
+            auto Iter = BaselineMetrics.find(Cur.Name);
+            if (Iter == BaselineMetrics.end())
+                continue;
+
+            const Metric& Base = *Iter->second;
+            const float CurStats[3] = { Cur.P50, Cur.P95, Cur.P99 };
+            const float BaseStats[3] = { Base.P50, Base.P95, Base.P99 };
+
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                ++NumCompared;
+                const float Limit = BaseStats[i] * (1.0f + s_Tolerance * 0.01f) + s_Slack;
+                if (CurStats[i] <= Limit)
+                    continue;
+
+                ++NumRegressions;
+                Report("Regressed: %s %s is %.3f ms, baseline %.3f ms (%+.1f%%)\n", Cur.Name.c_str(), StatNames[i],
+                    CurStats[i], BaseStats[i], BaseStats[i] > 0.0f ? 100.0f * (CurStats[i] / BaseStats[i] - 1.0f) : 100.0f);
+            }
+
+            BaselineMetrics.erase(Iter);
+        }
+
+        for (auto& Missing : BaselineMetrics)
+            Report("Not measured: %s (in the baseline only)\n", Missing.first.c_str());
+
+        Report("Compared %u statistics with the baseline (%.0f%% + %.2f ms tolerance): %u regressed\n",
+            NumCompared, s_Tolerance, s_Slack, NumRegressions);
+
+        return NumRegressions == 0;
+    }
+}
+
+void PerfRegression::Initialize( void )
+{
+#if WINAPI_FAMILY_PARTITION(WINAPI_PARTITION_DESKTOP)
+    int argc = 0;
+    wchar_t** argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    if (argv == nullptr)
+        return;
+
+    // Options this doesn't know are left for the application
+    for (int arg = 1; arg + 1 < argc; ++arg)
+    {
+        const wchar_t* Option = argv[arg];
+        const wchar_t* Operand = argv[arg + 1];
+
+        if (_wcsicmp(Option, L"-benchmark") == 0)
+            s_NumFrames = (uint32_t)max(_wtoi(Operand), 1);
+        else if (_wcsicmp(Option, L"-warmup") == 0)
+            s_NumWarmupFrames = (uint32_t)max(_wtoi(Operand), 0);
+        else if (_wcsicmp(Option, L"-summary") == 0)
+            s_SummaryFile = Operand;
+        else if (_wcsicmp(Option, L"-baseline") == 0)
+            s_BaselineFile = Operand;
+        else if (_wcsicmp(Option, L"-tolerance") == 0)
+            s_Tolerance = max((float)_wtof(Operand), 0.0f);
+        else if (_wcsicmp(Option, L"-slack") == 0)
+            s_Slack = max((float)_wtof(Operand), 0.0f);
+        else if (_wcsicmp(Option, L"-maxhitches") == 0)
+            s_MaxHitches = _wtoi(Operand);
+        else
+            continue;
+
+        ++arg;
+    }
+
+    LocalFree(argv);
+
+    s_Benchmarking = s_NumFrames > 0;
+    if (!s_Benchmarking)
+        return;
+
+    // Presenting on vertical blanks would hide everything shorter than a refresh
+    Graphics::s_EnableVSync = false;
+
+    Utility::Printf("Benchmarking %u frames after %u frames of warm up\n", s_NumFrames, s_NumWarmupFrames);
+#endif
+}
+
+void PerfRegression::Update( void )
+{
+    if (!s_Benchmarking)
+        return;
+
+    // EngineProfiling has gathered the times of the frames before this one
+    if (++s_FrameNumber == s_NumWarmupFrames + 1)
+        EngineProfiling::ResetStatistics();
+}
+
+bool PerfRegression::IsBenchmarking( void )
+{
+    return s_Benchmarking;
+}
+
+bool PerfRegression::IsDone( void )
+{
+    // The frame after the last measured one is rendered too, because frames are timed at the start of the next
+    return s_Benchmarking && s_FrameNumber > s_NumWarmupFrames + s_NumFrames;
+}
+
+float PerfRegression::GetPathPosition( void )
+{
+    if (!s_Benchmarking || s_FrameNumber <= s_NumWarmupFrames + 1 || s_NumFrames < 2)
+        return 0.0f;
+
+    return min((float)(s_FrameNumber - s_NumWarmupFrames - 1) / (float)(s_NumFrames - 1), 1.0f);
+}
+
+int PerfRegression::Shutdown( void )
+{
+    if (!s_Benchmarking && !WriteSummaryOnExit)
+        return kPassed;
+
+    const Summary Current = GatherSummary();
+    if (!WriteSummary(s_SummaryFile, Current))
+    {
+        Utility::Printf(L"Couldn't write the performance summary to %s\n", s_SummaryFile.c_str());
+        return kFailedToRun;
+    }
+
+    Utility::Printf(L"Wrote the performance summary to %s\n", s_SummaryFile.c_str());
+
+    if (!s_Benchmarking)
+        return kPassed;
+
+    // Quitting early, say by closing the window, measures fewer frames than asked for
+    if (Current.Frames < s_NumFrames)
+    {
+        Utility::Printf("Benchmark stopped after %llu of %u frames\n", Current.Frames, s_NumFrames);
+        return kFailedToRun;
+    }
+
+    bool Passed = true;
+
+    if (s_MaxHitches >= 0 && Current.Hitches > (uint32_t)s_MaxHitches)
+    {
+        Utility::Printf("Regressed: %u hitches, %d allowed\n", Current.Hitches, s_MaxHitches);
+        Passed = false;
+    }
+
+    if (!s_BaselineFile.empty())
+    {
+        Summary Baseline;
+        if (!ReadSummary(s_BaselineFile, Baseline))
+        {
+            Utility::Printf(L"Couldn't read the baseline %s\n", s_BaselineFile.c_str());
+            return kFailedToRun;
+        }
+
+        if (!Compare(Current, Baseline))
+            Passed = false;
+    }
+
+    Utility::Printf("Benchmark %s\n", Passed ? "passed" : "FAILED");
+    return Passed ? kPassed : kRegressed;
+}
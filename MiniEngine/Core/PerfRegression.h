@@ -0,0 +1,60 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Benchmark runs for performance regression testing.  With "-benchmark <frames>" on the command
+// line, the application warms up, renders the given number of frames while the game moves its camera along a
+// scripted path (see GetPathPosition()), and exits.  The frame time statistics of EngineProfiling are then
+// written as a JSON summary and compared with a baseline, and the process exit code says whether it passed.
+//
+// Options:
+//
+//   -benchmark <frames>      Frames to measure
+//   -warmup <frames>         Frames to render first, at the start of the path.  Defaults to 120.
+//   -summary <file>          Where to write the summary.  Defaults to PerfSummary.json.
+//   -baseline <file>         A summary from an earlier run to compare with
+//   -tolerance <percent>     How much slower p50, p95 and p99 may be than the baseline.  Defaults to 10.
+//   -slack <ms>              An absolute allowance as well, so that short scopes don't fail on noise.
+//                            Defaults to 0.1.
+//   -maxhitches <count>      Fails the run if it has more hitches than this
+//
+// The summary is also written on exit, without a benchmark run, when "Profiling/Write Summary On Exit" is set.
+//
+
+#pragma once
+
+#include <string>
+
+namespace PerfRegression
+{
+    enum ExitCode
+    {
+        kPassed = 0,
+        kRegressed = 1,
+        kFailedToRun = 2    // The baseline or summary couldn't be read or written
+    };
+
+    // Reads the command line
+    void Initialize( void );
+
+    // Call at the start of each frame.  Resets the statistics when the warm up is over.
+    void Update( void );
+
+    bool IsBenchmarking( void );
+
+    // True once every frame has been measured
+    bool IsDone( void );
+
+    // How far along the camera path the benchmark is, from 0 during the warm up to 1 on the last frame.  The
+    // position advances by frame rather than by time, so that every run renders the same views.
+    float GetPathPosition( void );
+
+    // Writes the summary and compares it with the baseline.  Returns the process exit code.
+    int Shutdown( void );
+}
@@ -0,0 +1,302 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "PipelineCacheFile.h"
+#include "Hash.h"
+#include <fstream>
+
+using namespace std;
+
+PipelineCacheFile::PipelineCacheFile()
+    : m_CompatibilityTag(0)
+    , m_FileHandle(INVALID_HANDLE_VALUE)
+    , m_MappingHandle(nullptr)
+    , m_MappedData(nullptr)
+    , m_MappedSize(0)
+    , m_Entries(nullptr)
+    , m_NumEntries(0)
+    , m_BlobData(nullptr)
+    , m_NumCorrupt(0)
+    , m_Prewarming(false)
+{
+}
+
+bool PipelineCacheFile::Open( const wstring& FileName, uint64_t CompatibilityTag )
+{
+    Close();
+
+    m_FileName = FileName;
+    m_CompatibilityTag = CompatibilityTag;
+
+    HANDLE File = CreateFile2(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER FileSize = {};
+    if (!GetFileSizeEx(File, &FileSize) || FileSize.QuadPart < (LONGLONG)sizeof(FileHeader))
+    {
+        CloseHandle(File);
+        return false;
+    }
+
+    HANDLE Mapping = CreateFileMapping(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* View = Mapping != nullptr ? MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (View == nullptr)
+    {
+        if (Mapping != nullptr)
+            CloseHandle(Mapping);
+        CloseHandle(File);
+        return false;
+    }
+
+    m_FileHandle = File;
+    m_MappingHandle = Mapping;
+
+    if (!Attach(View, (size_t)FileSize.QuadPart, CompatibilityTag))
+    {
+        Unmap();
+        return false;
+    }
+
+    return true;
+}
+
+bool PipelineCacheFile::Attach( const void* Data, size_t Size, uint64_t CompatibilityTag )
+{
+    m_CompatibilityTag = CompatibilityTag;
+    m_MappedData = (const uint8_t*)Data;
+    m_MappedSize = Size;
+    m_Entries = nullptr;
+    m_NumEntries = 0;
+    m_BlobData = nullptr;
+    m_Index.clear();
+    m_NumCorrupt = 0;
+
+    if (Size < sizeof(FileHeader))
+        return false;
+
+    const FileHeader& Header = *(const FileHeader*)Data;
+    if (Header.Magic != kMagic || Header.Version != kVersion || Header.CompatibilityTag != CompatibilityTag)
+        return false;
+
+    if (Header.NumEntries > (Size - sizeof(FileHeader)) / sizeof(IndexEntry))
+        return false;
+
+    const size_t IndexSize = sizeof(IndexEntry) * Header.NumEntries;
+    const size_t DataStart = Math::AlignUp(sizeof(FileHeader) + IndexSize, 16);
+    if (DataStart > Size || Header.DataSize > Size - DataStart)
+        return false;
+
+    const IndexEntry* Entries = (const IndexEntry*)(m_MappedData + sizeof(FileHeader));
+    if (Utility::HashBytes(Entries, IndexSize) != Header.IndexChecksum)
+    {
+        DEBUGPRINT("Pipeline cache index is corrupt and will be rebuilt");
+        return false;
+    }
+
+    for (uint32_t i = 0; i < Header.NumEntries; ++i)
+    {
+        if (Entries[i].Offset > Header.DataSize || Entries[i].Size > Header.DataSize - Entries[i].Offset)
+        {
+            m_Index.clear();
+            return false;
+        }
+        m_Index[Entries[i].Key] = i;
+    }
+
+    m_Entries = Entries;
+    m_NumEntries = Header.NumEntries;
+    m_BlobData = m_MappedData + DataStart;
+    m_EntryState.reset(new atomic<uint8_t>[Header.NumEntries]);
+    for (uint32_t i = 0; i < Header.NumEntries; ++i)
+        m_EntryState[i] = kUnverified;
+
+    return true;
+}
+
+void PipelineCacheFile::Unmap( void )
+{
+    m_PrewarmTasks.wait();
+    m_Prewarming = false;
+
+    if (m_MappingHandle != nullptr)
+    {
+        UnmapViewOfFile(m_MappedData);
+        CloseHandle(m_MappingHandle);
+        m_MappingHandle = nullptr;
+    }
+
+    if (m_FileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_FileHandle);
+        m_FileHandle = INVALID_HANDLE_VALUE;
+    }
+
+    m_MappedData = nullptr;
+    m_MappedSize = 0;
+    m_Entries = nullptr;
+    m_NumEntries = 0;
+    m_BlobData = nullptr;
+    m_Index.clear();
+    m_EntryState.reset();
+}
+
+void PipelineCacheFile::Close( void )
+{
+    Unmap();
+
+    lock_guard<mutex> LockGuard(m_StoreMutex);
+    m_Stored.clear();
+}
+
+bool PipelineCacheFile::VerifyEntry( size_t EntryIdx )
+{
+    uint8_t State = m_EntryState[EntryIdx];
+    if (State == kUnverified)
+    {
+        const IndexEntry& Entry = m_Entries[EntryIdx];
+        bool Valid = Utility::HashBytes(m_BlobData + Entry.Offset, (size_t)Entry.Size) == Entry.Checksum;
+
+        // Two threads may verify the same entry at once; only one of them counts it
+        uint8_t Expected = kUnverified;
+        if (m_EntryState[EntryIdx].compare_exchange_strong(Expected, Valid ? kValid : kCorrupt) && !Valid)
+            ++m_NumCorrupt;
+
+        State = Valid ? kValid : kCorrupt;
+    }
+    return State == kValid;
+}
+
+void PipelineCacheFile::Prewarm( void )
+{
+    if (m_Entries == nullptr || m_Prewarming)
+        return;
+
+    m_Prewarming = true;
+    m_PrewarmTasks.run([this]()
+    {
+        concurrency::parallel_for(0u, m_NumEntries, [this]( uint32_t EntryIdx ) { VerifyEntry(EntryIdx); });
+    });
+}
+
+bool PipelineCacheFile::Find( uint64_t Key, const void*& Data, size_t& Size )
+{
+    auto Iter = m_Index.find(Key);
+    if (Iter == m_Index.end() || !VerifyEntry(Iter->second))
+        return false;
+
+    const IndexEntry& Entry = m_Entries[Iter->second];
+    Data = m_BlobData + Entry.Offset;
+    Size = (size_t)Entry.Size;
+    return true;
+}
+
+void PipelineCacheFile::Store( uint64_t Key, const void* Data, size_t Size )
+{
+    lock_guard<mutex> LockGuard(m_StoreMutex);
+    m_Stored[Key].assign((const uint8_t*)Data, (const uint8_t*)Data + Size);
+}
+
+size_t PipelineCacheFile::GetNumStored( void )
+{
+    lock_guard<mutex> LockGuard(m_StoreMutex);
+    return m_Stored.size();
+}
+
+void PipelineCacheFile::Serialize( vector<uint8_t>& Image )
+{
+    lock_guard<mutex> LockGuard(m_StoreMutex);
+
+    struct Source { uint64_t Key; const void* Data; size_t Size; };
+    vector<Source> Sources;
+    Sources.reserve(m_Index.size() + m_Stored.size());
+
+    for (auto Iter = m_Index.begin(); Iter != m_Index.end(); ++Iter)
+    {
+        if (m_Stored.find(Iter->first) == m_Stored.end() && VerifyEntry(Iter->second))
+        {
+            const IndexEntry& Entry = m_Entries[Iter->second];
+            Source Src = { Entry.Key, m_BlobData + Entry.Offset, (size_t)Entry.Size };
+            Sources.push_back(Src);
+        }
+    }
+
+    for (auto Iter = m_Stored.begin(); Iter != m_Stored.end(); ++Iter)
+    {
+        Source Src = { Iter->first, Iter->second.data(), Iter->second.size() };
+        Sources.push_back(Src);
+    }
+
+    const size_t IndexSize = sizeof(IndexEntry) * Sources.size();
+    const size_t DataStart = Math::AlignUp(sizeof(FileHeader) + IndexSize, 16);
+
+    size_t DataSize = 0;
+    for (size_t i = 0; i < Sources.size(); ++i)
+        DataSize = Math::AlignUp(DataSize, 16) + Sources[i].Size;
+
+    Image.assign(DataStart + DataSize, 0);
+
+    IndexEntry* Entries = (IndexEntry*)(Image.data() + sizeof(FileHeader));
+    uint8_t* BlobData = Image.data() + DataStart;
+
+    size_t Offset = 0;
+    for (size_t i = 0; i < Sources.size(); ++i)
+    {
+        Offset = Math::AlignUp(Offset, 16);
+        memcpy(BlobData + Offset, Sources[i].Data, Sources[i].Size);
+
+        Entries[i].Key = Sources[i].Key;
+        Entries[i].Offset = Offset;
+        Entries[i].Size = Sources[i].Size;
+        Entries[i].Checksum = Utility::HashBytes(Sources[i].Data, Sources[i].Size);
+
+        Offset += Sources[i].Size;
+    }
+
+    FileHeader& Header = *(FileHeader*)Image.data();
+    Header.Magic = kMagic;
+    Header.Version = kVersion;
+    Header.CompatibilityTag = m_CompatibilityTag;
+    Header.NumEntries = (uint32_t)Sources.size();
+    Header.Reserved = 0;
+    Header.DataSize = DataSize;
+    Header.IndexChecksum = Utility::HashBytes(Entries, IndexSize);
+}
+
+bool PipelineCacheFile::Save( void )
+{
+    if (m_FileName.empty())
+        return false;
+
+    // Nothing new was compiled, so the file on disk is already up to date
+    if (GetNumStored() == 0 && m_NumCorrupt == 0 && m_Entries != nullptr)
+        return true;
+
+    vector<uint8_t> Image;
+    Serialize(Image);
+
+    // The file can't be replaced while it is mapped
+    Unmap();
+
+    const wstring TempFileName = m_FileName + L".tmp";
+    {
+        ofstream File(TempFileName, ios::out | ios::binary | ios::trunc);
+        if (!File)
+            return false;
+
+        File.write((const char*)Image.data(), Image.size());
+        if (!File)
+            return false;
+    }
+
+    return MoveFileEx(TempFileName.c_str(), m_FileName.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
@@ -0,0 +1,122 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A persistent store of driver-compiled pipeline blobs (ID3D12PipelineState::GetCachedBlob),
+// keyed by a 64-bit hash of the pipeline description with every pointer replaced by a hash of what it
+// points to.  All blobs live in one file which is memory-mapped for reading:
+//
+//     FileHeader | IndexEntry[NumEntries] | blob data (16-byte aligned)
+//
+// The header carries a format version and a compatibility tag (adapter and driver identity).  If either
+// differs, or the index checksum fails, the whole file is ignored.  Each blob has its own checksum which
+// is verified before first use, either lazily or by a Prewarm() pass on the PPL worker pool.  Checksums
+// and keys use Utility::HashBytes(), which gives the same result on every CPU.  Blobs compiled this
+// session are kept in memory and the file is rewritten by Save().
+//
+// The format code only deals with bytes, so Attach() and Serialize() may be used without a device.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ppl.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PipelineCacheFile
+{
+public:
+
+    static const uint32_t kMagic = 0x4350454D; // "MEPC"
+    static const uint32_t kVersion = 2;
+
+    PipelineCacheFile();
+    ~PipelineCacheFile() { Close(); }
+
+    // Maps an existing file.  Returns false (leaving an empty cache) if the file is missing, from
+    // another adapter or driver, or damaged.  Save() will write to FileName either way.
+    bool Open( const std::wstring& FileName, uint64_t CompatibilityTag );
+
+    // Uses a caller-owned file image.  The memory must outlive the cache or the next Close().
+    bool Attach( const void* Data, size_t Size, uint64_t CompatibilityTag );
+
+    void Close( void );
+
+    // Verifies every blob on the PPL worker pool, which also faults the mapped file in, so that
+    // lookups pay for neither.  Returns immediately.
+    void Prewarm( void );
+
+    // Returns a verified blob from the file.  The pointer is valid until Close().
+    bool Find( uint64_t Key, const void*& Data, size_t& Size );
+
+    // Records a blob compiled this session.  Replaces any blob with the same key on the next Save().
+    void Store( uint64_t Key, const void* Data, size_t Size );
+
+    // Builds a file image of every valid blob from the file plus those stored this session
+    void Serialize( std::vector<uint8_t>& Image );
+
+    // Writes the image to the file given to Open().  Unmaps the file first.
+    bool Save( void );
+
+    size_t GetNumEntries( void ) const { return m_Index.size(); }
+    size_t GetNumStored( void );
+    size_t GetNumCorrupt( void ) const { return m_NumCorrupt; }
+
+private:
+
+    struct FileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint64_t CompatibilityTag;
+        uint32_t NumEntries;
+        uint32_t Reserved;
+        uint64_t DataSize;
+        uint64_t IndexChecksum;
+    };
+
+    struct IndexEntry
+    {
+        uint64_t Key;
+        uint64_t Offset;
+        uint64_t Size;
+        uint64_t Checksum;
+    };
+
+    enum EntryState : uint8_t { kUnverified, kValid, kCorrupt };
+
+    bool VerifyEntry( size_t EntryIdx );
+    void Unmap( void );
+
+    std::wstring m_FileName;
+    uint64_t m_CompatibilityTag;
+
+    // The mapped (or attached) file
+    void* m_FileHandle;
+    void* m_MappingHandle;
+    const uint8_t* m_MappedData;
+    size_t m_MappedSize;
+
+    const IndexEntry* m_Entries;
+    uint32_t m_NumEntries;
+    const uint8_t* m_BlobData;
+    std::unordered_map<uint64_t, uint32_t> m_Index;
+    std::unique_ptr<std::atomic<uint8_t>[]> m_EntryState;
+    std::atomic<size_t> m_NumCorrupt;
+
+    concurrency::task_group m_PrewarmTasks;
+    bool m_Prewarming;
+
+    std::mutex m_StoreMutex;
+    std::unordered_map<uint64_t, std::vector<uint8_t>> m_Stored;
+};
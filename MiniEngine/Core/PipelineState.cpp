@@ -15,22 +15,100 @@
 #include "PipelineState.h"
 #include "RootSignature.h"
 #include "Hash.h"
-#include <map>
-#include <thread>
-#include <mutex>
+#include "PipelineStateCache.h"
+#include "PipelineCacheFile.h"
 
 using Math::IsAligned;
 using namespace Graphics;
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+// Asynchronous compiles share the PPL worker pool rather than each starting a thread
+static void ScheduleCompile( function<void (void)> Job )
+{
+    concurrency::create_task(Job);
+}
+
+static PipelineStateCache< ComPtr<ID3D12PipelineState> > s_GraphicsPSOCache(ScheduleCompile);
+static PipelineStateCache< ComPtr<ID3D12PipelineState> > s_ComputePSOCache(ScheduleCompile);
+static PipelineCacheFile s_PipelineCacheFile;
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    s_GraphicsPSOCache.Clear();
+    s_ComputePSOCache.Clear();
+}
+
+void PSO::LoadPipelineCache( const std::wstring& FileName, uint64_t CompatibilityTag )
+{
+    if (s_PipelineCacheFile.Open(FileName, CompatibilityTag))
+    {
+        Utility::Printf(L"Loaded %u cached pipelines from %s\n", (uint32_t)s_PipelineCacheFile.GetNumEntries(), FileName.c_str());
+        s_PipelineCacheFile.Prewarm();
+    }
+}
+
+void PSO::SavePipelineCache( void )
+{
+    if (s_PipelineCacheFile.GetNumCorrupt() > 0)
+        Utility::Printf("Discarding %u corrupt cached pipelines\n", (uint32_t)s_PipelineCacheFile.GetNumCorrupt());
+
+    s_PipelineCacheFile.Save();
+    s_PipelineCacheFile.Close();
+}
+
+namespace
+{
+    // Disk keys can't contain pointers, so every pointer is replaced by a hash of what it points to
+    void HashBytecode( D3D12_SHADER_BYTECODE& Bytecode )
+    {
+        if (Bytecode.pShaderBytecode != nullptr)
+            Bytecode.pShaderBytecode = (const void*)(uintptr_t)Utility::HashBytes(Bytecode.pShaderBytecode, Bytecode.BytecodeLength);
+    }
+
+    uint64_t GetPersistentKey( D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc, size_t RootSignatureHash )
+    {
+        const D3D12_INPUT_ELEMENT_DESC* InputElements = Desc.InputLayout.pInputElementDescs;
+
+        Desc.pRootSignature = nullptr;
+        Desc.InputLayout.pInputElementDescs = nullptr;
+        Desc.CachedPSO = D3D12_CACHED_PIPELINE_STATE();
+        HashBytecode(Desc.VS);
+        HashBytecode(Desc.PS);
+        HashBytecode(Desc.DS);
+        HashBytecode(Desc.HS);
+        HashBytecode(Desc.GS);
+
+        uint64_t Key = Utility::HashBytes(&RootSignatureHash, sizeof(RootSignatureHash));
+        Key = Utility::HashBytes(&Desc, sizeof(Desc), Key);
+
+        for (UINT i = 0; i < Desc.InputLayout.NumElements; ++i)
+        {
+            D3D12_INPUT_ELEMENT_DESC Element = InputElements[i];
+            Key = Utility::HashBytes(Element.SemanticName, strlen(Element.SemanticName), Key);
+            Element.SemanticName = nullptr;
+            Key = Utility::HashBytes(&Element, sizeof(Element), Key);
+        }
+
+        return Key;
+    }
+
+    uint64_t GetPersistentKey( D3D12_COMPUTE_PIPELINE_STATE_DESC Desc, size_t RootSignatureHash )
+    {
+        Desc.pRootSignature = nullptr;
+        Desc.CachedPSO = D3D12_CACHED_PIPELINE_STATE();
+        HashBytecode(Desc.CS);
+
+        uint64_t Key = Utility::HashBytes(&RootSignatureHash, sizeof(RootSignatureHash));
+        return Utility::HashBytes(&Desc, sizeof(Desc), Key);
+    }
+
+    void StoreCachedBlob( uint64_t Key, ID3D12PipelineState* PSO )
+    {
+        ComPtr<ID3DBlob> CachedBlob;
+        if (SUCCEEDED(PSO->GetCachedBlob(&CachedBlob)))
+            s_PipelineCacheFile.Store(Key, CachedBlob->GetBufferPointer(), CachedBlob->GetBufferSize());
+    }
 }
 
 
@@ -107,47 +185,80 @@ void GraphicsPSO::SetInputLayout( UINT NumElements, const D3D12_INPUT_ELEMENT_DE
 }
 
 void GraphicsPSO::Finalize()
+{
+    Finalize(false);
+}
+
+void GraphicsPSO::FinalizeAsync()
+{
+    Finalize(true);
+}
+
+void GraphicsPSO::Finalize( bool RunAsync )
 {
     // Make sure the root signature is finalized first
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     ASSERT(m_PSODesc.pRootSignature != nullptr);
 
+    // The cache key is the description (minus the input layout pointer) followed by the input elements
+    const size_t DescSize = sizeof(m_PSODesc);
+    const size_t LayoutSize = sizeof(D3D12_INPUT_ELEMENT_DESC) * m_PSODesc.InputLayout.NumElements;
+    vector<uint8_t> Key(DescSize + LayoutSize);
+
     m_PSODesc.InputLayout.pInputElementDescs = nullptr;
     size_t HashCode = Utility::HashState(&m_PSODesc);
     HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
+    memcpy(Key.data(), &m_PSODesc, DescSize);
+    if (LayoutSize > 0)
+        memcpy(Key.data() + DescSize, m_InputLayouts.get(), LayoutSize);
     m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
+    // Capture the description by value so this object may be edited while a worker compiles it
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc = m_PSODesc;
+    shared_ptr<const D3D12_INPUT_ELEMENT_DESC> InputLayouts = m_InputLayouts;
+    size_t RootSignatureHash = m_RootSignature->GetHash();
+
+    auto Future = s_GraphicsPSOCache.FindOrCompile(HashCode, Key.data(), Key.size(), [Desc, InputLayouts, RootSignatureHash]()
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_GraphicsPSOHashMap.find(HashCode);
+        ComPtr<ID3D12PipelineState> NewPSO;
+
+        // Stream output declarations aren't worth flattening into a disk key; they are never cached
+        const bool Persist = Desc.StreamOutput.NumEntries == 0;
+        const uint64_t PersistentKey = Persist ? GetPersistentKey(Desc, RootSignatureHash) : 0;
 
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_GraphicsPSOHashMap.end())
+        const void* CachedBlob;
+        size_t CachedBlobSize;
+        if (Persist && s_PipelineCacheFile.Find(PersistentKey, CachedBlob, CachedBlobSize))
         {
-            firstCompile = true;
-            PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
+            // The driver rejects blobs it can't use, in which case we fall back to a full compile
+            D3D12_GRAPHICS_PIPELINE_STATE_DESC CachedDesc = Desc;
+            CachedDesc.CachedPSO.pCachedBlob = CachedBlob;
+            CachedDesc.CachedPSO.CachedBlobSizeInBytes = CachedBlobSize;
+            if (SUCCEEDED(g_Device->CreateGraphicsPipelineState(&CachedDesc, MY_IID_PPV_ARGS(&NewPSO))))
+                return NewPSO;
         }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        ASSERT_SUCCEEDED( g_Device->CreateGraphicsPipelineState(&Desc, MY_IID_PPV_ARGS(&NewPSO)) );
+        if (Persist)
+            StoreCachedBlob(PersistentKey, NewPSO.Get());
+        return NewPSO;
+    }, RunAsync);
+
+    m_PSOFuture = Future;
+    m_PSO = RunAsync ? nullptr : Future.get().Get();
 }
 
 void ComputePSO::Finalize()
+{
+    Finalize(false);
+}
+
+void ComputePSO::FinalizeAsync()
+{
+    Finalize(true);
+}
+
+void ComputePSO::Finalize( bool RunAsync )
 {
     // Make sure the root signature is finalized first
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
@@ -155,34 +266,32 @@ void ComputePSO::Finalize()
 
     size_t HashCode = Utility::HashState(&m_PSODesc);
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = false;
+    D3D12_COMPUTE_PIPELINE_STATE_DESC Desc = m_PSODesc;
+    size_t RootSignatureHash = m_RootSignature->GetHash();
+
+    auto Future = s_ComputePSOCache.FindOrCompile(HashCode, &m_PSODesc, sizeof(m_PSODesc), [Desc, RootSignatureHash]()
     {
-        static mutex s_HashMapMutex;
-        lock_guard<mutex> CS(s_HashMapMutex);
-        auto iter = s_ComputePSOHashMap.find(HashCode);
+        ComPtr<ID3D12PipelineState> NewPSO;
+        const uint64_t PersistentKey = GetPersistentKey(Desc, RootSignatureHash);
 
-        // Reserve space so the next inquiry will find that someone got here first.
-        if (iter == s_ComputePSOHashMap.end())
+        const void* CachedBlob;
+        size_t CachedBlobSize;
+        if (s_PipelineCacheFile.Find(PersistentKey, CachedBlob, CachedBlobSize))
         {
-            firstCompile = true;
-            PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
+            D3D12_COMPUTE_PIPELINE_STATE_DESC CachedDesc = Desc;
+            CachedDesc.CachedPSO.pCachedBlob = CachedBlob;
+            CachedDesc.CachedPSO.CachedBlobSizeInBytes = CachedBlobSize;
+            if (SUCCEEDED(g_Device->CreateComputePipelineState(&CachedDesc, MY_IID_PPV_ARGS(&NewPSO))))
+                return NewPSO;
         }
-        else
-            PSORef = iter->second.GetAddressOf();
-    }
 
-    if (firstCompile)
-    {
-        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&m_PSODesc, MY_IID_PPV_ARGS(&m_PSO)) );
-        s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-    }
-    else
-    {
-        while (*PSORef == nullptr)
-            this_thread::yield();
-        m_PSO = *PSORef;
-    }
+        ASSERT_SUCCEEDED( g_Device->CreateComputePipelineState(&Desc, MY_IID_PPV_ARGS(&NewPSO)) );
+        StoreCachedBlob(PersistentKey, NewPSO.Get());
+        return NewPSO;
+    }, RunAsync);
+
+    m_PSOFuture = Future;
+    m_PSO = RunAsync ? nullptr : Future.get().Get();
 }
 
 ComputePSO::ComputePSO()
@@ -14,6 +14,8 @@
 #pragma once
 
 #include "pch.h"
+#include <atomic>
+#include <future>
 
 class CommandContext;
 class RootSignature;
@@ -28,10 +30,26 @@ class PSO
 {
 public:
 
-    PSO() : m_RootSignature(nullptr) {}
+    PSO() : m_RootSignature(nullptr), m_PSO(nullptr) {}
+
+    PSO( const PSO& Other )
+        : m_RootSignature(Other.m_RootSignature), m_PSO(Other.m_PSO.load()), m_PSOFuture(Other.m_PSOFuture) {}
+
+    PSO& operator=( const PSO& Other )
+    {
+        m_RootSignature = Other.m_RootSignature;
+        m_PSO = Other.m_PSO.load();
+        m_PSOFuture = Other.m_PSOFuture;
+        return *this;
+    }
 
     static void DestroyAll( void );
 
+    // Driver-compiled pipelines are persisted between runs.  The tag identifies the adapter and
+    // driver; a file written with a different tag is ignored and rebuilt.
+    static void LoadPipelineCache( const std::wstring& FileName, uint64_t CompatibilityTag );
+    static void SavePipelineCache( void );
+
     void SetRootSignature( const RootSignature& BindMappings )
     {
         m_RootSignature = &BindMappings;
@@ -43,13 +61,33 @@ public:
         return *m_RootSignature;
     }
 
-    ID3D12PipelineState* GetPipelineStateObject( void ) const { return m_PSO; }
+    // Blocks if the pipeline is still being compiled by FinalizeAsync().  Any number of threads may
+    // record with the same PSO; whichever gets the result first publishes it for the rest.
+    ID3D12PipelineState* GetPipelineStateObject( void ) const
+    {
+        ID3D12PipelineState* PipelineState = m_PSO.load(std::memory_order_acquire);
+        if (PipelineState == nullptr && m_PSOFuture.valid())
+        {
+            PipelineState = m_PSOFuture.get().Get();
+            m_PSO.store(PipelineState, std::memory_order_release);
+        }
+        return PipelineState;
+    }
+
+    // True once the pipeline can be bound without waiting
+    bool IsReady( void ) const
+    {
+        return m_PSO.load(std::memory_order_acquire) != nullptr || (m_PSOFuture.valid() &&
+            m_PSOFuture.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    }
 
 protected:
 
     const RootSignature* m_RootSignature;
 
-    ID3D12PipelineState* m_PSO;
+    // Written by Finalize(), or by the first GetPipelineStateObject() after FinalizeAsync()
+    mutable std::atomic<ID3D12PipelineState*> m_PSO;
+    std::shared_future<Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_PSOFuture;
 };
 
 class GraphicsPSO : public PSO
@@ -87,8 +125,15 @@ public:
     // Perform validation and compute a hash value for fast state block comparisons
     void Finalize();
 
+    // Same as Finalize(), but compilation of a new pipeline happens on a worker thread.  Use this at
+    // load time to overlap PSO creation; GetPipelineStateObject() waits for the result.
+    void FinalizeAsync();
+
 private:
 
+    void Finalize( bool RunAsync );
+
+
     D3D12_GRAPHICS_PIPELINE_STATE_DESC m_PSODesc;
     std::shared_ptr<const D3D12_INPUT_ELEMENT_DESC> m_InputLayouts;
 };
@@ -105,8 +150,11 @@ public:
     void SetComputeShader( const D3D12_SHADER_BYTECODE& Binary ) { m_PSODesc.CS = Binary; }
 
     void Finalize();
+    void FinalizeAsync();
 
 private:
 
+    void Finalize( bool RunAsync );
+
     D3D12_COMPUTE_PIPELINE_STATE_DESC m_PSODesc;
 };
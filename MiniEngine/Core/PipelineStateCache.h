@@ -0,0 +1,155 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// A concurrent cache of compiled pipeline state.  Entries are found by hash and then confirmed by
+// comparing the full key bytes, so two descriptions that happen to hash alike never share a pipeline.
+//
+// The first thread to ask for a key inserts a shared_future and compiles, either on its own thread or
+// as a job handed to the scheduler the cache was constructed with.  Everyone else that asks for the
+// same key gets that future and blocks on it only when they actually need the result.  The table is split into independently locked shards, and the locks
+// are held only long enough to find or insert an entry, never during compilation.
+//
+// The cache knows nothing about D3D or the engine's task system.  ValueType is whatever the compile
+// callback produces.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+template <typename ValueType>
+class PipelineStateCache
+{
+public:
+
+    typedef std::function<ValueType (void)> CompileFunction;
+    typedef std::shared_future<ValueType> FutureType;
+
+    // Runs a job on a worker thread
+    typedef std::function<void (std::function<void (void)>)> ScheduleFunction;
+
+    struct Statistics
+    {
+        size_t Hits;
+        size_t Misses;
+        size_t HashCollisions;
+    };
+
+    // Without a scheduler, compilations requested with RunAsync run on the calling thread
+    explicit PipelineStateCache( ScheduleFunction Schedule = ScheduleFunction() )
+        : m_Schedule(Schedule), m_Hits(0), m_Misses(0), m_HashCollisions(0) {}
+    ~PipelineStateCache() { Clear(); }
+
+    // Returns the (possibly still compiling) result for the key.  When the key is new, Compile runs
+    // on the calling thread, or is scheduled on a worker when RunAsync is set.  Compile must not
+    // reenter the cache with the same key.  An exception it throws is rethrown by the future.
+    FutureType FindOrCompile( size_t Hash, const void* Key, size_t KeySize, const CompileFunction& Compile, bool RunAsync = false )
+    {
+        Shard& shard = m_Shards[Hash % kNumShards];
+        std::shared_ptr<std::promise<ValueType>> Promise;
+        FutureType Future;
+
+        {
+            std::lock_guard<std::mutex> LockGuard(shard.Mutex);
+
+            auto Range = shard.Entries.equal_range(Hash);
+            for (auto Iter = Range.first; Iter != Range.second; ++Iter)
+            {
+                const std::vector<uint8_t>& EntryKey = Iter->second.Key;
+                if (EntryKey.size() == KeySize && memcmp(EntryKey.data(), Key, KeySize) == 0)
+                {
+                    ++m_Hits;
+                    return Iter->second.Future;
+                }
+            }
+
+            if (Range.first != Range.second)
+                ++m_HashCollisions;
+            ++m_Misses;
+
+            Entry NewEntry;
+            NewEntry.Key.assign((const uint8_t*)Key, (const uint8_t*)Key + KeySize);
+
+            // Publish the future before compiling so that later requests wait on it
+            Promise = std::make_shared<std::promise<ValueType>>();
+            NewEntry.Future = Promise->get_future().share();
+            Future = NewEntry.Future;
+            shard.Entries.emplace(Hash, std::move(NewEntry));
+        }
+
+        if (RunAsync && m_Schedule)
+            m_Schedule([Promise, Compile]() { Fulfill(*Promise, Compile); });
+        else
+            Fulfill(*Promise, Compile);
+
+        return Future;
+    }
+
+    // Waits for outstanding compilations and drops every entry
+    void Clear( void )
+    {
+        for (uint32_t i = 0; i < kNumShards; ++i)
+        {
+            std::lock_guard<std::mutex> LockGuard(m_Shards[i].Mutex);
+            for (auto Iter = m_Shards[i].Entries.begin(); Iter != m_Shards[i].Entries.end(); ++Iter)
+                Iter->second.Future.wait();
+            m_Shards[i].Entries.clear();
+        }
+    }
+
+    Statistics GetStatistics( void ) const
+    {
+        Statistics Stats = { m_Hits, m_Misses, m_HashCollisions };
+        return Stats;
+    }
+
+private:
+
+    static const uint32_t kNumShards = 16;
+
+    static void Fulfill( std::promise<ValueType>& Promise, const CompileFunction& Compile )
+    {
+        try
+        {
+            Promise.set_value(Compile());
+        }
+        catch (...)
+        {
+            Promise.set_exception(std::current_exception());
+        }
+    }
+
+    struct Entry
+    {
+        std::vector<uint8_t> Key;
+        FutureType Future;
+    };
+
+    struct Shard
+    {
+        std::mutex Mutex;
+        std::unordered_multimap<size_t, Entry> Entries;
+    };
+
+    ScheduleFunction m_Schedule;
+    Shard m_Shards[kNumShards];
+
+    std::atomic<size_t> m_Hits;
+    std::atomic<size_t> m_Misses;
+    std::atomic<size_t> m_HashCollisions;
+};
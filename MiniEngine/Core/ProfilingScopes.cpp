@@ -0,0 +1,352 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "ProfilingScopes.h"
+#include "SystemTime.h"
+#include "GpuTimeManager.h"
+#include "CommandContext.h"
+#include <atomic>
+#include <mutex>
+#include <intrin.h>
+
+using namespace std;
+using namespace ProfilingScopes;
+
+namespace
+{
+    inline int64_t ReadClock( void )
+    {
+#if PROFILING_USE_RDTSC
+        return (int64_t)__rdtsc();
+#else
+        return SystemTime::GetCurrentTick();
+#endif
+    }
+
+    // A clock reading and the SystemTime tick taken at the same moment
+    struct ClockSample
+    {
+        int64_t Raw;
+        int64_t Tick;
+    };
+
+    ClockSample SampleClock( void )
+    {
+        ClockSample Sample;
+#if PROFILING_USE_RDTSC
+        int64_t Before = ReadClock();
+        Sample.Tick = SystemTime::GetCurrentTick();
+        int64_t After = ReadClock();
+        Sample.Raw = Before + (After - Before) / 2;
+#else
+        Sample.Tick = SystemTime::GetCurrentTick();
+        Sample.Raw = Sample.Tick;
+#endif
+        return Sample;
+    }
+
+    // Taken before the first scope opens.  The rate of the clock is measured from here, so it gets more
+    // accurate the longer the engine runs.
+    const ClockSample& GetClockBase( void )
+    {
+        static const ClockSample s_Base = SampleClock();
+        return s_Base;
+    }
+
+    struct ThreadNode : public Node
+    {
+        uint32_t Hash;
+        uint32_t GpuTimerIdx;
+        vector<unique_ptr<ThreadNode>> Children;
+
+        ThreadNode* GetChild( const wchar_t* ChildName )
+        {
+            // FNV-1a, so that names are compared without building a wstring
+            uint32_t ChildHash = 2166136261u;
+            for (const wchar_t* c = ChildName; *c != 0; ++c)
+                ChildHash = (ChildHash ^ (uint32_t)*c) * 16777619u;
+
+            for (auto& Child : Children)
+            {
+                if (Child->Hash == ChildHash && Child->Name == ChildName)
+                    return Child.get();
+            }
+
+            ThreadNode* Child = new ThreadNode;
+            Child->Name = ChildName;
+            Child->Parent = this;
+            Child->Depth = (uint16_t)(Depth + 1);
+            Child->UserData = nullptr;
+            Child->Hash = ChildHash;
+            Child->GpuTimerIdx = 0;
+            Children.emplace_back(Child);
+            return Child;
+        }
+    };
+
+    struct Record
+    {
+        const ThreadNode* Scope;
+        int64_t Begin;
+        int64_t End;
+        uint32_t GpuTimerIdx;
+    };
+
+    struct OpenScope
+    {
+        ThreadNode* Scope;
+        int64_t Begin;
+        bool OnContext;
+    };
+
+    class ThreadScopes
+    {
+    public:
+        static const uint32_t kRingSize = 8192;
+        static const uint32_t kMaxDepth = 64;
+
+        ThreadScopes() : m_Head(0), m_Tail(0), m_Dropped(0), m_Depth(0), m_Overflow(0)
+        {
+            m_Root.Parent = nullptr;
+            m_Root.Depth = 0;
+            m_Root.UserData = nullptr;
+            m_Root.Hash = 0;
+            m_Root.GpuTimerIdx = 0;
+            m_Current = &m_Root;
+            m_ThreadId = GetCurrentThreadId();
+            m_Ring.reset(new Record[kRingSize]);
+        }
+
+        void Push( const wchar_t* Name, CommandContext* Context )
+        {
+            if (m_Depth == kMaxDepth)
+            {
+                ++m_Overflow;
+                return;
+            }
+
+            ThreadNode* Scope = m_Current->GetChild(Name);
+            m_Current = Scope;
+
+            OpenScope& Open = m_Stack[m_Depth++];
+            Open.Scope = Scope;
+            Open.OnContext = Context != nullptr;
+
+            if (Context != nullptr)
+            {
+                // NewTimer() returns zero once the query heap is full, and the scope is then only timed on the CPU
+                if (Scope->GpuTimerIdx == 0)
+                    Scope->GpuTimerIdx = GpuTimeManager::NewTimer();
+                if (Scope->GpuTimerIdx != 0)
+                    GpuTimeManager::StartTimer(*Context, Scope->GpuTimerIdx);
+                Context->PIXBeginEvent(Name);
+            }
+
+            // Last, so that none of the above is timed
+            Open.Begin = ReadClock();
+        }
+
+        void Pop( CommandContext* Context )
+        {
+            const int64_t End = ReadClock();
+
+            if (m_Overflow > 0)
+            {
+                --m_Overflow;
+                Drop();
+                return;
+            }
+
+            // Opened on another thread
+            if (m_Depth == 0)
+                return;
+
+            const OpenScope& Open = m_Stack[--m_Depth];
+            m_Current = (ThreadNode*)Open.Scope->Parent;
+
+            const bool OnContext = Open.OnContext && Context != nullptr;
+            const bool TimedOnGpu = OnContext && Open.Scope->GpuTimerIdx != 0;
+            if (TimedOnGpu)
+                GpuTimeManager::StopTimer(*Context, Open.Scope->GpuTimerIdx);
+            if (OnContext)
+                Context->PIXEndEvent();
+
+            const uint64_t Head = m_Head.load(memory_order_relaxed);
+            if (Head - m_Tail.load(memory_order_acquire) == kRingSize)
+            {
+                Drop();
+                return;
+            }
+
+            Record& Dest = m_Ring[Head & (kRingSize - 1)];
+            Dest.Scope = Open.Scope;
+            Dest.Begin = Open.Begin;
+            Dest.End = End;
+            Dest.GpuTimerIdx = TimedOnGpu ? Open.Scope->GpuTimerIdx : 0;
+            m_Head.store(Head + 1, memory_order_release);
+        }
+
+        // Only one thread may drain a ring
+        template <typename Func>
+        void Drain( Func Consume )
+        {
+            const uint64_t Head = m_Head.load(memory_order_acquire);
+            uint64_t Tail = m_Tail.load(memory_order_relaxed);
+
+            for (; Tail < Head; ++Tail)
+                Consume(m_Ring[Tail & (kRingSize - 1)], m_ThreadId);
+
+            m_Tail.store(Tail, memory_order_release);
+        }
+
+        uint64_t GetRecorded( void ) const { return m_Head.load(memory_order_relaxed); }
+        uint64_t GetDropped( void ) const { return m_Dropped.load(memory_order_relaxed); }
+
+    private:
+        // Only the owning thread writes the count, so it needs no read-modify-write
+        void Drop( void )
+        {
+            m_Dropped.store(m_Dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+        }
+
+        unique_ptr<Record[]> m_Ring;
+        atomic<uint64_t> m_Head;
+        atomic<uint64_t> m_Tail;
+        atomic<uint64_t> m_Dropped;
+
+        ThreadNode m_Root;
+        ThreadNode* m_Current;
+        OpenScope m_Stack[kMaxDepth];
+        uint32_t m_Depth;
+        uint32_t m_Overflow;
+        uint32_t m_ThreadId;
+    };
+
+    // Threads register the first time they open a scope.  Their scopes outlive them, because the timing tree
+    // keeps pointers to their nodes.
+    struct ThreadList
+    {
+        mutex Mutex;
+        vector<unique_ptr<ThreadScopes>> Threads;
+    };
+
+    ThreadList& GetThreadList( void )
+    {
+        static ThreadList s_List;
+        return s_List;
+    }
+
+    thread_local ThreadScopes* t_Scopes = nullptr;
+
+    ThreadScopes& GetThreadScopes( void )
+    {
+        if (t_Scopes == nullptr)
+        {
+            GetClockBase();
+
+            ThreadList& List = GetThreadList();
+            lock_guard<mutex> Guard(List.Mutex);
+            List.Threads.emplace_back(new ThreadScopes);
+            t_Scopes = List.Threads.back().get();
+        }
+
+        return *t_Scopes;
+    }
+}
+
+void ProfilingScopes::Push( const wchar_t* Name, CommandContext* Context )
+{
+    GetThreadScopes().Push(Name, Context);
+}
+
+void ProfilingScopes::Pop( CommandContext* Context )
+{
+    GetThreadScopes().Pop(Context);
+}
+
+void ProfilingScopes::Drain( vector<Sample>& Samples )
+{
+    // Convert clock readings with the rate measured since the base sample, relative to the present so that
+    // rounding errors don't accumulate
+    const ClockSample& Base = GetClockBase();
+    const ClockSample Now = SampleClock();
+    const double TicksPerRaw = Now.Raw > Base.Raw ? (double)(Now.Tick - Base.Tick) / (double)(Now.Raw - Base.Raw) : 1.0;
+
+    auto Consume = [&]( const Record& Src, uint32_t ThreadId )
+    {
+        Sample NewSample;
+        NewSample.Scope = Src.Scope;
+        NewSample.Begin = Now.Tick + (int64_t)((double)(Src.Begin - Now.Raw) * TicksPerRaw);
+        NewSample.End = Now.Tick + (int64_t)((double)(Src.End - Now.Raw) * TicksPerRaw);
+        NewSample.ThreadId = ThreadId;
+        NewSample.GpuTimerIdx = Src.GpuTimerIdx;
+        Samples.push_back(NewSample);
+    };
+
+    ThreadList& List = GetThreadList();
+    lock_guard<mutex> Guard(List.Mutex);
+    for (auto& Thread : List.Threads)
+        Thread->Drain(Consume);
+}
+
+Statistics ProfilingScopes::GetStatistics( void )
+{
+    Statistics Stats = {};
+
+    ThreadList& List = GetThreadList();
+    lock_guard<mutex> Guard(List.Mutex);
+    for (auto& Thread : List.Threads)
+    {
+        Stats.Recorded += Thread->GetRecorded();
+        Stats.Dropped += Thread->GetDropped();
+    }
+    Stats.NumThreads = (uint32_t)List.Threads.size();
+
+    return Stats;
+}
+
+void ProfilingScopes::MeasureOverhead( uint32_t Iterations, double& NanosecsPerScope, double& NanosecsPerClockRead )
+{
+    Iterations = max(Iterations, 1u);
+
+    // Not registered, so nothing it records reaches the timing tree
+    unique_ptr<ThreadScopes> Scopes(new ThreadScopes);
+    auto Discard = []( const Record&, uint32_t ) {};
+
+    // Creates the nodes, which only happens once per scope
+    Scopes->Push(L"Outer", nullptr);
+    Scopes->Push(L"Inner", nullptr);
+    Scopes->Pop(nullptr);
+    Scopes->Pop(nullptr);
+
+    int64_t Start = SystemTime::GetCurrentTick();
+    for (uint32_t i = 0; i < Iterations; ++i)
+    {
+        Scopes->Push(L"Outer", nullptr);
+        Scopes->Push(L"Inner", nullptr);
+        Scopes->Pop(nullptr);
+        Scopes->Pop(nullptr);
+
+        if ((i & 1023) == 1023)
+            Scopes->Drain(Discard);
+    }
+    int64_t Stop = SystemTime::GetCurrentTick();
+    NanosecsPerScope = SystemTime::TimeBetweenTicks(Start, Stop) * 1e9 / (2.0 * Iterations);
+
+    volatile int64_t Sink = 0;
+    Start = SystemTime::GetCurrentTick();
+    for (uint32_t i = 0; i < Iterations; ++i)
+        Sink = ReadClock();
+    Stop = SystemTime::GetCurrentTick();
+    (void)Sink;
+    NanosecsPerClockRead = SystemTime::TimeBetweenTicks(Start, Stop) * 1e9 / Iterations;
+}
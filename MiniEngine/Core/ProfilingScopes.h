@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Per-thread stacks of profiling scopes.  Every thread that opens a scope gets its own stack and
+// its own copy of the scope tree, so worker threads recording command contexts in parallel never share state
+// and never take a lock.  A scope must be closed on the thread that opened it.
+//
+// Closed scopes go into a single-producer, single-consumer ring buffer per thread.  EngineProfiling drains
+// all of them once a frame and merges the samples into its timing tree.
+//
+// Scopes are timed with rdtsc when PROFILING_USE_RDTSC is set, which costs a few nanoseconds rather than the
+// tens that QueryPerformanceCounter() can take.  The ticks are converted to SystemTime ticks when drained.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifndef PROFILING_USE_RDTSC
+#define PROFILING_USE_RDTSC 1
+#endif
+
+class CommandContext;
+
+namespace ProfilingScopes
+{
+    // A scope in a thread's tree.  The root of each tree has no parent and an empty name.
+    struct Node
+    {
+        std::wstring Name;
+        const Node* Parent;
+        uint16_t Depth;
+        mutable void* UserData;     // For the thread that calls Drain()
+    };
+
+    struct Sample
+    {
+        const Node* Scope;
+        int64_t Begin;              // SystemTime ticks
+        int64_t End;
+        uint32_t ThreadId;
+        uint32_t GpuTimerIdx;       // Zero unless the scope was timed on a command context
+    };
+
+    struct Statistics
+    {
+        uint32_t NumThreads;
+        uint64_t Recorded;
+        uint64_t Dropped;           // Because a thread's ring buffer was full, or its stack too deep
+    };
+
+    // With a command context, the scope is also timed on the GPU and marked with a PIX event.  Once every
+    // GPU timer is taken, scopes that have none are only timed on the CPU.
+    void Push( const wchar_t* Name, CommandContext* Context = nullptr );
+    void Pop( CommandContext* Context = nullptr );
+
+    // Appends the samples closed since the last call, from every thread.  Call from one thread only.
+    void Drain( std::vector<Sample>& Samples );
+
+    Statistics GetStatistics( void );
+
+    // Times Iterations pairs of nested scopes on a private stack and returns the cost of one Push() and Pop()
+    // in nanoseconds, and that of reading the clock alone
+    void MeasureOverhead( uint32_t Iterations, double& NanosecsPerScope, double& NanosecsPerClockRead );
+}
@@ -0,0 +1,103 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Estimates quantiles of a stream of positive values in fixed memory.  Values are counted in
+// buckets whose bounds grow geometrically, as in DDSketch, so every estimate is within 1% of a value that was
+// recorded.  With times in milliseconds, that holds from one microsecond to over ten minutes.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+class QuantileSketch
+{
+public:
+    QuantileSketch() { Reset(); }
+
+    void Reset( void )
+    {
+        memset(m_Counts, 0, sizeof(m_Counts));
+        m_Count = 0;
+        m_Sum = 0.0;
+        m_Minimum = FLT_MAX;
+        m_Maximum = 0.0f;
+    }
+
+    // Zero and negative values are ignored, as StatHistory uses them to mean "not timed"
+    void Add( float Value )
+    {
+        if (!(Value > 0.0f))
+            return;
+
+        ++m_Counts[GetBucket(Value)];
+        ++m_Count;
+        m_Sum += Value;
+        m_Minimum = Value < m_Minimum ? Value : m_Minimum;
+        m_Maximum = Value > m_Maximum ? Value : m_Maximum;
+    }
+
+    // Q is in [0, 1]
+    float GetQuantile( float Q ) const
+    {
+        if (m_Count == 0)
+            return 0.0f;
+
+        const uint64_t Rank = (uint64_t)((double)Q * (double)(m_Count - 1) + 0.5);
+        uint64_t Total = 0;
+        uint32_t Bucket = 0;
+        for (; Bucket < kNumBuckets - 1; ++Bucket)
+        {
+            Total += m_Counts[Bucket];
+            if (Total > Rank)
+                break;
+        }
+
+        // The bucket's midpoint in relative terms, which is within the relative error of every value in it
+        float Value = (float)(kMinValue * 2.0 * exp(kLogGamma * Bucket) / (kGamma + 1.0));
+        Value = Value < m_Minimum ? m_Minimum : Value;
+        return Value > m_Maximum ? m_Maximum : Value;
+    }
+
+    uint64_t GetCount( void ) const { return m_Count; }
+    float GetAverage( void ) const { return m_Count == 0 ? 0.0f : (float)(m_Sum / m_Count); }
+    float GetMinimum( void ) const { return m_Count == 0 ? 0.0f : m_Minimum; }
+    float GetMaximum( void ) const { return m_Maximum; }
+
+private:
+    static const uint32_t kNumBuckets = 1024;
+
+    // Gamma is (1 + a) / (1 - a) for a relative error a of 1%
+    static const double kMinValue;
+    static const double kGamma;
+    static const double kLogGamma;
+
+    static uint32_t GetBucket( float Value )
+    {
+        if (Value <= kMinValue)
+            return 0;
+
+        const double Bucket = ceil(log(Value / kMinValue) / kLogGamma);
+        return Bucket < kNumBuckets - 1 ? (uint32_t)Bucket : kNumBuckets - 1;
+    }
+
+    uint32_t m_Counts[kNumBuckets];
+    uint64_t m_Count;
+    double m_Sum;
+    float m_Minimum;
+    float m_Maximum;
+};
+
+__declspec(selectany) const double QuantileSketch::kMinValue = 0.001;
+__declspec(selectany) const double QuantileSketch::kGamma = 1.01 / 0.99;
+__declspec(selectany) const double QuantileSketch::kLogGamma = 0.020000666706669;     // log(kGamma)
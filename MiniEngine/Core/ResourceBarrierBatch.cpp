@@ -0,0 +1,170 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "ResourceBarrierBatch.h"
+
+using namespace std;
+
+namespace
+{
+    bool TouchesResource( const D3D12_RESOURCE_BARRIER& Barrier, ID3D12Resource* Resource )
+    {
+        switch (Barrier.Type)
+        {
+        case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+            return Barrier.Transition.pResource == Resource;
+        case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+            return Barrier.UAV.pResource == Resource || Barrier.UAV.pResource == nullptr;
+        default:
+            // A null aliasing resource means "any placed resource"
+            return Barrier.Aliasing.pResourceBefore == Resource || Barrier.Aliasing.pResourceAfter == Resource ||
+                Barrier.Aliasing.pResourceBefore == nullptr || Barrier.Aliasing.pResourceAfter == nullptr;
+        }
+    }
+}
+
+ResourceBarrierBatch::ResourceBarrierBatch() : m_Optimize(true)
+{
+    m_Barriers.reserve(16);
+    ResetStatistics();
+}
+
+void ResourceBarrierBatch::AddTransition( ID3D12Resource* Resource, UINT Subresource, D3D12_RESOURCE_STATES Before,
+    D3D12_RESOURCE_STATES After, D3D12_RESOURCE_BARRIER_FLAGS Flags )
+{
+    ++m_Stats.Requested;
+
+    // Only the most recent barrier touching this resource may be rewritten.  Anything earlier would
+    // reorder the new transition across it.
+    for (size_t i = m_Barriers.size(); m_Optimize && i-- > 0; )
+    {
+        D3D12_RESOURCE_BARRIER& Prior = m_Barriers[i];
+        if (!TouchesResource(Prior, Resource))
+            continue;
+
+        if (Prior.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION || Prior.Transition.Subresource != Subresource)
+            break;
+
+        if (Prior.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE && Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE)
+        {
+            ASSERT(Prior.Transition.StateAfter == Before, "Transition does not start where the previous one ended");
+            ++m_Stats.Merged;
+            Prior.Transition.StateAfter = After;
+            if (Prior.Transition.StateBefore == After)
+            {
+                // Unordered access before and after the pair still has to be ordered, which the round trip
+                // did.  A UAV barrier on the resource does that much more cheaply.
+                if (((Before | After) & D3D12_RESOURCE_STATE_UNORDERED_ACCESS) != 0)
+                {
+                    Prior.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+                    Prior.UAV.pResource = Resource;
+                }
+                else
+                {
+                    ++m_Stats.Elided;
+                    m_Barriers.erase(m_Barriers.begin() + i);
+                }
+            }
+            return;
+        }
+
+        if (Prior.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY && Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+        {
+            ASSERT(Prior.Transition.StateBefore == Before && Prior.Transition.StateAfter == After);
+            ++m_Stats.SplitsCollapsed;
+            Prior.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+            return;
+        }
+
+        break;
+    }
+
+    D3D12_RESOURCE_BARRIER Barrier;
+    Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+    Barrier.Flags = Flags;
+    Barrier.Transition.pResource = Resource;
+    Barrier.Transition.Subresource = Subresource;
+    Barrier.Transition.StateBefore = Before;
+    Barrier.Transition.StateAfter = After;
+    m_Barriers.push_back(Barrier);
+}
+
+void ResourceBarrierBatch::AddUAV( ID3D12Resource* Resource )
+{
+    ++m_Stats.Requested;
+
+    for (size_t i = m_Barriers.size(); m_Optimize && i-- > 0; )
+    {
+        const D3D12_RESOURCE_BARRIER& Prior = m_Barriers[i];
+        if (!TouchesResource(Prior, Resource) && Prior.Type != D3D12_RESOURCE_BARRIER_TYPE_UAV)
+            continue;
+
+        bool Redundant = false;
+        if (Prior.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV)
+        {
+            // A null UAV barrier covers every resource; a specific one only covers itself
+            if (Prior.UAV.pResource != nullptr && Prior.UAV.pResource != Resource)
+                continue;
+            Redundant = true;
+        }
+        else if (Prior.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+        {
+            Redundant = Prior.Transition.StateAfter == D3D12_RESOURCE_STATE_UNORDERED_ACCESS &&
+                Prior.Flags != D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+        }
+
+        if (Redundant)
+        {
+            ++m_Stats.Elided;
+            return;
+        }
+        break;
+    }
+
+    D3D12_RESOURCE_BARRIER Barrier;
+    Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+    Barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    Barrier.UAV.pResource = Resource;
+    m_Barriers.push_back(Barrier);
+}
+
+void ResourceBarrierBatch::AddAliasing( ID3D12Resource* Before, ID3D12Resource* After )
+{
+    ++m_Stats.Requested;
+
+    D3D12_RESOURCE_BARRIER Barrier;
+    Barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_ALIASING;
+    Barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+    Barrier.Aliasing.pResourceBefore = Before;
+    Barrier.Aliasing.pResourceAfter = After;
+    m_Barriers.push_back(Barrier);
+}
+
+void ResourceBarrierBatch::Clear( void )
+{
+    if (!m_Barriers.empty())
+    {
+        m_Stats.Emitted += m_Barriers.size();
+        ++m_Stats.Batches;
+    }
+    m_Barriers.clear();
+}
+
+void ResourceBarrierBatch::ResetStatistics( void )
+{
+    m_Stats.Requested = 0;
+    m_Stats.Emitted = 0;
+    m_Stats.Merged = 0;
+    m_Stats.Elided = 0;
+    m_Stats.SplitsCollapsed = 0;
+    m_Stats.Batches = 0;
+}
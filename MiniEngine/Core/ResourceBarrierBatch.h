@@ -0,0 +1,74 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  The resource barriers a command context has requested but not yet recorded.  No
+// commands are recorded between two barriers of the same batch, so the batch is free to rewrite it:
+//
+//   * Consecutive transitions of one subresource are merged (A->B, B->C becomes A->C), and a transition
+//     that returns a subresource to where it started (A->B, B->A) is dropped.  When either state is
+//     UNORDERED_ACCESS it becomes a UAV barrier instead, so accesses either side stay ordered.
+//   * A split barrier whose BEGIN_ONLY and END_ONLY halves land in the same batch overlapped no work,
+//     so it is collapsed into one ordinary transition.  Split barriers are only emitted when work was
+//     recorded between the two halves.
+//   * A UAV barrier is dropped when the batch already holds one for the same resource, or a transition
+//     of that resource into the UAV state (which already waits on all prior access).
+//
+// Transitions are keyed by resource and subresource.  A whole-resource transition and a transition of
+// one of its subresources are never merged; both are kept in the order requested.  State itself is
+// tracked by the caller (GpuResource, for the whole resource) and split barriers are begun by the
+// caller too, since only it knows how much work will be recorded before the state is needed.
+//
+// The batch only builds the array handed to ResourceBarrier(), so it can be driven without a device.
+//
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+class ResourceBarrierBatch
+{
+public:
+    struct Statistics
+    {
+        uint64_t Requested;         // Barriers asked for
+        uint64_t Emitted;           // Barriers handed to the command list
+        uint64_t Merged;            // Transitions folded into an earlier one
+        uint64_t Elided;            // Transitions or UAV barriers that turned out to do nothing
+        uint64_t SplitsCollapsed;   // BEGIN_ONLY/END_ONLY pairs that overlapped no work
+        uint64_t Batches;           // Non-empty calls to ResourceBarrier()
+    };
+
+    ResourceBarrierBatch();
+
+    // With optimization off, barriers are recorded exactly as requested
+    void SetOptimize( bool Optimize ) { m_Optimize = Optimize; }
+
+    void AddTransition( ID3D12Resource* Resource, UINT Subresource, D3D12_RESOURCE_STATES Before,
+        D3D12_RESOURCE_STATES After, D3D12_RESOURCE_BARRIER_FLAGS Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE );
+    void AddUAV( ID3D12Resource* Resource );
+    void AddAliasing( ID3D12Resource* Before, ID3D12Resource* After );
+
+    bool IsEmpty( void ) const { return m_Barriers.empty(); }
+    UINT GetNumBarriers( void ) const { return (UINT)m_Barriers.size(); }
+    const D3D12_RESOURCE_BARRIER* GetBarriers( void ) const { return m_Barriers.data(); }
+
+    // Call once the barriers have been recorded
+    void Clear( void );
+
+    const Statistics& GetStatistics( void ) const { return m_Stats; }
+    void ResetStatistics( void );
+
+private:
+
+    bool m_Optimize;
+    std::vector<D3D12_RESOURCE_BARRIER> m_Barriers;
+    Statistics m_Stats;
+};
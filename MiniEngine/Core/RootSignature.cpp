@@ -131,6 +131,8 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
             HashCode = Utility::HashState( &RootParam, 1, HashCode );
     }
 
+    m_Hash = HashCode;
+
     ID3D12RootSignature** RSRef = nullptr;
     bool firstCompile = false;
     {
@@ -15,11 +15,20 @@
 #include "pch.h"
 #include "TextureManager.h"
 #include "FileUtility.h"
+#include "FileSystem.h"
 #include "DDSTextureLoader.h"
 #include "GraphicsCore.h"
 #include "CommandContext.h"
-#include <map>
+#include "TextureStreamingQueue.h"
+#include "BlockCompression.h"
+#include "ImageProcessing.h"
+#include "Hash.h"
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 
 using namespace std;
 using namespace Graphics;
@@ -29,7 +38,7 @@ static UINT BytesPerPixel( DXGI_FORMAT Format )
     return (UINT)BitsPerPixel(Format) / 8;
 };
 
-void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
+void Texture::CreateResource( size_t Width, size_t Height, DXGI_FORMAT Format, uint32_t NumMips, D3D12_SUBRESOURCE_DATA* InitData )
 {
     m_UsageState = D3D12_RESOURCE_STATE_COPY_DEST;
 
@@ -38,7 +47,7 @@ void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT For
     texDesc.Width = Width;
     texDesc.Height = (UINT)Height;
     texDesc.DepthOrArraySize = 1;
-    texDesc.MipLevels = 1;
+    texDesc.MipLevels = (UINT16)NumMips;
     texDesc.Format = Format;
     texDesc.SampleDesc.Count = 1;
     texDesc.SampleDesc.Quality = 0;
@@ -57,19 +66,59 @@ void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT For
 
     m_pResource->SetName(L"Texture");
 
+    CommandContext::InitializeTexture(*this, NumMips, InitData);
+
+    if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_hCpuDescriptorHandle);
+}
+
+void Texture::Create( size_t Pitch, size_t Width, size_t Height, DXGI_FORMAT Format, const void* InitialData )
+{
     D3D12_SUBRESOURCE_DATA texResource;
     texResource.pData = InitialData;
     texResource.RowPitch = Pitch * BytesPerPixel(Format);
     texResource.SlicePitch = texResource.RowPitch * Height;
 
-    CommandContext::InitializeTexture(*this, 1, &texResource);
+    CreateResource(Width, Height, Format, 1, &texResource);
+}
 
-    if (m_hCpuDescriptorHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-        m_hCpuDescriptorHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-    g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_hCpuDescriptorHandle);
+void Texture::CreateMipChain( size_t Width, size_t Height, DXGI_FORMAT Format, uint32_t NumMips, const void* InitData )
+{
+    D3D12_SUBRESOURCE_DATA texResources[D3D12_REQ_MIP_LEVELS];
+    ASSERT(NumMips <= D3D12_REQ_MIP_LEVELS);
+
+    const uint8_t* MipData = (const uint8_t*)InitData;
+    size_t MipWidth = Width, MipHeight = Height;
+
+    for (uint32_t Mip = 0; Mip < NumMips; ++Mip)
+    {
+        texResources[Mip].pData = MipData;
+        texResources[Mip].RowPitch = MipWidth * BytesPerPixel(Format);
+        texResources[Mip].SlicePitch = texResources[Mip].RowPitch * MipHeight;
+
+        MipData += texResources[Mip].SlicePitch;
+        MipWidth = std::max<size_t>(MipWidth / 2, 1);
+        MipHeight = std::max<size_t>(MipHeight / 2, 1);
+    }
+
+    CreateResource(Width, Height, Format, NumMips, texResources);
 }
 
-void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
+namespace TextureManager
+{
+    const char* TGAMipLabels[] = { "None", "Box", "Kaiser" };
+    EnumVar s_TGAMips("Graphics/Textures/TGA Mips", 1, _countof(TGAMipLabels), TGAMipLabels);
+
+    const char* TGACompressionLabels[] = { "Off", "BC1", "BC3", "BC7" };
+    const char* TGACompressionQualityLabels[BlockCompression::kNumQualities] = { "Fast", "Normal", "High" };
+    EnumVar s_TGACompression("Graphics/Textures/TGA Compression", 0, _countof(TGACompressionLabels), TGACompressionLabels);
+    EnumVar s_TGACompressionQuality("Graphics/Textures/TGA Compression Quality", BlockCompression::kNormal,
+        BlockCompression::kNumQualities, TGACompressionQualityLabels);
+}
+
+// Expands a 24 or 32-bit TGA to RGBA8
+static uint32_t* ExpandTGA( const void* _filePtr, uint16_t& imageWidth, uint16_t& imageHeight )
 {
     const uint8_t* filePtr = (const uint8_t*)_filePtr;
 
@@ -81,9 +130,9 @@ void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
     // Ignore another 9 bytes
     filePtr += 9;
 
-    uint16_t imageWidth = *(uint16_t*)filePtr;
+    imageWidth = *(uint16_t*)filePtr;
     filePtr += sizeof(uint16_t);
-    uint16_t imageHeight = *(uint16_t*)filePtr;
+    imageHeight = *(uint16_t*)filePtr;
     filePtr += sizeof(uint16_t);
     uint8_t bitCount = *filePtr++;
 
@@ -91,32 +140,51 @@ void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
     filePtr++;
 
     uint32_t* formattedData = new uint32_t[imageWidth * imageHeight];
-    uint32_t* iter = formattedData;
 
     uint8_t numChannels = bitCount / 8;
-    uint32_t numBytes = imageWidth * imageHeight * numChannels;
 
     switch (numChannels)
     {
     default:
         break;
     case 3:
-        for (uint32_t byteIdx = 0; byteIdx < numBytes; byteIdx += 3)
-        {
-            *iter++ = 0xff000000 | filePtr[0] << 16 | filePtr[1] << 8 | filePtr[2];
-            filePtr += 3;
-        }
+        ImageProcessing::BGRToRGBA(filePtr, (uint8_t*)formattedData, imageWidth * imageHeight);
         break;
     case 4:
-        for (uint32_t byteIdx = 0; byteIdx < numBytes; byteIdx += 4)
-        {
-            *iter++ = filePtr[3] << 24 | filePtr[0] << 16 | filePtr[1] << 8 | filePtr[2];
-            filePtr += 4;
-        }
+        ImageProcessing::BGRAToRGBA(filePtr, (uint8_t*)formattedData, imageWidth * imageHeight);
         break;
     }
 
-    Create( imageWidth, imageHeight, sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM, formattedData );
+    return formattedData;
+}
+
+// Generates the mips "TGA Mips" asks for on the CPU.  Returns the mip count, with the chain in MipChain when
+// there is more than one.
+static uint32_t GenerateTGAMips( const uint32_t* Pixels, uint32_t Width, uint32_t Height, bool sRGB, vector<uint8_t>& MipChain )
+{
+    if (TextureManager::s_TGAMips == 0)
+        return 1;
+
+    const uint32_t MipCount = ImageProcessing::GetMipCount(Width, Height);
+    MipChain.resize(ImageProcessing::GetMipChainSize(Width, Height, MipCount, 4));
+    ImageProcessing::GenerateMipChain((ImageProcessing::Filter)(TextureManager::s_TGAMips - 1), sRGB,
+        (const uint8_t*)Pixels, Width, Height, MipCount, MipChain.data());
+    return MipCount;
+}
+
+void Texture::CreateTGAFromMemory( const void* _filePtr, size_t, bool sRGB )
+{
+    uint16_t imageWidth, imageHeight;
+    uint32_t* formattedData = ExpandTGA(_filePtr, imageWidth, imageHeight);
+
+    const DXGI_FORMAT Format = sRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    vector<uint8_t> MipChain;
+    const uint32_t MipCount = GenerateTGAMips(formattedData, imageWidth, imageHeight, sRGB, MipChain);
+    if (MipCount > 1)
+        CreateMipChain( imageWidth, imageHeight, Format, MipCount, MipChain.data() );
+    else
+        Create( imageWidth, imageHeight, Format, formattedData );
 
     delete [] formattedData;
 }
@@ -152,39 +220,617 @@ void Texture::CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize )
 namespace TextureManager
 {
     wstring s_RootPath = L"";
-    map< wstring, unique_ptr<ManagedTexture> > s_TextureCache;
 
-    void Initialize( const std::wstring& TextureLibRoot )
+    const Texture& GetMagentaTex2D(void);
+    void UpdateCacheSize( ManagedTexture* ManTex );
+}
+
+static bool IsDDSFile( const uint8_t* Data, size_t Size )
+{
+    return Size >= 4 && memcmp(Data, "DDS ", 4) == 0;
+}
+
+// Block compresses a TGA (and its mips) when "TGA Compression" is on, returning a .dds file image, or null to
+// use the TGA as it is.  The result is cached next to the TGA, tagged with a hash of the TGA and the settings,
+// so each TGA is only compressed again when it or the settings change.
+static Utility::ByteArray CompressTGA( const wstring& Path, const Utility::ByteArray& TGAFile, bool sRGB )
+{
+    using namespace BlockCompression;
+
+    // The header alone is 18 bytes, and only 24 and 32-bit images are read
+    if (TextureManager::s_TGACompression == 0 || TGAFile->size() < 18 || ((*TGAFile)[16] != 24 && (*TGAFile)[16] != 32))
+        return nullptr;
+
+    static const Format kFormats[] = { kBC1, kBC1, kBC3, kBC7 };
+    const Format Fmt = kFormats[TextureManager::s_TGACompression];
+    const Quality Qual = (Quality)(int32_t)TextureManager::s_TGACompressionQuality;
+
+    const uint32_t MipFilter = TextureManager::s_TGAMips;
+
+    // Bump the version when the encoder's output changes.  Mips are filtered differently for sRGB.
+    const uint64_t kEncoderVersion = 1;
+    const uint64_t Settings = (((kEncoderVersion * kNumFormats + Fmt) * kNumQualities + Qual) * 4 + MipFilter) * 2 + (sRGB ? 1 : 0);
+    const uint64_t Tag = Utility::HashBytes(TGAFile->data(), TGAFile->size(), Settings);
+
+    const wstring CacheFileName = Path + L".bc.dds";
+    Utility::ByteArray Cached = Utility::ReadFileSync(CacheFileName);
+    if (CheckDDSTag(Cached->data(), Cached->size(), Tag))
+        return Cached;
+
+    uint16_t Width, Height;
+    uint32_t* Pixels = ExpandTGA(TGAFile->data(), Width, Height);
+
+    vector<uint8_t> MipChain;
+    const uint32_t MipCount = GenerateTGAMips(Pixels, Width, Height, sRGB, MipChain);
+    const uint8_t* MipData = MipCount > 1 ? MipChain.data() : (const uint8_t*)Pixels;
+
+    size_t DDSSize = kDDSHeaderSize;
+    for (uint32_t Mip = 0; Mip < MipCount; ++Mip)
+        DDSSize += GetCompressedSize(Fmt, max(Width >> Mip, 1), max(Height >> Mip, 1));
+
+    // The DDS is always UNORM.  Loading it with sRGB forced picks the _SRGB format.
+    Utility::ByteArray DDSFile = make_shared<vector<byte> >(DDSSize);
+    WriteDDSHeader(DDSFile->data(), Fmt, false, Width, Height, MipCount, Tag);
+
+    uint8_t* Blocks = DDSFile->data() + kDDSHeaderSize;
+    for (uint32_t Mip = 0; Mip < MipCount; ++Mip)
     {
-        s_RootPath = TextureLibRoot;
+        const uint32_t MipWidth = max(Width >> Mip, 1);
+        const uint32_t MipHeight = max(Height >> Mip, 1);
+        Compress(Fmt, Qual, MipData, MipWidth * 4, MipWidth, MipHeight, Blocks);
+
+        MipData += MipWidth * MipHeight * 4;
+        Blocks += GetCompressedSize(Fmt, MipWidth, MipHeight);
     }
 
+    delete [] Pixels;
+
+    // Failing to write the cache only costs compressing again next time
+    const wstring TempFileName = CacheFileName + L".tmp";
+    {
+        ofstream File(TempFileName, ios::out | ios::binary | ios::trunc);
+        File.write((const char*)DDSFile->data(), DDSFile->size());
+    }
+    if (!MoveFileEx(TempFileName.c_str(), CacheFileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+        DeleteFile(TempFileName.c_str());
+
+    return DDSFile;
+}
+
+// Owns the streaming queue and acts as its sink: files are read on the queue's I/O threads and turned into
+// the textures that requested them during UpdateStreaming()
+class ManagedTextureStreamer : public ITextureStreamingSink
+{
+public:
+    // Mips no larger than this are read along with a streamed .dds file's headers
+    static const UINT kMipTailSize = 128;
+
+    // Larger mips are read behind whole loads of up to this priority, smaller mips first
+    static const float kMipPriorityBias;
+
+    void Initialize( uint32_t NumThreads, size_t ByteBudget ) { m_Queue.Create(this, NumThreads, ByteBudget); }
+
     void Shutdown( void )
     {
-        s_TextureCache.clear();
+        m_Queue.Shutdown();
+        m_MipStreamed.clear();
+        m_Retired.clear();
+    }
+
+    void Load( ManagedTexture* ManTex, const vector<wstring>& Candidates, bool sRGB, const Texture& Placeholder, float Priority )
+    {
+        D3D12_CPU_DESCRIPTOR_HANDLE Handle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        g_Device->CopyDescriptorsSimple(1, Handle, Placeholder.GetSRV(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+        // Publishing the handle releases anyone in WaitForLoad().  It must be in place before the request
+        // can complete so that texture creation writes to it rather than allocating another.
+        ManTex->m_sRGB = sRGB;
+        ManTex->m_StreamPriority = Priority;
+        ManTex->m_hCpuDescriptorHandle = Handle;
+        ManTex->m_StreamRequest = m_Queue.Request(Candidates, Priority, ManTex);
+    }
+
+    void SetPriority( const ManagedTexture* Tex, float Priority )
+    {
+        ManagedTexture* ManTex = const_cast<ManagedTexture*>(Tex);
+        ManTex->m_StreamPriority = Priority;
+        m_Queue.SetPriority(ManTex->m_StreamRequest, Priority);
+        if (ManTex->m_RefineRequest != 0)
+            m_Queue.SetPriority(ManTex->m_RefineRequest, GetMipPriority(ManTex, ManTex->m_ResidentMip - 1));
+    }
+
+    void Cancel( const ManagedTexture* Tex )
+    {
+        ManagedTexture* ManTex = const_cast<ManagedTexture*>(Tex);
+        m_Queue.Cancel(ManTex->m_StreamRequest);
+        CancelRefinement(ManTex);
+        StopMipStreaming(ManTex);
+    }
+
+    void Update( size_t MaxBytes, UINT DroppedMips )
+    {
+        CommandQueue& Queue = g_CommandManager.GetGraphicsQueue();
+        while (!m_Retired.empty() && Queue.IsFenceComplete(m_Retired.front().first))
+            m_Retired.pop_front();
+
+        m_Queue.Update(MaxBytes);
+        UpdateMips(DroppedMips);
+    }
+
+    void Flush( void ) { m_Queue.Flush(); }
+
+    // Stops everything streaming into a texture that is about to be evicted.  Returns false while its file
+    // is still being loaded, because an I/O thread may be using the texture.
+    bool Release( ManagedTexture* ManTex )
+    {
+        // Until then it has neither a resource nor has failed
+        if (ManTex->GetResource() == nullptr && ManTex->IsValid())
+            return false;
+
+        // Reads of a range of mips never touch the texture, so those can be abandoned mid-read
+        CancelRefinement(ManTex);
+        StopMipStreaming(ManTex);
+        return true;
+    }
+
+    virtual size_t GetReadSize( void* UserData, const wstring& FileName ) override
+    {
+        // Mip tails and compressed TGAs come back smaller than the file, and files only found as .gz larger
+        const wstring Path = TextureManager::s_RootPath + FileName;
+        uint64_t Size = 0;
+        if (!Utility::FileSystem::GetFileSize(Path, Size))
+            Utility::FileSystem::GetFileSize(Path + L".gz", Size);
+        return (size_t)Size;
+    }
+
+    virtual FileData ReadFile( void* UserData, const wstring& FileName, uint64_t Offset, size_t Size ) override
+    {
+        const wstring Path = TextureManager::s_RootPath + FileName;
+
+        // Reads go through FileSystem's completion port (or straight to a mounted pack), and this thread only
+        // waits for them
+        Utility::ByteArray ba;
+        if (Size != kWholeFile)
+            ba = Utility::ReadFileRangeAsync(Path, Offset, Size).get();
+        else if (IsDDS(FileName))
+            ba = ReadDDSMipTail(Path);
+        else
+            ba = Utility::ReadFileAsync(Path).get();
+
+        // Compressing on this thread keeps the work out of UpdateStreaming()
+        if (Size == kWholeFile && !IsDDS(FileName) && ba->size() > 0)
+        {
+            Utility::ByteArray Compressed = CompressTGA(Path, ba, ((ManagedTexture*)UserData)->m_sRGB);
+            if (Compressed != nullptr)
+                ba = Compressed;
+        }
+
+        return ba->size() > 0 ? ba : nullptr;
+    }
+
+    virtual bool CreateTexture( void* UserData, const wstring& FileName, const uint8_t* Data, size_t Size ) override
+    {
+        ManagedTexture* ManTex = (ManagedTexture*)UserData;
+
+        // Once created, only textures streamed by mip read anything more
+        if (ManTex->GetResource() != nullptr)
+        {
+            ASSERT(ManTex->m_RefineRequest != 0 && ManTex->m_ResidentMip > 0);
+            ManTex->m_RefineRequest = 0;
+            ResizeMips(ManTex, ManTex->m_ResidentMip - 1, Data, Size);
+            return true;
+        }
+
+        // The SRV already holds the placeholder, so creating the texture writes over it in place
+        if (IsDDS(FileName))
+        {
+            if (!CreateFromMipTail(ManTex, FileName, Data, Size) && !ManTex->CreateDDSFromMemory(Data, Size, ManTex->m_sRGB))
+                return false;
+        }
+        else if (IsDDSFile(Data, Size))
+        {
+            // A compressed TGA
+            if (!ManTex->CreateDDSFromMemory(Data, Size, ManTex->m_sRGB))
+                return false;
+        }
+        else
+        {
+            ManTex->CreateTGAFromMemory(Data, Size, ManTex->m_sRGB);
+        }
+
+        ManTex->GetResource()->SetName(FileName.c_str());
+        TextureManager::UpdateCacheSize(ManTex);
+        DynamicDescriptorHeap::InvalidateReusedTables();
+        return true;
+    }
+
+    virtual void LoadFailed( void* UserData ) override
+    {
+        // Unlike SetToInvalidTexture(), keep the handle that callers have already stored
+        ManagedTexture* ManTex = (ManagedTexture*)UserData;
+
+        // A texture streamed by mip whose file has gone away keeps the mips it has
+        if (ManTex->GetResource() != nullptr)
+        {
+            ManTex->m_RefineRequest = 0;
+            StopMipStreaming(ManTex);
+            return;
+        }
+
+        g_Device->CopyDescriptorsSimple(1, ManTex->m_hCpuDescriptorHandle,
+            TextureManager::GetMagentaTex2D().GetSRV(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+        DynamicDescriptorHeap::InvalidateReusedTables();
+        ManTex->m_IsValid = false;
+    }
+
+private:
+
+    static bool IsDDS( const wstring& FileName )
+    {
+        return FileName.size() > 4 && FileName.compare(FileName.size() - 4, 4, L".dds") == 0;
+    }
+
+    static UINT GetMipTail( const DDS_TEXTURE_LAYOUT& Layout )
+    {
+        UINT Mip = 0;
+        while (Mip + 1 < Layout.mipCount && max(Layout.width >> Mip, Layout.height >> Mip) > kMipTailSize)
+            ++Mip;
+        return Mip;
+    }
+
+    static float GetMipPriority( const ManagedTexture* ManTex, UINT Mip )
+    {
+        return ManTex->m_StreamPriority - kMipPriorityBias + (float)Mip;
+    }
+
+    // Reads the headers and mip tail of a .dds that can be streamed by mip, which are the first and the last
+    // bytes of the file.  Anything else, including a file that only exists as .gz, is read whole.
+    static Utility::ByteArray ReadDDSMipTail( const wstring& Path )
+    {
+        Utility::ByteArray Headers = Utility::ReadFileRangeAsync(Path, 0, DDS_MAX_HEADER_SIZE).get();
+
+        DDS_TEXTURE_LAYOUT Layout;
+        if (Headers->empty() || FAILED(GetDDSTextureLayout(Headers->data(), Headers->size(), &Layout)) ||
+            !CanStreamDDSMips(Layout) || GetMipTail(Layout) == 0)
+        {
+            return Utility::ReadFileAsync(Path).get();
+        }
+
+        const size_t TailOffset = Layout.mipOffset[GetMipTail(Layout)];
+        Utility::ByteArray Tail = Utility::ReadFileRangeAsync(Path, Layout.headerSize + TailOffset, Layout.sliceSize - TailOffset).get();
+
+        Headers->resize(Layout.headerSize);
+        Headers->insert(Headers->end(), Tail->begin(), Tail->end());
+        return Headers;
+    }
+
+    // Returns false if Data is not the output of ReadDDSMipTail()
+    bool CreateFromMipTail( ManagedTexture* ManTex, const wstring& FileName, const uint8_t* Data, size_t Size )
+    {
+        DDS_TEXTURE_LAYOUT& Layout = ManTex->m_MipLayout;
+        if (FAILED(GetDDSTextureLayout(Data, Size, &Layout)) || !CanStreamDDSMips(Layout))
+            return false;
+
+        const UINT TailMip = GetMipTail(Layout);
+        if (TailMip == 0 || Size != Layout.headerSize + Layout.sliceSize - Layout.mipOffset[TailMip])
+            return false;
+
+        if (FAILED(CreateDDSTextureFromMipTail(g_Device, Layout, TailMip, Data + Layout.headerSize, Size - Layout.headerSize,
+            ManTex->m_sRGB, &ManTex->m_pResource, ManTex->m_hCpuDescriptorHandle)))
+        {
+            return false;
+        }
+
+        ManTex->m_StreamFile = FileName;
+        ManTex->m_TailMip = TailMip;
+        ManTex->m_ResidentMip = TailMip;
+        m_MipStreamed.push_back(ManTex);
+        return true;
+    }
+
+    // Grows the texture with mips read from the file, or shrinks it (Data is null)
+    void ResizeMips( ManagedTexture* ManTex, UINT NewMip, const uint8_t* Data, size_t Size )
+    {
+        ID3D12Resource* NewResource = nullptr;
+        uint64_t FenceValue = 0;
+        HRESULT hr = ResizeDDSTextureMips(g_Device, ManTex->m_MipLayout, ManTex->GetResource(), ManTex->m_ResidentMip,
+            NewMip, Data, Size, ManTex->m_sRGB, &NewResource, ManTex->m_hCpuDescriptorHandle, &FenceValue);
+
+        if (FAILED(hr))
+        {
+            // The texture keeps the mips it has
+            Utility::Printf(L"Couldn't stream mip %u of %s:  Error = 0x%08X\n", NewMip, ManTex->m_StreamFile.c_str(), hr);
+            StopMipStreaming(ManTex);
+            return;
+        }
+
+        // The copy out of the old resource was submitted after every frame that may use it, and no frame is
+        // being recorded during UpdateStreaming(), so the graphics queue is done with it once the copy is
+        m_Retired.emplace_back(FenceValue, move(ManTex->m_pResource));
+        ManTex->m_pResource.Attach(NewResource);
+        ManTex->m_pResource->SetName(ManTex->m_StreamFile.c_str());
+        ManTex->m_ResidentMip = NewMip;
+        TextureManager::UpdateCacheSize(ManTex);
+        DynamicDescriptorHeap::InvalidateReusedTables();
+    }
+
+    // Requests the next larger mip of every texture streamed by mip, or drops mips down to DroppedMips
+    void UpdateMips( UINT DroppedMips )
+    {
+        // Backwards, because StopMipStreaming() moves the last texture into the current slot
+        for (size_t i = m_MipStreamed.size(); i-- > 0; )
+        {
+            ManagedTexture* ManTex = m_MipStreamed[i];
+            const UINT TargetMip = min(DroppedMips, ManTex->m_TailMip);
+
+            if (ManTex->m_ResidentMip <= TargetMip)
+            {
+                CancelRefinement(ManTex);
+                if (ManTex->m_ResidentMip < TargetMip)
+                    ResizeMips(ManTex, TargetMip, nullptr, 0);
+            }
+            else if (ManTex->m_RefineRequest == 0)
+            {
+                const DDS_TEXTURE_LAYOUT& Layout = ManTex->m_MipLayout;
+                const UINT Mip = ManTex->m_ResidentMip - 1;
+                ManTex->m_RefineRequest = m_Queue.RequestRange(ManTex->m_StreamFile, Layout.headerSize + Layout.mipOffset[Mip],
+                    Layout.mipSize[Mip], GetMipPriority(ManTex, Mip), ManTex);
+            }
+        }
     }
 
-    pair<ManagedTexture*, bool> FindOrLoadTexture( const wstring& fileName )
+    void CancelRefinement( ManagedTexture* ManTex )
     {
-        static mutex s_Mutex;
-        lock_guard<mutex> Guard(s_Mutex);
+        if (ManTex->m_RefineRequest != 0)
+        {
+            m_Queue.Cancel(ManTex->m_RefineRequest);
+            ManTex->m_RefineRequest = 0;
+        }
+    }
 
-        auto iter = s_TextureCache.find(fileName);
+    void StopMipStreaming( ManagedTexture* ManTex )
+    {
+        auto Iter = find(m_MipStreamed.begin(), m_MipStreamed.end(), ManTex);
+        if (Iter != m_MipStreamed.end())
+        {
+            *Iter = m_MipStreamed.back();
+            m_MipStreamed.pop_back();
+        }
+    }
+
+    TextureStreamingQueue m_Queue;
+    vector<ManagedTexture*> m_MipStreamed;
+    deque<pair<uint64_t, Microsoft::WRL::ComPtr<ID3D12Resource>>> m_Retired;    // Replaced by a resize, by fence value
+};
+
+const float ManagedTextureStreamer::kMipPriorityBias = 64.0f;
+
+// Owns every ManagedTexture.  Textures are looked up by a hash of their name.  Those that nothing references
+// stay cached until the cache holds more than its budget, and are then evicted least recently released first.
+class ManagedTextureCache
+{
+public:
+    ManagedTextureCache() : m_NumReleases(0), m_TotalBytes(0), m_Budget(SIZE_MAX), m_EvictionPending(false), m_Hits(0),
+        m_Misses(0), m_Evictions(0), m_BytesEvicted(0) {}
+
+    // Returns the texture and whether the caller must load it.  Ref is set before the cache is unlocked so
+    // that the texture can't be evicted before the caller holds it.
+    pair<ManagedTexture*, bool> FindOrCreate( const wstring& Key, TextureRef& Ref )
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+
+        auto Iter = m_Textures.find(Key);
 
         // If it's found, it has already been loaded or the load process has begun
-        if (iter != s_TextureCache.end())
-            return make_pair(iter->second.get(), false);
+        if (Iter != m_Textures.end())
+        {
+            ++m_Hits;
+            Ref = TextureRef(Iter->second.get());
+            return make_pair(Iter->second.get(), false);
+        }
 
-        ManagedTexture* NewTexture = new ManagedTexture(fileName);
-        s_TextureCache[fileName].reset( NewTexture );
+        ++m_Misses;
+        ManagedTexture* NewTexture = new ManagedTexture(Key);
+        m_Textures[Key].reset(NewTexture);
+        Ref = TextureRef(NewTexture);
 
         // This was the first time it was requested, so indicate that the caller must read the file
         return make_pair(NewTexture, true);
     }
 
+    void Release( const ManagedTexture* ManTex )
+    {
+        // Locked so that the last release can't race with eviction or a new reference
+        lock_guard<mutex> Guard(m_Mutex);
+
+        ASSERT(ManTex->m_RefCount > 0);
+        if (--ManTex->m_RefCount == 0)
+        {
+            ManTex->m_LastUse = ++m_NumReleases;
+            m_EvictionPending = true;
+        }
+    }
+
+    // Counts the memory of a texture that has been created or has changed size
+    void UpdateSize( ManagedTexture* ManTex )
+    {
+        size_t Size = 0;
+        if (ManTex->GetResource() != nullptr)
+        {
+            D3D12_RESOURCE_DESC Desc = ManTex->GetResource()->GetDesc();
+            Size = (size_t)g_Device->GetResourceAllocationInfo(0, 1, &Desc).SizeInBytes;
+        }
+
+        lock_guard<mutex> Guard(m_Mutex);
+
+        m_TotalBytes = m_TotalBytes - ManTex->m_SizeInBytes + Size;
+        ManTex->m_SizeInBytes = Size;
+        m_EvictionPending = true;
+    }
+
+    // Deletes evicted textures that the GPU has finished with, then evicts until the cache fits in Budget.
+    // Unreferenced textures whose files are still loading are left for a later frame.
+    void Evict( size_t Budget, ManagedTextureStreamer& Streamer )
+    {
+        CommandQueue& Queue = g_CommandManager.GetGraphicsQueue();
+
+        lock_guard<mutex> Guard(m_Mutex);
+
+        bool FreedDescriptors = false;
+        while (!m_Retired.empty() && Queue.IsFenceComplete(m_Retired.front().first))
+        {
+            // Every cached texture has a descriptor of its own, including invalid ones
+            const D3D12_CPU_DESCRIPTOR_HANDLE Handle = m_Retired.front().second->GetSRV();
+            if (Handle.ptr != 0 && Handle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+            {
+                FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, Handle);
+                FreedDescriptors = true;
+            }
+            m_Retired.pop_front();
+        }
+
+        // The next texture to get one of these handles must not be bound to a table copied from the old one
+        if (FreedDescriptors)
+            DynamicDescriptorHeap::InvalidateReusedTables();
+
+        // Only look for something to evict when a texture has been released or has grown, or the budget has
+        // shrunk, since last time
+        if (Budget < m_Budget)
+            m_EvictionPending = true;
+        m_Budget = Budget;
+
+        if (m_TotalBytes <= Budget || !m_EvictionPending)
+            return;
+
+        m_EvictionPending = false;
+
+        vector<ManagedTexture*> Unreferenced;
+        for (auto& Entry : m_Textures)
+        {
+            if (Entry.second->m_RefCount == 0)
+                Unreferenced.push_back(Entry.second.get());
+        }
+
+        sort(Unreferenced.begin(), Unreferenced.end(),
+            []( const ManagedTexture* A, const ManagedTexture* B ) { return A->m_LastUse < B->m_LastUse; });
+
+        // Frames that have been submitted, or are being recorded, may still sample the textures
+        const uint64_t FenceValue = Queue.GetNextFenceValue();
+
+        for (ManagedTexture* ManTex : Unreferenced)
+        {
+            if (m_TotalBytes <= Budget)
+                break;
+
+            if (!Streamer.Release(ManTex))
+            {
+                m_EvictionPending = true;
+                continue;
+            }
+
+            m_TotalBytes -= ManTex->m_SizeInBytes;
+            m_BytesEvicted += ManTex->m_SizeInBytes;
+            ++m_Evictions;
+
+            auto Iter = m_Textures.find(ManTex->m_MapKey);
+            m_Retired.emplace_back(FenceValue, move(Iter->second));
+            m_Textures.erase(Iter);
+        }
+    }
+
+    // The GPU must be idle.  Descriptors aren't freed, because the descriptor heaps are already gone.
+    void Clear( void )
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+        m_Retired.clear();
+        m_Textures.clear();
+        m_TotalBytes = 0;
+    }
+
+    TextureManager::CacheStatistics GetStatistics( void )
+    {
+        lock_guard<mutex> Guard(m_Mutex);
+
+        TextureManager::CacheStatistics Stats;
+        Stats.NumTextures = m_Textures.size();
+        Stats.TotalBytes = m_TotalBytes;
+        Stats.BudgetBytes = m_Budget;
+        Stats.Hits = m_Hits;
+        Stats.Misses = m_Misses;
+        Stats.Evictions = m_Evictions;
+        Stats.BytesEvicted = m_BytesEvicted;
+        return Stats;
+    }
+
+private:
+
+    struct KeyHash
+    {
+        size_t operator()( const wstring& Key ) const
+        {
+            return (size_t)Utility::HashBytes(Key.data(), Key.size() * sizeof(wchar_t));
+        }
+    };
+
+    mutex m_Mutex;
+    unordered_map<wstring, unique_ptr<ManagedTexture>, KeyHash> m_Textures;
+    deque<pair<uint64_t, unique_ptr<ManagedTexture>>> m_Retired;    // Evicted, waiting for the GPU, by fence value
+
+    uint64_t m_NumReleases;
+    size_t m_TotalBytes;
+    size_t m_Budget;                // As of the last Evict()
+    bool m_EvictionPending;
+
+    uint64_t m_Hits;
+    uint64_t m_Misses;
+    uint64_t m_Evictions;
+    uint64_t m_BytesEvicted;
+};
+
+namespace TextureManager
+{
+    // At most this many bytes of file data are held in memory waiting for UpdateStreaming()
+    const size_t kStreamingByteBudget = 64 * 1024 * 1024;
+    const uint32_t kNumStreamingThreads = 4;
+
+    IntVar s_StreamingUploadBudget("Graphics/Textures/Streaming KB per Frame", 16 * 1024, 256, 1024 * 1024, 256);
+    IntVar s_DroppedMips("Graphics/Textures/Dropped Mips", 0, 0, D3D12_REQ_MIP_LEVELS - 1);
+    IntVar s_CacheBudget("Graphics/Textures/Cache Budget MB", 1024, 16, 64 * 1024, 64);
+
+    ManagedTextureStreamer s_Streamer;
+    ManagedTextureCache s_Cache;
+
+    void Initialize( const std::wstring& TextureLibRoot )
+    {
+        s_RootPath = TextureLibRoot;
+        s_Streamer.Initialize(kNumStreamingThreads, kStreamingByteBudget);
+    }
+
+    void Shutdown( void )
+    {
+        s_Streamer.Shutdown();
+        s_Cache.Clear();
+    }
+
+    pair<ManagedTexture*, bool> FindOrLoadTexture( const wstring& fileName, TextureRef& Ref )
+    {
+        return s_Cache.FindOrCreate(fileName, Ref);
+    }
+
+    void UpdateCacheSize( ManagedTexture* ManTex )
+    {
+        s_Cache.UpdateSize(ManTex);
+    }
+
+    CacheStatistics GetCacheStatistics( void )
+    {
+        return s_Cache.GetStatistics();
+    }
+
     const Texture& GetBlackTex2D(void)
     {
-        auto ManagedTex = FindOrLoadTexture(L"DefaultBlackTexture");
+        TextureRef Ref;
+        auto ManagedTex = FindOrLoadTexture(L"DefaultBlackTexture", Ref);
 
         ManagedTexture* ManTex = ManagedTex.first;
         const bool RequestsLoad = ManagedTex.second;
@@ -197,12 +843,15 @@ namespace TextureManager
 
         uint32_t BlackPixel = 0;
         ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &BlackPixel);
+        ManTex->AddRef();   // Never released, so never evicted
+        UpdateCacheSize(ManTex);
         return *ManTex;
     }
 
     const Texture& GetWhiteTex2D(void)
     {
-        auto ManagedTex = FindOrLoadTexture(L"DefaultWhiteTexture");
+        TextureRef Ref;
+        auto ManagedTex = FindOrLoadTexture(L"DefaultWhiteTexture", Ref);
 
         ManagedTexture* ManTex = ManagedTex.first;
         const bool RequestsLoad = ManagedTex.second;
@@ -215,12 +864,15 @@ namespace TextureManager
 
         uint32_t WhitePixel = 0xFFFFFFFFul;
         ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &WhitePixel);
+        ManTex->AddRef();   // Never released, so never evicted
+        UpdateCacheSize(ManTex);
         return *ManTex;
     }
 
     const Texture& GetMagentaTex2D(void)
     {
-        auto ManagedTex = FindOrLoadTexture(L"DefaultMagentaTexture");
+        TextureRef Ref;
+        auto ManagedTex = FindOrLoadTexture(L"DefaultMagentaTexture", Ref);
 
         ManagedTexture* ManTex = ManagedTex.first;
         const bool RequestsLoad = ManagedTex.second;
@@ -233,9 +885,92 @@ namespace TextureManager
 
         uint32_t MagentaPixel = 0x00FF00FF;
         ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &MagentaPixel);
+        ManTex->AddRef();   // Never released, so never evicted
+        UpdateCacheSize(ManTex);
+        return *ManTex;
+    }
+
+    const Texture& GetDefaultNormalTex2D(void)
+    {
+        TextureRef Ref;
+        auto ManagedTex = FindOrLoadTexture(L"DefaultNormalTexture", Ref);
+
+        ManagedTexture* ManTex = ManagedTex.first;
+        const bool RequestsLoad = ManagedTex.second;
+
+        if (!RequestsLoad)
+        {
+            ManTex->WaitForLoad();
+            return *ManTex;
+        }
+
+        // (0, 0, 1) in tangent space
+        uint32_t NormalPixel = 0x00FF8080;
+        ManTex->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &NormalPixel);
+        ManTex->AddRef();   // Never released, so never evicted
+        UpdateCacheSize(ManTex);
         return *ManTex;
     }
 
+    TextureRef LoadFromFileAsync( const vector<wstring>& fileNames, bool sRGB, const Texture& Placeholder, float Priority )
+    {
+        ASSERT(!fileNames.empty());
+
+        // The same file may be requested with different fallbacks, so the whole list is the key
+        wstring Key = L"Async:";
+        for (size_t i = 0; i < fileNames.size(); ++i)
+            Key += fileNames[i] + L"|";
+
+        TextureRef Ref;
+        auto ManagedTex = FindOrLoadTexture(Key, Ref);
+
+        ManagedTexture* ManTex = ManagedTex.first;
+        const bool RequestsLoad = ManagedTex.second;
+
+        if (!RequestsLoad)
+        {
+            ManTex->WaitForLoad();
+            return Ref;
+        }
+
+        vector<wstring> Candidates;
+        Candidates.reserve(fileNames.size() * 2);
+        for (size_t i = 0; i < fileNames.size(); ++i)
+        {
+            Candidates.push_back(fileNames[i] + L".dds");
+            Candidates.push_back(fileNames[i] + L".tga");
+        }
+
+        s_Streamer.Load(ManTex, Candidates, sRGB, Placeholder, Priority);
+        return Ref;
+    }
+
+    void SetStreamingPriority( const ManagedTexture* Tex, float Priority )
+    {
+        s_Streamer.SetPriority(Tex, Priority);
+    }
+
+    void CancelStreaming( const ManagedTexture* Tex )
+    {
+        s_Streamer.Cancel(Tex);
+    }
+
+    void DropStreamedMips( uint32_t NumMips )
+    {
+        s_DroppedMips = (int32_t)NumMips;
+    }
+
+    void UpdateStreaming( void )
+    {
+        s_Streamer.Update((size_t)s_StreamingUploadBudget * 1024, (UINT)(int32_t)s_DroppedMips);
+        s_Cache.Evict((size_t)s_CacheBudget * 1024 * 1024, s_Streamer);
+    }
+
+    void FlushStreaming( void )
+    {
+        s_Streamer.Flush();
+    }
+
 } // namespace TextureManager
 
 void ManagedTexture::WaitForLoad( void ) const
@@ -248,24 +983,39 @@ void ManagedTexture::WaitForLoad( void ) const
 
 void ManagedTexture::SetToInvalidTexture( void )
 {
-    m_hCpuDescriptorHandle = TextureManager::GetMagentaTex2D().GetSRV();
+    // A copy of the magenta texture's SRV, so that every cached texture can free its own descriptor
+    D3D12_CPU_DESCRIPTOR_HANDLE Handle = m_hCpuDescriptorHandle;
+    const bool Rewrite = Handle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+    if (!Rewrite)
+        Handle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    g_Device->CopyDescriptorsSimple(1, Handle, TextureManager::GetMagentaTex2D().GetSRV(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    if (Rewrite)
+        DynamicDescriptorHeap::InvalidateReusedTables();
+
+    m_hCpuDescriptorHandle = Handle;
     m_IsValid = false;
 }
 
-const ManagedTexture* TextureManager::LoadFromFile( const std::wstring& fileName, bool sRGB )
+void ManagedTexture::Release( void ) const
+{
+    TextureManager::s_Cache.Release(this);
+}
+
+TextureRef TextureManager::LoadFromFile( const std::wstring& fileName, bool sRGB )
 {
     std::wstring CatPath = fileName;
 
-    const ManagedTexture* Tex = LoadDDSFromFile( CatPath + L".dds", sRGB );
+    TextureRef Tex = LoadDDSFromFile( CatPath + L".dds", sRGB );
     if (!Tex->IsValid())
         Tex = LoadTGAFromFile( CatPath + L".tga", sRGB );
 
     return Tex;
 }
 
-const ManagedTexture* TextureManager::LoadDDSFromFile( const std::wstring& fileName, bool sRGB )
+TextureRef TextureManager::LoadDDSFromFile( const std::wstring& fileName, bool sRGB )
 {
-    auto ManagedTex = FindOrLoadTexture(fileName);
+    TextureRef Ref;
+    auto ManagedTex = FindOrLoadTexture(fileName, Ref);
 
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
@@ -273,7 +1023,7 @@ const ManagedTexture* TextureManager::LoadDDSFromFile( const std::wstring& fileN
     if (!RequestsLoad)
     {
         ManTex->WaitForLoad();
-        return ManTex;
+        return Ref;
     }
 
     Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
@@ -282,12 +1032,14 @@ const ManagedTexture* TextureManager::LoadDDSFromFile( const std::wstring& fileN
     else
         ManTex->GetResource()->SetName(fileName.c_str());
 
-    return ManTex;
+    UpdateCacheSize(ManTex);
+    return Ref;
 }
 
-const ManagedTexture* TextureManager::LoadTGAFromFile( const std::wstring& fileName, bool sRGB )
+TextureRef TextureManager::LoadTGAFromFile( const std::wstring& fileName, bool sRGB )
 {
-    auto ManagedTex = FindOrLoadTexture(fileName);
+    TextureRef Ref;
+    auto ManagedTex = FindOrLoadTexture(fileName, Ref);
 
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
@@ -295,11 +1047,16 @@ const ManagedTexture* TextureManager::LoadTGAFromFile( const std::wstring& fileN
     if (!RequestsLoad)
     {
         ManTex->WaitForLoad();
-        return ManTex;
+        return Ref;
     }
 
     Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
-    if (ba->size() > 0)
+    Utility::ByteArray Compressed = ba->size() > 0 ? CompressTGA( s_RootPath + fileName, ba, sRGB ) : nullptr;
+    if (Compressed != nullptr && ManTex->CreateDDSFromMemory( Compressed->data(), Compressed->size(), sRGB ))
+    {
+        ManTex->GetResource()->SetName(fileName.c_str());
+    }
+    else if (ba->size() > 0)
     {
         ManTex->CreateTGAFromMemory( ba->data(), ba->size(), sRGB );
         ManTex->GetResource()->SetName(fileName.c_str());
@@ -307,13 +1064,15 @@ const ManagedTexture* TextureManager::LoadTGAFromFile( const std::wstring& fileN
     else
         ManTex->SetToInvalidTexture();
 
-    return ManTex;
+    UpdateCacheSize(ManTex);
+    return Ref;
 }
 
 
-const ManagedTexture* TextureManager::LoadPIXImageFromFile( const std::wstring& fileName )
+TextureRef TextureManager::LoadPIXImageFromFile( const std::wstring& fileName )
 {
-    auto ManagedTex = FindOrLoadTexture(fileName);
+    TextureRef Ref;
+    auto ManagedTex = FindOrLoadTexture(fileName, Ref);
 
     ManagedTexture* ManTex = ManagedTex.first;
     const bool RequestsLoad = ManagedTex.second;
@@ -321,7 +1080,7 @@ const ManagedTexture* TextureManager::LoadPIXImageFromFile( const std::wstring&
     if (!RequestsLoad)
     {
         ManTex->WaitForLoad();
-        return ManTex;
+        return Ref;
     }
 
     Utility::ByteArray ba = Utility::ReadFileSync( s_RootPath + fileName );
@@ -333,5 +1092,6 @@ const ManagedTexture* TextureManager::LoadPIXImageFromFile( const std::wstring&
     else
         ManTex->SetToInvalidTexture();
 
-    return ManTex;
+    UpdateCacheSize(ManTex);
+    return Ref;
 }
@@ -17,6 +17,8 @@
 #include "pch.h"
 #include "GpuResource.h"
 #include "Utility.h"
+#include "DDSTextureLoader.h"
+#include <atomic>
 
 class Texture : public GpuResource
 {
@@ -34,6 +36,9 @@ public:
         Create(Width, Width, Height, Format, InitData);
     }
 
+    // Create a 2D texture with NumMips mips, which InitData holds tightly packed and largest first
+    void CreateMipChain(size_t Width, size_t Height, DXGI_FORMAT Format, uint32_t NumMips, const void* InitData );
+
     void CreateTGAFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     bool CreateDDSFromMemory( const void* memBuffer, size_t fileSize, bool sRGB );
     void CreatePIXImageFromMemory( const void* memBuffer, size_t fileSize );
@@ -50,13 +55,20 @@ public:
 
 protected:
 
+    void CreateResource( size_t Width, size_t Height, DXGI_FORMAT Format, uint32_t NumMips, D3D12_SUBRESOURCE_DATA* InitData );
+
     D3D12_CPU_DESCRIPTOR_HANDLE m_hCpuDescriptorHandle;
 };
 
 class ManagedTexture : public Texture
 {
+    friend class ManagedTextureStreamer;
+    friend class ManagedTextureCache;
+
 public:
-    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true) {}
+    ManagedTexture( const std::wstring& FileName ) : m_MapKey(FileName), m_IsValid(true), m_RefCount(0), m_LastUse(0),
+        m_SizeInBytes(0), m_sRGB(false), m_StreamRequest(0), m_StreamPriority(0.0f), m_TailMip(0), m_ResidentMip(0),
+        m_RefineRequest(0) {}
 
     void operator= ( const Texture& Texture );
 
@@ -66,9 +78,67 @@ public:
     void SetToInvalidTexture(void);
     bool IsValid(void) const { return m_IsValid; }
 
+    // The most detailed mip of the file that is in memory, which is mip 0 of the resource.  Textures
+    // streamed by mip start with only their smallest mips; anything else has every mip resident.
+    uint32_t GetResidentMip(void) const { return m_ResidentMip; }
+
+    // Counted by TextureRef.  A texture can only be evicted from the cache once its count reaches zero.
+    void AddRef(void) const { ++m_RefCount; }
+    void Release(void) const;
+
 private:
     std::wstring m_MapKey;		// For deleting from the map later
     bool m_IsValid;
+
+    // Cache bookkeeping
+    mutable std::atomic<uint32_t> m_RefCount;
+    mutable uint64_t m_LastUse;     // When the last reference was released, for least recently used eviction
+    size_t m_SizeInBytes;           // Counted against the cache budget
+
+    // Asynchronous loads
+    bool m_sRGB;
+    uint64_t m_StreamRequest;
+    float m_StreamPriority;
+
+    // Textures streamed by mip
+    std::wstring m_StreamFile;
+    DDS_TEXTURE_LAYOUT m_MipLayout;
+    uint32_t m_TailMip;             // Loaded first and never dropped
+    uint32_t m_ResidentMip;
+    uint64_t m_RefineRequest;       // Reading mip m_ResidentMip - 1
+};
+
+// A counted reference to a texture in the TextureManager cache.  The cache keeps every texture that is
+// referenced; the rest stay cached until evicted, least recently released first, whenever the cache holds
+// more than "Graphics/Textures/Cache Budget MB".  Evicted textures are deleted once the GPU is done with
+// them, so a reference must be held for as long as the texture's SRV handle is used.
+class TextureRef
+{
+public:
+    TextureRef() : m_Tex(nullptr) {}
+
+    // Tex must already be referenced, e.g. by another TextureRef
+    explicit TextureRef( const ManagedTexture* Tex ) : m_Tex(Tex) { if (m_Tex != nullptr) m_Tex->AddRef(); }
+
+    TextureRef( const TextureRef& Ref ) : TextureRef(Ref.m_Tex) {}
+    TextureRef( TextureRef&& Ref ) : m_Tex(Ref.m_Tex) { Ref.m_Tex = nullptr; }
+    ~TextureRef() { Release(); }
+
+    TextureRef& operator= ( TextureRef Ref ) { std::swap(m_Tex, Ref.m_Tex); return *this; }
+
+    void Release(void)
+    {
+        if (m_Tex != nullptr)
+            m_Tex->Release();
+        m_Tex = nullptr;
+    }
+
+    const ManagedTexture* Get(void) const { return m_Tex; }
+    const ManagedTexture* operator->(void) const { return m_Tex; }
+    const ManagedTexture& operator*(void) const { return *m_Tex; }
+
+private:
+    const ManagedTexture* m_Tex;
 };
 
 namespace TextureManager
@@ -76,31 +146,73 @@ namespace TextureManager
     void Initialize( const std::wstring& TextureLibRoot );
     void Shutdown(void);
 
-    const ManagedTexture* LoadFromFile( const std::wstring& fileName, bool sRGB = false );
-    const ManagedTexture* LoadDDSFromFile( const std::wstring& fileName, bool sRGB = false );
-    const ManagedTexture* LoadTGAFromFile( const std::wstring& fileName, bool sRGB = false );
-    const ManagedTexture* LoadPIXImageFromFile( const std::wstring& fileName );
+    TextureRef LoadFromFile( const std::wstring& fileName, bool sRGB = false );
+    TextureRef LoadDDSFromFile( const std::wstring& fileName, bool sRGB = false );
+    TextureRef LoadTGAFromFile( const std::wstring& fileName, bool sRGB = false );
+    TextureRef LoadPIXImageFromFile( const std::wstring& fileName );
 
-    inline const ManagedTexture* LoadFromFile( const std::string& fileName, bool sRGB = false )
+    inline TextureRef LoadFromFile( const std::string& fileName, bool sRGB = false )
     {
         return LoadFromFile(MakeWStr(fileName), sRGB);
     }
 
-    inline const ManagedTexture* LoadDDSFromFile( const std::string& fileName, bool sRGB = false )
+    inline TextureRef LoadDDSFromFile( const std::string& fileName, bool sRGB = false )
     {
         return LoadDDSFromFile(MakeWStr(fileName), sRGB);
     }
 
-    inline const ManagedTexture* LoadTGAFromFile( const std::string& fileName, bool sRGB = false )
+    inline TextureRef LoadTGAFromFile( const std::string& fileName, bool sRGB = false )
     {
         return LoadTGAFromFile(MakeWStr(fileName), sRGB);
     }
 
-    inline const ManagedTexture* LoadPIXImageFromFile( const std::string& fileName )
+    inline TextureRef LoadPIXImageFromFile( const std::string& fileName )
     {
         return LoadPIXImageFromFile(MakeWStr(fileName));
     }
 
+    // Returns immediately with a texture whose SRV shows Placeholder until the first of fileNames that can
+    // be loaded (as .dds, then .tga) is ready.  The SRV handle never changes, so it may be stored.  Files
+    // are read on I/O threads in priority order (higher first); textures are created in UpdateStreaming().
+    //
+    // A .dds holding a single 2D texture is streamed by mip: only its headers and its mips no larger than
+    // 128x128 are read at first, then each larger mip in turn behind every pending whole load.
+    TextureRef LoadFromFileAsync( const std::vector<std::wstring>& fileNames, bool sRGB,
+        const Texture& Placeholder, float Priority = 0.0f );
+
+    // Only affects loads whose file hasn't started reading
+    void SetStreamingPriority( const ManagedTexture* Tex, float Priority );
+
+    // The texture keeps its placeholder, or the mips it already has
+    void CancelStreaming( const ManagedTexture* Tex );
+
+    // Frees the top NumMips mips of every texture streamed by mip, e.g. under memory pressure, and keeps
+    // them from streaming back in until allowed again.  Mip tails are never dropped.
+    void DropStreamedMips( uint32_t NumMips );
+
+    // Creates textures whose files have been read, within the per-frame upload budget, and evicts
+    // unreferenced textures while the cache is over budget.  Called once per frame before any rendering.
+    void UpdateStreaming( void );
+
+    // Blocks until every asynchronous load has finished, e.g. at the end of a loading screen.  Textures
+    // streamed by mip go on adding larger mips afterwards.
+    void FlushStreaming( void );
+
+    struct CacheStatistics
+    {
+        size_t NumTextures;
+        size_t TotalBytes;          // Of every cached texture, referenced or not
+        size_t BudgetBytes;
+        uint64_t Hits;              // Loads of a texture that was already cached
+        uint64_t Misses;
+        uint64_t Evictions;
+        uint64_t BytesEvicted;
+    };
+
+    CacheStatistics GetCacheStatistics( void );
+
+    // The default textures are never evicted
     const Texture& GetBlackTex2D(void);
     const Texture& GetWhiteTex2D(void);
+    const Texture& GetDefaultNormalTex2D(void);
 }
@@ -0,0 +1,389 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "TextureStreamingQueue.h"
+#include <algorithm>
+
+using namespace std;
+
+TextureStreamingQueue::TextureStreamingQueue()
+    : m_Sink(nullptr)
+    , m_InFlightByteBudget(0)
+    , m_ShuttingDown(false)
+    , m_NextId(1)
+    , m_NextSequence(0)
+    , m_NumReading(0)
+    , m_BytesInFlight(0)
+    , m_PeakBytesInFlight(0)
+    , m_NumRequested(0)
+    , m_NumCompleted(0)
+    , m_NumFailed(0)
+    , m_NumCancelled(0)
+{
+}
+
+void TextureStreamingQueue::Create( ITextureStreamingSink* Sink, uint32_t NumThreads, size_t InFlightByteBudget )
+{
+    ASSERT(Sink != nullptr && NumThreads > 0);
+    ASSERT(m_Threads.empty(), "Streaming queue already created");
+
+    m_Sink = Sink;
+    m_InFlightByteBudget = InFlightByteBudget;
+    m_ShuttingDown = false;
+
+    for (uint32_t i = 0; i < NumThreads; ++i)
+        m_Threads.emplace_back(&TextureStreamingQueue::WorkerThread, this);
+}
+
+void TextureStreamingQueue::Shutdown( void )
+{
+    {
+        lock_guard<mutex> LockGuard(m_Mutex);
+        m_ShuttingDown = true;
+        m_NumCancelled += m_Requests.size();
+        m_Queue.clear();
+        m_Ready.clear();
+    }
+
+    m_WorkAvailable.notify_all();
+    for (auto Iter = m_Threads.begin(); Iter != m_Threads.end(); ++Iter)
+        Iter->join();
+    m_Threads.clear();
+
+    lock_guard<mutex> LockGuard(m_Mutex);
+    m_Requests.clear();
+    m_BytesInFlight = 0;
+}
+
+void TextureStreamingQueue::Enqueue( StreamRequest& Req )
+{
+    Req.State = kQueued;
+    QueueKey Key = { Req.Priority, Req.Sequence, Req.Id };
+    m_Queue.insert(Key);
+    m_WorkAvailable.notify_one();
+}
+
+bool TextureStreamingQueue::FitsBudget( size_t ExpectedSize ) const
+{
+    return m_BytesInFlight == 0 ||
+        (m_BytesInFlight < m_InFlightByteBudget && ExpectedSize <= m_InFlightByteBudget - m_BytesInFlight);
+}
+
+bool TextureStreamingQueue::CanStartRead( void ) const
+{
+    if (m_Queue.empty())
+        return false;
+
+    // A file not sized yet is taken while there is any room, and sized before it is read
+    const size_t ExpectedSize = m_Requests.at(m_Queue.begin()->Id)->ExpectedSize;
+    return FitsBudget(ExpectedSize == kUnknownSize ? 0 : ExpectedSize);
+}
+
+void TextureStreamingQueue::Release( StreamRequest& Req )
+{
+    if (Req.Data)
+    {
+        m_BytesInFlight -= Req.Data->size();
+        Req.Data.reset();
+        m_WorkAvailable.notify_all();
+    }
+}
+
+TextureStreamingQueue::RequestId TextureStreamingQueue::Request( const vector<wstring>& Candidates, float Priority, void* UserData )
+{
+    ASSERT(!Candidates.empty());
+
+    unique_ptr<StreamRequest> NewRequest(new StreamRequest);
+    NewRequest->Candidates = Candidates;
+    NewRequest->NextCandidate = 0;
+    NewRequest->Offset = 0;
+    NewRequest->Size = ITextureStreamingSink::kWholeFile;
+    NewRequest->ExpectedSize = kUnknownSize;
+    NewRequest->Priority = Priority;
+    NewRequest->UserData = UserData;
+    NewRequest->Cancelled = false;
+
+    return Submit(move(NewRequest));
+}
+
+TextureStreamingQueue::RequestId TextureStreamingQueue::RequestRange( const wstring& FileName, uint64_t Offset, size_t Size,
+    float Priority, void* UserData )
+{
+    ASSERT(Size > 0);
+
+    unique_ptr<StreamRequest> NewRequest(new StreamRequest);
+    NewRequest->Candidates.push_back(FileName);
+    NewRequest->NextCandidate = 0;
+    NewRequest->Offset = Offset;
+    NewRequest->Size = Size;
+    NewRequest->ExpectedSize = Size;
+    NewRequest->Priority = Priority;
+    NewRequest->UserData = UserData;
+    NewRequest->Cancelled = false;
+
+    return Submit(move(NewRequest));
+}
+
+TextureStreamingQueue::RequestId TextureStreamingQueue::Submit( unique_ptr<StreamRequest> NewRequest )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    NewRequest->Id = m_NextId++;
+    NewRequest->Sequence = m_NextSequence++;
+    ++m_NumRequested;
+
+    StreamRequest& Req = *NewRequest;
+    m_Requests[Req.Id] = move(NewRequest);
+    Enqueue(Req);
+
+    return Req.Id;
+}
+
+bool TextureStreamingQueue::SetPriority( RequestId Id, float Priority )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    auto Iter = m_Requests.find(Id);
+    if (Iter == m_Requests.end() || Iter->second->State != kQueued)
+        return false;
+
+    StreamRequest& Req = *Iter->second;
+    QueueKey OldKey = { Req.Priority, Req.Sequence, Req.Id };
+    m_Queue.erase(OldKey);
+    Req.Priority = Priority;
+    Enqueue(Req);
+    return true;
+}
+
+bool TextureStreamingQueue::Cancel( RequestId Id )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    auto Iter = m_Requests.find(Id);
+    if (Iter == m_Requests.end() || Iter->second->Cancelled)
+        return false;
+
+    StreamRequest& Req = *Iter->second;
+    ++m_NumCancelled;
+
+    switch (Req.State)
+    {
+    case kQueued:
+    {
+        QueueKey Key = { Req.Priority, Req.Sequence, Req.Id };
+        m_Queue.erase(Key);
+        m_Requests.erase(Iter);
+        break;
+    }
+    case kReading:
+        // The I/O thread drops it when the read finishes
+        Req.Cancelled = true;
+        break;
+    case kReady:
+        m_Ready.erase(find(m_Ready.begin(), m_Ready.end(), Id));
+        Release(Req);
+        m_Requests.erase(Iter);
+        break;
+    }
+
+    m_ReadFinished.notify_all();
+    return true;
+}
+
+void TextureStreamingQueue::WorkerThread( void )
+{
+    unique_lock<mutex> Lock(m_Mutex);
+
+    for (;;)
+    {
+        m_WorkAvailable.wait(Lock, [this] { return m_ShuttingDown || CanStartRead(); });
+
+        if (m_ShuttingDown)
+            return;
+
+        const RequestId Id = m_Queue.begin()->Id;
+        m_Queue.erase(m_Queue.begin());
+
+        // While reading, nothing else touches the request's candidates and it can't be deleted
+        StreamRequest& Req = *m_Requests[Id];
+        Req.State = kReading;
+        ++m_NumReading;
+
+        if (Req.ExpectedSize == kUnknownSize)
+        {
+            Lock.unlock();
+
+            size_t ExpectedSize = 0;
+            for (size_t Candidate = Req.NextCandidate; Candidate < Req.Candidates.size() && ExpectedSize == 0; ++Candidate)
+                ExpectedSize = m_Sink->GetReadSize(Req.UserData, Req.Candidates[Candidate]);
+
+            Lock.lock();
+
+            Req.ExpectedSize = ExpectedSize;
+
+            // Back in line until there is room for it.  It keeps its place, so nothing passes it.
+            if (!Req.Cancelled && !m_ShuttingDown && !FitsBudget(ExpectedSize))
+            {
+                --m_NumReading;
+                Enqueue(Req);
+                continue;
+            }
+        }
+
+        if (Req.Cancelled || m_ShuttingDown)
+        {
+            --m_NumReading;
+            m_Requests.erase(Id);
+            m_ReadFinished.notify_all();
+            continue;
+        }
+
+        // Reserved so that reads started meanwhile count it against the budget
+        const size_t Reserved = Req.ExpectedSize;
+        m_BytesInFlight += Reserved;
+        m_PeakBytesInFlight = max(m_PeakBytesInFlight, m_BytesInFlight);
+
+        Lock.unlock();
+
+        ITextureStreamingSink::FileData Data;
+        size_t Candidate = Req.NextCandidate;
+        for (; Candidate < Req.Candidates.size(); ++Candidate)
+        {
+            Data = m_Sink->ReadFile(Req.UserData, Req.Candidates[Candidate], Req.Offset, Req.Size);
+            if (Data && !Data->empty())
+                break;
+            Data.reset();
+        }
+
+        Lock.lock();
+
+        --m_NumReading;
+        m_BytesInFlight -= Reserved;
+
+        if (Req.Cancelled || m_ShuttingDown)
+        {
+            m_Requests.erase(Id);
+            m_ReadFinished.notify_all();
+            m_WorkAvailable.notify_all();
+            continue;
+        }
+
+        Req.NextCandidate = Candidate;
+        Req.Data = Data;
+        Req.State = kReady;
+
+        if (Data)
+        {
+            m_BytesInFlight += Data->size();
+            m_PeakBytesInFlight = max(m_PeakBytesInFlight, m_BytesInFlight);
+        }
+
+        // The read may have come in under what was reserved
+        if (!Data || Data->size() < Reserved)
+            m_WorkAvailable.notify_all();
+
+        m_Ready.push_back(Id);
+        m_ReadFinished.notify_all();
+    }
+}
+
+size_t TextureStreamingQueue::Update( size_t MaxBytes )
+{
+    size_t BytesConsumed = 0;
+    size_t NumFinished = 0;
+
+    unique_lock<mutex> Lock(m_Mutex);
+
+    while (BytesConsumed < MaxBytes && !m_Ready.empty())
+    {
+        const RequestId Id = m_Ready.front();
+        m_Ready.pop_front();
+
+        // Take ownership so that the sink may call Cancel() (which will fail) or make new requests
+        auto Iter = m_Requests.find(Id);
+        unique_ptr<StreamRequest> Req = move(Iter->second);
+        m_Requests.erase(Iter);
+
+        const size_t Candidate = Req->NextCandidate;
+        const bool WasRead = Req->Data != nullptr;
+
+        Lock.unlock();
+
+        bool Created = false;
+        if (WasRead)
+            Created = m_Sink->CreateTexture(Req->UserData, Req->Candidates[Candidate], Req->Data->data(), Req->Data->size());
+
+        Lock.lock();
+
+        // The request holds the only reference, so the bytes are freed as they leave the budget
+        if (WasRead)
+            BytesConsumed += Req->Data->size();
+        Release(*Req);
+
+        if (Created)
+        {
+            ++m_NumCompleted;
+            ++NumFinished;
+        }
+        else if (WasRead && Candidate + 1 < Req->Candidates.size())
+        {
+            // The file was there but wasn't usable, so try the next one
+            Req->NextCandidate = Candidate + 1;
+            Req->ExpectedSize = kUnknownSize;
+            StreamRequest& Requeued = *Req;
+            m_Requests[Id] = move(Req);
+            Enqueue(Requeued);
+        }
+        else
+        {
+            ++m_NumFailed;
+            ++NumFinished;
+
+            Lock.unlock();
+            m_Sink->LoadFailed(Req->UserData);
+            Lock.lock();
+        }
+    }
+
+    return NumFinished;
+}
+
+void TextureStreamingQueue::Flush( void )
+{
+    for (;;)
+    {
+        Update();
+
+        unique_lock<mutex> Lock(m_Mutex);
+        if (m_Requests.empty())
+            return;
+
+        m_ReadFinished.wait(Lock, [this] { return !m_Ready.empty() || m_Requests.empty(); });
+    }
+}
+
+TextureStreamingQueue::Statistics TextureStreamingQueue::GetStatistics( void )
+{
+    lock_guard<mutex> LockGuard(m_Mutex);
+
+    Statistics Stats;
+    Stats.Requested = m_NumRequested;
+    Stats.Completed = m_NumCompleted;
+    Stats.Failed = m_NumFailed;
+    Stats.Cancelled = m_NumCancelled;
+    Stats.NumQueued = m_Queue.size();
+    Stats.NumReading = m_NumReading;
+    Stats.NumReady = m_Ready.size();
+    Stats.BytesInFlight = m_BytesInFlight;
+    Stats.PeakBytesInFlight = m_PeakBytesInFlight;
+    return Stats;
+}
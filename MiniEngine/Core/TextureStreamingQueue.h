@@ -0,0 +1,180 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  A prioritized queue of texture file reads serviced by a small pool of I/O threads.
+//
+// Each request names one or more candidate files; the first that can be read (and turned into a texture)
+// wins.  Workers always read the highest priority request next.  Before a read starts, the bytes it is
+// expected to return are reserved against a budget that also holds the reads not yet consumed, and reads
+// wait while the next one doesn't fit.  One larger than the whole budget goes ahead once nothing else is
+// in flight.  Finished reads are handed to the sink from Update(), which the owner calls on its own
+// thread, so texture creation never races with rendering.
+//
+// A request may also name a byte range of a single file, which is how textures that are streamed a few
+// mips at a time read the rest of their mips.
+//
+// The queue only deals with file names and bytes.  Reading and texture creation are done by the
+// ITextureStreamingSink, which lets the queue be driven without a device or a file system.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ITextureStreamingSink
+{
+public:
+    typedef std::shared_ptr<std::vector<uint8_t>> FileData;
+
+    static const size_t kWholeFile = SIZE_MAX;
+
+    virtual ~ITextureStreamingSink() {}
+
+    // Called on an I/O thread before a whole file is read.  Returns about how many bytes ReadFile() will
+    // return, or zero if the file can't be found.  Ranges are expected to return their size.
+    virtual size_t GetReadSize( void* UserData, const std::wstring& FileName ) = 0;
+
+    // Called on an I/O thread.  Returns null or an empty array when the file can't be read.  Size is
+    // kWholeFile (and Offset zero) unless the request named a range.
+    virtual FileData ReadFile( void* UserData, const std::wstring& FileName, uint64_t Offset, size_t Size ) = 0;
+
+    // Called from Update().  Returning false moves on to the request's next candidate file.
+    virtual bool CreateTexture( void* UserData, const std::wstring& FileName, const uint8_t* Data, size_t Size ) = 0;
+
+    // Called from Update() when no candidate could be read or created
+    virtual void LoadFailed( void* UserData ) = 0;
+};
+
+class TextureStreamingQueue
+{
+public:
+    typedef uint64_t RequestId;
+    static const RequestId kInvalidRequest = 0;
+
+    struct Statistics
+    {
+        uint64_t Requested;
+        uint64_t Completed;
+        uint64_t Failed;
+        uint64_t Cancelled;
+        size_t NumQueued;           // Waiting for an I/O thread
+        size_t NumReading;
+        size_t NumReady;            // Read, waiting for Update()
+        size_t BytesInFlight;       // Reserved for reads, or read and not yet consumed by Update()
+        size_t PeakBytesInFlight;
+    };
+
+    TextureStreamingQueue();
+    ~TextureStreamingQueue() { Shutdown(); }
+
+    void Create( ITextureStreamingSink* Sink, uint32_t NumThreads, size_t InFlightByteBudget );
+
+    // Cancels everything outstanding and joins the I/O threads.  The sink is not called again.
+    void Shutdown( void );
+
+    // Higher priorities are read first; equal priorities in request order
+    RequestId Request( const std::vector<std::wstring>& Candidates, float Priority, void* UserData );
+
+    // Reads Size bytes of one file starting at Offset
+    RequestId RequestRange( const std::wstring& FileName, uint64_t Offset, size_t Size, float Priority, void* UserData );
+
+    // Only affects requests that haven't started reading.  Returns false if it's too late.
+    bool SetPriority( RequestId Id, float Priority );
+
+    // Returns true if the sink will not be called for this request
+    bool Cancel( RequestId Id );
+
+    // Hands finished reads to the sink, stopping once at least MaxBytes have been consumed.  Returns
+    // the number of requests that completed or failed.
+    size_t Update( size_t MaxBytes = SIZE_MAX );
+
+    // Pumps Update() until every request has completed, failed or been cancelled
+    void Flush( void );
+
+    Statistics GetStatistics( void );
+
+private:
+
+    enum RequestState { kQueued, kReading, kReady };
+
+    struct StreamRequest
+    {
+        RequestId Id;
+        std::vector<std::wstring> Candidates;
+        size_t NextCandidate;
+        uint64_t Offset;
+        size_t Size;
+        size_t ExpectedSize;        // Reserved against the budget while reading, kUnknownSize until asked
+        float Priority;
+        uint64_t Sequence;
+        void* UserData;
+        RequestState State;
+        bool Cancelled;
+        ITextureStreamingSink::FileData Data;
+    };
+
+    struct QueueKey
+    {
+        float Priority;
+        uint64_t Sequence;
+        RequestId Id;
+
+        bool operator<( const QueueKey& Rhs ) const
+        {
+            if (Priority != Rhs.Priority)
+                return Priority > Rhs.Priority;
+            return Sequence < Rhs.Sequence;
+        }
+    };
+
+    static const size_t kUnknownSize = SIZE_MAX;
+
+    void WorkerThread( void );
+
+    RequestId Submit( std::unique_ptr<StreamRequest> NewRequest );
+
+    // Must hold m_Mutex
+    void Enqueue( StreamRequest& Req );
+    void Release( StreamRequest& Req );
+    bool FitsBudget( size_t ExpectedSize ) const;
+    bool CanStartRead( void ) const;
+
+    ITextureStreamingSink* m_Sink;
+    size_t m_InFlightByteBudget;
+    std::vector<std::thread> m_Threads;
+
+    std::mutex m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_ReadFinished;
+    bool m_ShuttingDown;
+
+    std::unordered_map<RequestId, std::unique_ptr<StreamRequest>> m_Requests;
+    std::set<QueueKey> m_Queue;
+    std::deque<RequestId> m_Ready;
+
+    RequestId m_NextId;
+    uint64_t m_NextSequence;
+    size_t m_NumReading;
+    size_t m_BytesInFlight;
+    size_t m_PeakBytesInFlight;
+    uint64_t m_NumRequested;
+    uint64_t m_NumCompleted;
+    uint64_t m_NumFailed;
+    uint64_t m_NumCancelled;
+};
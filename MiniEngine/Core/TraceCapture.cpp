@@ -0,0 +1,293 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+
+#include "pch.h"
+#include "TraceCapture.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+using namespace TraceCapture;
+
+namespace
+{
+    static_assert(sizeof(Event) == 32, "Events are copied as four 64-bit words");
+
+    // Sequence is one more than the index of the event the slot holds, zero before the first, and kBusy
+    // while an event is written.  The words are atomic so that a reader can copy a slot as it changes.
+    struct Slot
+    {
+        atomic<uint64_t> Sequence;
+        atomic<uint64_t> Words[4];
+    };
+
+    const uint64_t kBusy = ~0ull;
+
+    unique_ptr<Slot[]> s_Slots;
+    uint64_t s_Mask = 0;
+    atomic<uint64_t> s_WriteIndex(0);
+    atomic<uint64_t> s_NumDropped(0);
+    atomic<bool> s_Capturing(false);
+
+    // Writers between their check of s_Capturing and the end of their write, which Start() waits out
+    atomic<uint32_t> s_NumWriters(0);
+
+    struct NameTable
+    {
+        mutex Mutex;
+        unordered_map<wstring, uint32_t> Ids;
+        vector<string> Names;   // UTF-8
+    };
+
+    // Profiling scopes may be registered during static initialization
+    NameTable& GetNameTable( void )
+    {
+        static NameTable s_Table;
+        return s_Table;
+    }
+
+    string EscapeJson( const string& Str )
+    {
+        string Result;
+        Result.reserve(Str.size());
+
+        for (char c : Str)
+        {
+            if (c == '"' || c == '\\')
+            {
+                Result += '\\';
+                Result += c;
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                char Code[8];
+                snprintf(Code, sizeof(Code), "\\u%04x", (unsigned)c);
+                Result += Code;
+            }
+            else
+                Result += c;
+        }
+
+        return Result;
+    }
+
+    bool SaveChromeJson( ofstream& File, const vector<Event>& Events, const vector<string>& Names, double SecondsPerTick )
+    {
+        vector<string> EscapedNames(Names.size());
+        for (size_t i = 0; i < Names.size(); ++i)
+            EscapedNames[i] = EscapeJson(Names[i]);
+
+        int64_t Origin = Events.empty() ? 0 : Events[0].Begin;
+        for (const Event& E : Events)
+            Origin = min(Origin, E.Begin);
+
+        const double MicrosecsPerTick = SecondsPerTick * 1000000.0;
+
+        File << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"CPU\"}},\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"GPU\"}},\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"Timestamps\"}}";
+
+        char Line[256];
+        for (const Event& E : Events)
+        {
+            const bool IsGpu = E.Timeline == kGpu;
+            const char* Name = E.NameId < EscapedNames.size() ? EscapedNames[E.NameId].c_str() : "?";
+
+            snprintf(Line, sizeof(Line), "\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u,\"depth\":%u}}",
+                IsGpu ? 2 : 1, IsGpu ? 0 : E.ThreadId, (E.Begin - Origin) * MicrosecsPerTick,
+                max<int64_t>(E.End - E.Begin, 0) * MicrosecsPerTick, E.Frame, (uint32_t)E.Depth);
+
+            File << ",\n{\"name\":\"" << Name << Line;
+        }
+
+        File << "\n]}\n";
+        return File.good();
+    }
+
+    bool SaveBinary( ofstream& File, const vector<Event>& Events, const vector<string>& Names, double SecondsPerTick )
+    {
+        BinaryHeader Header = {};
+        memcpy(Header.Magic, "MTRC", 4);
+        Header.Version = 1;
+        Header.SecondsPerTick = SecondsPerTick;
+        Header.NumNames = (uint32_t)Names.size();
+        Header.EventSize = sizeof(Event);
+        Header.NumEvents = Events.size();
+        File.write((const char*)&Header, sizeof(Header));
+
+        for (const string& Name : Names)
+        {
+            const uint16_t Length = (uint16_t)min<size_t>(Name.size(), UINT16_MAX);
+            File.write((const char*)&Length, sizeof(Length));
+            File.write(Name.data(), Length);
+        }
+
+        if (!Events.empty())
+            File.write((const char*)Events.data(), Events.size() * sizeof(Event));
+
+        return File.good();
+    }
+}
+
+uint32_t TraceCapture::RegisterName( const wstring& Name )
+{
+    NameTable& Table = GetNameTable();
+    lock_guard<mutex> Guard(Table.Mutex);
+
+    auto Iter = Table.Ids.find(Name);
+    if (Iter != Table.Ids.end())
+        return Iter->second;
+
+    const uint32_t Id = (uint32_t)Table.Names.size();
+    Table.Names.push_back(MakeUTF8(Name));
+    Table.Ids[Name] = Id;
+    return Id;
+}
+
+void TraceCapture::Start( size_t MaxEvents )
+{
+    uint64_t Capacity = 1;
+    while (Capacity < MaxEvents)
+        Capacity <<= 1;
+
+    s_Capturing = false;
+    while (s_NumWriters.load() != 0)
+        this_thread::yield();
+
+    if (s_Slots == nullptr || Capacity != s_Mask + 1)
+    {
+        s_Slots.reset(new Slot[Capacity]);
+        s_Mask = Capacity - 1;
+    }
+
+    for (uint64_t i = 0; i < Capacity; ++i)
+        s_Slots[i].Sequence.store(0, memory_order_relaxed);
+
+    s_WriteIndex = 0;
+    s_NumDropped = 0;
+    s_Capturing.store(true, memory_order_release);
+}
+
+void TraceCapture::Stop( void )
+{
+    // The events are kept for saving
+    s_Capturing = false;
+}
+
+bool TraceCapture::IsCapturing( void )
+{
+    return s_Capturing;
+}
+
+void TraceCapture::Record( const Event& NewEvent )
+{
+    if (!s_Capturing.load(memory_order_relaxed))
+        return;
+
+    // Start() may be about to clear or reallocate the ring.  Both sides write one variable, then read the
+    // other's, so either Start() waits for this writer or the writer sees the capture has stopped.
+    s_NumWriters.fetch_add(1);
+    if (!s_Capturing.load())
+    {
+        s_NumWriters.fetch_sub(1, memory_order_release);
+        return;
+    }
+
+    const uint64_t Index = s_WriteIndex.fetch_add(1, memory_order_relaxed);
+    Slot& Dest = s_Slots[Index & s_Mask];
+
+    // Only when writers lap the whole ring can two meet in one slot.  The later event is dropped.
+    if (Dest.Sequence.exchange(kBusy, memory_order_acquire) == kBusy)
+    {
+        ++s_NumDropped;
+        s_NumWriters.fetch_sub(1, memory_order_release);
+        return;
+    }
+
+    // A reader whose copy overlaps this write sees the sequence number change and discards the copy.  The
+    // fence keeps the words from being written before kBusy is visible, which the exchange alone doesn't.
+    atomic_thread_fence(memory_order_release);
+
+    uint64_t Words[4];
+    memcpy(Words, &NewEvent, sizeof(Words));
+    for (uint32_t i = 0; i < 4; ++i)
+        Dest.Words[i].store(Words[i], memory_order_relaxed);
+
+    Dest.Sequence.store(Index + 1, memory_order_release);
+    s_NumWriters.fetch_sub(1, memory_order_release);
+}
+
+void TraceCapture::GetEvents( vector<Event>& Events )
+{
+    Events.clear();
+    if (s_Slots == nullptr)
+        return;
+
+    const uint64_t End = s_WriteIndex.load(memory_order_acquire);
+    const uint64_t Begin = End > s_Mask + 1 ? End - (s_Mask + 1) : 0;
+    Events.reserve((size_t)(End - Begin));
+
+    for (uint64_t Index = Begin; Index < End; ++Index)
+    {
+        const Slot& Src = s_Slots[Index & s_Mask];
+        if (Src.Sequence.load(memory_order_acquire) != Index + 1)
+            continue;
+
+        uint64_t Words[4];
+        for (uint32_t i = 0; i < 4; ++i)
+            Words[i] = Src.Words[i].load(memory_order_relaxed);
+
+        atomic_thread_fence(memory_order_acquire);
+        if (Src.Sequence.load(memory_order_relaxed) != Index + 1)
+            continue;
+
+        Event Copy;
+        memcpy(&Copy, Words, sizeof(Copy));
+        Events.push_back(Copy);
+    }
+}
+
+Statistics TraceCapture::GetStatistics( void )
+{
+    Statistics Stats;
+    Stats.Recorded = s_WriteIndex;
+    Stats.Capacity = s_Slots == nullptr ? 0 : (size_t)(s_Mask + 1);
+    Stats.Overwritten = Stats.Recorded > Stats.Capacity ? Stats.Recorded - Stats.Capacity : 0;
+    Stats.Dropped = s_NumDropped;
+    return Stats;
+}
+
+bool TraceCapture::Save( const wstring& FileName, Format Fmt, double SecondsPerTick )
+{
+    vector<Event> Events;
+    GetEvents(Events);
+
+    vector<string> Names;
+    {
+        NameTable& Table = GetNameTable();
+        lock_guard<mutex> Guard(Table.Mutex);
+        Names = Table.Names;
+    }
+
+    ofstream File(FileName, ios::out | ios::binary | ios::trunc);
+    if (!File)
+        return false;
+
+    if (Fmt == kBinary)
+        return SaveBinary(File, Events, Names, SecondsPerTick);
+    else
+        return SaveChromeJson(File, Events, Names, SecondsPerTick);
+}
@@ -0,0 +1,102 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Description:  Records a timeline of profiling scopes for offline analysis.  While a capture runs, each
+// scope that EngineProfiling times adds a CPU event, and a GPU event when it was timed on a command context.
+//
+// Events go into a fixed-size ring buffer.  Once it is full the oldest events are overwritten, so a soak
+// run that saves on demand keeps its most recent frames.  Recording is lock-free:  a writer claims a slot
+// with an atomic increment and publishes it with a sequence number, so events can be recorded from any
+// thread and read while the capture goes on.
+//
+// Captures are saved as Chrome trace event JSON (chrome://tracing or Perfetto) or in a compact binary
+// format, which is:
+//
+//   BinaryHeader
+//   NumNames x { uint16_t Length, Length bytes of UTF-8 }
+//   NumEvents x Event, oldest first
+//
+// All fields are little endian.  Times are in the recorder's ticks; SecondsPerTick converts them.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace TraceCapture
+{
+    enum Timeline
+    {
+        kCpu,
+        kGpu
+    };
+
+    enum Format
+    {
+        kChromeJson,
+        kBinary,
+        kNumFormats
+    };
+
+    struct Event
+    {
+        int64_t Begin;          // Ticks
+        int64_t End;
+        uint32_t Frame;
+        uint32_t NameId;        // From RegisterName()
+        uint32_t ThreadId;      // Zero for GPU events
+        uint16_t Depth;         // Of the scope in the profiling tree
+        uint8_t Timeline;
+        uint8_t Reserved;
+    };
+
+    struct BinaryHeader
+    {
+        char Magic[4];          // "MTRC"
+        uint32_t Version;       // 1
+        double SecondsPerTick;
+        uint32_t NumNames;
+        uint32_t EventSize;     // sizeof(Event)
+        uint64_t NumEvents;
+    };
+
+    struct Statistics
+    {
+        uint64_t Recorded;      // Since the capture started
+        uint64_t Overwritten;   // Recorded while the ring buffer was full
+        uint64_t Dropped;       // Writers lapped the ring buffer and found a slot still being written
+        size_t Capacity;
+    };
+
+    // Names are stored once so that events stay small.  Returns the same Id for the same name.
+    uint32_t RegisterName( const std::wstring& Name );
+
+    // Discards any previous capture.  MaxEvents is rounded up to a power of two.  Start() waits for any
+    // Record() already under way, so Start() and Stop() can be called from any thread, but Start() must not
+    // run at the same time as GetEvents() or Save().
+    void Start( size_t MaxEvents = 1 << 20 );
+    void Stop( void );
+    bool IsCapturing( void );
+
+    // Does nothing unless capturing
+    void Record( const Event& NewEvent );
+
+    // The captured events, oldest first.  Safe during a capture; events still being written are skipped.
+    void GetEvents( std::vector<Event>& Events );
+
+    Statistics GetStatistics( void );
+
+    // Chrome traces show CPU events by thread and GPU events on a timeline of their own, with times in
+    // microseconds from the earliest event.
+    bool Save( const std::wstring& FileName, Format Fmt, double SecondsPerTick );
+}
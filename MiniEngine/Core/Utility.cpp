@@ -139,3 +139,45 @@ std::wstring MakeWStr( const std::string& str )
 {
     return std::wstring(str.begin(), str.end());
 }
+
+std::string MakeUTF8( const std::wstring& str )
+{
+    std::string Result;
+    Result.reserve(str.size());
+
+    for (size_t i = 0; i < str.size(); ++i)
+    {
+        uint32_t c = (uint32_t)str[i];
+
+        // Join UTF-16 surrogate pairs
+        if (c >= 0xD800 && c < 0xDC00 && i + 1 < str.size() && (uint32_t)str[i + 1] >= 0xDC00 && (uint32_t)str[i + 1] < 0xE000)
+            c = 0x10000 + ((c - 0xD800) << 10) + ((uint32_t)str[++i] - 0xDC00);
+        else if (c >= 0xD800 && c < 0xE000)
+            c = 0xFFFD;     // An unpaired surrogate, replaced as WideCharToMultiByte() does
+
+        if (c < 0x80)
+        {
+            Result += (char)c;
+        }
+        else if (c < 0x800)
+        {
+            Result += (char)(0xC0 | c >> 6);
+            Result += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            Result += (char)(0xE0 | c >> 12);
+            Result += (char)(0x80 | (c >> 6 & 0x3F));
+            Result += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            Result += (char)(0xF0 | c >> 18);
+            Result += (char)(0x80 | (c >> 12 & 0x3F));
+            Result += (char)(0x80 | (c >> 6 & 0x3F));
+            Result += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    return Result;
+}
@@ -140,3 +140,6 @@ void SIMDMemCopy( void* __restrict Dest, const void* __restrict Source, size_t N
 void SIMDMemFill( void* __restrict Dest, __m128 FillVector, size_t NumQuadwords );
 
 std::wstring MakeWStr( const std::string& str );
+
+// UTF-16 (or UTF-32, where wchar_t is 32 bits) to UTF-8
+std::string MakeUTF8( const std::wstring& str );
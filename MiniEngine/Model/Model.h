@@ -209,4 +209,5 @@ protected:
     void ReleaseTextures();
     void LoadTextures();
     D3D12_CPU_DESCRIPTOR_HANDLE* m_SRVs;
+    std::vector<TextureRef> m_Textures;     // Keeps the textures of m_SRVs in the cache
 };
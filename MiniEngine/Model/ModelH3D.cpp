@@ -88,10 +88,8 @@ bool Model::LoadH3D(const char *filename)
 
     m_VertexBufferDepth.Create(L"VertexBufferDepth", m_Header.vertexDataByteSizeDepth / m_VertexStrideDepth, m_VertexStrideDepth, m_pVertexDataDepth);
     m_IndexBufferDepth.Create(L"IndexBufferDepth", m_Header.indexDataByteSize / sizeof(uint16_t), sizeof(uint16_t), m_pIndexDataDepth);
-    delete [] m_pVertexDataDepth;
-    m_pVertexDataDepth = nullptr;
-    delete [] m_pIndexDataDepth;
-    m_pIndexDataDepth = nullptr;
+
+    // The depth-only streams are kept for occlusion culling on the CPU.  Clear() frees them.
 
     LoadTextures();
 
@@ -142,21 +140,11 @@ h3d_save_fail:
 
 void Model::ReleaseTextures()
 {
-    /*
-    if (m_Textures != nullptr)
-    {
-        for (uint32_t materialIdx = 0; materialIdx < m_Header.materialCount; ++materialIdx)
-        {
-            for (int n = 0; n < Material::texCount; n++)
-            {
-                if (m_Textures[materialIdx * Material::texCount + n])
-                    m_Textures[materialIdx * Material::texCount + n]->Release();
-                m_Textures[materialIdx * Material::texCount + n] = nullptr;
-            }
-        }
-        delete [] m_Textures;
-    }
-    */
+    // Once no model references them, the texture cache may evict the textures
+    m_Textures.clear();
+
+    delete [] m_SRVs;
+    m_SRVs = nullptr;
 }
 
 void Model::LoadTextures(void)
@@ -165,37 +153,35 @@ void Model::LoadTextures(void)
 
     m_SRVs = new D3D12_CPU_DESCRIPTOR_HANDLE[m_Header.materialCount * 6];
 
-    const ManagedTexture* MatTextures[6] = {};
+    m_Textures.reserve(m_Header.materialCount * 3);
+
+    TextureRef MatTextures[6];
+
+    // Textures stream in on I/O threads.  Until they arrive the model renders with neutral placeholders, and
+    // since diffuse contributes the most it is read first.
+    const Texture& DiffusePlaceholder = TextureManager::GetWhiteTex2D();
+    const Texture& SpecularPlaceholder = TextureManager::GetBlackTex2D();
+    const Texture& NormalPlaceholder = TextureManager::GetDefaultNormalTex2D();
 
     for (uint32_t materialIdx = 0; materialIdx < m_Header.materialCount; ++materialIdx)
     {
         const Material& pMaterial = m_pMaterial[materialIdx];
+        const std::wstring DiffusePath = MakeWStr(pMaterial.texDiffusePath);
 
         // Load diffuse
-        MatTextures[0] = TextureManager::LoadFromFile(pMaterial.texDiffusePath, true);
-        if (!MatTextures[0]->IsValid())
-            MatTextures[0] = TextureManager::LoadFromFile("default", true);
+        MatTextures[0] = TextureManager::LoadFromFileAsync(
+            { DiffusePath, L"default" }, true, DiffusePlaceholder, 2.0f);
 
         // Load specular
-        MatTextures[1] = TextureManager::LoadFromFile(pMaterial.texSpecularPath, true);
-        if (!MatTextures[1]->IsValid())
-        {
-            MatTextures[1] = TextureManager::LoadFromFile(std::string(pMaterial.texDiffusePath) + "_specular", true);
-            if (!MatTextures[1]->IsValid())
-                MatTextures[1] = TextureManager::LoadFromFile("default_specular", true);
-        }
+        MatTextures[1] = TextureManager::LoadFromFileAsync(
+            { MakeWStr(pMaterial.texSpecularPath), DiffusePath + L"_specular", L"default_specular" }, true, SpecularPlaceholder, 0.0f);
 
         // Load emissive
         //MatTextures[2] = TextureManager::LoadFromFile(pMaterial.texEmissivePath, true);
 
         // Load normal
-        MatTextures[3] = TextureManager::LoadFromFile(pMaterial.texNormalPath, false);
-        if (!MatTextures[3]->IsValid())
-        {
-            MatTextures[3] = TextureManager::LoadFromFile(std::string(pMaterial.texDiffusePath) + "_normal", false);
-            if (!MatTextures[3]->IsValid())
-                MatTextures[3] = TextureManager::LoadFromFile("default_normal", false);
-        }
+        MatTextures[3] = TextureManager::LoadFromFileAsync(
+            { MakeWStr(pMaterial.texNormalPath), DiffusePath + L"_normal", L"default_normal" }, false, NormalPlaceholder, 1.0f);
 
         // Load lightmap
         //MatTextures[4] = TextureManager::LoadFromFile(pMaterial.texLightmapPath, true);
@@ -209,5 +195,9 @@ void Model::LoadTextures(void)
         m_SRVs[materialIdx * 6 + 3] = MatTextures[3]->GetSRV();
         m_SRVs[materialIdx * 6 + 4] = MatTextures[0]->GetSRV();
         m_SRVs[materialIdx * 6 + 5] = MatTextures[0]->GetSRV();
+
+        m_Textures.push_back(MatTextures[0]);
+        m_Textures.push_back(MatTextures[1]);
+        m_Textures.push_back(MatTextures[3]);
     }
 }
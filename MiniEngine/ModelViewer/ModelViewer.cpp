@@ -32,6 +32,8 @@
 #include "ShadowCamera.h"
 #include "ParticleEffectManager.h"
 #include "GameInput.h"
+#include "PerfRegression.h"
+#include "Math/MaskedOcclusion.h"
 #include "./ForwardPlusLighting.h"
 
 // To enable wave intrinsics, uncomment this macro and #define DXIL in Core/GraphcisCore.cpp.
@@ -64,13 +66,22 @@ public:
 
     virtual void Update( float deltaT ) override;
     virtual void RenderScene( void ) override;
+    virtual void RenderUI( class GraphicsContext& gfxContext ) override;
 
 private:
 
     void RenderLightShadows(GraphicsContext& gfxContext);
+    void UpdateBenchmarkCamera( void );
+
+    // Each view draws only the meshes whose bounding boxes intersect it
+    enum eCullingView { kMainView, kSunShadowView, kLightShadowView, kNumCullingViews };
+    void CreateMeshBounds( void );
+    void CreateOccluders( void );
+    void CullMeshes( eCullingView View, const Matrix4& ViewProjMat );
+    uint32_t OcclusionCullMeshes( const Matrix4& ViewProjMat, uint32_t* VisibleMask );
 
     enum eObjectFilter { kOpaque = 0x1, kCutout = 0x2, kTransparent = 0x4, kAll = 0xF, kNone = 0x0 };
-    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eObjectFilter Filter = kAll );
+    void RenderObjects( GraphicsContext& Context, const Matrix4& ViewProjMat, eCullingView View, eObjectFilter Filter = kAll );
     void CreateParticleEffects();
     Camera m_Camera;
     std::auto_ptr<CameraController> m_CameraController;
@@ -99,6 +110,27 @@ private:
     Model m_Model;
     std::vector<bool> m_pMaterialIsCutout;
 
+    // The model is static, so its mesh bounds are gathered once
+    std::vector<float> m_MeshBounds[6];
+    BoxArrays m_MeshBoxes;
+
+    struct VisibleMeshList
+    {
+        std::vector<uint32_t> Mask;
+        std::vector<uint32_t> Meshes;
+        uint64_t NumCulled;     // Totals since startup, for the stats
+        uint64_t NumTested;
+        uint64_t NumOccluded;   // Of NumCulled
+    };
+    VisibleMeshList m_VisibleMeshes[kNumCullingViews];
+
+    // The main view is also occlusion culled against the larger opaque meshes, rendered in software from their
+    // depth-only streams.  Meshes that can't be occluders have no indices.
+    std::vector<OccluderMesh> m_Occluders;
+    std::vector<float> m_OccluderSizes;
+    std::vector<OccluderMesh> m_FrameOccluders;
+    MaskedOcclusionBuffer m_OcclusionBuffer;
+
     Vector3 m_SunDirection;
     ShadowCamera m_SunShadow;
 };
@@ -114,6 +146,10 @@ NumVar ShadowDimY("Application/Lighting/Shadow Dim Y", 3000, 1000, 10000, 100 );
 NumVar ShadowDimZ("Application/Lighting/Shadow Dim Z", 3000, 1000, 10000, 100 );
 
 BoolVar ShowWaveTileCounts("Application/Forward+/Show Wave Tile Counts", false);
+BoolVar EnableMeshCulling("Application/Culling/Enable", true);
+BoolVar ShowCullingStats("Application/Culling/Show Stats", false);
+BoolVar EnableOcclusionCulling("Application/Culling/Occlusion Culling", true);
+NumVar MinOccluderSize("Application/Culling/Min Occluder Size", 200.0f, 0.0f, 2000.0f, 10.0f);
 #ifdef _WAVE_OP
 BoolVar EnableWaveOps("Application/Forward+/Enable Wave Ops", true);
 #endif
@@ -146,6 +182,8 @@ void ModelViewer::Startup( void )
         { "BITANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D12_APPEND_ALIGNED_ELEMENT, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
     };
 
+    // These compile on worker threads while the model and textures load
+
     // Depth-only (2x rate)
     m_DepthPSO.SetRootSignature(m_RootSig);
     m_DepthPSO.SetRasterizerState(RasterizerDefault);
@@ -155,25 +193,25 @@ void ModelViewer::Startup( void )
     m_DepthPSO.SetPrimitiveTopologyType(D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE);
     m_DepthPSO.SetRenderTargetFormats(0, nullptr, DepthFormat);
     m_DepthPSO.SetVertexShader(g_pDepthViewerVS, sizeof(g_pDepthViewerVS));
-    m_DepthPSO.Finalize();
+    m_DepthPSO.FinalizeAsync();
 
     // Depth-only shading but with alpha testing
     m_CutoutDepthPSO = m_DepthPSO;
     m_CutoutDepthPSO.SetPixelShader(g_pDepthViewerPS, sizeof(g_pDepthViewerPS));
     m_CutoutDepthPSO.SetRasterizerState(RasterizerTwoSided);
-    m_CutoutDepthPSO.Finalize();
+    m_CutoutDepthPSO.FinalizeAsync();
 
     // Depth-only but with a depth bias and/or render only backfaces
     m_ShadowPSO = m_DepthPSO;
     m_ShadowPSO.SetRasterizerState(RasterizerShadow);
     m_ShadowPSO.SetRenderTargetFormats(0, nullptr, g_ShadowBuffer.GetFormat());
-    m_ShadowPSO.Finalize();
+    m_ShadowPSO.FinalizeAsync();
 
     // Shadows with alpha testing
     m_CutoutShadowPSO = m_ShadowPSO;
     m_CutoutShadowPSO.SetPixelShader(g_pDepthViewerPS, sizeof(g_pDepthViewerPS));
     m_CutoutShadowPSO.SetRasterizerState(RasterizerShadowTwoSided);
-    m_CutoutShadowPSO.Finalize();
+    m_CutoutShadowPSO.FinalizeAsync();
 
     // Full color pass
     m_ModelPSO = m_DepthPSO;
@@ -182,27 +220,27 @@ void ModelViewer::Startup( void )
     m_ModelPSO.SetRenderTargetFormats(1, &ColorFormat, DepthFormat);
     m_ModelPSO.SetVertexShader( g_pModelViewerVS, sizeof(g_pModelViewerVS) );
     m_ModelPSO.SetPixelShader( g_pModelViewerPS, sizeof(g_pModelViewerPS) );
-    m_ModelPSO.Finalize();
+    m_ModelPSO.FinalizeAsync();
 
 #ifdef _WAVE_OP
     m_DepthWaveOpsPSO = m_DepthPSO;
     m_DepthWaveOpsPSO.SetVertexShader( g_pDepthViewerVS_SM6, sizeof(g_pDepthViewerVS_SM6) );
-    m_DepthWaveOpsPSO.Finalize();
+    m_DepthWaveOpsPSO.FinalizeAsync();
 
     m_ModelWaveOpsPSO = m_ModelPSO;
     m_ModelWaveOpsPSO.SetVertexShader( g_pModelViewerVS_SM6, sizeof(g_pModelViewerVS_SM6) );
     m_ModelWaveOpsPSO.SetPixelShader( g_pModelViewerPS_SM6, sizeof(g_pModelViewerPS_SM6) );
-    m_ModelWaveOpsPSO.Finalize();
+    m_ModelWaveOpsPSO.FinalizeAsync();
 #endif
 
     m_CutoutModelPSO = m_ModelPSO;
     m_CutoutModelPSO.SetRasterizerState(RasterizerTwoSided);
-    m_CutoutModelPSO.Finalize();
+    m_CutoutModelPSO.FinalizeAsync();
 
     // A debug shader for counting lights in a tile
     m_WaveTileCountPSO = m_ModelPSO;
     m_WaveTileCountPSO.SetPixelShader(g_pWaveTileCountPS, sizeof(g_pWaveTileCountPS));
-    m_WaveTileCountPSO.Finalize();
+    m_WaveTileCountPSO.FinalizeAsync();
 
     Lighting::InitializeResources();
 
@@ -230,6 +268,8 @@ void ModelViewer::Startup( void )
         }
     }
 
+    CreateMeshBounds();
+    CreateOccluders();
     CreateParticleEffects();
 
     float modelRadius = Length(m_Model.m_Header.boundingBox.max - m_Model.m_Header.boundingBox.min) * .5f;
@@ -255,6 +295,7 @@ void ModelViewer::Startup( void )
 
 void ModelViewer::Cleanup( void )
 {
+    m_OcclusionBuffer.Destroy();
     m_Model.Clear();
     Lighting::Shutdown();
 }
@@ -273,7 +314,10 @@ void ModelViewer::Update( float deltaT )
     else if (GameInput::IsFirstPressed(GameInput::kRShoulder))
         DebugZoom.Increment();
 
-    m_CameraController->Update(deltaT);
+    if (PerfRegression::IsBenchmarking())
+        UpdateBenchmarkCamera();
+    else
+        m_CameraController->Update(deltaT);
     m_ViewProjMatrix = m_Camera.GetViewProjMatrix();
 
     float costheta = cosf(m_SunOrientation);
@@ -303,7 +347,138 @@ void ModelViewer::Update( float deltaT )
     m_MainScissor.bottom = (LONG)g_SceneColorBuffer.GetHeight();
 }
 
-void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eObjectFilter Filter )
+// Benchmark runs circle the middle of the model looking inward, so that every run renders the same views
+void ModelViewer::UpdateBenchmarkCamera( void )
+{
+    const Model::BoundingBox& Bounds = m_Model.GetBoundingBox();
+    const Vector3 Center = (Bounds.min + Bounds.max) * 0.5f;
+    const Vector3 Extent = (Bounds.max - Bounds.min) * 0.25f;
+    const float Angle = PerfRegression::GetPathPosition() * XM_2PI;
+
+    const Vector3 Eye = Center + Vector3(cosf(Angle) * Extent.GetX(), 0.0f, sinf(Angle) * Extent.GetZ());
+    m_Camera.SetEyeAtUp(Eye, Center, Vector3(kYUnitVector));
+    m_Camera.Update();
+}
+
+void ModelViewer::CreateMeshBounds( void )
+{
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+    for (auto& Bounds : m_MeshBounds)
+        Bounds.resize(MeshCount);
+
+    for (uint32_t meshIndex = 0; meshIndex < MeshCount; meshIndex++)
+    {
+        const Model::BoundingBox& Box = m_Model.m_pMesh[meshIndex].boundingBox;
+        m_MeshBounds[0][meshIndex] = Box.min.GetX();
+        m_MeshBounds[1][meshIndex] = Box.min.GetY();
+        m_MeshBounds[2][meshIndex] = Box.min.GetZ();
+        m_MeshBounds[3][meshIndex] = Box.max.GetX();
+        m_MeshBounds[4][meshIndex] = Box.max.GetY();
+        m_MeshBounds[5][meshIndex] = Box.max.GetZ();
+    }
+
+    m_MeshBoxes.MinX = m_MeshBounds[0].data();
+    m_MeshBoxes.MinY = m_MeshBounds[1].data();
+    m_MeshBoxes.MinZ = m_MeshBounds[2].data();
+    m_MeshBoxes.MaxX = m_MeshBounds[3].data();
+    m_MeshBoxes.MaxY = m_MeshBounds[4].data();
+    m_MeshBoxes.MaxZ = m_MeshBounds[5].data();
+
+    for (auto& List : m_VisibleMeshes)
+    {
+        List.Mask.resize(GetCullMaskSize(MeshCount));
+        List.Meshes.reserve(MeshCount);
+        List.NumCulled = 0;
+        List.NumTested = 0;
+        List.NumOccluded = 0;
+    }
+}
+
+void ModelViewer::CreateOccluders( void )
+{
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+    m_Occluders.resize(MeshCount);
+    m_OccluderSizes.resize(MeshCount);
+    m_FrameOccluders.reserve(MeshCount);
+
+    for (uint32_t meshIndex = 0; meshIndex < MeshCount; meshIndex++)
+    {
+        const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
+        OccluderMesh& Occluder = m_Occluders[meshIndex];
+
+        Occluder.Positions = (const float*)(m_Model.m_pVertexDataDepth + mesh.vertexDataByteOffsetDepth + mesh.attribDepth[Model::attrib_position].offset);
+        Occluder.VertexStride = mesh.vertexStrideDepth;
+        Occluder.VertexCount = mesh.vertexCountDepth;
+        Occluder.Indices = (const uint16_t*)(m_Model.m_pIndexDataDepth + mesh.indexDataByteOffset);
+        Occluder.IndexCount = m_pMaterialIsCutout[mesh.materialIndex] ? 0 : mesh.indexCount;
+
+        m_OccluderSizes[meshIndex] = Length(mesh.boundingBox.max - mesh.boundingBox.min);
+    }
+
+    // Roughly the camera's aspect ratio.  It needn't match, since the whole view is mapped to the buffer.
+    m_OcclusionBuffer.Create(512, 288);
+}
+
+// Builds the view's list of meshes to draw, in mesh order so that draws sharing a material stay together
+void ModelViewer::CullMeshes( eCullingView View, const Matrix4& ViewProjMat )
+{
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+    VisibleMeshList& List = m_VisibleMeshes[View];
+    List.Meshes.clear();
+
+    if (!EnableMeshCulling)
+    {
+        for (uint32_t meshIndex = 0; meshIndex < MeshCount; meshIndex++)
+            List.Meshes.push_back(meshIndex);
+        return;
+    }
+
+    CullBoxes(MakeCullingPlanes(ViewProjMat), m_MeshBoxes, 0, MeshCount, List.Mask.data());
+
+    if (View == kMainView && EnableOcclusionCulling)
+        List.NumOccluded += OcclusionCullMeshes(ViewProjMat, List.Mask.data());
+
+    for (uint32_t Word = 0; Word < List.Mask.size(); ++Word)
+    {
+        for (uint32_t Bits = List.Mask[Word]; Bits != 0; Bits &= Bits - 1)
+        {
+            unsigned long Bit;
+            _BitScanForward(&Bit, Bits);
+            List.Meshes.push_back(Word * 32 + Bit);
+        }
+    }
+
+    List.NumCulled += MeshCount - (uint32_t)List.Meshes.size();
+    List.NumTested += MeshCount;
+}
+
+// Clears the mask bits of meshes hidden behind the occluders in view, and returns how many were
+uint32_t ModelViewer::OcclusionCullMeshes( const Matrix4& ViewProjMat, uint32_t* VisibleMask )
+{
+    ScopedTimer _prof(L"Occlusion Culling");
+
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+    uint32_t InFrustum = 0;
+
+    m_FrameOccluders.clear();
+    for (uint32_t meshIndex = 0; meshIndex < MeshCount; meshIndex++)
+    {
+        if (!IsVisible(VisibleMask, meshIndex))
+            continue;
+
+        ++InFrustum;
+        if (m_Occluders[meshIndex].IndexCount > 0 && m_OccluderSizes[meshIndex] >= MinOccluderSize)
+            m_FrameOccluders.push_back(m_Occluders[meshIndex]);
+    }
+
+    m_OcclusionBuffer.SetViewProjMatrix((const float*)&ViewProjMat);
+    m_OcclusionBuffer.Clear();
+    m_OcclusionBuffer.RenderOccluders(m_FrameOccluders.data(), (uint32_t)m_FrameOccluders.size());
+
+    return InFrustum - m_OcclusionBuffer.TestBoxes(m_MeshBoxes, MeshCount, VisibleMask);
+}
+
+void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& ViewProjMat, eCullingView View, eObjectFilter Filter )
 {
     struct VSConstants
     {
@@ -321,7 +496,7 @@ void ModelViewer::RenderObjects( GraphicsContext& gfxContext, const Matrix4& Vie
 
     uint32_t VertexStride = m_Model.m_VertexStride;
 
-    for (uint32_t meshIndex = 0; meshIndex < m_Model.m_Header.meshCount; meshIndex++)
+    for (uint32_t meshIndex : m_VisibleMeshes[View].Meshes)
     {
         const Model::Mesh& mesh = m_Model.m_pMesh[meshIndex];
 
@@ -355,12 +530,15 @@ void ModelViewer::RenderLightShadows(GraphicsContext& gfxContext)
     if (LightIndex >= MaxLights)
         return;
 
+    // The shadow frustum encloses the light's cone and ends at its radius
+    CullMeshes(kLightShadowView, m_LightShadowMatrix[LightIndex]);
+
     m_LightShadowTempBuffer.BeginRendering(gfxContext);
     {
         gfxContext.SetPipelineState(m_ShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kOpaque);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kLightShadowView, kOpaque);
         gfxContext.SetPipelineState(m_CutoutShadowPSO);
-        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kCutout);
+        RenderObjects(gfxContext, m_LightShadowMatrix[LightIndex], kLightShadowView, kCutout);
     }
     m_LightShadowTempBuffer.EndRendering(gfxContext);
 
@@ -434,6 +612,15 @@ void ModelViewer::RenderScene( void )
 
     pfnSetupGraphicsState();
 
+    m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
+        (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
+
+    {
+        ScopedTimer _prof(L"Cull Meshes");
+        CullMeshes(kMainView, m_ViewProjMatrix);
+        CullMeshes(kSunShadowView, m_SunShadow.GetViewProjMatrix());
+    }
+
     RenderLightShadows(gfxContext);
 
     {
@@ -453,13 +640,13 @@ void ModelViewer::RenderScene( void )
 #endif
             gfxContext.SetDepthStencilTarget(g_SceneDepthBuffer.GetDSV());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects(gfxContext, m_ViewProjMatrix, kMainView, kOpaque );
         }
 
         {
             ScopedTimer _prof(L"Cutout", gfxContext);
             gfxContext.SetPipelineState(m_CutoutDepthPSO);
-            RenderObjects(gfxContext, m_ViewProjMatrix, kCutout );
+            RenderObjects(gfxContext, m_ViewProjMatrix, kMainView, kCutout );
         }
     }
 
@@ -479,14 +666,11 @@ void ModelViewer::RenderScene( void )
         {
             ScopedTimer _prof(L"Render Shadow Map", gfxContext);
 
-            m_SunShadow.UpdateMatrix(-m_SunDirection, Vector3(0, -500.0f, 0), Vector3(ShadowDimX, ShadowDimY, ShadowDimZ),
-                (uint32_t)g_ShadowBuffer.GetWidth(), (uint32_t)g_ShadowBuffer.GetHeight(), 16);
-
             g_ShadowBuffer.BeginRendering(gfxContext);
             gfxContext.SetPipelineState(m_ShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kOpaque);
+            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kSunShadowView, kOpaque);
             gfxContext.SetPipelineState(m_CutoutShadowPSO);
-            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kCutout);
+            RenderObjects(gfxContext, m_SunShadow.GetViewProjMatrix(), kSunShadowView, kCutout);
             g_ShadowBuffer.EndRendering(gfxContext);
         }
 
@@ -515,12 +699,12 @@ void ModelViewer::RenderScene( void )
             gfxContext.SetRenderTarget(g_SceneColorBuffer.GetRTV(), g_SceneDepthBuffer.GetDSV_DepthReadOnly());
             gfxContext.SetViewportAndScissor(m_MainViewport, m_MainScissor);
 
-            RenderObjects( gfxContext, m_ViewProjMatrix, kOpaque );
+            RenderObjects( gfxContext, m_ViewProjMatrix, kMainView, kOpaque );
 
             if (!ShowWaveTileCounts)
             {
                 gfxContext.SetPipelineState(m_CutoutModelPSO);
-                RenderObjects( gfxContext, m_ViewProjMatrix, kCutout );
+                RenderObjects( gfxContext, m_ViewProjMatrix, kMainView, kCutout );
             }
         }
 
@@ -544,6 +728,39 @@ void ModelViewer::RenderScene( void )
     gfxContext.Finish();
 }
 
+void ModelViewer::RenderUI( class GraphicsContext& gfxContext )
+{
+    if (!ShowCullingStats)
+        return;
+
+    static const char* s_ViewNames[kNumCullingViews] = { "Camera", "Sun shadow", "Spot light shadows" };
+    const uint32_t MeshCount = m_Model.m_Header.meshCount;
+
+    TextContext Text(gfxContext);
+    Text.Begin();
+    Text.ResetCursor(10.0f, (float)g_OverlayBuffer.GetHeight() - 120.0f);
+    Text.SetTextSize(20.0f);
+
+    for (uint32_t View = 0; View < kNumCullingViews; ++View)
+    {
+        const VisibleMeshList& List = m_VisibleMeshes[View];
+        const uint32_t Drawn = (uint32_t)List.Meshes.size();
+        const float CulledPercent = List.NumTested == 0 ? 0.0f : 100.0f * List.NumCulled / List.NumTested;
+        Text.DrawFormattedString("%-20s %4u / %4u meshes drawn, %5.1f%% culled on average\n",
+            s_ViewNames[View], Drawn, MeshCount, CulledPercent);
+    }
+
+    const VisibleMeshList& MainList = m_VisibleMeshes[kMainView];
+    if (EnableOcclusionCulling && MainList.NumTested > 0)
+    {
+        Text.DrawFormattedString("%-20s %4u occluders, %u triangles, %5.1f%% of camera meshes occluded on average\n",
+            "Occlusion", (uint32_t)m_FrameOccluders.size(), m_OcclusionBuffer.GetNumTrianglesRasterized(),
+            100.0f * MainList.NumOccluded / MainList.NumTested);
+    }
+
+    Text.End();
+}
+
 void ModelViewer::CreateParticleEffects()
 {
     ParticleEffectProperties Effect = ParticleEffectProperties();
@@ -0,0 +1,624 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures DynamicAABBTree on a large open world of small boxes:  building it, frustum, sphere, ray and nearest
+// queries, queries from several threads at once, moving some of the objects, and removing and reinserting them.
+// Frustum queries are compared with testing every box with ParallelCullBoxes().
+//
+// With -validate, the result of every query is checked against testing every object's box, and the tree's
+// structure is checked after each kind of change.
+//
+
+#include "DynamicAABBTree.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace Math;
+
+typedef DynamicAABBTree::ProxyId ProxyId;
+
+const float kMargin = 0.5f;
+const float kViewDistance = 300.0f;
+const float kSphereRadius = 20.0f;
+const uint32_t kNeighbors = 16;
+
+struct World
+{
+	DynamicAABBTree tree;
+	vector<float> bounds[6];		// Min x, y, z, then max x, y, z, indexed by object
+	vector<ProxyId> proxies;
+	float size;
+
+	World() : tree(kMargin) {}
+
+	void GetBox( uint32_t object, float* lo, float* hi ) const
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			lo[k] = bounds[k][object];
+			hi[k] = bounds[3 + k][object];
+		}
+	}
+
+	void SetBox( uint32_t object, const float* lo, const float* hi )
+	{
+		for (int k = 0; k < 3; ++k)
+		{
+			bounds[k][object] = lo[k];
+			bounds[3 + k][object] = hi[k];
+		}
+	}
+};
+
+// Objects of a few meters scattered over a square that grows with their number, at about one per 16 square meters
+void GenerateWorld( uint32_t numObjects, World& world )
+{
+	world.size = sqrtf((float)numObjects) * 4.0f;
+	for (int k = 0; k < 6; ++k)
+		world.bounds[k].resize(numObjects);
+	world.proxies.resize(numObjects);
+
+	mt19937 rng(1234);
+	uniform_real_distribution<float> position(-0.5f * world.size, 0.5f * world.size);
+	uniform_real_distribution<float> height(0.0f, 20.0f);
+	uniform_real_distribution<float> extent(0.25f, 2.0f);
+
+	for (uint32_t i = 0; i < numObjects; ++i)
+	{
+		const float center[3] = { position(rng), height(rng), position(rng) };
+		float lo[3], hi[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const float e = extent(rng);
+			lo[k] = center[k] - e;
+			hi[k] = center[k] + e;
+		}
+		world.SetBox(i, lo, hi);
+	}
+}
+
+// A camera near the ground looking somewhere horizontal, with a 90 by 60 degree field of view
+void MakeFrustum( const World& world, mt19937& rng, CullingPlanes& planes )
+{
+	uniform_real_distribution<float> position(-0.5f * world.size, 0.5f * world.size);
+	uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+	const float eye[3] = { position(rng), 10.0f, position(rng) };
+	const float yaw = angle(rng);
+	const float forward[3] = { sinf(yaw), 0.0f, cosf(yaw) };
+	const float right[3] = { cosf(yaw), 0.0f, -sinf(yaw) };
+	const float up[3] = { 0.0f, 1.0f, 0.0f };
+
+	auto addPlane = [&]( const float* n, float offset )
+	{
+		planes.AddPlane(n[0], n[1], n[2], offset - (n[0] * eye[0] + n[1] * eye[1] + n[2] * eye[2]));
+	};
+
+	const float ch = cosf(0.785398f), sh = sinf(0.785398f);
+	const float cv = cosf(0.523599f), sv = sinf(0.523599f);
+
+	float n[3];
+	for (int k = 0; k < 3; ++k) n[k] = forward[k];
+	addPlane(n, -0.1f);
+	for (int k = 0; k < 3; ++k) n[k] = -forward[k];
+	addPlane(n, kViewDistance);
+	for (int k = 0; k < 3; ++k) n[k] = right[k] * ch + forward[k] * sh;
+	addPlane(n, 0.0f);
+	for (int k = 0; k < 3; ++k) n[k] = -right[k] * ch + forward[k] * sh;
+	addPlane(n, 0.0f);
+	for (int k = 0; k < 3; ++k) n[k] = up[k] * cv + forward[k] * sv;
+	addPlane(n, 0.0f);
+	for (int k = 0; k < 3; ++k) n[k] = -up[k] * cv + forward[k] * sv;
+	addPlane(n, 0.0f);
+}
+
+void MakeQueryPoint( const World& world, mt19937& rng, float* point )
+{
+	uniform_real_distribution<float> position(-0.5f * world.size, 0.5f * world.size);
+	uniform_real_distribution<float> height(0.0f, 20.0f);
+	point[0] = position(rng);
+	point[1] = height(rng);
+	point[2] = position(rng);
+}
+
+void MakeRay( const World& world, mt19937& rng, float* origin, float* direction )
+{
+	uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+	uniform_real_distribution<float> slope(-0.1f, 0.1f);
+	MakeQueryPoint(world, rng, origin);
+	const float yaw = angle(rng);
+	direction[0] = sinf(yaw);
+	direction[1] = slope(rng);
+	direction[2] = cosf(yaw);
+}
+
+// The references below test the fat boxes the tree holds, the same way the tree does, so must match it exactly
+
+bool BoxInFrustum( const CullingPlanes& planes, const float* lo, const float* hi )
+{
+	for (uint32_t p = 0; p < planes.GetNumPlanes(); ++p)
+	{
+		const float farthest = planes.PosX[p] * hi[0] + planes.NegX[p] * lo[0] +
+			planes.PosY[p] * hi[1] + planes.NegY[p] * lo[1] +
+			planes.PosZ[p] * hi[2] + planes.NegZ[p] * lo[2] + planes.D[p];
+		if (farthest < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+float BoxDistanceSquared( const float* point, const float* lo, const float* hi )
+{
+	float sum = 0.0f;
+	for (int k = 0; k < 3; ++k)
+	{
+		const float d = max(max(lo[k] - point[k], point[k] - hi[k]), 0.0f);
+		sum += d * d;
+	}
+	return sum;
+}
+
+bool RayHitsBox( const float* origin, const float* direction, float maxDistance, const float* lo, const float* hi, float& entry )
+{
+	float tNear = 0.0f, tFar = maxDistance;
+	for (int k = 0; k < 3; ++k)
+	{
+		if (direction[k] == 0.0f)
+		{
+			if (origin[k] < lo[k] || origin[k] > hi[k])
+				return false;
+			continue;
+		}
+		const float inv = 1.0f / direction[k];
+		float t0 = (lo[k] - origin[k]) * inv, t1 = (hi[k] - origin[k]) * inv;
+		if (t0 > t1)
+			swap(t0, t1);
+		tNear = max(tNear, t0);
+		tFar = min(tFar, t1);
+		if (tNear > tFar)
+			return false;
+	}
+	entry = tNear;
+	return true;
+}
+
+template <typename Test>
+vector<uint32_t> FindAll( const World& world, Test test )
+{
+	vector<uint32_t> found;
+	for (uint32_t i = 0; i < world.proxies.size(); ++i)
+	{
+		if (world.proxies[i] != DynamicAABBTree::kInvalidProxy &&
+			test(world.tree.GetFatMin(world.proxies[i]), world.tree.GetFatMax(world.proxies[i])))
+		{
+			found.push_back(i);
+		}
+	}
+	return found;
+}
+
+bool SameSet( vector<uint32_t> a, vector<uint32_t> b )
+{
+	sort(a.begin(), a.end());
+	sort(b.begin(), b.end());
+	return a == b;
+}
+
+// Runs every kind of query from a few places and counts those that disagree with testing every object
+uint32_t CountQueryErrors( const World& world, uint32_t numQueries )
+{
+	mt19937 rng(4321);
+	uint32_t errors = 0;
+	vector<uint32_t> results;
+
+	for (uint32_t q = 0; q < numQueries; ++q)
+	{
+		CullingPlanes planes;
+		MakeFrustum(world, rng, planes);
+		results.clear();
+		world.tree.QueryFrustum(planes, results);
+		if (!SameSet(results, FindAll(world, [&]( const float* lo, const float* hi ) { return BoxInFrustum(planes, lo, hi); })))
+			++errors;
+
+		float center[3];
+		MakeQueryPoint(world, rng, center);
+		results.clear();
+		world.tree.QuerySphere(center, kSphereRadius, results);
+		if (!SameSet(results, FindAll(world, [&]( const float* lo, const float* hi ) { return BoxDistanceSquared(center, lo, hi) <= kSphereRadius * kSphereRadius; })))
+			++errors;
+
+		float origin[3], direction[3];
+		MakeRay(world, rng, origin, direction);
+		vector<DynamicAABBTree::RayHit> hits;
+		world.tree.QueryRay(origin, direction, kViewDistance, hits);
+		float nearest = FLT_MAX;
+		const vector<uint32_t> expected = FindAll(world, [&]( const float* lo, const float* hi )
+		{
+			float entry;
+			if (!RayHitsBox(origin, direction, kViewDistance, lo, hi, entry))
+				return false;
+			nearest = min(nearest, entry);
+			return true;
+		});
+		results.clear();
+		for (size_t i = 0; i < hits.size(); ++i)
+		{
+			results.push_back(hits[i].UserData);
+			if (i > 0 && hits[i].Distance < hits[i - 1].Distance)
+				++errors;
+		}
+		if (!SameSet(results, expected))
+			++errors;
+
+		DynamicAABBTree::RayHit hit;
+		const bool found = world.tree.RayCast(origin, direction, kViewDistance, hit);
+		if (found != !expected.empty() || (found && hit.Distance != nearest))
+			++errors;
+
+		vector<DynamicAABBTree::Neighbor> neighbors;
+		world.tree.QueryNearest(center, kNeighbors, neighbors);
+		vector<float> distances;
+		FindAll(world, [&]( const float* lo, const float* hi )
+		{
+			distances.push_back(BoxDistanceSquared(center, lo, hi));
+			return false;
+		});
+		sort(distances.begin(), distances.end());
+		if (neighbors.size() != min<size_t>(kNeighbors, distances.size()))
+			++errors;
+		for (size_t i = 0; i < neighbors.size() && i < distances.size(); ++i)
+		{
+			if (neighbors[i].Distance != sqrtf(distances[i]))
+			{
+				++errors;
+				break;
+			}
+		}
+	}
+
+	return errors;
+}
+
+void Validate( const char* name, const World& world, uint32_t numQueries )
+{
+	world.tree.Validate();
+	printf("%-36s  %u query errors\n", name, CountQueryErrors(world, min(numQueries, 50u)));
+}
+
+template <typename Func>
+double TimeSeconds( Func body )
+{
+	auto start = chrono::high_resolution_clock::now();
+	body();
+	return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+void Report( const char* name, double seconds, uint32_t count, double found )
+{
+	printf("%-36s  %9.3f us  %10.1f found\n", name, seconds * 1e6 / count, found / count);
+}
+
+void TimeQueries( const World& world, uint32_t numQueries )
+{
+	mt19937 rng(8765);
+	vector<CullingPlanes> frusta(numQueries);
+	vector<float> points(numQueries * 3), origins(numQueries * 3), directions(numQueries * 3);
+	for (uint32_t q = 0; q < numQueries; ++q)
+	{
+		MakeFrustum(world, rng, frusta[q]);
+		MakeQueryPoint(world, rng, &points[q * 3]);
+		MakeRay(world, rng, &origins[q * 3], &directions[q * 3]);
+	}
+
+	vector<uint32_t> results;
+	uint64_t found = 0;
+	double seconds = TimeSeconds([&]
+	{
+		for (uint32_t q = 0; q < numQueries; ++q)
+		{
+			results.clear();
+			world.tree.QueryFrustum(frusta[q], results);
+			found += results.size();
+		}
+	});
+	Report("Frustum query", seconds, numQueries, (double)found);
+
+	// Every box against every frustum, for comparison
+	const uint32_t numObjects = (uint32_t)world.proxies.size();
+	const BoxArrays boxes = { world.bounds[0].data(), world.bounds[1].data(), world.bounds[2].data(),
+		world.bounds[3].data(), world.bounds[4].data(), world.bounds[5].data() };
+	vector<uint32_t> mask(GetCullMaskSize(numObjects));
+	const uint32_t numBruteForce = max(numQueries / 10, 1u);
+	found = 0;
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t q = 0; q < numBruteForce; ++q)
+			found += ParallelCullBoxes(frusta[q], boxes, numObjects, mask.data());
+	});
+	Report("Frustum, ParallelCullBoxes", seconds, numBruteForce, (double)found);
+
+	found = 0;
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t q = 0; q < numQueries; ++q)
+		{
+			results.clear();
+			world.tree.QuerySphere(&points[q * 3], kSphereRadius, results);
+			found += results.size();
+		}
+	});
+	Report("Sphere query", seconds, numQueries, (double)found);
+
+	vector<DynamicAABBTree::RayHit> hits;
+	found = 0;
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t q = 0; q < numQueries; ++q)
+		{
+			hits.clear();
+			world.tree.QueryRay(&origins[q * 3], &directions[q * 3], kViewDistance, hits);
+			found += hits.size();
+		}
+	});
+	Report("Ray query, every hit", seconds, numQueries, (double)found);
+
+	found = 0;
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t q = 0; q < numQueries; ++q)
+		{
+			DynamicAABBTree::RayHit hit;
+			found += world.tree.RayCast(&origins[q * 3], &directions[q * 3], kViewDistance, hit) ? 1 : 0;
+		}
+	});
+	Report("Ray cast, nearest hit", seconds, numQueries, (double)found);
+
+	vector<DynamicAABBTree::Neighbor> neighbors;
+	found = 0;
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t q = 0; q < numQueries; ++q)
+		{
+			neighbors.clear();
+			world.tree.QueryNearest(&points[q * 3], kNeighbors, neighbors);
+			found += neighbors.size();
+		}
+	});
+	Report("16 nearest", seconds, numQueries, (double)found);
+}
+
+// The same frustum queries split between threads, which share the tree with no locking
+void TimeConcurrentQueries( const World& world, uint32_t numQueries, uint32_t numThreads )
+{
+	mt19937 rng(2468);
+	vector<CullingPlanes> frusta(numQueries);
+	for (uint32_t q = 0; q < numQueries; ++q)
+		MakeFrustum(world, rng, frusta[q]);
+
+	vector<uint64_t> found(numThreads, 0);
+	const double seconds = TimeSeconds([&]
+	{
+		vector<thread> threads;
+		for (uint32_t t = 0; t < numThreads; ++t)
+		{
+			threads.emplace_back([&, t]
+			{
+				vector<uint32_t> results;
+				for (uint32_t q = t; q < numQueries; q += numThreads)
+				{
+					results.clear();
+					world.tree.QueryFrustum(frusta[q], results);
+					found[t] += results.size();
+				}
+			});
+		}
+		for (thread& worker : threads)
+			worker.join();
+	});
+
+	uint64_t total = 0;
+	for (uint64_t n : found)
+		total += n;
+
+	char name[64];
+	sprintf(name, "Frustum query, %u threads", numThreads);
+	printf("%-36s  %9.3f us  %10.1f found  %10.0f queries/s\n", name, seconds * 1e6 / numQueries,
+		(double)total / numQueries, numQueries / seconds);
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-objects <n>\n\tObjects in the world.  Defaults to 100000.\n"
+		"-queries <n>\n\tQueries of each kind to average.  Defaults to 1000.\n"
+		"-threads <n>\n\tThreads for the concurrent queries.  Defaults to the number of hardware threads.\n"
+		"-validate\n\tChecks the results against testing every object.  This is slow.\n"
+		"\n\nExample:  %s -objects 1000000 -validate\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numObjects = 100000;
+	uint32_t numQueries = 1000;
+	uint32_t numThreads = max(thread::hardware_concurrency(), 1u);
+	bool validate = false;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (strcmp("-validate", argv[arg]) == 0)
+				validate = true;
+			else if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-objects", argv[arg]) == 0)
+				numObjects = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-queries", argv[arg]) == 0)
+				numQueries = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-threads", argv[arg]) == 0)
+				numThreads = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numObjects == 0 || numQueries == 0 || numThreads == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ AABB tree benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	World world;
+	GenerateWorld(numObjects, world);
+
+	const double buildSeconds = TimeSeconds([&]
+	{
+		for (uint32_t i = 0; i < numObjects; ++i)
+		{
+			float lo[3], hi[3];
+			world.GetBox(i, lo, hi);
+			world.proxies[i] = world.tree.Insert(lo, hi, i);
+		}
+	});
+
+	printf("%u objects inserted in %.1f ms, height %u, area ratio %.1f\n\n", numObjects, buildSeconds * 1000.0,
+		world.tree.GetHeight(), world.tree.GetAreaRatio());
+
+	if (validate)
+		Validate("After inserting", world, numQueries);
+
+	TimeQueries(world, numQueries);
+	TimeConcurrentQueries(world, numQueries, 1);
+	if (numThreads > 1)
+		TimeConcurrentQueries(world, numQueries, numThreads);
+	printf("\n");
+
+	// A tenth of the objects drift a little each frame, and only those leaving their margin touch the tree
+	mt19937 rng(1357);
+	uniform_real_distribution<float> drift(-0.2f, 0.2f);
+	const uint32_t numFrames = 10;
+	const uint32_t numMoving = max(numObjects / 10, 1u);
+	uint64_t reinserted = 0;
+	double seconds = 0.0;
+	for (uint32_t frame = 0; frame < numFrames; ++frame)
+	{
+		for (uint32_t i = 0; i < numMoving; ++i)
+		{
+			const uint32_t object = i * 10 % numObjects;
+			float lo[3], hi[3];
+			world.GetBox(object, lo, hi);
+			for (int k = 0; k < 3; ++k)
+			{
+				const float d = drift(rng);
+				lo[k] += d;
+				hi[k] += d;
+			}
+			world.SetBox(object, lo, hi);
+		}
+
+		seconds += TimeSeconds([&]
+		{
+			for (uint32_t i = 0; i < numMoving; ++i)
+			{
+				const uint32_t object = i * 10 % numObjects;
+				float lo[3], hi[3];
+				world.GetBox(object, lo, hi);
+				reinserted += world.tree.Move(world.proxies[object], lo, hi) ? 1 : 0;
+			}
+		});
+	}
+	printf("%-36s  %9.3f ms  %10.0f reinserted\n", "Moving 10% of objects", seconds * 1000.0 / numFrames,
+		(double)reinserted / numFrames);
+
+	if (validate)
+		Validate("After moving", world, numQueries);
+
+	// Remove a tenth of the objects, then put them back somewhere else
+	uniform_real_distribution<float> position(-0.5f * world.size, 0.5f * world.size);
+	const uint32_t numRemoved = max(numObjects / 10, 1u);
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t i = 0; i < numRemoved; ++i)
+		{
+			const uint32_t object = (i * 10 + 5) % numObjects;
+			if (world.proxies[object] != DynamicAABBTree::kInvalidProxy)
+			{
+				world.tree.Remove(world.proxies[object]);
+				world.proxies[object] = DynamicAABBTree::kInvalidProxy;
+			}
+		}
+	});
+	printf("%-36s  %9.3f ms\n", "Removing 10% of objects", seconds * 1000.0);
+
+	if (validate)
+		Validate("After removing", world, numQueries);
+
+	for (uint32_t i = 0; i < numRemoved; ++i)
+	{
+		const uint32_t object = (i * 10 + 5) % numObjects;
+		float lo[3], hi[3];
+		world.GetBox(object, lo, hi);
+		const float dx = position(rng) - lo[0], dz = position(rng) - lo[2];
+		lo[0] += dx; hi[0] += dx;
+		lo[2] += dz; hi[2] += dz;
+		world.SetBox(object, lo, hi);
+	}
+
+	seconds = TimeSeconds([&]
+	{
+		for (uint32_t i = 0; i < numRemoved; ++i)
+		{
+			const uint32_t object = (i * 10 + 5) % numObjects;
+			if (world.proxies[object] == DynamicAABBTree::kInvalidProxy)
+			{
+				float lo[3], hi[3];
+				world.GetBox(object, lo, hi);
+				world.proxies[object] = world.tree.Insert(lo, hi, object);
+			}
+		}
+	});
+	printf("%-36s  %9.3f ms\n", "Reinserting them elsewhere", seconds * 1000.0);
+	printf("\nHeight %u, area ratio %.1f\n\n", world.tree.GetHeight(), world.tree.GetAreaRatio());
+
+	if (validate)
+	{
+		Validate("After reinserting", world, numQueries);
+		printf("\n");
+	}
+
+	return 0;
+}
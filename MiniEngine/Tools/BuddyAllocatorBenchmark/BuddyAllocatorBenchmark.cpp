@@ -0,0 +1,301 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures BuddyAllocatorCore under alloc/free churn:  a steady state where blocks of mixed orders are freed and
+// allocated at random, as a buddy heap sees while streaming, and filling then emptying the whole range with
+// blocks of one order.
+//
+// With -fuzz, random churn is checked against a map of which units are in use:  allocated blocks must be
+// aligned, within the range and never overlap, the free unit count must match, running out of memory must mean
+// no aligned free run of that order exists, and freeing everything must merge back to a single block.
+//
+
+#include "BuddyAllocatorCore.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Block
+{
+	uint32_t offset;
+	uint32_t order;
+};
+
+// Small blocks are far more common than large ones, as with buffers in a heap
+uint32_t RandomOrder( mt19937& rng, uint32_t maxOrder )
+{
+	const uint32_t largest = min(maxOrder, 10u);
+	uint32_t order = 0;
+	while (order < largest && (rng() & 3) == 0)
+		++order;
+	return order;
+}
+
+template <typename Func>
+double TimeSeconds( Func body )
+{
+	auto start = chrono::high_resolution_clock::now();
+	body();
+	return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// Half full of random blocks, then each operation frees a random block and allocates one of a random order
+void TimeChurn( uint32_t maxOrder, uint32_t numOps )
+{
+	BuddyAllocatorCore core;
+	core.Create(maxOrder);
+
+	mt19937 rng(1234);
+	vector<Block> live;
+	const size_t halfUnits = core.GetTotalUnits() / 2;
+	while (core.GetTotalUnits() - core.GetFreeUnits() < halfUnits)
+	{
+		Block block = { 0, RandomOrder(rng, maxOrder) };
+		if (core.AllocateBlock(block.order, block.offset) != kBuddySuccess)
+			break;
+		live.push_back(block);
+	}
+
+	// Decide everything up front so that only the allocator is timed
+	vector<uint32_t> victims(numOps), orders(numOps);
+	for (uint32_t i = 0; i < numOps; ++i)
+	{
+		victims[i] = rng();
+		orders[i] = RandomOrder(rng, maxOrder);
+	}
+
+	uint32_t failures = 0;
+	const double seconds = TimeSeconds([&]
+	{
+		for (uint32_t i = 0; i < numOps; ++i)
+		{
+			if (!live.empty())
+			{
+				const size_t victim = victims[i] % live.size();
+				core.DeallocateBlock(live[victim].offset, live[victim].order);
+				live[victim] = live.back();
+				live.pop_back();
+			}
+
+			Block block = { 0, orders[i] };
+			if (core.AllocateBlock(block.order, block.offset) == kBuddySuccess)
+				live.push_back(block);
+			else
+				++failures;
+		}
+	});
+
+	printf("%-32s  %8.1f ns per free and allocate  %6.2f%% full  %u failed\n", "Random churn, half full",
+		seconds * 1e9 / numOps, 100.0 * (core.GetTotalUnits() - core.GetFreeUnits()) / core.GetTotalUnits(), failures);
+}
+
+// Allocates the whole range in blocks of one order, then frees them in a shuffled order so that merges cascade
+void TimeFillAndEmpty( uint32_t maxOrder, uint32_t order )
+{
+	BuddyAllocatorCore core;
+	core.Create(maxOrder);
+
+	const uint32_t numBlocks = 1u << (maxOrder - order);
+	vector<uint32_t> offsets(numBlocks);
+
+	const double fillSeconds = TimeSeconds([&]
+	{
+		for (uint32_t i = 0; i < numBlocks; ++i)
+			core.AllocateBlock(order, offsets[i]);
+	});
+
+	shuffle(offsets.begin(), offsets.end(), mt19937(5678));
+
+	const double emptySeconds = TimeSeconds([&]
+	{
+		for (uint32_t i = 0; i < numBlocks; ++i)
+			core.DeallocateBlock(offsets[i], order);
+	});
+
+	char name[64];
+	sprintf(name, "Fill and empty, order %u", order);
+	printf("%-32s  %8.1f ns per allocate  %8.1f ns per free\n", name, fillSeconds * 1e9 / numBlocks,
+		emptySeconds * 1e9 / numBlocks);
+}
+
+// Whether some aligned run of (1 << order) units is entirely unused
+bool HasFreeRun( const vector<uint8_t>& used, uint32_t order )
+{
+	const size_t size = (size_t)1 << order;
+	for (size_t start = 0; start < used.size(); start += size)
+	{
+		if (find(used.begin() + start, used.begin() + start + size, 1) == used.begin() + start + size)
+			return true;
+	}
+	return false;
+}
+
+// Returns the number of errors found
+uint32_t Fuzz( uint32_t maxOrder, uint32_t numOps, uint32_t seed )
+{
+	BuddyAllocatorCore core;
+	core.Create(maxOrder);
+
+	mt19937 rng(seed);
+	vector<uint8_t> used(core.GetTotalUnits(), 0);
+	vector<Block> live;
+	size_t usedUnits = 0;
+	uint32_t errors = 0;
+
+	auto check = [&]( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  seed %u:  %s\n", seed, what);
+	};
+
+	for (uint32_t op = 0; op < numOps; ++op)
+	{
+		// Lean towards allocating while mostly empty and freeing while mostly full, so both extremes are visited
+		const bool allocate = live.empty() || (rng() % core.GetTotalUnits()) >= usedUnits;
+		if (allocate)
+		{
+			Block block = { 0, (uint32_t)(rng() % (maxOrder + 2)) };
+			const kBuddyResult result = core.AllocateBlock(block.order, block.offset);
+
+			if (block.order > maxOrder)
+			{
+				check(result == kBuddyInvalidOrder, "an order larger than the range was not rejected");
+				continue;
+			}
+
+			if (result == kBuddyOutOfMemory)
+			{
+				check(!HasFreeRun(used, block.order), "out of memory with a free run of the order available");
+				continue;
+			}
+
+			check(result == kBuddySuccess, "unexpected result");
+			check(block.offset % (1u << block.order) == 0, "block not aligned to its order");
+			check(block.offset + (1u << block.order) <= used.size(), "block outside the range");
+
+			for (uint32_t u = block.offset; u < block.offset + (1u << block.order) && u < used.size(); ++u)
+			{
+				check(used[u] == 0, "block overlaps another");
+				used[u] = 1;
+			}
+			usedUnits += (size_t)1 << block.order;
+			live.push_back(block);
+		}
+		else
+		{
+			const size_t victim = rng() % live.size();
+			const Block block = live[victim];
+			live[victim] = live.back();
+			live.pop_back();
+
+			core.DeallocateBlock(block.offset, block.order);
+			for (uint32_t u = block.offset; u < block.offset + (1u << block.order); ++u)
+				used[u] = 0;
+			usedUnits -= (size_t)1 << block.order;
+		}
+
+		check(core.GetFreeUnits() == core.GetTotalUnits() - usedUnits, "free unit count is wrong");
+	}
+
+	for (const Block& block : live)
+		core.DeallocateBlock(block.offset, block.order);
+
+	check(core.GetFreeUnits() == core.GetTotalUnits(), "units missing after freeing everything");
+	check(core.HasFreeBlock(maxOrder), "freeing everything did not merge back to one block");
+
+	// And the whole range must be allocatable again
+	uint32_t offset;
+	check(core.AllocateBlock(maxOrder, offset) == kBuddySuccess && offset == 0, "could not allocate the whole range");
+
+	return errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-order <n>\n\tThe range managed is 2^n units.  Defaults to 20.\n"
+		"-ops <n>\n\tOperations to time.  Defaults to 10000000.\n"
+		"-fuzz <n>\n\tRuns n seeds of random churn, with 2^10 units, checked against a map of used units.\n"
+		"\n\nExample:  %s -order 24 -fuzz 200\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t maxOrder = 20;
+	uint32_t numOps = 10000000;
+	uint32_t numSeeds = 0;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-order", argv[arg]) == 0)
+				maxOrder = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-ops", argv[arg]) == 0)
+				numOps = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-fuzz", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (maxOrder > 28 || numOps == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Buddy allocator benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+	printf("2^%u units\n\n", maxOrder);
+
+	TimeChurn(maxOrder, numOps);
+	TimeFillAndEmpty(maxOrder, 0);
+	TimeFillAndEmpty(maxOrder, maxOrder / 2);
+
+	if (numSeeds > 0)
+	{
+		// Small ranges fill up quickly, which is where the merging and out of memory paths get exercised
+		const uint32_t fuzzOrder = min(maxOrder, 10u);
+		uint32_t errors = 0;
+		for (uint32_t seed = 0; seed < numSeeds; ++seed)
+			errors += Fuzz(fuzzOrder, 20000, seed);
+		printf("\nFuzzed %u seeds of 20000 operations on 2^%u units:  %u errors\n", numSeeds, fuzzOrder, errors);
+		if (errors > 0)
+			return 1;
+	}
+
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,488 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Drives CommandAllocatorPool with fake allocators and a simulated fence, the way contexts use it:  every frame
+// records a few small command lists and a large one, and the GPU completes frames some way behind, now and then
+// falling far behind.
+//
+// Allocators must never be handed out while in use or before their fence has passed, must be reset exactly when
+// reused, and must be destroyed only while idle and exactly once.  Each request must get the allocator the policy
+// describes:  the smallest completed one that fits, or else the largest.  The statistics must agree with what the
+// fake factory saw.  The memory the allocators hold, which never shrinks, is compared with taking the oldest
+// completed allocator, as the pool used to.
+//
+
+#include "CommandAllocatorPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+class SimulatedFence : public IFenceSource
+{
+public:
+	SimulatedFence() : m_NextFenceValue(1), m_CompletedFenceValue(0) {}
+
+	uint64_t GetNextFenceValue() override { return m_NextFenceValue; }
+	bool IsFenceComplete( uint64_t fenceValue ) override { return fenceValue <= m_CompletedFenceValue; }
+
+	uint64_t Submit() { return m_NextFenceValue++; }
+	void Complete( uint64_t fenceValue ) { m_CompletedFenceValue = max(m_CompletedFenceValue, fenceValue); }
+
+private:
+	uint64_t m_NextFenceValue;
+	uint64_t m_CompletedFenceValue;
+};
+
+// What the factory knows about one allocator
+struct FakeAllocator
+{
+	enum State { kInUse, kRetired, kDestroyed };
+
+	State state;
+	uint64_t fenceValue;
+	size_t footprint;       // The most ever recorded into it, which Reset() doesn't give back
+	uint32_t resets;
+};
+
+class FakeFactory : public ICommandAllocatorFactory
+{
+public:
+	FakeFactory( Checker& checker ) : m_Checker(checker), m_NumCreated(0), m_NumResets(0), m_NumDestroyed(0) {}
+
+	~FakeFactory()
+	{
+		for (auto& entry : m_Allocators)
+			delete entry.second;
+	}
+
+	ID3D12CommandAllocator* CreateAllocator( void ) override
+	{
+		// Only the pointer matters to the pool
+		ID3D12CommandAllocator* allocator = (ID3D12CommandAllocator*)new char;
+		FakeAllocator* fake = new FakeAllocator;
+		// Not in use until the pool hands it out
+		fake->state = FakeAllocator::kRetired;
+		fake->fenceValue = 0;
+		fake->footprint = 0;
+		fake->resets = 0;
+		m_Allocators[allocator] = fake;
+		++m_NumCreated;
+		return allocator;
+	}
+
+	void ResetAllocator( ID3D12CommandAllocator* allocator ) override
+	{
+		FakeAllocator* fake = Find(allocator);
+		m_Checker.Check(fake != nullptr && fake->state == FakeAllocator::kRetired, "an allocator was reset while not retired");
+		m_Checker.Check(fake != nullptr && m_Fence->IsFenceComplete(fake->fenceValue), "an allocator was reset before its fence passed");
+		if (fake != nullptr)
+			++fake->resets;
+		++m_NumResets;
+	}
+
+	void DestroyAllocator( ID3D12CommandAllocator* allocator ) override
+	{
+		FakeAllocator* fake = Find(allocator);
+		m_Checker.Check(fake != nullptr && fake->state == FakeAllocator::kRetired, "an allocator was destroyed while not retired");
+		m_Checker.Check(fake != nullptr && m_Fence->IsFenceComplete(fake->fenceValue), "an allocator was destroyed before its fence passed");
+		if (fake != nullptr)
+			fake->state = FakeAllocator::kDestroyed;
+		delete (char*)allocator;
+		++m_NumDestroyed;
+	}
+
+	FakeAllocator* Find( ID3D12CommandAllocator* allocator )
+	{
+		auto iter = m_Allocators.find(allocator);
+		return iter == m_Allocators.end() || iter->second->state == FakeAllocator::kDestroyed ? nullptr : iter->second;
+	}
+
+	// The size the policy should pick from the retired allocators whose fence has passed, or 0 for a new one
+	bool ExpectedChoice( size_t expectedBytes, size_t& footprint )
+	{
+		bool found = false;
+		for (auto& entry : m_Allocators)
+		{
+			const FakeAllocator& fake = *entry.second;
+			if (fake.state != FakeAllocator::kRetired || !m_Fence->IsFenceComplete(fake.fenceValue))
+				continue;
+
+			const bool fits = fake.footprint >= expectedBytes;
+			const bool bestFits = found && footprint >= expectedBytes;
+			if (!found || (fits ? (!bestFits || fake.footprint < footprint) : (!bestFits && fake.footprint > footprint)))
+				footprint = fake.footprint;
+			found = true;
+		}
+		return found;
+	}
+
+	size_t TotalFootprint( void )
+	{
+		size_t total = 0;
+		for (auto& entry : m_Allocators)
+		{
+			if (entry.second->state != FakeAllocator::kDestroyed)
+				total += entry.second->footprint;
+		}
+		return total;
+	}
+
+	SimulatedFence* m_Fence;
+	Checker& m_Checker;
+	map<ID3D12CommandAllocator*, FakeAllocator*> m_Allocators;
+	size_t m_NumCreated;
+	size_t m_NumResets;
+	size_t m_NumDestroyed;
+};
+
+// A command list:  its allocator, what it recorded and what it asked for
+struct List
+{
+	ID3D12CommandAllocator* allocator;
+	size_t usedBytes;
+};
+
+struct Workload
+{
+	uint32_t numFrames;
+	uint32_t smallPerFrame;
+	uint32_t framesInFlight;
+};
+
+// Each context asks for what it recorded last time, as CommandContext does
+size_t SmallSize( mt19937& rng ) { return 4096 + rng() % 16384; }
+size_t LargeSize( mt19937& rng ) { return (1 << 20) + rng() % (1 << 20); }
+
+// Returns the number of errors found
+uint32_t CheckPolicy( const Workload& work, uint32_t seed )
+{
+	Checker checker;
+	SimulatedFence fence;
+	FakeFactory factory(checker);
+	factory.m_Fence = &fence;
+
+	CommandAllocatorPool pool;
+	pool.Create(&fence, &factory);
+
+	mt19937 rng(seed);
+	deque<uint64_t> frameFences;
+	size_t requests = 0, reusedBefore = 0;
+
+	for (uint32_t frame = 0; frame < work.numFrames; ++frame)
+	{
+		// Now and then a burst of extra lists, then a lull, so that allocators go idle and get trimmed
+		const uint32_t numSmall = (frame / 500) % 4 == 3 ? work.smallPerFrame * 4 : work.smallPerFrame;
+
+		// The large list is recorded at a different point every frame
+		const uint32_t largeIndex = rng() % (numSmall + 1);
+
+		vector<List> lists;
+		for (uint32_t i = 0; i <= numSmall; ++i)
+		{
+			const bool large = i == largeIndex;
+			const size_t usedBytes = large ? LargeSize(rng) : SmallSize(rng);
+			const size_t expectedBytes = large ? (1 << 20) : 4096;
+
+			size_t expectedFootprint = 0;
+			const bool expectReuse = factory.ExpectedChoice(expectedBytes, expectedFootprint);
+			const size_t createdBefore = factory.m_NumCreated;
+
+			ID3D12CommandAllocator* allocator = pool.RequestAllocator(expectedBytes);
+			++requests;
+
+			FakeAllocator* fake = factory.Find(allocator);
+			checker.Check(fake != nullptr, "the pool handed out an allocator that does not exist");
+			if (fake == nullptr)
+				continue;
+
+			const bool created = factory.m_NumCreated != createdBefore;
+			checker.Check(created || fake->state == FakeAllocator::kRetired, "an allocator was handed out while in use");
+			checker.Check(created || fence.IsFenceComplete(fake->fenceValue), "an allocator was handed out before its fence passed");
+			checker.Check(created != expectReuse, "a completed allocator was passed over, or a new one was not created");
+			checker.Check(created || fake->footprint == expectedFootprint, "the allocator chosen is not the best fit");
+
+			fake->state = FakeAllocator::kInUse;
+			fake->footprint = max(fake->footprint, usedBytes);
+			lists.push_back({ allocator, usedBytes });
+		}
+
+		const uint64_t fenceValue = fence.Submit();
+		for (const List& list : lists)
+		{
+			FakeAllocator* fake = factory.Find(list.allocator);
+			fake->state = FakeAllocator::kRetired;
+			fake->fenceValue = fenceValue;
+			pool.DiscardAllocator(fenceValue, list.allocator, list.usedBytes);
+		}
+
+		// Now and then the GPU falls far behind, so that allocators sit retired for long without completing
+		const bool hitch = frame % 1000 >= 800 && frame % 1000 < 900;
+
+		frameFences.push_back(fenceValue);
+		while (!hitch && frameFences.size() > work.framesInFlight)
+		{
+			fence.Complete(frameFences.front());
+			frameFences.pop_front();
+		}
+
+		if (frame == work.numFrames / 2)
+			reusedBefore = factory.m_NumResets;
+	}
+
+	const CommandAllocatorPool::Statistics stats = pool.GetStatistics();
+	checker.Check(stats.Created == factory.m_NumCreated, "the pool's count of created allocators is wrong");
+	checker.Check(stats.Reused == factory.m_NumResets, "the pool's count of reused allocators is wrong");
+	checker.Check(stats.Trimmed == factory.m_NumDestroyed, "the pool's count of trimmed allocators is wrong");
+	checker.Check(stats.NumLive == factory.m_NumCreated - factory.m_NumDestroyed, "the pool's count of live allocators is wrong");
+	checker.Check(stats.Created + stats.Reused == requests, "requests were neither created nor reused");
+	checker.Check(stats.HighWaterBytes == factory.TotalFootprint(), "the pool's high-water total is wrong");
+	checker.Check(stats.Trimmed > 0, "no idle allocator was ever trimmed");
+	checker.Check(factory.m_NumResets > reusedBefore, "allocators stopped being reused");
+
+	// Once the GPU is done, everything left is destroyed exactly once
+	fence.Complete(fence.GetNextFenceValue() - 1);
+	pool.Shutdown();
+	checker.Check(factory.m_NumDestroyed == factory.m_NumCreated, "Shutdown() did not destroy every allocator");
+
+	printf("seed %-4u  %6zu created  %7zu reused  %5zu stalls  %5zu trimmed  %6.1f MB held at the end  %u errors\n", seed,
+		stats.Created, stats.Reused, stats.Stalls, stats.Trimmed, stats.HighWaterBytes / 1048576.0, checker.errors);
+
+	return checker.errors;
+}
+
+// The memory held by allocators, with the pool's choice and with the oldest completed allocator
+void CompareFootprint( const Workload& work )
+{
+	mt19937 rng(1);
+
+	struct Fifo
+	{
+		deque<pair<uint64_t, size_t>> retired;   // Fence value and footprint, oldest first
+		size_t total;
+	} fifo = { {}, 0 };
+
+	Checker checker;
+	SimulatedFence fence;
+	FakeFactory factory(checker);
+	factory.m_Fence = &fence;
+	CommandAllocatorPool pool;
+	pool.Create(&fence, &factory);
+
+	deque<uint64_t> frameFences;
+	for (uint32_t frame = 0; frame < work.numFrames; ++frame)
+	{
+		const uint32_t largeIndex = rng() % (work.smallPerFrame + 1);
+
+		vector<List> lists;
+		vector<size_t> fifoLists;
+		for (uint32_t i = 0; i <= work.smallPerFrame; ++i)
+		{
+			const bool large = i == largeIndex;
+			const size_t usedBytes = large ? LargeSize(rng) : SmallSize(rng);
+
+			ID3D12CommandAllocator* allocator = pool.RequestAllocator(large ? (1 << 20) : 4096);
+			FakeAllocator* fake = factory.Find(allocator);
+			fake->state = FakeAllocator::kInUse;
+			fake->footprint = max(fake->footprint, usedBytes);
+			lists.push_back({ allocator, usedBytes });
+
+			// The old pool only looked at the front of its queue
+			size_t footprint = 0;
+			if (!fifo.retired.empty() && fence.IsFenceComplete(fifo.retired.front().first))
+			{
+				footprint = fifo.retired.front().second;
+				fifo.retired.pop_front();
+			}
+			fifo.total += max(footprint, usedBytes) - footprint;
+			fifoLists.push_back(max(footprint, usedBytes));
+		}
+
+		const uint64_t fenceValue = fence.Submit();
+		for (const List& list : lists)
+		{
+			FakeAllocator* fake = factory.Find(list.allocator);
+			fake->state = FakeAllocator::kRetired;
+			fake->fenceValue = fenceValue;
+			pool.DiscardAllocator(fenceValue, list.allocator, list.usedBytes);
+		}
+		for (size_t footprint : fifoLists)
+			fifo.retired.push_back(make_pair(fenceValue, footprint));
+
+		frameFences.push_back(fenceValue);
+		while (frameFences.size() > work.framesInFlight)
+		{
+			fence.Complete(frameFences.front());
+			frameFences.pop_front();
+		}
+	}
+
+	printf("\nAllocator memory after %u frames of %u small lists and one large:  %.1f MB best fit, %.1f MB oldest first\n",
+		work.numFrames, work.smallPerFrame, pool.GetStatistics().HighWaterBytes / 1048576.0, fifo.total / 1048576.0);
+
+	fence.Complete(fence.GetNextFenceValue() - 1);
+	pool.Shutdown();
+}
+
+// Returns the number of errors found
+uint32_t CheckThreads( uint32_t numThreads )
+{
+	Checker checker;
+	SimulatedFence fence;
+	FakeFactory factory(checker);
+	factory.m_Fence = &fence;
+
+	// Every value completes at once, so that only the pool's own locking is tested
+	fence.Complete(~0ull >> 1);
+
+	// The pool calls the factory under its own lock, but the threads below look at the fake allocators too
+	mutex factoryMutex;
+	class LockedFactory : public ICommandAllocatorFactory
+	{
+	public:
+		LockedFactory( FakeFactory& factory, mutex& m ) : m_Factory(factory), m_Mutex(m) {}
+		ID3D12CommandAllocator* CreateAllocator( void ) override { lock_guard<mutex> guard(m_Mutex); return m_Factory.CreateAllocator(); }
+		void ResetAllocator( ID3D12CommandAllocator* a ) override { lock_guard<mutex> guard(m_Mutex); m_Factory.ResetAllocator(a); }
+		void DestroyAllocator( ID3D12CommandAllocator* a ) override { lock_guard<mutex> guard(m_Mutex); m_Factory.DestroyAllocator(a); }
+	private:
+		FakeFactory& m_Factory;
+		mutex& m_Mutex;
+	} lockedFactory(factory, factoryMutex);
+
+	CommandAllocatorPool pool;
+	pool.Create(&fence, &lockedFactory);
+
+	vector<thread> threads;
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			mt19937 rng(t);
+			for (uint32_t i = 0; i < 20000; ++i)
+			{
+				ID3D12CommandAllocator* allocator = pool.RequestAllocator(SmallSize(rng));
+				{
+					lock_guard<mutex> guard(factoryMutex);
+					FakeAllocator* fake = factory.Find(allocator);
+					checker.Check(fake != nullptr && fake->state != FakeAllocator::kInUse, "an allocator was handed to two threads");
+					if (fake != nullptr)
+						fake->state = FakeAllocator::kInUse;
+				}
+				{
+					lock_guard<mutex> guard(factoryMutex);
+					factory.Find(allocator)->state = FakeAllocator::kRetired;
+				}
+				pool.DiscardAllocator(1, allocator, SmallSize(rng));
+			}
+		});
+	}
+	for (thread& worker : threads)
+		worker.join();
+
+	const CommandAllocatorPool::Statistics stats = pool.GetStatistics();
+	checker.Check(stats.Created + stats.Reused == (size_t)numThreads * 20000, "requests from several threads were lost");
+	checker.Check(stats.NumLive <= numThreads, "threads created allocators they did not need");
+
+	pool.Shutdown();
+	checker.Check(factory.m_NumDestroyed == factory.m_NumCreated, "Shutdown() did not destroy every allocator");
+
+	printf("\n%u threads:  %zu created  %zu reused  %u errors\n", numThreads, stats.Created, stats.Reused, checker.errors);
+
+	return checker.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-frames <n>\n\tFrames simulated per seed.  Defaults to 5000.\n"
+		"-lists <n>\n\tSmall command lists per frame, besides the large one.  Defaults to 6.\n"
+		"-latency <n>\n\tFrames the GPU runs behind.  Defaults to 3.\n"
+		"-seeds <n>\n\tRuns repeated with different seeds.  Defaults to 4.\n"
+		"\n\nExample:  %s -lists 20 -latency 2\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	Workload work = { 5000, 6, 3 };
+	uint32_t numSeeds = 4;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-frames", argv[arg]) == 0)
+				work.numFrames = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-lists", argv[arg]) == 0)
+				work.smallPerFrame = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-latency", argv[arg]) == 0)
+				work.framesInFlight = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seeds", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (work.numFrames < 2000 || work.framesInFlight == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Command allocator pool benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = 0;
+	for (uint32_t seed = 0; seed < numSeeds; ++seed)
+		errors += CheckPolicy(work, seed);
+	CompareFootprint(work);
+	errors += CheckThreads(4);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
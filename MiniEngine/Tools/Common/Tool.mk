@@ -0,0 +1,36 @@
+#
+# Shared rules for building the tools here without the rest of the engine, for platforms other than Windows.  A
+# tool's Makefile sets TARGET, SOURCES (its own), ENGINE_SOURCES (under Core) and HEADERS, then includes this.
+# ENGINE_HEADERS names the Core headers that include "pch.h" themselves, if any.
+#
+# Engine sources include "pch.h", which the compiler looks for next to them first, and Core/pch.h pulls in the
+# Windows headers.  So they are compiled from copies in the build directory, where Common/pch.h is found instead.
+# The copies begin with #line, so diagnostics still name the originals.
+#
+
+CXX ?= g++
+CXXFLAGS ?= -O2
+override CXXFLAGS += -std=c++14 -Wall -I$(BUILD_DIR) -I../Common -I../../Core -I../../Core/Math -pthread
+
+BUILD_DIR = build
+ENGINE_COPIES = $(addprefix $(BUILD_DIR)/,$(notdir $(ENGINE_SOURCES)))
+ENGINE_HEADER_COPIES = $(addprefix $(BUILD_DIR)/,$(notdir $(ENGINE_HEADERS)))
+
+vpath %.cpp $(sort $(dir $(ENGINE_SOURCES)))
+vpath %.h $(sort $(dir $(ENGINE_HEADERS)))
+
+$(TARGET): $(SOURCES) $(ENGINE_COPIES) $(ENGINE_HEADER_COPIES) $(HEADERS) ../Common/pch.h
+	$(CXX) $(CXXFLAGS) -o $@ $(SOURCES) $(ENGINE_COPIES) $(LDLIBS)
+
+$(BUILD_DIR)/%.cpp: %.cpp
+	@mkdir -p $(BUILD_DIR)
+	{ echo '#line 1 "$<"'; cat $<; } > $@
+
+$(BUILD_DIR)/%.h: %.h
+	@mkdir -p $(BUILD_DIR)
+	{ echo '#line 1 "$<"'; cat $<; } > $@
+
+clean:
+	rm -rf $(TARGET) $(BUILD_DIR)
+
+.PHONY: clean
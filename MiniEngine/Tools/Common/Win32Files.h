@@ -0,0 +1,402 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Stands in for the Win32 file, mapping and completion port calls that FileSystem.cpp makes, over POSIX, so that
+// tools built with Tool.mk can include it.  A tool's Makefile force-includes this (-include Win32Files.h) ahead
+// of everything else.  Overlapped reads are done at once with pread() and their completions queued to the port,
+// so a completion port here only shows the cost of its bookkeeping, not of reads overlapping.
+//
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef unsigned char byte;
+typedef uint32_t DWORD;
+typedef int BOOL;
+typedef uintptr_t ULONG_PTR;
+typedef void* PVOID;
+
+#define MAXDWORD	0xffffffffu
+#define INFINITE	0xffffffffu
+#define ERROR_IO_PENDING	997
+#define INVALID_FILE_ATTRIBUTES	((DWORD)-1)
+#define FILE_ATTRIBUTE_DIRECTORY	0x10
+
+// Only what the engine passes, none of which changes what these stand-ins do
+#define GENERIC_READ	0x80000000u
+#define FILE_SHARE_READ	0x1
+#define OPEN_EXISTING	3
+#define FILE_FLAG_SEQUENTIAL_SCAN	0x08000000
+#define FILE_FLAG_RANDOM_ACCESS	0x10000000
+#define FILE_FLAG_OVERLAPPED	0x40000000
+#define PAGE_READONLY	0x02
+#define FILE_MAP_READ	0x04
+
+// Not a desktop app, so command line handling is compiled out
+#define WINAPI_FAMILY_PARTITION( Partition )	0
+
+#define ZeroMemory( Destination, Length )	memset((Destination), 0, (Length))
+
+union LARGE_INTEGER
+{
+	long long QuadPart;
+};
+
+struct OVERLAPPED
+{
+	ULONG_PTR Internal;
+	ULONG_PTR InternalHigh;
+	DWORD Offset;
+	DWORD OffsetHigh;
+	void* hEvent;
+};
+
+struct WIN32_MEMORY_RANGE_ENTRY
+{
+	PVOID VirtualAddress;
+	size_t NumberOfBytes;
+};
+
+enum GET_FILEEX_INFO_LEVELS
+{
+	GetFileExInfoStandard
+};
+
+struct WIN32_FILE_ATTRIBUTE_DATA
+{
+	DWORD dwFileAttributes;
+	DWORD nFileSizeHigh;
+	DWORD nFileSizeLow;
+};
+
+// Files, mappings and completion ports are all handles
+struct Win32Handle
+{
+	virtual ~Win32Handle() {}
+};
+
+typedef Win32Handle* HANDLE;
+
+#define INVALID_HANDLE_VALUE	((HANDLE)(intptr_t)-1)
+
+// From Utility.h.  Utility.cpp needs the Windows headers, so its MakeUTF8() is repeated here, where wchar_t is
+// UTF-32 and there are no surrogates to join.
+inline std::string MakeUTF8( const std::wstring& str )
+{
+	std::string Result;
+	Result.reserve(str.size());
+
+	for (wchar_t w : str)
+	{
+		uint32_t c = (uint32_t)w;
+		if (c >= 0xD800 && c < 0xE000)
+			c = 0xFFFD;
+
+		if (c < 0x80)
+		{
+			Result += (char)c;
+		}
+		else if (c < 0x800)
+		{
+			Result += (char)(0xC0 | c >> 6);
+			Result += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			Result += (char)(0xE0 | c >> 12);
+			Result += (char)(0x80 | (c >> 6 & 0x3F));
+			Result += (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			Result += (char)(0xF0 | c >> 18);
+			Result += (char)(0x80 | (c >> 12 & 0x3F));
+			Result += (char)(0x80 | (c >> 6 & 0x3F));
+			Result += (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	return Result;
+}
+
+namespace Win32Files
+{
+	struct CompletionPort : public Win32Handle
+	{
+		struct Packet
+		{
+			DWORD BytesTransferred;
+			ULONG_PTR Key;
+			OVERLAPPED* Overlapped;
+			BOOL Succeeded;
+		};
+
+		void Post( const Packet& NewPacket )
+		{
+			{
+				std::lock_guard<std::mutex> Guard(Mutex);
+				Packets.push_back(NewPacket);
+			}
+			Posted.notify_one();
+		}
+
+		std::mutex Mutex;
+		std::condition_variable Posted;
+		std::deque<Packet> Packets;
+	};
+
+	struct File : public Win32Handle
+	{
+		File( int Descriptor, bool Overlapped ) : Fd(Descriptor), IsOverlapped(Overlapped), Port(nullptr) {}
+		~File() { close(Fd); }
+
+		int Fd;
+		bool IsOverlapped;
+		CompletionPort* Port;
+	};
+
+	struct Mapping : public Win32Handle
+	{
+		Mapping( int Descriptor, size_t MappingSize ) : Fd(dup(Descriptor)), Size(MappingSize) {}
+		~Mapping() { close(Fd); }
+
+		int Fd;
+		size_t Size;
+	};
+
+	// The size of each view, which UnmapViewOfFile() isn't told
+	inline std::mutex& ViewMutex( void ) { static std::mutex s_Mutex; return s_Mutex; }
+	inline std::map<const void*, size_t>& ViewSizes( void ) { static std::map<const void*, size_t> s_Sizes; return s_Sizes; }
+
+	inline DWORD& LastError( void ) { static thread_local DWORD s_LastError = 0; return s_LastError; }
+
+	// Either slash
+	inline std::string NarrowPath( const wchar_t* Path )
+	{
+		std::string Narrow = MakeUTF8(Path);
+		for (char& c : Narrow)
+		{
+			if (c == '\\')
+				c = '/';
+		}
+		return Narrow;
+	}
+}
+
+inline DWORD GetLastError( void )
+{
+	return Win32Files::LastError();
+}
+
+inline HANDLE CreateFileW( const wchar_t* FileName, DWORD, DWORD, void*, DWORD, DWORD FlagsAndAttributes, HANDLE )
+{
+	const int Fd = open(Win32Files::NarrowPath(FileName).c_str(), O_RDONLY | O_CLOEXEC);
+	if (Fd < 0)
+		return INVALID_HANDLE_VALUE;
+
+	struct stat Stat;
+	if (fstat(Fd, &Stat) != 0 || S_ISDIR(Stat.st_mode))
+	{
+		close(Fd);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return new Win32Files::File(Fd, (FlagsAndAttributes & FILE_FLAG_OVERLAPPED) != 0);
+}
+
+inline BOOL CloseHandle( HANDLE Handle )
+{
+	delete Handle;
+	return 1;
+}
+
+inline BOOL GetFileSizeEx( HANDLE Handle, LARGE_INTEGER* FileSize )
+{
+	struct stat Stat;
+	if (fstat(static_cast<Win32Files::File*>(Handle)->Fd, &Stat) != 0)
+		return 0;
+
+	FileSize->QuadPart = Stat.st_size;
+	return 1;
+}
+
+inline DWORD GetFileAttributesW( const wchar_t* FileName )
+{
+	struct stat Stat;
+	if (stat(Win32Files::NarrowPath(FileName).c_str(), &Stat) != 0)
+		return INVALID_FILE_ATTRIBUTES;
+
+	return S_ISDIR(Stat.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : 0;
+}
+
+inline BOOL GetFileAttributesExW( const wchar_t* FileName, GET_FILEEX_INFO_LEVELS, WIN32_FILE_ATTRIBUTE_DATA* Data )
+{
+	struct stat Stat;
+	if (stat(Win32Files::NarrowPath(FileName).c_str(), &Stat) != 0)
+		return 0;
+
+	Data->dwFileAttributes = S_ISDIR(Stat.st_mode) ? FILE_ATTRIBUTE_DIRECTORY : 0;
+	Data->nFileSizeHigh = (DWORD)((uint64_t)Stat.st_size >> 32);
+	Data->nFileSizeLow = (DWORD)Stat.st_size;
+	return 1;
+}
+
+// Maps the whole file, as the engine always does
+inline HANDLE CreateFileMappingW( HANDLE FileHandle, void*, DWORD, DWORD, DWORD, const wchar_t* )
+{
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(FileHandle, &FileSize) || FileSize.QuadPart == 0)
+		return nullptr;
+
+	return new Win32Files::Mapping(static_cast<Win32Files::File*>(FileHandle)->Fd, (size_t)FileSize.QuadPart);
+}
+
+inline void* MapViewOfFile( HANDLE MappingHandle, DWORD, DWORD, DWORD, size_t )
+{
+	const Win32Files::Mapping* Mapping = static_cast<Win32Files::Mapping*>(MappingHandle);
+	void* Base = mmap(nullptr, Mapping->Size, PROT_READ, MAP_PRIVATE, Mapping->Fd, 0);
+	if (Base == MAP_FAILED)
+		return nullptr;
+
+	std::lock_guard<std::mutex> Guard(Win32Files::ViewMutex());
+	Win32Files::ViewSizes()[Base] = Mapping->Size;
+	return Base;
+}
+
+inline BOOL UnmapViewOfFile( const void* Base )
+{
+	std::lock_guard<std::mutex> Guard(Win32Files::ViewMutex());
+	auto Iter = Win32Files::ViewSizes().find(Base);
+	if (Iter == Win32Files::ViewSizes().end())
+		return 0;
+
+	munmap(const_cast<void*>(Base), Iter->second);
+	Win32Files::ViewSizes().erase(Iter);
+	return 1;
+}
+
+inline BOOL ReadFile( HANDLE Handle, void* Buffer, DWORD BytesToRead, DWORD* BytesRead, OVERLAPPED* Overlapped )
+{
+	Win32Files::File* File = static_cast<Win32Files::File*>(Handle);
+
+	if (!File->IsOverlapped)
+	{
+		const ssize_t Read = read(File->Fd, Buffer, BytesToRead);
+		if (BytesRead != nullptr)
+			*BytesRead = Read < 0 ? 0 : (DWORD)Read;
+		return Read >= 0;
+	}
+
+	if (Overlapped == nullptr || File->Port == nullptr)
+		return 0;
+
+	const off_t Offset = (off_t)((uint64_t)Overlapped->OffsetHigh << 32 | Overlapped->Offset);
+	const ssize_t Read = pread(File->Fd, Buffer, BytesToRead, Offset);
+
+	const Win32Files::CompletionPort::Packet Completion = { Read < 0 ? 0 : (DWORD)Read, 0, Overlapped, Read >= 0 };
+	File->Port->Post(Completion);
+
+	Win32Files::LastError() = ERROR_IO_PENDING;
+	return 0;
+}
+
+inline HANDLE CreateIoCompletionPort( HANDLE FileHandle, HANDLE ExistingPort, ULONG_PTR, DWORD )
+{
+	if (FileHandle == INVALID_HANDLE_VALUE)
+		return new Win32Files::CompletionPort;
+
+	static_cast<Win32Files::File*>(FileHandle)->Port = static_cast<Win32Files::CompletionPort*>(ExistingPort);
+	return ExistingPort;
+}
+
+inline BOOL PostQueuedCompletionStatus( HANDLE PortHandle, DWORD BytesTransferred, ULONG_PTR Key, OVERLAPPED* Overlapped )
+{
+	const Win32Files::CompletionPort::Packet Completion = { BytesTransferred, Key, Overlapped, 1 };
+	static_cast<Win32Files::CompletionPort*>(PortHandle)->Post(Completion);
+	return 1;
+}
+
+inline BOOL GetQueuedCompletionStatus( HANDLE PortHandle, DWORD* BytesTransferred, ULONG_PTR* Key, OVERLAPPED** Overlapped, DWORD )
+{
+	Win32Files::CompletionPort* Port = static_cast<Win32Files::CompletionPort*>(PortHandle);
+
+	std::unique_lock<std::mutex> Lock(Port->Mutex);
+	Port->Posted.wait(Lock, [Port] { return !Port->Packets.empty(); });
+
+	const Win32Files::CompletionPort::Packet Completion = Port->Packets.front();
+	Port->Packets.pop_front();
+
+	*BytesTransferred = Completion.BytesTransferred;
+	*Key = Completion.Key;
+	*Overlapped = Completion.Overlapped;
+	return Completion.Succeeded;
+}
+
+inline HANDLE GetCurrentProcess( void )
+{
+	return nullptr;
+}
+
+inline BOOL PrefetchVirtualMemory( HANDLE, size_t NumEntries, WIN32_MEMORY_RANGE_ENTRY* Entries, DWORD )
+{
+	const uintptr_t PageMask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+	for (size_t i = 0; i < NumEntries; ++i)
+	{
+		const uintptr_t Start = (uintptr_t)Entries[i].VirtualAddress & ~PageMask;
+		const uintptr_t End = (uintptr_t)Entries[i].VirtualAddress + Entries[i].NumberOfBytes;
+		madvise((void*)Start, End - Start, MADV_WILLNEED);
+	}
+	return 1;
+}
+
+// From Utility.h
+namespace Utility
+{
+	inline void Printf( const char* Format, ... )
+	{
+		va_list Args;
+		va_start(Args, Format);
+		vfprintf(stderr, Format, Args);
+		va_end(Args);
+	}
+
+	// %s is a wide string here, as with MSVC
+	inline void Printf( const wchar_t* Format, ... )
+	{
+		std::wstring PosixFormat;
+		for (; *Format != L'\0'; ++Format)
+		{
+			PosixFormat += *Format;
+			if (Format[0] == L'%' && Format[1] == L's')
+				PosixFormat += L'l';
+		}
+
+		wchar_t Buffer[1024];
+		va_list Args;
+		va_start(Args, Format);
+		vswprintf(Buffer, 1024, PosixFormat.c_str(), Args);
+		va_end(Args);
+		fputs(MakeUTF8(Buffer).c_str(), stderr);
+	}
+}
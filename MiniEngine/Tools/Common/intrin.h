@@ -0,0 +1,17 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Stands in for the MSVC header in engine sources built with Tool.mk.  gcc and clang declare the same x86
+// intrinsics, __rdtsc() among them, in x86intrin.h.  The _BitScan functions are in pch.h.
+//
+
+#pragma once
+
+#include <x86intrin.h>
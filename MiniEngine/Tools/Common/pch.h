@@ -0,0 +1,200 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Stands in for the engine's precompiled header when engine sources are built into the tools on their own, as
+// with Tool.mk here.  It supplies only what those sources need from Core/pch.h without the Windows headers.
+// Visual Studio builds find Core/pch.h instead.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#ifdef _DEBUG
+#define ASSERT( isTrue, ... ) \
+	if (!(bool)(isTrue)) { fprintf(stderr, "Assertion failed in %s @ %d: '%s' is false\n", __FILE__, __LINE__, #isTrue); abort(); }
+#else
+#define ASSERT( isTrue, ... ) (void)(isTrue)
+#endif
+
+// From d3d12.h, for engine sources that only pass handles and barriers around
+typedef uint32_t UINT;
+
+struct ID3D12Resource;
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE
+{
+	size_t ptr;
+};
+
+enum D3D12_RESOURCE_STATES
+{
+	D3D12_RESOURCE_STATE_COMMON = 0,
+	D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER = 0x1,
+	D3D12_RESOURCE_STATE_INDEX_BUFFER = 0x2,
+	D3D12_RESOURCE_STATE_RENDER_TARGET = 0x4,
+	D3D12_RESOURCE_STATE_UNORDERED_ACCESS = 0x8,
+	D3D12_RESOURCE_STATE_DEPTH_WRITE = 0x10,
+	D3D12_RESOURCE_STATE_DEPTH_READ = 0x20,
+	D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE = 0x40,
+	D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE = 0x80,
+	D3D12_RESOURCE_STATE_STREAM_OUT = 0x100,
+	D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT = 0x200,
+	D3D12_RESOURCE_STATE_COPY_DEST = 0x400,
+	D3D12_RESOURCE_STATE_COPY_SOURCE = 0x800,
+	D3D12_RESOURCE_STATE_RESOLVE_DEST = 0x1000,
+	D3D12_RESOURCE_STATE_RESOLVE_SOURCE = 0x2000,
+	D3D12_RESOURCE_STATE_GENERIC_READ = 0xac3,
+	D3D12_RESOURCE_STATE_PRESENT = 0
+};
+
+inline D3D12_RESOURCE_STATES operator|( D3D12_RESOURCE_STATES a, D3D12_RESOURCE_STATES b )
+{
+	return (D3D12_RESOURCE_STATES)((uint32_t)a | (uint32_t)b);
+}
+
+inline D3D12_RESOURCE_STATES operator&( D3D12_RESOURCE_STATES a, D3D12_RESOURCE_STATES b )
+{
+	return (D3D12_RESOURCE_STATES)((uint32_t)a & (uint32_t)b);
+}
+
+enum D3D12_RESOURCE_BARRIER_TYPE
+{
+	D3D12_RESOURCE_BARRIER_TYPE_TRANSITION = 0,
+	D3D12_RESOURCE_BARRIER_TYPE_ALIASING = 1,
+	D3D12_RESOURCE_BARRIER_TYPE_UAV = 2
+};
+
+enum D3D12_RESOURCE_BARRIER_FLAGS
+{
+	D3D12_RESOURCE_BARRIER_FLAG_NONE = 0,
+	D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY = 0x1,
+	D3D12_RESOURCE_BARRIER_FLAG_END_ONLY = 0x2
+};
+
+#define D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES	0xffffffff
+
+struct D3D12_RESOURCE_TRANSITION_BARRIER
+{
+	ID3D12Resource* pResource;
+	UINT Subresource;
+	D3D12_RESOURCE_STATES StateBefore;
+	D3D12_RESOURCE_STATES StateAfter;
+};
+
+struct D3D12_RESOURCE_ALIASING_BARRIER
+{
+	ID3D12Resource* pResourceBefore;
+	ID3D12Resource* pResourceAfter;
+};
+
+struct D3D12_RESOURCE_UAV_BARRIER
+{
+	ID3D12Resource* pResource;
+};
+
+struct D3D12_RESOURCE_BARRIER
+{
+	D3D12_RESOURCE_BARRIER_TYPE Type;
+	D3D12_RESOURCE_BARRIER_FLAGS Flags;
+	union
+	{
+		D3D12_RESOURCE_TRANSITION_BARRIER Transition;
+		D3D12_RESOURCE_ALIASING_BARRIER Aliasing;
+		D3D12_RESOURCE_UAV_BARRIER UAV;
+	};
+};
+
+// From Math/Common.h, which needs DirectXMath
+namespace Math
+{
+	template <typename T> inline T AlignUpWithMask( T value, size_t mask )
+	{
+		return (T)(((size_t)value + mask) & ~mask);
+	}
+
+	template <typename T> inline T AlignUp( T value, size_t alignment )
+	{
+		return AlignUpWithMask(value, alignment - 1);
+	}
+
+	template <typename T> inline bool IsPowerOfTwo( T value )
+	{
+		return 0 == (value & (value - 1));
+	}
+}
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+// The MSVC intrinsics the engine uses, with the same contract:  false when Mask is zero, when Index is meaningless.
+// It is zeroed anyway so that gcc can tell it is never read uninitialized.
+inline unsigned char _BitScanForward( unsigned long* Index, uint32_t Mask )
+{
+	if (Mask == 0)
+	{
+		*Index = 0;
+		return 0;
+	}
+	*Index = (unsigned long)__builtin_ctz(Mask);
+	return 1;
+}
+
+inline unsigned char _BitScanForward64( unsigned long* Index, uint64_t Mask )
+{
+	if (Mask == 0)
+	{
+		*Index = 0;
+		return 0;
+	}
+	*Index = (unsigned long)__builtin_ctzll(Mask);
+	return 1;
+}
+
+inline unsigned char _BitScanReverse( unsigned long* Index, uint32_t Mask )
+{
+	if (Mask == 0)
+	{
+		*Index = 0;
+		return 0;
+	}
+	*Index = 31ul - (unsigned long)__builtin_clz(Mask);
+	return 1;
+}
+
+inline unsigned char _BitScanReverse64( unsigned long* Index, uint64_t Mask )
+{
+	if (Mask == 0)
+	{
+		*Index = 0;
+		return 0;
+	}
+	*Index = 63ul - (unsigned long)__builtin_clzll(Mask);
+	return 1;
+}
+
+// dds.h defines its constants in the header, which MSVC lets every source include with selectany
+#define __declspec( x ) __declspec_##x
+#define __declspec_selectany __attribute__((weak))
+
+// Numbers threads in the order they first ask, which is all the engine needs of the Win32 call
+inline uint32_t GetCurrentThreadId( void )
+{
+	static std::atomic<uint32_t> s_NextThreadId(1);
+	thread_local uint32_t t_ThreadId = s_NextThreadId++;
+	return t_ThreadId;
+}
+#endif
@@ -0,0 +1,116 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Stands in for the Parallel Patterns Library (and ppltasks.h) when engine sources are built with Tool.mk, like
+// pch.h here.  parallel_for runs on one thread per hardware thread, which take indices in turn.  Tasks are only
+// as much as the engine uses:  a continuation runs on whichever thread first waits for its result, rather than
+// on a thread pool, which gives the same results.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace concurrency
+{
+	template <typename Index, typename Function>
+	void parallel_for( Index First, Index Last, const Function& Func )
+	{
+		if (First >= Last)
+			return;
+
+		std::atomic<Index> Next(First);
+		auto Worker = [&]
+		{
+			for (Index i = Next++; i < Last; i = Next++)
+				Func(i);
+		};
+
+		const size_t NumThreads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), (size_t)(Last - First));
+
+		std::vector<std::thread> Threads;
+		for (size_t i = 1; i < NumThreads; ++i)
+			Threads.emplace_back(Worker);
+
+		Worker();
+
+		for (auto& Thread : Threads)
+			Thread.join();
+	}
+
+	template <typename T> class task;
+
+	template <typename T>
+	class task_completion_event
+	{
+	public:
+		task_completion_event() : m_Promise(std::make_shared<std::promise<T>>()), m_Future(m_Promise->get_future().share()) {}
+
+		void set( T Value ) const { m_Promise->set_value(std::move(Value)); }
+
+	private:
+		template <typename U> friend task<U> create_task( const task_completion_event<U>& Event );
+
+		std::shared_ptr<std::promise<T>> m_Promise;
+		std::shared_future<T> m_Future;
+	};
+
+	namespace details
+	{
+		// A continuation that returns a task is unwrapped, as in the PPL
+		template <typename T> struct Unwrap { typedef T Type; static T Get( T Value ) { return Value; } };
+		template <typename T> struct Unwrap<task<T>> { typedef T Type; static T Get( task<T> Value ) { return Value.get(); } };
+	}
+
+	template <typename T>
+	class task
+	{
+	public:
+		task() {}
+		explicit task( const std::shared_future<T>& Future ) : m_Future(Future) {}
+
+		T get( void ) const { return m_Future.get(); }
+
+		template <typename Function>
+		auto then( const Function& Func ) const -> task<typename details::Unwrap<decltype(Func(std::declval<T>()))>::Type>
+		{
+			typedef decltype(Func(std::declval<T>())) Result;
+			typedef typename details::Unwrap<Result>::Type Value;
+
+			std::shared_future<T> Antecedent = m_Future;
+			return task<Value>(std::async(std::launch::deferred,
+				[=] { return details::Unwrap<Result>::Get(Func(Antecedent.get())); }).share());
+		}
+
+	private:
+		std::shared_future<T> m_Future;
+	};
+
+	template <typename T>
+	task<T> create_task( const task_completion_event<T>& Event )
+	{
+		return task<T>(Event.m_Future);
+	}
+
+	template <typename T>
+	task<T> task_from_result( T Value )
+	{
+		std::promise<T> Promise;
+		Promise.set_value(std::move(Value));
+		return task<T>(Promise.get_future().share());
+	}
+}
@@ -0,0 +1,321 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Stresses ConcurrentBuddyAllocator from several threads against a simulated fence.  A "render" thread keeps
+// submitting fence values and a "GPU" thread completes them some way behind, while worker threads allocate,
+// free, retire and reclaim blocks of mixed orders.
+//
+// Every unit records whether it is live, or the fence it was retired against, so the test catches a block being
+// handed out twice or being handed out again before the GPU is done with it.  At the end everything is retired,
+// taken back with ReclaimAllRetired(), and the whole range must be free, counting the thread caches, and merge
+// back to a single block.
+//
+
+#include "ConcurrentBuddyAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+// Stands in for a command queue.  Values are submitted by one thread and completed by another.
+class SimulatedFence : public IFenceSource
+{
+public:
+	SimulatedFence() : m_NextFenceValue(1), m_CompletedFenceValue(0) {}
+
+	uint64_t GetNextFenceValue() override { return m_NextFenceValue.load(); }
+	bool IsFenceComplete( uint64_t fenceValue ) override { return fenceValue <= m_CompletedFenceValue.load(); }
+
+	void Submit() { ++m_NextFenceValue; }
+
+	// Completes one more submitted value, keeping at least lag values in flight
+	void Advance( uint64_t lag )
+	{
+		const uint64_t submitted = m_NextFenceValue.load() - 1;
+		const uint64_t completed = m_CompletedFenceValue.load();
+		if (completed + lag < submitted)
+			m_CompletedFenceValue.store(completed + 1);
+	}
+
+	void CompleteAll() { m_CompletedFenceValue.store(m_NextFenceValue.load() - 1); }
+
+private:
+	atomic<uint64_t> m_NextFenceValue;
+	atomic<uint64_t> m_CompletedFenceValue;
+};
+
+// Per unit:  0 when never used or freed immediately, kLive while allocated, or one more than the fence value it
+// was retired against
+static const uint64_t kLive = ~0ull;
+
+struct Shared
+{
+	ConcurrentBuddyAllocator allocator;
+	SimulatedFence fence;
+	unique_ptr<atomic<uint64_t>[]> units;
+	size_t numUnits;
+	atomic<uint32_t> errors;
+	atomic<uint64_t> reclaimed;
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+// Small blocks are far more common than large ones, as with buffers in a heap
+uint32_t RandomOrder( mt19937& rng, uint32_t maxOrder )
+{
+	const uint32_t largest = min(maxOrder, 8u);
+	uint32_t order = 0;
+	while (order < largest && (rng() & 3) == 0)
+		++order;
+	return order;
+}
+
+void MarkAllocated( Shared& shared, uint32_t offset, uint32_t order )
+{
+	for (uint32_t u = offset; u < offset + (1u << order); ++u)
+	{
+		const uint64_t previous = shared.units[u].exchange(kLive);
+		shared.Check(previous != kLive, "a unit was allocated twice");
+		shared.Check(previous == 0 || previous == kLive || shared.fence.IsFenceComplete(previous - 1),
+			"a unit was reallocated before its fence completed");
+	}
+}
+
+// Every unit must be marked before the block leaves this thread, after which it may be reallocated at once
+void MarkReleased( Shared& shared, uint32_t offset, uint32_t order, uint64_t value )
+{
+	for (uint32_t u = offset; u < offset + (1u << order); ++u)
+		shared.units[u].store(value);
+}
+
+void Reclaim( Shared& shared, BuddyRetireNode* pNode )
+{
+	while (pNode != nullptr)
+	{
+		BuddyRetireNode* pNext = pNode->m_pNextRetired;
+		shared.reclaimed += 1;
+		delete pNode;
+		pNode = pNext;
+	}
+}
+
+void Worker( Shared& shared, uint32_t seed, uint32_t numOps )
+{
+	mt19937 rng(seed);
+	vector<BuddyRetireNode*> live;
+	const uint32_t maxOrder = shared.allocator.GetMaxOrder();
+
+	for (uint32_t op = 0; op < numOps; ++op)
+	{
+		const uint32_t action = rng() % 16;
+
+		if (action < 7 || live.empty())
+		{
+			uint32_t offset;
+			const uint32_t order = RandomOrder(rng, maxOrder);
+			if (shared.allocator.Allocate(order, offset) != kBuddySuccess)
+				continue;
+
+			shared.Check(offset % (1u << order) == 0 && offset + (1u << order) <= shared.numUnits,
+				"block misaligned or outside the range");
+			MarkAllocated(shared, offset, order);
+
+			BuddyRetireNode* pNode = new BuddyRetireNode;
+			pNode->m_UnitOffset = offset;
+			pNode->m_Order = order;
+			live.push_back(pNode);
+		}
+		else if (action < 14)
+		{
+			const size_t victim = rng() % live.size();
+			BuddyRetireNode* pNode = live[victim];
+			live[victim] = live.back();
+			live.pop_back();
+
+			if (action == 13)
+			{
+				// The GPU never saw this one
+				MarkReleased(shared, pNode->m_UnitOffset, pNode->m_Order, 0);
+				shared.allocator.Free(pNode->m_UnitOffset, pNode->m_Order);
+				delete pNode;
+			}
+			else
+			{
+				// The value Retire() stamps can only be later than this one, which makes the check weaker but never wrong
+				MarkReleased(shared, pNode->m_UnitOffset, pNode->m_Order, shared.fence.GetNextFenceValue() + 1);
+				shared.allocator.Retire(pNode);
+			}
+		}
+		else
+		{
+			Reclaim(shared, shared.allocator.ReclaimRetired());
+		}
+	}
+
+	for (BuddyRetireNode* pNode : live)
+	{
+		MarkReleased(shared, pNode->m_UnitOffset, pNode->m_Order, shared.fence.GetNextFenceValue() + 1);
+		shared.allocator.Retire(pNode);
+	}
+}
+
+// Returns the number of errors found
+uint32_t Stress( uint32_t maxOrder, uint32_t numThreads, uint32_t numOps, uint32_t seed )
+{
+	Shared shared;
+	shared.allocator.Create(maxOrder, &shared.fence);
+	shared.numUnits = (size_t)1 << maxOrder;
+	shared.units.reset(new atomic<uint64_t>[shared.numUnits]);
+	for (size_t u = 0; u < shared.numUnits; ++u)
+		shared.units[u].store(0);
+	shared.errors = 0;
+	shared.reclaimed = 0;
+
+	atomic<bool> running(true);
+
+	thread renderThread([&]
+	{
+		while (running.load())
+		{
+			shared.fence.Submit();
+			this_thread::yield();
+		}
+	});
+
+	thread gpuThread([&]
+	{
+		while (running.load())
+		{
+			shared.fence.Advance(4);
+			this_thread::yield();
+		}
+	});
+
+	auto start = chrono::high_resolution_clock::now();
+
+	vector<thread> workers;
+	for (uint32_t i = 0; i < numThreads; ++i)
+		workers.emplace_back(Worker, ref(shared), seed * 1000 + i, numOps);
+	for (thread& worker : workers)
+		worker.join();
+
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	running = false;
+	renderThread.join();
+	gpuThread.join();
+
+	// Shutdown:  the GPU is idle, but nothing tells the allocator so
+	Reclaim(shared, shared.allocator.ReclaimAllRetired());
+	shared.fence.CompleteAll();
+
+	// The last worker may have flushed every cache when it ran out of memory, so leave some blocks parked in this
+	// thread's cache:  the first allocation refills it
+	uint32_t offset;
+	shared.Check(shared.allocator.Allocate(0, offset) == kBuddySuccess, "could not allocate after reclaiming everything");
+	shared.allocator.Free(offset, 0);
+
+	shared.Check(shared.allocator.GetFreeUnits() == shared.numUnits, "units missing, counting the thread caches");
+
+	shared.allocator.FlushThreadCaches();
+	shared.Check(shared.allocator.GetFreeUnits() == shared.numUnits, "units missing after flushing the thread caches");
+
+	shared.Check(shared.allocator.Allocate(maxOrder, offset) == kBuddySuccess && offset == 0,
+		"freeing everything did not merge back to one block");
+	shared.allocator.Free(offset, maxOrder);
+
+	shared.allocator.Destroy();
+
+	printf("seed %-4u  %8.1f ns per operation  %8llu blocks reclaimed  %u errors\n", seed,
+		seconds * 1e9 / ((double)numOps * numThreads), (unsigned long long)shared.reclaimed.load(), shared.errors.load());
+
+	return shared.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-order <n>\n\tThe range managed is 2^n units.  Defaults to 12.\n"
+		"-threads <n>\n\tWorker threads.  Defaults to 4.\n"
+		"-ops <n>\n\tOperations per worker thread.  Defaults to 200000.\n"
+		"-seeds <n>\n\tRuns repeated with different seeds.  Defaults to 4.\n"
+		"\n\nExample:  %s -threads 8 -seeds 20\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t maxOrder = 12;
+	uint32_t numThreads = 4;
+	uint32_t numOps = 200000;
+	uint32_t numSeeds = 4;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-order", argv[arg]) == 0)
+				maxOrder = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-threads", argv[arg]) == 0)
+				numThreads = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-ops", argv[arg]) == 0)
+				numOps = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seeds", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (maxOrder > 24 || numThreads == 0 || numOps == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Concurrent buddy allocator benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+	printf("2^%u units, %u threads, %u operations each\n\n", maxOrder, numThreads, numOps);
+
+	uint32_t errors = 0;
+	for (uint32_t seed = 0; seed < numSeeds; ++seed)
+		errors += Stress(maxOrder, numThreads, numOps, seed);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,223 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures how fast BatchCulling culls random boxes and spheres against a perspective frustum, with each
+// implementation on one thread and with the best one on every worker.  The masks of each implementation are
+// checked against the scalar one.
+//
+
+#include "BatchCulling.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace Math;
+
+struct Scene
+{
+	vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	vector<float> centerX, centerY, centerZ, radius;
+
+	BoxArrays GetBoxes( void ) const
+	{
+		BoxArrays boxes = { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data() };
+		return boxes;
+	}
+
+	SphereArrays GetSpheres( void ) const
+	{
+		SphereArrays spheres = { centerX.data(), centerY.data(), centerZ.data(), radius.data() };
+		return spheres;
+	}
+};
+
+// Objects are scattered through a cube around the camera, so that about a tenth of them are visible
+void GenerateScene( uint32_t count, Scene& scene )
+{
+	mt19937 rng(1234);
+	uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+	uniform_real_distribution<float> size(0.5f, 20.0f);
+
+	for (auto* v : { &scene.minX, &scene.minY, &scene.minZ, &scene.maxX, &scene.maxY, &scene.maxZ,
+		&scene.centerX, &scene.centerY, &scene.centerZ, &scene.radius })
+	{
+		v->resize(count);
+	}
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const float x = position(rng), y = position(rng), z = position(rng);
+		const float hx = size(rng), hy = size(rng), hz = size(rng);
+		scene.minX[i] = x - hx;
+		scene.minY[i] = y - hy;
+		scene.minZ[i] = z - hz;
+		scene.maxX[i] = x + hx;
+		scene.maxY[i] = y + hy;
+		scene.maxZ[i] = z + hz;
+		scene.centerX[i] = x;
+		scene.centerY[i] = y;
+		scene.centerZ[i] = z;
+		scene.radius[i] = sqrtf(hx * hx + hy * hy + hz * hz);
+	}
+}
+
+// A view space frustum looking down -Z, as Frustum builds for a perspective projection
+CullingPlanes MakePerspectivePlanes( float fovY, float aspect, float nearClip, float farClip )
+{
+	const float vTan = tanf(fovY * 0.5f);
+	const float hTan = vTan * aspect;
+	const float nH = 1.0f / sqrtf(1.0f + hTan * hTan);
+	const float nV = 1.0f / sqrtf(1.0f + vTan * vTan);
+
+	CullingPlanes planes;
+	planes.AddPlane(0.0f, 0.0f, -1.0f, -nearClip);
+	planes.AddPlane(0.0f, 0.0f, 1.0f, farClip);
+	planes.AddPlane(nH, 0.0f, -hTan * nH, 0.0f);
+	planes.AddPlane(-nH, 0.0f, -hTan * nH, 0.0f);
+	planes.AddPlane(0.0f, -nV, -vTan * nV, 0.0f);
+	planes.AddPlane(0.0f, nV, -vTan * nV, 0.0f);
+	return planes;
+}
+
+// Repeats cull() for at least the given time and returns objects culled per second
+template <typename Func>
+double Measure( uint32_t count, double minSeconds, Func cull )
+{
+	cull();
+
+	uint32_t iterations = 0;
+	double seconds = 0.0;
+	auto start = chrono::high_resolution_clock::now();
+	do
+	{
+		cull();
+		++iterations;
+		seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	}
+	while (seconds < minSeconds);
+
+	return (double)count * iterations / seconds;
+}
+
+uint32_t CountDifferences( const vector<uint32_t>& a, const vector<uint32_t>& b )
+{
+	uint32_t differences = 0;
+	for (size_t i = 0; i < a.size(); ++i)
+	{
+		for (uint32_t bits = a[i] ^ b[i]; bits != 0; bits &= bits - 1)
+			++differences;
+	}
+	return differences;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-count <n>\n\tThe number of boxes and spheres.  Defaults to 4000000.\n"
+		"-seconds <s>\n\tHow long to run each measurement.  Defaults to 1.\n"
+		"-chunk <n>\n\tObjects per worker thread task.  Defaults to 16384.\n"
+		"\n\nExample:  %s -count 10000000\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t count = 4000000;
+	double seconds = 1.0;
+	uint32_t chunkSize = 16384;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-count", argv[arg]) == 0)
+				count = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seconds", argv[arg]) == 0)
+				seconds = atof(argv[++arg]);
+			else if (strcmp("-chunk", argv[arg]) == 0)
+				chunkSize = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (count == 0 || seconds <= 0.0 || chunkSize == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Culling benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	Scene scene;
+	GenerateScene(count, scene);
+	const BoxArrays boxes = scene.GetBoxes();
+	const SphereArrays spheres = scene.GetSpheres();
+	const CullingPlanes planes = MakePerspectivePlanes(3.14159265f / 3.0f, 16.0f / 9.0f, 1.0f, 1000.0f);
+
+	vector<uint32_t> boxMask(GetCullMaskSize(count));
+	vector<uint32_t> sphereMask(GetCullMaskSize(count));
+	vector<uint32_t> scalarBoxMask(GetCullMaskSize(count));
+	vector<uint32_t> scalarSphereMask(GetCullMaskSize(count));
+
+	const uint32_t visibleBoxes = CullBoxes(kCullScalar, planes, boxes, 0, count, scalarBoxMask.data());
+	const uint32_t visibleSpheres = CullSpheres(kCullScalar, planes, spheres, 0, count, scalarSphereMask.data());
+	printf("%u objects, %u boxes and %u spheres visible\n\n", count, visibleBoxes, visibleSpheres);
+
+	printf("Implementation       Boxes/s    Spheres/s    Mismatches\n");
+
+	bool mismatched = false;
+	for (int i = 0; i < kNumCullImplementations; ++i)
+	{
+		const CullImplementation impl = (CullImplementation)i;
+		if (!IsCullImplementationSupported(impl))
+			continue;
+
+		const double boxRate = Measure(count, seconds, [&]() { CullBoxes(impl, planes, boxes, 0, count, boxMask.data()); });
+		const double sphereRate = Measure(count, seconds, [&]() { CullSpheres(impl, planes, spheres, 0, count, sphereMask.data()); });
+		const uint32_t mismatches = CountDifferences(boxMask, scalarBoxMask) + CountDifferences(sphereMask, scalarSphereMask);
+		mismatched |= mismatches != 0;
+
+		printf("%-14s  %10.1fM  %10.1fM  %12u\n", GetCullImplementationName(impl), boxRate * 1e-6, sphereRate * 1e-6, mismatches);
+	}
+
+	const double boxRate = Measure(count, seconds, [&]() { ParallelCullBoxes(planes, boxes, count, boxMask.data(), chunkSize); });
+	const double sphereRate = Measure(count, seconds, [&]() { ParallelCullSpheres(planes, spheres, count, sphereMask.data(), chunkSize); });
+	const uint32_t mismatches = CountDifferences(boxMask, scalarBoxMask) + CountDifferences(sphereMask, scalarSphereMask);
+	mismatched |= mismatches != 0;
+
+	printf("%-14s  %10.1fM  %10.1fM  %12u\n\n", "Parallel", boxRate * 1e-6, sphereRate * 1e-6, mismatches);
+
+	// Mismatches are only expected for objects touching a plane, which random positions practically never give
+	return mismatched ? 2 : 0;
+}
@@ -0,0 +1,352 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Tests DescriptorIndexAllocator against a fake heap factory, which records the heaps it is asked for and,
+// like DescriptorAllocator, takes a lock of its own in CreateHeap().  An observer thread keeps taking that lock
+// while the workers allocate, and checks that no heap is handed out before the factory has created it.
+//
+// The single threaded check fills whole heaps and makes sure a new one is only created when the others are full,
+// and that freed ranges coalesce back into whole heaps.  The stress test then allocates and frees ranges of mixed
+// sizes from several threads.  Every descriptor records its owner, so a range handed out twice is caught, and at
+// the end every heap must be free again and able to hand out all of its descriptors in one range.
+//
+
+#include "pch.h"
+#include "DescriptorIndexAllocator.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Checker
+{
+	atomic<uint32_t> errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+// Stands in for DescriptorAllocator, without a device
+class FakeHeapFactory : public IDescriptorHeapFactory
+{
+public:
+	FakeHeapFactory( Checker& checker, uint32_t numDescriptorsPerHeap )
+		: m_Checker(checker), m_NumDescriptorsPerHeap(numDescriptorsPerHeap), m_NumCreated(0) {}
+
+	void CreateHeap( uint32_t heapIndex, uint32_t numDescriptors ) override
+	{
+		lock_guard<mutex> lockGuard(m_PoolMutex);
+		m_Checker.Check(heapIndex == m_NumCreated, "heaps were not created in order");
+		m_Checker.Check(numDescriptors == m_NumDescriptorsPerHeap, "heap created with the wrong size");
+		++m_NumCreated;
+	}
+
+	// What DescriptorAllocator::DestroyAll() does before destroying the allocators
+	uint32_t GetNumCreated()
+	{
+		lock_guard<mutex> lockGuard(m_PoolMutex);
+		return m_NumCreated;
+	}
+
+	void Reset()
+	{
+		lock_guard<mutex> lockGuard(m_PoolMutex);
+		m_NumCreated = 0;
+	}
+
+private:
+	Checker& m_Checker;
+	uint32_t m_NumDescriptorsPerHeap;
+	mutex m_PoolMutex;
+	uint32_t m_NumCreated;
+};
+
+struct Range
+{
+	uint32_t heapIndex;
+	uint32_t offset;
+	uint32_t count;
+};
+
+// The allocator rounds counts up to a power of two and owns the whole block
+uint32_t RoundedCount( uint32_t count )
+{
+	uint32_t rounded = 1;
+	while (rounded < count)
+		rounded *= 2;
+	return rounded;
+}
+
+struct Shared
+{
+	Checker checker;
+	FakeHeapFactory factory;
+	DescriptorIndexAllocator allocator;
+	uint32_t numDescriptorsPerHeap;
+	unique_ptr<atomic<uint32_t>[]> owners;
+
+	Shared( uint32_t numDescriptorsPerHeap ) : factory(checker, numDescriptorsPerHeap), numDescriptorsPerHeap(numDescriptorsPerHeap)
+	{
+		const size_t numDescriptors = (size_t)DescriptorIndexAllocator::kMaxHeaps * numDescriptorsPerHeap;
+		owners.reset(new atomic<uint32_t>[numDescriptors]);
+		for (size_t i = 0; i < numDescriptors; ++i)
+			owners[i].store(0);
+		allocator.Create(&factory, numDescriptorsPerHeap);
+	}
+
+	Range Allocate( uint32_t count, uint32_t owner )
+	{
+		Range range;
+		range.count = count;
+		allocator.Allocate(count, range.heapIndex, range.offset);
+
+		const uint32_t rounded = RoundedCount(count);
+		checker.Check(range.heapIndex < allocator.GetNumHeaps(), "range in a heap that does not exist");
+		checker.Check(range.offset % rounded == 0 && range.offset + rounded <= numDescriptorsPerHeap,
+			"range misaligned or outside its heap");
+
+		const size_t first = (size_t)range.heapIndex * numDescriptorsPerHeap + range.offset;
+		for (size_t i = first; i < first + rounded; ++i)
+			checker.Check(owners[i].exchange(owner) == 0, "a descriptor was allocated twice");
+
+		return range;
+	}
+
+	// Every descriptor must be released before the range goes back, after which it may be reallocated at once
+	void Free( const Range& range )
+	{
+		const size_t first = (size_t)range.heapIndex * numDescriptorsPerHeap + range.offset;
+		for (size_t i = first; i < first + RoundedCount(range.count); ++i)
+			owners[i].store(0);
+		allocator.Free(range.heapIndex, range.offset, range.count);
+	}
+
+	// Freed ranges must merge back, so each heap can hand out all of its descriptors at once without growing
+	void CheckAllFree()
+	{
+		checker.Check(allocator.GetNumAllocatedDescriptors() == 0, "descriptors still allocated after freeing everything");
+
+		const uint32_t numHeaps = allocator.GetNumHeaps();
+		vector<Range> whole;
+		for (uint32_t i = 0; i < numHeaps; ++i)
+			whole.push_back(Allocate(numDescriptorsPerHeap, 1));
+		checker.Check(allocator.GetNumHeaps() == numHeaps, "freed ranges did not coalesce back into whole heaps");
+
+		for (const Range& range : whole)
+			Free(range);
+	}
+};
+
+// Returns the number of errors found
+uint32_t Fill( uint32_t numDescriptorsPerHeap )
+{
+	Shared shared(numDescriptorsPerHeap);
+	Checker& checker = shared.checker;
+
+	const uint32_t kNumHeaps = 3;
+	vector<Range> ranges;
+	for (uint32_t heap = 0; heap < kNumHeaps; ++heap)
+	{
+		for (uint32_t i = 0; i < numDescriptorsPerHeap; ++i)
+			ranges.push_back(shared.Allocate(1, 1));
+		checker.Check(shared.allocator.GetNumHeaps() == heap + 1, "a heap was added before the others were full");
+	}
+
+	checker.Check(shared.factory.GetNumCreated() == kNumHeaps, "the factory was not asked for every heap");
+	checker.Check(shared.allocator.GetNumAllocatedDescriptors() == kNumHeaps * numDescriptorsPerHeap,
+		"wrong count of allocated descriptors");
+
+	for (const Range& range : ranges)
+		shared.Free(range);
+	shared.CheckAllFree();
+
+	// A non power of two takes the whole rounded up block, so four ranges of three fill a heap of sixteen
+	ranges.clear();
+	for (uint32_t i = 0; i < numDescriptorsPerHeap / 4; ++i)
+		ranges.push_back(shared.Allocate(3, 1));
+	checker.Check(shared.allocator.GetNumHeaps() == kNumHeaps, "rounded up ranges added a heap");
+	checker.Check(shared.allocator.GetNumAllocatedDescriptors() == numDescriptorsPerHeap,
+		"rounded up ranges were not counted whole");
+	for (const Range& range : ranges)
+		shared.Free(range);
+
+	// Starting over must ask the factory for heaps from the first index again
+	shared.allocator.Destroy();
+	checker.Check(shared.allocator.GetNumHeaps() == 0, "heaps left after Destroy()");
+	shared.factory.Reset();
+	shared.allocator.Create(&shared.factory, numDescriptorsPerHeap);
+	shared.Free(shared.Allocate(1, 1));
+	checker.Check(shared.factory.GetNumCreated() == 1, "the first heap was not recreated");
+
+	printf("fill       %u heaps of %u descriptors  %u errors\n", kNumHeaps, numDescriptorsPerHeap, checker.errors.load());
+
+	return checker.errors;
+}
+
+// Mostly single descriptors, as for SRVs and UAVs, with the odd table
+uint32_t RandomCount( mt19937& rng, uint32_t maxCount )
+{
+	if ((rng() & 3) != 0)
+		return 1;
+	return 1 + rng() % maxCount;
+}
+
+void Worker( Shared& shared, uint32_t owner, uint32_t seed, uint32_t numOps )
+{
+	const uint32_t kMaxLiveRanges = 64;
+	const uint32_t maxCount = min(shared.numDescriptorsPerHeap, 16u);
+
+	mt19937 rng(seed);
+	vector<Range> live;
+
+	for (uint32_t op = 0; op < numOps; ++op)
+	{
+		if (live.size() < kMaxLiveRanges && (live.empty() || (rng() & 1) != 0))
+		{
+			live.push_back(shared.Allocate(RandomCount(rng, maxCount), owner));
+		}
+		else
+		{
+			const size_t victim = rng() % live.size();
+			shared.Free(live[victim]);
+			live[victim] = live.back();
+			live.pop_back();
+		}
+	}
+
+	for (const Range& range : live)
+		shared.Free(range);
+}
+
+// Returns the number of errors found
+uint32_t Stress( uint32_t numDescriptorsPerHeap, uint32_t numThreads, uint32_t numOps, uint32_t seed )
+{
+	Shared shared(numDescriptorsPerHeap);
+	atomic<bool> running(true);
+
+	// Takes the factory's lock while the workers grow the allocator, as DescriptorAllocator::DestroyAll() does
+	thread observer([&]
+	{
+		while (running.load())
+		{
+			const uint32_t numVisible = shared.allocator.GetNumHeaps();
+			shared.checker.Check(numVisible <= shared.factory.GetNumCreated(), "a heap was visible before it was created");
+			this_thread::yield();
+		}
+	});
+
+	auto start = chrono::high_resolution_clock::now();
+
+	vector<thread> workers;
+	for (uint32_t i = 0; i < numThreads; ++i)
+		workers.emplace_back(Worker, ref(shared), i + 1, seed * 1000 + i, numOps);
+	for (thread& worker : workers)
+		worker.join();
+
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	running = false;
+	observer.join();
+
+	shared.checker.Check(shared.allocator.GetNumHeaps() == shared.factory.GetNumCreated(), "heaps created but never used");
+	shared.CheckAllFree();
+
+	printf("seed %-4u  %8.1f ns per operation  %4u heaps  %u errors\n", seed,
+		seconds * 1e9 / ((double)numOps * numThreads), shared.allocator.GetNumHeaps(), shared.checker.errors.load());
+
+	return shared.checker.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-size <n>\n\tDescriptors per heap, a power of two from 16 to 4096.  Defaults to 256.\n"
+		"-threads <n>\n\tWorker threads.  Defaults to 4.\n"
+		"-ops <n>\n\tOperations per worker thread.  Defaults to 200000.\n"
+		"-seeds <n>\n\tRuns repeated with different seeds.  Defaults to 4.\n"
+		"\n\nExample:  %s -threads 8 -seeds 20\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numDescriptorsPerHeap = 256;
+	uint32_t numThreads = 4;
+	uint32_t numOps = 200000;
+	uint32_t numSeeds = 4;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-size", argv[arg]) == 0)
+				numDescriptorsPerHeap = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-threads", argv[arg]) == 0)
+				numThreads = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-ops", argv[arg]) == 0)
+				numOps = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seeds", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		// Each worker holds at most 64 ranges of up to 16, which must fit in half the heaps the allocator can
+		// create, leaving room for fragmentation and the thread caches
+		if (numDescriptorsPerHeap < 16 || numDescriptorsPerHeap > 4096 || !Math::IsPowerOfTwo(numDescriptorsPerHeap) ||
+			numThreads == 0 || numThreads * 64 * 16 * 2 > DescriptorIndexAllocator::kMaxHeaps * numDescriptorsPerHeap ||
+			numOps == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Descriptor index allocator benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+	printf("%u descriptors per heap, %u threads, %u operations each\n\n", numDescriptorsPerHeap, numThreads, numOps);
+
+	uint32_t errors = Fill(numDescriptorsPerHeap);
+	for (uint32_t seed = 0; seed < numSeeds; ++seed)
+		errors += Stress(numDescriptorsPerHeap, numThreads, numOps, seed);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
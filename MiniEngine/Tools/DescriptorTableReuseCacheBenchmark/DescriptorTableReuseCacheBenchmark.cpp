@@ -0,0 +1,389 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Exercises DescriptorTableReuseCache without a device.  Keys must depend on the table size, the assigned handle
+// mask and the assigned handles only, never on stale entries left in the staging area.  Keys forced onto one hash
+// must stay distinct, a full cache must stop storing keys without breaking lookups, and Clear() must forget
+// everything.
+//
+// A simulation then stages handles the way DynamicDescriptorHeap does, copies missed tables into a fake shader
+// visible heap and retires the heap when it fills.  Descriptors are rewritten now and then, after which the cache is
+// cleared as DynamicDescriptorHeap::InvalidateReusedTables() makes every context do.  Every hit must point at a
+// copy holding exactly the staged handles, as they are now.  The time to look up a table is reported.
+//
+
+#include "pch.h"
+#include "DescriptorTableReuseCache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+typedef DescriptorTableReuseCache::TableKey TableKey;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+D3D12_CPU_DESCRIPTOR_HANDLE MakeHandle( uint32_t index )
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE handle;
+	handle.ptr = 0x10000 + (size_t)index * 32;
+	return handle;
+}
+
+bool SameKey( const TableKey& a, const TableKey& b )
+{
+	return a.Hash == b.Hash && a.NumWords == b.NumWords && memcmp(a.Words, b.Words, a.NumWords * sizeof(uint64_t)) == 0;
+}
+
+// Returns the number of errors found
+uint32_t CheckKeys( void )
+{
+	Checker checker;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE handles[32];
+	for (uint32_t i = 0; i < 32; ++i)
+		handles[i] = MakeHandle(i);
+
+	TableKey key, other;
+	DescriptorTableReuseCache::BuildKey(handles, 0x15, 5, key);
+	checker.Check(key.NumWords == 4 && key.NumDescriptors == 3, "a key does not hold one word per assigned handle");
+
+	// Entries 1 and 3 are not assigned, so whatever they hold must not matter
+	handles[1] = MakeHandle(100);
+	handles[3] = MakeHandle(101);
+	DescriptorTableReuseCache::BuildKey(handles, 0x15, 5, other);
+	checker.Check(SameKey(key, other), "a stale unassigned handle changed the key");
+
+	handles[2] = MakeHandle(102);
+	DescriptorTableReuseCache::BuildKey(handles, 0x15, 5, other);
+	checker.Check(!SameKey(key, other), "an assigned handle did not change the key");
+	handles[2] = MakeHandle(2);
+
+	// The same handles in other slots, or in a larger table, are a different table
+	DescriptorTableReuseCache::BuildKey(handles, 0x15, 6, other);
+	checker.Check(!SameKey(key, other), "the table size did not change the key");
+	const D3D12_CPU_DESCRIPTOR_HANDLE packed[3] = { handles[0], handles[2], handles[4] };
+	DescriptorTableReuseCache::BuildKey(packed, 0x7, 5, other);
+	checker.Check(!SameKey(key, other), "the assigned mask did not change the key");
+
+	// All 32 entries assigned is the largest key
+	for (uint32_t i = 0; i < 32; ++i)
+		handles[i] = MakeHandle(i);
+	DescriptorTableReuseCache::BuildKey(handles, 0xFFFFFFFF, 32, key);
+	checker.Check(key.NumWords == DescriptorTableReuseCache::kMaxKeyWords && key.NumDescriptors == 32,
+		"a full table does not fill the key");
+
+	printf("Keys:  %u errors\n", checker.errors);
+
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckCache( void )
+{
+	Checker checker;
+	DescriptorTableReuseCache cache;
+	uint32_t offset = 0;
+
+	D3D12_CPU_DESCRIPTOR_HANDLE handles[4];
+	for (uint32_t i = 0; i < 4; ++i)
+		handles[i] = MakeHandle(i);
+
+	// Two tables forced onto one hash are only told apart by comparing the keys in full
+	TableKey a, b;
+	DescriptorTableReuseCache::BuildKey(handles, 0x3, 2, a);
+	DescriptorTableReuseCache::BuildKey(handles, 0x5, 3, b);
+	b.Hash = a.Hash;
+
+	checker.Check(!cache.Find(a, offset), "an empty cache found a table");
+	cache.Insert(a, 5);
+	checker.Check(!cache.Find(b, offset), "a table with the same hash was taken for another");
+	cache.Insert(b, 9);
+	checker.Check(cache.Find(a, offset) && offset == 5, "the first of two colliding tables was lost");
+	checker.Check(cache.Find(b, offset) && offset == 9, "the second of two colliding tables was lost");
+
+	const DescriptorTableReuseCache::Statistics& stats = cache.GetStatistics();
+	checker.Check(stats.Lookups == 4 && stats.Hits == 2 && stats.DescriptorsSaved == 4, "statistics do not add up");
+	cache.ResetStatistics();
+	checker.Check(stats.Lookups == 0 && stats.Hits == 0 && stats.DescriptorsSaved == 0, "statistics were not reset");
+
+	cache.Clear();
+	checker.Check(!cache.Find(a, offset) && !cache.Find(b, offset), "a table survived Clear()");
+
+	// Far more tables than fit:  the first ones stay, the rest are copied every time, and lookups still end
+	vector<TableKey> keys(4096);
+	for (uint32_t i = 0; i < keys.size(); ++i)
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE handle = MakeHandle(i);
+		DescriptorTableReuseCache::BuildKey(&handle, 0x1, 1, keys[i]);
+		if (!cache.Find(keys[i], offset))
+			cache.Insert(keys[i], i);
+	}
+
+	uint32_t found = 0;
+	for (uint32_t i = 0; i < keys.size(); ++i)
+	{
+		if (cache.Find(keys[i], offset))
+		{
+			checker.Check(offset == i, "a table was found at another table's offset");
+			++found;
+		}
+	}
+	checker.Check(found >= 512 && found < 1024, "a full cache kept too few or too many tables");
+
+	// Clearing repeatedly must not bring anything back
+	for (uint32_t i = 0; i < 100000; ++i)
+	{
+		cache.Insert(keys[i % keys.size()], i);
+		cache.Clear();
+	}
+	found = 0;
+	for (const TableKey& key : keys)
+		found += cache.Find(key, offset) ? 1 : 0;
+	checker.Check(found == 0, "a table survived repeated clears");
+
+	printf("Cache:  %u errors\n", checker.errors);
+
+	return checker.errors;
+}
+
+// A descriptor as the shader visible heap holds it:  which CPU handle it was copied from, and that handle's version
+struct HeapEntry
+{
+	size_t ptr;
+	uint32_t version;
+};
+
+// Returns the number of errors found
+uint32_t Simulate( uint32_t numDraws, uint32_t numHandles, uint32_t seed )
+{
+	Checker checker;
+	DescriptorTableReuseCache cache;
+	mt19937 rng(seed);
+
+	const uint32_t kHeapSize = 1024;
+	vector<HeapEntry> heap(kHeapSize);
+	uint32_t heapOffset = 0;
+	uint32_t heapsRetired = 0;
+
+	// Bumped whenever a handle's descriptor is rewritten
+	vector<uint32_t> versions(numHandles, 0);
+	uint32_t rewrites = 0;
+
+	// The staging area of one root parameter.  As in DynamicDescriptorHeap, handles stay staged until the root
+	// signature changes, and unassigned entries keep whatever they held before.
+	D3D12_CPU_DESCRIPTOR_HANDLE staged[32];
+	for (uint32_t i = 0; i < 32; ++i)
+		staged[i] = MakeHandle(rng() % numHandles);
+	uint32_t rootTableSize = 8;
+	uint32_t assigned = 0;
+
+	for (uint32_t draw = 0; draw < numDraws; ++draw)
+	{
+		if (rng() % 16 == 0)
+		{
+			rootTableSize = 1 + (rng() % 8 == 0 ? rng() % 32 : rng() % 8);
+			assigned = 0;
+		}
+
+		// Like SetDynamicDescriptors():  one or two ranges of handles
+		const uint32_t numRanges = 1 + rng() % 2;
+		for (uint32_t r = 0; r < numRanges; ++r)
+		{
+			const uint32_t offset = rng() % rootTableSize;
+			const uint32_t count = 1 + rng() % min(rootTableSize - offset, 4u);
+			for (uint32_t i = 0; i < count; ++i)
+				staged[offset + i] = MakeHandle(rng() % numHandles);
+			assigned |= ((1u << count) - 1) << offset;
+		}
+
+		unsigned long maxSet;
+		_BitScanReverse(&maxSet, assigned);
+		const uint32_t tableSize = (uint32_t)maxSet + 1;
+
+		if (heapOffset + tableSize > kHeapSize)
+		{
+			// Retiring the heap clears the cache
+			cache.Clear();
+			heapOffset = 0;
+			++heapsRetired;
+		}
+
+		TableKey key;
+		DescriptorTableReuseCache::BuildKey(staged, assigned, tableSize, key);
+
+		uint32_t tableOffset;
+		if (!cache.Find(key, tableOffset))
+		{
+			tableOffset = heapOffset;
+			cache.Insert(key, tableOffset);
+			for (uint32_t i = 0; i < tableSize; ++i)
+			{
+				if (assigned & (1u << i))
+				{
+					heap[tableOffset + i].ptr = staged[i].ptr;
+					heap[tableOffset + i].version = versions[(staged[i].ptr - 0x10000) / 32];
+				}
+			}
+			heapOffset += tableSize;
+		}
+
+		// What the shader would read must be what was staged, as it is now
+		for (uint32_t i = 0; i < tableSize; ++i)
+		{
+			if ((assigned & (1u << i)) == 0)
+				continue;
+			const HeapEntry& entry = heap[tableOffset + i];
+			checker.Check(entry.ptr == staged[i].ptr, "a bound table holds another handle");
+			checker.Check(entry.version == versions[(staged[i].ptr - 0x10000) / 32], "a bound table holds a rewritten descriptor");
+		}
+
+		// A streamed texture gets a new resource
+		if (rng() % 256 == 0)
+		{
+			++versions[rng() % numHandles];
+			++rewrites;
+			cache.Clear();
+		}
+	}
+
+	const DescriptorTableReuseCache::Statistics& stats = cache.GetStatistics();
+	checker.Check(stats.Hits > 0, "no table was ever reused");
+
+	printf("seed %-4u  %5.1f%% of tables reused  %6llu descriptors saved  %4u heaps  %4u rewrites  %u errors\n", seed,
+		100.0 * stats.Hits / stats.Lookups, (unsigned long long)stats.DescriptorsSaved, heapsRetired, rewrites, checker.errors);
+
+	return checker.errors;
+}
+
+void TimeLookups( uint32_t numLookups )
+{
+	DescriptorTableReuseCache cache;
+
+	// A typical heap's worth of four handle tables, all of them cached
+	const uint32_t kNumTables = 256;
+	vector<TableKey> keys(kNumTables);
+	for (uint32_t t = 0; t < kNumTables; ++t)
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE handles[4];
+		for (uint32_t i = 0; i < 4; ++i)
+			handles[i] = MakeHandle(t * 4 + i);
+		DescriptorTableReuseCache::BuildKey(handles, 0xF, 4, keys[t]);
+		cache.Insert(keys[t], t * 4);
+	}
+
+	vector<D3D12_CPU_DESCRIPTOR_HANDLE> handles(kNumTables * 4);
+	for (uint32_t i = 0; i < handles.size(); ++i)
+		handles[i] = MakeHandle(i);
+
+	mt19937 rng(1234);
+	vector<uint32_t> tables(numLookups);
+	for (uint32_t i = 0; i < numLookups; ++i)
+		tables[i] = rng() % kNumTables;
+
+	// Building the key is part of every lookup
+	uint64_t sum = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < numLookups; ++i)
+	{
+		TableKey key;
+		DescriptorTableReuseCache::BuildKey(&handles[tables[i] * 4], 0xF, 4, key);
+		uint32_t offset = 0;
+		cache.Find(key, offset);
+		sum += offset;
+	}
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	printf("\nKey and lookup of a cached four handle table:  %.1f ns  (checksum %llx)\n", seconds * 1e9 / numLookups,
+		(unsigned long long)sum);
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-draws <n>\n\tDraws simulated per seed.  Defaults to 200000.\n"
+		"-handles <n>\n\tDistinct CPU descriptors the draws choose from.  Defaults to 24.\n"
+		"-seeds <n>\n\tRuns repeated with different seeds.  Defaults to 4.\n"
+		"\n\nExample:  %s -handles 200 -seeds 20\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numDraws = 200000;
+	uint32_t numHandles = 24;
+	uint32_t numSeeds = 4;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-draws", argv[arg]) == 0)
+				numDraws = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-handles", argv[arg]) == 0)
+				numHandles = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seeds", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numDraws == 0 || numHandles == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Descriptor table reuse cache benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = CheckKeys();
+	errors += CheckCache();
+	printf("\n");
+	for (uint32_t seed = 0; seed < numSeeds; ++seed)
+		errors += Simulate(numDraws, numHandles, seed);
+	TimeLookups(10000000);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,633 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures loading thousands of small files through Utility::FileSystem:  loose and from a pack file, mapped,
+// copied by ReadFileSync(), and read with ReadAsync().  The old way, a stat and an ifstream read into a zeroed
+// vector, is timed too.  The files are written to a scratch directory, and packed as CreatePackFile.py does.
+//
+// Every way of reading must return every file's contents, whatever the case and slashes of its name.  Range
+// reads must stop at the end of the file, ".gz" files must be found and inflated, a directory mounted after a
+// pack must shadow it, a damaged pack must not mount, and views must outlive the mounts they came from.
+//
+
+#include "pch.h"
+#include "FileSystem.h"
+#include "FileUtility.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <sys/stat.h>
+#endif
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace Utility;
+
+typedef vector<uint8_t> Bytes;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+#ifdef _WIN32
+FILE* OpenScratchFile( const wstring& path, const wchar_t* mode ) { return _wfopen(path.c_str(), mode); }
+void MakeScratchDirectory( const wstring& path ) { _wmkdir(path.c_str()); }
+void RemoveScratchFile( const wstring& path ) { _wremove(path.c_str()); }
+void RemoveScratchDirectory( const wstring& path ) { _wrmdir(path.c_str()); }
+#else
+FILE* OpenScratchFile( const wstring& path, const wchar_t* mode ) { return fopen(Win32Files::NarrowPath(path.c_str()).c_str(), mode[0] == L'w' ? "wb" : "rb"); }
+void MakeScratchDirectory( const wstring& path ) { mkdir(Win32Files::NarrowPath(path.c_str()).c_str(), 0755); }
+void RemoveScratchFile( const wstring& path ) { remove(Win32Files::NarrowPath(path.c_str()).c_str()); }
+void RemoveScratchDirectory( const wstring& path ) { rmdir(Win32Files::NarrowPath(path.c_str()).c_str()); }
+#endif
+
+// How assets were read before FileSystem:  a stat for the size, then an ifstream read into a zeroed buffer
+ByteArray ReadFileOldWay( const wstring& path )
+{
+#ifdef _WIN32
+	struct _stat64 fileStat;
+	if (_wstat64(path.c_str(), &fileStat) != 0)
+		return NullFile;
+	ifstream file(path, ios::in | ios::binary);
+#else
+	const string narrowPath = Win32Files::NarrowPath(path.c_str());
+	struct stat fileStat;
+	if (stat(narrowPath.c_str(), &fileStat) != 0)
+		return NullFile;
+	ifstream file(narrowPath, ios::in | ios::binary);
+#endif
+	if (!file)
+		return NullFile;
+
+	ByteArray contents = make_shared<vector<byte> >( (size_t)fileStat.st_size );
+	file.read((char*)contents->data(), contents->size());
+	return contents;
+}
+
+void WriteScratchFile( const wstring& path, const Bytes& contents )
+{
+	FILE* file = OpenScratchFile(path, L"wb");
+	if (file == nullptr)
+		throw runtime_error("Couldn't write a file in the scratch directory");
+	if (!contents.empty())
+		fwrite(contents.data(), 1, contents.size(), file);
+	fclose(file);
+}
+
+// As CreatePackFile.py's MakeKey() and HashKey(), for names that are already relative and plain
+string MakeKey( const wstring& name )
+{
+	string key;
+	for (wchar_t c : name)
+	{
+		if (c == L'/')
+			c = L'\\';
+		else if (c >= L'A' && c <= L'Z')
+			c += L'a' - L'A';
+
+		// Only Latin-1 names are written here
+		if (c < 0x80)
+		{
+			key += (char)c;
+		}
+		else
+		{
+			key += (char)(0xC0 | c >> 6);
+			key += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return key;
+}
+
+uint64_t HashKey( const string& key )
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : key)
+		hash = (hash ^ (uint8_t)c) * 0x100000001b3ull;
+	return hash;
+}
+
+template <typename T>
+void Append( Bytes& out, const T& value )
+{
+	const uint8_t* bytes = (const uint8_t*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+void Overwrite( Bytes& out, size_t offset, const T& value )
+{
+	memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+// The layout CreatePackFile.py writes
+Bytes MakePack( const map<wstring, Bytes>& files )
+{
+	struct Entry
+	{
+		uint64_t hash;
+		string key;
+		uint64_t offset;
+		uint64_t size;
+	};
+
+	Bytes pack(32, 0);
+	vector<Entry> entries;
+
+	map<string, const Bytes*> sorted;
+	for (auto& file : files)
+		sorted[MakeKey(file.first)] = &file.second;
+
+	for (auto& file : sorted)
+	{
+		pack.resize((pack.size() + 15) & ~(size_t)15, 0);
+		Entry entry = { HashKey(file.first), file.first, pack.size(), file.second->size() };
+		entries.push_back(entry);
+		pack.insert(pack.end(), file.second->begin(), file.second->end());
+	}
+
+	sort(entries.begin(), entries.end(), []( const Entry& a, const Entry& b )
+		{ return a.hash < b.hash || (a.hash == b.hash && a.key < b.key); });
+
+	pack.resize((pack.size() + 7) & ~(size_t)7, 0);
+	const uint64_t directoryOffset = pack.size();
+	uint32_t nameOffset = 0;
+	for (const Entry& entry : entries)
+	{
+		Append(pack, entry.hash);
+		Append(pack, entry.offset);
+		Append(pack, entry.size);
+		Append(pack, nameOffset);
+		Append(pack, (uint32_t)entry.key.size());
+		nameOffset += (uint32_t)entry.key.size();
+	}
+
+	const uint64_t namesOffset = pack.size();
+	for (const Entry& entry : entries)
+		pack.insert(pack.end(), entry.key.begin(), entry.key.end());
+
+	memcpy(pack.data(), "MPAK", 4);
+	Overwrite(pack, 4, (uint32_t)1);
+	Overwrite(pack, 8, (uint32_t)entries.size());
+	Overwrite(pack, 16, directoryOffset);
+	Overwrite(pack, 24, namesOffset);
+	return pack;
+}
+
+Bytes Gzip( const Bytes& data )
+{
+	z_stream strm = {};
+	deflateInit2(&strm, 6, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
+
+	Bytes out(deflateBound(&strm, (uLong)data.size()));
+	strm.next_in = (Bytef*)data.data();
+	strm.avail_in = (uInt)data.size();
+	strm.next_out = out.data();
+	strm.avail_out = (uInt)out.size();
+	deflate(&strm, Z_FINISH);
+	out.resize(strm.total_out);
+	deflateEnd(&strm);
+	return out;
+}
+
+bool Same( const FileView& view, const Bytes& expected )
+{
+	return view.IsValid() && view.Size() == expected.size() &&
+		(expected.empty() || memcmp(view.Data(), expected.data(), expected.size()) == 0);
+}
+
+bool Same( const ByteArray& data, const Bytes& expected )
+{
+	return data->size() == expected.size() && (expected.empty() || memcmp(data->data(), expected.data(), expected.size()) == 0);
+}
+
+// Upper case and back slashes, sometimes behind ".\"
+wstring Mangle( const wstring& name, uint32_t i )
+{
+	wstring mangled = name;
+	if (i % 2 == 1)
+	{
+		for (wchar_t& c : mangled)
+		{
+			if (c >= L'a' && c <= L'z')
+				c -= L'a' - L'A';
+			else if (c == L'/')
+				c = L'\\';
+		}
+	}
+	return i % 3 == 0 ? L".\\" + mangled : mangled;
+}
+
+// The files written to the scratch directory, by name relative to it
+struct TestFiles
+{
+	wstring root;
+	wstring packFile;
+	wstring damagedPackFile;
+	wstring overrideRoot;
+	vector<wstring> smallNames;     // The thousands of small files
+	map<wstring, Bytes> files;      // Everything, as packed
+	Bytes text;                     // Stored only as text.txt.gz
+	Bytes overrideFile;             // Shadows the first small file in overrideRoot
+};
+
+void WriteTestFiles( TestFiles& test, const wstring& root, uint32_t numFiles )
+{
+	mt19937 rng(1);
+
+	test.root = root + L"/";
+	test.packFile = root + L".pak";
+	test.damagedPackFile = root + L"Damaged.pak";
+	test.overrideRoot = root + L"Override/";
+
+	MakeScratchDirectory(root);
+	for (uint32_t dir = 0; dir < 16; ++dir)
+		MakeScratchDirectory(test.root + L"Dir" + to_wstring(dir));
+
+	for (uint32_t i = 0; i < numFiles; ++i)
+	{
+		Bytes contents(1024 + rng() % (15 * 1024));
+		for (uint8_t& b : contents)
+			b = (uint8_t)(rng() >> 24);
+
+		const wstring name = L"Dir" + to_wstring(i % 16) + L"/File" + to_wstring(i) + L".bin";
+		test.smallNames.push_back(name);
+		test.files[name] = contents;
+	}
+
+	test.files[L"empty.bin"] = Bytes();
+	test.files[L"Unicod\u00e9.bin"] = Bytes(100, 0xe9);
+
+	Bytes large(1 << 20);
+	for (size_t i = 0; i < large.size(); ++i)
+		large[i] = (uint8_t)(i * 7 + (i >> 12));
+	test.files[L"large.bin"] = large;
+
+	for (uint32_t i = 0; i < 20000; ++i)
+		test.text.push_back((uint8_t)('a' + rng() % 8));
+	test.files[L"text.txt.gz"] = Gzip(test.text);
+
+	for (auto& file : test.files)
+		WriteScratchFile(test.root + file.first, file.second);
+
+	WriteScratchFile(test.packFile, MakePack(test.files));
+
+	// Directory entries that run past the end of the file
+	Bytes damaged = MakePack(test.files);
+	damaged.resize(damaged.size() - 64);
+	WriteScratchFile(test.damagedPackFile, damaged);
+
+	MakeScratchDirectory(test.overrideRoot);
+	MakeScratchDirectory(test.overrideRoot + L"Dir0");
+	test.overrideFile = Bytes(5, 0x55);
+	WriteScratchFile(test.overrideRoot + test.smallNames[0], test.overrideFile);
+}
+
+void RemoveTestFiles( const TestFiles& test )
+{
+	for (auto& file : test.files)
+		RemoveScratchFile(test.root + file.first);
+	for (uint32_t dir = 0; dir < 16; ++dir)
+		RemoveScratchDirectory(test.root + L"Dir" + to_wstring(dir));
+	RemoveScratchDirectory(test.root);
+
+	RemoveScratchFile(test.overrideRoot + test.smallNames[0]);
+	RemoveScratchDirectory(test.overrideRoot + L"Dir0");
+	RemoveScratchDirectory(test.overrideRoot);
+
+	RemoveScratchFile(test.packFile);
+	RemoveScratchFile(test.damagedPackFile);
+}
+
+// Returns the number of errors found.  Reads through root, or the mounts when it is empty.
+uint32_t CheckReads( Checker& checker, const TestFiles& test, const wstring& root )
+{
+	const uint32_t errorsBefore = checker.errors;
+
+	for (uint32_t i = 0; i < (uint32_t)test.smallNames.size(); ++i)
+	{
+		const wstring& name = test.smallNames[i];
+		const wstring path = root.empty() ? Mangle(name, i) : root + name;
+		checker.Check(Same(FileSystem::MapFile(path), test.files.at(name)), "MapFile() didn't return a small file");
+	}
+
+	// Issued together, waited for afterward
+	vector<concurrency::task<FileView>> reads;
+	for (uint32_t i = 0; i < (uint32_t)test.smallNames.size(); ++i)
+		reads.push_back(FileSystem::ReadAsync(root.empty() ? Mangle(test.smallNames[i], i) : root + test.smallNames[i]));
+	for (uint32_t i = 0; i < (uint32_t)reads.size(); ++i)
+		checker.Check(Same(reads[i].get(), test.files.at(test.smallNames[i])), "ReadAsync() didn't return a small file");
+
+	const Bytes& large = test.files.at(L"large.bin");
+	const Bytes& empty = test.files.at(L"empty.bin");
+	const Bytes& unicode = test.files.at(L"Unicod\u00e9.bin");
+
+	checker.Check(Same(FileSystem::MapFile(root + L"large.bin"), large), "MapFile() didn't return a large file");
+	checker.Check(Same(FileSystem::MapFile(root + L"empty.bin"), empty), "MapFile() didn't return an empty file");
+	// Loose names are only case insensitive where the OS makes them so
+	checker.Check(Same(FileSystem::MapFile(root.empty() ? L"UNICOD\u00e9.BIN" : root + L"Unicod\u00e9.bin"), unicode),
+		"MapFile() didn't find a Unicode name");
+	checker.Check(!FileSystem::MapFile(root + L"Dir0/Missing.bin").IsValid(), "MapFile() found a missing file");
+
+	checker.Check(Same(FileSystem::ReadAsync(root + L"large.bin").get(), large), "ReadAsync() didn't return a large file");
+	checker.Check(Same(FileSystem::ReadAsync(root + L"empty.bin").get(), empty), "ReadAsync() didn't return an empty file");
+	checker.Check(!FileSystem::ReadAsync(root + L"Dir0/Missing.bin").get().IsValid(), "ReadAsync() found a missing file");
+
+	// Loose files are read into a buffer that FileUtility hands over rather than copies.  Pack entries are mapped.
+	const FileView read = FileSystem::ReadAsync(root.empty() ? Mangle(test.smallNames[0], 0) : root + test.smallNames[0]).get();
+	checker.Check(root.empty() ? read.GetBuffer() == nullptr : read.GetBuffer() != nullptr && read.GetBuffer()->data() == read.Data(),
+		"ReadAsync() returned the wrong kind of view");
+
+	const Bytes middle(large.begin() + 1000, large.begin() + 1500);
+	const Bytes tail(large.end() - 100, large.end());
+	checker.Check(Same(FileSystem::ReadAsync(root + L"large.bin", 1000, 500).get(), middle), "A range read was wrong");
+	checker.Check(Same(FileSystem::ReadAsync(root + L"large.bin", large.size() - 100, 500).get(), tail),
+		"A range read didn't stop at the end of the file");
+	checker.Check(!FileSystem::ReadAsync(root + L"large.bin", large.size() + 1, 10).get().IsValid(),
+		"A range read past the end of the file was valid");
+
+	uint64_t size = 0;
+	checker.Check(FileSystem::GetFileSize(root + L"large.bin", size) && size == large.size(), "GetFileSize() was wrong");
+	checker.Check(!FileSystem::GetFileSize(root + L"Dir0/Missing.bin", size), "GetFileSize() found a missing file");
+
+	// Through FileUtility, which looks for ".gz" first
+	checker.Check(Same(ReadFileSync(root + test.smallNames[1]), test.files.at(test.smallNames[1])), "ReadFileSync() was wrong");
+	checker.Check(Same(ReadFileSync(root + L"text.txt"), test.text), "ReadFileSync() didn't inflate a .gz file");
+	checker.Check(Same(ReadFileAsync(root + test.smallNames[2]).get(), test.files.at(test.smallNames[2])), "ReadFileAsync() was wrong");
+	checker.Check(Same(ReadFileAsync(root + L"text.txt").get(), test.text), "ReadFileAsync() didn't inflate a .gz file");
+	checker.Check(ReadFileAsync(root + L"Dir0/Missing.bin").get()->empty(), "ReadFileAsync() found a missing file");
+	checker.Check(Same(ReadFileRangeAsync(root + L"large.bin", 1000, 500).get(), middle), "ReadFileRangeAsync() was wrong");
+
+	return checker.errors - errorsBefore;
+}
+
+// Returns the number of errors found
+uint32_t CheckFileSystem( const TestFiles& test )
+{
+	Checker checker;
+
+	printf("Checking loose files...\n");
+	CheckReads(checker, test, test.root);
+
+	printf("Checking a mounted pack...\n");
+	checker.Check(!FileSystem::MountPackFile(test.damagedPackFile), "A damaged pack was mounted");
+	checker.Check(!FileSystem::MountPackFile(test.root + L"large.bin"), "A file that isn't a pack was mounted");
+	checker.Check(FileSystem::MountPackFile(test.packFile), "The pack wasn't mounted");
+	CheckReads(checker, test, L"");
+
+	printf("Checking a directory mounted over the pack...\n");
+	const FileView packed = FileSystem::MapFile(L"large.bin");
+	checker.Check(FileSystem::MountDirectory(test.overrideRoot), "The directory wasn't mounted");
+	checker.Check(Same(FileSystem::MapFile(test.smallNames[0]), test.overrideFile), "The directory didn't shadow the pack");
+	checker.Check(Same(FileSystem::ReadAsync(test.smallNames[0]).get(), test.overrideFile), "The directory didn't shadow the pack");
+	checker.Check(Same(FileSystem::MapFile(test.smallNames[1]), test.files.at(test.smallNames[1])), "The pack was hidden");
+
+	FileSystem::UnmountAll();
+	checker.Check(!FileSystem::MapFile(test.smallNames[1]).IsValid(), "A file was found after unmounting");
+	checker.Check(Same(packed, test.files.at(L"large.bin")), "A view didn't outlive its pack");
+
+	return checker.errors;
+}
+
+template <typename Function>
+double MicrosecondsPerFile( const TestFiles& test, uint32_t numPasses, Function func )
+{
+	double best = 1e30;
+	for (uint32_t pass = 0; pass < numPasses; ++pass)
+	{
+		const auto start = chrono::high_resolution_clock::now();
+		func();
+		best = min(best, chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
+	}
+	return best * 1e6 / test.smallNames.size();
+}
+
+// Returns the number of errors found
+uint32_t MeasureReads( const TestFiles& test, uint32_t numPasses )
+{
+	Checker checker;
+	size_t expectedBytes = 0;
+	for (const wstring& name : test.smallNames)
+		expectedBytes += test.files.at(name).size();
+
+	printf("\nReading %u files of 1 to 16 KB, best of %u passes:\n\n", (uint32_t)test.smallNames.size(), numPasses);
+
+	// Each file's pages are touched, so that mapped files are really read
+	volatile uint8_t touched = 0;
+	auto Touch = [&]( const uint8_t* data, size_t size )
+	{
+		for (size_t i = 0; i < size; i += 4096)
+			touched += data[i];
+		return size;
+	};
+
+	size_t bytes = 0;
+	auto Report = [&]( const char* what, double us )
+	{
+		checker.Check(bytes == expectedBytes, "Not every file was read");
+		printf("%-32s %8.2f us/file\n", what, us);
+	};
+
+	double us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		bytes = 0;
+		for (const wstring& name : test.smallNames)
+			bytes += ReadFileOldWay(test.root + name)->size();
+	});
+	Report("stat and ifstream (old)", us);
+
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		bytes = 0;
+		for (const wstring& name : test.smallNames)
+		{
+			FileView view = FileSystem::MapFile(test.root + name);
+			bytes += Touch(view.Data(), view.Size());
+		}
+	});
+	Report("loose, MapFile()", us);
+
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		bytes = 0;
+		for (const wstring& name : test.smallNames)
+			bytes += ReadFileSync(test.root + name)->size();
+	});
+	Report("loose, ReadFileSync()", us);
+
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		vector<concurrency::task<FileView>> reads;
+		for (const wstring& name : test.smallNames)
+			reads.push_back(FileSystem::ReadAsync(test.root + name));
+
+		bytes = 0;
+		for (auto& read : reads)
+			bytes += read.get().Size();
+	});
+	Report("loose, ReadAsync()", us);
+
+	// As the texture streamer reads, looking for a ".gz" first and ending with an array rather than a view
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		vector<concurrency::task<ByteArray>> reads;
+		for (const wstring& name : test.smallNames)
+			reads.push_back(ReadFileAsync(test.root + name));
+
+		bytes = 0;
+		for (auto& read : reads)
+			bytes += read.get()->size();
+	});
+	Report("loose, ReadFileAsync()", us);
+
+	FileSystem::MountPackFile(test.packFile);
+
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		bytes = 0;
+		for (const wstring& name : test.smallNames)
+		{
+			FileView view = FileSystem::MapFile(name);
+			bytes += Touch(view.Data(), view.Size());
+		}
+	});
+	Report("pack, MapFile()", us);
+
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		bytes = 0;
+		for (const wstring& name : test.smallNames)
+			bytes += ReadFileSync(name)->size();
+	});
+	Report("pack, ReadFileSync()", us);
+
+	us = MicrosecondsPerFile(test, numPasses, [&]
+	{
+		vector<concurrency::task<FileView>> reads;
+		for (const wstring& name : test.smallNames)
+			reads.push_back(FileSystem::ReadAsync(name));
+
+		bytes = 0;
+		for (auto& read : reads)
+		{
+			FileView view = read.get();
+			bytes += Touch(view.Data(), view.Size());
+		}
+	});
+	Report("pack, ReadAsync()", us);
+
+	FileSystem::UnmountAll();
+	return checker.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-files <n>\n\tSmall files written and read.  Defaults to 4000.\n"
+		"-passes <n>\n\tTimes every file is read, of which the fastest is reported.  Defaults to 3.\n"
+		"-dir <path>\n\tThe scratch directory, which is removed afterward.  Defaults to FileSystemBenchmarkFiles.\n"
+		"\n\nExample:  %s -files 20000 -passes 5\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numFiles = 4000;
+	uint32_t numPasses = 3;
+	string scratchDir = "FileSystemBenchmarkFiles";
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-files", argv[arg]) == 0)
+				numFiles = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-passes", argv[arg]) == 0)
+				numPasses = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-dir", argv[arg]) == 0)
+				scratchDir = argv[++arg];
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numFiles < 16 || numPasses == 0 || scratchDir.empty())
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ File system benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	TestFiles test;
+	uint32_t errors = 0;
+
+	try
+	{
+		WriteTestFiles(test, wstring(scratchDir.begin(), scratchDir.end()), numFiles);
+		errors += CheckFileSystem(test);
+		errors += MeasureReads(test, numPasses);
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n", e.what());
+		++errors;
+	}
+
+	FileSystem::Shutdown();
+
+	// Streaming threads may still ask for files while the engine shuts down
+	if (!test.root.empty() && FileSystem::ReadAsync(test.root + L"large.bin").get().IsValid())
+	{
+		printf("  ReadAsync() read a file after Shutdown()\n");
+		++errors;
+	}
+
+	RemoveTestFiles(test);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,317 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks and measures Utility::HashBytes, which is the only identity of pipeline states, root signatures and
+// samplers, and whose values are stored in the pipeline cache file.
+//
+// Every implementation the CPU supports must match the portable one at every size and alignment, and known
+// inputs must keep their known hashes:  changing them means bumping PipelineCacheFile::kVersion.  Collisions are
+// counted over keys that differ by one or two bits and over sequential keys, for the full 64 bits and for the low
+// 32 bits, where a good hash expects about n^2 / 2^33 of them.  Throughput is reported for each implementation.
+//
+
+#include "Hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace Utility;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+vector<uint8_t> RandomBytes( size_t size, uint32_t seed )
+{
+	mt19937 rng(seed);
+	vector<uint8_t> bytes(size);
+	for (uint8_t& byte : bytes)
+		byte = (uint8_t)rng();
+	return bytes;
+}
+
+// Returns the number of errors found
+uint32_t CheckImplementationsAgree( void )
+{
+	Checker checker;
+
+	// Eight bytes of slack so every size can be hashed at every alignment
+	const size_t kMaxSize = 4100;
+	const vector<uint8_t> bytes = RandomBytes(kMaxSize + 8, 1);
+
+	for (uint32_t i = kHashPortable + 1; i < kNumHashImplementations; ++i)
+	{
+		const HashImplementation impl = (HashImplementation)i;
+		if (!IsHashImplementationSupported(impl))
+		{
+			printf("%-24s  not supported\n", GetHashImplementationName(impl));
+			continue;
+		}
+
+		const uint32_t errorsBefore = checker.errors;
+		for (size_t size = 0; size <= kMaxSize; ++size)
+		{
+			for (size_t offset = 0; offset < 8; ++offset)
+			{
+				const uint64_t seed = size * 0x9E3779B97F4A7C15ull + offset;
+				checker.Check(HashBytes(impl, &bytes[offset], size, seed) == HashBytes(kHashPortable, &bytes[offset], size, seed),
+					"an implementation disagrees with the portable one");
+			}
+		}
+		printf("%-24s  matches the portable implementation:  %s\n", GetHashImplementationName(impl),
+			checker.errors == errorsBefore ? "yes" : "NO");
+	}
+
+	checker.Check(IsHashImplementationSupported(GetHashImplementation()), "the implementation in use is not supported");
+
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckKnownAnswers( void )
+{
+	Checker checker;
+
+	// Sizes either side of the switch from the CRC chains to the wide loop, and across a scramble block
+	struct KnownAnswer
+	{
+		size_t size;
+		uint64_t seed;
+		uint64_t hash;
+	};
+	static const KnownAnswer kKnownAnswers[] =
+	{
+		{    0, 2166136261u,            0x8027E27876A6B985ull },
+		{    3, 2166136261u,            0x4E96955ED1C07959ull },
+		{   64, 2166136261u,            0x13E7F388684890E1ull },
+		{  255, 0,                      0xD9F64B67E83CC7ABull },
+		{  256, 0,                      0x5137A7D1D5043EFCull },
+		{  777, 0x0123456789ABCDEFull,  0x5CED5FFA93E02A1Eull },
+		{ 4096, 2166136261u,            0xE299D41964AE52EBull },
+	};
+
+	const vector<uint8_t> bytes = RandomBytes(4096, 2);
+
+	for (const KnownAnswer& answer : kKnownAnswers)
+	{
+		const uint64_t hash = HashBytes(bytes.data(), answer.size, answer.seed);
+		if (hash != answer.hash)
+			printf("  %zu bytes, seed %llx:  %016llx\n", answer.size, (unsigned long long)answer.seed, (unsigned long long)hash);
+		checker.Check(hash == answer.hash, "a known input hashed to a different value");
+	}
+
+	printf("Known answers:  %u errors\n", checker.errors);
+
+	return checker.errors;
+}
+
+// Sorts the hashes and returns how many equal their predecessor
+size_t CountCollisions( vector<uint64_t>& hashes )
+{
+	sort(hashes.begin(), hashes.end());
+	size_t collisions = 0;
+	for (size_t i = 1; i < hashes.size(); ++i)
+		collisions += hashes[i] == hashes[i - 1] ? 1 : 0;
+	return collisions;
+}
+
+// Counts collisions in the full hashes and in their low 32 bits, which is what a 32-bit CRC would give
+// Returns the number of errors found
+uint32_t ReportCollisions( const char* name, vector<uint64_t>& hashes )
+{
+	Checker checker;
+
+	vector<uint64_t> low(hashes.size());
+	for (size_t i = 0; i < hashes.size(); ++i)
+		low[i] = (uint32_t)hashes[i];
+
+	const size_t full = CountCollisions(hashes);
+	const size_t truncated = CountCollisions(low);
+	const double expected = (double)hashes.size() * (double)hashes.size() / 8589934592.0;
+
+	printf("%-36s  %9zu keys  %4zu 64-bit collisions  %6zu 32-bit collisions (%.1f expected)\n", name, hashes.size(),
+		full, truncated, expected);
+
+	checker.Check(full == 0, "two keys hashed to the same 64-bit value");
+	// Far more than chance means whole groups of keys hash alike
+	checker.Check(truncated <= 4 * expected + 10, "the low 32 bits collide far more often than chance");
+
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckCollisions( uint32_t numKeys )
+{
+	uint32_t errors = 0;
+
+	// Every one and two bit flip of random keys, the kind of difference between two pipeline descriptions
+	{
+		vector<uint64_t> hashes;
+		const size_t kSizes[] = { 8, 12, 64, 120, 256, 1024 };
+		for (size_t size : kSizes)
+		{
+			vector<uint8_t> key = RandomBytes(size, (uint32_t)size);
+			const size_t numBits = size * 8;
+			const size_t stride = max<size_t>(1, numBits / 256);
+
+			hashes.push_back(HashBytes(key.data(), size));
+			for (size_t i = 0; i < numBits; ++i)
+			{
+				key[i / 8] ^= (uint8_t)(1 << (i % 8));
+				hashes.push_back(HashBytes(key.data(), size));
+				// Pairs with bits further along, subsampled for the long keys
+				for (size_t j = i + 1; j < numBits; j += (j < i + 64) ? 1 : stride)
+				{
+					key[j / 8] ^= (uint8_t)(1 << (j % 8));
+					hashes.push_back(HashBytes(key.data(), size));
+					key[j / 8] ^= (uint8_t)(1 << (j % 8));
+				}
+				key[i / 8] ^= (uint8_t)(1 << (i % 8));
+			}
+		}
+		errors += ReportCollisions("One and two bit flips", hashes);
+	}
+
+	// Sequential counters in an otherwise zeroed 64-byte key, as with state descriptions that differ in one field
+	{
+		vector<uint64_t> hashes(numKeys);
+		uint32_t key[16] = {};
+		for (uint32_t i = 0; i < numKeys; ++i)
+		{
+			key[5] = i;
+			hashes[i] = HashState(key, 16);
+		}
+		errors += ReportCollisions("Sequential keys", hashes);
+	}
+
+	// The same key under sequential seeds, which is how HashState chains several descriptions together
+	{
+		vector<uint64_t> hashes(numKeys);
+		const uint32_t key[4] = { 1, 2, 3, 4 };
+		for (uint32_t i = 0; i < numKeys; ++i)
+			hashes[i] = HashState(key, 4, i);
+		errors += ReportCollisions("Sequential seeds", hashes);
+	}
+
+	return errors;
+}
+
+void TimeThroughput( size_t totalBytes )
+{
+	const size_t kSizes[] = { 16, 64, 256, 1024, 4096, 65536, 1 << 20 };
+	const vector<uint8_t> bytes = RandomBytes(1 << 20, 3);
+
+	printf("\n%-24s", "Throughput, GB/s");
+	for (size_t size : kSizes)
+		printf("  %7zu B", size);
+	printf("\n");
+
+	for (uint32_t i = 0; i < kNumHashImplementations; ++i)
+	{
+		const HashImplementation impl = (HashImplementation)i;
+		if (!IsHashImplementationSupported(impl))
+			continue;
+
+		printf("%-24s", GetHashImplementationName(impl));
+		for (size_t size : kSizes)
+		{
+			const size_t count = max<size_t>(1, totalBytes / size);
+			uint64_t hash = 0;
+
+			auto start = chrono::high_resolution_clock::now();
+			// Each hash seeds the next so none of them can be skipped or overlapped
+			for (size_t n = 0; n < count; ++n)
+				hash = HashBytes(impl, bytes.data(), size, hash);
+			const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+			printf("  %9.2f", (double)count * size / seconds / 1e9);
+			if (hash == 42)
+				printf("!");
+		}
+		printf("\n");
+	}
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-keys <n>\n\tSequential keys checked for collisions.  Defaults to 4000000.\n"
+		"-bytes <n>\n\tMegabytes hashed for each throughput measurement.  Defaults to 256.\n"
+		"\n\nExample:  %s -keys 20000000\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numKeys = 4000000;
+	size_t megabytes = 256;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-keys", argv[arg]) == 0)
+				numKeys = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-bytes", argv[arg]) == 0)
+				megabytes = (size_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numKeys == 0 || megabytes == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Hash benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+	printf("Using %s\n\n", GetHashImplementationName(GetHashImplementation()));
+
+	uint32_t errors = CheckImplementationsAgree();
+	errors += CheckKnownAnswers();
+	printf("\n");
+	errors += CheckCollisions(numKeys);
+	TimeThroughput(megabytes << 20);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,645 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks ImageProcessing against scalar references, then times it.  Needs no GPU and no files.
+//
+// The packing references are line-for-line ports of f32tof16(), Pack_R11G11B10_FLOAT() and PackRGBE() from
+// PixelPacking_R11G11B10.hlsli and PixelPacking_RGBE.hlsli, and the SSE versions must match them bit for bit:
+// on every rounding tie of half precision, on random bit patterns (denormals, infinities and NaNs included) and on
+// values spread over the whole range of each format.  Unpacking is checked on every half and against ldexp().
+//
+// Downsampling is checked against a box filter that weighs every source pixel by the area it shares with the
+// destination pixel, in double precision, with sRGB decoded and encoded by the exact formulas.  The SSE version
+// goes through lookup tables and floats, so results must round the reference to within a small slack.  Padded
+// rows, flat images under both filters, and single and multithreaded runs are checked as well.
+//
+
+#include "ImageProcessing.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+inline uint32_t AsUint( float f )
+{
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+inline float AsFloat( uint32_t u )
+{
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+//
+// Scalar references of the HLSL
+//
+
+// f32tof16(), rounding to nearest even.  NaNs become quiet NaNs.
+uint16_t RefFloatToHalf( float f )
+{
+	const uint32_t bits = AsUint(f);
+	const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	const uint32_t abs = bits & 0x7FFFFFFF;
+
+	if (abs > 0x7F800000)
+		return sign | 0x7E00;
+
+	// From halfway between 65504 and 65536 up
+	if (abs >= 0x477FF000)
+		return sign | 0x7C00;
+
+	// Below 2^-14 the result is a denormal, a multiple of 2^-24, which double precision rounds exactly
+	if (abs < 0x38800000)
+		return sign | (uint16_t)nearbyint((double)AsFloat(abs) * 16777216.0);
+
+	uint32_t h = ((abs >> 23) - 112) << 10 | (abs & 0x7FFFFF) >> 13;
+	const uint32_t dropped = abs & 0x1FFF;
+	if (dropped > 0x1000 || (dropped == 0x1000 && (h & 1) != 0))
+		++h;
+	return sign | (uint16_t)h;
+}
+
+// f16tof32()
+float RefHalfToFloat( uint16_t h )
+{
+	const uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	const uint32_t exponent = (h >> 10) & 0x1F;
+	const uint32_t mantissa = h & 0x3FF;
+
+	if (exponent == 0x1F)
+		return AsFloat(sign | 0x7F800000 | mantissa << 13);
+
+	const float f = exponent == 0 ? ldexpf((float)mantissa, -24) : ldexpf((float)(mantissa | 0x400), (int)exponent - 25);
+	return AsFloat(sign | AsUint(f));
+}
+
+// HLSL's min() and max() return the other operand when one is NaN.  fminf() and fmaxf() don't when it is a
+// signaling NaN.
+inline float HlslMin( float a, float b )
+{
+	return a != a ? b : b != b ? a : min(a, b);
+}
+
+inline float HlslMax( float a, float b )
+{
+	return a != a ? b : b != b ? a : max(a, b);
+}
+
+uint32_t RefPack_R11G11B10_FLOAT( const float rgb[3] )
+{
+	const float kMaxVal = AsFloat(0x477C0000);
+	const uint32_t r = (((uint32_t)RefFloatToHalf(HlslMin(rgb[0], kMaxVal)) + 8) >> 4) & 0x000007FF;
+	const uint32_t g = (((uint32_t)RefFloatToHalf(HlslMin(rgb[1], kMaxVal)) + 8) << 7) & 0x003FF800;
+	const uint32_t b = (((uint32_t)RefFloatToHalf(HlslMin(rgb[2], kMaxVal)) + 16) << 17) & 0xFFC00000;
+	return r | g | b;
+}
+
+void RefUnpack_R11G11B10_FLOAT( uint32_t p, float rgb[3] )
+{
+	rgb[0] = RefHalfToFloat((uint16_t)((p << 4) & 0x7FF0));
+	rgb[1] = RefHalfToFloat((uint16_t)((p >> 7) & 0x7FF0));
+	rgb[2] = RefHalfToFloat((uint16_t)((p >> 17) & 0x7FE0));
+}
+
+uint32_t RefPackRGBE( const float in[3] )
+{
+	const float kMaxVal = AsFloat(0x477F8000);
+	const float kMinVal = AsFloat(0x37800000);
+
+	float rgb[3];
+	for (uint32_t c = 0; c < 3; ++c)
+		rgb[c] = HlslMin(HlslMax(in[c], 0.0f), kMaxVal);
+
+	const float maxChannel = HlslMax(HlslMax(kMinVal, rgb[0]), HlslMax(rgb[1], rgb[2]));
+	const float bias = AsFloat((AsUint(maxChannel) + 0x07804000) & 0x7F800000);
+
+	uint32_t RGB[3];
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		volatile float sum = rgb[c] + bias;		// Rounded to single precision, as on the GPU
+		RGB[c] = AsUint(sum);
+	}
+
+	const uint32_t e = (AsUint(bias) << 4) + 0x10000000;
+	return e | RGB[2] << 18 | RGB[1] << 9 | (RGB[0] & 0x1FF);
+}
+
+void RefUnpackRGBE( uint32_t p, float rgb[3] )
+{
+	rgb[0] = ldexpf((float)(p & 0x1FF), (int)(p >> 27) - 24);
+	rgb[1] = ldexpf((float)((p >> 9) & 0x1FF), (int)(p >> 27) - 24);
+	rgb[2] = ldexpf((float)((p >> 18) & 0x1FF), (int)(p >> 27) - 24);
+}
+
+//
+// Inputs
+//
+
+// Every tie between neighboring halves, a step either side of it, and every half itself, of both signs
+vector<float> MakeHalfEdgeCases( void )
+{
+	vector<float> values;
+	for (uint32_t h = 0; h < 0x7C00; ++h)
+	{
+		const float f = RefHalfToFloat((uint16_t)h);
+		const float tie = (f + RefHalfToFloat((uint16_t)(h + 1))) * 0.5f;
+		const float cases[] = { f, tie, nextafterf(tie, 0.0f), nextafterf(tie, INFINITY) };
+		for (float c : cases)
+		{
+			values.push_back(c);
+			values.push_back(-c);
+		}
+	}
+	values.push_back(INFINITY);
+	values.push_back(-INFINITY);
+	values.push_back(AsFloat(0x7FC00000));
+	values.push_back(AsFloat(0xFF800001));
+	return values;
+}
+
+// Random bit patterns, then values spread evenly over each power of two from 2^-30 up to 2^17, then uniform
+// values up to the largest half
+vector<float> MakeRandomValues( size_t count, mt19937& rng )
+{
+	vector<float> values(count);
+	uniform_int_distribution<uint32_t> bits;
+	uniform_real_distribution<float> exponent(-30.0f, 17.0f);
+	uniform_real_distribution<float> linear(0.0f, 65504.0f);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		switch (i % 3)
+		{
+		case 0: values[i] = AsFloat(bits(rng)); break;
+		case 1: values[i] = exp2f(exponent(rng)); break;
+		default: values[i] = linear(rng); break;
+		}
+	}
+	return values;
+}
+
+//
+// Checks
+//
+
+// Returns the number of errors found
+uint32_t CheckHalf( const vector<float>& values )
+{
+	Checker checker;
+
+	vector<uint16_t> packed(values.size());
+	ImageProcessing::PackHalf(values.data(), packed.data(), values.size());
+
+	uint32_t mismatches = 0;
+	for (size_t i = 0; i < values.size(); ++i)
+	{
+		const bool match = packed[i] == RefFloatToHalf(values[i]);
+		mismatches += match ? 0 : 1;
+		checker.Check(match, "PackHalf() differs from f32tof16()");
+	}
+
+	// Every half, including the tails of ForEachGroupOf4()
+	vector<uint16_t> halves(0x10000);
+	for (uint32_t h = 0; h < 0x10000; ++h)
+		halves[h] = (uint16_t)h;
+
+	vector<float> unpacked(halves.size());
+	for (size_t count = 0x10000; count > 0xFFF8; --count)
+	{
+		fill(unpacked.begin(), unpacked.end(), -1.0f);
+		ImageProcessing::UnpackHalf(halves.data(), unpacked.data(), count);
+		for (size_t i = 0; i < halves.size(); ++i)
+		{
+			const uint32_t expected = i < count ? AsUint(RefHalfToFloat(halves[i])) : AsUint(-1.0f);
+			checker.Check(AsUint(unpacked[i]) == expected, "UnpackHalf() differs from f16tof32(), or wrote past the end");
+		}
+	}
+
+	printf("half          %u errors  (%u of %zu values)\n", checker.errors, mismatches, values.size());
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckR11G11B10( const vector<float>& values )
+{
+	Checker checker;
+
+	// Three values per pixel, rotated through the channels so that each channel sees them all
+	const size_t count = values.size() / 3;
+	vector<float> rgba(count * 4);
+	vector<uint32_t> packed(count);
+	vector<float> unpacked(count * 4);
+	uint32_t mismatches = 0;
+
+	for (uint32_t rotation = 0; rotation < 3; ++rotation)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				rgba[i * 4 + c] = values[i * 3 + (c + rotation) % 3];
+			rgba[i * 4 + 3] = 1.0f;
+		}
+
+		ImageProcessing::PackR11G11B10(rgba.data(), packed.data(), count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const bool match = packed[i] == RefPack_R11G11B10_FLOAT(&rgba[i * 4]);
+			mismatches += match ? 0 : 1;
+			checker.Check(match, "PackR11G11B10() differs from Pack_R11G11B10_FLOAT()");
+		}
+
+		ImageProcessing::UnpackR11G11B10(packed.data(), unpacked.data(), count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			float expected[3];
+			RefUnpack_R11G11B10_FLOAT(packed[i], expected);
+			for (uint32_t c = 0; c < 3; ++c)
+				checker.Check(AsUint(unpacked[i * 4 + c]) == AsUint(expected[c]), "UnpackR11G11B10() differs from Unpack_R11G11B10_FLOAT()");
+			checker.Check(unpacked[i * 4 + 3] == 1.0f, "UnpackR11G11B10() didn't set alpha to one");
+		}
+	}
+
+	printf("R11G11B10     %u errors  (%u of %zu pixels)\n", checker.errors, mismatches, count * 3);
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckRGBE( const vector<float>& values )
+{
+	Checker checker;
+
+	// Three values per pixel, rotated through the channels so that each channel sees them all
+	const size_t count = values.size() / 3;
+	vector<float> rgba(count * 4);
+	vector<uint32_t> packed(count);
+	vector<float> unpacked(count * 4);
+	uint32_t mismatches = 0;
+
+	for (uint32_t rotation = 0; rotation < 3; ++rotation)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			for (uint32_t c = 0; c < 3; ++c)
+				rgba[i * 4 + c] = values[i * 3 + (c + rotation) % 3];
+			rgba[i * 4 + 3] = 1.0f;
+		}
+
+		ImageProcessing::PackRGBE(rgba.data(), packed.data(), count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const bool match = packed[i] == RefPackRGBE(&rgba[i * 4]);
+			mismatches += match ? 0 : 1;
+			checker.Check(match, "PackRGBE() differs from PackRGBE() in the shader");
+		}
+
+		ImageProcessing::UnpackRGBE(packed.data(), unpacked.data(), count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			float expected[3];
+			RefUnpackRGBE(packed[i], expected);
+			for (uint32_t c = 0; c < 3; ++c)
+				checker.Check(AsUint(unpacked[i * 4 + c]) == AsUint(expected[c]), "UnpackRGBE() differs from UnpackRGBE() in the shader");
+			checker.Check(unpacked[i * 4 + 3] == 1.0f, "UnpackRGBE() didn't set alpha to one");
+		}
+	}
+
+	printf("RGBE          %u errors  (%u of %zu pixels)\n", checker.errors, mismatches, count * 3);
+	return checker.errors;
+}
+
+double RefToLinear( uint8_t value )
+{
+	const double s = value / 255.0;
+	return s <= 0.04045 ? s / 12.92 : pow((s + 0.055) / 1.055, 2.4);
+}
+
+// Unrounded, in 8-bit steps
+double RefFromLinear( double l )
+{
+	l = min(max(l, 0.0), 1.0);
+	const double s = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+	return s * 255.0;
+}
+
+// The share of each source pixel in each destination pixel along one axis
+vector<vector<double>> RefBoxWeights( uint32_t srcSize, uint32_t destSize )
+{
+	const double scale = (double)srcSize / destSize;
+	vector<vector<double>> weights(destSize, vector<double>(srcSize, 0.0));
+
+	for (uint32_t i = 0; i < destSize; ++i)
+	{
+		for (uint32_t j = 0; j < srcSize; ++j)
+			weights[i][j] = max(0.0, min(j + 1.0, (i + 1) * scale) - max((double)j, i * scale)) / scale;
+	}
+	return weights;
+}
+
+// How far past the rounding boundary a result may land.  Filtering in floats moves values by far less than a
+// thousandth of a step, and rounding the sRGB tables' index to 16 bits by up to 0.025 of a step near black.
+const double kRoundingSlack[2] = { 0.001, 0.05 };
+
+// Returns the number of errors found, and raises maxError to the largest distance, in 8-bit steps, between a result
+// and the unrounded reference
+uint32_t CheckBoxDownsample( uint32_t width, uint32_t height, bool sRGB, mt19937& rng, double& maxError )
+{
+	Checker checker;
+
+	vector<uint8_t> src((size_t)width * height * 4);
+	uniform_int_distribution<uint32_t> byteValue(0, 255);
+	for (uint8_t& b : src)
+		b = (uint8_t)byteValue(rng);
+
+	const uint32_t destWidth = max(width / 2, 1u);
+	const uint32_t destHeight = max(height / 2, 1u);
+
+	// Padded pitches, with a guard byte pattern after each row
+	const size_t srcPitch = width * 4 + 12;
+	const size_t destPitch = destWidth * 4 + 12;
+	vector<uint8_t> paddedSrc(srcPitch * height, 0xCD);
+	for (uint32_t y = 0; y < height; ++y)
+		memcpy(&paddedSrc[y * srcPitch], &src[(size_t)y * width * 4], width * 4);
+
+	vector<uint8_t> dest(destPitch * destHeight, 0xCD), single(destPitch * destHeight, 0xCD);
+	ImageProcessing::Downsample(ImageProcessing::kBox, sRGB, paddedSrc.data(), srcPitch, width, height, dest.data(), destPitch);
+	ImageProcessing::Downsample(ImageProcessing::kBox, sRGB, paddedSrc.data(), srcPitch, width, height, single.data(), destPitch, false);
+	checker.Check(dest == single, "multithreaded and single-threaded downsampling differ");
+
+	const vector<vector<double>> weightsX = RefBoxWeights(width, destWidth);
+	const vector<vector<double>> weightsY = RefBoxWeights(height, destHeight);
+
+	for (uint32_t y = 0; y < destHeight; ++y)
+	{
+		for (uint32_t x = 0; x < destWidth; ++x)
+		{
+			double sum[4] = {};
+			for (uint32_t j = 0; j < height; ++j)
+			{
+				for (uint32_t i = 0; i < width; ++i)
+				{
+					const double w = weightsX[x][i] * weightsY[y][j];
+					if (w == 0.0)
+						continue;
+
+					const uint8_t* pixel = &src[((size_t)j * width + i) * 4];
+					for (uint32_t c = 0; c < 4; ++c)
+						sum[c] += w * (sRGB && c < 3 ? RefToLinear(pixel[c]) : pixel[c] / 255.0);
+				}
+			}
+
+			const uint8_t* result = &dest[y * destPitch + x * 4];
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const double expected = sRGB && c < 3 ? RefFromLinear(sum[c]) : sum[c] * 255.0;
+				const double error = fabs(result[c] - expected);
+				checker.Check(error <= 0.5 + kRoundingSlack[sRGB], "downsampled pixel isn't the reference box filter rounded");
+				maxError = max(maxError, error);
+			}
+		}
+
+		for (size_t i = destWidth * 4; i < destPitch; ++i)
+			checker.Check(dest[y * destPitch + i] == 0xCD, "Downsample() wrote past the end of a row");
+	}
+
+	return checker.errors;
+}
+
+// Returns the number of errors found.  Both filters' weights must sum to one, so a flat image stays flat.
+uint32_t CheckFlat( uint32_t width, uint32_t height )
+{
+	Checker checker;
+
+	for (uint32_t f = 0; f < ImageProcessing::kNumFilters; ++f)
+	{
+		for (uint32_t value = 0; value < 256; value += 17)
+		{
+			const vector<uint8_t> src((size_t)width * height * 4, (uint8_t)value);
+			vector<uint8_t> dest((size_t)max(width / 2, 1u) * max(height / 2, 1u) * 4);
+
+			for (uint32_t s = 0; s < 2; ++s)
+			{
+				ImageProcessing::Downsample((ImageProcessing::Filter)f, s != 0, src.data(), width * 4, width, height,
+					dest.data(), max(width / 2, 1u) * 4);
+				for (uint8_t b : dest)
+					checker.Check(b == value, "a flat image didn't stay flat");
+			}
+		}
+	}
+
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckDownsampling( mt19937& rng )
+{
+	Checker checker;
+
+	static const uint32_t kSizes[][2] = { { 64, 64 }, { 256, 128 }, { 63, 37 }, { 5, 3 }, { 3, 5 }, { 1, 17 }, { 17, 1 },
+		{ 2, 2 }, { 1, 1 }, { 130, 67 } };
+
+	double maxError[2] = {};
+	for (auto& size : kSizes)
+	{
+		for (uint32_t s = 0; s < 2; ++s)
+			checker.errors += CheckBoxDownsample(size[0], size[1], s != 0, rng, maxError[s]);
+		checker.errors += CheckFlat(size[0], size[1]);
+	}
+
+	printf("downsampling  %u errors  (at most %.4f linear and %.4f sRGB steps from the reference)\n", checker.errors,
+		maxError[0], maxError[1]);
+	return checker.errors;
+}
+
+//
+// Timings
+//
+
+template <typename Func>
+double TimeIt( Func func )
+{
+	// Repeat short runs so that the timer has something to measure
+	uint32_t iterations = 0;
+	auto start = chrono::high_resolution_clock::now();
+	double seconds = 0.0;
+	do
+	{
+		func();
+		++iterations;
+		seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	}
+	while (seconds < 0.25);
+
+	return seconds / iterations;
+}
+
+void TimePacking( const vector<float>& values )
+{
+	const size_t count = values.size() / 4;
+	vector<float> rgba(count * 4);
+	for (size_t i = 0; i < rgba.size(); ++i)
+		rgba[i] = fabsf(values[i]) < 1e6f ? fabsf(values[i]) : 1.0f;
+
+	vector<uint16_t> halves(rgba.size());
+	vector<uint32_t> packed(count);
+	const double megaPixels = count / 1e6;
+	const double megaValues = rgba.size() / 1e6;
+
+	printf("%-24s %10s %10s\n", "M values per second", "SSE", "scalar");
+
+	double sse = TimeIt([&] { ImageProcessing::PackHalf(rgba.data(), halves.data(), rgba.size()); });
+	double scalar = TimeIt([&] { for (size_t i = 0; i < rgba.size(); ++i) halves[i] = RefFloatToHalf(rgba[i]); });
+	printf("%-24s %10.1f %10.1f\n", "PackHalf", megaValues / sse, megaValues / scalar);
+
+	sse = TimeIt([&] { ImageProcessing::PackR11G11B10(rgba.data(), packed.data(), count); });
+	scalar = TimeIt([&] { for (size_t i = 0; i < count; ++i) packed[i] = RefPack_R11G11B10_FLOAT(&rgba[i * 4]); });
+	printf("%-24s %10.1f %10.1f\n", "PackR11G11B10 (pixels)", megaPixels / sse, megaPixels / scalar);
+
+	sse = TimeIt([&] { ImageProcessing::PackRGBE(rgba.data(), packed.data(), count); });
+	scalar = TimeIt([&] { for (size_t i = 0; i < count; ++i) packed[i] = RefPackRGBE(&rgba[i * 4]); });
+	printf("%-24s %10.1f %10.1f\n", "PackRGBE (pixels)", megaPixels / sse, megaPixels / scalar);
+
+	printf("\n");
+}
+
+void TimeDownsampling( uint32_t size, mt19937& rng )
+{
+	vector<uint8_t> src((size_t)size * size * 4);
+	uniform_int_distribution<uint32_t> byteValue(0, 255);
+	for (uint8_t& b : src)
+		b = (uint8_t)byteValue(rng);
+
+	const uint32_t mipCount = ImageProcessing::GetMipCount(size, size);
+	vector<uint8_t> chain(ImageProcessing::GetMipChainSize(size, size, mipCount, 4));
+	const double megaPixels = (double)size * size / 1e6;
+
+	printf("%-24s %10s %10s\n", "Source MPix per second", "1 thread", "threads");
+
+	for (uint32_t f = 0; f < ImageProcessing::kNumFilters; ++f)
+	{
+		const ImageProcessing::Filter filt = (ImageProcessing::Filter)f;
+		for (uint32_t s = 0; s < 2; ++s)
+		{
+			double seconds[2];
+			for (uint32_t t = 0; t < 2; ++t)
+			{
+				seconds[t] = TimeIt([&] { ImageProcessing::Downsample(filt, s != 0, src.data(), size * 4, size, size,
+					chain.data(), size * 2, t != 0); });
+			}
+
+			char label[64];
+			snprintf(label, sizeof(label), "%s, %s", ImageProcessing::GetFilterName(filt), s != 0 ? "sRGB" : "linear");
+			printf("%-24s %10.1f %10.1f\n", label, megaPixels / seconds[0], megaPixels / seconds[1]);
+		}
+	}
+
+	double seconds[2];
+	for (uint32_t t = 0; t < 2; ++t)
+		seconds[t] = TimeIt([&] { ImageProcessing::GenerateMipChain(ImageProcessing::kBox, true, src.data(), size, size, mipCount, chain.data(), t != 0); });
+	printf("%-24s %10.1f %10.1f\n", "Mip chain, Box, sRGB", megaPixels / seconds[0], megaPixels / seconds[1]);
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-values <n>\n\tRandom values packed and checked.  Defaults to 3000000.\n"
+		"-size <n>\n\tThe width and height of the image downsampled for timing.  Defaults to 2048.\n"
+		"-seed <n>\n\tSeeds the random values and images.  Defaults to 1.\n"
+		"\n\nExample:  %s -size 4096\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numValues = 3000000;
+	uint32_t size = 2048;
+	uint32_t seed = 1;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-values", argv[arg]) == 0)
+				numValues = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-size", argv[arg]) == 0)
+				size = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seed", argv[arg]) == 0)
+				seed = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numValues < 12 || size == 0 || size > 16384)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Image processing benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	mt19937 rng(seed);
+	const vector<float> edgeCases = MakeHalfEdgeCases();
+	const vector<float> randomValues = MakeRandomValues(numValues, rng);
+
+	vector<float> allValues = edgeCases;
+	allValues.insert(allValues.end(), randomValues.begin(), randomValues.end());
+
+	uint32_t errors = CheckHalf(allValues);
+	errors += CheckR11G11B10(allValues);
+	errors += CheckRGBE(allValues);
+	errors += CheckDownsampling(rng);
+
+	printf("\n");
+	TimePacking(randomValues);
+	TimeDownsampling(size, rng);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
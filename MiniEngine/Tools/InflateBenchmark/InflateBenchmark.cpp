@@ -0,0 +1,379 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures how fast .gz assets are decompressed:  the same data as one gzip stream, inflated on one thread, and as
+// a chunked file (as written by Tools/Scripts/CompressChunked.py), inflated in parallel.  The data is text-like,
+// texture-like (blocks of noise with repeated runs), or nearly all zeros.
+//
+// Both must give back exactly what was compressed.  A gzip trailer that claims too much, or too little, must not
+// change the result, and must not make the first allocation larger than kMaxInflateGuessRatio times the file.
+// Damaged or truncated chunked files must fail as a whole, and a chunk that claims more than deflate could hold
+// must be rejected before anything is allocated for it.
+//
+
+#include "pch.h"
+#include "Inflate.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+typedef vector<uint8_t> Bytes;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+enum DataKind
+{
+	kText,
+	kTexture,
+	kZeros,
+
+	kNumDataKinds
+};
+
+const char* kDataKindNames[] = { "text", "texture", "zeros" };
+
+Bytes MakeData( DataKind kind, size_t size, uint32_t seed )
+{
+	mt19937 rng(seed);
+	Bytes data;
+	data.reserve(size + 64);
+
+	switch (kind)
+	{
+	case kText:
+	{
+		// Words drawn unevenly from a small vocabulary
+		vector<string> words;
+		for (uint32_t i = 0; i < 2000; ++i)
+		{
+			string word;
+			for (uint32_t n = 2 + rng() % 9; n > 0; --n)
+				word += (char)('a' + rng() % 26);
+			words.push_back(word);
+		}
+
+		while (data.size() < size)
+		{
+			const string& word = words[min(rng() % 2000, rng() % 2000)];
+			data.insert(data.end(), word.begin(), word.end());
+			data.push_back(rng() % 12 == 0 ? '\n' : ' ');
+		}
+		break;
+	}
+	case kTexture:
+		// 16 byte blocks, a third of them repeats of a recent block
+		while (data.size() < size)
+		{
+			if (data.size() >= 256 && rng() % 3 == 0)
+			{
+				const size_t from = data.size() - 16 * (1 + rng() % 16);
+				for (size_t i = 0; i < 16; ++i)
+					data.push_back(data[from + i]);
+			}
+			else
+			{
+				for (size_t i = 0; i < 16; ++i)
+					data.push_back((uint8_t)(rng() >> (i % 4 == 0 ? 24 : 29)));
+			}
+		}
+		break;
+	case kZeros:
+		data.resize(size);
+		for (size_t i = 0; i < size; i += 1 + rng() % (1 << 20))
+			data[i] = (uint8_t)rng();
+		break;
+	default:
+		break;
+	}
+
+	data.resize(size);
+	return data;
+}
+
+void PutLE32( Bytes& out, uint32_t value )
+{
+	for (uint32_t i = 0; i < 4; ++i)
+		out.push_back((uint8_t)(value >> (i * 8)));
+}
+
+void SetLE32( uint8_t* out, uint32_t value )
+{
+	for (uint32_t i = 0; i < 4; ++i)
+		out[i] = (uint8_t)(value >> (i * 8));
+}
+
+// windowBits as for deflateInit2():  -15 raw deflate, 15 zlib, 31 gzip
+Bytes Deflate( const uint8_t* data, size_t size, int level, int windowBits )
+{
+	z_stream strm = {};
+	if (deflateInit2(&strm, level, Z_DEFLATED, windowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		throw runtime_error("deflateInit2 failed");
+
+	Bytes out(deflateBound(&strm, (uLong)size));
+	strm.next_in = (Bytef*)data;
+	strm.avail_in = (uInt)size;
+	strm.next_out = out.data();
+	strm.avail_out = (uInt)out.size();
+
+	const int err = deflate(&strm, Z_FINISH);
+	out.resize(strm.total_out);
+	deflateEnd(&strm);
+
+	if (err != Z_STREAM_END)
+		throw runtime_error("deflate failed");
+	return out;
+}
+
+// The same layout as Tools/Scripts/CompressChunked.py
+Bytes CompressChunked( const Bytes& data, size_t blockSize, int level )
+{
+	Bytes out;
+	for (size_t start = 0; start < max<size_t>(data.size(), 1); start += blockSize)
+	{
+		const size_t size = min(blockSize, data.size() - start);
+		const Bytes deflated = Deflate(data.data() + start, size, level, -15);
+		const uint32_t memberSize = (uint32_t)(12 + 12 + deflated.size() + 8);
+
+		const uint8_t header[12] = { 0x1f, 0x8b, 8, 0x04, 0, 0, 0, 0, 0, 255, 12, 0 };
+		out.insert(out.end(), header, header + 12);
+		out.push_back('M');
+		out.push_back('E');
+		out.push_back(8);
+		out.push_back(0);
+		PutLE32(out, memberSize);
+		PutLE32(out, (uint32_t)size);
+		out.insert(out.end(), deflated.begin(), deflated.end());
+		PutLE32(out, (uint32_t)crc32(0, data.data() + start, (uInt)size));
+		PutLE32(out, (uint32_t)size);
+	}
+	return out;
+}
+
+// Returns the number of errors found
+uint32_t CheckRoundTrips( void )
+{
+	Checker checker;
+	printf("Checking round trips and damaged files...\n");
+
+	for (uint32_t kind = 0; kind < kNumDataKinds; ++kind)
+	{
+		for (size_t size : { (size_t)0, (size_t)1, (size_t)1000, (size_t)(256 << 10), (size_t)(3 << 20) + 17 })
+		{
+			const Bytes data = MakeData((DataKind)kind, size, 1 + kind);
+			const Bytes gzip = Deflate(data.data(), data.size(), 6, 31);
+			const Bytes zlib = Deflate(data.data(), data.size(), 6, 15);
+			const Bytes chunked = CompressChunked(data, 64 << 10, 6);
+
+			Bytes result;
+			checker.Check(Utility::Inflate(gzip.data(), gzip.size(), result) == Z_STREAM_END && result == data,
+				"A gzip stream didn't round trip");
+			checker.Check(Utility::Inflate(zlib.data(), zlib.size(), result) == Z_STREAM_END && result == data,
+				"A zlib stream didn't round trip");
+			checker.Check(!Utility::InflateChunked(gzip.data(), gzip.size(), result),
+				"A gzip stream was taken for a chunked file");
+			checker.Check(Utility::InflateChunked(chunked.data(), chunked.size(), result) && result == data,
+				"A chunked file didn't round trip");
+
+			if (size == 0)
+				continue;
+
+			// The trailer claims 4 GB.  zlib checks it once the data is inflated, which is too late to size the
+			// destination by.
+			Bytes lying = gzip;
+			SetLE32(lying.data() + lying.size() - 4, 0xffffffff);
+			Bytes fresh;
+			checker.Check(Utility::Inflate(lying.data(), lying.size(), fresh) != Z_STREAM_END && fresh.empty(),
+				"A gzip stream with the wrong size was accepted");
+			checker.Check(fresh.capacity() <= max(lying.size() * Utility::kMaxInflateGuessRatio, 2 * data.size()),
+				"A gzip stream's size was believed past the limit");
+
+			// Truncated and damaged
+			Bytes damaged(gzip.begin(), gzip.begin() + gzip.size() / 2);
+			checker.Check(Utility::Inflate(damaged.data(), damaged.size(), result) != Z_STREAM_END && result.empty(),
+				"A truncated gzip stream was accepted");
+
+			// Not taken for a chunked file at all is fine too, since then it is inflated as a damaged gzip stream
+			damaged.assign(chunked.begin(), chunked.end() - 1);
+			Utility::InflateChunked(damaged.data(), damaged.size(), result);
+			checker.Check(result.empty(), "A truncated chunked file was accepted");
+
+			damaged = chunked;
+			damaged[24] ^= 0x5a;
+			Utility::InflateChunked(damaged.data(), damaged.size(), result);
+			checker.Check(result.empty(), "A chunked file with damaged data was accepted");
+
+			damaged = chunked;
+			damaged[damaged.size() - 8] ^= 0x5a;
+			checker.Check(Utility::InflateChunked(damaged.data(), damaged.size(), result) && result.empty(),
+				"A chunked file with a damaged CRC was accepted");
+
+			// The last chunk claims more than its deflated bytes could hold, in its header and trailer alike
+			damaged = chunked;
+			size_t last = 0;
+			for (size_t offset = 0; offset < damaged.size(); )
+			{
+				last = offset;
+				offset += damaged[offset + 16] | damaged[offset + 17] << 8 | damaged[offset + 18] << 16 |
+					(size_t)damaged[offset + 19] << 24;
+			}
+			SetLE32(damaged.data() + last + 20, 0x7fffffff);
+			SetLE32(damaged.data() + damaged.size() - 4, 0x7fffffff);
+			Bytes unallocated;
+			const bool wasChunked = Utility::InflateChunked(damaged.data(), damaged.size(), unallocated);
+			checker.Check(wasChunked == (last > 0) && unallocated.capacity() == 0,
+				"A chunk too large for its deflated size was accepted");
+		}
+	}
+
+	return checker.errors;
+}
+
+template <typename Function>
+double MegabytesPerSecond( size_t size, uint32_t numRepeats, Function func )
+{
+	double best = 1e30;
+	for (uint32_t i = 0; i < numRepeats; ++i)
+	{
+		const auto start = chrono::high_resolution_clock::now();
+		func();
+		best = min(best, chrono::duration<double>(chrono::high_resolution_clock::now() - start).count());
+	}
+	return size / best / (1 << 20);
+}
+
+struct ThroughputSettings
+{
+	size_t size;
+	size_t blockSize;
+	int level;
+	uint32_t numRepeats;
+};
+
+// Returns the number of errors found
+uint32_t MeasureThroughput( DataKind kind, const ThroughputSettings& settings )
+{
+	Checker checker;
+
+	const Bytes data = MakeData(kind, settings.size, 1000 + kind);
+	const Bytes gzip = Deflate(data.data(), data.size(), settings.level, 31);
+	const Bytes chunked = CompressChunked(data, settings.blockSize, settings.level);
+
+	Bytes result;
+	const double gzipRate = MegabytesPerSecond(data.size(), settings.numRepeats, [&]
+	{
+		checker.Check(Utility::Inflate(gzip.data(), gzip.size(), result) == Z_STREAM_END, "Inflate() failed");
+	});
+	checker.Check(result == data, "A gzip stream didn't round trip");
+
+	const double chunkedRate = MegabytesPerSecond(data.size(), settings.numRepeats, [&]
+	{
+		checker.Check(Utility::InflateChunked(chunked.data(), chunked.size(), result), "InflateChunked() failed");
+	});
+	checker.Check(result == data, "A chunked file didn't round trip");
+
+	printf("%-8s  %8.2f  %8.1f MB/s  %8.2f  %8.1f MB/s  %5.2fx\n", kDataKindNames[kind],
+		(double)data.size() / gzip.size(), gzipRate, (double)data.size() / chunked.size(), chunkedRate, chunkedRate / gzipRate);
+
+	return checker.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-size <n>\n\tMegabytes of each kind of data.  Defaults to 64.\n"
+		"-block <n>\n\tKilobytes in each chunk of a chunked file.  Defaults to 256.\n"
+		"-level <n>\n\tCompression level, 1 to 9.  Defaults to 9, as CompressChunked.py uses.\n"
+		"-repeat <n>\n\tTimes each file is decompressed, of which the fastest is reported.  Defaults to 3.\n"
+		"\n\nExample:  %s -size 256 -block 1024\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	ThroughputSettings settings = { 64, 256, 9, 3 };
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-size", argv[arg]) == 0)
+				settings.size = (size_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-block", argv[arg]) == 0)
+				settings.blockSize = (size_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-level", argv[arg]) == 0)
+				settings.level = atoi(argv[++arg]);
+			else if (strcmp("-repeat", argv[arg]) == 0)
+				settings.numRepeats = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (settings.size == 0 || settings.size > 2048 || settings.blockSize == 0 || settings.blockSize > (1 << 20) ||
+			settings.level < 1 || settings.level > 9 || settings.numRepeats == 0)
+		{
+			throw runtime_error("Invalid operand");
+		}
+		settings.size <<= 20;
+		settings.blockSize <<= 10;
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Inflate benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = CheckRoundTrips();
+
+	printf("\n%u MB of each, level %d, %u KB chunks:\n\n", (uint32_t)(settings.size >> 20), settings.level,
+		(uint32_t)(settings.blockSize >> 10));
+	printf("%-8s  %8s  %13s  %8s  %13s  %6s\n", "data", "gzip", "one stream", "chunked", "in parallel", "speedup");
+
+	for (uint32_t kind = 0; kind < kNumDataKinds; ++kind)
+		errors += MeasureThroughput((DataKind)kind, settings);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,386 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Drives LinearPagePool with fake pages and a simulated fence, so the bookkeeping the linear allocators rely on
+// can be timed and checked without a device.
+//
+// The policy checks run on one thread:  discarded pages are not handed out until their fence completes and are
+// reused after, large pages are rounded to a size class and recycled by class, pooled large pages stay within
+// the budget, and Destroy() releases every page exactly once.
+//
+// The stress run has worker threads request, discard and free pages while one thread submits fence values and
+// another completes them.  Each fake page records whether it is in use or the fence it was retired against, which
+// catches a page being handed out twice or before the GPU is done with it.
+//
+
+#include "LinearPagePool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+static const size_t kPageSize = 64 * 1024;
+
+// Stands in for a command queue.  Values are submitted by one thread and completed by another.
+class SimulatedFence : public IFenceSource
+{
+public:
+	SimulatedFence() : m_NextFenceValue(1), m_CompletedFenceValue(0) {}
+
+	uint64_t GetNextFenceValue() override { return m_NextFenceValue.load(); }
+	bool IsFenceComplete( uint64_t fenceValue ) override { return fenceValue <= m_CompletedFenceValue.load(); }
+
+	// Returns the value signaled
+	uint64_t Submit() { return m_NextFenceValue++; }
+
+	// Completes one more submitted value, keeping at least lag values in flight
+	void Advance( uint64_t lag )
+	{
+		const uint64_t submitted = m_NextFenceValue.load() - 1;
+		const uint64_t completed = m_CompletedFenceValue.load();
+		if (completed + lag < submitted)
+			m_CompletedFenceValue.store(completed + 1);
+	}
+
+	void CompleteAll() { m_CompletedFenceValue.store(m_NextFenceValue.load() - 1); }
+
+private:
+	atomic<uint64_t> m_NextFenceValue;
+	atomic<uint64_t> m_CompletedFenceValue;
+};
+
+// 0 when new, kInUse while handed out, or one more than the fence value it was retired against
+static const uint64_t kInUse = ~0ull;
+
+struct FakePage : public LinearPageNode
+{
+	atomic<uint64_t> state;
+	size_t requestedSize;
+
+	FakePage( size_t size ) : state(0), requestedSize(size) {}
+};
+
+class FakePageFactory : public ILinearPageFactory
+{
+public:
+	FakePageFactory() : numCreated(0), numDestroyed(0), errors(0) {}
+
+	LinearPageNode* CreatePage( size_t pageSize ) override
+	{
+		FakePage* page = new FakePage(pageSize);
+		lock_guard<mutex> lockGuard(m_Mutex);
+		m_Live.insert(page);
+		++numCreated;
+		return page;
+	}
+
+	void DestroyPage( LinearPageNode* page ) override
+	{
+		{
+			lock_guard<mutex> lockGuard(m_Mutex);
+			if (m_Live.erase(page) == 0)
+			{
+				++errors;
+				printf("  a page was destroyed twice or was never created\n");
+				return;
+			}
+			++numDestroyed;
+		}
+		delete static_cast<FakePage*>(page);
+	}
+
+	size_t GetNumLive() { lock_guard<mutex> lockGuard(m_Mutex); return m_Live.size(); }
+
+	atomic<uint32_t> numCreated;
+	atomic<uint32_t> numDestroyed;
+	atomic<uint32_t> errors;
+
+private:
+	mutex m_Mutex;
+	set<LinearPageNode*> m_Live;
+};
+
+struct Checker
+{
+	atomic<uint32_t> errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+void MarkInUse( Checker& checker, SimulatedFence& fence, LinearPageNode* node )
+{
+	const uint64_t previous = static_cast<FakePage*>(node)->state.exchange(kInUse);
+	checker.Check(previous != kInUse, "a page was handed out twice");
+	checker.Check(previous == 0 || previous == kInUse || fence.IsFenceComplete(previous - 1),
+		"a page was handed out before its fence completed");
+}
+
+void MarkRetired( LinearPageNode* node, uint64_t fenceValue )
+{
+	static_cast<FakePage*>(node)->state.store(fenceValue + 1);
+}
+
+// Returns the number of errors found
+uint32_t CheckPolicy( void )
+{
+	Checker checker;
+	SimulatedFence fence;
+	FakePageFactory factory;
+	LinearPagePool pool;
+
+	const size_t budget = 4 * 1024 * 1024;
+	pool.Create(&fence, &factory, kPageSize, budget);
+
+	// Standard pages come back only once their fence has passed
+	LinearPageNode* pages[8];
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		pages[i] = pool.RequestPage();
+		checker.Check(pages[i]->m_PageSize == kPageSize, "standard page has the wrong size");
+		MarkInUse(checker, fence, pages[i]);
+	}
+
+	uint64_t fenceValue = fence.Submit();
+	for (uint32_t i = 0; i < 8; ++i)
+		MarkRetired(pages[i], fenceValue);
+	pool.DiscardPages(fenceValue, pages, 8);
+
+	LinearPageNode* early = pool.RequestPage();
+	MarkInUse(checker, fence, early);
+	checker.Check(pool.GetNumPagesCreated() == 9, "a discarded page was reused before its fence completed");
+
+	fence.CompleteAll();
+	for (uint32_t i = 0; i < 8; ++i)
+		MarkInUse(checker, fence, pool.RequestPage());
+	checker.Check(pool.GetNumPagesCreated() == 9, "discarded pages were not reused after their fence completed");
+
+	// A freed large page is reused by any request of the same class, but not before its fence
+	LinearPageNode* large = pool.RequestLargePage(300 * 1024);
+	MarkInUse(checker, fence, large);
+	const size_t classSize = large->m_PageSize;
+
+	fenceValue = fence.Submit();
+	MarkRetired(large, fenceValue);
+	pool.FreeLargePages(fenceValue, &large, 1);
+
+	LinearPageNode* sameClass = pool.RequestLargePage(classSize - 1);
+	MarkInUse(checker, fence, sameClass);
+	checker.Check(sameClass != large, "a large page was reused before its fence completed");
+
+	fence.CompleteAll();
+	LinearPageNode* reused = pool.RequestLargePage(classSize);
+	MarkInUse(checker, fence, reused);
+	checker.Check(reused == large, "a freed large page was not reused by its size class");
+
+	fenceValue = fence.Submit();
+	pool.FreeLargePages(fenceValue, &sameClass, 1);
+	pool.FreeLargePages(fenceValue, &reused, 1);
+
+	// Large pages round up to one of four classes per power of two
+	for (size_t size = kPageSize + 1; size < 64 * 1024 * 1024; size = size * 5 / 4 + 37)
+	{
+		LinearPageNode* page = pool.RequestLargePage(size);
+		checker.Check(page->m_PageSize >= size, "large page smaller than requested");
+		checker.Check(page->m_PageSize - size < size / 4 + 1, "large page rounded up by more than a quarter");
+
+		fenceValue = fence.Submit();
+		pool.FreeLargePages(fenceValue, &page, 1);
+	}
+
+	// Flood the pool with large pages:  what is kept must stay within the budget
+	vector<LinearPageNode*> flood;
+	for (uint32_t i = 0; i < 64; ++i)
+		flood.push_back(pool.RequestLargePage(1024 * 1024 + i * 4096));
+	fenceValue = fence.Submit();
+	pool.FreeLargePages(fenceValue, flood.data(), flood.size());
+	fence.CompleteAll();
+	LinearPageNode* inUse = pool.RequestLargePage(8 * 1024 * 1024);
+	checker.Check(pool.GetPooledLargePageBytes() <= budget, "pooled large pages exceed the budget");
+
+	// Standard pages are released wherever they are, large ones only when pooled or waiting on a fence
+	pool.Destroy();
+	checker.Check(factory.GetNumLive() == 1, "Destroy() did not release every pooled or retired page");
+	factory.DestroyPage(inUse);
+
+	printf("Policy checks:  %u pages created, %u destroyed, %u errors\n", factory.numCreated.load(),
+		factory.numDestroyed.load(), checker.errors.load() + factory.errors.load());
+
+	return checker.errors + factory.errors;
+}
+
+void Worker( LinearPagePool& pool, SimulatedFence& fence, Checker& checker, uint32_t seed, uint32_t numOps )
+{
+	mt19937 rng(seed);
+	vector<LinearPageNode*> pages;
+	vector<LinearPageNode*> largePages;
+
+	for (uint32_t op = 0; op < numOps; ++op)
+	{
+		// A command context fills a few pages and a large one now and then, then closes against a fence
+		const uint32_t numPages = 1 + rng() % 4;
+		for (uint32_t i = 0; i < numPages; ++i)
+		{
+			pages.push_back(pool.RequestPage());
+			MarkInUse(checker, fence, pages.back());
+		}
+
+		if (rng() % 8 == 0)
+		{
+			largePages.push_back(pool.RequestLargePage(kPageSize + rng() % (4 * 1024 * 1024)));
+			MarkInUse(checker, fence, largePages.back());
+		}
+
+		// The value the context will be signaled with can only be later than this one
+		const uint64_t fenceValue = fence.GetNextFenceValue();
+		for (LinearPageNode* page : pages)
+			MarkRetired(page, fenceValue);
+		for (LinearPageNode* page : largePages)
+			MarkRetired(page, fenceValue);
+
+		pool.DiscardPages(fenceValue, pages.data(), pages.size());
+		pool.FreeLargePages(fenceValue, largePages.data(), largePages.size());
+		pages.clear();
+		largePages.clear();
+	}
+}
+
+// Returns the number of errors found
+uint32_t Stress( uint32_t numThreads, uint32_t numOps )
+{
+	Checker checker;
+	SimulatedFence fence;
+	FakePageFactory factory;
+	LinearPagePool pool;
+	pool.Create(&fence, &factory, kPageSize, 32 * 1024 * 1024);
+
+	atomic<bool> running(true);
+
+	thread renderThread([&]
+	{
+		while (running.load())
+		{
+			fence.Submit();
+			this_thread::yield();
+		}
+	});
+
+	thread gpuThread([&]
+	{
+		while (running.load())
+		{
+			fence.Advance(4);
+			this_thread::yield();
+		}
+	});
+
+	auto start = chrono::high_resolution_clock::now();
+
+	vector<thread> workers;
+	for (uint32_t i = 0; i < numThreads; ++i)
+		workers.emplace_back(Worker, ref(pool), ref(fence), ref(checker), i, numOps);
+	for (thread& worker : workers)
+		worker.join();
+
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	running = false;
+	renderThread.join();
+	gpuThread.join();
+
+	checker.Check(pool.GetPooledLargePageBytes() <= 32 * 1024 * 1024, "pooled large pages exceed the budget");
+
+	const size_t pagesCreated = pool.GetNumPagesCreated();
+	const size_t largeCreated = pool.GetNumLargePagesCreated();
+	const size_t largeReused = pool.GetNumLargePagesReused();
+
+	pool.Destroy();
+	checker.Check(factory.GetNumLive() == 0, "Destroy() did not release every page");
+
+	printf("%u threads:  %8.1f ns per context  %zu pages  %zu large pages created, %zu reused  %u errors\n",
+		numThreads, seconds * 1e9 / ((double)numOps * numThreads), pagesCreated, largeCreated, largeReused,
+		checker.errors.load() + factory.errors.load());
+
+	return checker.errors + factory.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-threads <n>\n\tWorker threads for the stress run.  Defaults to 4.\n"
+		"-ops <n>\n\tCommand contexts each worker closes.  Defaults to 200000.\n"
+		"\n\nExample:  %s -threads 8\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numThreads = 4;
+	uint32_t numOps = 200000;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-threads", argv[arg]) == 0)
+				numThreads = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-ops", argv[arg]) == 0)
+				numOps = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numThreads == 0 || numOps == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Linear page pool benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = CheckPolicy();
+	errors += Stress(1, numOps);
+	errors += Stress(numThreads, numOps);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
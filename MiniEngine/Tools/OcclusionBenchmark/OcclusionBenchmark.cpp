@@ -0,0 +1,569 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures MaskedOcclusionBuffer without a GPU or window, so that it runs anywhere, including Linux.  The scene
+// is either the depth-only streams of an H3D model, with each mesh as an occluder and its bounding box as an
+// occludee, or a generated city of buildings with small objects scattered between them.  The camera circles the
+// middle of the scene, as the ModelViewer benchmark does.
+//
+// With -validate, every view is also rasterized by a slow reference rasterizer, and any box reported occluded
+// that the reference can see is counted as an error.  The benchmark exits with 1 if there are any.
+//
+
+#include "MaskedOcclusion.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace Math;
+
+struct Scene
+{
+	vector<float> positions;		// xyz
+	vector<uint16_t> indices;
+	vector<OccluderMesh> occluders;
+	vector<uint32_t> firstIndex;	// Of each occluder, to fix up the pointers once the arrays stop growing
+	vector<uint32_t> firstVertex;
+
+	vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	float center[3];
+	float radius;
+
+	BoxArrays GetBoxes( void ) const
+	{
+		BoxArrays boxes = { minX.data(), minY.data(), minZ.data(), maxX.data(), maxY.data(), maxZ.data() };
+		return boxes;
+	}
+
+	void AddBox( const float* lo, const float* hi )
+	{
+		minX.push_back(lo[0]); minY.push_back(lo[1]); minZ.push_back(lo[2]);
+		maxX.push_back(hi[0]); maxY.push_back(hi[1]); maxZ.push_back(hi[2]);
+	}
+
+	void BeginOccluder( void )
+	{
+		firstIndex.push_back((uint32_t)indices.size());
+		firstVertex.push_back((uint32_t)(positions.size() / 3));
+	}
+
+	void FinishOccluders( void )
+	{
+		occluders.resize(firstIndex.size());
+		for (size_t i = 0; i < occluders.size(); ++i)
+		{
+			const uint32_t endIndex = i + 1 < firstIndex.size() ? firstIndex[i + 1] : (uint32_t)indices.size();
+			const uint32_t endVertex = i + 1 < firstVertex.size() ? firstVertex[i + 1] : (uint32_t)(positions.size() / 3);
+			occluders[i].Positions = positions.data() + firstVertex[i] * 3;
+			occluders[i].VertexStride = 3 * sizeof(float);
+			occluders[i].VertexCount = endVertex - firstVertex[i];
+			occluders[i].Indices = indices.data() + firstIndex[i];
+			occluders[i].IndexCount = endIndex - firstIndex[i];
+		}
+	}
+};
+
+// The parts of Model's H3D layout needed here, as written by the 64-bit engine
+struct H3DHeader
+{
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t vertexDataByteSize;
+	uint32_t indexDataByteSize;
+	uint32_t vertexDataByteSizeDepth;
+	uint32_t pad[3];
+	float boundsMin[4];
+	float boundsMax[4];
+};
+
+struct H3DMesh
+{
+	float boundsMin[4];
+	float boundsMax[4];
+	uint32_t materialIndex;
+	uint32_t attribsEnabled;
+	uint32_t attribsEnabledDepth;
+	uint32_t vertexStride;
+	uint32_t vertexStrideDepth;
+	uint16_t attrib[16][4];
+	uint16_t attribDepth[16][4];
+	uint32_t vertexDataByteOffset;
+	uint32_t vertexCount;
+	uint32_t indexDataByteOffset;
+	uint32_t indexCount;
+	uint32_t vertexDataByteOffsetDepth;
+	uint32_t vertexCountDepth;
+	uint32_t pad;
+};
+
+static_assert(sizeof(H3DHeader) == 64, "H3D header layout");
+static_assert(sizeof(H3DMesh) == 336, "H3D mesh layout");
+const size_t kH3DMaterialSize = 992;
+
+bool LoadH3D( const string& fileName, Scene& scene )
+{
+	ifstream file(fileName, ios::in | ios::binary);
+	if (!file)
+		return false;
+
+	H3DHeader header;
+	if (!file.read((char*)&header, sizeof(header)) || header.meshCount == 0)
+		return false;
+
+	vector<H3DMesh> meshes(header.meshCount);
+	vector<char> skipped(header.materialCount * kH3DMaterialSize + header.vertexDataByteSize + header.indexDataByteSize);
+	vector<uint8_t> vertexData(header.vertexDataByteSizeDepth);
+	vector<uint16_t> indexData(header.indexDataByteSize / sizeof(uint16_t));
+
+	if (!file.read((char*)meshes.data(), meshes.size() * sizeof(H3DMesh)) ||
+		!file.read(skipped.data(), skipped.size()) ||
+		!file.read((char*)vertexData.data(), vertexData.size()) ||
+		!file.read((char*)indexData.data(), indexData.size() * sizeof(uint16_t)))
+	{
+		return false;
+	}
+
+	for (const H3DMesh& mesh : meshes)
+	{
+		scene.BeginOccluder();
+		for (uint32_t v = 0; v < mesh.vertexCountDepth; ++v)
+		{
+			const float* p = (const float*)(vertexData.data() + mesh.vertexDataByteOffsetDepth + v * mesh.vertexStrideDepth);
+			scene.positions.insert(scene.positions.end(), p, p + 3);
+		}
+
+		const uint16_t* meshIndices = indexData.data() + mesh.indexDataByteOffset / sizeof(uint16_t);
+		scene.indices.insert(scene.indices.end(), meshIndices, meshIndices + mesh.indexCount);
+		scene.AddBox(mesh.boundsMin, mesh.boundsMax);
+	}
+
+	for (int i = 0; i < 3; ++i)
+		scene.center[i] = (header.boundsMin[i] + header.boundsMax[i]) * 0.5f;
+	scene.radius = (header.boundsMax[0] - header.boundsMin[0]) * 0.25f;
+
+	scene.FinishOccluders();
+	return true;
+}
+
+// Adds a box to the occluders, twelve triangles
+void AddOccluderBox( Scene& scene, const float* lo, const float* hi )
+{
+	scene.BeginOccluder();
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		scene.positions.push_back(corner & 1 ? hi[0] : lo[0]);
+		scene.positions.push_back(corner & 2 ? hi[1] : lo[1]);
+		scene.positions.push_back(corner & 4 ? hi[2] : lo[2]);
+	}
+
+	static const uint16_t kBoxIndices[36] =
+	{
+		0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,	0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7,	0, 4, 2, 2, 4, 6,	1, 3, 5, 3, 7, 5
+	};
+	scene.indices.insert(scene.indices.end(), kBoxIndices, kBoxIndices + 36);
+}
+
+// Blocks of buildings on a grid, with a ground plane, and objects scattered in the streets and on the roofs
+void GenerateCity( uint32_t numObjects, Scene& scene )
+{
+	mt19937 rng(1234);
+	uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const int kBlocks = 24;
+	const float kBlockSize = 100.0f;
+	const float kStreetWidth = 30.0f;
+	const float kPitch = kBlockSize + kStreetWidth;
+	const float halfExtent = kBlocks * kPitch * 0.5f;
+
+	const float groundLo[3] = { -halfExtent, -1.0f, -halfExtent };
+	const float groundHi[3] = { halfExtent, 0.0f, halfExtent };
+	AddOccluderBox(scene, groundLo, groundHi);
+
+	for (int bz = 0; bz < kBlocks; ++bz)
+	{
+		for (int bx = 0; bx < kBlocks; ++bx)
+		{
+			const float x = -halfExtent + bx * kPitch + kStreetWidth * 0.5f;
+			const float z = -halfExtent + bz * kPitch + kStreetWidth * 0.5f;
+			const float height = 20.0f + unit(rng) * 120.0f;
+			const float lo[3] = { x, 0.0f, z };
+			const float hi[3] = { x + kBlockSize, height, z + kBlockSize };
+			AddOccluderBox(scene, lo, hi);
+		}
+	}
+
+	uniform_real_distribution<float> position(-halfExtent, halfExtent);
+	for (uint32_t i = 0; i < numObjects; ++i)
+	{
+		const float size = 0.5f + unit(rng) * 4.0f;
+		const float x = position(rng), z = position(rng);
+		const float y = unit(rng) < 0.9f ? 0.0f : unit(rng) * 150.0f;
+		const float lo[3] = { x - size, y, z - size };
+		const float hi[3] = { x + size, y + size * 2.0f, z + size };
+		scene.AddBox(lo, hi);
+	}
+
+	scene.center[0] = scene.center[1] = scene.center[2] = 0.0f;
+	scene.center[1] = 10.0f;
+	scene.radius = halfExtent * 0.5f;
+	scene.FinishOccluders();
+}
+
+// A perspective view from eye toward target, laid out as Math::Matrix4 is in memory.  Only x, y and w matter.
+void MakeViewProjMatrix( const float* eye, const float* target, float fovY, float aspect, float* m )
+{
+	float forward[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	float length = sqrtf(forward[0] * forward[0] + forward[1] * forward[1] + forward[2] * forward[2]);
+	for (float& f : forward)
+		f /= length;
+
+	// Right = forward x up, with y up
+	float right[3] = { -forward[2], 0.0f, forward[0] };
+	length = sqrtf(right[0] * right[0] + right[2] * right[2]);
+	right[0] /= length;
+	right[2] /= length;
+
+	const float up[3] =
+	{
+		right[1] * forward[2] - right[2] * forward[1],
+		right[2] * forward[0] - right[0] * forward[2],
+		right[0] * forward[1] - right[1] * forward[0]
+	};
+
+	const float scaleY = 1.0f / tanf(fovY * 0.5f);
+	const float scaleX = scaleY / aspect;
+
+	memset(m, 0, 16 * sizeof(float));
+	for (int i = 0; i < 3; ++i)
+	{
+		m[i * 4 + 0] = right[i] * scaleX;
+		m[i * 4 + 1] = up[i] * scaleY;
+		m[i * 4 + 3] = forward[i];
+	}
+	m[12] = -(eye[0] * right[0] + eye[1] * right[1] + eye[2] * right[2]) * scaleX;
+	m[13] = -(eye[0] * up[0] + eye[1] * up[1] + eye[2] * up[2]) * scaleY;
+	m[14] = 1.0f;
+	m[15] = -(eye[0] * forward[0] + eye[1] * forward[1] + eye[2] * forward[2]);
+}
+
+// Frustum planes for the culling that happens first, from the same matrix
+CullingPlanes MakeFrustumPlanes( const float* m )
+{
+	CullingPlanes planes;
+	for (int sign = -1; sign <= 1; sign += 2)
+	{
+		for (int axis = 0; axis < 2; ++axis)
+		{
+			// w + x, w - x, w + y, w - y
+			float p[4];
+			for (int row = 0; row < 4; ++row)
+				p[row] = m[row * 4 + 3] - sign * m[row * 4 + axis];
+			planes.AddPlane(p[0], p[1], p[2], p[3]);
+		}
+	}
+	planes.AddPlane(m[3], m[7], m[11], m[15] - 0.1f);
+	return planes;
+}
+
+// Brute force depth buffer, one pixel center at a time, with the same clipping as MaskedOcclusionBuffer
+class ReferenceRasterizer
+{
+public:
+	ReferenceRasterizer( uint32_t width, uint32_t height ) : m_Width(width), m_Height(height), m_Depth(width * height, 0.0f) {}
+
+	void Render( const float* m, const Scene& scene )
+	{
+		fill(m_Depth.begin(), m_Depth.end(), 0.0f);
+		for (const OccluderMesh& mesh : scene.occluders)
+		{
+			for (uint32_t i = 0; i + 2 < mesh.IndexCount; i += 3)
+			{
+				double clip[3][3];
+				for (int k = 0; k < 3; ++k)
+				{
+					const float* p = mesh.Positions + mesh.Indices[i + k] * 3;
+					for (int c = 0; c < 3; ++c)
+					{
+						const int col = c == 2 ? 3 : c;
+						clip[k][c] = (double)p[0] * m[col] + (double)p[1] * m[4 + col] + (double)p[2] * m[8 + col] + m[12 + col];
+					}
+				}
+				RenderClipped(clip);
+			}
+		}
+	}
+
+	// Whether any pixel of the box's screen rectangle is farther than its nearest point
+	bool IsBoxVisible( const float* m, const float* lo, const float* hi ) const
+	{
+		double minX = 1e30, maxX = -1e30, minY = 1e30, maxY = -1e30, nearest = 0.0;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const double p[3] = { corner & 1 ? hi[0] : lo[0], corner & 2 ? hi[1] : lo[1], corner & 4 ? hi[2] : lo[2] };
+			double c[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				const int col = k == 2 ? 3 : k;
+				c[k] = p[0] * m[col] + p[1] * m[4 + col] + p[2] * m[8 + col] + m[12 + col];
+			}
+			if (c[2] < 1e-3)
+				return true;
+			const double x = (c[0] / c[2] * 0.5 + 0.5) * m_Width;
+			const double y = (0.5 - c[1] / c[2] * 0.5) * m_Height;
+			minX = min(minX, x); maxX = max(maxX, x);
+			minY = min(minY, y); maxY = max(maxY, y);
+			nearest = max(nearest, 1.0 / c[2]);
+		}
+
+		if (maxX < 0.0 || maxY < 0.0 || minX >= m_Width || minY >= m_Height)
+			return true;
+
+		for (int y = (int)max(minY, 0.0); y <= (int)min(maxY, m_Height - 1.0); ++y)
+		{
+			for (int x = (int)max(minX, 0.0); x <= (int)min(maxX, m_Width - 1.0); ++x)
+			{
+				if (m_Depth[y * m_Width + x] <= nearest)
+					return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	void RenderClipped( double clip[3][3] )
+	{
+		double poly[4][3];
+		int count = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			const double* cur = clip[i];
+			const double* next = clip[(i + 1) % 3];
+			if (cur[2] >= 1e-3)
+				memcpy(poly[count++], cur, sizeof(poly[0]));
+			if ((cur[2] >= 1e-3) != (next[2] >= 1e-3))
+			{
+				const double t = (1e-3 - cur[2]) / (next[2] - cur[2]);
+				for (int c = 0; c < 3; ++c)
+					poly[count][c] = cur[c] + (next[c] - cur[c]) * t;
+				poly[count++][2] = 1e-3;
+			}
+		}
+
+		double screen[4][3];
+		for (int i = 0; i < count; ++i)
+		{
+			screen[i][0] = (poly[i][0] / poly[i][2] * 0.5 + 0.5) * m_Width;
+			screen[i][1] = (0.5 - poly[i][1] / poly[i][2] * 0.5) * m_Height;
+			screen[i][2] = 1.0 / poly[i][2];
+		}
+
+		for (int i = 2; i < count; ++i)
+			RenderTriangle(screen[0], screen[i - 1], screen[i]);
+	}
+
+	void RenderTriangle( const double* a, const double* b, const double* c )
+	{
+		const double area = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+		if (fabs(area) < 1e-12)
+			return;
+
+		const int x0 = max((int)floor(min(min(a[0], b[0]), c[0])), 0);
+		const int x1 = min((int)ceil(max(max(a[0], b[0]), c[0])), (int)m_Width - 1);
+		const int y0 = max((int)floor(min(min(a[1], b[1]), c[1])), 0);
+		const int y1 = min((int)ceil(max(max(a[1], b[1]), c[1])), (int)m_Height - 1);
+
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				const double px = x + 0.5, py = y + 0.5;
+				const double wa = ((b[0] - px) * (c[1] - py) - (c[0] - px) * (b[1] - py)) / area;
+				const double wb = ((c[0] - px) * (a[1] - py) - (a[0] - px) * (c[1] - py)) / area;
+				const double wc = 1.0 - wa - wb;
+				if (wa < 0.0 || wb < 0.0 || wc < 0.0)
+					continue;
+
+				float& depth = m_Depth[y * m_Width + x];
+				depth = max(depth, (float)(wa * a[2] + wb * b[2] + wc * c[2]));
+			}
+		}
+	}
+
+	uint32_t m_Width;
+	uint32_t m_Height;
+	vector<float> m_Depth;
+};
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [H3D file] [options]*\n\n"
+		"Options:\n\n"
+		"-width <n>, -height <n>\n\tThe occlusion buffer size.  Defaults to 512x256.\n"
+		"-views <n>\n\tCamera positions around the scene.  Defaults to 64.\n"
+		"-objects <n>\n\tObjects to scatter through the generated city, when no H3D file is given.\n\tDefaults to 100000.\n"
+		"-validate\n\tChecks each view against a reference rasterizer, and fails if any visible box was culled.  This is slow.\n"
+		"\n\nExample:  %s sponza.h3d -validate\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	string modelFile;
+	uint32_t width = 512;
+	uint32_t height = 256;
+	uint32_t numViews = 64;
+	uint32_t numObjects = 100000;
+	bool validate = false;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (argv[arg][0] != '-')
+				modelFile = argv[arg];
+			else if (strcmp("-validate", argv[arg]) == 0)
+				validate = true;
+			else if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-width", argv[arg]) == 0)
+				width = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-height", argv[arg]) == 0)
+				height = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-views", argv[arg]) == 0)
+				numViews = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-objects", argv[arg]) == 0)
+				numObjects = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (width == 0 || width % MaskedOcclusionBuffer::kTileWidth != 0 ||
+			height == 0 || height % MaskedOcclusionBuffer::kTileHeight != 0)
+		{
+			throw runtime_error("The width must be a multiple of 32 and the height of 4");
+		}
+
+		if (numViews == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Occlusion benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	Scene scene;
+	if (!modelFile.empty())
+	{
+		if (!LoadH3D(modelFile, scene))
+		{
+			printf("Unable to read %s\n", modelFile.c_str());
+			return 1;
+		}
+		printf("%s:  ", modelFile.c_str());
+	}
+	else
+	{
+		GenerateCity(numObjects, scene);
+		printf("Generated city:  ");
+	}
+
+	const uint32_t numBoxes = (uint32_t)scene.minX.size();
+	printf("%u occluders, %u triangles, %u boxes, %ux%u buffer\n\n", (uint32_t)scene.occluders.size(),
+		(uint32_t)scene.indices.size() / 3, numBoxes, width, height);
+
+	MaskedOcclusionBuffer buffer;
+	buffer.Create(width, height);
+	ReferenceRasterizer reference(width, height);
+
+	const BoxArrays boxes = scene.GetBoxes();
+	vector<uint32_t> mask(GetCullMaskSize(numBoxes));
+
+	double renderSeconds = 0.0, testSeconds = 0.0;
+	uint64_t totalInFrustum = 0, totalVisible = 0, totalTriangles = 0, errors = 0;
+
+	for (uint32_t view = 0; view < numViews; ++view)
+	{
+		const float angle = 6.2831853f * view / numViews;
+		const float eye[3] = { scene.center[0] + cosf(angle) * scene.radius, scene.center[1], scene.center[2] + sinf(angle) * scene.radius };
+		float viewProj[16];
+		MakeViewProjMatrix(eye, scene.center, 1.0f, (float)width / height, viewProj);
+
+		const uint32_t inFrustum = ParallelCullBoxes(MakeFrustumPlanes(viewProj), boxes, numBoxes, mask.data());
+
+		auto start = chrono::high_resolution_clock::now();
+		buffer.SetViewProjMatrix(viewProj);
+		buffer.Clear();
+		buffer.RenderOccluders(scene.occluders.data(), (uint32_t)scene.occluders.size());
+		auto rendered = chrono::high_resolution_clock::now();
+		const uint32_t visible = buffer.TestBoxes(boxes, numBoxes, mask.data());
+		auto tested = chrono::high_resolution_clock::now();
+
+		renderSeconds += chrono::duration<double>(rendered - start).count();
+		testSeconds += chrono::duration<double>(tested - rendered).count();
+		totalInFrustum += inFrustum;
+		totalVisible += visible;
+		totalTriangles += buffer.GetNumTrianglesRasterized();
+
+		if (validate)
+		{
+			// The reference only checks that culling was conservative, so only occluded boxes are looked at
+			reference.Render(viewProj, scene);
+			vector<uint32_t> frustumMask(mask.size());
+			ParallelCullBoxes(MakeFrustumPlanes(viewProj), boxes, numBoxes, frustumMask.data());
+			for (uint32_t i = 0; i < numBoxes; ++i)
+			{
+				if (IsVisible(frustumMask.data(), i) && !IsVisible(mask.data(), i))
+				{
+					const float lo[3] = { scene.minX[i], scene.minY[i], scene.minZ[i] };
+					const float hi[3] = { scene.maxX[i], scene.maxY[i], scene.maxZ[i] };
+					if (reference.IsBoxVisible(viewProj, lo, hi))
+						++errors;
+				}
+			}
+		}
+	}
+
+	const double occludedPercent = totalInFrustum == 0 ? 0.0 : 100.0 * (totalInFrustum - totalVisible) / totalInFrustum;
+	printf("Triangles rasterized:  %8.0f per view\n", (double)totalTriangles / numViews);
+	printf("Render occluders:      %8.3f ms per view\n", renderSeconds * 1000.0 / numViews);
+	printf("Test boxes:            %8.3f ms per view (%.1fM boxes/s)\n", testSeconds * 1000.0 / numViews,
+		testSeconds > 0.0 ? totalInFrustum / testSeconds * 1e-6 : 0.0);
+	printf("Boxes in frustum:      %8.0f per view, %.1f%% of them occluded\n", (double)totalInFrustum / numViews, occludedPercent);
+
+	if (validate)
+		printf("Validation:            %8llu boxes culled that the reference can see\n", (unsigned long long)errors);
+
+	printf("\n");
+	return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,352 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Checks the pipeline cache file format without a device, using random bytes for the driver blobs.
+//
+// Round trips:  blobs stored in one cache, serialized and attached to another, come back byte for byte, as do
+// blobs saved to disk and opened again.  Blobs stored this session replace those from the file.  Corruption:  a
+// different compatibility tag, version or magic, a truncated image, or a damaged index rejects the whole file,
+// a damaged blob loses only that blob, and random damage anywhere never hands out a blob that differs from
+// what was stored.  Prewarm() must reach the same verdicts as verifying lazily.
+//
+// Also times verifying and finding every blob in a file, which is what a load pays for.
+//
+
+#include "PipelineCacheFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+static const uint64_t kTag = 0x0123456789ABCDEFull;
+
+typedef map<uint64_t, vector<uint8_t>> BlobSet;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+BlobSet MakeBlobs( uint32_t count, size_t maxSize, uint32_t seed )
+{
+	mt19937_64 rng(seed);
+	BlobSet blobs;
+	while (blobs.size() < count)
+	{
+		vector<uint8_t>& blob = blobs[rng()];
+		blob.resize(rng() % (maxSize + 1));
+		for (uint8_t& byte : blob)
+			byte = (uint8_t)rng();
+	}
+	return blobs;
+}
+
+vector<uint8_t> SerializeBlobs( const BlobSet& blobs, uint64_t tag = kTag )
+{
+	// Attaching nothing leaves an empty cache that writes the tag
+	PipelineCacheFile cache;
+	cache.Attach(nullptr, 0, tag);
+	for (auto& blob : blobs)
+		cache.Store(blob.first, blob.second.data(), blob.second.size());
+
+	vector<uint8_t> image;
+	cache.Serialize(image);
+	return image;
+}
+
+// Returns how many blobs were found.  Any blob found must match what was stored.
+size_t CheckContents( Checker& checker, PipelineCacheFile& cache, const BlobSet& blobs )
+{
+	size_t numFound = 0;
+	for (auto& blob : blobs)
+	{
+		const void* data;
+		size_t size;
+		if (!cache.Find(blob.first, data, size))
+			continue;
+
+		++numFound;
+		checker.Check(size == blob.second.size() && (size == 0 || memcmp(data, blob.second.data(), size) == 0),
+			"a blob came back different from what was stored");
+	}
+	return numFound;
+}
+
+void CheckRoundTrip( Checker& checker, const BlobSet& blobs )
+{
+	const vector<uint8_t> image = SerializeBlobs(blobs);
+
+	PipelineCacheFile cache;
+	checker.Check(cache.Attach(image.data(), image.size(), kTag), "a serialized image was rejected");
+	checker.Check(cache.GetNumEntries() == blobs.size(), "the image lost entries");
+	checker.Check(CheckContents(checker, cache, blobs) == blobs.size(), "blobs were missing after a round trip");
+	checker.Check(cache.GetNumCorrupt() == 0, "an intact blob was counted as corrupt");
+
+	// Blobs from the file carry over to the next image, and ones stored this session replace them
+	BlobSet updated = blobs;
+	BlobSet added = MakeBlobs(8, 4096, 99);
+	for (auto& blob : added)
+	{
+		updated[blob.first] = blob.second;
+		cache.Store(blob.first, blob.second.data(), blob.second.size());
+	}
+
+	auto replaced = updated.begin();
+	replaced->second.assign(100, 0xAB);
+	cache.Store(replaced->first, replaced->second.data(), replaced->second.size());
+
+	vector<uint8_t> nextImage;
+	cache.Serialize(nextImage);
+
+	PipelineCacheFile nextCache;
+	checker.Check(nextCache.Attach(nextImage.data(), nextImage.size(), kTag), "a reserialized image was rejected");
+	checker.Check(nextCache.GetNumEntries() == updated.size(), "reserializing lost or duplicated entries");
+	checker.Check(CheckContents(checker, nextCache, updated) == updated.size(), "stored blobs did not replace or join the file's");
+}
+
+void CheckSaveAndOpen( Checker& checker, const BlobSet& blobs )
+{
+	const wstring fileName = L"PipelineCacheFileBenchmark.bin";
+	_wremove(fileName.c_str());
+
+	{
+		PipelineCacheFile cache;
+		checker.Check(!cache.Open(fileName, kTag), "a missing file was opened");
+		for (auto& blob : blobs)
+			cache.Store(blob.first, blob.second.data(), blob.second.size());
+		checker.Check(cache.Save(), "the file could not be saved");
+	}
+
+	{
+		PipelineCacheFile cache;
+		checker.Check(cache.Open(fileName, kTag), "a saved file could not be opened");
+		cache.Prewarm();
+		checker.Check(CheckContents(checker, cache, blobs) == blobs.size(), "blobs were missing after saving and opening");
+
+		// Nothing changed, but saving must still leave a readable file behind
+		checker.Check(cache.Save(), "an unchanged file could not be saved");
+	}
+
+	{
+		PipelineCacheFile cache;
+		checker.Check(!cache.Open(fileName, kTag + 1), "a file from another driver was opened");
+		checker.Check(cache.Open(fileName, kTag), "a file saved twice could not be opened");
+		checker.Check(CheckContents(checker, cache, blobs) == blobs.size(), "blobs were missing after saving twice");
+	}
+
+	_wremove(fileName.c_str());
+}
+
+void CheckRejection( Checker& checker, const BlobSet& blobs )
+{
+	const vector<uint8_t> image = SerializeBlobs(blobs);
+	PipelineCacheFile cache;
+
+	checker.Check(!cache.Attach(image.data(), image.size(), kTag + 1), "an image with another tag was accepted");
+	checker.Check(cache.GetNumEntries() == 0, "a rejected image left entries behind");
+
+	// Magic and version lead the header
+	for (size_t field = 0; field < 2; ++field)
+	{
+		vector<uint8_t> damaged = image;
+		damaged[field * 4] ^= 1;
+		checker.Check(!cache.Attach(damaged.data(), damaged.size(), kTag), "an image with a bad magic or version was accepted");
+	}
+
+	// The index follows the 40 byte header
+	vector<uint8_t> damagedIndex = image;
+	damagedIndex[40 + 3] ^= 1;
+	checker.Check(!cache.Attach(damagedIndex.data(), damagedIndex.size(), kTag), "an image with a damaged index was accepted");
+
+	// Cutting the image short anywhere must be caught without reading past the end.  The copy makes the
+	// end exact for memory checkers.
+	for (size_t size = 0; size < image.size(); size += 1 + size / 8)
+	{
+		vector<uint8_t> truncated(image.begin(), image.begin() + size);
+		if (cache.Attach(truncated.data(), truncated.size(), kTag))
+			checker.Check(false, "a truncated image was accepted");
+	}
+}
+
+void CheckDamagedBlob( Checker& checker, const BlobSet& blobs )
+{
+	vector<uint8_t> image = SerializeBlobs(blobs);
+
+	// Blobs are random, so the largest one can be found in the image by its contents
+	auto largest = blobs.begin();
+	for (auto iter = blobs.begin(); iter != blobs.end(); ++iter)
+	{
+		if (iter->second.size() > largest->second.size())
+			largest = iter;
+	}
+	auto found = search(image.begin(), image.end(), largest->second.begin(), largest->second.end());
+	checker.Check(found != image.end(), "a blob was not stored verbatim");
+	if (found == image.end())
+		return;
+	found[largest->second.size() / 2] ^= 0x80;
+
+	for (uint32_t prewarm = 0; prewarm < 2; ++prewarm)
+	{
+		PipelineCacheFile cache;
+		checker.Check(cache.Attach(image.data(), image.size(), kTag), "damage to one blob rejected the whole file");
+		if (prewarm)
+			cache.Prewarm();
+
+		checker.Check(CheckContents(checker, cache, blobs) == blobs.size() - 1, "a damaged blob was not dropped, or others were");
+		checker.Check(cache.GetNumCorrupt() == 1, "a damaged blob was not counted once");
+
+		// Saving drops the damaged blob
+		vector<uint8_t> repaired;
+		cache.Serialize(repaired);
+		PipelineCacheFile repairedCache;
+		checker.Check(repairedCache.Attach(repaired.data(), repaired.size(), kTag), "a repaired image was rejected");
+		checker.Check(repairedCache.GetNumEntries() == blobs.size() - 1, "the damaged blob survived reserializing");
+	}
+}
+
+// Damages random bytes anywhere in the image.  Whatever survives must be exactly what was stored.
+void FuzzDamage( Checker& checker, const BlobSet& blobs, uint32_t numTrials )
+{
+	const vector<uint8_t> image = SerializeBlobs(blobs);
+	mt19937 rng(4321);
+
+	for (uint32_t trial = 0; trial < numTrials; ++trial)
+	{
+		vector<uint8_t> damaged = image;
+		const uint32_t numFlips = 1 + rng() % 4;
+		for (uint32_t i = 0; i < numFlips; ++i)
+			damaged[rng() % damaged.size()] ^= (uint8_t)(1 + rng() % 255);
+
+		PipelineCacheFile cache;
+		if (cache.Attach(damaged.data(), damaged.size(), kTag))
+		{
+			if (trial & 1)
+				cache.Prewarm();
+			CheckContents(checker, cache, blobs);
+		}
+	}
+}
+
+void TimeVerify( const BlobSet& blobs, uint32_t numRuns )
+{
+	const vector<uint8_t> image = SerializeBlobs(blobs);
+
+	double lazySeconds = 0.0, prewarmSeconds = 0.0;
+	for (uint32_t run = 0; run < numRuns; ++run)
+	{
+		for (uint32_t prewarm = 0; prewarm < 2; ++prewarm)
+		{
+			auto start = chrono::high_resolution_clock::now();
+
+			PipelineCacheFile cache;
+			cache.Attach(image.data(), image.size(), kTag);
+			if (prewarm)
+				cache.Prewarm();
+
+			for (auto& blob : blobs)
+			{
+				const void* data;
+				size_t size;
+				cache.Find(blob.first, data, size);
+			}
+			cache.Close();
+
+			const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+			(prewarm ? prewarmSeconds : lazySeconds) += seconds;
+		}
+	}
+
+	const double megabytes = image.size() * (double)numRuns / (1024.0 * 1024.0);
+	printf("Find every blob in a %.1f MB file:  %8.1f MB/s verifying lazily  %8.1f MB/s after Prewarm()\n",
+		image.size() / (1024.0 * 1024.0), megabytes / lazySeconds, megabytes / prewarmSeconds);
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-blobs <n>\n\tPipelines in the file.  Defaults to 500.\n"
+		"-fuzz <n>\n\tTrials of random damage.  Defaults to 2000.\n"
+		"\n\nExample:  %s -blobs 2000 -fuzz 10000\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numBlobs = 500;
+	uint32_t numTrials = 2000;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-blobs", argv[arg]) == 0)
+				numBlobs = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-fuzz", argv[arg]) == 0)
+				numTrials = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numBlobs < 2)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Pipeline cache file benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	// Driver blobs run from a few hundred bytes to tens of kilobytes.  Some are empty.
+	const BlobSet blobs = MakeBlobs(numBlobs, 64 * 1024, 1);
+	const BlobSet smallBlobs = MakeBlobs(16, 512, 2);
+
+	Checker checker;
+	CheckRoundTrip(checker, blobs);
+	CheckSaveAndOpen(checker, blobs);
+	CheckRejection(checker, smallBlobs);
+	CheckDamagedBlob(checker, blobs);
+	FuzzDamage(checker, smallBlobs, numTrials);
+
+	TimeVerify(blobs, 10);
+
+	printf("\n%u errors\n\n", checker.errors);
+	return checker.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,322 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Exercises PipelineStateCache with a fake compiler, so the concurrency of the PSO cache can be checked without a
+// device.  The engine schedules asynchronous compiles as PPL tasks; here a small pool of worker threads stands in.
+//
+// Several threads request overlapping sets of keys at once, some synchronously and some on the workers.  Every key
+// must be compiled exactly once and every request must get that key's result.  Keys forced onto one hash must stay
+// distinct, a compiler that throws must surface through the future, and without a scheduler asynchronous requests
+// run on the caller.  The time to look up a key that is already compiled is reported.
+//
+
+#include "PipelineStateCache.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+typedef PipelineStateCache<uint64_t> Cache;
+
+// Stands in for the PPL scheduler:  a fixed set of threads draining a queue
+class WorkerPool
+{
+public:
+	WorkerPool( uint32_t numThreads ) : m_Stop(false)
+	{
+		for (uint32_t i = 0; i < numThreads; ++i)
+			m_Threads.emplace_back([this] { Run(); });
+	}
+
+	~WorkerPool()
+	{
+		{
+			lock_guard<mutex> lockGuard(m_Mutex);
+			m_Stop = true;
+		}
+		m_Wake.notify_all();
+		for (thread& worker : m_Threads)
+			worker.join();
+	}
+
+	void Schedule( function<void (void)> job )
+	{
+		{
+			lock_guard<mutex> lockGuard(m_Mutex);
+			m_Jobs.push_back(move(job));
+		}
+		m_Wake.notify_one();
+	}
+
+private:
+	void Run( void )
+	{
+		for (;;)
+		{
+			function<void (void)> job;
+			{
+				unique_lock<mutex> lock(m_Mutex);
+				m_Wake.wait(lock, [this] { return m_Stop || !m_Jobs.empty(); });
+				if (m_Jobs.empty())
+					return;
+				job = move(m_Jobs.front());
+				m_Jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	mutex m_Mutex;
+	condition_variable m_Wake;
+	deque<function<void (void)>> m_Jobs;
+	vector<thread> m_Threads;
+	bool m_Stop;
+};
+
+// Stands in for a pipeline description.  Only the bytes matter to the cache.
+struct FakeDesc
+{
+	uint32_t id;
+	uint32_t padding[15];
+};
+
+struct Checker
+{
+	atomic<uint32_t> errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+// The value a key compiles to
+uint64_t Expected( uint32_t id ) { return 0x9E3779B97F4A7C15ull * (id + 1); }
+
+FakeDesc MakeDesc( uint32_t id )
+{
+	FakeDesc desc;
+	memset(&desc, 0, sizeof(desc));
+	desc.id = id;
+	return desc;
+}
+
+// Returns the number of errors found
+uint32_t CheckConcurrentCompiles( uint32_t numThreads, uint32_t numKeys, uint32_t compileMicroseconds, bool collide )
+{
+	Checker checker;
+	WorkerPool workers(4);
+	Cache cache([&workers]( function<void (void)> job ) { workers.Schedule(move(job)); });
+
+	unique_ptr<atomic<uint32_t>[]> compileCounts(new atomic<uint32_t>[numKeys]);
+	for (uint32_t i = 0; i < numKeys; ++i)
+		compileCounts[i] = 0;
+
+	auto request = [&]( uint32_t id, bool runAsync )
+	{
+		const FakeDesc desc = MakeDesc(id);
+		// A constant hash puts every key in one bucket, so only the key bytes tell them apart
+		const size_t hash = collide ? 42 : id * 2654435761u;
+		return cache.FindOrCompile(hash, &desc, sizeof(desc), [&compileCounts, id, compileMicroseconds]
+		{
+			++compileCounts[id];
+			this_thread::sleep_for(chrono::microseconds(compileMicroseconds));
+			return Expected(id);
+		}, runAsync);
+	};
+
+	vector<thread> threads;
+	for (uint32_t t = 0; t < numThreads; ++t)
+	{
+		threads.emplace_back([&, t]
+		{
+			mt19937 rng(t);
+			vector<pair<uint32_t, Cache::FutureType>> futures;
+			for (uint32_t i = 0; i < numKeys; ++i)
+			{
+				// Every thread asks for every key, in its own order, so requests for a key race each other
+				const uint32_t id = (i * 7919 + t * 104729) % numKeys;
+				futures.push_back(make_pair(id, request(id, (rng() & 1) != 0)));
+			}
+
+			for (auto& future : futures)
+				checker.Check(future.second.get() == Expected(future.first), "a request got another key's result");
+		});
+	}
+	for (thread& requester : threads)
+		requester.join();
+
+	for (uint32_t i = 0; i < numKeys; ++i)
+		checker.Check(compileCounts[i] == 1, "a key was compiled more or less than once");
+
+	const Cache::Statistics stats = cache.GetStatistics();
+	checker.Check(stats.Misses == numKeys, "misses do not match the number of keys");
+	checker.Check(stats.Hits == (size_t)numKeys * (numThreads - 1), "hits do not match the repeated requests");
+	checker.Check(!collide || stats.HashCollisions == numKeys - 1, "hash collisions were not counted");
+
+	cache.Clear();
+
+	printf("%u threads, %u keys%s:  %zu hits, %zu misses, %zu collisions, %u errors\n", numThreads, numKeys,
+		collide ? " on one hash" : "", stats.Hits, stats.Misses, stats.HashCollisions, checker.errors.load());
+
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckFailuresAndFallback( void )
+{
+	Checker checker;
+
+	// A compile that throws must reach whoever waits on the result, whether it ran inline or on a worker
+	{
+		WorkerPool workers(2);
+		Cache cache([&workers]( function<void (void)> job ) { workers.Schedule(move(job)); });
+
+		for (uint32_t runAsync = 0; runAsync < 2; ++runAsync)
+		{
+			const FakeDesc desc = MakeDesc(runAsync);
+			Cache::FutureType future = cache.FindOrCompile(runAsync, &desc, sizeof(desc), []() -> uint64_t
+			{
+				throw runtime_error("compile failed");
+			}, runAsync != 0);
+
+			bool threw = false;
+			try
+			{
+				future.get();
+			}
+			catch (runtime_error&)
+			{
+				threw = true;
+			}
+			checker.Check(threw, "a failed compile did not rethrow from the future");
+		}
+
+		cache.Clear();
+	}
+
+	// Without a scheduler there is nowhere to run asynchronously, so the result is ready on return
+	{
+		Cache cache;
+		const FakeDesc desc = MakeDesc(0);
+		Cache::FutureType future = cache.FindOrCompile(0, &desc, sizeof(desc), [] { return Expected(0); }, true);
+		checker.Check(future.wait_for(chrono::seconds(0)) == future_status::ready, "an unscheduled compile did not run inline");
+		checker.Check(future.get() == Expected(0), "an unscheduled compile gave the wrong result");
+	}
+
+	printf("Failures and fallback:  %u errors\n", checker.errors.load());
+
+	return checker.errors;
+}
+
+void TimeLookups( uint32_t numKeys, uint32_t numLookups )
+{
+	Cache cache;
+	vector<FakeDesc> descs;
+	for (uint32_t i = 0; i < numKeys; ++i)
+	{
+		descs.push_back(MakeDesc(i));
+		cache.FindOrCompile(i * 2654435761u, &descs[i], sizeof(FakeDesc), [i] { return Expected(i); });
+	}
+
+	mt19937 rng(1234);
+	vector<uint32_t> ids(numLookups);
+	for (uint32_t i = 0; i < numLookups; ++i)
+		ids[i] = rng() % numKeys;
+
+	uint64_t sum = 0;
+	auto start = chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < numLookups; ++i)
+	{
+		const uint32_t id = ids[i];
+		sum += cache.FindOrCompile(id * 2654435761u, &descs[id], sizeof(FakeDesc), [] { return 0ull; }).get();
+	}
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	printf("Lookup of a compiled key, %u keys:  %.1f ns  (checksum %llx)\n", numKeys, seconds * 1e9 / numLookups,
+		(unsigned long long)sum);
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-threads <n>\n\tThreads requesting pipelines at once.  Defaults to 8.\n"
+		"-keys <n>\n\tDistinct pipelines requested by every thread.  Defaults to 500.\n"
+		"-compile <n>\n\tMicroseconds each fake compile takes.  Defaults to 50.\n"
+		"\n\nExample:  %s -threads 16 -keys 2000\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numThreads = 8;
+	uint32_t numKeys = 500;
+	uint32_t compileMicroseconds = 50;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-threads", argv[arg]) == 0)
+				numThreads = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-keys", argv[arg]) == 0)
+				numKeys = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-compile", argv[arg]) == 0)
+				compileMicroseconds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numThreads == 0 || numKeys == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Pipeline state cache benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = CheckConcurrentCompiles(numThreads, numKeys, compileMicroseconds, false);
+	errors += CheckConcurrentCompiles(numThreads, min(numKeys, 64u), compileMicroseconds, true);
+	errors += CheckFailuresAndFallback();
+	TimeLookups(numKeys, 1000000);
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
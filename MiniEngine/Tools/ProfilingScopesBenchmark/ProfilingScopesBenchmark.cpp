@@ -0,0 +1,546 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures what a profiling scope costs and checks what ProfilingScopes records.  GpuTimeManager, the PIX
+// events of CommandContext and SystemTime are stubbed here, so scopes "timed on a command context" only show
+// the cost of the bookkeeping around the time stamps, not of writing them.  The stubs check that every timer
+// started is stopped, in order and on the same thread, and that no scope is timed once the timers run out.
+//
+// The checks cover the samples drained from one thread (their nesting, times and timers), what happens when the
+// GPU timers run out, a stack deeper than ProfilingScopes keeps and a full ring buffer, and several threads
+// recording while another drains.  Then the cost per scope is timed, with and without a command context, and
+// from several threads at once.
+//
+
+#include "pch.h"
+#include "ProfilingScopes.h"
+#include "GpuTimeManager.h"
+#include "CommandContext.h"
+#include "SystemTime.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Checker
+{
+	atomic<uint32_t> errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+// Errors the stubs find, counted by whichever check is running
+Checker g_StubChecker;
+
+uint32_t TakeStubErrors( void )
+{
+	return g_StubChecker.errors.exchange(0);
+}
+
+//
+// Stubs
+//
+
+double SystemTime::sm_CpuTickDelta = 1e-9;
+
+void SystemTime::Initialize( void )
+{
+}
+
+int64_t SystemTime::GetCurrentTick( void )
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Timer zero is the frame's, as in GpuTimeManager
+atomic<uint32_t> g_NumTimers(1);
+uint32_t g_MaxNumTimers = 4096;
+
+// The timers each thread has started and not yet stopped, and how deep its PIX events are
+thread_local vector<uint32_t> t_OpenTimers;
+thread_local uint32_t t_PixDepth = 0;
+
+uint32_t GpuTimeManager::NewTimer( void )
+{
+	uint32_t timerIdx = g_NumTimers.load(memory_order_relaxed);
+	do
+	{
+		if (timerIdx >= g_MaxNumTimers)
+			return 0;
+	}
+	while (!g_NumTimers.compare_exchange_weak(timerIdx, timerIdx + 1, memory_order_relaxed));
+
+	return timerIdx;
+}
+
+void GpuTimeManager::StartTimer( CommandContext&, uint32_t TimerIdx )
+{
+	g_StubChecker.Check(TimerIdx != 0 && TimerIdx < g_MaxNumTimers, "a timer was started outside the query heap");
+	t_OpenTimers.push_back(TimerIdx);
+}
+
+void GpuTimeManager::StopTimer( CommandContext&, uint32_t TimerIdx )
+{
+	g_StubChecker.Check(!t_OpenTimers.empty() && t_OpenTimers.back() == TimerIdx, "a timer was stopped out of order");
+	if (!t_OpenTimers.empty())
+		t_OpenTimers.pop_back();
+}
+
+void CommandContext::PIXBeginEvent( const wchar_t* )
+{
+	++t_PixDepth;
+}
+
+void CommandContext::PIXEndEvent( void )
+{
+	g_StubChecker.Check(t_PixDepth > 0, "a PIX event was ended before it began");
+	--t_PixDepth;
+}
+
+// Never dereferenced:  the stubbed members above ignore the context they are called on
+CommandContext* const g_Context = reinterpret_cast<CommandContext*>(&g_MaxNumTimers);
+
+//
+// Checks
+//
+
+using ProfilingScopes::Sample;
+
+vector<Sample> DrainAll( void )
+{
+	vector<Sample> samples;
+	ProfilingScopes::Drain(samples);
+	return samples;
+}
+
+const Sample* FindSample( const vector<Sample>& samples, const wchar_t* name )
+{
+	for (const Sample& sample : samples)
+	{
+		if (sample.Scope->Name == name)
+			return &sample;
+	}
+	return nullptr;
+}
+
+// Returns the number of errors found
+uint32_t CheckNesting( void )
+{
+	Checker checker;
+	DrainAll();
+
+	for (uint32_t pass = 0; pass < 2; ++pass)
+	{
+		ProfilingScopes::Push(L"Frame");
+		ProfilingScopes::Push(L"Shadows", g_Context);
+		ProfilingScopes::Pop(g_Context);
+		ProfilingScopes::Push(L"Lighting");
+		ProfilingScopes::Pop();
+		ProfilingScopes::Pop();
+	}
+
+	const vector<Sample> samples = DrainAll();
+	checker.Check(samples.size() == 6, "wrong number of samples");
+	if (samples.size() != 6)
+		return checker.errors;
+
+	// Closed innermost first, and the same nodes again on the second pass
+	const Sample& frame = samples[2];
+	const Sample& shadows = samples[0];
+	const Sample& lighting = samples[1];
+	checker.Check(frame.Scope->Name == L"Frame" && shadows.Scope->Name == L"Shadows" && lighting.Scope->Name == L"Lighting",
+		"samples out of order");
+	checker.Check(samples[3].Scope == shadows.Scope && samples[4].Scope == lighting.Scope && samples[5].Scope == frame.Scope,
+		"a scope opened again got a new node");
+
+	checker.Check(frame.Scope->Depth == 1 && shadows.Scope->Depth == 2 && lighting.Scope->Depth == 2, "wrong depths");
+	checker.Check(shadows.Scope->Parent == frame.Scope && lighting.Scope->Parent == frame.Scope, "wrong parents");
+	checker.Check(frame.Scope->Parent != nullptr && frame.Scope->Parent->Parent == nullptr &&
+		frame.Scope->Parent->Name.empty(), "the tree has no root");
+
+	checker.Check(frame.Begin <= shadows.Begin && shadows.Begin <= shadows.End && shadows.End <= lighting.Begin &&
+		lighting.Begin <= lighting.End && lighting.End <= frame.End, "child scopes are not inside their parent");
+	checker.Check(frame.ThreadId == shadows.ThreadId && frame.ThreadId == lighting.ThreadId, "thread ids differ");
+
+	checker.Check(shadows.GpuTimerIdx != 0 && samples[3].GpuTimerIdx == shadows.GpuTimerIdx,
+		"the scope timed on a command context has no GPU timer, or a new one each time");
+	checker.Check(frame.GpuTimerIdx == 0 && lighting.GpuTimerIdx == 0, "a scope opened without a context has a GPU timer");
+
+	// Closed without the context it was opened with, so the time stamp is never written
+	ProfilingScopes::Push(L"Unfinished", g_Context);
+	ProfilingScopes::Pop();
+	t_OpenTimers.clear();
+	t_PixDepth = 0;
+	const vector<Sample> unfinished = DrainAll();
+	checker.Check(unfinished.size() == 1 && unfinished[0].GpuTimerIdx == 0, "a GPU timer that was never stopped was drained");
+
+	checker.Check(t_OpenTimers.empty() && t_PixDepth == 0, "timers or PIX events left open");
+
+	checker.errors += TakeStubErrors();
+	printf("nesting       %u errors\n", checker.errors.load());
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckTimersRunOut( uint32_t numThreads )
+{
+	Checker checker;
+	DrainAll();
+
+	// Leave room for three more
+	const uint32_t savedMax = g_MaxNumTimers;
+	g_MaxNumTimers = g_NumTimers + 3;
+
+	const wchar_t* names[] = { L"Timer 0", L"Timer 1", L"Timer 2", L"Timer 3", L"Timer 4" };
+	for (uint32_t pass = 0; pass < 2; ++pass)
+	{
+		for (const wchar_t* name : names)
+		{
+			ProfilingScopes::Push(name, g_Context);
+			ProfilingScopes::Pop(g_Context);
+		}
+	}
+
+	vector<Sample> samples = DrainAll();
+	checker.Check(samples.size() == 10, "wrong number of samples");
+	uint32_t numTimed = 0;
+	for (const Sample& sample : samples)
+		numTimed += sample.GpuTimerIdx != 0 ? 1 : 0;
+	checker.Check(numTimed == 6, "scopes were timed on the GPU without a timer, or not timed with one");
+	checker.Check(g_NumTimers == g_MaxNumTimers, "more timers were handed out than there are");
+	checker.Check(t_OpenTimers.empty() && t_PixDepth == 0, "timers or PIX events left open");
+
+	// Many threads racing for the last few
+	g_MaxNumTimers = g_NumTimers + 50;
+	const uint32_t firstTimer = g_NumTimers;
+
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([&checker]
+		{
+			for (uint32_t s = 0; s < 100; ++s)
+			{
+				const wstring name = L"Scope " + to_wstring(s);
+				ProfilingScopes::Push(name.c_str(), g_Context);
+				ProfilingScopes::Pop(g_Context);
+			}
+			checker.Check(t_OpenTimers.empty() && t_PixDepth == 0, "timers or PIX events left open");
+		});
+	}
+	for (thread& t : threads)
+		t.join();
+
+	samples = DrainAll();
+	vector<uint32_t> timers;
+	for (const Sample& sample : samples)
+	{
+		if (sample.GpuTimerIdx != 0)
+			timers.push_back(sample.GpuTimerIdx);
+	}
+	sort(timers.begin(), timers.end());
+	checker.Check(samples.size() == 100 * numThreads, "wrong number of samples");
+	checker.Check(timers.size() == min(50u, 100 * numThreads), "the last timers were not all handed out");
+	checker.Check(adjacent_find(timers.begin(), timers.end()) == timers.end(), "a timer was handed out twice");
+	checker.Check(timers.empty() || (timers.front() >= firstTimer && timers.back() < g_MaxNumTimers),
+		"a timer outside the query heap was handed out");
+
+	g_MaxNumTimers = savedMax;
+
+	checker.errors += TakeStubErrors();
+	printf("timers        %u errors\n", checker.errors.load());
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckOverflow( void )
+{
+	Checker checker;
+
+	// On a thread of its own, so that its ring buffer starts empty
+	thread worker([&checker]
+	{
+		// Closed here, but opened somewhere else
+		ProfilingScopes::Pop();
+
+		ProfilingScopes::Statistics before = ProfilingScopes::GetStatistics();
+
+		// Deeper than the stack
+		const uint32_t kDepth = 70;
+		for (uint32_t i = 0; i < kDepth; ++i)
+			ProfilingScopes::Push(L"Deep", g_Context);
+		for (uint32_t i = 0; i < kDepth; ++i)
+			ProfilingScopes::Pop(g_Context);
+
+		checker.Check(t_OpenTimers.empty() && t_PixDepth == 0, "timers or PIX events left open");
+
+		ProfilingScopes::Statistics after = ProfilingScopes::GetStatistics();
+		checker.Check(after.Recorded - before.Recorded == 64 && after.Dropped - before.Dropped == kDepth - 64,
+			"scopes deeper than the stack were not dropped");
+
+		// More than the ring holds, without draining
+		before = after;
+		for (uint32_t i = 0; i < 10000; ++i)
+		{
+			ProfilingScopes::Push(L"Many");
+			ProfilingScopes::Pop();
+		}
+
+		after = ProfilingScopes::GetStatistics();
+		checker.Check(after.Recorded - before.Recorded == 8192 - 64 && after.Dropped - before.Dropped == 10000 - (8192 - 64),
+			"scopes that didn't fit in the ring buffer were not dropped");
+	});
+	worker.join();
+
+	const vector<Sample> samples = DrainAll();
+	checker.Check(samples.size() == 8192, "a full ring buffer didn't drain whole");
+
+	uint32_t deepest = 0;
+	for (const Sample& sample : samples)
+		deepest = max<uint32_t>(deepest, sample.Scope->Depth);
+	checker.Check(deepest == 64, "the stack kept the wrong number of scopes");
+
+	checker.errors += TakeStubErrors();
+	printf("overflow      %u errors\n", checker.errors.load());
+	return checker.errors;
+}
+
+// Returns the number of errors found.  Samples are dropped if the drain falls behind, but none may go missing.
+uint32_t CheckConcurrentDrain( uint32_t numThreads, uint32_t numScopes )
+{
+	Checker checker;
+	DrainAll();
+
+	const ProfilingScopes::Statistics before = ProfilingScopes::GetStatistics();
+	atomic<uint32_t> running(numThreads);
+	uint64_t drained = 0;
+
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([&running, numScopes]
+		{
+			for (uint32_t s = 0; s < numScopes; s += 2)
+			{
+				ProfilingScopes::Push(L"Outer", g_Context);
+				ProfilingScopes::Push(L"Inner");
+				ProfilingScopes::Pop();
+				ProfilingScopes::Pop(g_Context);
+
+				// Small enough batches that the drain keeps up, even on one core
+				if ((s & 1023) == 0)
+					this_thread::yield();
+			}
+			--running;
+		});
+	}
+
+	vector<Sample> samples;
+	for (;;)
+	{
+		const bool last = running == 0;
+
+		samples.clear();
+		ProfilingScopes::Drain(samples);
+		drained += samples.size();
+
+		for (const Sample& sample : samples)
+		{
+			checker.Check(sample.Begin <= sample.End, "a scope ended before it began");
+			checker.Check((sample.Scope->Name == L"Outer") == (sample.GpuTimerIdx != 0), "wrong GPU timer in a sample");
+			checker.Check(sample.Scope->Name != L"Inner" || sample.Scope->Parent->Name == L"Outer", "wrong parent in a sample");
+		}
+
+		if (last)
+			break;
+		this_thread::yield();
+	}
+
+	for (thread& t : threads)
+		t.join();
+
+	const ProfilingScopes::Statistics after = ProfilingScopes::GetStatistics();
+	const uint64_t expected = (uint64_t)numThreads * ((numScopes + 1) / 2) * 2;
+	checker.Check(after.Recorded - before.Recorded == drained && drained + (after.Dropped - before.Dropped) == expected,
+		"samples were lost");
+
+	checker.errors += TakeStubErrors();
+	printf("concurrent    %u errors  %llu samples  %llu dropped\n", checker.errors.load(), (unsigned long long)drained,
+		(unsigned long long)(after.Dropped - before.Dropped));
+	return checker.errors;
+}
+
+//
+// Timings
+//
+
+// Pairs of nested scopes, as MeasureOverhead() times them, but on a registered thread and optionally timed on the
+// GPU.  Returns nanoseconds per scope.
+double TimeScopes( uint32_t numScopes, CommandContext* context )
+{
+	vector<Sample> samples;
+
+	const auto start = chrono::high_resolution_clock::now();
+	for (uint32_t s = 0; s < numScopes; s += 2)
+	{
+		ProfilingScopes::Push(L"Outer", context);
+		ProfilingScopes::Push(L"Inner", context);
+		ProfilingScopes::Pop(context);
+		ProfilingScopes::Pop(context);
+
+		// Drained as often as it would be at a few thousand scopes a frame
+		if ((s & 2047) == 2046)
+		{
+			samples.clear();
+			ProfilingScopes::Drain(samples);
+		}
+	}
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	DrainAll();
+	return seconds * 1e9 / numScopes;
+}
+
+// Returns nanoseconds per scope on each thread, with all of them recording at once
+double TimeThreads( uint32_t numThreads, uint32_t numScopes )
+{
+	atomic<uint32_t> ready(0);
+	atomic<bool> go(false);
+	vector<double> nanosecs(numThreads);
+
+	vector<thread> threads;
+	for (uint32_t i = 0; i < numThreads; ++i)
+	{
+		threads.emplace_back([&, i]
+		{
+			// Registers the thread before the clock starts
+			ProfilingScopes::Push(L"Warm up");
+			ProfilingScopes::Pop();
+
+			++ready;
+			while (!go)
+				this_thread::yield();
+
+			const auto start = chrono::high_resolution_clock::now();
+			for (uint32_t s = 0; s < numScopes; s += 2)
+			{
+				ProfilingScopes::Push(L"Outer");
+				ProfilingScopes::Push(L"Inner");
+				ProfilingScopes::Pop();
+				ProfilingScopes::Pop();
+			}
+			nanosecs[i] = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count() * 1e9 / numScopes;
+		});
+	}
+
+	while (ready < numThreads)
+		this_thread::yield();
+	go = true;
+
+	// Full rings drop samples, which costs no less than recording them, so there is no need to drain
+	for (thread& t : threads)
+		t.join();
+	DrainAll();
+
+	double total = 0.0;
+	for (double ns : nanosecs)
+		total += ns;
+	return total / numThreads;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-threads <n>\n\tThreads recording at once.  Defaults to 4.\n"
+		"-scopes <n>\n\tScopes timed on each thread.  Defaults to 2000000.\n"
+		"\n\nExample:  %s -threads 8\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numThreads = 4;
+	uint32_t numScopes = 2000000;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-threads", argv[arg]) == 0)
+				numThreads = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-scopes", argv[arg]) == 0)
+				numScopes = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numThreads == 0 || numThreads > 64 || numScopes < 2)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Profiling scopes benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	SystemTime::Initialize();
+
+	uint32_t errors = CheckNesting();
+	errors += CheckTimersRunOut(numThreads);
+	errors += CheckOverflow();
+	errors += CheckConcurrentDrain(numThreads, min(numScopes, 200000u));
+
+	printf("\n%u scopes per thread, nanoseconds per scope:\n\n", numScopes);
+
+	double nanosecsPerScope, nanosecsPerClockRead;
+	ProfilingScopes::MeasureOverhead(numScopes / 2, nanosecsPerScope, nanosecsPerClockRead);
+	printf("%-36s %8.1f\n", "MeasureOverhead()", nanosecsPerScope);
+	printf("%-36s %8.1f\n", "reading the clock alone", nanosecsPerClockRead);
+	printf("%-36s %8.1f\n", "CPU only", TimeScopes(numScopes, nullptr));
+	printf("%-36s %8.1f\n", "with a command context", TimeScopes(numScopes, g_Context));
+
+	char label[64];
+	snprintf(label, sizeof(label), "CPU only, %u threads at once", numThreads);
+	printf("%-36s %8.1f\n", label, TimeThreads(numThreads, numScopes));
+
+	errors += TakeStubErrors();
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
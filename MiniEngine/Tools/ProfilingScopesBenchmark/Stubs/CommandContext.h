@@ -0,0 +1,22 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Stands in for Core/CommandContext.h in the Makefile build, declaring only the members ProfilingScopes.cpp
+// calls.  The benchmark defines them, as it does for the real class in the Visual Studio build.
+//
+
+#pragma once
+
+class CommandContext
+{
+public:
+    void PIXBeginEvent(const wchar_t* label);
+    void PIXEndEvent(void);
+};
@@ -0,0 +1,782 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Replays streams of barrier requests through ResourceBarrierBatch, once exactly as requested and once optimized,
+// and measures how many barriers the optimization removes.  Streams are either generated, by requesting barriers
+// the way CommandContext does for a frame's passes, or read from a trace file.  A generated stream can be written
+// out as a trace, and a trace is plain text so streams captured elsewhere can be replayed too.
+//
+// Both outputs are applied to a model of every subresource's state.  Every transition must start where the
+// subresource is, split barriers must end as they began, and after every batch both models must agree.  A resource
+// in the UAV state on both sides of a batch that the requests ordered must still be ordered by the optimized batch.
+// A few hand-written streams check each rewrite exactly.
+//
+
+#include "pch.h"
+#include "ResourceBarrierBatch.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+// Resources are only compared, so they are numbers dressed up as pointers.  The null resource is kAnyResource.
+static const uint32_t kAnyResource = ~0u;
+
+ID3D12Resource* ToResource( uint32_t id )
+{
+	return id == kAnyResource ? nullptr : reinterpret_cast<ID3D12Resource*>((uintptr_t)(id + 1) * 64);
+}
+
+uint32_t FromResource( ID3D12Resource* resource )
+{
+	return resource == nullptr ? kAnyResource : (uint32_t)(reinterpret_cast<uintptr_t>(resource) / 64 - 1);
+}
+
+// One call a command context makes on its batch, or kWork for a command that flushes it
+struct Request
+{
+	enum Kind { kTransition, kUAV, kAliasing, kWork };
+
+	Kind kind;
+	uint32_t resource;
+	uint32_t otherResource;     // The resource after, for aliasing
+	UINT subresource;
+	D3D12_RESOURCE_STATES before;
+	D3D12_RESOURCE_STATES after;
+	D3D12_RESOURCE_BARRIER_FLAGS flags;
+};
+
+typedef vector<Request> Stream;
+typedef vector<vector<D3D12_RESOURCE_BARRIER>> BatchList;
+
+Request MakeTransition( uint32_t resource, UINT subresource, D3D12_RESOURCE_STATES before, D3D12_RESOURCE_STATES after,
+	D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE )
+{
+	Request request = { Request::kTransition, resource, kAnyResource, subresource, before, after, flags };
+	return request;
+}
+
+Request MakeUAV( uint32_t resource )
+{
+	Request request = { Request::kUAV, resource, kAnyResource, 0, D3D12_RESOURCE_STATE_COMMON,
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_BARRIER_FLAG_NONE };
+	return request;
+}
+
+Request MakeWork( void )
+{
+	Request request = { Request::kWork, kAnyResource, kAnyResource, 0, D3D12_RESOURCE_STATE_COMMON,
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_BARRIER_FLAG_NONE };
+	return request;
+}
+
+//
+// Replay
+//
+
+// Feeds the stream to a batch and returns what reached the command list, one entry per flush
+BatchList Replay( const Stream& stream, bool optimize, ResourceBarrierBatch::Statistics* stats = nullptr )
+{
+	ResourceBarrierBatch batch;
+	batch.SetOptimize(optimize);
+
+	BatchList batches;
+	for (size_t i = 0; i <= stream.size(); ++i)
+	{
+		// Whatever is left at the end is flushed too, as CommandContext::Finish() does
+		if (i == stream.size() || stream[i].kind == Request::kWork)
+		{
+			batches.push_back(vector<D3D12_RESOURCE_BARRIER>(batch.GetBarriers(), batch.GetBarriers() + batch.GetNumBarriers()));
+			batch.Clear();
+			continue;
+		}
+
+		const Request& request = stream[i];
+		switch (request.kind)
+		{
+		case Request::kTransition:
+			batch.AddTransition(ToResource(request.resource), request.subresource, request.before, request.after, request.flags);
+			break;
+		case Request::kUAV:
+			batch.AddUAV(ToResource(request.resource));
+			break;
+		default:
+			batch.AddAliasing(ToResource(request.resource), ToResource(request.otherResource));
+			break;
+		}
+	}
+
+	if (stats != nullptr)
+		*stats = batch.GetStatistics();
+
+	return batches;
+}
+
+//
+// State model
+//
+
+// Subresources past this are not modeled.  A whole-resource transition applies to all of them.
+static const UINT kMaxSubresources = 16;
+
+// Subresources no request transitions stay unknown
+static const uint32_t kUnknownState = ~0u;
+static const uint32_t kInTransition = ~1u;
+
+class StateModel
+{
+public:
+	// Takes each subresource's starting state from the first request that transitions it, so that resources whose
+	// transitions were all dropped are known to both models
+	StateModel( const Stream& stream )
+	{
+		for (const Request& request : stream)
+		{
+			if (request.kind != Request::kTransition || request.resource == kAnyResource)
+				continue;
+
+			array<uint32_t, kMaxSubresources>& states = GetStates(request.resource);
+			const UINT first = request.subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES ? 0 : request.subresource;
+			const UINT last = request.subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES ? kMaxSubresources : request.subresource + 1;
+			for (UINT i = first; i < last && i < kMaxSubresources; ++i)
+			{
+				if (states[i] == kUnknownState)
+					states[i] = request.before;
+			}
+		}
+	}
+
+	// Applies one batch, checking every barrier against the state it finds
+	void Apply( const vector<D3D12_RESOURCE_BARRIER>& barriers, Checker& checker )
+	{
+		for (const D3D12_RESOURCE_BARRIER& barrier : barriers)
+		{
+			if (barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+			{
+				checker.Check(barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE, "a UAV or aliasing barrier has flags");
+				continue;
+			}
+
+			const D3D12_RESOURCE_TRANSITION_BARRIER& transition = barrier.Transition;
+			const uint32_t resource = FromResource(transition.pResource);
+			checker.Check(transition.pResource != nullptr, "a transition has no resource");
+			checker.Check(transition.StateBefore != transition.StateAfter, "a transition does not change state");
+			checker.Check(transition.Subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES ||
+				transition.Subresource < kMaxSubresources, "a subresource is out of range");
+
+			const uint64_t splitKey = (uint64_t)resource << 32 | transition.Subresource;
+			if (barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY)
+			{
+				auto split = m_Splits.find(splitKey);
+				checker.Check(split != m_Splits.end(), "a split barrier ends without beginning");
+				if (split == m_Splits.end())
+					continue;
+				checker.Check(split->second.first == transition.StateBefore && split->second.second == transition.StateAfter,
+					"a split barrier ends in different states than it began");
+				m_Splits.erase(split);
+				SetStates(resource, transition.Subresource, kInTransition, transition.StateAfter, checker);
+				continue;
+			}
+
+			SetStates(resource, transition.Subresource, transition.StateBefore,
+				barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY ? kInTransition : (uint32_t)transition.StateAfter, checker);
+
+			if (barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY)
+			{
+				checker.Check(m_Splits.count(splitKey) == 0, "a split barrier begins twice");
+				m_Splits[splitKey] = make_pair(transition.StateBefore, transition.StateAfter);
+			}
+		}
+	}
+
+	bool IsInUAVState( uint32_t resource ) const
+	{
+		auto states = m_States.find(resource);
+		if (states == m_States.end())
+			return false;
+		for (uint32_t state : states->second)
+		{
+			if (state != kUnknownState && state != kInTransition && (state & D3D12_RESOURCE_STATE_UNORDERED_ACCESS) != 0)
+				return true;
+		}
+		return false;
+	}
+
+	vector<uint32_t> GetUAVResources( void ) const
+	{
+		vector<uint32_t> resources;
+		for (auto& states : m_States)
+		{
+			if (IsInUAVState(states.first))
+				resources.push_back(states.first);
+		}
+		return resources;
+	}
+
+	bool operator==( const StateModel& other ) const { return m_States == other.m_States && m_Splits == other.m_Splits; }
+	bool operator!=( const StateModel& other ) const { return !(*this == other); }
+
+private:
+	void SetStates( uint32_t resource, UINT subresource, uint32_t before, uint32_t after, Checker& checker )
+	{
+		array<uint32_t, kMaxSubresources>& states = GetStates(resource);
+		const UINT first = subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES ? 0 : subresource;
+		const UINT last = subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES ? kMaxSubresources : subresource + 1;
+		for (UINT i = first; i < last && i < kMaxSubresources; ++i)
+		{
+			checker.Check(states[i] == before, before == kInTransition ?
+				"a split barrier ends on a subresource that changed state in between" :
+				"a transition does not start where the subresource is");
+			states[i] = after;
+		}
+	}
+
+	array<uint32_t, kMaxSubresources>& GetStates( uint32_t resource )
+	{
+		auto inserted = m_States.insert(make_pair(resource, array<uint32_t, kMaxSubresources>()));
+		if (inserted.second)
+			inserted.first->second.fill(kUnknownState);
+		return inserted.first->second;
+	}
+
+	map<uint32_t, array<uint32_t, kMaxSubresources>> m_States;
+	map<uint64_t, pair<D3D12_RESOURCE_STATES, D3D12_RESOURCE_STATES>> m_Splits;
+};
+
+// Whether a batch holds a barrier that orders unordered access to the resource
+bool OrdersResource( const vector<D3D12_RESOURCE_BARRIER>& barriers, uint32_t resource )
+{
+	for (const D3D12_RESOURCE_BARRIER& barrier : barriers)
+	{
+		if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV &&
+			(barrier.UAV.pResource == nullptr || FromResource(barrier.UAV.pResource) == resource))
+			return true;
+		if (barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION && FromResource(barrier.Transition.pResource) == resource)
+			return true;
+	}
+	return false;
+}
+
+// Returns the number of errors found
+uint32_t CheckStream( const Stream& stream, ResourceBarrierBatch::Statistics& stats )
+{
+	Checker checker;
+
+	const BatchList raw = Replay(stream, false);
+	const BatchList optimized = Replay(stream, true, &stats);
+	checker.Check(raw.size() == optimized.size(), "the batches were flushed at different times");
+	if (raw.size() != optimized.size())
+		return checker.errors;
+
+	StateModel rawModel(stream), optimizedModel(stream);
+	for (size_t i = 0; i < raw.size(); ++i)
+	{
+		checker.Check(optimized[i].size() <= raw[i].size(), "a batch grew when optimized");
+
+		const vector<uint32_t> uavBefore = rawModel.GetUAVResources();
+		rawModel.Apply(raw[i], checker);
+		optimizedModel.Apply(optimized[i], checker);
+		checker.Check(rawModel == optimizedModel, "the optimized batch leaves resources in different states");
+
+		// Work in the UAV state before and after the batch must stay ordered if the requests ordered it
+		for (uint32_t resource : uavBefore)
+		{
+			if (rawModel.IsInUAVState(resource) && OrdersResource(raw[i], resource))
+				checker.Check(OrdersResource(optimized[i], resource), "unordered access is no longer ordered");
+		}
+	}
+
+	return checker.errors;
+}
+
+//
+// Hand-written streams
+//
+
+struct Case
+{
+	const char* name;
+	Stream stream;
+	size_t expectedBarriers;
+	D3D12_RESOURCE_BARRIER_TYPE expectedFirstType;
+};
+
+// Returns the number of errors found
+uint32_t CheckCases( void )
+{
+	Checker checker;
+
+	const UINT kAll = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	const D3D12_RESOURCE_STATES kUAV = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	const D3D12_RESOURCE_STATES kSRV = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	const D3D12_RESOURCE_STATES kRT = D3D12_RESOURCE_STATE_RENDER_TARGET;
+	const D3D12_RESOURCE_STATES kCopy = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	const D3D12_RESOURCE_BARRIER_FLAGS kBegin = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+	const D3D12_RESOURCE_BARRIER_FLAGS kEnd = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+	const D3D12_RESOURCE_BARRIER_TYPE kTransition = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+
+	const Case kCases[] =
+	{
+		{ "A->B, B->C merges", { MakeTransition(0, kAll, kRT, kSRV), MakeTransition(0, kAll, kSRV, kCopy) }, 1, kTransition },
+		{ "A->B, B->A is dropped", { MakeTransition(0, kAll, kRT, kSRV), MakeTransition(0, kAll, kSRV, kRT) }, 0, kTransition },
+		{ "UAV->B, B->UAV is a UAV barrier", { MakeTransition(0, kAll, kUAV, kSRV), MakeTransition(0, kAll, kSRV, kUAV) },
+			1, D3D12_RESOURCE_BARRIER_TYPE_UAV },
+		{ "A->UAV, UAV->A is a UAV barrier", { MakeTransition(0, 2, kSRV, kUAV), MakeTransition(0, 2, kUAV, kSRV) },
+			1, D3D12_RESOURCE_BARRIER_TYPE_UAV },
+		{ "A->UAV and a UAV barrier", { MakeTransition(0, kAll, kSRV, kUAV), MakeUAV(0) }, 1, kTransition },
+		{ "two UAV barriers", { MakeUAV(0), MakeUAV(0) }, 1, D3D12_RESOURCE_BARRIER_TYPE_UAV },
+		{ "UAV barriers on two resources", { MakeUAV(0), MakeUAV(1) }, 2, D3D12_RESOURCE_BARRIER_TYPE_UAV },
+		{ "a split with no work between", { MakeTransition(0, kAll, kRT, kSRV, kBegin), MakeTransition(0, kAll, kRT, kSRV, kEnd) },
+			1, kTransition },
+		{ "a whole resource and a subresource", { MakeTransition(0, kAll, kRT, kSRV), MakeTransition(0, 1, kSRV, kCopy) },
+			2, kTransition },
+		{ "a barrier between", { MakeTransition(0, kAll, kRT, kSRV), MakeUAV(kAnyResource), MakeTransition(0, kAll, kSRV, kRT) },
+			3, kTransition },
+	};
+
+	for (const Case& c : kCases)
+	{
+		const BatchList batches = Replay(c.stream, true);
+		const vector<D3D12_RESOURCE_BARRIER>& barriers = batches.back();
+
+		const uint32_t errorsBefore = checker.errors;
+		checker.Check(barriers.size() == c.expectedBarriers, "a stream produced the wrong number of barriers");
+		checker.Check(barriers.empty() || barriers[0].Type == c.expectedFirstType, "a stream produced the wrong barrier");
+		for (const D3D12_RESOURCE_BARRIER& barrier : barriers)
+		{
+			checker.Check(barrier.Type != D3D12_RESOURCE_BARRIER_TYPE_UAV || barrier.Flags == D3D12_RESOURCE_BARRIER_FLAG_NONE,
+				"a UAV barrier has flags");
+		}
+
+		ResourceBarrierBatch::Statistics stats;
+		checker.errors += CheckStream(c.stream, stats);
+		if (checker.errors != errorsBefore)
+			printf("  in \"%s\"\n", c.name);
+	}
+
+	printf("Hand-written streams:  %u errors\n", checker.errors);
+
+	return checker.errors;
+}
+
+//
+// Generated streams
+//
+
+// Requests barriers the way CommandContext::TransitionResource() and BeginResourceTransition() do, from state
+// kept per resource as GpuResource keeps it.  Mip chains are transitioned a subresource at a time instead.
+class FrameGenerator
+{
+public:
+	struct Settings
+	{
+		uint32_t numFrames;
+		uint32_t numResources;
+		uint32_t seed;
+	};
+
+	FrameGenerator( const Settings& settings ) : m_Settings(settings), m_Rng(settings.seed)
+	{
+		for (uint32_t i = 0; i < settings.numResources; ++i)
+		{
+			Resource resource;
+			resource.kind = (Resource::Kind)(i % Resource::kNumKinds);
+			resource.state = GetStates(resource.kind)[0];
+			resource.transitioningState = kNotTransitioning;
+			resource.mipStates.fill(resource.state);
+			m_Resources.push_back(resource);
+		}
+	}
+
+	Stream Generate( void )
+	{
+		Stream stream;
+		for (uint32_t frame = 0; frame < m_Settings.numFrames; ++frame)
+		{
+			const uint32_t numPasses = 8 + m_Rng() % 16;
+			for (uint32_t pass = 0; pass < numPasses; ++pass)
+			{
+				// Passes usually declare a few inputs and outputs, and now and then a helper transitions one of
+				// them on its own before the pass does, or a UAV resource is read back in the same pass
+				const uint32_t numRequests = 1 + m_Rng() % 5;
+				for (uint32_t n = 0; n < numRequests; ++n)
+					RequestBarrier(stream);
+				stream.push_back(MakeWork());
+			}
+		}
+		return stream;
+	}
+
+private:
+	static const uint32_t kNotTransitioning = ~0u;
+	static const UINT kNumMips = 4;
+
+	struct Resource
+	{
+		enum Kind { kRenderTarget, kDepthBuffer, kStructuredBuffer, kMipChain, kTexture, kNumKinds };
+
+		Kind kind;
+		uint32_t state;
+		uint32_t transitioningState;
+		array<uint32_t, kNumMips> mipStates;
+	};
+
+	static vector<uint32_t> GetStates( Resource::Kind kind )
+	{
+		const uint32_t kShaderResource = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+		switch (kind)
+		{
+		case Resource::kRenderTarget:
+			return { D3D12_RESOURCE_STATE_RENDER_TARGET, kShaderResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+				D3D12_RESOURCE_STATE_COPY_SOURCE };
+		case Resource::kDepthBuffer:
+			return { D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_DEPTH_READ | kShaderResource, kShaderResource };
+		case Resource::kStructuredBuffer:
+			return { D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE,
+				D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_COPY_SOURCE };
+		case Resource::kMipChain:
+			return { kShaderResource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS };
+		default:
+			return { kShaderResource, D3D12_RESOURCE_STATE_COPY_DEST };
+		}
+	}
+
+	void RequestBarrier( Stream& stream )
+	{
+		const uint32_t index = m_Rng() % m_Settings.numResources;
+		Resource& resource = m_Resources[index];
+		const vector<uint32_t> states = GetStates(resource.kind);
+		const uint32_t newState = states[m_Rng() % states.size()];
+
+		if (resource.kind == Resource::kMipChain)
+		{
+			const UINT mip = m_Rng() % kNumMips;
+			if (resource.mipStates[mip] != newState)
+				stream.push_back(MakeTransition(index, mip, (D3D12_RESOURCE_STATES)resource.mipStates[mip], (D3D12_RESOURCE_STATES)newState));
+			else if (newState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+				stream.push_back(MakeUAV(index));
+			resource.mipStates[mip] = newState;
+			return;
+		}
+
+		// A resource with a transition begun can only be finished, as the engine does before using it
+		const uint32_t choice = m_Rng() % 16;
+		if (resource.transitioningState != kNotTransitioning)
+			Transition(stream, index, resource.transitioningState);
+		else if (choice < 2)
+			BeginTransition(stream, index, newState);
+		else if (choice < 3)
+			stream.push_back(MakeUAV(m_Rng() % 4 == 0 ? kAnyResource : index));
+		else
+		{
+			// A helper that needs the resource in some state, after which the pass wants it in another
+			Transition(stream, index, newState);
+			if (choice < 5)
+				Transition(stream, index, states[m_Rng() % states.size()]);
+		}
+	}
+
+	// CommandContext::TransitionResource()
+	void Transition( Stream& stream, uint32_t index, uint32_t newState )
+	{
+		Resource& resource = m_Resources[index];
+		if (resource.state != newState)
+		{
+			D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+			if (newState == resource.transitioningState)
+			{
+				flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+				resource.transitioningState = kNotTransitioning;
+			}
+			stream.push_back(MakeTransition(index, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, (D3D12_RESOURCE_STATES)resource.state,
+				(D3D12_RESOURCE_STATES)newState, flags));
+			resource.state = newState;
+		}
+		else if (newState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS)
+			stream.push_back(MakeUAV(index));
+	}
+
+	// CommandContext::BeginResourceTransition()
+	void BeginTransition( Stream& stream, uint32_t index, uint32_t newState )
+	{
+		Resource& resource = m_Resources[index];
+		if (resource.state != newState)
+		{
+			stream.push_back(MakeTransition(index, D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, (D3D12_RESOURCE_STATES)resource.state,
+				(D3D12_RESOURCE_STATES)newState, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+			resource.transitioningState = newState;
+		}
+	}
+
+	Settings m_Settings;
+	mt19937 m_Rng;
+	vector<Resource> m_Resources;
+};
+
+//
+// Trace files
+//
+// One request per line, with # starting a comment:
+//
+//     T <resource> <subresource> <before> <after> [begin|end]     a transition
+//     U <resource>                                                a UAV barrier
+//     A <resource> <resource>                                     an aliasing barrier
+//     W                                                           work, which flushes the batch
+//
+// Resources are numbers, or * for none.  The subresource is a number or * for all of them, and states are numbers
+// as in D3D12_RESOURCE_STATES, in hexadecimal with a 0x prefix.
+//
+
+string FormatResource( uint32_t resource )
+{
+	return resource == kAnyResource ? string("*") : to_string(resource);
+}
+
+uint32_t ParseResource( const char* text )
+{
+	if (strcmp(text, "*") == 0)
+		return kAnyResource;
+	char* end;
+	const unsigned long resource = strtoul(text, &end, 0);
+	if (*end != '\0' || resource >= kAnyResource)
+		throw runtime_error("Invalid resource in trace");
+	return (uint32_t)resource;
+}
+
+void WriteTrace( const char* filename, const Stream& stream )
+{
+	FILE* file = fopen(filename, "w");
+	if (file == nullptr)
+		throw runtime_error("Cannot write trace");
+
+	fprintf(file, "# Barrier requests, from ResourceBarrierBatchBenchmark v.%d.%d\n", kMajorVersion, kMinorVersion);
+	for (const Request& request : stream)
+	{
+		switch (request.kind)
+		{
+		case Request::kTransition:
+			fprintf(file, "T %s %s 0x%x 0x%x%s\n", FormatResource(request.resource).c_str(),
+				request.subresource == D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES ? "*" : to_string(request.subresource).c_str(),
+				(uint32_t)request.before, (uint32_t)request.after,
+				request.flags == D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY ? " begin" :
+				request.flags == D3D12_RESOURCE_BARRIER_FLAG_END_ONLY ? " end" : "");
+			break;
+		case Request::kUAV:
+			fprintf(file, "U %s\n", FormatResource(request.resource).c_str());
+			break;
+		case Request::kAliasing:
+			fprintf(file, "A %s %s\n", FormatResource(request.resource).c_str(), FormatResource(request.otherResource).c_str());
+			break;
+		default:
+			fprintf(file, "W\n");
+			break;
+		}
+	}
+
+	fclose(file);
+}
+
+Stream ReadTrace( const char* filename )
+{
+	FILE* file = fopen(filename, "r");
+	if (file == nullptr)
+		throw runtime_error("Cannot read trace");
+
+	Stream stream;
+	char line[256];
+	while (fgets(line, sizeof(line), file) != nullptr)
+	{
+		char* comment = strchr(line, '#');
+		if (comment != nullptr)
+			*comment = '\0';
+
+		char kind[8], first[32], second[32], before[32], after[32], flags[32];
+		const int fields = sscanf(line, "%7s %31s %31s %31s %31s %31s", kind, first, second, before, after, flags);
+		if (fields <= 0)
+			continue;
+
+		Request request = MakeWork();
+		if (strcmp(kind, "T") == 0 && (fields == 5 || fields == 6))
+		{
+			request.kind = Request::kTransition;
+			request.resource = ParseResource(first);
+			request.subresource = strcmp(second, "*") == 0 ? D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES : (UINT)strtoul(second, nullptr, 0);
+			request.before = (D3D12_RESOURCE_STATES)strtoul(before, nullptr, 0);
+			request.after = (D3D12_RESOURCE_STATES)strtoul(after, nullptr, 0);
+			if (fields == 6 && strcmp(flags, "begin") == 0)
+				request.flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+			else if (fields == 6 && strcmp(flags, "end") == 0)
+				request.flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+			else if (fields == 6)
+				throw runtime_error("Invalid flags in trace");
+		}
+		else if (strcmp(kind, "U") == 0 && fields == 2)
+		{
+			request.kind = Request::kUAV;
+			request.resource = ParseResource(first);
+		}
+		else if (strcmp(kind, "A") == 0 && fields == 3)
+		{
+			request.kind = Request::kAliasing;
+			request.resource = ParseResource(first);
+			request.otherResource = ParseResource(second);
+		}
+		else if (strcmp(kind, "W") != 0 || fields != 1)
+		{
+			fclose(file);
+			throw runtime_error("Invalid line in trace");
+		}
+		stream.push_back(request);
+	}
+
+	fclose(file);
+	return stream;
+}
+
+//
+// Measurement
+//
+
+void ReportStream( const char* name, const Stream& stream, const ResourceBarrierBatch::Statistics& stats )
+{
+	const double seconds = [&stream]()
+	{
+		auto start = chrono::high_resolution_clock::now();
+		Replay(stream, true);
+		return chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+	}();
+
+	printf("%-24s  %9llu requested  %9llu emitted (%4.1f%% fewer)  %8llu merged  %8llu elided  %7llu collapsed  %5.1f ns each\n",
+		name, (unsigned long long)stats.Requested, (unsigned long long)stats.Emitted,
+		stats.Requested == 0 ? 0.0 : 100.0 * (double)(stats.Requested - stats.Emitted) / (double)stats.Requested,
+		(unsigned long long)stats.Merged, (unsigned long long)stats.Elided, (unsigned long long)stats.SplitsCollapsed,
+		stream.empty() ? 0.0 : seconds * 1e9 / (double)stream.size());
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-frames <n>\n\tFrames generated per seed.  Defaults to 2000.\n"
+		"-resources <n>\n\tResources the generated frames use.  Defaults to 24.\n"
+		"-seeds <n>\n\tStreams generated with different seeds.  Defaults to 4.\n"
+		"-record <file>\n\tWrites the first generated stream to a trace file.\n"
+		"-trace <file>\n\tReplays a trace file instead of generating streams.\n"
+		"\n\nExample:  %s -frames 100 -seeds 1 -record frames.txt\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	FrameGenerator::Settings settings = { 2000, 24, 0 };
+	uint32_t numSeeds = 4;
+	const char* recordFile = nullptr;
+	const char* traceFile = nullptr;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-frames", argv[arg]) == 0)
+				settings.numFrames = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-resources", argv[arg]) == 0)
+				settings.numResources = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seeds", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-record", argv[arg]) == 0)
+				recordFile = argv[++arg];
+			else if (strcmp("-trace", argv[arg]) == 0)
+				traceFile = argv[++arg];
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (settings.numFrames == 0 || settings.numResources == 0 || numSeeds == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Resource barrier batch benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = CheckCases();
+	printf("\n");
+
+	try
+	{
+		if (traceFile != nullptr)
+		{
+			const Stream stream = ReadTrace(traceFile);
+			ResourceBarrierBatch::Statistics stats;
+			errors += CheckStream(stream, stats);
+			ReportStream(traceFile, stream, stats);
+		}
+		else
+		{
+			for (uint32_t seed = 0; seed < numSeeds; ++seed)
+			{
+				settings.seed = seed;
+				const Stream stream = FrameGenerator(settings).Generate();
+				if (seed == 0 && recordFile != nullptr)
+					WriteTrace(recordFile, stream);
+
+				ResourceBarrierBatch::Statistics stats;
+				errors += CheckStream(stream, stats);
+				const string name = "Generated, seed " + to_string(seed);
+				ReportStream(name.c_str(), stream, stats);
+			}
+		}
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		return 1;
+	}
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,344 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Measures SceneGraph updates on a large instanced scene:  districts of instances, each instance a small tree of
+// parts.  Updates are timed with every node moving, with a few instances moving, and with nothing moving.
+//
+// With -validate, world transforms are checked against a recursive double precision reference after each kind
+// of update and after instances are moved between districts, and every bound is checked to be exact.
+//
+
+#include "SceneGraph.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace Math;
+
+typedef SceneGraph::NodeId NodeId;
+
+const uint32_t kInstancesPerDistrict = 100;
+const uint32_t kPartsPerNode = 4;
+const uint32_t kPartLevels = 3;
+
+// Rotation about y, uniform scale and translation, laid out as Math::Matrix4 is in memory
+void MakeTransform( float angle, float scale, float x, float y, float z, float* m )
+{
+	const float c = cosf(angle) * scale, s = sinf(angle) * scale;
+	const float matrix[16] =
+	{
+		c, 0.0f, -s, 0.0f,
+		0.0f, scale, 0.0f, 0.0f,
+		s, 0.0f, c, 0.0f,
+		x, y, z, 1.0f
+	};
+	memcpy(m, matrix, sizeof(matrix));
+}
+
+struct Scene
+{
+	SceneGraph graph;
+	vector<NodeId> districts;
+	vector<NodeId> instances;
+};
+
+void AddParts( Scene& scene, NodeId parent, uint32_t level, mt19937& rng )
+{
+	uniform_real_distribution<float> offset(-4.0f, 4.0f);
+	uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+	for (uint32_t i = 0; i < kPartsPerNode; ++i)
+	{
+		const NodeId part = scene.graph.AddNode(parent);
+		float m[16];
+		MakeTransform(angle(rng), 0.5f, offset(rng), offset(rng) + 2.0f, offset(rng), m);
+		scene.graph.SetLocalTransform(part, m);
+
+		// Leaves have geometry, and so does every other part above them
+		if (level + 1 == kPartLevels || i % 2 == 0)
+		{
+			const float lo[3] = { -1.0f, 0.0f, -1.0f };
+			const float hi[3] = { 1.0f, 3.0f, 1.0f };
+			scene.graph.SetLocalBounds(part, lo, hi);
+		}
+
+		if (level + 1 < kPartLevels)
+			AddParts(scene, part, level + 1, rng);
+	}
+}
+
+void GenerateScene( uint32_t numInstances, Scene& scene )
+{
+	mt19937 rng(1234);
+	uniform_real_distribution<float> position(-200.0f, 200.0f);
+	uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+	const uint32_t numDistricts = (numInstances + kInstancesPerDistrict - 1) / kInstancesPerDistrict;
+	for (uint32_t d = 0; d < numDistricts; ++d)
+	{
+		const NodeId district = scene.graph.AddNode();
+		float m[16];
+		MakeTransform(0.0f, 1.0f, (float)(d % 32) * 500.0f, 0.0f, (float)(d / 32) * 500.0f, m);
+		scene.graph.SetLocalTransform(district, m);
+		scene.districts.push_back(district);
+	}
+
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		const NodeId instance = scene.graph.AddNode(scene.districts[i / kInstancesPerDistrict]);
+		float m[16];
+		MakeTransform(angle(rng), 1.0f, position(rng), 0.0f, position(rng), m);
+		scene.graph.SetLocalTransform(instance, m);
+		scene.instances.push_back(instance);
+		AddParts(scene, instance, 0, rng);
+	}
+}
+
+// Recomputes every world transform and world box from scratch in double precision, and compares
+double GetMaxError( const SceneGraph& graph )
+{
+	const uint32_t numNodes = graph.GetNumNodes();
+	vector<double> world(numNodes * 16);
+	vector<uint8_t> done(numNodes, 0);
+	double maxError = 0.0;
+
+	for (NodeId node = 0; node < numNodes; ++node)
+	{
+		// Walk up to the nearest computed ancestor, then back down
+		vector<NodeId> chain;
+		for (NodeId n = node; n != SceneGraph::kNoParent && !done[n]; n = graph.GetParent(n))
+			chain.push_back(n);
+
+		for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+		{
+			const float* local = graph.GetLocalTransform(*it);
+			const NodeId parent = graph.GetParent(*it);
+			double* w = &world[*it * 16];
+			for (int r = 0; r < 4; ++r)
+			{
+				for (int c = 0; c < 4; ++c)
+				{
+					if (parent == SceneGraph::kNoParent)
+					{
+						w[r * 4 + c] = local[r * 4 + c];
+						continue;
+					}
+					const double* p = &world[parent * 16];
+					w[r * 4 + c] = local[r * 4] * p[c] + local[r * 4 + 1] * p[4 + c] + local[r * 4 + 2] * p[8 + c] + local[r * 4 + 3] * p[12 + c];
+				}
+			}
+			done[*it] = 1;
+		}
+
+		const double* w = &world[node * 16];
+		const float* actual = graph.GetWorldTransform(node);
+		for (int i = 0; i < 16; ++i)
+			maxError = max(maxError, fabs(actual[i] - w[i]) / max(1.0, fabs(w[i])));
+
+		// Every part with geometry has the same local box, centered at (0, 1.5, 0) with extents (1, 1.5, 1)
+		float lo[3], hi[3];
+		if (!graph.GetWorldBounds(node, lo, hi))
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			const double center = 1.5 * w[4 + k] + w[12 + k];
+			const double extent = fabs(w[k]) + 1.5 * fabs(w[4 + k]) + fabs(w[8 + k]);
+			maxError = max(maxError, fabs(lo[k] - (center - extent)) / max(1.0, fabs(center - extent)));
+			maxError = max(maxError, fabs(hi[k] - (center + extent)) / max(1.0, fabs(center + extent)));
+		}
+	}
+
+	return maxError;
+}
+
+// Every subtree box must be exactly the union of the node's own box and its children's subtree boxes
+uint32_t CountBoundsErrors( const SceneGraph& graph )
+{
+	const uint32_t numNodes = graph.GetNumNodes();
+	vector<float> expected(numNodes * 6);
+	for (NodeId node = 0; node < numNodes; ++node)
+		graph.GetWorldBounds(node, &expected[node * 6], &expected[node * 6 + 3]);
+
+	// Children always come after their parents in update order, so fold them in from the back
+	for (uint32_t index = numNodes; index-- > 0; )
+	{
+		const NodeId node = graph.GetNodeAt(index);
+		const NodeId parent = graph.GetParent(node);
+		if (parent == SceneGraph::kNoParent)
+			continue;
+		for (int k = 0; k < 3; ++k)
+		{
+			expected[parent * 6 + k] = min(expected[parent * 6 + k], expected[node * 6 + k]);
+			expected[parent * 6 + 3 + k] = max(expected[parent * 6 + 3 + k], expected[node * 6 + 3 + k]);
+		}
+	}
+
+	uint32_t errors = 0;
+	for (NodeId node = 0; node < numNodes; ++node)
+	{
+		float lo[3], hi[3];
+		graph.GetSubtreeBounds(node, lo, hi);
+		if (memcmp(lo, &expected[node * 6], sizeof(lo)) != 0 || memcmp(hi, &expected[node * 6 + 3], sizeof(hi)) != 0)
+			++errors;
+	}
+	return errors;
+}
+
+void Validate( const char* name, const SceneGraph& graph )
+{
+	printf("%-30s  max relative error %.2g, %u bounds errors\n", name, GetMaxError(graph), CountBoundsErrors(graph));
+}
+
+// Runs move() and Update() for some frames and reports the average time of the updates
+template <typename Func>
+void TimeUpdates( const char* name, uint32_t numFrames, Scene& scene, Func move )
+{
+	double seconds = 0.0;
+	uint64_t updated = 0;
+	for (uint32_t frame = 0; frame < numFrames; ++frame)
+	{
+		move(frame);
+		auto start = chrono::high_resolution_clock::now();
+		scene.graph.Update();
+		seconds += chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+		updated += scene.graph.GetNumNodesUpdated();
+	}
+
+	printf("%-30s  %8.3f ms  %10.0f nodes updated\n", name, seconds * 1000.0 / numFrames, (double)updated / numFrames);
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-instances <n>\n\tInstances in the scene, each of 85 nodes.  Defaults to 10000.\n"
+		"-frames <n>\n\tUpdates to average.  Defaults to 20.\n"
+		"-validate\n\tChecks the results against a reference.  This is slow.\n"
+		"\n\nExample:  %s -instances 2000 -validate\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	uint32_t numInstances = 10000;
+	uint32_t numFrames = 20;
+	bool validate = false;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (strcmp("-validate", argv[arg]) == 0)
+				validate = true;
+			else if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-instances", argv[arg]) == 0)
+				numInstances = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-frames", argv[arg]) == 0)
+				numFrames = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (numInstances == 0 || numFrames == 0)
+			throw runtime_error("Invalid operand");
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Scene graph benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	Scene scene;
+	GenerateScene(numInstances, scene);
+
+	auto start = chrono::high_resolution_clock::now();
+	scene.graph.Update();
+	const double firstUpdate = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	printf("%u nodes in %u levels, first update with sorting %.3f ms\n\n", scene.graph.GetNumNodes(),
+		scene.graph.GetNumLevels(), firstUpdate * 1000.0);
+
+	if (validate)
+		Validate("After the first update", scene.graph);
+
+	mt19937 rng(5678);
+	uniform_real_distribution<float> position(-200.0f, 200.0f);
+	uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+
+	TimeUpdates("Every district moving", numFrames, scene, [&]( uint32_t frame )
+	{
+		for (uint32_t d = 0; d < scene.districts.size(); ++d)
+		{
+			float m[16];
+			MakeTransform(frame * 0.01f, 1.0f, (float)(d % 32) * 500.0f, (float)frame, (float)(d / 32) * 500.0f, m);
+			scene.graph.SetLocalTransform(scene.districts[d], m);
+		}
+	});
+
+	if (validate)
+		Validate("After moving every district", scene.graph);
+
+	TimeUpdates("1% of instances moving", numFrames, scene, [&]( uint32_t )
+	{
+		for (uint32_t i = 0; i < numInstances / 100 + 1; ++i)
+		{
+			float m[16];
+			MakeTransform(angle(rng), 1.0f, position(rng), 0.0f, position(rng), m);
+			scene.graph.SetLocalTransform(scene.instances[rng() % numInstances], m);
+		}
+	});
+
+	if (validate)
+		Validate("After moving some instances", scene.graph);
+
+	TimeUpdates("Nothing moving", numFrames, scene, []( uint32_t ) {});
+
+	if (validate)
+	{
+		// Move some instances to other districts, which sorts the nodes again
+		for (uint32_t i = 0; i < numInstances / 100 + 1; ++i)
+			scene.graph.SetParent(scene.instances[rng() % numInstances], scene.districts[rng() % scene.districts.size()]);
+		scene.graph.Update();
+		Validate("After reparenting", scene.graph);
+
+		// And add some under the existing districts
+		for (uint32_t i = 0; i < numInstances / 100 + 1; ++i)
+		{
+			const NodeId instance = scene.graph.AddNode(scene.districts[rng() % scene.districts.size()]);
+			AddParts(scene, instance, 0, rng);
+		}
+		scene.graph.Update();
+		Validate("After adding instances", scene.graph);
+	}
+
+	printf("\n");
+	return 0;
+}
@@ -0,0 +1,68 @@
+'''
+Copyright (c) Microsoft. All rights reserved.
+This code is licensed under the MIT License (MIT).
+THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+
+Developed by Minigraph
+
+Writes the chunked .gz files that Utility::ReadFileSync() decompresses in parallel.  The file is
+split into blocks that are compressed independently and written as a series of gzip members, so
+that any gzip tool can still read the result.  Each member's header has an extra field ('M' 'E')
+holding the member's size and the block's size, which the engine uses as an index.
+
+Usage:  python CompressChunked.py [-level N] [-block KB] file...
+'''
+
+import struct
+import sys
+import zlib
+
+def CompressFile( fileName, outFileName=None, blockSize=256 * 1024, level=9 ):
+	'''Compresses fileName to outFileName (fileName + ".gz" by default)'''
+	if outFileName == None:
+		outFileName = fileName + '.gz'
+
+	with open(fileName, 'rb') as infile:
+		contents = infile.read()
+
+	with open(outFileName, 'wb') as outfile:
+		# An empty file still gets one (empty) member
+		for start in range(0, max(len(contents), 1), blockSize):
+			block = contents[start:start + blockSize]
+
+			compressor = zlib.compressobj(level, zlib.DEFLATED, -15)
+			deflated = compressor.compress(block) + compressor.flush()
+
+			# Header (with a 12 byte extra field), compressed data, CRC and size
+			memberSize = 12 + 12 + len(deflated) + 8
+
+			outfile.write(struct.pack('<BBBBIBBH', 0x1f, 0x8b, 8, 0x04, 0, 0, 255, 12))
+			outfile.write(struct.pack('<BBHII', ord('M'), ord('E'), 8, memberSize, len(block)))
+			outfile.write(deflated)
+			outfile.write(struct.pack('<II', zlib.crc32(block) & 0xffffffff, len(block)))
+
+	print('Compressed {0} ({1} bytes) to {2}'.format(fileName, len(contents), outFileName))
+
+if __name__ == "__main__":
+	level = 9
+	blockSize = 256 * 1024
+	files = []
+
+	args = sys.argv[1:]
+	while args:
+		arg = args.pop(0)
+		if arg == '-level':
+			level = int(args.pop(0))
+		elif arg == '-block':
+			blockSize = int(args.pop(0)) * 1024
+		else:
+			files.append(arg)
+
+	if not files:
+		print(__doc__)
+
+	for file in files:
+		CompressFile(file, blockSize=blockSize, level=level)
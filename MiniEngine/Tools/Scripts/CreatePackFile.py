@@ -0,0 +1,99 @@
+'''
+Copyright (c) Microsoft. All rights reserved.
+This code is licensed under the MIT License (MIT).
+THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+
+Developed by Minigraph
+
+Writes the pack files that Utility::FileSystem::MountPackFile() mounts.  Every file under each
+directory is stored by its path relative to that directory, so mounting the pack stands in for
+mounting the directory.  The files are followed by a directory sorted by a hash of their names
+and then by the names themselves.
+
+Usage:  python CreatePackFile.py [-o pack] directory...
+'''
+
+import os
+import struct
+import sys
+
+MAGIC = b'MPAK'
+VERSION = 1
+HEADER_FORMAT = '<4sIIIQQ'
+ENTRY_FORMAT = '<QQQII'
+ALIGNMENT = 16
+
+def MakeKey( name ):
+	'''Matches MakePackKey() in FileSystem.cpp'''
+	while name[:2] in ('.\\', './'):
+		name = name[2:]
+	name = ''.join(c.lower() if 'A' <= c <= 'Z' else c for c in name.replace('/', '\\'))
+	return name.encode('utf-8')
+
+def HashKey( key ):
+	'''64-bit FNV-1a'''
+	hash = 0xcbf29ce484222325
+	for b in bytearray(key):
+		hash = ((hash ^ b) * 0x100000001b3) & 0xffffffffffffffff
+	return hash
+
+def CreatePackFile( directories, outFileName ):
+	'''Packs every file under the given directories.  Later directories win when names collide.'''
+	files = {}
+	for directory in directories:
+		for root, dirs, names in os.walk(directory):
+			for name in names:
+				path = os.path.join(root, name)
+				files[MakeKey(os.path.relpath(path, directory))] = path
+
+	entries = []
+
+	with open(outFileName, 'wb') as outfile:
+		outfile.write(b'\0' * struct.calcsize(HEADER_FORMAT))
+
+		for key in sorted(files):
+			outfile.write(b'\0' * (-outfile.tell() % ALIGNMENT))
+			with open(files[key], 'rb') as infile:
+				contents = infile.read()
+			entries.append((HashKey(key), key, outfile.tell(), len(contents)))
+			outfile.write(contents)
+
+		entries.sort()
+
+		outfile.write(b'\0' * (-outfile.tell() % 8))
+		directoryOffset = outfile.tell()
+		nameOffset = 0
+		for hash, key, offset, size in entries:
+			outfile.write(struct.pack(ENTRY_FORMAT, hash, offset, size, nameOffset, len(key)))
+			nameOffset += len(key)
+
+		namesOffset = outfile.tell()
+		for hash, key, offset, size in entries:
+			outfile.write(key)
+
+		outfile.seek(0)
+		outfile.write(struct.pack(HEADER_FORMAT, MAGIC, VERSION, len(entries), 0, directoryOffset, namesOffset))
+
+	print('Packed {0} files into {1}'.format(len(entries), outFileName))
+
+if __name__ == "__main__":
+	outFileName = None
+	directories = []
+
+	args = sys.argv[1:]
+	while args:
+		arg = args.pop(0)
+		if arg == '-o':
+			outFileName = args.pop(0)
+		else:
+			directories.append(arg)
+
+	if not directories:
+		print(__doc__)
+	else:
+		if outFileName == None:
+			outFileName = os.path.normpath(directories[-1]) + '.pak'
+		CreatePackFile(directories, outFileName)
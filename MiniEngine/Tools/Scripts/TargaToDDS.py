@@ -1,11 +1,10 @@
 def CompileTGA( filename, normalMap=False ):
 	import subprocess
 
-	args = 'texconv.exe ' + filename + ' -nologo -vflip'
+	# TextureCompressor (Tools/TextureCompressor) keeps rows in file order, as TextureManager loads them
+	args = 'TextureCompressor.exe ' + filename + ' -f BC1'
 	if normalMap:
-		args += ' -f BC1_UNORM'
-	else:
-		args += ' -srgbi -f BC1_UNORM_SRGB'
+		args += ' -linear'
 
 	print('Calling "{0}"'.format(args))
 	subprocess.call(args.split())
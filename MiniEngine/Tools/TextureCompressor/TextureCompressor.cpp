@@ -0,0 +1,311 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Compresses TGAs to .dds files with the engine's block compression encoder, so that offline and load time
+// compression produce the same texels.  Rows are kept in file order, as TextureManager loads them.  Mips are
+// generated on the CPU with ImageProcessing.
+//
+
+#include "BlockCompression.h"
+#include "ImageProcessing.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+using namespace BlockCompression;
+
+struct Image
+{
+	uint32_t Width;
+	uint32_t Height;
+	vector<uint8_t> Pixels;		// RGBA8
+};
+
+// Reads an uncompressed 24 or 32-bit TGA
+bool LoadTGA( const string& fileName, Image& image )
+{
+	ifstream file(fileName, ios::in | ios::binary);
+	if (!file)
+		return false;
+
+	uint8_t header[18];
+	if (!file.read((char*)header, sizeof(header)))
+		return false;
+
+	const uint8_t idLength = header[0];
+	const uint8_t imageType = header[2];
+	const uint8_t bitCount = header[16];
+	if (imageType != 2 || (bitCount != 24 && bitCount != 32))
+		return false;
+
+	image.Width = header[12] | header[13] << 8;
+	image.Height = header[14] | header[15] << 8;
+
+	const uint32_t numChannels = bitCount / 8;
+	vector<uint8_t> fileData((size_t)image.Width * image.Height * numChannels);
+	file.seekg(sizeof(header) + idLength);
+	if (!file.read((char*)fileData.data(), fileData.size()))
+		return false;
+
+	image.Pixels.resize((size_t)image.Width * image.Height * 4);
+	for (size_t i = 0, j = 0; i < fileData.size(); i += numChannels, j += 4)
+	{
+		image.Pixels[j + 0] = fileData[i + 2];
+		image.Pixels[j + 1] = fileData[i + 1];
+		image.Pixels[j + 2] = fileData[i + 0];
+		image.Pixels[j + 3] = numChannels == 4 ? fileData[i + 3] : 255;
+	}
+
+	return true;
+}
+
+bool WriteDDS( const string& fileName, Format fmt, bool sRGB, const Image& image, uint32_t mipCount, const vector<uint8_t>& blocks )
+{
+	uint8_t header[kDDSHeaderSize];
+	WriteDDSHeader(header, fmt, sRGB, image.Width, image.Height, mipCount, 0);
+
+	ofstream file(fileName, ios::out | ios::binary | ios::trunc);
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)blocks.data(), blocks.size());
+	return file.good();
+}
+
+// Returns the RMS error of the channels a format stores, and of alpha separately.  BC1 alpha is either 0 or
+// 255, so the color of transparent pixels doesn't count.
+void MeasureError( Format fmt, const Image& source, const vector<uint8_t>& decoded, double& colorRMSE, double& alphaRMSE )
+{
+	const uint32_t numColorChannels = fmt == kBC5 ? 2 : 3;
+	double colorError = 0.0, alphaError = 0.0;
+	size_t colorCount = 0, alphaCount = 0;
+
+	for (size_t i = 0; i < source.Pixels.size(); i += 4)
+	{
+		uint8_t sourceAlpha = source.Pixels[i + 3];
+		if (fmt == kBC1)
+			sourceAlpha = sourceAlpha < 128 ? 0 : 255;
+
+		if (fmt != kBC1 || sourceAlpha != 0)
+		{
+			for (uint32_t c = 0; c < numColorChannels; ++c)
+			{
+				double d = (double)source.Pixels[i + c] - decoded[i + c];
+				colorError += d * d;
+			}
+			colorCount += numColorChannels;
+		}
+
+		if (fmt != kBC5)
+		{
+			double d = (double)sourceAlpha - decoded[i + 3];
+			alphaError += d * d;
+			++alphaCount;
+		}
+	}
+
+	colorRMSE = colorCount ? sqrt(colorError / colorCount) : 0.0;
+	alphaRMSE = alphaCount ? sqrt(alphaError / alphaCount) : 0.0;
+}
+
+// Compares names the way the options are documented, without regard to case
+bool NamesMatch( const char* a, const char* b )
+{
+	for (; *a != 0 && tolower((unsigned char)*a) == tolower((unsigned char)*b); ++a, ++b)
+		;
+	return *a == *b;
+}
+
+// Compresses with every format and quality, reporting throughput and error
+void Benchmark( const string& fileName, const Image& image )
+{
+	const double megaPixels = image.Width * image.Height / 1000000.0;
+
+	printf("%s (%ux%u)\n\n", fileName.c_str(), image.Width, image.Height);
+	printf("Format  Quality    MPix/s    Color RMSE    Alpha RMSE\n");
+
+	vector<uint8_t> decoded(image.Pixels.size());
+
+	for (int f = 0; f < kNumFormats; ++f)
+	{
+		const Format fmt = (Format)f;
+		vector<uint8_t> blocks(GetCompressedSize(fmt, image.Width, image.Height));
+
+		for (int q = 0; q < kNumQualities; ++q)
+		{
+			const Quality qual = (Quality)q;
+
+			// Repeat short runs so that the timer has something to measure
+			uint32_t iterations = 0;
+			auto start = chrono::high_resolution_clock::now();
+			double seconds = 0.0;
+			do
+			{
+				Compress(fmt, qual, image.Pixels.data(), image.Width * 4, image.Width, image.Height, blocks.data());
+				++iterations;
+				seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+			}
+			while (seconds < 0.5);
+
+			Decompress(fmt, blocks.data(), image.Width, image.Height, decoded.data(), image.Width * 4);
+
+			double colorRMSE, alphaRMSE;
+			MeasureError(fmt, image, decoded, colorRMSE, alphaRMSE);
+
+			printf("%-6s  %-7s  %8.2f  %12.3f  %12.3f\n", GetFormatName(fmt), GetQualityName(qual),
+				megaPixels * iterations / seconds, colorRMSE, alphaRMSE);
+		}
+	}
+
+	printf("\n");
+}
+
+int main( int argc, const char** argv )
+{
+	vector<string> inputFiles;
+	Format fmt = kBC1;
+	Quality qual = kNormal;
+	bool sRGB = true;
+	bool benchmark = false;
+	int mipFilter = ImageProcessing::kBox;		// -1 for no mips
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (argv[arg][0] != '-')
+				inputFiles.push_back(argv[arg]);
+			else if (strcmp("-linear", argv[arg]) == 0)
+				sRGB = false;
+			else if (strcmp("-benchmark", argv[arg]) == 0)
+				benchmark = true;
+			else if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-f", argv[arg]) == 0)
+			{
+				const char* name = argv[++arg];
+				int f = 0;
+				while (f < kNumFormats && !NamesMatch(name, GetFormatName((Format)f)))
+					++f;
+				if (f == kNumFormats)
+					throw runtime_error("Unknown format");
+				fmt = (Format)f;
+			}
+			else if (strcmp("-mips", argv[arg]) == 0)
+			{
+				const char* name = argv[++arg];
+				int m = 0;
+				while (m < ImageProcessing::kNumFilters && !NamesMatch(name, ImageProcessing::GetFilterName((ImageProcessing::Filter)m)))
+					++m;
+				if (m == ImageProcessing::kNumFilters)
+				{
+					if (!NamesMatch(name, "none"))
+						throw runtime_error("Unknown mip filter");
+					m = -1;
+				}
+				mipFilter = m;
+			}
+			else if (strcmp("-q", argv[arg]) == 0)
+			{
+				const char* name = argv[++arg];
+				int q = 0;
+				while (q < kNumQualities && !NamesMatch(name, GetQualityName((Quality)q)))
+					++q;
+				if (q == kNumQualities)
+					throw runtime_error("Unknown quality");
+				qual = (Quality)q;
+			}
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (inputFiles.empty())
+			throw runtime_error("No TGA file specified");
+	}
+	catch (exception& e)
+	{
+		printf(
+			"Error: %s\n\n"
+			"Usage:  %s <TGA file>+ [options]*\n\n"
+			"Options:\n\n"
+			"-f <BC1 | BC3 | BC5 | BC7>\n\tThe block compressed format.  Defaults to BC1.\n"
+			"-q <Fast | Normal | High>\n\tThe quality preset.  Defaults to Normal.\n"
+			"-mips <None | Box | Kaiser>\n\tThe filter for generating mips.  Defaults to Box.\n"
+			"-linear\n\tWrites a UNORM rather than UNORM_SRGB format (for normal maps and other data).\n\tMips are filtered without gamma correction.\n"
+			"-benchmark\n\tCompresses with every format and quality and reports speed and error.\n\tNo files are written.\n"
+			"\n\nExample:  %s bricks_normal.tga -f BC5 -q High -linear\n\n", e.what(), argv[0], argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Texture compressor v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	int failures = 0;
+
+	for (const string& inputFile : inputFiles)
+	{
+		Image image;
+		if (!LoadTGA(inputFile, image))
+		{
+			printf("Unable to read %s (only uncompressed 24 and 32-bit TGAs are supported)\n", inputFile.c_str());
+			++failures;
+			continue;
+		}
+
+		if (benchmark)
+		{
+			Benchmark(inputFile, image);
+			continue;
+		}
+
+		uint32_t mipCount = 1;
+		vector<uint8_t> mipChain = image.Pixels;
+		if (mipFilter >= 0)
+		{
+			mipCount = ImageProcessing::GetMipCount(image.Width, image.Height);
+			mipChain.resize(ImageProcessing::GetMipChainSize(image.Width, image.Height, mipCount, 4));
+			ImageProcessing::GenerateMipChain((ImageProcessing::Filter)mipFilter, sRGB, image.Pixels.data(),
+				image.Width, image.Height, mipCount, mipChain.data());
+		}
+
+		vector<uint8_t> blocks;
+		const uint8_t* mipPixels = mipChain.data();
+		for (uint32_t mip = 0; mip < mipCount; ++mip)
+		{
+			const uint32_t width = max(image.Width >> mip, 1u);
+			const uint32_t height = max(image.Height >> mip, 1u);
+
+			const size_t offset = blocks.size();
+			blocks.resize(offset + GetCompressedSize(fmt, width, height));
+			Compress(fmt, qual, mipPixels, width * 4, width, height, blocks.data() + offset);
+			mipPixels += width * height * 4;
+		}
+
+		const string outputFile = inputFile.substr(0, inputFile.rfind('.')) + ".dds";
+		if (WriteDDS(outputFile, fmt, sRGB, image, mipCount, blocks))
+			printf("%s -> %s (%s %s)\n", inputFile.c_str(), outputFile.c_str(), GetFormatName(fmt), GetQualityName(qual));
+		else
+		{
+			printf("Unable to write %s\n", outputFile.c_str());
+			++failures;
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
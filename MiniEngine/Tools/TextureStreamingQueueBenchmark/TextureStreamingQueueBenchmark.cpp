@@ -0,0 +1,561 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+// Developed by Minigraph
+//
+// Drives TextureStreamingQueue with a fake texture sink, whose files are only sizes and whose reads take a while.
+//
+// Reads must start in priority order, and a cancelled request must never reach the sink.  A request must try its
+// candidates in order and finish exactly once, created or failed, from the owner's thread.  The bytes being read
+// and the bytes read but not consumed must stay within the budget, unless a single read is larger than the whole
+// budget.  The sink measures this itself, from the reads it is doing and the buffers it has handed out that are
+// still alive.  A stress run then requests, cancels and reprioritizes from the owner's thread while several I/O
+// threads read, and reports the peak bytes in flight and the time to stream everything.
+//
+
+#include "pch.h"
+#include "TextureStreamingQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define kMajorVersion	1
+#define kMinorVersion	0
+
+using namespace std;
+
+struct Checker
+{
+	uint32_t errors;
+
+	Checker() : errors(0) {}
+
+	void Check( bool condition, const char* what )
+	{
+		if (!condition && errors++ < 10)
+			printf("  %s\n", what);
+	}
+};
+
+// What the sink knows about one file
+struct FakeFile
+{
+	size_t size;            // What GetReadSize() reports
+	size_t readSize;        // What ReadFile() returns, which may be less, as with mip tails.  Zero fails the read.
+	bool creatable;         // Whether CreateTexture() accepts it
+};
+
+// What the sink knows about one request, passed as its user data
+struct FakeTexture
+{
+	atomic<uint32_t> numCreated;
+	atomic<uint32_t> numFailed;
+	wstring createdFrom;
+	bool cancelled;
+
+	FakeTexture() : numCreated(0), numFailed(0), cancelled(false) {}
+};
+
+class FakeSink : public ITextureStreamingSink
+{
+public:
+	FakeSink( size_t budget, uint32_t readMicroseconds ) : m_Budget(budget), m_ReadMicroseconds(readMicroseconds),
+		m_Outstanding(0), m_PeakOutstanding(0), m_OverBudget(0), m_WrongThread(0), m_Cancelled(0), m_GateOpen(true),
+		m_OwnerThread(this_thread::get_id()) {}
+
+	void AddFile( const wstring& name, size_t size, size_t readSize, bool creatable )
+	{
+		FakeFile file = { size, readSize, creatable };
+		m_Files[name] = file;
+	}
+
+	// While closed, reads wait before returning, so that requests can pile up behind them
+	void SetGate( bool open )
+	{
+		{
+			lock_guard<mutex> guard(m_Mutex);
+			m_GateOpen = open;
+		}
+		m_GateChanged.notify_all();
+	}
+
+	vector<wstring> GetReadOrder( void )
+	{
+		lock_guard<mutex> guard(m_Mutex);
+		return m_ReadOrder;
+	}
+
+	void ClearReadOrder( void )
+	{
+		lock_guard<mutex> guard(m_Mutex);
+		m_ReadOrder.clear();
+	}
+
+	size_t GetOutstanding( void ) const { return (size_t)m_Outstanding.load(); }
+	// Leaving out reads started alone, which may be larger than the budget
+	size_t GetPeakOutstanding( void ) const { return (size_t)m_PeakOutstanding.load(); }
+	uint32_t GetOverBudget( void ) const { return m_OverBudget; }
+	uint32_t GetWrongThread( void ) const { return m_WrongThread; }
+	uint32_t GetCancelledCalls( void ) const { return m_Cancelled; }
+
+	size_t GetReadSize( void* userData, const wstring& fileName ) override
+	{
+		(void)userData;
+		auto file = m_Files.find(fileName);
+		return file == m_Files.end() ? 0 : file->second.size;
+	}
+
+	FileData ReadFile( void* userData, const wstring& fileName, uint64_t offset, size_t size ) override
+	{
+		(void)userData;
+		auto file = m_Files.find(fileName);
+		const size_t expected = file == m_Files.end() ? 0 : size != kWholeFile ? size : file->second.size;
+
+		// The queue reserved the expected size before calling, so everything outstanding must fit the budget,
+		// unless this read is the only thing outstanding
+		const int64_t outstanding = m_Outstanding += (int64_t)expected;
+		if ((size_t)outstanding != expected)
+		{
+			UpdatePeak(outstanding);
+			if ((size_t)outstanding > m_Budget)
+				++m_OverBudget;
+		}
+
+		{
+			lock_guard<mutex> guard(m_Mutex);
+			m_ReadOrder.push_back(fileName);
+		}
+
+		if (m_ReadMicroseconds > 0)
+			this_thread::sleep_for(chrono::microseconds(m_ReadMicroseconds));
+
+		{
+			unique_lock<mutex> lock(m_Mutex);
+			m_GateChanged.wait(lock, [this] { return m_GateOpen; });
+		}
+
+		size_t readSize = file == m_Files.end() ? 0 : file->second.readSize;
+		if (size != kWholeFile)
+			readSize = (size_t)min<uint64_t>(size, offset < readSize ? readSize - offset : 0);
+
+		// The deleter tells the sink when the queue lets go of the bytes
+		FileData data;
+		if (readSize > 0)
+		{
+			atomic<int64_t>& counter = m_Outstanding;
+			data = FileData(new vector<uint8_t>(readSize, (uint8_t)readSize), [&counter, readSize]( vector<uint8_t>* bytes )
+			{
+				counter -= (int64_t)readSize;
+				delete bytes;
+			});
+		}
+
+		// What was expected becomes what was read, in one step so that neither is counted twice
+		m_Outstanding += (int64_t)readSize - (int64_t)expected;
+		return data;
+	}
+
+	bool CreateTexture( void* userData, const wstring& fileName, const uint8_t* data, size_t size ) override
+	{
+		FakeTexture& texture = *(FakeTexture*)userData;
+		Observe(texture);
+
+		auto file = m_Files.find(fileName);
+		if (file == m_Files.end() || data == nullptr || size == 0 || !file->second.creatable)
+			return false;
+
+		texture.createdFrom = fileName;
+		++texture.numCreated;
+		return true;
+	}
+
+	void LoadFailed( void* userData ) override
+	{
+		FakeTexture& texture = *(FakeTexture*)userData;
+		Observe(texture);
+		++texture.numFailed;
+	}
+
+private:
+	void Observe( const FakeTexture& texture )
+	{
+		if (this_thread::get_id() != m_OwnerThread)
+			++m_WrongThread;
+		if (texture.cancelled)
+			++m_Cancelled;
+	}
+
+	void UpdatePeak( int64_t outstanding )
+	{
+		int64_t peak = m_PeakOutstanding;
+		while (outstanding > peak && !m_PeakOutstanding.compare_exchange_weak(peak, outstanding))
+			;
+	}
+
+	map<wstring, FakeFile> m_Files;     // Not changed once the queue is running
+	size_t m_Budget;
+	uint32_t m_ReadMicroseconds;
+
+	atomic<int64_t> m_Outstanding;
+	atomic<int64_t> m_PeakOutstanding;
+	atomic<uint32_t> m_OverBudget;
+	atomic<uint32_t> m_WrongThread;
+	atomic<uint32_t> m_Cancelled;
+
+	mutex m_Mutex;
+	condition_variable m_GateChanged;
+	bool m_GateOpen;
+	vector<wstring> m_ReadOrder;
+	thread::id m_OwnerThread;
+};
+
+wstring FileName( const char* prefix, uint32_t index )
+{
+	const string name = prefix + to_string(index) + ".dds";
+	return wstring(name.begin(), name.end());
+}
+
+// Returns the number of errors found
+uint32_t CheckSinkCounters( Checker& checker, FakeSink& sink )
+{
+	checker.Check(sink.GetOverBudget() == 0, "reads started with too little room in the budget");
+	checker.Check(sink.GetWrongThread() == 0, "the sink was called from an I/O thread");
+	checker.Check(sink.GetCancelledCalls() == 0, "a cancelled request reached the sink");
+	checker.Check(sink.GetOutstanding() == 0, "read bytes were not freed");
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckOrder( void )
+{
+	Checker checker;
+	const uint32_t kNumRequests = 64;
+
+	FakeSink sink(SIZE_MAX, 0);
+	sink.AddFile(L"blocker.dds", 16, 16, true);
+	for (uint32_t i = 0; i < kNumRequests; ++i)
+		sink.AddFile(FileName("file", i), 16, 16, true);
+
+	TextureStreamingQueue queue;
+	queue.Create(&sink, 1, SIZE_MAX);
+
+	// The only I/O thread is held in the first read while everything else is requested
+	sink.SetGate(false);
+	vector<FakeTexture> textures(kNumRequests + 1);
+	queue.Request({ L"blocker.dds" }, 1000.0f, &textures[kNumRequests]);
+	while (sink.GetReadOrder().empty())
+		this_thread::yield();
+
+	mt19937 rng(1);
+	vector<float> priorities(kNumRequests);
+	vector<TextureStreamingQueue::RequestId> ids(kNumRequests);
+	for (uint32_t i = 0; i < kNumRequests; ++i)
+	{
+		priorities[i] = (float)(rng() % 8);
+		ids[i] = queue.Request({ FileName("file", i) }, priorities[i], &textures[i]);
+	}
+
+	// Every fourth one is cancelled and every third one reprioritized, all before any is read
+	for (uint32_t i = 0; i < kNumRequests; ++i)
+	{
+		if (i % 4 == 0)
+		{
+			textures[i].cancelled = true;
+			checker.Check(queue.Cancel(ids[i]), "a queued request could not be cancelled");
+			checker.Check(!queue.Cancel(ids[i]), "a request was cancelled twice");
+		}
+		else if (i % 3 == 0)
+		{
+			priorities[i] = (float)(rng() % 8);
+			checker.Check(queue.SetPriority(ids[i], priorities[i]), "a queued request could not be reprioritized");
+		}
+	}
+
+	sink.ClearReadOrder();
+	sink.SetGate(true);
+	queue.Flush();
+
+	// Highest priority first, then in request order
+	vector<uint32_t> expected;
+	for (uint32_t i = 0; i < kNumRequests; ++i)
+	{
+		if (!textures[i].cancelled)
+			expected.push_back(i);
+	}
+	stable_sort(expected.begin(), expected.end(), [&priorities]( uint32_t a, uint32_t b ) { return priorities[a] > priorities[b]; });
+
+	const vector<wstring> order = sink.GetReadOrder();
+	checker.Check(order.size() == expected.size(), "the wrong number of files was read");
+	for (size_t i = 0; i < min(order.size(), expected.size()); ++i)
+		checker.Check(order[i] == FileName("file", expected[i]), "files were not read in priority order");
+
+	for (uint32_t i = 0; i < kNumRequests; ++i)
+	{
+		checker.Check(textures[i].numCreated == (textures[i].cancelled ? 0u : 1u), "a request was not created exactly once");
+		checker.Check(textures[i].numFailed == 0, "a readable request failed");
+	}
+
+	const TextureStreamingQueue::Statistics stats = queue.GetStatistics();
+	checker.Check(stats.Cancelled == kNumRequests / 4 && stats.Completed == stats.Requested - stats.Cancelled,
+		"the statistics don't add up");
+	checker.Check(stats.BytesInFlight == 0, "bytes are still in flight after a flush");
+
+	queue.Shutdown();
+	CheckSinkCounters(checker, sink);
+
+	printf("Priority order and cancellation:  %u errors\n", checker.errors);
+	return checker.errors;
+}
+
+// Returns the number of errors found
+uint32_t CheckCandidates( void )
+{
+	Checker checker;
+
+	FakeSink sink(SIZE_MAX, 0);
+	sink.AddFile(L"good.dds", 100, 100, true);
+	sink.AddFile(L"corrupt.dds", 100, 100, false);
+	sink.AddFile(L"unreadable.dds", 100, 0, true);
+	sink.AddFile(L"large.dds", 1000, 1000, true);
+
+	TextureStreamingQueue queue;
+	queue.Create(&sink, 2, SIZE_MAX);
+
+	FakeTexture missingFirst, corruptFirst, unreadableFirst, allBad, range, rangePastEnd;
+	queue.Request({ L"missing.dds", L"good.dds" }, 0.0f, &missingFirst);
+	queue.Request({ L"corrupt.dds", L"good.dds" }, 0.0f, &corruptFirst);
+	queue.Request({ L"unreadable.dds", L"good.dds" }, 0.0f, &unreadableFirst);
+	queue.Request({ L"missing.dds", L"corrupt.dds", L"unreadable.dds" }, 0.0f, &allBad);
+	queue.RequestRange(L"large.dds", 200, 300, 0.0f, &range);
+	queue.RequestRange(L"large.dds", 2000, 300, 0.0f, &rangePastEnd);
+	queue.Flush();
+
+	checker.Check(missingFirst.numCreated == 1 && missingFirst.createdFrom == L"good.dds", "a missing candidate was not skipped");
+	checker.Check(corruptFirst.numCreated == 1 && corruptFirst.createdFrom == L"good.dds", "an unusable candidate was not skipped");
+	checker.Check(unreadableFirst.numCreated == 1 && unreadableFirst.createdFrom == L"good.dds", "an unreadable candidate was not skipped");
+	checker.Check(allBad.numCreated == 0 && allBad.numFailed == 1, "a request with no usable candidate did not fail once");
+	checker.Check(range.numCreated == 1 && range.numFailed == 0, "a range was not read");
+	checker.Check(rangePastEnd.numCreated == 0 && rangePastEnd.numFailed == 1, "a range past the end of the file did not fail");
+
+	const TextureStreamingQueue::Statistics stats = queue.GetStatistics();
+	checker.Check(stats.Completed == 4 && stats.Failed == 2, "the statistics don't add up");
+
+	queue.Shutdown();
+	CheckSinkCounters(checker, sink);
+
+	printf("Candidates and ranges:  %u errors\n", checker.errors);
+	return checker.errors;
+}
+
+struct StressSettings
+{
+	uint32_t numRequests;
+	uint32_t numThreads;
+	size_t budget;
+	uint32_t readMicroseconds;
+	uint32_t seed;
+};
+
+// Returns the number of errors found
+uint32_t CheckStress( const StressSettings& settings )
+{
+	Checker checker;
+	mt19937 rng(settings.seed);
+
+	// Mostly small files and a few larger than the whole budget, some read smaller than their size says
+	FakeSink sink(settings.budget, settings.readMicroseconds);
+	for (uint32_t i = 0; i < settings.numRequests; ++i)
+	{
+		const uint32_t kind = rng() % 64;
+		const size_t size = kind == 0 ? settings.budget + settings.budget / 2 : 1024 + rng() % (settings.budget / 8);
+		const size_t readSize = rng() % 4 == 0 ? size / 2 : size;
+		sink.AddFile(FileName("file", i), size, kind == 1 ? 0 : readSize, kind != 2);
+	}
+
+	TextureStreamingQueue queue;
+	queue.Create(&sink, settings.numThreads, settings.budget);
+
+	vector<FakeTexture> textures(settings.numRequests);
+	vector<TextureStreamingQueue::RequestId> ids(settings.numRequests);
+
+	auto start = chrono::high_resolution_clock::now();
+
+	// Requests arrive a few at a time between updates, as a game would make them, and some change their minds
+	uint32_t numRequested = 0;
+	while (numRequested < settings.numRequests)
+	{
+		const uint32_t burst = min<uint32_t>(settings.numRequests - numRequested, 1 + rng() % 16);
+		for (uint32_t n = 0; n < burst; ++n, ++numRequested)
+		{
+			const uint32_t i = numRequested;
+			vector<wstring> candidates;
+			if (rng() % 8 == 0)
+				candidates.push_back(FileName("missing", i));
+			candidates.push_back(FileName("file", i));
+			ids[i] = queue.Request(candidates, (float)(rng() % 16), &textures[i]);
+		}
+
+		for (uint32_t n = 0; n < 4; ++n)
+		{
+			const uint32_t i = rng() % numRequested;
+			if (rng() % 2 == 0)
+			{
+				// Set before cancelling, because a request that can no longer be cancelled may finish any time
+				const bool wasCancelled = textures[i].cancelled;
+				textures[i].cancelled = true;
+				if (!queue.Cancel(ids[i]))
+					textures[i].cancelled = wasCancelled;
+			}
+			else
+			{
+				queue.SetPriority(ids[i], (float)(rng() % 16));
+			}
+		}
+
+		queue.Update(settings.budget / 4);
+	}
+	queue.Flush();
+
+	const double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+	uint32_t numCancelled = 0;
+	for (const FakeTexture& texture : textures)
+	{
+		numCancelled += texture.cancelled ? 1 : 0;
+		checker.Check(texture.numCreated + texture.numFailed == (texture.cancelled ? 0u : 1u), "a request did not finish exactly once");
+	}
+
+	const TextureStreamingQueue::Statistics stats = queue.GetStatistics();
+	checker.Check(stats.Requested == settings.numRequests && stats.Cancelled == numCancelled &&
+		stats.Completed + stats.Failed + stats.Cancelled == stats.Requested, "the statistics don't add up");
+	checker.Check(stats.NumQueued == 0 && stats.NumReading == 0 && stats.NumReady == 0 && stats.BytesInFlight == 0,
+		"requests are left over after a flush");
+
+	queue.Shutdown();
+	CheckSinkCounters(checker, sink);
+
+	printf("%2u threads, %6zu KB budget:  %6u requests (%u cancelled) in %6.3f s, peak %6zu KB in flight:  %u errors\n",
+		settings.numThreads, settings.budget >> 10, settings.numRequests, numCancelled, seconds, sink.GetPeakOutstanding() >> 10,
+		checker.errors);
+	return checker.errors;
+}
+
+// Shutting down with requests in every state must not call the sink again
+// Returns the number of errors found
+uint32_t CheckShutdown( void )
+{
+	Checker checker;
+	const uint32_t kNumRequests = 256;
+
+	FakeSink sink(64 << 10, 50);
+	for (uint32_t i = 0; i < kNumRequests; ++i)
+		sink.AddFile(FileName("file", i), 4096, 4096, true);
+
+	vector<FakeTexture> textures(kNumRequests);
+	{
+		TextureStreamingQueue queue;
+		queue.Create(&sink, 4, 64 << 10);
+		for (uint32_t i = 0; i < kNumRequests; ++i)
+			queue.Request({ FileName("file", i) }, 0.0f, &textures[i]);
+		queue.Update(16 << 10);
+		this_thread::sleep_for(chrono::milliseconds(1));
+		for (FakeTexture& texture : textures)
+			texture.cancelled = true;
+	}
+
+	CheckSinkCounters(checker, sink);
+
+	printf("Shutdown:  %u errors\n", checker.errors);
+	return checker.errors;
+}
+
+void PrintUsage( const char* exe )
+{
+	printf(
+		"Usage:  %s [options]*\n\n"
+		"Options:\n\n"
+		"-requests <n>\n\tRequests made in each stress run.  Defaults to 20000.\n"
+		"-budget <n>\n\tIn-flight byte budget in kilobytes.  Defaults to 1024.\n"
+		"-delay <n>\n\tMicroseconds each fake read takes.  Defaults to 20.\n"
+		"-seeds <n>\n\tStress runs repeated with different seeds.  Defaults to 2.\n"
+		"\n\nExample:  %s -requests 5000 -delay 200\n\n", exe, exe);
+}
+
+int main( int argc, const char** argv )
+{
+	StressSettings settings = { 20000, 0, 1024, 20, 0 };
+	uint32_t numSeeds = 2;
+
+	try
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			if (strcmp("-h", argv[arg]) == 0 || strcmp("--help", argv[arg]) == 0)
+			{
+				PrintUsage(argv[0]);
+				return 0;
+			}
+
+			if (arg + 1 == argc)
+				throw runtime_error("Missing operand");
+			else if (strcmp("-requests", argv[arg]) == 0)
+				settings.numRequests = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-budget", argv[arg]) == 0)
+				settings.budget = (size_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-delay", argv[arg]) == 0)
+				settings.readMicroseconds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else if (strcmp("-seeds", argv[arg]) == 0)
+				numSeeds = (uint32_t)strtoul(argv[++arg], nullptr, 10);
+			else
+				throw runtime_error("Invalid option");
+		}
+
+		if (settings.numRequests == 0 || settings.budget < 64 || numSeeds == 0)
+			throw runtime_error("Invalid operand");
+		settings.budget <<= 10;
+	}
+	catch (exception& e)
+	{
+		printf("Error: %s\n\n", e.what());
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	printf("\n[ Texture streaming queue benchmark v.%d.%d ]\n\n", kMajorVersion, kMinorVersion);
+
+	uint32_t errors = CheckOrder();
+	errors += CheckCandidates();
+	errors += CheckShutdown();
+	printf("\n");
+
+	const uint32_t kThreadCounts[] = { 1, 2, 4, 8 };
+	for (uint32_t seed = 0; seed < numSeeds; ++seed)
+	{
+		for (uint32_t numThreads : kThreadCounts)
+		{
+			settings.numThreads = numThreads;
+			settings.seed = seed;
+			errors += CheckStress(settings);
+		}
+	}
+
+	printf("\n%u errors\n\n", errors);
+	return errors > 0 ? 1 : 0;
+}